@@ -0,0 +1,309 @@
+/**
+ * @file benchmark.h
+ * Minimal micro-benchmark harness for rtosc-bench
+ *
+ * Each benchmark is a function running its workload a given number of
+ * times. The runner first calibrates the number of iterations, such that one
+ * sample takes at least the minimum sample time, then discards one warm up
+ * sample and takes the configured number of samples. The results are given
+ * in ns per iteration, as median, median absolute deviation, minimum, mean,
+ * standard deviation and 95% confidence interval of the mean.
+ *
+ * Latency benchmarks time each single event instead and report the
+ * percentiles of the event durations, the median being the 50th percentile.
+ *
+ * Options:
+ *  --json, --csv      machine readable output (default: text table)
+ *  --filter=<str>     only run benchmarks whose name contains str
+ *  --samples=<n>      number of samples per benchmark (default: 20)
+ *  --min-time=<ms>    minimum duration of one sample (default: 10)
+ *  --list             only print the benchmark names
+ */
+
+#ifndef RTOSC_BENCHMARK_H
+#define RTOSC_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+//! Prevent the compiler from optimizing away the computation of @p v
+template<class T>
+inline void do_not_optimize(const T &v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(v) : "memory");
+#else
+    static volatile const T *sink;
+    sink = &v;
+#endif
+}
+
+struct result_t
+{
+    std::string name;
+    uint64_t    iterations; //!< iterations per sample
+    size_t      samples;
+    double      median, mad, min, mean, stddev, ci95; //!< ns per iteration
+    bool        latency;   //!< whether the percentiles below are set
+    double      p90, p99, p999, max; //!< ns per event
+};
+
+class Runner
+{
+    public:
+        typedef std::function<void(uint64_t iterations)> bench_t;
+
+        Runner(int argc, char **argv)
+            :format(TEXT), nsamples(20), min_time_ms(10), list(false)
+        {
+            for(int i=1; i<argc; ++i) {
+                const char *a = argv[i];
+                if(!strcmp(a, "--json"))
+                    format = JSON;
+                else if(!strcmp(a, "--csv"))
+                    format = CSV;
+                else if(!strcmp(a, "--list"))
+                    list = true;
+                else if(!strncmp(a, "--filter=", 9))
+                    filter = a + 9;
+                else if(!strncmp(a, "--samples=", 10))
+                    nsamples = std::max(2, atoi(a + 10));
+                else if(!strncmp(a, "--min-time=", 11))
+                    min_time_ms = std::max(1.0, atof(a + 11));
+                else {
+                    fprintf(stderr, "usage: %s [--json|--csv] [--list] "
+                            "[--filter=<str>] [--samples=<n>] "
+                            "[--min-time=<ms>]\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+
+        //! Run @p fn, unless it is filtered out
+        void run(const char *name, const bench_t &fn)
+        {
+            if(!filter.empty() && !strstr(name, filter.c_str()))
+                return;
+            if(list) {
+                printf("%s\n", name);
+                return;
+            }
+
+            //calibrate, such that one sample takes at least min_time_ms
+            uint64_t iterations = 1;
+            while(true) {
+                const double ns = time(fn, iterations);
+                if(ns >= min_time_ms * 1e6 || iterations >= (1ull << 40))
+                    break;
+                const double scale = ns > 0 ? min_time_ms * 1e6 / ns : 100;
+                iterations = std::max<uint64_t>(iterations + 1,
+                        iterations * std::min(100.0, scale * 1.2));
+            }
+
+            time(fn, iterations); //warm up
+            std::vector<double> s(nsamples);
+            for(double &x : s)
+                x = time(fn, iterations) / iterations;
+
+            result_t r;
+            r.name       = name;
+            r.iterations = iterations;
+            r.samples    = s.size();
+            r.median     = median(s);
+            r.min        = *std::min_element(s.begin(), s.end());
+            double sum   = 0, sq = 0;
+            for(double x : s)
+                sum += x;
+            r.mean       = sum / s.size();
+            for(double x : s)
+                sq += (x - r.mean) * (x - r.mean);
+            r.stddev     = sqrt(sq / (s.size() - 1));
+            r.ci95       = 1.96 * r.stddev / sqrt(s.size());
+            std::vector<double> dev(s.size());
+            for(size_t i=0; i<s.size(); ++i)
+                dev[i] = fabs(s[i] - r.median);
+            r.mad        = median(dev);
+            r.latency    = false;
+            results.push_back(r);
+
+            if(format == TEXT)
+                print_text(r);
+        }
+
+        typedef std::function<void(uint64_t event)> event_t;
+
+        /**
+         * Time @p events single calls of @p fn and report percentiles
+         *
+         * Each call is timed on its own, so the clock overhead is part of
+         * the durations. Use run() for the throughput.
+         */
+        void latency(const char *name, const event_t &fn, uint64_t events)
+        {
+            if(!filter.empty() && !strstr(name, filter.c_str()))
+                return;
+            if(list) {
+                printf("%s\n", name);
+                return;
+            }
+
+            typedef std::chrono::steady_clock clock;
+            for(uint64_t i=0; i<events/10; ++i) //warm up
+                fn(i);
+            std::vector<double> s(events);
+            for(uint64_t i=0; i<events; ++i) {
+                const clock::time_point start = clock::now();
+                fn(i);
+                s[i] = std::chrono::duration<double, std::nano>(
+                        clock::now() - start).count();
+            }
+            std::sort(s.begin(), s.end());
+
+            result_t r;
+            r.name       = name;
+            r.iterations = 1;
+            r.samples    = s.size();
+            r.median     = percentile(s, 0.5);
+            r.min        = s.front();
+            double sum   = 0, sq = 0;
+            for(double x : s)
+                sum += x;
+            r.mean       = sum / s.size();
+            for(double x : s)
+                sq += (x - r.mean) * (x - r.mean);
+            r.stddev     = sqrt(sq / (s.size() - 1));
+            r.ci95       = 1.96 * r.stddev / sqrt(s.size());
+            std::vector<double> dev(s.size());
+            for(size_t i=0; i<s.size(); ++i)
+                dev[i] = fabs(s[i] - r.median);
+            r.mad        = median(dev);
+            r.latency    = true;
+            r.p90        = percentile(s, 0.9);
+            r.p99        = percentile(s, 0.99);
+            r.p999       = percentile(s, 0.999);
+            r.max        = s.back();
+            results.push_back(r);
+
+            if(format == TEXT)
+                print_text(r);
+        }
+
+        //! Print the results, @return the exit code for main()
+        int finish(const char *version)
+        {
+            if(list)
+                return EXIT_SUCCESS;
+            if(format == JSON) {
+                printf("{\n  \"rtosc_version\": \"%s\",\n"
+                       "  \"compiler\": \"%s\",\n"
+                       "  \"samples\": %d,\n  \"min_time_ms\": %g,\n"
+                       "  \"benchmarks\": [\n",
+                       version, compiler(), nsamples, min_time_ms);
+                for(size_t i=0; i<results.size(); ++i) {
+                    const result_t &r = results[i];
+                    printf("    {\"name\": \"%s\", \"iterations\": %llu, "
+                           "\"samples\": %zu, \"median_ns\": %.3f, "
+                           "\"mad_ns\": %.3f, \"min_ns\": %.3f, "
+                           "\"mean_ns\": %.3f, \"stddev_ns\": %.3f, "
+                           "\"ci95_ns\": %.3f",
+                           r.name.c_str(), (unsigned long long)r.iterations,
+                           r.samples, r.median, r.mad, r.min, r.mean,
+                           r.stddev, r.ci95);
+                    if(r.latency)
+                        printf(", \"p90_ns\": %.3f, \"p99_ns\": %.3f, "
+                               "\"p999_ns\": %.3f, \"max_ns\": %.3f",
+                               r.p90, r.p99, r.p999, r.max);
+                    printf("}%s\n", i+1 < results.size() ? "," : "");
+                }
+                printf("  ]\n}\n");
+            } else if(format == CSV) {
+                printf("name,iterations,samples,median_ns,mad_ns,min_ns,"
+                       "mean_ns,stddev_ns,ci95_ns,p90_ns,p99_ns,p999_ns,"
+                       "max_ns\n");
+                for(const result_t &r : results) {
+                    printf("%s,%llu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f",
+                           r.name.c_str(), (unsigned long long)r.iterations,
+                           r.samples, r.median, r.mad, r.min, r.mean,
+                           r.stddev, r.ci95);
+                    if(r.latency)
+                        printf(",%.3f,%.3f,%.3f,%.3f\n",
+                               r.p90, r.p99, r.p999, r.max);
+                    else
+                        printf(",,,,\n");
+                }
+            }
+            return EXIT_SUCCESS;
+        }
+
+    private:
+        enum format_t { TEXT, JSON, CSV };
+
+        static double time(const bench_t &fn, uint64_t iterations)
+        {
+            typedef std::chrono::steady_clock clock;
+            const clock::time_point start = clock::now();
+            fn(iterations);
+            return std::chrono::duration<double, std::nano>(
+                    clock::now() - start).count();
+        }
+
+        //! @param sorted must be sorted
+        static double percentile(const std::vector<double> &sorted, double p)
+        {
+            const size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+            return sorted[std::min(i, sorted.size() - 1)];
+        }
+
+        static double median(std::vector<double> v)
+        {
+            std::sort(v.begin(), v.end());
+            const size_t n = v.size();
+            return n % 2 ? v[n/2] : (v[n/2-1] + v[n/2]) / 2;
+        }
+
+        void print_text(const result_t &r)
+        {
+            if(results.size() == 1)
+                printf("%-36s %12s %10s %10s %10s %10s\n", "benchmark",
+                       "iterations", "median", "+-mad", "min", "mean");
+            printf("%-36s %12llu %8.2fns %8.2fns %8.2fns %8.2fns\n",
+                   r.name.c_str(), (unsigned long long)r.iterations,
+                   r.median, r.mad, r.min, r.mean);
+            if(r.latency)
+                printf("%-36s p90 %.2fns, p99 %.2fns, p99.9 %.2fns, "
+                       "max %.2fns\n", "", r.p90, r.p99, r.p999, r.max);
+            fflush(stdout);
+        }
+
+        static const char *compiler(void)
+        {
+#if defined(__clang__)
+            return "clang " __clang_version__;
+#elif defined(__GNUC__)
+            return "gcc " __VERSION__;
+#else
+            return "unknown";
+#endif
+        }
+
+        format_t              format;
+        int                   nsamples;
+        double                min_time_ms;
+        bool                  list;
+        std::string           filter;
+        std::vector<result_t> results;
+};
+
+}
+
+#endif
@@ -0,0 +1,441 @@
+//Micro-benchmarks for the performance critical parts of rtosc
+//Run "rtosc-bench --help" for the options, see benchmark.h
+
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/pretty-format.h>
+#include <rtosc/savefile.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/miditable.h>
+#include <rtosc/automations.h>
+#include <rtosc/rtosc-version.h>
+
+#include "benchmark.h"
+
+using namespace rtosc;
+using bench::do_not_optimize;
+
+/*
+ * Port tree for dispatch, savefiles and port walking:
+ * /part#16/voice#8/osc/..., four levels deep
+ */
+struct Oscillator
+{
+    float   phase   = 0.0f;
+    int     shape   = 0;
+    bool    sync    = false;
+    static const Ports ports;
+};
+
+struct Voice
+{
+    float      volume  = 0.5f;
+    int        detune  = 0;
+    bool       enabled = true;
+    Oscillator osc;
+    static const Ports ports;
+};
+
+struct Part
+{
+    Voice voice[8];
+    float gain    = 1.0f;
+    int   channel = 0;
+    static const Ports ports;
+};
+
+struct Master
+{
+    Part  part[16];
+    float volume = 0.8f;
+    static const Ports ports;
+};
+
+#define rObject Oscillator
+const Ports Oscillator::ports = {
+    rParamF(phase, rDefault(0.0), "Phase offset"),
+    rParamI(shape, rDefault(0), "Shape index"),
+    rToggle(sync, rDefault(false), "Hard sync"),
+};
+#undef rObject
+
+#define rObject Voice
+const Ports Voice::ports = {
+    rParamF(volume, rLinear(0.0, 1.0), rDefault(0.5), "Volume"),
+    rParamI(detune, rLinear(-100, 100), rDefault(0), "Detune in cents"),
+    rToggle(enabled, rDefault(true), "Voice enable"),
+    rRecur(osc, "Oscillator"),
+};
+#undef rObject
+
+#define rObject Part
+const Ports Part::ports = {
+    rRecurs(voice, 8, "Voices"),
+    rParamF(gain, rLinear(0.0, 2.0), rDefault(1.0), "Gain"),
+    rParamI(channel, rDefault(0), "MIDI channel"),
+};
+#undef rObject
+
+#define rObject Master
+const Ports Master::ports = {
+    rRecurs(part, 16, "Parts"),
+    rParamF(volume, rDefault(0.8), "Master volume"),
+};
+#undef rObject
+
+static Master master;
+
+//some non-default values for the savefile
+static void change_values(Master &m)
+{
+    for(int p=0; p<16; p += 3) {
+        m.part[p].gain = 0.25f * (p % 4);
+        for(int v=0; v<8; v += 2) {
+            m.part[p].voice[v].volume    = 0.1f * v;
+            m.part[p].voice[v].detune    = v - 4;
+            m.part[p].voice[v].osc.shape = v % 3;
+        }
+    }
+}
+
+static void bench_messages(bench::Runner &r)
+{
+    char buffer[256];
+    r.run("message/rtosc_message", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            do_not_optimize(rtosc_message(buffer, sizeof(buffer),
+                    "/part3/voice5/osc/phase", "ifsT", (int)i, 0.5f, "sine"));
+        }
+    });
+
+    rtosc_arg_t args[4];
+    args[0].i = 42;
+    args[1].f = 0.5f;
+    args[2].s = "sine";
+    args[3].T = 1;
+    r.run("message/rtosc_amessage", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            args[0].i = i;
+            do_not_optimize(rtosc_amessage(buffer, sizeof(buffer),
+                    "/part3/voice5/osc/phase", "ifsT", args));
+        }
+    });
+
+    rtosc_message(buffer, sizeof(buffer), "/part3/voice5/osc/phase",
+                  "ifshd", 1, 2.0f, "three", (int64_t)4, 5.0);
+    r.run("argument/rtosc_argument", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            for(unsigned a=0; a<5; ++a)
+                do_not_optimize(rtosc_argument(buffer, a));
+        }
+    });
+
+    r.run("argument/rtosc_itr", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            rtosc_arg_itr_t itr = rtosc_itr_begin(buffer);
+            while(!rtosc_itr_end(itr))
+                do_not_optimize(rtosc_itr_next(&itr));
+        }
+    });
+}
+
+static void bench_dispatch(bench::Runner &r)
+{
+    char loc[256];
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+
+    const char *paths[] = {
+        "/volume", "/part3/gain", "/part7/voice2/volume",
+        "/part15/voice7/osc/phase", "/part0/voice0/enabled",
+        "/part9/voice4/osc/shape", "/part12/channel", "/part5/voice6/detune",
+    };
+    const char *types[] = {"f", "f", "f", "f", "T", "i", "i", "i"};
+    const int  npaths   = sizeof(paths)/sizeof(paths[0]);
+    char msgs[npaths][128];
+    for(int i=0; i<npaths; ++i) {
+        if(types[i][0] == 'f')
+            rtosc_message(msgs[i], 128, paths[i], "f", 0.5f);
+        else if(types[i][0] == 'i')
+            rtosc_message(msgs[i], 128, paths[i], "i", 1);
+        else
+            rtosc_message(msgs[i], 128, paths[i], "T");
+    }
+
+    auto dispatch_all = [&](uint64_t n, const char (*m)[128]) {
+        for(uint64_t i=0; i<n; ++i) {
+            const char *msg = m[i % npaths];
+            d.obj = &master;
+            Master::ports.dispatch(msg+1, d, true);
+        }
+    };
+
+    r.run("dispatch/flat", [&](uint64_t n) {
+        char msg[128];
+        rtosc_message(msg, sizeof(msg), "/volume", "f", 0.5f);
+        for(uint64_t i=0; i<n; ++i) {
+            d.obj = &master.part[0].voice[0];
+            Voice::ports.dispatch(msg+1, d, true);
+        }
+    });
+
+    r.run("dispatch/nested-rRecur", [&](uint64_t n) {
+        dispatch_all(n, msgs);
+    });
+
+    char deepest[128];
+    rtosc_message(deepest, sizeof(deepest), "/part15/voice7/osc/phase", "f",
+                  0.25f);
+    r.run("dispatch/nested-depth4", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            d.obj = &master;
+            Master::ports.dispatch(deepest+1, d, true);
+        }
+    });
+
+    char queries[npaths][128];
+    for(int i=0; i<npaths; ++i)
+        rtosc_message(queries[i], 128, paths[i], "");
+    r.run("dispatch/nested-query", [&](uint64_t n) {
+        dispatch_all(n, queries);
+    });
+}
+
+static void bench_thread_link(bench::Runner &r)
+{
+    ThreadLink link(128, 1024);
+    r.run("thread-link/write-read", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            link.write("/part0/voice0/volume", "f", 0.5f);
+            do_not_optimize(link.read());
+        }
+    });
+
+    r.run("thread-link/throughput", [&](uint64_t n) {
+        //ThreadLink drops messages if it is full, so keep it half full
+        std::atomic<uint64_t> received(0);
+        std::thread consumer([&] {
+            while(received < n) {
+                if(link.hasNext()) {
+                    do_not_optimize(link.read());
+                    ++received;
+                } else
+                    std::this_thread::yield();
+            }
+        });
+        for(uint64_t i=0; i<n; ++i) {
+            while(i - received >= 512)
+                std::this_thread::yield();
+            link.write("/part0/voice0/volume", "f", 0.5f);
+        }
+        consumer.join();
+    });
+}
+
+static void bench_pretty_format(bench::Runner &r)
+{
+    rtosc_arg_val_t av[8];
+    av[0].type = 'i'; av[0].val.i = 42;
+    av[1].type = 'f'; av[1].val.f = 0.125f;
+    av[2].type = 's'; av[2].val.s = "a string";
+    av[3].type = 'T'; av[3].val.T = 1;
+    av[4].type = 'h'; av[4].val.h = 1234567890123;
+    av[5].type = 'd'; av[5].val.d = 3.14159;
+    av[6].type = 'c'; av[6].val.i = 'x';
+    av[7].type = 'S'; av[7].val.s = "symbol";
+
+    char printed[512];
+    r.run("pretty-format/rtosc_print_arg_vals", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            do_not_optimize(rtosc_print_arg_vals(av, 8, printed,
+                                                 sizeof(printed), NULL, 0));
+    });
+
+    rtosc_print_arg_vals(av, 8, printed, sizeof(printed), NULL, 0);
+    rtosc_arg_val_t scanned[8];
+    char strbuf[256];
+    r.run("pretty-format/rtosc_scan_arg_vals", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            do_not_optimize(rtosc_scan_arg_vals(printed, scanned, 8,
+                                                strbuf, sizeof(strbuf)));
+    });
+}
+
+static void bench_savefile(bench::Runner &r)
+{
+    const rtosc_version appver = {0, 0, 1};
+    Master changed;
+    change_values(changed);
+
+    r.run("savefile/save_to_file", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            do_not_optimize(save_to_file(Master::ports, &changed,
+                                         "rtosc-bench", appver));
+    });
+
+    const std::string file = save_to_file(Master::ports, &changed,
+                                          "rtosc-bench", appver);
+    Master loaded;
+    r.run("savefile/load_from_file", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            do_not_optimize(load_from_file(file.c_str(), Master::ports,
+                                           &loaded, "rtosc-bench", appver));
+    });
+}
+
+static void bench_walk_ports(bench::Runner &r)
+{
+    char name[1024];
+    r.run("walk_ports/full-tree", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            unsigned count = 0;
+            walk_ports(&Master::ports, name, sizeof(name), &count,
+                       [](const Port*, const char*, const char*,
+                          const Ports&, void *data, void*) {
+                           ++*(unsigned*)data; });
+            do_not_optimize(count);
+        }
+    });
+
+    r.run("walk_ports/with-runtime", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            unsigned count = 0;
+            walk_ports(&Master::ports, name, sizeof(name), &count,
+                       [](const Port*, const char*, const char*,
+                          const Ports&, void *data, void*) {
+                           ++*(unsigned*)data; }, true, &master);
+            do_not_optimize(count);
+        }
+    });
+}
+
+/*
+ * MIDI mappings into the port tree: per channel (0..15), CCs 20..27 are
+ * bound to part<channel>/voice<cc-20>/volume, the NRPNs use the detune
+ * ports. Each iteration is one CC, dispatched into the tree.
+ */
+static void bench_midi(bench::Runner &r)
+{
+    char loc[256];
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    auto dispatch = [&d](const char *msg) {
+        d.obj = &master;
+        Master::ports.dispatch(msg+1, d, true);
+    };
+    static std::function<void(const char*)> table_dispatch;
+    table_dispatch = dispatch;
+
+    char path[64];
+    MidiTable table(Master::ports);
+    table.event_cb = [](const char *msg) { table_dispatch(msg); };
+    for(int ch=0; ch<16; ++ch)
+        for(int v=0; v<8; ++v) {
+            snprintf(path, sizeof(path), "/part%d/voice%d/volume", ch, v);
+            table.addElm(ch, 20+v, path);
+        }
+
+    // dense sweeps over all channels and controllers
+    r.run("midi/MidiTable-cc-sweep", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            table.process(i % 16, 20 + (i/16) % 8, i % 128);
+    });
+    r.latency("midi/MidiTable-cc-latency", [&](uint64_t i) {
+        table.process(i % 16, 20 + (i/16) % 8, i % 128);
+    }, 100000);
+
+    AutomationMgr mgr(128, 1, 16);
+    mgr.set_ports(Master::ports);
+    mgr.backend = dispatch;
+    for(int ch=0; ch<16; ++ch)
+        for(int v=0; v<8; ++v) {
+            const int slot = ch*8 + v;
+            snprintf(path, sizeof(path), "/part%d/voice%d/volume", ch, v);
+            mgr.createBinding(slot, path, false);
+            mgr.slots[slot].midi_cc = ch*128 + 20+v;
+        }
+    r.run("midi/AutomationMgr-cc-sweep", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            mgr.handleMidi(i % 16, 20 + (i/16) % 8, i % 128);
+    });
+    r.latency("midi/AutomationMgr-cc-latency", [&](uint64_t i) {
+        mgr.handleMidi(i % 16, 20 + (i/16) % 8, i % 128);
+    }, 100000);
+
+    // NRPN bursts: parameter number, then data entry MSB and LSB
+    AutomationMgr nrpn_mgr(16, 1, 16);
+    nrpn_mgr.set_ports(Master::ports);
+    nrpn_mgr.backend = dispatch;
+    for(int p=0; p<16; ++p) {
+        snprintf(path, sizeof(path), "/part%d/voice0/detune", p);
+        nrpn_mgr.createBinding(p, path, false);
+        nrpn_mgr.slots[p].midi_nrpn = p;
+    }
+    r.run("midi/AutomationMgr-nrpn-burst", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i) {
+            switch(i % 4) {
+                case 0: nrpn_mgr.handleMidi(0, C_nrpnhi, 0); break;
+                case 1: nrpn_mgr.handleMidi(0, C_nrpnlo, (i/4) % 16); break;
+                case 2: nrpn_mgr.handleMidi(0, C_dataentryhi, i % 128); break;
+                case 3: nrpn_mgr.handleMidi(0, C_dataentrylo, i % 128); break;
+            }
+        }
+    });
+
+    MidiMapperRT rt;
+    MidiMappernRT non_rt;
+    non_rt.rt_cb = [&rt](const char *msg) { rt.bind(msg); };
+    rt.setFrontendCb([&non_rt](const char *msg) { non_rt.reclaim(msg); });
+    rt.setBackendCb(dispatch);
+    const Port *volume = Voice::ports.apropos("volume");
+    non_rt.beginTransaction();
+    for(int id=0; id<128; ++id) {
+        snprintf(path, sizeof(path), "/part%d/voice%d/volume", id/8, id%8);
+        non_rt.addNewMapper(id, *volume, path);
+    }
+    non_rt.commitTransaction();
+    r.run("midi/MidiMapperRT-cc-sweep", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; ++i)
+            rt.handleCC(i % 128, i % 128);
+    });
+    r.latency("midi/MidiMapperRT-cc-latency", [&](uint64_t i) {
+        rt.handleCC(i % 128, i % 128);
+    }, 100000);
+
+    // one period with 4 CCs per mapped ID for 16 IDs
+    MidiEvent events[64];
+    for(int i=0; i<64; ++i)
+        events[i] = MidiEvent{(uint32_t)i, i % 16, i};
+    r.run("midi/MidiMapperRT-block-64", [&](uint64_t n) {
+        for(uint64_t i=0; i<n; i += 64)
+            rt.handleCCs(events, 64);
+    });
+}
+
+int main(int argc, char **argv)
+{
+    bench::Runner r(argc, argv);
+
+    bench_messages(r);
+    bench_dispatch(r);
+    bench_thread_link(r);
+    bench_pretty_format(r);
+    bench_savefile(r);
+    bench_walk_ports(r);
+    bench_midi(r);
+
+    char version[12];
+    rtosc_version v = rtosc_current_version();
+    rtosc_version_print_to_12byte_str(&v, version);
+    return r.finish(version);
+}
@@ -0,0 +1,79 @@
+//Memory footprint of a large port tree, see port-memory.h
+//
+//The tree has 16 parts of 8 voices, each voice has --params parameters, so
+//the default makes about 100k ports. Half of the callbacks capture a value,
+//like callbacks written as lambdas do. Applications print the report of
+//their own trees with PortMemoryReport::print().
+//
+//Options:
+// --params=<n>   parameters per voice (default: 780)
+// --depth=<n>    only print subtrees up to this depth
+// --min=<bytes>  only print subtrees with at least this many bytes
+// --lazy         do not build the tables first
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <rtosc/ports.h>
+#include <rtosc/port-memory.h>
+
+using namespace rtosc;
+
+static const char param_meta[] =
+    ":parameter\0:default\0=0.5\0:min\0=0\0:max\0=1\0"
+    ":documentation\0=A parameter of the voice\0";
+
+static void param_cb(const char *, RtData &) {}
+
+int main(int argc, char **argv)
+{
+    unsigned params = 780, depth = ~0u;
+    std::size_t min_bytes = 0;
+    bool lazy = false;
+    for(int i = 1; i < argc; ++i) {
+        if(!strncmp(argv[i], "--params=", 9))
+            params = atoi(argv[i] + 9);
+        else if(!strncmp(argv[i], "--depth=", 8))
+            depth = atoi(argv[i] + 8);
+        else if(!strncmp(argv[i], "--min=", 6))
+            min_bytes = atol(argv[i] + 6);
+        else if(!strcmp(argv[i], "--lazy"))
+            lazy = true;
+        else {
+            fprintf(stderr, "usage: %s [--params=<n>] [--depth=<n>] "
+                            "[--min=<bytes>] [--lazy]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    //the tables are built on first use, so the ports can be added here
+    std::vector<std::string> names(params);
+    Ports voice = {};
+    voice.ports.reserve(params);
+    for(unsigned i = 0; i < params; ++i) {
+        names[i] = "param" + std::to_string(i) + "::f";
+        if(i % 2)
+            voice.ports.push_back({names[i].c_str(), param_meta, NULL,
+                                   param_cb});
+        else
+            voice.ports.push_back({names[i].c_str(), param_meta, NULL,
+                                   [i](const char *, RtData &) { (void)i; }});
+    }
+    Ports part = {
+        {"voice#8/", ":documentation\0=Voices\0", &voice, param_cb},
+        {"gain::f", param_meta, NULL, param_cb},
+    };
+    Ports master = {
+        {"part#16/", ":documentation\0=Parts\0", &part, param_cb},
+        {"volume::f", param_meta, NULL, param_cb},
+    };
+
+    if(!lazy)
+        master.prepare();
+    PortMemoryReport(master).print(std::cout, depth, min_bytes);
+    return 0;
+}
@@ -1,6 +1,37 @@
+#include <algorithm>
 #include "Echo.h"
 #include "util.h"
 
 rtosc::Ports Echo::ports = {
     PARAM(Echo, time, time, log, 1e-3, 10, "Delay of echo")
 };
+
+//the history is allocated once, for the longest delay
+Echo::Echo(float srate)
+    :history(10 * srate + block_size)
+{}
+
+void Echo::process(float *smps, unsigned n, float srate)
+{
+    const unsigned size  = history.size();
+    const unsigned delay = std::max(1u, std::min(size - 1,
+                                                 (unsigned)(time * srate)));
+    const float    fb    = feedback;
+
+    //split the block where the ring buffer wraps, and into pieces no longer
+    //than the delay, so each piece reads samples it does not write, and the
+    //inner loop has no dependency between samples
+    for(unsigned done = 0; done < n; ) {
+        const unsigned rd  = (pos + size - delay) % size;
+        const unsigned len = std::min({n - done, delay, size - pos, size - rd});
+        const float *src = history.data() + rd;
+        float       *dst = history.data() + pos;
+        float       *out = smps + done;
+        for(unsigned i = 0; i < len; ++i) {
+            out[i] += fb * src[i];
+            dst[i]  = out[i];
+        }
+        pos   = (pos + len) % size;
+        done += len;
+    }
+}
@@ -1,7 +1,16 @@
+#include <vector>
 #include "Effect.h"
 
 struct Echo : public Effect
 {
-    float time;//sec
+    //! @param srate Highest sample rate the echo will be used with
+    explicit Echo(float srate = 48000);
+    float time = 0.3;//sec
+    float feedback = 0.5;
+    void process(float *smps, unsigned n, float srate) override;
     static rtosc::Ports ports;
+
+    private:
+        std::vector<float> history;//ring buffer of the output
+        unsigned pos = 0;//next sample to write
 };
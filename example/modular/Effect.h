@@ -1,7 +1,13 @@
 #pragma once
 namespace rtosc{struct Ports;}
 
+//! Samples per block. Parameters set through the ports are read once per
+//! block, so they change between blocks, not between samples.
+constexpr unsigned block_size = 64;
+
 struct Effect
 {
     virtual ~Effect(void){};
+    //! Process @p n (at most block_size) samples in place
+    virtual void process(float *smps, unsigned n, float srate) = 0;
 };
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <rtosc/ports.h>
 #include "LFO.h"
 #include "util.h"
@@ -7,3 +8,22 @@ using namespace rtosc;
 Ports LFO::ports = {
     PARAM(LFO, freq, freq, log, 1e-3, 10, "frequency"),
 };
+
+static float lfo_gain(float phase)
+{
+    return 0.5f + 0.5f * std::sin(2.0f * (float)M_PI * phase);
+}
+
+void LFO::process(float *smps, unsigned n, float srate)
+{
+    if(!n)
+        return;
+    //the LFO is slow, so it is only evaluated at the block boundaries, and
+    //interpolated in between
+    const float start = lfo_gain(phase);
+    phase += freq * n / srate;
+    phase -= (int)phase;
+    const float step = (lfo_gain(phase) - start) / n;
+    for(unsigned i = 0; i < n; ++i)
+        smps[i] *= start + step * (i + 1);
+}
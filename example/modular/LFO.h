@@ -2,6 +2,9 @@
 
 struct LFO : public Effect
 {
-    float freq;//Hz
+    float freq = 1;//Hz
+    float phase = 0;
+    //! Amplitude modulation
+    void process(float *smps, unsigned n, float srate) override;
     static rtosc::Ports ports;
 };
@@ -1,7 +1,36 @@
 #include "Oscil.h"
+#include "Effect.h"
 #include "util.h"
 
 rtosc::Ports Oscillator::ports = {
     PARAM(Oscillator, freq, freq, log, 0.01, 1e3, "frequency")
 };
 
+//parabolic approximation of sin(2*pi*phase) without branches, so loops
+//calling it can be vectorized
+static inline float fast_sin(float phase)
+{
+    const float x   = 1.0f - 2.0f * phase;//sin(2*pi*phase) == sin(pi*x)
+    const float ax  = x < 0 ? -x : x;
+    const float y   = 4.0f * x * (1.0f - ax);
+    const float ay  = y < 0 ? -y : y;
+    return 0.225f * (y * ay - y) + y;
+}
+
+void Oscillator::render(float *out, unsigned n, float srate)
+{
+    //the parameter is read once, it may change between blocks
+    const float inc = freq / srate;
+
+    //phases first, then the waveform, both loops are independent of each
+    //sample's predecessor
+    float phases[block_size];
+    for(unsigned i = 0; i < n; ++i) {
+        const float p = phase + inc * (i + 1);
+        phases[i] = p - (int)p;
+    }
+    for(unsigned i = 0; i < n; ++i)
+        out[i] = fast_sin(phases[i]);
+    if(n)
+        phase = phases[n - 1];
+}
@@ -3,6 +3,9 @@ namespace rtosc{struct Ports;};
 
 struct Oscillator
 {
-    float freq;
+    float freq = 440;
+    float phase = 0;//periods, in [0,1)
+    //! Render @p n (at most block_size) samples into @p out
+    void render(float *out, unsigned n, float srate);
     static rtosc::Ports ports;
 };
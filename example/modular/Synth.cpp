@@ -1,5 +1,7 @@
+#include <algorithm>
 #include "Synth.h"
 #include "EffectMgr.h"
+#include "Effect.h"
 #include "util.h"
 #include <rtosc/ports.h>
 using namespace rtosc;
@@ -10,3 +12,22 @@ Ports Synth::ports = {
     RECURS(Synth, EffectMgr, effect, effects, 8)
 
 };
+
+void Synth::process(float *out, unsigned n)
+{
+    for(unsigned done = 0; done < n; done += block_size) {
+        const unsigned len = std::min(n - done, block_size);
+        float *block = out + done;
+
+        oscil.render(block, len, srate);
+        for(EffectMgr &e : effects)
+            if(e.eff)
+                e.eff->process(block, len, srate);
+
+        //ramp volume changes over the block to avoid clicks
+        const float step = (volume - last_volume) / len;
+        for(unsigned i = 0; i < len; ++i)
+            block[i] *= last_volume + step * (i + 1);
+        last_volume = volume;
+    }
+}
@@ -3,8 +3,15 @@
 
 struct Synth
 {
-    float volume;
+    float volume = 1;
+    float srate  = 48000;
     Oscillator oscil;
     EffectMgr effects[8];
+
+    //! Render @p n samples into @p out, in blocks of block_size
+    void process(float *out, unsigned n);
     static rtosc::Ports ports;
+
+    private:
+        float last_volume = 1;//volume of the previous block
 };
@@ -1,5 +1,7 @@
 #include "Synth.h"
 #include "Echo.h"
+#include "LFO.h"
+#include <chrono>
 #include <stdio.h>
 #include <rtosc/rtosc.h>
 #include <rtosc/ports.h>
@@ -42,5 +44,25 @@ int main()
     printf("synth.volume                = %f\n", synth.volume);
     printf("synth.effects[2].echo->time = %f\n", synth.effects[2].echo->time);
 
+    //benchmark: render 10 seconds, changing parameters through the ports
+    //between the blocks, like automations or a UI would
+    synth.effects[3].eff = new LFO();
+    const unsigned frames = 10 * synth.srate;
+    float block[block_size];
+    float sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(unsigned done = 0; done < frames; done += block_size) {
+        rtosc_message(buffer,100,"oscil/freq","f", 440.0f + (done >> 12) % 64);
+        Synth::ports.dispatch(buffer, d);
+        synth.process(block, block_size);
+        sum += block[0];
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    //the synth has one voice, its oscillator
+    printf("CPU load per voice          = %f%% (checksum %f)\n",
+           100.0 * elapsed.count() * synth.srate / frames, sum);
+
     return 0;
 }
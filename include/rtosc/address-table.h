@@ -0,0 +1,100 @@
+/**
+ * @file address-table.h
+ * Integer IDs for addresses, to send compact messages
+ *
+ * @test address-table.cpp
+ */
+
+#ifndef RTOSC_ADDRESS_TABLE_H
+#define RTOSC_ADDRESS_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * Table of interned addresses
+ *
+ * Each address gets an integer ID. A compact message carries the address
+ * "/#<id>" instead of the full address, followed by the original type tags
+ * and arguments, so deep addresses do not cost more bytes than their
+ * arguments.
+ *
+ * Sender and receiver build the same table, usually from the same port tree,
+ * and compare checksum() to agree on the IDs before using compact messages.
+ * The table can also be queried over OSC by mounting addressTablePort()
+ * (or AddressTable::ports, with d.obj pointing to the table).
+ *
+ * Only building the table allocates. Lookups, compress(), expand() and
+ * dispatch() can be used from realtime threads.
+ */
+class AddressTable
+{
+    public:
+        AddressTable(void);
+        /**
+         * Intern the addresses of all (non pattern) leaf ports of @p root,
+         * in the order of walk_ports()
+         */
+        explicit AddressTable(const Ports &root);
+
+        //! Intern @p path, @returns its ID
+        unsigned add(const char *path);
+        //! @returns the ID of @p path, or -1 if it is not interned
+        int id(const char *path) const;
+        //! @returns the address of @p id, or NULL if it is unknown
+        const char *path(unsigned id) const;
+        size_t size(void) const { return paths.size(); }
+
+        //! Hash over all addresses in ID order, to compare tables
+        uint32_t checksum(void) const { return sum; }
+
+        //! @returns the ID of a compact message, or -1 for full messages
+        static int compact_id(const char *msg);
+
+        /**
+         * Write the compact form of @p msg, @p buffer may be @p msg
+         * @returns the length of the compact message, or 0 if the address is
+         *          not interned or the buffer is too small
+         */
+        size_t compress(const char *msg, char *buffer, size_t len) const;
+
+        /**
+         * Write the full form of the compact message @p msg, @p buffer may
+         * be @p msg
+         * @returns the length of the full message, or 0 if the ID is unknown
+         *          or the buffer is too small
+         */
+        size_t expand(const char *msg, char *buffer, size_t len) const;
+
+        /**
+         * Base dispatch of a compact or full message
+         *
+         * The ID is resolved in constant time, without matching any port
+         * names. With a @p cache, repeated IDs call their leaf ports directly.
+         * @returns false if @p msg is a compact message with an unknown ID
+         */
+        bool dispatch(const Ports &root, const char *msg, RtData &d,
+                      DispatchCache *cache = NULL) const;
+
+        //! Maximum length of an expanded message in dispatch()
+        enum { max_message = 1024 };
+
+        static const Ports ports;
+        //! Port "address-table/" exporting this table
+        Port addressTablePort(void);
+
+    private:
+        void rehash(size_t slots);
+
+        std::vector<std::string> paths;
+        std::vector<int>         table; //!< open addressing, -1 for free
+        uint32_t                 sum;
+};
+
+}
+
+#endif
@@ -32,6 +32,7 @@
 #ifndef ARG_VAL_CMP
 #define ARG_VAL_CMP
 
+#include <stdint.h>
 #include <rtosc/rtosc.h>
 
 #ifdef __cplusplus
@@ -83,6 +84,42 @@ int rtosc_arg_vals_cmp(const rtosc_arg_val_t *lhs, const rtosc_arg_val_t *rhs,
                        size_t lsize, size_t rsize,
                        const rtosc_cmp_options* opt);
 
+/**
+ * Hash an array of rtosc_arg_val_t
+ *
+ * Ranges are hashed like the values they expand to, so arrays which are
+ * equal for rtosc_arg_vals_eq() without float tolerance have equal hashes,
+ * unless they contain infinite ranges. Comparing a stored hash first tells
+ * if values have changed without keeping a copy of the old values, and
+ * only equal hashes require rtosc_arg_vals_eq().
+ *
+ * @param size Array size of @p av, e.g. 3 for just one counting range
+ */
+uint64_t rtosc_arg_vals_hash(const rtosc_arg_val_t *av, size_t size);
+
+/**
+ * Hash an OSC message, i.e. its address and its arguments
+ *
+ * The arguments are hashed like by rtosc_arg_vals_hash(), so a message has
+ * the same hash as rtosc_avmessage_hash() of its address and argument values,
+ * which allows storing the hash of either representation. Hashes depend on
+ * the byte order, but not on the process, so they can be stored.
+ */
+uint64_t rtosc_message_hash(const char *msg);
+
+/**
+ * Hash a message given as address and argument values
+ *
+ * This equals rtosc_message_hash() of a message with the address and the
+ * argument values. Ranges are hashed like the values they expand to, and
+ * arrays like the brackets of a message.
+ */
+uint64_t rtosc_avmessage_hash(const char *address,
+                              const rtosc_arg_val_t *args, size_t nargs);
+
+//! Combine a hash @p h with another hash @p value, e.g. of a subtree
+uint64_t rtosc_hash_combine(uint64_t h, uint64_t value);
+
 #ifdef __cplusplus
 };
 #endif
@@ -30,7 +30,8 @@
  *
  * @note Chaining these functions can be inefficient: a+b+c involves (at least)
  *   two switch statements about the types, though one would suffice.
- *   Use these functions if runtime is not too critical.
+ *   Use these functions if runtime is not too critical, and the bulk
+ *   functions for arrays.
  * @test arg-val-math.c
  */
 
@@ -62,6 +63,83 @@ int rtosc_arg_val_to_int(const rtosc_arg_val_t *av, int* res);
 rtosc_arg_val_t *rtosc_arg_val_range_arg(const rtosc_arg_val_t* range_arg,
                                          int ith, rtosc_arg_val_t *result);
 
+/**
+ * Calculate @p n consecutive arguments of a range with delta
+ *
+ * The results are the same as calling rtosc_arg_val_range_arg() for
+ * @p first, @p first + 1 and so on, but the type switch is only done once
+ * for all arguments.
+ * @param range_arg The range arg, which must have a delta
+ * @param first Index of the first argument to calculate
+ * @param n How many arguments to calculate
+ * @param result Array of size @p n to store the arguments
+ */
+void rtosc_arg_val_range_args(const rtosc_arg_val_t* range_arg,
+                              int first, size_t n, rtosc_arg_val_t *result);
+
+/*
+ * bulk functions for arrays of arg values
+ *
+ * They compute the same results as the functions above, element by element,
+ * but the type switch is only done once for each run of values of the same
+ * type. Ranges and arrays ('-' and 'a') are not supported. @p res may be
+ * equal to @p lhs or @p rhs, but must not overlap them otherwise.
+ * All functions return false if any element could not be computed.
+ */
+int rtosc_arg_vals_add(const rtosc_arg_val_t *lhs, const rtosc_arg_val_t *rhs,
+                       size_t n, rtosc_arg_val_t *res);
+int rtosc_arg_vals_sub(const rtosc_arg_val_t *lhs, const rtosc_arg_val_t *rhs,
+                       size_t n, rtosc_arg_val_t *res);
+int rtosc_arg_vals_mult(const rtosc_arg_val_t *lhs, const rtosc_arg_val_t *rhs,
+                        size_t n, rtosc_arg_val_t *res);
+int rtosc_arg_vals_round(rtosc_arg_val_t *av, size_t n);
+
+/**
+ * Scale @p n values in place, e.g. for automations: av = av * mult + add
+ *
+ * Floats are computed in float precision, integers are converted back like
+ * with rtosc_arg_val_from_double(). 'T' and 'F' become true if the result
+ * is not zero.
+ */
+int rtosc_arg_vals_scale(rtosc_arg_val_t *av, size_t n,
+                         double mult, double add);
+
+/**
+ * Interpolate between two arrays, e.g. for morphing presets:
+ * res = from + (to - from) * t
+ *
+ * Numbers are interpolated, and converted back like with
+ * rtosc_arg_val_from_double(). All other values, like strings, 'T' and 'F',
+ * are those of @p from for t < 0.5, and those of @p to otherwise.
+ * @return false if the types of @p from and @p to differ (except for 'T'
+ *         and 'F')
+ */
+int rtosc_arg_vals_lerp(const rtosc_arg_val_t *from, const rtosc_arg_val_t *to,
+                        size_t n, double t, rtosc_arg_val_t *res);
+
+/*
+ * bulk functions for packed values, e.g. read by rtosc_argument_run()
+ *
+ * These are simple loops over contiguous arrays, which compilers can
+ * vectorize. @p res may be equal to the inputs, but must not overlap them
+ * otherwise.
+ */
+void rtosc_floats_add(const float *lhs, const float *rhs, size_t n,
+                      float *res);
+void rtosc_floats_scale(float *v, size_t n, float mult, float add);
+void rtosc_floats_clamp(float *v, size_t n, float min, float max);
+void rtosc_floats_lerp(const float *from, const float *to, size_t n,
+                       float t, float *res);
+
+void rtosc_ints_add(const int32_t *lhs, const int32_t *rhs, size_t n,
+                    int32_t *res);
+//! Scale in float precision, and truncate like a cast to int32_t
+void rtosc_ints_scale(int32_t *v, size_t n, float mult, float add);
+void rtosc_ints_clamp(int32_t *v, size_t n, int32_t min, int32_t max);
+//! Interpolate in float precision, and truncate like a cast to int32_t
+void rtosc_ints_lerp(const int32_t *from, const int32_t *to, size_t n,
+                     float t, int32_t *res);
+
 #ifdef __cplusplus
 };
 #endif
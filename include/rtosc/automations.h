@@ -1,5 +1,6 @@
 #include <rtosc/ports.h>
 #include <rtosc/rtosc.h>
+#include <rtosc/midi-decoder.h>
 #include <cassert>
 namespace rtosc {
     
@@ -45,6 +46,12 @@ struct Automation
     float       param_max;
     float       param_step;       //resolution of parameter. Useful for:
                                   //- integer valued controls
+
+    //Preencoded message to param_path, only the argument is patched when
+    //the slot changes (for 'T', the type tag is patched)
+    char        param_msg[136];
+    int         param_msg_len;
+    int         param_arg_offset;
     AutomationMapping map;
 };
 
@@ -93,6 +100,27 @@ class AutomationMgr
          */
         void createBinding(int slot, const char *path, bool start_midi_learn);
 
+        /**
+         * Create an Automation binding from a non-realtime thread
+         *
+         * The port is looked up and the binding is built here, like in
+         * createBinding(), and then passed through a lock-free queue.
+         * The realtime side installs it with applyQueued(), which only
+         * copies the built binding into a free automation of the slot.
+         * One thread may queue while another one handles MIDI.
+         * @return false if the port cannot be bound or the queue is full
+         */
+        bool queueBinding(int slot, const char *path, bool start_midi_learn);
+        //! Start a MIDI learn for @p slot from a non-realtime thread
+        bool queueLearn(int slot);
+        /**
+         * Install the queued bindings and learn requests
+         *
+         * This is realtime safe and called by handleMidi() and process().
+         * @return The number of requests applied
+         */
+        int applyQueued(void);
+
         void updateMapping(int slot, int sub);
 
 
@@ -102,6 +130,40 @@ class AutomationMgr
         void setSlotSub(int slot_id, int sub, float value);
         float getSlot(int slot_id);
 
+        /**
+         * Set a slot value which is applied by the next process() call
+         *
+         * Unlike setSlot(), nothing is sent immediately, so many changes
+         * per block only cost one evaluation per binding.
+         */
+        void queueSlot(int slot_id, float value);
+
+        /**
+         * Evaluate the mapping curves of all queued slots for one block
+         *
+         * Messages are only sent to the backend for values which changed
+         * since they were sent last. If ramp_backend is set, float
+         * parameters get a linear ramp of @p nframes values to the new
+         * value instead.
+         */
+        void process(int nframes);
+
+        /**
+         * Smooth queued values of a slot
+         *
+         * Values passed to queueSlot() are then reached in a linear ramp
+         * over @p frames frames, starting at the current value. 0 turns
+         * smoothing off. setSlot() always jumps to the value.
+         */
+        void setSlotSmoothing(int slot_id, int frames);
+        /**
+         * Split process() calls into sub blocks of @p frames frames
+         *
+         * Smoothed slots are evaluated once per sub block, so ramps are
+         * sent at this rate. 0 means one evaluation per process() call.
+         */
+        void setSubBlock(int frames);
+
         void clearSlot(int slot_id);
         void clearSlotSub(int slot_id, int sub);
 
@@ -139,14 +201,17 @@ class AutomationMgr
         void *instance;
 
         std::function<void(const char *)> backend;
+        //! receives per sample values of float parameters in process()
+        std::function<void(const char *path, const float *ramp,
+                           int nframes)> ramp_backend;
 
         int damaged;
     private:
-    
+        void evaluate(int nframes);
+        void bind(int slot, const Automation &built, bool start_midi_learn);
+        void learn(int slot);
+
         /** RPN and NPRPN */
-        struct { //nrpn
-            int parhi, parlo;
-            int valhi, vallo;
-        } NRPN;
+        MidiDecoder midi;
 };
 };
@@ -0,0 +1,146 @@
+/**
+ * @file broadcaster.h
+ * Fan-out of broadcasts to many subscribers, serializing each message once
+ *
+ * @test broadcaster.cpp
+ */
+
+#ifndef RTOSC_BROADCASTER_H
+#define RTOSC_BROADCASTER_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <functional>
+#include <rtosc/ports.h>
+#include <rtosc/subscriptions.h>
+
+namespace rtosc {
+
+class ThreadLink;
+
+/**
+ * Reference counted, immutable OSC message
+ *
+ * Copying a MessageRef only copies the reference, so all subscribers of a
+ * broadcast share one buffer. The reference count is atomic, so references
+ * can be passed to other threads. Creating a message allocates.
+ */
+class MessageRef
+{
+    public:
+        MessageRef(void) : ptr(nullptr) {}
+        MessageRef(const MessageRef &other);
+        MessageRef(MessageRef &&other) : ptr(other.ptr) { other.ptr = nullptr; }
+        MessageRef &operator=(MessageRef other);
+        ~MessageRef(void);
+
+        //! Copy a message or bundle of @p len bytes
+        static MessageRef copy(const char *msg, size_t len);
+        //! Copy a message, @see rtosc_message_length()
+        static MessageRef copy(const char *msg);
+        //! Serialize a message directly into a new buffer
+        static MessageRef format(const char *path, const char *args, ...);
+        static MessageRef vformat(const char *path, const char *args,
+                                  va_list va);
+        static MessageRef formatArray(const char *path, const char *args,
+                                      const rtosc_arg_t *vals);
+
+        explicit operator bool(void) const { return ptr; }
+        const char *data(void) const;
+        size_t size(void) const;
+        //! Number of references to the message, 0 for an empty reference
+        unsigned use_count(void) const;
+
+    private:
+        static MessageRef allocate(size_t len);
+        struct shared_message_t *ptr;
+};
+
+/**
+ * Sends each broadcast once to each subscriber, e.g. to UI clients
+ *
+ * Broadcasts are collected until flush(), which is meant to be called once
+ * per tick: each subscriber then gets all messages of the tick with one
+ * call. A message which is broadcast again within the same tick, with the
+ * same bytes, is only sent once. Each message is serialized once, and all
+ * subscribers get references to the same buffer, so a subscriber only
+ * copies if its destination requires it, e.g. a ThreadLink.
+ *
+ * Subscribers can restrict the addresses they get with filters, see
+ * Subscriptions. Subscribers without filters get all messages, bundles are
+ * passed to all subscribers.
+ *
+ * This is meant for the non-realtime side, and not thread safe.
+ */
+class Broadcaster
+{
+    public:
+        //! Subscriber, receiving the messages of one tick in broadcast order
+        typedef std::function<void(const MessageRef *msgs, size_t n)> sink_t;
+
+        Broadcaster(void);
+        ~Broadcaster(void);
+        Broadcaster(const Broadcaster&) = delete;
+
+        //! @return an ID for unsubscribe()
+        int subscribe(sink_t sink);
+        void unsubscribe(int id);
+        size_t subscribers(void) const;
+
+        /**
+         * Only pass messages matching @p filter (or any other filter) to
+         * subscriber @p id
+         * @return false if the filter is invalid
+         * @see Subscriptions::add()
+         */
+        bool add_filter(int id, const char *filter);
+        void remove_filter(int id, const char *filter);
+        /**
+         * Whether subscriber @p id is interested in @p address, e.g. to
+         * decide if a reply is passed to it
+         */
+        bool wants(int id, const char *address);
+
+        void broadcast(const MessageRef &msg);
+        void broadcast(const char *msg);
+        void broadcast(const char *path, const char *args, ...);
+
+        /**
+         * Pass all messages of this tick to all subscribers
+         * @return The number of distinct messages
+         */
+        size_t flush(void);
+        //! Number of messages waiting for flush()
+        size_t pending(void) const;
+        //! Number of broadcasts which have been merged into earlier ones
+        size_t merged(void) const;
+
+        //! Subscriber writing all messages to @p link
+        static sink_t link_sink(ThreadLink &link);
+
+    private:
+        struct internal_broadcaster_t *impl;
+};
+
+/**
+ * RtData passing all broadcasts to a Broadcaster
+ *
+ * Broadcasts of a dispatch are serialized once, directly into their shared
+ * buffer. Replies are passed to RtData, i.e. ignored, unless reply() is
+ * overridden.
+ */
+struct BroadcastData : public RtData
+{
+    explicit BroadcastData(Broadcaster &b) : broadcaster(b) {}
+
+    void broadcast(const char *path, const char *args, ...) override;
+    void broadcast(const char *msg) override;
+    void broadcastArray(const char *path, const char *args,
+                        rtosc_arg_t *vals) override;
+
+    Broadcaster &broadcaster;
+};
+
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include <cctype>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include "ports.h"
 
 namespace rtosc {
@@ -89,6 +90,202 @@ void bundle_foreach(const struct Port& p, const char* name, char* old_end,
         *pos2 = 0;
 }
 
+/**
+ * Execute a callback for each index of a bundle port, without names
+ *
+ * Unlike bundle_foreach(), no name is formatted, @p ftor is called as
+ * ftor(index) for each index of @p p, whose name must contain a '#'.
+ */
+template<class F>
+void bundle_foreach_index(const struct Port& p, const F& ftor)
+{
+    const unsigned max = atoi(strchr(p.name, '#') + 1);
+    for(unsigned i=0; i<max; ++i)
+        ftor(i);
+}
+
+/**
+ * Port found by walk_port_elements(), with the indices of its path
+ *
+ * The path to the port is not formatted. name() formats it, like it would
+ * be passed to a port_walker_t by walk_ports().
+ */
+struct port_element_t
+{
+    enum { max_depth = 32 };        //!< deeper subtrees are not walked
+
+    const Port *const *path;        //!< ports from the root to the element
+    const unsigned    *indices;     //!< index of each port in @p path,
+                                    //!< 0 for ports without '#'
+    std::size_t        depth;       //!< number of ports in @p path
+    const Ports       *base;        //!< Ports containing port()
+
+    const Port &port(void) const { return *path[depth-1]; }
+    //! Index of the element in its innermost array port, 0 if none
+    unsigned index(void) const { return indices[depth-1]; }
+
+    /**
+     * Format the absolute path, e.g. "/voice3/osc/freq"
+     * @return The length of the path, 0 if it did not fit into @p len
+     */
+    std::size_t name(char *buffer, std::size_t len) const
+    {
+        std::size_t pos = 0;
+        if(len < 2)
+            return 0;
+        buffer[pos++] = '/';
+        for(std::size_t d = 0; d < depth; ++d)
+        {
+            const char *n = path[d]->name;
+            for(; *n && *n != ':'; ++n)
+            {
+                if(*n == '#')
+                {
+                    char num[16];
+                    const int nlen = snprintf(num, sizeof(num), "%u",
+                                              indices[d]);
+                    if(pos + nlen >= len)
+                        return 0;
+                    memcpy(buffer + pos, num, nlen);
+                    pos += nlen;
+                    while(isdigit(n[1]))
+                        ++n;
+                }
+                else if(pos + 1 >= len)
+                    return 0;
+                else
+                    buffer[pos++] = *n;
+            }
+        }
+        buffer[pos] = 0;
+        return pos;
+    }
+};
+
+//! State of walk_port_elements()
+template<class F>
+struct port_element_walk_t
+{
+    const Port *path[port_element_t::max_depth];
+    unsigned    indices[port_element_t::max_depth];
+    const F    &ftor;
+
+    void walk(const Ports &base, std::size_t depth)
+    {
+        if(depth >= port_element_t::max_depth)
+            return;
+        for(const Port &p : base)
+        {
+            path[depth] = &p;
+            indices[depth] = 0;
+            const bool array = strchr(p.name, '#');
+            if(p.ports) {
+                if(array)
+                    bundle_foreach_index(p, [&](unsigned i) {
+                        indices[depth] = i;
+                        walk(*p.ports, depth + 1);
+                    });
+                else
+                    walk(*p.ports, depth + 1);
+            } else {
+                const port_element_t e{path, indices, depth + 1, &base};
+                if(array)
+                    bundle_foreach_index(p, [&](unsigned i) {
+                        indices[depth] = i;
+                        ftor(e);
+                    });
+                else
+                    ftor(e);
+            }
+        }
+    }
+};
+
+/**
+ * Call @p ftor for each leaf port element of @p base, with indices only
+ *
+ * This visits the same ports as walk_ports() with expanded bundles, in the
+ * same order, but without formatting or parsing any path, which saves most
+ * of the walk's time for large arrays. @p ftor is called as
+ * ftor(const port_element_t&) and may call port_element_t::name() for the
+ * elements which need their paths. Runtime information, like disabled
+ * subtrees, is not taken into account.
+ */
+template<class F>
+void walk_port_elements(const Ports& base, const F& ftor)
+{
+    port_element_walk_t<F> w{{}, {}, ftor};
+    w.walk(base, 0);
+}
+
+//! Element of an OSC bundle, pointing into the bundle
+struct bundle_element_t
+{
+    const char *msg;
+    size_t      len;
+};
+
+/**
+ * Range over the elements of an OSC bundle, walking it only once
+ *
+ * @code
+ *     for(bundle_element_t e : BundleRange(bundle, len))
+ *         handle(e.msg, e.len);
+ * @endcode
+ *
+ * Use rtosc_bundle_index() if random access is required, and
+ * rtosc_bundle_walk() to descend into nested bundles.
+ */
+class BundleRange
+{
+    public:
+        class iterator
+        {
+            public:
+                iterator() : done(true) {}
+                explicit iterator(rtosc_bundle_itr_t itr)
+                    : itr(itr), done(false) { ++*this; }
+
+                const bundle_element_t &operator*() const { return cur; }
+                const bundle_element_t *operator->() const { return &cur; }
+                iterator &operator++()
+                {
+                    done = done || rtosc_bundle_itr_end(itr);
+                    if(!done)
+                        cur.msg = rtosc_bundle_itr_next(&itr, &cur.len);
+                    return *this;
+                }
+                bool operator==(const iterator &other) const
+                {
+                    return done ? other.done
+                                : !other.done && cur.msg == other.cur.msg;
+                }
+                bool operator!=(const iterator &other) const
+                {
+                    return !(*this == other);
+                }
+
+            private:
+                rtosc_bundle_itr_t itr;
+                bundle_element_t   cur;
+                bool               done;
+        };
+
+        //! @param len Upper bound on the length of the bundle
+        BundleRange(const char *bundle, size_t len = (size_t)-1)
+            : bundle(bundle), len(len) {}
+
+        iterator begin() const
+        {
+            return iterator(rtosc_bundle_itr_begin(bundle, len));
+        }
+        iterator end() const { return iterator(); }
+
+    private:
+        const char *bundle;
+        size_t      len;
+};
+
 // use this function if you don't want to do anything in bundle_foreach
 // (useful to create paths if cut_afterwards is true)
 inline void bundle_foreach_do_nothing(const Port*, const char*, const char*,
@@ -0,0 +1,110 @@
+/**
+ * @file bundle-scheduler.h
+ * Queue releasing bundled messages at their timetags, sample accurately
+ *
+ * @test bundle-scheduler.cpp
+ */
+
+#ifndef RTOSC_BUNDLE_SCHEDULER_H
+#define RTOSC_BUNDLE_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <rtosc/rtosc-time.h>
+
+namespace rtosc {
+
+class ThreadLink;
+
+/**
+ * Priority queue of messages, keyed by the timetags of their bundles
+ *
+ * Bundles (or plain messages, which are due immediately) are split into
+ * their messages, which are stored in preallocated slots. The audio thread
+ * then processes one block at a time:
+ *
+ * @code
+ *     sched.schedule_from(link);
+ *     sched.begin_block(block_start, nframes, sample_rate);
+ *     unsigned offset;
+ *     while(const char *msg = sched.next(&offset))
+ *         dispatch_at_frame(msg, offset);
+ * @endcode
+ *
+ * Messages due in the block come in timetag order (and in arrival order for
+ * equal timetags), late and immediate messages get offset 0. Timetags are
+ * NTP timestamps (32.32 fixed point seconds). Only the constructor
+ * allocates, and the scheduler is not thread safe.
+ */
+class BundleScheduler
+{
+    public:
+        /**
+         * @param max_messages Number of messages that can be queued
+         * @param max_message_length Maximum length of a single message
+         */
+        BundleScheduler(size_t max_messages, size_t max_message_length);
+        ~BundleScheduler(void);
+        BundleScheduler(const BundleScheduler&) = delete;
+
+        /**
+         * Queue all messages of a bundle (recursively), or a single message
+         * @param len Upper bound on the length of msg
+         * @returns false if any message got dropped since it did not fit
+         */
+        bool schedule(const char *msg, size_t len = (size_t)-1);
+
+        //! Schedule all messages pending in @p link
+        //! @returns the number of messages read from the link
+        size_t schedule_from(ThreadLink &link);
+
+        //! Start releasing the messages due before the end of a block
+        void begin_block(uint64_t start, unsigned nframes, double sample_rate);
+
+        /**
+         * Fetch the next message due in the current block
+         * @param offset receives the frame of the message in the block
+         * @returns the message, valid until the next call, or NULL
+         */
+        const char *next(unsigned *offset);
+
+        //! Timetag of the earliest queued message
+        //! (0 for immediate messages or an empty queue)
+        uint64_t next_timetag(void) const;
+
+        size_t size(void) const { return queued; }
+        size_t capacity(void) const { return max_messages; }
+        //! Drop all queued messages
+        void clear(void);
+
+        //! Number of messages dropped since they did not fit
+        uint64_t dropped;
+
+    private:
+        struct entry_t
+        {
+            uint64_t tt;
+            uint64_t seq; //!< arrival order, for equal timetags
+            uint32_t slot;
+        };
+
+        bool push(const char *msg, size_t len, uint64_t tt);
+        bool schedule_bundle(const char *msg, size_t len, uint64_t tt);
+        static bool before(const entry_t &a, const entry_t &b);
+
+        const size_t max_messages;
+        const size_t max_message_length;
+        char     *storage;
+        entry_t  *heap;
+        uint32_t *free_slots;
+        size_t    queued;
+        size_t    nfree;
+        uint64_t  seq;
+        int64_t   released; //!< slot of the last released message, or -1
+
+        rtosc_block_time_t block;
+};
+
+}
+
+#endif
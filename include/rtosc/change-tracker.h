@@ -0,0 +1,96 @@
+/**
+ * @file change-tracker.h
+ * Realtime safe dirty flags for the subtrees of a port tree
+ *
+ * @test default-value.cpp
+ */
+
+#ifndef RTOSC_CHANGE_TRACKER_H
+#define RTOSC_CHANGE_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace rtosc {
+
+struct Port;
+struct Ports;
+
+/**
+ * Tracks which parts of a port tree have been changed
+ *
+ * The tree is split into units: each port of the root with subports is one
+ * unit, and each index of a port array with subports (like "voice#8/")
+ * is one unit, too. All other ports of the root form one common unit,
+ * since their default values may depend on each other.
+ *
+ * Set RtData::changes to enable it. The setters of port-sugar.h then call
+ * mark() with their location. Marking sets an atomic flag, so it is realtime
+ * safe and can happen on another thread than reading the flags.
+ *
+ * Units can also be declared to be at their default values, e.g. after a
+ * subtree has been reset, with mark_defaults(). A save can then drop such
+ * units without walking them, so with a tracker constructed for a runtime
+ * object at its defaults, saving only walks the units changed since.
+ */
+class ChangeTracker
+{
+    public:
+        //! State of a unit since it has last been fetched
+        enum state_t {
+            unchanged,  //!< not marked
+            changed,    //!< marked by mark()
+            at_defaults //!< marked by mark_defaults(), and not changed since
+        };
+
+        /**
+         * @param root The root of the tracked port tree
+         * @param at_defaults Whether the runtime object has only default
+         *   values; otherwise, all units start as changed
+         */
+        explicit ChangeTracker(const Ports &root, bool at_defaults = false);
+        ChangeTracker(const ChangeTracker&) = delete;
+
+        //! Mark the unit containing the absolute location @p path as changed.
+        //! Unknown locations (or NULL) mark all units.
+        void mark(const char *path);
+        //! Mark all units as changed
+        void mark_all(void);
+        //! Declare the unit containing @p path to be at its default values.
+        //! Unknown locations (or NULL) declare all units.
+        void mark_defaults(const char *path);
+
+        //! Number of units; they are numbered from 0 on
+        std::size_t units(void) const { return flags.size(); }
+        //! The unit of port @p p of the root, with index @p index for
+        //! port arrays with subports, or -1
+        std::size_t unit(const Port *p, int index = -1) const;
+        //! Return whether @p unit has been changed and reset its flag
+        bool fetch(std::size_t unit) { return fetch_state(unit) != unchanged; }
+        //! Return the state of @p unit and reset it to unchanged
+        state_t fetch_state(std::size_t unit);
+
+        //! The common unit of all root ports without subports
+        enum { leaf_unit = 0 };
+
+    private:
+        struct subtree_t
+        {
+            const Port  *port;
+            std::size_t  prefix_len; //!< length of the name before '#' or '/'
+            int          size;       //!< array size, or -1 for no array
+            std::size_t  first_unit;
+        };
+        //! the unit of @p path, or units() if it is unknown
+        std::size_t find(const char *path) const;
+        //! set the state of @p unit, or of all units for units()
+        void set(std::size_t unit, state_t state);
+
+        std::vector<subtree_t>                  subtrees;
+        std::vector<std::atomic<unsigned char>> flags;
+};
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file coalescing-link.h
+ * ThreadLink which only delivers the latest value per address
+ *
+ * @test thread-link.cpp
+ */
+
+#ifndef RTOSC_COALESCING_LINK_H
+#define RTOSC_COALESCING_LINK_H
+
+#include <cstddef>
+#include <rtosc/thread-link.h>
+
+namespace rtosc {
+
+/**
+ * Link for parameter updates, where only the latest value of an address
+ * matters
+ *
+ * Messages written with write_latest() or raw_write_latest() are kept in
+ * one slot per address. A newer message for an address replaces the pending
+ * one, so when a slider is dragged, the reader only sees the value at the
+ * time it reads, instead of all intermediate ones. Messages passed to
+ * write() or raw_write() keep their FIFO order, like in a ThreadLink.
+ *
+ * The reader gets all FIFO messages first, then the pending latest values,
+ * in the order their addresses first got pending. There is one writer and
+ * one reader, like for ThreadLink. Neither of them allocates, and neither
+ * waits for the other; if all address slots are in use, further addresses
+ * are passed in FIFO order.
+ */
+class CoalescingLink
+{
+    public:
+        /**
+         * @param max_message_length Maximum length of any message
+         * @param max_messages Number of FIFO messages the link can hold
+         * @param max_addresses Number of addresses with coalesced values
+         */
+        CoalescingLink(size_t max_message_length, size_t max_messages,
+                       size_t max_addresses);
+        ~CoalescingLink(void);
+        CoalescingLink(const CoalescingLink&) = delete;
+
+        //! Queue a message in FIFO order, @see ThreadLink::write()
+        void write(const char *dest, const char *args, ...);
+        //! Queue a message in FIFO order, @see ThreadLink::raw_write()
+        void raw_write(const char *msg);
+
+        //! Replace any pending message to @p dest
+        void write_latest(const char *dest, const char *args, ...);
+        //! Replace any pending message with the address of @p msg
+        void raw_write_latest(const char *msg);
+
+        bool hasNext(void) const;
+
+        /**
+         * Read all pending messages (realtime safe)
+         *
+         * Messages are only valid during the callback. A latest value which
+         * the writer is just replacing is read by the next call.
+         * @returns the number of messages read
+         */
+        size_t read_all(ThreadLink::read_cb_t cb, void *data);
+        template<class F>
+        size_t read_all(F &&f)
+        {
+            return read_all([](const char *msg, size_t len, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)(msg, len);
+                }, (void*)&f);
+        }
+
+        //! Number of messages which have been replaced before being read
+        size_t coalesced(void) const;
+
+    private:
+        ThreadLink fifo;
+        char *write_buffer;
+        struct internal_coalescing_t *impl;
+};
+
+}
+
+#endif
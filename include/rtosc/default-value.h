@@ -59,6 +59,11 @@ const char* get_default_value(const char* port_name, const struct Ports& ports,
  * i.e. mapped values are being converted to integers; see
  * canonicalize_arg_vals() .
  *
+ * Default values which do not depend on other ports are taken from
+ * Ports::encodedDefault() if @p ports contains @p port_hint directly.
+ * Other scanned values are cached per port and preset, so repeated calls do
+ * not parse the metadata again; see clear_default_value_cache().
+ *
  * @param port_name the port's OSC path.
  * @param port_args the port's arguments, e.g. '::i:c:S'
  * @param ports the ports where @a portname is to be searched
@@ -83,6 +88,15 @@ int get_default_value(const char* port_name, const char *port_args,
                       std::size_t n, rtosc_arg_val_t* res,
                       char *strbuf, size_t strbufsize);
 
+/**
+ * Drop all cached default values
+ *
+ * This is done automatically whenever any Ports run refreshMagic(), which
+ * happens e.g. on their construction. Call it if metadata texts are being
+ * changed otherwise.
+ */
+void clear_default_value_cache();
+
 }
 
 #endif // RTOSC_DEFAULT_VALUE
@@ -0,0 +1,99 @@
+/**
+ * @file dispatch-profiler.h
+ * Per-port hit counts and callback latencies, recorded by Ports::dispatch
+ *
+ * @test port-dispatch.cpp
+ */
+
+#ifndef RTOSC_DISPATCH_PROFILER_H
+#define RTOSC_DISPATCH_PROFILER_H
+
+#include <cstdint>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * Profiler for the leaf ports called by dispatch
+ *
+ * Set RtData::profiler to enable it. Each leaf call is counted, and every
+ * sample_interval-th call is timed, so it is cheap enough to be left on.
+ * Latencies go into a histogram with power of two buckets, bucket i counting
+ * latencies below 2^(i+6) ns (the last one counts all the slower ones).
+ *
+ * The statistics can be read over OSC by mounting profilerPort() (or
+ * DispatchProfiler::ports, with d.obj pointing to the profiler) into the
+ * port tree. Dispatching does not allocate, but the profiler is not thread
+ * safe, so each dispatching thread needs its own.
+ */
+class DispatchProfiler
+{
+    public:
+        enum {
+            buckets  = 16, //!< number of histogram buckets
+            max_path = 64  //!< maximum recorded path length
+        };
+
+        struct stats_t
+        {
+            const Port *port;
+            char        path[max_path]; //!< location of the first call
+            uint64_t    hits;
+            uint64_t    samples;        //!< number of timed calls
+            uint64_t    total_ns;       //!< sum of the timed calls
+            uint64_t    max_ns;
+            uint32_t    histogram[buckets];
+        };
+
+        /**
+         * @param ports Maximum number of profiled ports, rounded to 2^n
+         * @param sample_interval Time every n-th call, 0 for no timing
+         */
+        DispatchProfiler(unsigned ports = 256, unsigned sample_interval = 64);
+        ~DispatchProfiler(void);
+        DispatchProfiler(const DispatchProfiler&) = delete;
+
+        //! Called by dispatch instead of calling the leaf's callback
+        void call(const Port &port, const char *m, RtData &d);
+
+        //! Drop all statistics
+        void reset(void);
+
+        //! Number of profiled ports
+        unsigned size(void) const { return nused; }
+        //! Statistics of the i-th profiled port, in order of the first call
+        const stats_t &stats(unsigned i) const { return table[used[i]]; }
+        //! Statistics of the port with location @p path, or NULL
+        const stats_t *find(const char *path) const;
+
+        //! If false, leaf callbacks are called without any profiling
+        bool     enabled;
+        unsigned sample_interval;
+        //! Calls of ports which did not fit into the table anymore
+        uint64_t overflow;
+
+        /**
+         * Ports for reading the statistics; d.obj must be the profiler:
+         * - "enable::T:F", "sample_interval::i", "reset:"
+         * - "count:" replies the number of profiled ports
+         * - "stats:" replies "shhhh" (path, hits, samples, total and maximum
+         *   ns) for each port, "stats:s" for the port with the given path
+         * - "histogram:s" replies the path and the buckets as int32
+         */
+        static const Ports ports;
+
+        //! Port "profiler/" for merging DispatchProfiler::ports into a tree
+        Port profilerPort(void);
+
+    private:
+        stats_t  *lookup(const Port &port, const RtData &d);
+
+        stats_t  *table;
+        unsigned *used;
+        unsigned  mask, nused;
+        unsigned  countdown;
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file feedback-limiter.h
+ * Rate limiting of parameter feedback to slow clients
+ *
+ * @test broadcaster.cpp
+ */
+
+#ifndef RTOSC_FEEDBACK_LIMITER_H
+#define RTOSC_FEEDBACK_LIMITER_H
+
+#include <cstddef>
+#include <rtosc/broadcaster.h>
+
+namespace rtosc {
+
+/**
+ * Subscriber of a Broadcaster which passes messages on at a maximum rate
+ *
+ * Between two flushes, only the latest message per address is kept, so a
+ * client sees the current values, but not every intermediate one. At most
+ * @p max_addresses addresses and bundles are pending, which bounds the size
+ * of each flush. Up to @p max_addresses further ones are kept, coalesced the
+ * same way, and become pending after the next flush. Only messages beyond
+ * that are dropped, which bounds the memory.
+ *
+ * Messages are not copied, the limiter keeps references to the messages of
+ * the Broadcaster. Each client gets its own limiter, with its own rate.
+ * tick() must be called regularly, e.g. after each Broadcaster::flush().
+ *
+ * This is meant for the non-realtime side, and not thread safe.
+ */
+class FeedbackLimiter
+{
+    public:
+        /**
+         * @param out Where to pass the messages, e.g. a transport
+         * @param max_rate Maximum number of flushes per second
+         * @param max_addresses Maximum number of pending messages, and of
+         *   messages kept for the flush after the next one
+         */
+        FeedbackLimiter(Broadcaster::sink_t out, double max_rate = 30,
+                        size_t max_addresses = 1024);
+        ~FeedbackLimiter(void);
+        FeedbackLimiter(const FeedbackLimiter&) = delete;
+
+        //! Sink for Broadcaster::subscribe(), referring to this limiter
+        Broadcaster::sink_t sink(void);
+        //! Keep @p n messages until the next flush
+        void add(const MessageRef *msgs, size_t n);
+
+        /**
+         * Flush if the last flush is at least 1/max_rate seconds ago
+         * @param now The current time in seconds, any monotonic clock
+         * @return The number of messages passed on
+         */
+        size_t tick(double now);
+        //! tick() with the current time of a steady clock
+        size_t tick(void);
+        //! Pass all pending messages on now
+        size_t flush(void);
+
+        void set_rate(double max_rate);
+        size_t pending(void) const;
+        //! Number of messages replaced by newer ones for the same address
+        size_t coalesced(void) const;
+        //! Number of messages dropped because twice max_addresses were kept
+        size_t dropped(void) const;
+
+    private:
+        struct internal_limiter_t *impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file midi-decoder.h
+ * Decoder for 14 bit CCs and (N)RPNs
+ *
+ * @test test-midi-mapper.cpp
+ */
+
+#ifndef RTOSC_MIDI_DECODER_H
+#define RTOSC_MIDI_DECODER_H
+
+#include <cstdint>
+
+namespace rtosc {
+
+/**
+ * Pairs controller messages to 14 bit values
+ *
+ * CCs 0 to 31 can be paired with CCs 32 to 63 as coarse and fine part of
+ * one 14 bit value. CCs 99/98 (NRPN) and 101/100 (RPN) select a parameter
+ * number, which data entry CCs 6 and 38 then set. The roles of all CCs are
+ * kept in a table and the state in fixed arrays per channel, so feeding a
+ * CC takes constant time and never allocates.
+ */
+class MidiDecoder
+{
+    public:
+        enum event_type
+        {
+            cc,   //!< plain 7 bit CC
+            cc14, //!< 14 bit CC, number is the coarse CC
+            nrpn, //!< NRPN, number is the 14 bit parameter number
+            rpn   //!< RPN, number is the 14 bit parameter number
+        };
+
+        struct Event
+        {
+            event_type type;
+            int channel;
+            int number;
+            int value; //!< 7 bit for cc, otherwise 14 bit
+        };
+
+        //! State of (N)RPN parameter numbers and data, -1 if not received
+        struct ParameterState
+        {
+            int parhi, parlo;
+            int valhi, vallo;
+            bool is_nrpn;
+        };
+
+        MidiDecoder(void);
+
+        /**
+         * Pair CC @p cc (0 to 31) with CC cc+32 to 14 bit values
+         *
+         * The coarse and fine part are kept when the other one changes.
+         * Both parts of paired CCs emit cc14 events.
+         */
+        void setHighRes(int cc, bool high_res);
+
+        /**
+         * Feed one CC
+         * @return true if @p ev has been set to a decoded value, false if
+         *   only a parameter number was completed, or for invalid input
+         */
+        bool feed(int channel, int cc, int value, Event *ev);
+
+        const ParameterState &parameter(int channel) const
+        {
+            return params[channel];
+        }
+
+        //! Forget all received values
+        void reset(void);
+
+        enum { channels = 16 };
+
+    private:
+        enum role_t : uint8_t
+        {
+            plain, coarse, fine, data_hi, data_lo,
+            nrpn_hi, nrpn_lo, rpn_hi, rpn_lo
+        };
+        role_t role[128];
+        uint8_t coarse_val[channels][32];
+        uint8_t fine_val[channels][32];
+        ParameterState params[channels];
+};
+
+}
+
+#endif
@@ -68,6 +68,8 @@ class MidiMapperStorage
             TinyVector clone(void)
             {TinyVector next(n); for(int i=0;i<n; ++i) next.t[i]=t[i]; return std::move(next);}
             int size(void) const{return n;}
+            //! free the elements, copies of this vector become invalid
+            void release(void) {delete [] t; t = 0; n = 0;}
         };
 
         typedef std::function<void(const char*)> write_cb;
@@ -79,11 +81,18 @@ class MidiMapperStorage
         TinyVector<int> values;
 
         bool handleCC(int ID, int val, write_cb write);
+        //! Store the value of a CC, without calling the callback
+        //! @return index of the changed value, or -1 if ID is not mapped
+        int apply(int ID, int val);
 
         //TODO try to change O(n^2) algorithm to O(n)
         void cloneValues(const MidiMapperStorage &storage);
 
         MidiMapperStorage *clone(void);
+
+        MidiMapperStorage(void) = default;
+        MidiMapperStorage(const MidiMapperStorage&) = delete;
+        ~MidiMapperStorage(void);
 };
 
 struct MidiBijection
@@ -116,6 +125,26 @@ class MidiMappernRT
 
         void clear(void);
 
+        /**
+         * Collect all following changes into one storage
+         *
+         * Until commitTransaction(), changed storages are not sent to the
+         * realtime side, and intermediate storages are freed directly.
+         * Transactions can be nested.
+         */
+        void beginTransaction(void);
+        //! Send the storage with all changes since beginTransaction()
+        void commitTransaction(void);
+
+        /**
+         * Free a storage that the realtime side does not use anymore
+         *
+         * MidiMapperRT sends "/midi-retire" with the old storage to its
+         * frontend when it gets a new one.
+         * @return false if @p msg is no "/midi-retire" message
+         */
+        bool reclaim(const char *msg);
+
         std::map<std::string, std::string> getMidiMappingStrings(void);
 
         //unclear if this should be be here as a helper or not
@@ -148,6 +177,19 @@ class MidiMappernRT
         std::function<void(const char *)> rt_cb;
         MidiMapperStorage *storage;
         const Ports *base_ports;
+    private:
+        void replaceStorage(MidiMapperStorage *nstorage, bool publish = true);
+        void publishStorage(void);
+        bool published;  //!< whether storage has been sent to the RT side
+        int  transaction;
+};
+
+//! Timestamped CC, e.g. from an LV2 or JACK event buffer
+struct MidiEvent
+{
+    uint32_t time; //!< frame offset in the period
+    int ID;        //!< CC ID, as passed to MidiMapperRT::handleCC()
+    int val;
 };
 
 class MidiMapperRT
@@ -157,8 +199,22 @@ class MidiMapperRT
         void setBackendCb(std::function<void(const char*)> cb);
         void setFrontendCb(std::function<void(const char*)> cb);
         void handleCC(int ID, int val);
+        /**
+         * Handle all CCs of one period
+         *
+         * All values of mapped CCs are stored first, then each changed
+         * target gets one message with its last value. Unmapped CCs are
+         * handled like in handleCC().
+         */
+        void handleCCs(const MidiEvent *events, int n);
+        //! Use the storage of a "midi-bind" message
+        void bind(const char *msg);
         void addWatch(void);
         void remWatch(void);
+    private:
+        void unhandledCC(int ID);
+        void flush(const int *changed, int n);
+    public:
 
         //Depricated
         Port addWatchPort(void);
@@ -274,6 +330,18 @@ class MidiTable
         Port unlearnPort(void);
         Port registerPort(void);
 
+        //! Conversion of a controller value, parsed from port metadata
+        struct Conversion
+        {
+            enum { invalid, linear, logarithmic } scale;
+            float offset; //!< min, or log(min) for logarithmic
+            float factor; //!< max-min, or log(max)-log(min)
+        };
+
+        //! Parse min, max and scale once, for use with translate()
+        static Conversion parseConversion(const char *meta);
+        static float translate(uint8_t val, const Conversion &c);
+
         //TODO generalize to an addScalingFunction() system
         static float translate(uint8_t val, const char *meta);
 
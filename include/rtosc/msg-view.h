@@ -0,0 +1,54 @@
+/**
+ * @file msg-view.h
+ * C++ wrapper around rtosc_msg_view
+ *
+ * Parse a message once, then read its arguments in constant time:
+ * @code
+ *     rtosc::MsgView v(msg);
+ *     for(unsigned i = 0; i < v.size(); ++i)
+ *         if(v.type(i) == 'f')
+ *             sum += v[i].f;
+ * @endcode
+ *
+ * @test test/msg-view.c
+ */
+
+#ifndef RTOSC_MSG_VIEW_H
+#define RTOSC_MSG_VIEW_H
+
+#include <rtosc/rtosc.h>
+
+namespace rtosc {
+
+class MsgView
+{
+    public:
+        //! @param msg well formed OSC message which must outlive the view
+        explicit MsgView(const char *msg) { rtosc_msg_view_init(&view, msg); }
+
+        const char *message() const { return view.msg; }
+        //! number of arguments, excluding array delimiters
+        unsigned size() const { return view.nargs; }
+
+        char type(unsigned i) const { return rtosc_msg_view_type(&view, i); }
+        rtosc_arg_t operator[](unsigned i) const
+        {
+            return rtosc_msg_view_argument(&view, i);
+        }
+        rtosc_arg_val_t arg_val(unsigned i) const
+        {
+            rtosc_arg_val_t av;
+            av.type = type(i);
+            av.val  = (*this)[i];
+            return av;
+        }
+
+        const rtosc_msg_view &c_view() const { return view; }
+
+    private:
+        rtosc_msg_view view;
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file osc-doc.h
+ * Streamed and cached output of the OSC documentation of port trees
+ *
+ * @test osc-doc.cpp
+ */
+
+#ifndef RTOSC_OSC_DOC_H
+#define RTOSC_OSC_DOC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <rtosc/ports.h>
+#include <rtosc/pretty-format.h>
+
+namespace rtosc {
+
+/**
+ * Pass the XML documentation of a port tree to a sink
+ *
+ * The text is the same as the one written by operator<<(), but it is passed
+ * on in chunks of a few KiB while the tree is being walked, and the walk
+ * stops as soon as the sink stops printing.
+ * @return false if the sink stopped printing
+ */
+bool write_osc_doc(const OscDocFormatter &formatter,
+                   rtosc_print_sink sink, void *sink_data);
+
+/**
+ * Documentation of a port tree, which only regenerates changed subtrees
+ *
+ * The text of each Ports object is kept, split at its subtrees. update()
+ * walks the tree again, but only formats the Ports objects which are new
+ * or whose ports have changed, i.e. which have other port names, metadata
+ * pointers or subtrees than before. Metadata which is changed in place must
+ * be reported with invalidate().
+ *
+ * The output is the same as the one of operator<<() for the formatter.
+ */
+class OscDocCache
+{
+    public:
+        //! The formatter's tree is documented by the first update()
+        explicit OscDocCache(const OscDocFormatter &formatter);
+
+        /**
+         * Walk the tree and regenerate the changed Ports objects
+         * @return The number of regenerated Ports objects
+         */
+        std::size_t update(void);
+        /**
+         * Regenerate the subtrees at and below @p prefix on next update()
+         *
+         * If @p prefix does not end with '/', e.g. if it is the path of a
+         * leaf, the Ports object containing it is regenerated, too.
+         */
+        void invalidate(const char *prefix = "/");
+
+        //! Pass the documentation to a sink, see write_osc_doc()
+        bool write(rtosc_print_sink sink, void *sink_data) const;
+        //! The whole documentation
+        std::string str(void) const;
+
+    private:
+        struct node_t
+        {
+            std::string  path;        //!< e.g. "/voice[0,7]/"
+            const Ports *ports;
+            uint64_t     fingerprint; //!< of the ports, 0 if invalidated
+            std::vector<std::string> segments; //!< text around the children
+            std::vector<std::size_t> children; //!< indices into nodes
+        };
+
+        void build(const Ports *ports, const std::string &path,
+                   const std::vector<node_t> &old,
+                   const std::unordered_map<std::string, std::size_t>
+                       &old_index);
+        bool write(std::size_t node, rtosc_print_sink sink,
+                   void *sink_data) const;
+
+        OscDocFormatter formatter;
+        std::string header, footer;
+        std::vector<node_t> nodes; //!< in pre-order, the root first
+        std::unordered_map<std::string, std::size_t> index; //!< by path
+        std::size_t rebuilt;
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file parallel-dispatch.h
+ * Dispatching batches of messages to independent subtrees in parallel
+ *
+ * Messages are partitioned by the first segment of their address, e.g. all
+ * messages to "/part0/..." form one partition and all messages to
+ * "/part1/..." another one. Each partition is dispatched by exactly one
+ * worker thread, in the order of the batch, so the ports of one subtree
+ * never run concurrently. Ports of different subtrees must not share state
+ * without synchronizing it.
+ *
+ * @test parallel-dispatch.cpp
+ */
+
+#ifndef RTOSC_PARALLEL_DISPATCH_H
+#define RTOSC_PARALLEL_DISPATCH_H
+
+#include <cstddef>
+
+namespace rtosc {
+
+struct Ports;
+struct RtData;
+class WorkerPool;
+
+/**
+ * Worker threads for dispatching batches of messages in parallel
+ *
+ * This is meant for the non-realtime side, e.g. for loading large
+ * savefiles or applying many changes at once. Dispatching allocates.
+ */
+class ParallelDispatcher
+{
+    public:
+        /**
+         * @param threads Number of worker threads, 0 to use the shared
+         *   pool (see WorkerPool::shared())
+         */
+        explicit ParallelDispatcher(unsigned threads = 0);
+        //! Dispatch on the workers of @p pool, which must outlive this
+        explicit ParallelDispatcher(WorkerPool &pool);
+        ~ParallelDispatcher(void);
+        ParallelDispatcher(const ParallelDispatcher&) = delete;
+
+        //! Number of worker threads, i.e. of RtData required by dispatch()
+        unsigned threads(void) const;
+
+        /**
+         * Base dispatch of @p n messages, partitioned by subtree
+         *
+         * Returns when all messages have been dispatched.
+         *
+         * @param root The root of the port tree
+         * @param msgs The messages
+         * @param n Number of messages
+         * @param data One RtData per worker thread, see threads(). Each one is
+         *             set up like for a base dispatch and is only used by its
+         *             worker, i.e. it must not be shared with other workers.
+         * @return The sum of RtData::matches over all partitions
+         */
+        int dispatch(const Ports &root, const char *const *msgs, size_t n,
+                     RtData *const *data);
+
+    private:
+        WorkerPool *pool;
+        bool        own_pool;
+};
+
+}
+
+#endif
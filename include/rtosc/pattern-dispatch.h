@@ -0,0 +1,126 @@
+/**
+ * @file pattern-dispatch.h
+ * Dispatching messages whose addresses are OSC patterns, like
+ * "/part?/Pvolume", "/voice[0-7]/enable" or "/{foo,bar}/baz"
+ *
+ * The pattern is compiled once and then matched against the names of the
+ * port tree, level by level. Each matching leaf receives a copy of the
+ * message with the leaf's concrete address.
+ *
+ * @test pattern-dispatch.cpp
+ */
+
+#ifndef RTOSC_PATTERN_DISPATCH_H
+#define RTOSC_PATTERN_DISPATCH_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace rtosc {
+
+struct Ports;
+struct RtData;
+
+/**
+ * OSC address pattern, compiled into one small matcher program per path
+ * segment. All storage is fixed size, so compiling does not allocate.
+ */
+class CompiledPattern
+{
+    public:
+        enum {
+            max_address  = 256, //!< maximum address length, including '\0'
+            max_segments = 16,  //!< maximum number of path segments
+            max_ops      = 64,  //!< maximum number of literals and operators
+            max_sets     = 8    //!< maximum number of "[...]" expressions
+        };
+
+        CompiledPattern(void) : nsegments(0) { address[0] = 0; }
+
+        /**
+         * Compile an OSC address pattern, e.g. "/voice[0-7]/enable"
+         * @return false if the pattern is malformed or exceeds the limits
+         */
+        bool compile(const char *pattern);
+
+        //! Whether compile() succeeded
+        bool valid(void) const { return nsegments; }
+
+        //! The pattern given to compile(), without the leading '/'
+        const char *pattern(void) const { return address; }
+
+        int segments(void) const { return nsegments; }
+
+        //! Whether segment @p seg contains no pattern characters
+        bool literal(int seg) const;
+
+        //! The text of segment @p seg inside pattern(), of length @p len
+        const char *segment(int seg, int *len) const;
+
+        //! Match the string [str, str+len) against segment @p seg
+        bool match(int seg, const char *str, int len) const;
+
+    private:
+        enum op_type_t { LITERAL, ANY, STAR, SET, OPTIONS };
+        struct op_t {
+            uint8_t  type;
+            uint8_t  len;    //!< length of the literal or the options text
+            uint16_t offset; //!< into address, or into sets for SET
+        };
+
+        bool match_ops(int op, int end_op, const char *s, const char *e) const;
+
+        char     address[max_address];
+        op_t     ops[max_ops];
+        uint8_t  sets[max_sets][32];
+        uint8_t  seg_begin[max_segments+1]; //!< first op of each segment
+        uint16_t seg_text[max_segments+1];  //!< segment offsets in address
+        int      nsegments;
+};
+
+/**
+ * Cache of the recently compiled patterns, replacing the least recently
+ * used one on a miss. Not thread safe, use one cache per dispatching thread.
+ */
+class PatternCache
+{
+    public:
+        enum { size = 8 };
+
+        PatternCache(void);
+
+        //! @return The compiled @p address, or NULL if it can not be compiled
+        const CompiledPattern *get(const char *address);
+
+    private:
+        CompiledPattern entries[size];
+        unsigned long   last_use[size];
+        unsigned long   clock;
+};
+
+//! Whether @p address contains OSC pattern characters ('*', '?', '[', '{')
+bool is_pattern(const char *address);
+
+/**
+ * Dispatch a message whose address may be an OSC pattern
+ *
+ * Every leaf port in @p root whose concrete address matches the pattern
+ * is dispatched once with a copy of @p m, as if that message was sent to the
+ * leaf's address. Subtrees are walked statically, i.e. "#N" ports expand to
+ * all N indices, while ports named "*" can only be matched literally.
+ * Messages without pattern characters (or with invalid patterns) are
+ * dispatched like the usual base dispatch, which counts as one address.
+ *
+ * @param root The root of the port tree
+ * @param m The message
+ * @param d The RtData for each dispatch. d.matches is the total number of
+ *          matches after return
+ * @param cache Cache for compiled patterns, or NULL for compiling each time
+ * @return The number of addresses dispatched to
+ */
+int dispatch_pattern(const Ports &root, const char *m, RtData &d,
+                     PatternCache *cache = NULL);
+
+}
+
+#endif
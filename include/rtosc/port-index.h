@@ -0,0 +1,180 @@
+/**
+ * @file port-index.h
+ * Flat indices of a port tree, for repeated walks and path searches
+ *
+ * @test walk-ports.cpp
+ */
+
+#ifndef RTOSC_PORT_INDEX_H
+#define RTOSC_PORT_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * The expansion of walk_ports(), computed once
+ *
+ * Building the index walks the tree like walk_ports() without a runtime
+ * object, so all subtrees are expanded, and records each visited port. The
+ * entries are stored in one array, and all paths in one string arena, so a
+ * later walk is a linear scan without any recursion or path building.
+ *
+ * The index does not know a runtime object: ports which walk_ports() would
+ * skip because they are disabled (see port_is_enabled()) are contained.
+ * Rebuild the index if the port tree changes.
+ */
+class PortIndex
+{
+    public:
+        struct entry_t
+        {
+            const Port  *port;
+            const Ports *base;      //!< Ports object containing port
+            uint32_t     path;      //!< offset of the absolute path
+            uint32_t     from_base; //!< offset of the port's own name in it
+            uint32_t     indices;   //!< offset of the array indices
+            uint32_t     nindices;  //!< number of array indices
+        };
+
+        /**
+         * @param expand_bundles Like the parameter of walk_ports(): whether
+         *        each element of a bundle port (like "a#4") gets an entry
+         */
+        explicit PortIndex(const Ports &root, bool expand_bundles = true);
+
+        size_t size(void) const { return entries.size(); }
+        const entry_t &operator[](size_t i) const { return entries[i]; }
+        const entry_t *begin(void) const { return entries.data(); }
+        const entry_t *end(void) const
+        {
+            return entries.data() + entries.size();
+        }
+
+        //! Absolute path of an entry, like the walkers' name buffer
+        const char *path(const entry_t &e) const
+        {
+            return strings.data() + e.path;
+        }
+        //! Part of the path which belongs to the port itself
+        const char *path_from_base(const entry_t &e) const
+        {
+            return strings.data() + e.path + e.from_base;
+        }
+        //! The index of each port array on the path, outermost first,
+        //! e.g. {3, 1} for "/voice3/osc1/freq"
+        const int *indices(const entry_t &e) const
+        {
+            return index_arena.data() + e.indices;
+        }
+
+        /**
+         * Call @p walker for each entry, in the order of walk_ports()
+         *
+         * The walker gets the same arguments as from walk_ports() without a
+         * runtime object. The path is copied into a buffer first, so walkers
+         * which modify the name buffer can be used, too.
+         */
+        void walk(void *data, port_walker_t walker) const;
+
+    private:
+        void build(const Ports &base, char *name_buffer, size_t buffer_size,
+                   std::vector<int> &path_indices, bool expand_bundles);
+        void add(const Port &p, const Ports &base, const char *name_buffer,
+                 const char *old_end, const std::vector<int> &path_indices);
+
+        std::vector<entry_t> entries;
+        std::vector<char>    strings;
+        std::vector<int>     index_arena;
+        size_t               max_path;
+};
+
+/**
+ * Name index of all Ports objects of a port tree, for path_search()
+ *
+ * For each Ports object in the tree, the names of its children are kept
+ * sorted, and a suffix array over the names is built, so both prefix and
+ * substring needles are found by binary search instead of scanning all
+ * children. Ports objects which occur multiple times in the tree, like the
+ * subtree of a port array, are indexed only once.
+ *
+ * Rebuild the index if the port tree changes.
+ */
+class PathSearchIndex
+{
+    public:
+        /**
+         * @param substrings Whether to build the suffix arrays required for
+         *        substring searches
+         */
+        explicit PathSearchIndex(const Ports &root, bool substrings = true);
+
+        const Ports &root(void) const { return root_ports; }
+
+        /**
+         * Find the children of @p ports whose names match @p needle
+         *
+         * Names starting with the needle come first, sorted by name. For
+         * substring searches, they are followed by names containing the
+         * needle, sorted by the position of the match, then by name. Only the
+         * part of a name before the argument specs (':') is searched for
+         * substrings.
+         *
+         * @param res Array of size @p max to store the matching ports in
+         * @return The number of matches stored in @p res, or -1 if
+         *   @p ports is not part of the index, or if a substring search
+         *   was requested from an index built without suffix arrays
+         */
+        int search(const Ports &ports, const char *needle, bool substring,
+                   const Port **res, size_t max) const;
+
+    private:
+        struct node_t
+        {
+            //! children, sorted by name
+            std::vector<const Port*> by_name;
+            //! (index into by_name, offset) of each suffix, sorted
+            std::vector<std::pair<uint32_t, uint32_t>> suffixes;
+        };
+
+        void build(const Ports &ports, bool substrings);
+
+        const Ports &root_ports;
+        bool has_suffixes;
+        std::unordered_map<const Ports*, node_t> nodes;
+};
+
+/**
+ * Like path_search(), but searching in a PathSearchIndex
+ *
+ * Results are ranked as described at PathSearchIndex::search(). Ports
+ * objects which are not part of the index are scanned like in path_search().
+ *
+ * @param substring Whether to return ports containing @p needle as well,
+ *   not only ports starting with it
+ * @see path_search
+ */
+void path_search(const PathSearchIndex& index,
+                 const char *str, const char *needle,
+                 char *types, std::size_t max_types,
+                 rtosc_arg_t* args, std::size_t max_args,
+                 bool substring = false);
+
+/**
+ * Like the message version of path_search(), but searching in a
+ * PathSearchIndex
+ *
+ * In addition to the two string arguments, @p m may have a third argument of
+ * type 'T' to request a substring search.
+ */
+std::size_t path_search(const PathSearchIndex& index, const char *m,
+                        std::size_t max_ports,
+                        char *msgbuf, std::size_t bufsize);
+
+}
+
+#endif
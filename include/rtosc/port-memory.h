@@ -0,0 +1,73 @@
+/**
+ * @file port-memory.h
+ * Memory footprint reports of port trees
+ *
+ * @test port-memory.cpp
+ */
+
+#ifndef RTOSC_PORT_MEMORY_H
+#define RTOSC_PORT_MEMORY_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * Bytes used by a port tree, per subtree and category
+ *
+ * Each Ports object is reported once, at the first path where it is
+ * mounted, e.g. "/part#16/voice#8/". Its other mounts, like the other 15
+ * parts, share it and only count as instances. A matcher shared by Ports
+ * with equal names (see Ports::prepare()) is counted for the first one.
+ * Tables which have not been built yet count as 0 bytes, so prepare the
+ * tree first to see the footprint of a running process.
+ *
+ * The captures of large std::function callbacks can not be measured, only
+ * the std::function objects themselves.
+ */
+struct PortMemoryReport
+{
+    //! A mounted hash table with more slots than this per port is flagged
+    static constexpr double oversized_hash = 2.0;
+
+    struct subtree_t
+    {
+        std::string     path;      //!< e.g. "/" or "/part#16/voice#8/"
+        const Ports    *ports;
+        Ports::memory_t self;      //!< with matcher 0 if counted before
+        std::size_t     bytes;     //!< sum of the categories of self
+        std::size_t     total;     //!< bytes of this and all subtrees below
+        std::size_t     instances; //!< number of runtime instances
+        std::size_t     end;       //!< index after the last subtree below
+        bool            oversized; //!< see oversized_hash
+    };
+
+    //! Walk @p root and all subtrees
+    explicit PortMemoryReport(const Ports &root);
+
+    //! Subtrees in pre-order, the root first
+    std::vector<subtree_t> subtrees;
+    //! Totals per category over the whole tree
+    Ports::memory_t sum;
+
+    //! Bytes of the whole tree
+    std::size_t total(void) const { return subtrees[0].total; }
+
+    /**
+     * Print one line per subtree, with its own and its total bytes per
+     * category, and a summary
+     * @param max_depth Subtrees deeper than this are only counted in their
+     *   parents' totals
+     * @param min_bytes Subtrees with smaller totals are left out
+     */
+    void print(std::ostream &out, unsigned max_depth = ~0u,
+               std::size_t min_bytes = 0) const;
+};
+
+}
+
+#endif
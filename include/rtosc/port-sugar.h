@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <type_traits>
 #include <cstring>
+#include <rtosc/change-tracker.h>
 
 #ifndef RTOSC_PORT_SUGAR
 #define RTOSC_PORT_SUGAR
@@ -180,6 +181,9 @@ struct rtosc_hack_decltype_t
 //This can be used to queue up interpolation or parameter regen
 #define rChangeCb
 
+//Report a change to the ChangeTracker, if the RtData has one
+#define rMarkChanged if(data.changes) data.changes->mark(data.location());
+
 //Normal parameters
 #define rParam(name, ...) \
   {STRINGIFY(name) "::c",  rProp(parameter) rMap(min, 0) rMap(max, 127) DOC(__VA_ARGS__), NULL, rParamCb(name)}
@@ -249,13 +253,13 @@ template<class T> constexpr T spice(T*t) {return *t;}
     {STRINGIFY(cond_name) ":", rProp(internal), NULL, rEnabledIfCb(condition)}
 #define rEnabledIfCb(condition) rBOIL_BEGIN \
     assert(!rtosc_narguments(msg)); \
-    data.reply(loc, (condition)?"T":"F"); \
+    data.reply(data.location(), (condition)?"T":"F"); \
     rBOIL_END \
 
 #define rSelf(type, ...) \
 {"self:", rProp(internal) rMap(class, type) __VA_ARGS__ rDoc("port metadata"), 0, \
     [](const char *, rtosc::RtData &d){ \
-        d.reply(d.loc, "b", sizeof(d.obj), &d.obj);}}\
+        d.reply(d.location(), "b", sizeof(d.obj), &d.obj);}}\
 
 //Misc
 #define rDummy(name, ...) {STRINGIFY(name), rProp(dummy), NULL, [](msg_t, rtosc::RtData &){}}
@@ -303,11 +307,11 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 
 //Callback Implementations
+//They call data.location() only where they use the path, see RtData::lazy_loc
 #define rBOIL_BEGIN [](const char *msg, rtosc::RtData &data) { \
         (void) msg; (void) data; \
         rObject *obj = (rObject*) data.obj;(void) obj; \
         const char *args = rtosc_argument_string(msg); (void) args;\
-        const char *loc = data.loc; (void) loc;\
         auto prop = data.port->meta(); (void) prop;
 
 #define rBOIL_END }
@@ -320,45 +324,48 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 #define rTYPE(n) decltype(obj->n)
 
-#define rCAPPLY(getcode, t, setcode) if((decltype(var))(getcode) != var) data.reply("/undo_change", "s" #t #t, data.loc, static_cast<int>(getcode), var); setcode;
+#define rCAPPLY(getcode, t, setcode) if((decltype(var))(getcode) != var) data.reply("/undo_change", "s" #t #t, data.location(), static_cast<int>(getcode), var); setcode;
 #define rAPPLY(n,t) rCAPPLY(obj->n, t, obj->n = var)
 
 #define rParamCb(name) rBOIL_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "c", obj->name); \
+            data.reply(data.location(), "c", obj->name); \
         } else { \
             rTYPE(name) var = rtosc_argument(msg, 0).i; \
             rLIMIT(var, atoi) \
             rAPPLY(name, c) \
-            data.broadcast(loc, "c", obj->name);\
+            data.broadcast(data.location(), "c", obj->name);\
             rChangeCb \
+            rMarkChanged \
         } rBOIL_END
 
 #define rParamFCb(name) rBOIL_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "f", obj->name); \
+            data.reply(data.location(), "f", obj->name); \
         } else { \
             rTYPE(name) var = rtosc_argument(msg, 0).f; \
             rLIMIT(var, atof) \
             rAPPLY(name, f) \
-            data.broadcast(loc, "f", obj->name);\
+            data.broadcast(data.location(), "f", obj->name);\
             rChangeCb \
+            rMarkChanged \
         } rBOIL_END
 
 #define rParamICb(name) rBOIL_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "i", obj->name); \
+            data.reply(data.location(), "i", obj->name); \
         } else { \
             rTYPE(name) var = rtosc_argument(msg, 0).i; \
             rLIMIT(var, atoi) \
             rAPPLY(name, i) \
-            data.broadcast(loc, "i", obj->name);\
+            data.broadcast(data.location(), "i", obj->name);\
             rChangeCb \
+            rMarkChanged \
         } rBOIL_END
 
 #define rCOptionCb_(getcode, setcode) { \
             if(!strcmp("", args)) {\
-                data.reply(loc, "i", static_cast<int>(getcode)); \
+                data.reply(data.location(), "i", static_cast<int>(getcode)); \
             } else if(!strcmp("s", args) || !strcmp("S", args)) { \
                 int var = \
                     enum_key(prop, rtosc_argument(msg, 0).s); \
@@ -368,15 +375,17 @@ template<class T> constexpr T spice(T*t) {return *t;}
                 assert(!prop["max"] || \
                        var <= atoi(prop["max"])); \
                 rCAPPLY(getcode, i, setcode) \
-                data.broadcast(loc, "i", getcode); \
+                data.broadcast(data.location(), "i", getcode); \
                 rChangeCb \
+                rMarkChanged \
             } else {\
                 int var = \
                     rtosc_argument(msg, 0).i; \
                 rLIMIT(var, atoi) \
                 rCAPPLY(getcode, i, setcode) \
-                data.broadcast(loc, rtosc_argument_string(msg), getcode);\
+                data.broadcast(data.location(), rtosc_argument_string(msg), getcode);\
                 rChangeCb \
+                rMarkChanged \
             } \
         }
 
@@ -393,12 +402,13 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 #define rToggleCb(name) rBOIL_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, obj->name ? "T" : "F"); \
+            data.reply(data.location(), obj->name ? "T" : "F"); \
         } else { \
             if(obj->name != rtosc_argument(msg, 0).T) { \
-                data.broadcast(loc, args);\
+                data.broadcast(data.location(), args);\
                 obj->name = rtosc_argument(msg, 0).T; \
                 rChangeCb \
+                rMarkChanged \
             } \
         } rBOIL_END
 
@@ -414,7 +424,7 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 #define rRecurPtrCb(name) rBOIL_BEGIN \
     void *ptr = &obj->name; \
-    data.reply(loc, "b", sizeof(void*), &ptr); \
+    data.reply(data.location(), "b", sizeof(void*), &ptr); \
     rBOIL_END
 
 #define rRecurpCb(name) rBOIL_BEGIN \
@@ -452,32 +462,35 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 #define rArrayFCb(name) rBOILS_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "f", obj->name[idx]); \
+            data.reply(data.location(), "f", obj->name[idx]); \
         } else { \
             float var = rtosc_argument(msg, 0).f; \
             rLIMIT(var, atof) \
             rAPPLY(name[idx], f) \
-            data.broadcast(loc, "f", obj->name[idx]);\
+            data.broadcast(data.location(), "f", obj->name[idx]);\
+            rMarkChanged \
         } rBOILS_END
 
 #define rArrayTCb(name) rBOILS_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, obj->name[idx] ? "T" : "F"); \
+            data.reply(data.location(), obj->name[idx] ? "T" : "F"); \
         } else { \
             if(obj->name[idx] != rtosc_argument(msg, 0).T) { \
-                data.broadcast(loc, args);\
+                data.broadcast(data.location(), args);\
                 rChangeCb \
+                rMarkChanged \
             } \
             obj->name[idx] = rtosc_argument(msg, 0).T; \
         } rBOILS_END
 
 #define rArrayTCbMember(name, member) rBOILS_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, obj->name[idx].member ? "T" : "F"); \
+            data.reply(data.location(), obj->name[idx].member ? "T" : "F"); \
         } else { \
             if(obj->name[idx].member != rtosc_argument(msg, 0).T) { \
-                data.broadcast(loc, args);\
+                data.broadcast(data.location(), args);\
                 rChangeCb \
+                rMarkChanged \
             } \
             obj->name[idx].member = rtosc_argument(msg, 0).T; \
         } rBOILS_END
@@ -485,13 +498,14 @@ template<class T> constexpr T spice(T*t) {return *t;}
 
 #define rArrayICb(name) rBOILS_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "i", obj->name[idx]); \
+            data.reply(data.location(), "i", obj->name[idx]); \
         } else { \
             char var = rtosc_argument(msg, 0).i; \
             rLIMIT(var, atoi) \
             rAPPLY(name[idx], i) \
-            data.broadcast(loc, "i", obj->name[idx]);\
+            data.broadcast(data.location(), "i", obj->name[idx]);\
             rChangeCb \
+            rMarkChanged \
         } rBOILS_END
 
 
@@ -500,17 +514,22 @@ template<class T> constexpr T spice(T*t) {return *t;}
     rBOILS_END
 
 #define rParamsCb(name, length) rBOIL_BEGIN \
-    data.reply(loc, "b", length, obj->name); rBOIL_END
+    data.reply(data.location(), "b", length, obj->name); rBOIL_END
 
 #define rStringCb(name, length) rBOIL_BEGIN \
         if(!strcmp("", args)) {\
-            data.reply(loc, "s", obj->name); \
+            data.reply(data.location(), "s", obj->name); \
         } else { \
             strncpy(obj->name, rtosc_argument(msg, 0).s, length-1); \
             obj->name[length-1] = '\0'; \
-            data.broadcast(loc, "s", obj->name);\
+            data.broadcast(data.location(), "s", obj->name);\
             rChangeCb \
+            rMarkChanged \
         } rBOIL_END
 
 
+//Precomputed dispatch hash, see rtosc::MagicFormatter
+#define rMagic(table) reinterpret_cast<const char*>(table), sizeof(table)
+
+
 #endif
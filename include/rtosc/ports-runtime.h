@@ -31,6 +31,7 @@
 
 #include <cstddef>
 #include <rtosc/rtosc.h>
+#include <rtosc/pretty-format.h>
 
 namespace rtosc {
 namespace helpers {
@@ -39,6 +40,10 @@ namespace helpers {
  * @brief Returns a port's value pretty-printed from a runtime object. The
  *        port object must not be known.
  *
+ * This is meant for displaying values. For comparing or storing values, use
+ * the overloads returning rtosc_arg_val_t, which need no printing and
+ * scanning.
+ *
  * For the parameters, see the overloaded function
  * @return The argument values, pretty-printed
  */
@@ -48,6 +53,23 @@ const char* get_value_from_runtime(void* runtime, const struct Ports& ports,
                                    std::size_t buffersize,
                                    int cols_used);
 
+/**
+ * @brief Returns a port's value from a runtime object as rtosc_arg_val_t.
+ *        The port object must not be known.
+ *
+ * Like the pretty-printing overload, the port is found by dispatching
+ * @p buffer_with_port at @p ports, but the reply is stored typed.
+ *
+ * @param arena The arena to append the values to. Strings and blobs of the
+ *   reply are copied into it, so they stay valid after the call.
+ * @return The number of values appended, or -1 if the port did not reply or
+ *   memory could not be allocated
+ */
+int get_value_from_runtime(void* runtime, const struct Ports& ports,
+                           size_t loc_size, char* loc,
+                           char* buffer_with_port, std::size_t buffersize,
+                           rtosc_arg_val_arena* arena);
+
 /**
  * @brief Returns a port's current value(s)
  *
@@ -72,6 +94,55 @@ size_t get_value_from_runtime(void* runtime, const struct Port& port,
                               char* buffer_with_port, std::size_t buffersize,
                               std::size_t max_args, rtosc_arg_val_t* arg_vals);
 
+/**
+ * @brief Returns the runtime object of a subtree port's child
+ *
+ * This does what walk_ports() does to find the runtime object of a subtree:
+ * it dispatches a (non-existing) "pointer" port to @p port, which makes the
+ * rRecur* callbacks store the child object.
+ * @param runtime The runtime object of the Ports containing @p port
+ * @param port A port with subports
+ * @param name The port's name with array indices, e.g. "voice3/", must end
+ *   with a slash
+ * @return The child's runtime object, or NULL if the child does not exist
+ */
+void* get_child_runtime(void* runtime, const struct Port& port,
+                        const char* name);
+
+//! One port value to be queried by get_values_from_runtime()
+struct value_query_t
+{
+    const char* path;   //!< absolute path of the port, e.g. "/voice0/freq"
+    std::size_t offset; //!< output: index of the first value in arg_vals
+    int nargs;          //!< output: number of values, or -1 on failure
+};
+
+/**
+ * @brief Returns the current value(s) of multiple ports
+ *
+ * The queries are grouped by parent path, and the runtime object of each
+ * parent is only resolved once, before all its children are queried.
+ * The values are stored contiguously in @p arg_vals, in the order of the
+ * groups; each query tells where its values are.
+ *
+ * A query fails if its port or one of its parents can not be found, if the
+ * runtime object of a parent is NULL, or if its values do not fit into
+ * @p arg_vals anymore.
+ *
+ * @param runtime The runtime object of @p root
+ * @param root The Ports where the queried paths start
+ * @param queries The queries, which will be filled with the results
+ * @param nqueries Number of queries
+ * @param max_args Maximum capacity of @p arg_vals
+ * @param arg_vals Argument buffer for returned argument values
+ * @return The number of argument values stored in @p arg_vals
+ */
+std::size_t get_values_from_runtime(void* runtime, const struct Ports& root,
+                                    value_query_t* queries,
+                                    std::size_t nqueries,
+                                    std::size_t max_args,
+                                    rtosc_arg_val_t* arg_vals);
+
 // TODO: loc should probably not be passed,
 //       since it can be allocated in constant time?
 // TODO: clean up those funcs:
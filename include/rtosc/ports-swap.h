@@ -0,0 +1,99 @@
+/**
+ * @file ports-swap.h
+ * Replacing port trees while the realtime thread dispatches into them
+ *
+ * @test ports-swap.cpp
+ */
+
+#ifndef RTOSC_PORTS_SWAP_H
+#define RTOSC_PORTS_SWAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * Holder of a Ports tree which can be replaced without locking dispatch
+ *
+ * This works like RCU: the non-realtime thread builds a new tree and
+ * publishes it with one atomic store. The realtime thread keeps dispatching
+ * into whichever tree it has loaded, and calls quiescent() whenever it does
+ * not use any tree, e.g. at the end of each audio period. A replaced tree is
+ * deleted by reclaim() once the realtime thread has been quiescent after the
+ * replacement, so neither thread ever waits for the other.
+ *
+ * There must be one realtime thread reading current() (or dispatching), and
+ * one other thread calling publish() and reclaim(). Trees must not be
+ * shared with other holders, since the holder deletes them.
+ *
+ * port() returns a Port which dispatches into the current tree, to mount it
+ * into a static tree. Walkers like walk_ports() do not descend into it,
+ * because a Port can not point to a changing tree; the non-realtime thread
+ * can walk current() directly.
+ */
+class PortsSwap
+{
+    public:
+        //! @param initial The first tree, owned by the holder, or NULL
+        explicit PortsSwap(Ports *initial = nullptr);
+        //! Deletes all trees, so the realtime thread must not use them anymore
+        ~PortsSwap(void);
+        PortsSwap(const PortsSwap&) = delete;
+
+        /**
+         * Make @p ports the current tree, and retire the previous one
+         *
+         * Non-realtime only. The tables of @p ports are built first (see
+         * Ports::prepare()), and the holder owns @p ports from now on.
+         */
+        void publish(Ports *ports);
+        /**
+         * Delete the retired trees which the realtime thread cannot use
+         * anymore; non-realtime only
+         * @return The number of trees still waiting for a grace period
+         */
+        std::size_t reclaim(void);
+
+        //! The current tree, or NULL; valid until the caller's quiescent()
+        const Ports *current(void) const
+        {
+            return cur.load(std::memory_order_acquire);
+        }
+        //! Signal that the realtime thread holds no trees loaded before
+        void quiescent(void)
+        {
+            rt_epoch.store(epoch.load(std::memory_order_acquire),
+                           std::memory_order_release);
+        }
+
+        //! Dispatch @p m to the current tree, if any
+        void dispatch(const char *m, RtData &d, bool base_dispatch = false)
+                     const;
+        /**
+         * A port which dispatches into the current tree
+         * @param name The subtree's name, ending in '/', e.g. "plugin/"
+         */
+        Port port(const char *name, const char *metadata = "") const;
+
+    private:
+        static void dispatch_cb(const char *m, RtData &d, void *swap);
+
+        struct retired_t
+        {
+            Ports   *ports;
+            uint64_t epoch; //!< publish which replaced the tree
+        };
+
+        std::atomic<Ports*>   cur;
+        std::atomic<uint64_t> epoch;    //!< number of publishes
+        std::atomic<uint64_t> rt_epoch; //!< epoch at the last quiescent()
+        std::vector<retired_t> retired;
+};
+
+}
+
+#endif
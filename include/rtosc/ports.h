@@ -31,9 +31,11 @@
 #ifndef RTOSC_PORTS
 #define RTOSC_PORTS
 
+#include <atomic>
 #include <vector>
 #include <functional>
 #include <initializer_list>
+#include <type_traits>
 #include <rtosc/rtosc.h>
 #include <string>
 #include <cstdio>
@@ -46,6 +48,93 @@ typedef const char *msg_t;
 
 struct Port;
 struct Ports;
+class DispatchCache;
+class DispatchProfiler;
+class ChangeTracker;
+class RtChecker;
+
+/**
+ * Stack of the array indices of the subtrees being dispatched through
+ *
+ * Index 0 is the innermost (last pushed) index, 1 the one above and so on.
+ * Pushing and popping is O(1). The inline storage holds default_depth
+ * indices; set_storage() provides more without allocating. Indices pushed
+ * beyond the capacity are counted, but not stored, and read as 0.
+ */
+class IndexStack
+{
+    public:
+        enum { default_depth = 16 };
+
+        IndexStack(void)
+            :data(inline_data), capacity(default_depth), depth(0), scratch(0)
+        {}
+        IndexStack(const IndexStack &other) : IndexStack() { *this = other; }
+        IndexStack &operator=(const IndexStack &other)
+        {
+            if(this == &other)
+                return *this;
+            if(other.data != other.inline_data) { //shared external storage
+                data     = other.data;
+                capacity = other.capacity;
+            } else {
+                data     = inline_data;
+                capacity = default_depth;
+                for(int i=0; i<other.stored(); ++i)
+                    inline_data[i] = other.data[i];
+            }
+            depth   = other.depth;
+            scratch = other.scratch;
+            return *this;
+        }
+
+        /**
+         * Use @p storage for up to @p size indices, keeping the current ones
+         * as far as they fit. The storage must outlive its use, also by
+         * copies of this stack.
+         */
+        void set_storage(int *storage, int size)
+        {
+            const int n = stored() < size ? stored() : size;
+            for(int i=0; i<n; ++i)
+                storage[i] = data[i];
+            data     = storage;
+            capacity = size;
+        }
+
+        void push(int index)
+        {
+            if(depth < capacity)
+                data[depth] = index;
+            ++depth;
+        }
+        void pop(void) { if(depth) --depth; }
+        void clear(void) { depth = 0; }
+
+        //! Number of pushed indices
+        int size(void) const { return depth; }
+
+        //! The index @p level levels above the innermost one
+        int operator[](int level) const
+        {
+            const int i = depth - 1 - level;
+            return (i >= 0 && i < capacity && level >= 0) ? data[i] : scratch;
+        }
+        int &operator[](int level)
+        {
+            const int i = depth - 1 - level;
+            return (i >= 0 && i < capacity && level >= 0) ? data[i] : scratch;
+        }
+
+    private:
+        int stored(void) const { return depth < capacity ? depth : capacity; }
+
+        int *data;
+        int  capacity;
+        int  depth;
+        int  scratch; //!< read and written for levels outside of the stack
+        int  inline_data[default_depth];
+};
 
 //! data object for the dispatch routine
 struct RtData
@@ -60,6 +149,24 @@ struct RtData
      */
     char *loc;
     size_t loc_size;
+
+    /**
+     * If true, dispatch only records the location on a stack of segments,
+     * while loc is being left untouched. Callbacks must then use location()
+     * instead of loc, which writes the location to loc on demand.
+     */
+    bool lazy_loc;
+    enum { max_loc_depth = 32 };
+    struct {
+        const char *str;
+        int         len;
+    } loc_stack[max_loc_depth]; //!< segments of the lazy location
+    int loc_depth;
+    void push_loc(const char *str, int len);
+    void pop_loc(void) { --loc_depth; }
+    //! The current location; written to loc first if lazy_loc is set
+    const char *location(void) const;
+
     void *obj;        //!< runtime object to dispatch this object to
     int  matches;     //!< number of matches returned from dispatch routine
     const Port *port; //!< dispatch will write the matching port's pointer here
@@ -67,9 +174,21 @@ struct RtData
     //!   a base dispatch
     const char *message;
 
-    int idx[16];
-    void push_index(int ind);
-    void pop_index(void);
+    //! Array indices, idx[0] being the innermost one
+    IndexStack idx;
+    void push_index(int ind) { idx.push(ind); }
+    void pop_index(void) { idx.pop(); }
+    //! The index @p level levels above the innermost one
+    int index(int level = 0) const { return idx[level]; }
+
+    //! If non-NULL, dispatch reports each leaf port it calls to this cache
+    DispatchCache *cache;
+    //! If non-NULL, dispatch calls each leaf port through this profiler
+    DispatchProfiler *profiler;
+    //! If non-NULL, dispatch calls each leaf port through this checker
+    RtChecker *checker;
+    //! If non-NULL, the setters of port-sugar.h report changes to this
+    ChangeTracker *changes;
 
     virtual void replyArray(const char *path, const char *args,
             rtosc_arg_t *vals);
@@ -91,6 +210,100 @@ struct RtData
 };
 
 
+/**
+ * Callback of a Port, a small replacement for std::function
+ *
+ * Plain functions and lambdas without captures (e.g. all callbacks from
+ * port-sugar.h) are stored as a function pointer and called directly. A
+ * function taking an extra context pointer can be stored together with its
+ * context. Any other callable is kept in a heap allocated std::function.
+ */
+class PortCallback
+{
+    public:
+        typedef void (*fn_t)(msg_t, RtData&);
+        typedef void (*ctx_fn_t)(msg_t, RtData&, void*);
+        typedef std::function<void(msg_t, RtData&)> function_t;
+
+        PortCallback(void) : call(NULL) { data.fn = NULL; }
+        PortCallback(fn_t fn) : call(NULL) { data.fn = fn; }
+        PortCallback(ctx_fn_t fn, void *ctx) : call(fn) { data.ctx = ctx; }
+
+        template<class F, typename std::enable_if<
+            std::is_convertible<F, fn_t>::value, int>::type = 0>
+        PortCallback(F f) : call(NULL) { data.fn = f; }
+
+        template<class F, typename std::enable_if<
+            !std::is_convertible<F, fn_t>::value && !std::is_integral<F>::value &&
+            !std::is_same<typename std::decay<F>::type, PortCallback>::value,
+            int>::type = 0>
+        PortCallback(F f) : PortCallback(function_t(std::move(f))) {}
+
+        PortCallback(function_t f)
+            :call(NULL)
+        {
+            data.fn = NULL;
+            if(fn_t *fn = f.template target<fn_t>())
+                data.fn = *fn;
+            else if(f)
+                call = &call_function, data.ctx = new function_t(std::move(f));
+        }
+
+        PortCallback(const PortCallback &c) : call(c.call), data(c.data)
+        {
+            if(owns())
+                data.ctx = new function_t(*(function_t*)c.data.ctx);
+        }
+        PortCallback(PortCallback &&c) noexcept : call(c.call), data(c.data)
+        {
+            c.call    = NULL;
+            c.data.fn = NULL;
+        }
+        PortCallback &operator=(PortCallback c)
+        {
+            std::swap(call, c.call);
+            std::swap(data, c.data);
+            return *this;
+        }
+        ~PortCallback(void)
+        {
+            if(owns())
+                delete (function_t*)data.ctx;
+        }
+
+        void operator()(msg_t m, RtData &d) const
+        {
+            if(call)
+                call(m, d, data.ctx);
+            else
+                data.fn(m, d);
+        }
+
+        explicit operator bool(void) const { return call || data.fn; }
+
+        //! The plain function pointer, or NULL for other callbacks
+        fn_t function(void) const { return call ? NULL : data.fn; }
+        //! Bytes of the heap allocated std::function, if any, not counting
+        //! what it allocates for large captures
+        size_t heap_size(void) const
+        {
+            return owns() ? sizeof(function_t) : 0;
+        }
+
+    private:
+        static void call_function(msg_t m, RtData &d, void *f)
+        {
+            (*(function_t*)f)(m, d);
+        }
+        bool owns(void) const { return call == &call_function; }
+
+        ctx_fn_t call; //!< NULL if data.fn is to be called
+        union {
+            fn_t  fn;
+            void *ctx;
+        } data;
+};
+
 /**
  * Port in rtosc dispatching hierarchy
  */
@@ -98,7 +311,30 @@ struct Port {
     const char  *name;    //!< Pattern for messages to match
     const char  *metadata;//!< Statically accessable data about port
     const Ports *ports;   //!< Pointer to further ports
-    std::function<void(msg_t, RtData&)> cb;//!< Callback for matching functions
+    PortCallback cb;      //!< Callback for matching functions
+
+    /**
+     * Well-known metadata keys
+     *
+     * Containers returned by Ports::meta() find them in constant time,
+     * instead of walking the metadata string.
+     */
+    enum meta_key_t {
+        meta_parameter,       //!< "parameter"
+        meta_default,         //!< "default"
+        meta_default_depends, //!< "default depends"
+        meta_enabled_by,      //!< "enabled by"
+        meta_min,             //!< "min"
+        meta_max,             //!< "max"
+        meta_scale,           //!< "scale"
+        meta_no_walk,         //!< "no walk"
+        meta_internal,        //!< "internal"
+        meta_key_count
+    };
+    //! The titles of the meta_key_t keys
+    static const char *const meta_key_names[meta_key_count];
+
+    struct MetaIndex;
 
     class MetaIterator
     {
@@ -121,18 +357,34 @@ struct Port {
     class MetaContainer
     {
         public:
-            MetaContainer(const char *str_);
+            /**
+             * @param index_ Optional index of @p str_ for well-known keys,
+             *   see Ports::meta()
+             */
+            MetaContainer(const char *str_, const MetaIndex *index_ = NULL);
 
             MetaIterator begin(void) const;
             MetaIterator end(void) const;
 
             MetaIterator find(const char *str) const;
+            MetaIterator find(meta_key_t key) const;
             size_t length(void) const;
             //!Return the key to the value @p str, or NULL if the key is
             //!invalid or if there's no value for that key.
             const char *operator[](const char *str) const;
+            //!Like operator[](const char*), for a well-known key
+            const char *operator[](meta_key_t key) const;
 
             const char *str_ptr;
+            const MetaIndex *index;
+    };
+
+    //! Positions of the well-known keys in one port's metadata
+    struct MetaIndex
+    {
+        const char *title[meta_key_count]; //!< NULL if the key is missing
+        const char *value[meta_key_count]; //!< NULL if no value is given
+        explicit MetaIndex(const MetaContainer &meta);
     };
 
     MetaContainer meta(void) const
@@ -153,7 +405,13 @@ struct Port {
  * their respective ports.
  * That said, it is a very simple structure, which uses a stl container to store
  * all data in a simple dispatch table.
- * All methods post-initialization are RT safe (assuming callbacks are RT safe)
+ *
+ * The tables which speed up dispatching (hash, trie, metadata index, encoded
+ * defaults) are built on first use, so tables which are never used cost
+ * nothing at startup. Tables of Ports with the same port names share the
+ * name based parts. Building allocates, so call prepare() before dispatching
+ * from a realtime thread; after that, all methods are RT safe (assuming
+ * callbacks are RT safe).
  */
 struct Ports
 {
@@ -175,6 +433,13 @@ struct Ports
     const Port &operator[](unsigned i) const {return ports[i];}
 
     Ports(std::initializer_list<Port> l);
+    /**
+     * Construct the ports and take the dispatch hash from @p magic, which
+     * has been returned by saveMagic() earlier. If it does not fit these
+     * ports, the hash is generated as usual.
+     */
+    Ports(std::initializer_list<Port> l, const char *magic,
+          size_t magic_len);
     ~Ports(void);
 
     Ports(const Ports&) = delete;
@@ -199,8 +464,33 @@ struct Ports
      */
     void dispatch(const char *m, RtData &d, bool base_dispatch=false) const;
 
+    /**
+     * @brief Base dispatch of several messages, in order.
+     *
+     * This equals a base dispatch() of each message, but d is only set up
+     * once for all of them, e.g. the location buffer is only cleared once.
+     * After return, d.matches is the sum of all messages' matches.
+     *
+     * @param msgs Array of @p n valid OSC messages
+     */
+    void dispatch_batch(const char *const *msgs, size_t n, RtData &d) const;
+
+    /**
+     * @brief Base dispatch of all messages in a bundle, like dispatch_batch().
+     *
+     * Nested bundles are dispatched in place. Time tags are ignored, i.e. all
+     * messages are dispatched immediately.
+     *
+     * @param bundle A valid OSC bundle
+     * @param len The length of @p bundle
+     */
+    void dispatch_bundle(const char *bundle, size_t len, RtData &d) const;
+
     /**
      * Retrieve local port by name
+     *
+     * This is a hash lookup of the name up to the first ':', built on first
+     * use.
      * TODO implement full matching
      */
     const Port *operator[](const char *name) const;
@@ -212,6 +502,9 @@ struct Ports
      * @param path partial OSC path
      * @returns first path prefixed by the argument
      *
+     * Candidates are looked up in the prefix trie built on first use,
+     * instead of comparing every port.
+     *
      * Example usage:
      * @code
      *    Ports p = {{"foo",0,0,dummy_method},
@@ -232,12 +525,138 @@ struct Ports
      */
     static char *collapsePath(char *p);
 
+    /**
+     * Serialize the dispatch hash, so it does not need to be generated on
+     * the next launch. The data is meant for the same build on the same host.
+     *
+     * @returns The serialized hash, or an empty string if these ports are
+     *          dispatched without one
+     */
+    std::string saveMagic(void) const;
+
+    /**
+     * Pre-encoded default value of one of these ports
+     *
+     * The tables scan and canonicalize each port's "default" value
+     * once, unless it depends on other ports (see rDefaultDepends), so
+     * looking it up needs no parsing. The values are canonicalized for the
+     * port's own argument specs.
+     *
+     * @param p A port of these Ports
+     * @param args Will point to the values, which stay valid until the next
+     *   refreshMagic()
+     * @return The number of values, or -1 if @p p is not part of these Ports
+     *   or has no pre-encoded default value
+     */
+    int encodedDefault(const Port &p, const rtosc_arg_val_t **args) const;
+
+    /**
+     * Metadata of one of these ports, like Port::meta(), but with an index
+     * of the well-known keys (see Port::meta_key_t), which is built with the
+     * other tables
+     *
+     * For ports which are not part of these Ports, this is Port::meta().
+     */
+    Port::MetaContainer meta(const Port &p) const;
+
+    /**
+     * Counter which is increased each time refreshMagic() runs on any Ports.
+     * Caches derived from port trees compare it to notice stale entries.
+     */
+    static unsigned long magicGeneration(void);
+
+    /**
+     * Build the tables of these Ports and of all subtrees now
+     *
+     * Otherwise, each table is built when it is first used, e.g. by the first
+     * dispatch, which allocates. Building is thread safe, but it blocks
+     * other threads which build tables at the same time.
+     */
+    void prepare(void) const;
+    //! Whether the tables of these Ports (not of the subtrees) are built
+    bool prepared(void) const;
+
+    //! Bytes used by one Ports object, without its subtrees
+    struct memory_t
+    {
+        size_t ports;      //!< this object and its Port entries
+        size_t callbacks;  //!< heap allocated callbacks, see
+                           //!< PortCallback::heap_size()
+        size_t strings;    //!< names and metadata, usually static data
+        size_t matcher;    //!< name based tables, maybe shared
+        size_t tables;     //!< metadata index and encoded defaults
+        size_t hash_slots; //!< slots of the perfect hash, 0 if none
+        const void *matcher_id; //!< equal for Ports sharing the matcher
+        long matcher_users;     //!< number of Ports sharing the matcher
+    };
+    /**
+     * Report the memory used by these Ports
+     *
+     * Tables which are not built yet (see prepare()) count as 0 bytes.
+     */
+    memory_t memoryUsage(void) const;
+
     protected:
-    void refreshMagic(void);
+    //! Drop the tables, so they are built from the current ports on next use
+    void refreshMagic(const char *magic = NULL, size_t magic_len = 0);
     private:
+    const class Port_Tables &tables(void) const;
+    const class Port_Tables &build_tables(void) const;
+    const Port *apropos_linear(const char *path) const;
     //Performance hacks
-    class Port_Matcher *impl;
-    unsigned elms;
+    mutable std::atomic<const class Port_Tables*> impl;
+    std::string pending_magic; //!< saved hash for the next build
+};
+
+/**
+ * Cache for repeatedly dispatched addresses
+ *
+ * The first dispatch of an address records which leaf ports get called,
+ * together with d.obj, d.idx and d.loc at that time. Further messages with
+ * the same address and argument types call the leaf callbacks directly,
+ * without walking the tree.
+ *
+ * This is only correct as long as the callbacks of the subtree ports do
+ * nothing but prepare d for the next level, as the sugar's rRecur* will.
+ * Entries are dropped automatically when any refreshMagic() runs, and
+ * invalidate() must be called when objects on the recorded path are
+ * reallocated. Dispatching does not allocate, but the cache is not thread
+ * safe, so each dispatching thread needs its own.
+ */
+class DispatchCache
+{
+    public:
+        enum {
+            max_key    = 128, //!< maximum of address + argument types
+            max_loc    = 128, //!< maximum recorded location length
+            max_leaves = 4    //!< maximum leaves called by one address
+        };
+
+        //! @param entries Number of cached addresses, rounded to 2^n
+        DispatchCache(unsigned entries = 256);
+        ~DispatchCache(void);
+        DispatchCache(const DispatchCache&) = delete;
+
+        //! Base dispatch of @p m to @p root, using the cache if possible
+        void dispatch(const Ports &root, const char *m, RtData &d);
+
+        //! Drop all entries
+        void invalidate(void);
+        //! Drop all entries whose address starts with @p prefix
+        void invalidate(const char *prefix);
+
+        //! Called by dispatch for each leaf, or with NULL if a default
+        //! handler is called
+        void record(const Port *port, const char *m, const RtData &d);
+
+        unsigned long hits, misses;
+
+    private:
+        struct entry_t;
+        entry_t      *entries;
+        entry_t      *recording;
+        unsigned      mask;
+        unsigned long generation;
 };
 
 struct ClonePort
@@ -246,15 +665,35 @@ struct ClonePort
     std::function<void(msg_t, RtData&)> cb;
 };
 
+/**
+ * Ports copied from another Ports object, with new callbacks
+ *
+ * Each ClonePort names a port of @p p by its full name (including the
+ * argument spec). If @p p contains a name more than once, the last port of
+ * that name is cloned. The name "*" sets the default handler. As for Ports,
+ * @p magic can be a hash table saved by saveMagic().
+ */
 struct ClonePorts:public Ports
 {
     ClonePorts(const Ports &p,
-               std::initializer_list<ClonePort> c);
+               std::initializer_list<ClonePort> c,
+               const char *magic = NULL, size_t magic_len = 0);
 };
 
+/**
+ * Union of several Ports objects
+ *
+ * The ports are taken in the order of @p c. If a full port name (including
+ * the argument spec) occurs more than once, the first port wins, i.e. ports
+ * of earlier Ports objects override the ones of later Ports objects. Ports
+ * of the same path, but with other argument specs, are all kept. As for
+ * Ports, @p magic can be a hash table saved by saveMagic(), which skips the
+ * hash generation.
+ */
 struct MergePorts:public Ports
 {
-    MergePorts(std::initializer_list<const Ports*> c);
+    MergePorts(std::initializer_list<const Ports*> c,
+               const char *magic = NULL, size_t magic_len = 0);
 };
 
 /**
@@ -316,7 +755,9 @@ typedef void(*port_walker_t)(const Port*,const char*,const char*,
  *   invokes walking over each of the bundle's port
  * @param runtime Runtime object corresponding to @p base . If given, checks
  *   the runtime object will be used stop recursion if the Ports are disabled
- *   (using the "enabled by" property) and it will be passed to the walker
+ *   (using the "enabled by" property) and it will be passed to the walker.
+ *   Each "enabled by" toggle is only queried once per walk, so walkers
+ *   which change toggles do not affect the ports walked in the same walk.
  */
 void walk_ports(const Ports *base,
                 char          *name_buffer,
@@ -326,6 +767,175 @@ void walk_ports(const Ports *base,
                 bool expand_bundles = true,
                 void *runtime = NULL);
 
+/**
+ * Call a function on one port of @p base and on all of its subports
+ *
+ * This is one step of walk_ports(), which calls it for all ports of
+ * @p base. It can be used to split a walk, e.g. to walk subtrees on different
+ * threads. Other than walk_ports(), it does not check whether @p base itself
+ * is enabled.
+ * @param p The port, which must be one of @p base
+ * @param name_buffer The location of @p base, followed by zeros
+ * @param index For port arrays with subports (e.g. "voice#8/"), only walk
+ *   the subtree with this index; -1 walks all subtrees
+ * @see walk_ports
+ */
+void walk_port(const Ports *base,
+               const Port   &p,
+               char          *name_buffer,
+               size_t         buffer_size,
+               void          *data,
+               port_walker_t  walker,
+               bool expand_bundles = true,
+               void *runtime = NULL,
+               int index = -1);
+
+/**
+ * Lazy walk over all ports and subports
+ *
+ * Visits the same ports as walk_ports(), in the same order and with the same
+ * checks of the runtime object, but yields them one after another, using an
+ * explicit stack. Walks can thus be stopped early, interleaved, or feed
+ * other consumers without collecting all ports first.
+ *
+ * @code
+ *     for(const PortWalk::item_t &item : PortWalk(ports, runtime))
+ *         if(!strcmp(item.path, "/volume"))
+ *             break;
+ * @endcode
+ * @note An item, including its path, is only valid until the next step
+ */
+class PortWalk
+{
+    public:
+        //! The arguments which the walker would get from walk_ports()
+        struct item_t
+        {
+            const Port  *port;
+            const char  *path;           //!< absolute location
+            const char  *path_from_base; //!< the part of the port itself
+            const Ports *base;
+            void        *runtime;
+        };
+
+        /**
+         * @param runtime Runtime object of @p root, see walk_ports()
+         * @param expand_bundles See walk_ports()
+         * @param buffer_size Maximum length of paths
+         */
+        explicit PortWalk(const Ports &root, void *runtime = NULL,
+                          bool expand_bundles = true,
+                          size_t buffer_size = 1024);
+
+        //! Step to the next port, @returns false if the walk is finished
+        bool next(void);
+        //! The current port, after next() returned true
+        const item_t &get(void) const { return cur; }
+
+        class iterator
+        {
+            public:
+                explicit iterator(PortWalk *walk = NULL) : walk(walk) {}
+                const item_t &operator*() const { return walk->get(); }
+                const item_t *operator->() const { return &walk->get(); }
+                iterator &operator++()
+                {
+                    if(!walk->next())
+                        walk = NULL;
+                    return *this;
+                }
+                bool operator==(const iterator &o) const
+                {
+                    return walk == o.walk;
+                }
+                bool operator!=(const iterator &o) const
+                {
+                    return walk != o.walk;
+                }
+            private:
+                PortWalk *walk;
+        };
+        //! Steps to the first port, so it can only be called once
+        iterator begin(void) { return ++iterator(this); }
+        iterator end(void) { return iterator(); }
+
+    private:
+        struct frame_t
+        {
+            const Ports *ports;
+            size_t idx;      //!< current port of ports
+            unsigned elem;   //!< next array index of the current port
+            size_t base_len; //!< length of the location of ports
+            void *runtime;
+        };
+        void push(const Ports &ports, size_t base_len, void *runtime);
+
+        std::vector<frame_t> stack;
+        std::vector<char> name_buffer;
+        bool expand;
+        item_t cur;
+};
+
+/**
+ * @brief Check if the port @p port is enabled
+ * @param port The port to be checked. Usually of type rRecur* or rSelf.
+ * @param loc The absolute path of @p port
+ * @param loc_size The maximum usable size of @p loc
+ * @param base The Ports object containing @p port
+ * @param runtime The runtime object (optional)
+ * @return True if no runtime is provided or @p port has no enabled property.
+ *         Otherwise, the state of the "enabled by" toggle. When called from
+ *         inside walk_ports(), this state is cached for the rest of the walk.
+ */
+bool port_is_enabled(const Port* port, char* loc, size_t loc_size,
+                     const Ports& base, void *runtime);
+
+/**
+ * Preallocated cache for the "enabled by" states of walks
+ *
+ * Each walk_ports() call with a runtime object caches the states which
+ * port_is_enabled() queried, in a map which allocates. While a
+ * WalkEnabledCache is installed on a thread, the walks of this thread use it
+ * instead, which does not allocate: it is cleared at the start of each walk,
+ * and states which do not fit anymore are queried again each time. The cache
+ * is not thread safe, so each walking thread needs its own.
+ */
+class WalkEnabledCache
+{
+    public:
+        enum { max_loc = 128 }; //!< states at longer locations are not cached
+        //! @param entries Number of cached states, rounded to 2^n
+        explicit WalkEnabledCache(unsigned entries = 64);
+        ~WalkEnabledCache(void);
+        WalkEnabledCache(const WalkEnabledCache&) = delete;
+        //! Use this cache for the walks of the calling thread
+        void install(void);
+        //! Let the walks of the calling thread use their own caches again
+        void uninstall(void);
+
+        //! @return The cached state (0 or 1), or -1 if it is not cached
+        int find(const void *runtime, const Port *toggle,
+                 const char *loc) const;
+        void insert(const void *runtime, const Port *toggle, const char *loc,
+                    bool enabled);
+        //! Drop all states
+        void clear(void);
+    private:
+        struct entry_t
+        {
+            const void *runtime;
+            const Port *toggle; //!< NULL for unused entries
+            bool        enabled;
+            char        loc[max_loc];
+        };
+        unsigned slot(const void *runtime, const Port *toggle,
+                      const char *loc) const;
+        entry_t  *table;
+        unsigned *used;
+        unsigned  mask, nused;
+        WalkEnabledCache *outer; //!< the cache installed before this one
+};
+
 /**
  * Returns paths and metadata of all direct children of a port, or of the port
  * itself if that port has no children.
@@ -396,5 +1006,23 @@ struct OscDocFormatter
 };
 
 std::ostream &operator<<(std::ostream &o, OscDocFormatter &formatter);
+
+/**
+ * Writes the dispatch hash of @p p as a C array definition, which can be
+ * compiled in and passed to the Ports constructor using rMagic(), e.g.:
+ * @code
+ *    #include "voice-magic.h" // static const uint32_t voice_magic[] = ...
+ *    Ports voicePorts({...}, rMagic(voice_magic));
+ * @endcode
+ * Tables that do not fit the ports (anymore) are ignored, so a stale file
+ * only costs the usual hash generation.
+ */
+struct MagicFormatter
+{
+    const Ports *p;
+    std::string name; //!< name of the generated array
+};
+
+std::ostream &operator<<(std::ostream &o, const MagicFormatter &formatter);
 };
 #endif
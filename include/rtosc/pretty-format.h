@@ -45,6 +45,9 @@ typedef struct
     const char* sep; //!< separator for multiple argument values
     int linelength;
     int compress_ranges;
+    //! print floats as the shortest decimal which reads back exactly,
+    //! instead of using floating_point_precision and lossless
+    bool shortest_floats;
 } rtosc_print_options;
 
 /**
@@ -97,6 +100,47 @@ size_t rtosc_print_message(const char* address,
                            const rtosc_print_options* opt,
                            int cols_used);
 
+/**
+ * Receiver of printed text
+ * @param str The text, which is not null terminated
+ * @param len Number of bytes in @p str
+ * @param data User data
+ * @return 0 to continue, non-zero to stop printing
+ */
+typedef int (*rtosc_print_sink)(const char* str, size_t len, void* data);
+
+/**
+ * Pretty-print rtosct_arg_val_t array to a sink
+ *
+ * The output is the same as the one of rtosc_print_arg_vals(), but no output
+ * buffer is required, and the sink gets the text in chunks while it is being
+ * printed. No whitespace is required in front of the values, a line break
+ * in front of the first value is written as a newline.
+ *
+ * @param sink The sink which receives the text
+ * @param data User data passed to the sink
+ * @return The number of bytes passed to the sink, which is less than the
+ *   whole text if the sink stopped printing
+ * @see rtosc_print_arg_vals
+ */
+size_t rtosc_print_arg_vals_to_sink(const rtosc_arg_val_t *args, size_t n,
+                                    rtosc_print_sink sink, void* data,
+                                    const rtosc_print_options* opt,
+                                    int cols_used);
+
+/**
+ * Pretty-print OSC message to a sink
+ *
+ * The output is the same as the one of rtosc_print_message().
+ *
+ * @see rtosc_print_arg_vals_to_sink
+ */
+size_t rtosc_print_message_to_sink(const char* address,
+                                   const rtosc_arg_val_t *args, size_t n,
+                                   rtosc_print_sink sink, void* data,
+                                   const rtosc_print_options* opt,
+                                   int cols_used);
+
 /**
  * Skip characters from a string until one argument value
  *   would have been scanned
@@ -108,7 +152,8 @@ size_t rtosc_print_message(const char* address,
  *   (it will get the left of left hand sign of this argument)
  * @param follow_ellipsis Whether an argument followed by an ellipsis is
  *   interpreted as a range start or as only the argument itself
- * @param inside_bundle Whether the current position is inside a bundle
+ * @param inside_bundle Whether the current position is inside an array;
+ *   the nesting depth of arrays, which is limited to 32
  * @return The first character after that argument value, or NULL if a
  *   parsing error occurred
  */
@@ -201,6 +246,96 @@ size_t rtosc_scan_message(const char* src,
                           rtosc_arg_val_t *args, size_t n,
                           char* buffer_for_strings, size_t bufsize);
 
+/**
+ * Growable storage for scanned argument values and their strings
+ *
+ * Scanning into an arena needs no preceding call to
+ * rtosc_count_printed_arg_vals(): each argument value is syntax checked
+ * right before it is scanned, and the arena grows as required. Scanned
+ * values are appended, so an arena can hold the arguments of a whole load
+ * or parse pass. Strings and blobs of the values point into the arena. They
+ * are stored in chunks which never move, so pointers to them stay valid
+ * until the arena is cleared or destroyed, which frees all of them at once.
+ * With rtosc_arg_val_arena_intern(), equal strings and blobs are only stored
+ * once.
+ */
+typedef struct
+{
+    rtosc_arg_val_t *args; //!< all scanned argument values
+    size_t nargs;          //!< number of values in args
+    size_t args_capacity;
+    char *strbuf;          //!< newest chunk for scanned strings and blobs
+    size_t strbuf_used;    //!< bytes used in the newest chunk
+    size_t strbuf_capacity;
+    struct rtosc_arg_val_interned *interned; //!< NULL if not interning
+} rtosc_arg_val_arena;
+
+//! Initialize an empty arena
+void rtosc_arg_val_arena_init(rtosc_arg_val_arena* arena);
+//! Free all memory of the arena and make it empty
+void rtosc_arg_val_arena_destroy(rtosc_arg_val_arena* arena);
+//! Remove all values, but keep the memory of the newest chunk for further
+//! scans
+void rtosc_arg_val_arena_clear(rtosc_arg_val_arena* arena);
+/**
+ * Switch interning of strings and blobs on or off
+ *
+ * An interning arena keeps one copy of equal strings and blobs (compared by
+ * their bytes), which saves memory and lets values be compared by pointer,
+ * e.g. for savefiles with many equal strings. The values which are in the
+ * arena already are not interned.
+ * @return false if memory could not be allocated
+ */
+bool rtosc_arg_val_arena_intern(rtosc_arg_val_arena* arena, bool intern);
+/**
+ * Make sure that @p nargs more values fit into the arena without growing
+ * @return false if memory could not be allocated
+ */
+bool rtosc_arg_val_arena_reserve(rtosc_arg_val_arena* arena, size_t nargs);
+
+/**
+ * Append argument values to the arena
+ *
+ * Strings and blobs of the values are copied into the arena, so the values
+ * do not depend on the memory of @p args afterwards.
+ * @return false if memory could not be allocated
+ */
+bool rtosc_arg_val_arena_append(rtosc_arg_val_arena* arena,
+                                const rtosc_arg_val_t* args, size_t n);
+
+/**
+ * Check and scan argument values in a single pass
+ *
+ * Scanning stops at the end of @p src or at the next message's address.
+ * Preceding and trailing whitespace and comments are consumed.
+ *
+ * @param src The string to scan from
+ * @param arena The arena to append the values to
+ * @param rd If not NULL, the number of bytes scanned will be stored here
+ * @return The number of values appended to the arena (arrays and array
+ *   starts count as one value each), or -n if the nth value (range 1...)
+ *   could not be scanned, like rtosc_count_printed_arg_vals(). Values
+ *   before the erroneous one are kept in the arena.
+ */
+int rtosc_scan_arg_vals_arena(const char* src, rtosc_arg_val_arena* arena,
+                              size_t* rd);
+
+/**
+ * Check and scan an OSC message in a single pass
+ *
+ * @param src The string
+ * @param address A buffer where the port address will be written
+ * @param adrsize Size of buffer @p address
+ * @param arena The arena to append the argument values to
+ * @param rd If not NULL, the number of bytes scanned will be stored here
+ * @return The number of values appended, or an error code, as returned by
+ *   rtosc_count_printed_arg_vals_of_msg()
+ * @see rtosc_scan_arg_vals_arena
+ */
+int rtosc_scan_message_arena(const char* src,
+                             char* address, size_t adrsize,
+                             rtosc_arg_val_arena* arena, size_t* rd);
+
 #ifdef __cplusplus
 }
 #endif
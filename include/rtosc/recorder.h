@@ -0,0 +1,166 @@
+/**
+ * @file recorder.h
+ * Append-only binary logs of timestamped messages, and their replay
+ *
+ * @test recorder.cpp
+ */
+
+#ifndef RTOSC_RECORDER_H
+#define RTOSC_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <rtosc/thread-link.h>
+
+namespace rtosc {
+
+struct Ports;
+struct RtData;
+
+/*
+ * Log format
+ *
+ * The file starts with the 8 bytes "rtosclog", followed by the records. Each
+ * record is a 64 bit timetag and a 32 bit message length (both big endian,
+ * like in OSC), followed by the message itself. Messages are padded to 4
+ * bytes anyways, so the records stay aligned.
+ */
+
+/**
+ * Recorder of messages into a binary log
+ *
+ * The realtime thread calls record() for each message it receives or
+ * dispatches. This copies the message into a lock-free ring buffer, without
+ * allocating or blocking. Another thread calls flush() periodically, which
+ * appends all pending messages to the log file. The file is grown in chunks
+ * and written by memory mapping, so flushing does not need one system call
+ * per message.
+ *
+ * Messages that do not fit into the ring buffer are dropped.
+ */
+class Recorder
+{
+    public:
+        /**
+         * @param max_message_length Maximum length of a recorded message
+         * @param max_messages Number of messages the ring buffer can hold
+         */
+        Recorder(size_t max_message_length, size_t max_messages);
+        ~Recorder(void);
+        Recorder(const Recorder&) = delete;
+
+        //! Start a new log at @p path, @returns false on errors
+        bool open(const char *path);
+        //! Flush, then finish the log file
+        void close(void);
+        bool is_open(void) const { return fd >= 0; }
+
+        /**
+         * Queue @p msg for the log (realtime safe)
+         * @param timetag NTP timestamp of the message
+         */
+        void record(const char *msg, uint64_t timetag);
+        //! Queue @p msg, timestamped with now()
+        void record(const char *msg) { record(msg, now()); }
+
+        /**
+         * Append all queued messages to the log (not realtime safe)
+         * @returns the number of messages written
+         */
+        size_t flush(void);
+
+        //! Number of messages written to the log file
+        size_t size(void) const { return records; }
+
+        //! Current wall clock time as NTP timestamp
+        static uint64_t now(void);
+
+    private:
+        bool reserve(size_t len);
+
+        const size_t max_message_length;
+        ThreadLink link;
+        int        fd;
+        char      *map;
+        size_t     mapped;  //!< size of the file and its mapping
+        size_t     written; //!< bytes used in the file
+        size_t     records;
+};
+
+/**
+ * Read access to a binary log written by Recorder
+ *
+ * The log is memory mapped, so messages are returned in place, and opening
+ * large logs does not read them. A sparse index with the timetag of every
+ * index_stride-th record is built on opening, to seek to a time quickly.
+ */
+class LogReplay
+{
+    public:
+        LogReplay(void);
+        ~LogReplay(void);
+        LogReplay(const LogReplay&) = delete;
+
+        //! Open the log at @p path, @returns false on errors or invalid logs
+        bool open(const char *path);
+        void close(void);
+
+        //! Number of records in the log
+        size_t size(void) const { return records; }
+        //! Timetags of the first and last record (0 for empty logs)
+        uint64_t first_timetag(void) const { return first_tt; }
+        uint64_t last_timetag(void) const { return last_tt; }
+
+        //! Move to the first record with a timetag not less than @p timetag
+        void seek(uint64_t timetag);
+        //! Move to the first record
+        void rewind(void) { pos = header_size; }
+
+        /**
+         * Read the record at the current position and advance
+         * @param timetag receives its timetag, if non-NULL
+         * @returns the message, or NULL at the end of the log
+         */
+        const char *next(uint64_t *timetag = NULL);
+
+        //! Speed of replay()
+        enum speed_t {
+            max_speed,     //!< dispatch without waiting
+            original_speed //!< wait between messages as when recorded
+        };
+
+        /**
+         * Base dispatch all messages from the current position on to
+         * @p root, until (excluding) the first one with a timetag after
+         * @p until
+         * @returns the number of dispatched messages
+         */
+        size_t replay(const Ports &root, RtData &d,
+                      speed_t speed = max_speed,
+                      uint64_t until = (uint64_t)-1);
+
+        //! Number of records between two entries of the sparse index
+        enum { index_stride = 64 };
+
+    private:
+        struct index_entry_t
+        {
+            uint64_t timetag;
+            size_t   pos;
+        };
+
+        enum { header_size = 8 };
+
+        const char *map;
+        size_t      mapped;
+        size_t      length; //!< end of the last complete record
+        size_t      pos;
+        size_t      records;
+        uint64_t    first_tt, last_tt;
+        std::vector<index_entry_t> index;
+};
+
+}
+
+#endif
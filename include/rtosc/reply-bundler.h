@@ -0,0 +1,104 @@
+/**
+ * @file reply-bundler.h
+ * Collecting the replies of a dispatch into bundles
+ *
+ * @test reply-bundler.cpp
+ */
+
+#ifndef RTOSC_REPLY_BUNDLER_H
+#define RTOSC_REPLY_BUNDLER_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/thread-link.h>
+
+namespace rtosc {
+
+/**
+ * RtData which collects replies and broadcasts into bundles
+ *
+ * Requests which match many ports, like subtree queries, let each port reply
+ * separately, and each reply costs a transport send or a ThreadLink write.
+ * Dispatching with a ReplyBundler instead collects the replies (and, in
+ * another bundle, the broadcasts) with the streaming bundle writer. A full
+ * bundle is passed on at once, the rest at flush(), which dispatch() calls
+ * after dispatching.
+ *
+ * Bundles and messages go to a sink, with their lengths, since bundles do
+ * not encode their own length. A single pending message is passed on without
+ * a bundle, and messages which do not fit into an empty bundle are passed on
+ * at once.
+ *
+ * Like for any RtData, loc, obj etc. must be set on the bundler itself.
+ * Replying does not allocate.
+ */
+class ReplyBundler : public RtData
+{
+    public:
+        /**
+         * Receives a bundle or message of @p len bytes, @p broadcast tells
+         * whether it holds broadcasts or replies
+         */
+        typedef std::function<void(const char *msg, std::size_t len,
+                                   bool broadcast)> sink_t;
+
+        /**
+         * @param sink Where bundles and unbundled messages go
+         * @param max_size Maximum size of a bundle, e.g. the transport's MTU
+         */
+        explicit ReplyBundler(sink_t sink, std::size_t max_size = 1024);
+        ~ReplyBundler(void);
+        ReplyBundler(const ReplyBundler&) = delete;
+
+        //! Dispatch @p msg to @p ports, then flush()
+        void dispatch(const Ports &ports, const char *msg);
+        //! Pass on all pending replies and broadcasts
+        void flush(void);
+
+        using RtData::reply;
+        using RtData::broadcast;
+        void reply(const char *path, const char *args, ...) override;
+        void reply(const char *msg) override;
+        void replyArray(const char *path, const char *args,
+                        rtosc_arg_t *vals) override;
+        void broadcast(const char *path, const char *args, ...) override;
+        void broadcast(const char *msg) override;
+        void broadcastArray(const char *path, const char *args,
+                            rtosc_arg_t *vals) override;
+
+        //! Number of messages passed on so far, bundled or not
+        std::size_t messages(void) const { return nmessages; }
+        //! Number of bundles passed on so far
+        std::size_t bundles(void) const { return nbundles; }
+
+        //! Sink which writes everything to @p link
+        static sink_t link_sink(ThreadLink &link);
+
+    private:
+        struct pending_t
+        {
+            std::vector<char>   buffer;
+            rtosc_bundle_writer writer;
+            std::size_t         count; //!< messages in the writer
+            bool                broadcast;
+        };
+
+        void add(pending_t &p, const char *msg);
+        void add(pending_t &p, const char *path, const char *args,
+                 va_list va);
+        void add(pending_t &p, const char *path, const char *args,
+                 const rtosc_arg_t *vals);
+        void send(pending_t &p);
+        void pass_on(const pending_t &p, const char *msg, std::size_t len);
+
+        sink_t      sink;
+        pending_t   replies, broadcasts;
+        std::size_t nmessages, nbundles;
+};
+
+}
+
+#endif
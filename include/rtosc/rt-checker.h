@@ -0,0 +1,138 @@
+/**
+ * @file rt-checker.h
+ * Debug dispatch mode which finds port callbacks that are not realtime safe
+ *
+ * @test rt-checker.cpp
+ */
+
+#ifndef RTOSC_RT_CHECKER_H
+#define RTOSC_RT_CHECKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <rtosc/ports.h>
+
+namespace rtosc {
+
+/**
+ * Checks leaf port callbacks for calls which are not realtime safe
+ *
+ * Set RtData::checker to enable it. Dispatch then calls each leaf port
+ * through the checker, which marks the thread as being inside a callback
+ * and times the callback. The interposer library rtosc-rt-check replaces
+ * malloc(), calloc(), realloc(), free() and pthread_mutex_lock() (thus also
+ * operator new and std::mutex) by functions which report to the checker of
+ * the current thread, so linking it into a debug build reveals each port
+ * which allocates or blocks, together with the call it made. Without the
+ * interposer, only the times are recorded, and callbacks can still report
+ * calls themselves with note(). Dispatching into a Ports object which was
+ * not prepared is reported as the call "Ports::build_tables".
+ *
+ * The checker does not allocate while it checks a callback, but it is not
+ * thread safe, so each dispatching thread needs its own. If
+ * RtData::profiler is set, too, the callbacks are profiled as well.
+ */
+class RtChecker
+{
+    public:
+        enum {
+            max_path = 64,       //!< maximum recorded path length
+            max_violations = 256 //!< maximum number of distinct violations
+        };
+
+        //! A forbidden call, made by a port
+        struct violation_t
+        {
+            const Port *port;
+            char        path[max_path]; //!< location of the first call
+            const char *call;           //!< e.g. "malloc"
+            uint64_t    count;          //!< number of such calls
+        };
+
+        //! Times of one port
+        struct stats_t
+        {
+            const Port *port;
+            char        path[max_path]; //!< location of the worst call
+            uint64_t    calls;
+            uint64_t    max_ns;         //!< worst-case callback time
+        };
+
+        /**
+         * @param ports Maximum number of timed ports, rounded to 2^n
+         */
+        explicit RtChecker(unsigned ports = 4096);
+        ~RtChecker(void);
+        RtChecker(const RtChecker&) = delete;
+
+        //! Called by dispatch instead of calling the leaf's callback
+        void call(const Port &port, const char *m, RtData &d);
+
+        /**
+         * Report a forbidden call, if a checked callback runs on this thread
+         *
+         * This is called by the interposer and must not allocate.
+         */
+        static void note(const char *call);
+        /**
+         * Report a forbidden call which this checker's thread makes outside
+         * of callbacks, e.g. building the tables of a Ports object which
+         * dispatch() finds unprepared
+         *
+         * @param port The port which made the call, or NULL
+         * @param path The location, or the message
+         */
+        void report(const char *call, const Port *port, const char *path);
+        //! Whether a checked callback runs on the current thread
+        static bool active(void);
+        //! Whether the interposer library has been linked
+        static bool interposed(void);
+
+        /**
+         * Query every leaf port of @p ports once, through the checker
+         *
+         * The ports are found with walk_ports() and called without
+         * arguments, like when reading the values, at the runtime objects
+         * of their parents. Ports with the "internal" property are skipped.
+         * The tables of @p ports are built before, see Ports::prepare().
+         * @return The number of ports called
+         */
+        std::size_t exercise(const Ports &ports, void *runtime);
+
+        //! Drop all violations and times
+        void reset(void);
+
+        //! Number of distinct violations, i.e. pairs of port and call
+        unsigned violations(void) const { return nviolations; }
+        const violation_t &violation(unsigned i) const { return viol[i]; }
+        //! Violations which did not fit into the table anymore
+        uint64_t violation_overflow;
+
+        //! Number of timed ports
+        unsigned size(void) const { return nused; }
+        //! Times of the i-th timed port, in order of the first call
+        const stats_t &stats(unsigned i) const { return table[used[i]]; }
+        //! Worst-case time over all callbacks, and its port's stats
+        const stats_t *worst(void) const { return worst_stats; }
+
+    private:
+        stats_t *lookup(const Port &port);
+        void add_violation(const char *call, const Port *port,
+                           const char *path);
+
+        stats_t     *table;
+        unsigned    *used;
+        unsigned     mask, nused;
+        const stats_t *worst_stats;
+
+        violation_t  viol[max_violations];
+        unsigned     nviolations;
+
+        //! the port whose callback runs, and its location
+        const Port  *cur_port;
+        const char  *cur_path;
+};
+
+}
+
+#endif
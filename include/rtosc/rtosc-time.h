@@ -30,6 +30,7 @@
  * Functions and helper functions for conversion between time and arg vals
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -64,6 +65,83 @@ bool rtosc_arg_val_is_immediatelly(const rtosc_arg_val_t* arg);
 
 float rtosc_secfracs2float(uint64_t secfracs);
 
+/*
+ * fast timetags
+ */
+
+/**
+ * Clock which stamps timetags from the monotonic clock
+ *
+ * Calibration reads the wall clock once, each stamp then only reads the
+ * monotonic clock and converts the elapsed time with integer operations,
+ * without calls like time() or localtime(). The timetags have the same
+ * epoch as rtosc_arg_val_current_time(), but the full 1/2^32 s resolution.
+ * The clock does not follow changes of the wall clock, so programs which
+ * run for long should calibrate it again from time to time (not on the
+ * realtime thread, as the wall clock is read).
+ *
+ * Stamping is realtime safe and a calibrated clock can be shared between
+ * threads, as long as no thread calibrates it concurrently.
+ */
+typedef struct
+{
+    uint64_t base_tt; //!< timetag at calibration
+    uint64_t base_ns; //!< monotonic clock at calibration, in ns
+} rtosc_timetag_clock_t;
+
+void rtosc_timetag_clock_calibrate(rtosc_timetag_clock_t *clock);
+//! The current time as timetag
+uint64_t rtosc_timetag_clock_now(const rtosc_timetag_clock_t *clock);
+//! Timetag at a reading @p monotonic_ns of the monotonic clock
+uint64_t rtosc_timetag_clock_at(const rtosc_timetag_clock_t *clock,
+                                uint64_t monotonic_ns);
+//! Reading of the monotonic clock, in ns
+uint64_t rtosc_monotonic_ns(void);
+//! Convert nanoseconds to timetag units (1/2^32 s)
+uint64_t rtosc_ns2timetag(uint64_t ns);
+
+//! Like rtosc_arg_val_current_time(), but stamped by @p clock
+rtosc_arg_val_t* rtosc_arg_val_from_clock(rtosc_arg_val_t* dest,
+                                          const rtosc_timetag_clock_t *clock);
+
+/**
+ * Conversion between timetags and frames of an audio block
+ *
+ * The conversions of a block are done in fixed point, so whole arrays can
+ * be converted in vectorizable loops. Timetags between two frames are
+ * rounded to the nearest frame. BundleScheduler places its messages with
+ * these conversions.
+ */
+typedef struct
+{
+    uint64_t start;       //!< timetag of frame 0
+    uint64_t end;         //!< timetag after the last frame
+    uint32_t nframes;
+    uint64_t frames_mult; //!< frames per timetag unit, as 24.40 fixed point
+    uint64_t tt_mult;     //!< timetag units per frame, as 48.16 fixed point
+} rtosc_block_time_t;
+
+/**
+ * @param start Timetag of the first frame
+ * @param sample_rate In Hz, at most 2^24 frames per block are supported
+ */
+void rtosc_block_time_init(rtosc_block_time_t *block, uint64_t start,
+                           uint32_t nframes, double sample_rate);
+
+/**
+ * Frames of @p n timetags in the block
+ *
+ * Timetags before the block, including the immediate one, get frame 0,
+ * timetags after the block get nframes.
+ */
+void rtosc_timetags2frames(const rtosc_block_time_t *block,
+                           const uint64_t *timetags, uint32_t *frames,
+                           size_t n);
+//! Timetags of @p n frames of the block
+void rtosc_frames2timetags(const rtosc_block_time_t *block,
+                           const uint32_t *frames, uint64_t *timetags,
+                           size_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -146,6 +146,88 @@ size_t rtosc_amessage(char        *buffer,
                       const char  *arguments,
                       const rtosc_arg_t *args);
 
+/*
+ * incremental message building
+ */
+/**
+ * State of a message being built in place
+ *
+ * The builder writes path, type tags and arguments directly into the target
+ * memory in one forward pass, without va_lists or a separate sizing pass.
+ * Space for up to max_tags type tags is reserved behind the path, and the
+ * arguments are moved down once in rtosc_builder_finish() if fewer tags have
+ * been used. The target can be any contiguous memory, e.g. a reserved slot
+ * of a ring buffer.
+ *
+ * @code
+ *     rtosc_builder b;
+ *     rtosc_builder_begin(&b, buffer, sizeof(buffer), "/volume", 2);
+ *     rtosc_builder_add_i32(&b, 3);
+ *     rtosc_builder_add_float(&b, 0.5f);
+ *     size_t len = rtosc_builder_finish(&b); // 0 on overflow
+ * @endcode
+ */
+typedef struct
+{
+    char    *buffer;
+    size_t   len;      //!< size of buffer
+    size_t   pos;      //!< write position of the next argument
+    unsigned tags;     //!< offset of the type tag string (the ',')
+    unsigned args;     //!< offset of the first argument
+    unsigned ntags;    //!< number of type tags written so far
+    unsigned max_tags; //!< number of type tags reserved
+    int      overflow; //!< set if anything did not fit
+} rtosc_builder;
+
+/**
+ * Start building a message
+ * @param b        builder to initialize
+ * @param buffer   target memory, need not be zeroed
+ * @param len      size of buffer
+ * @param path     OSC address
+ * @param max_tags maximum number of type tags (including array tags)
+ * @returns 1 on success, 0 if the path and type tags do not fit
+ */
+int rtosc_builder_begin(rtosc_builder *b, char *buffer, size_t len,
+                        const char *path, unsigned max_tags);
+
+/**
+ * Append an argument
+ * @returns 1 on success, 0 if the argument did not fit. In the latter case,
+ *          the builder is marked as overflown and rtosc_builder_finish()
+ *          will fail.
+ */
+int rtosc_builder_add_i32(rtosc_builder *b, int32_t i);
+int rtosc_builder_add_i64(rtosc_builder *b, int64_t h);
+int rtosc_builder_add_float(rtosc_builder *b, float f);
+int rtosc_builder_add_double(rtosc_builder *b, double d);
+int rtosc_builder_add_timetag(rtosc_builder *b, uint64_t t);
+int rtosc_builder_add_char(rtosc_builder *b, char c);
+int rtosc_builder_add_rgba(rtosc_builder *b, int32_t r);
+int rtosc_builder_add_midi(rtosc_builder *b, const uint8_t m[4]);
+int rtosc_builder_add_string(rtosc_builder *b, const char *s);
+int rtosc_builder_add_symbol(rtosc_builder *b, const char *S);
+//! @param data blob content, or NULL to write zeros
+int rtosc_builder_add_blob(rtosc_builder *b, int32_t len, const uint8_t *data);
+/**
+ * Append n arguments of the same type from a host array, e.g. a wavetable
+ * @param type one of 'i', 'f', 'c', 'r' (32 bit values in src) or
+ *             'h', 't', 'd' (64 bit values in src)
+ */
+int rtosc_builder_add_run(rtosc_builder *b, char type, const void *src,
+                          size_t n);
+int rtosc_builder_add_bool(rtosc_builder *b, int T);
+int rtosc_builder_add_nil(rtosc_builder *b);
+int rtosc_builder_add_inf(rtosc_builder *b);
+//! Append '[' or ']'
+int rtosc_builder_array(rtosc_builder *b, int begin);
+
+/**
+ * Complete the message
+ * @returns length of resulting message or zero if bounds were exceeded
+ */
+size_t rtosc_builder_finish(rtosc_builder *b);
+
 /**
  * Returns the number of arguments found in a given message
  *
@@ -249,6 +331,86 @@ rtosc_arg_val_t rtosc_itr_next(rtosc_arg_itr_t *itr);
  */
 int rtosc_itr_end(rtosc_arg_itr_t itr);
 
+/**
+ * Read a run of arguments of the same type and advance past them
+ * @see rtosc_argument_run()
+ * @returns the number of arguments read, 0 if the next argument is not of
+ *          a supported type
+ */
+size_t rtosc_itr_read_run(rtosc_arg_itr_t *itr, void *dst, size_t max);
+
+/*
+ * decode plans
+ */
+//! Maximum number of runs (of equal types) in a decode plan
+#define RTOSC_DECODE_PLAN_MAX_RUNS 32
+
+//! Run of arguments of the same type in a decode plan
+typedef struct
+{
+    char     type;
+    uint8_t  size;  //!< bytes per argument, 0 if none, 255 if variable
+    uint32_t count; //!< number of arguments
+} rtosc_decode_run_t;
+
+/**
+ * Plan to decode messages of one type string
+ *
+ * The plan is computed once from a type string, e.g. the arguments of a
+ * port. It groups the arguments into runs of the same type and skips array
+ * delimiters, so decoding a message with these types needs neither a type
+ * switch nor a size computation per argument, and runs of fixed size types
+ * are decoded in bulk.
+ *
+ * The decode functions expect a message with exactly the plan's types, see
+ * rtosc_decode_plan_matches().
+ */
+typedef struct
+{
+    rtosc_decode_run_t runs[RTOSC_DECODE_PLAN_MAX_RUNS];
+    unsigned nruns;
+    unsigned nargs;
+    //! bytes needed by rtosc_plan_decode_native(), 0 if the plan has
+    //! strings or blobs
+    unsigned native_size;
+} rtosc_decode_plan_t;
+
+/**
+ * Compute the plan for a type string
+ * @param types Argument types, like rtosc_argument_string()
+ * @returns 0 if the types have more than RTOSC_DECODE_PLAN_MAX_RUNS runs or
+ *          contain unknown types, 1 otherwise
+ */
+int rtosc_decode_plan_init(rtosc_decode_plan_t *plan, const char *types);
+
+//! @returns 1 if @p msg has the plan's types, 0 otherwise
+int rtosc_decode_plan_matches(const rtosc_decode_plan_t *plan,
+                              const char *msg);
+
+/**
+ * Decode the arguments of a message with the plan's types
+ * @param args receives the arguments, like from rtosc_argument()
+ * @param max capacity of args
+ * @returns the number of arguments decoded
+ */
+size_t rtosc_plan_decode(const rtosc_decode_plan_t *plan, const char *msg,
+                         rtosc_arg_t *args, size_t max);
+
+/**
+ * Decode the arguments into native values, run by run
+ *
+ * Each run of 32 bit types ('i', 'f', 'c', 'r', 'm') is written as an array
+ * of 4 byte values, each run of 64 bit types ('h', 't', 'd') as an array of
+ * 8 byte values, which starts at a multiple of 8 bytes. Types without data
+ * ('T', 'F', 'N', 'I') take no space. Messages with strings or blobs can
+ * not be decoded this way.
+ * @param dst receives the values, should be 8 byte aligned
+ * @param len size of dst, at least plan->native_size
+ * @returns the number of bytes written, 0 on error
+ */
+size_t rtosc_plan_decode_native(const rtosc_decode_plan_t *plan,
+                                const char *msg, void *dst, size_t len);
+
 /**
  * Blob data may be safely written to
  * @param msg OSC message
@@ -257,6 +419,85 @@ int rtosc_itr_end(rtosc_arg_itr_t itr);
  */
 rtosc_arg_t rtosc_argument(const char *msg, unsigned i);
 
+/*
+ * bulk conversion
+ */
+/**
+ * Convert n 32 bit values (int32_t, float, ...) from host byte order to the
+ * big endian order of OSC messages
+ *
+ * Useful for whole runs of arguments and for arrays inside of blobs.
+ * src and dst must either be equal or not overlap.
+ */
+void rtosc_pack32(uint8_t *dst, const void *src, size_t n);
+//! Inverse of rtosc_pack32()
+void rtosc_unpack32(void *dst, const uint8_t *src, size_t n);
+//! Like rtosc_pack32(), for 64 bit values (int64_t, double, timetags)
+void rtosc_pack64(uint8_t *dst, const void *src, size_t n);
+//! Inverse of rtosc_pack64()
+void rtosc_unpack64(void *dst, const uint8_t *src, size_t n);
+
+/**
+ * Read a run of consecutive arguments of the same type in one go
+ *
+ * Only the fixed size types 'i', 'f', 'c', 'r' (into 32 bit values) and
+ * 'h', 't', 'd' (into 64 bit values) are supported. A run ends at the first
+ * argument of another type or at an array delimiter.
+ *
+ * @param msg OSC message
+ * @param i   index of the first argument
+ * @param dst host array, receives the arguments
+ * @param max capacity of dst
+ * @returns the number of arguments read
+ */
+size_t rtosc_argument_run(const char *msg, unsigned i, void *dst, size_t max);
+
+/*
+ * parsed message views
+ */
+//! Number of arguments a message view can index directly
+#define RTOSC_MSG_VIEW_MAX_ARGS 64
+
+/**
+ * Message with pre-computed argument types and offsets
+ *
+ * rtosc_argument() needs to walk all previous arguments, so reading all
+ * arguments of a message one by one is quadratic. The view walks the message
+ * only once, afterwards each argument is accessed in constant time.
+ * Array delimiters ('[' and ']') are skipped, like in rtosc_argument().
+ * Arguments beyond RTOSC_MSG_VIEW_MAX_ARGS are still accessible, but fall
+ * back to rtosc_argument().
+ */
+typedef struct
+{
+    const char *msg;   //!< the viewed message
+    unsigned    nargs; //!< number of arguments, may exceed the array size
+    char        types[RTOSC_MSG_VIEW_MAX_ARGS];
+    uint32_t    offsets[RTOSC_MSG_VIEW_MAX_ARGS]; //!< from the message start
+} rtosc_msg_view;
+
+/**
+ * Parse a message into a view
+ * @param view view to initialize
+ * @param msg well formed OSC message which must outlive the view
+ * @returns number of arguments in the message
+ */
+unsigned rtosc_msg_view_init(rtosc_msg_view *view, const char *msg);
+
+/**
+ * @param view initialized view
+ * @param i    index of argument, must be less than view->nargs
+ * @returns the type of the ith argument
+ */
+char rtosc_msg_view_type(const rtosc_msg_view *view, unsigned i);
+
+/**
+ * @param view initialized view
+ * @param i    index of argument, must be less than view->nargs
+ * @returns the ith argument, like rtosc_argument() would
+ */
+rtosc_arg_t rtosc_msg_view_argument(const rtosc_msg_view *view, unsigned i);
+
 /**
  * @param msg OSC message
  * @param len Message length upper bound
@@ -344,6 +585,156 @@ int rtosc_bundle_p(const char *msg);
  */
 uint64_t rtosc_bundle_timetag(const char *msg);
 
+/**
+ * Iterator over the elements of a bundle
+ *
+ * Unlike rtosc_bundle_fetch() and rtosc_bundle_size(), which start at the
+ * first element on each call, the iterator walks the bundle only once.
+ */
+typedef struct {
+    const char *pos;       //!< size field of the next element
+    size_t      remaining; //!< bytes left in the bundle, from pos on
+} rtosc_bundle_itr_t;
+
+/**
+ * Create an iterator over the elements of a bundle
+ * @param msg OSC bundle
+ * @param len Upper bound on the length of the bundle
+ */
+rtosc_bundle_itr_t rtosc_bundle_itr_begin(const char *msg, size_t len);
+
+/**
+ * @returns 1 if there are no more elements, 0 otherwise
+ */
+int rtosc_bundle_itr_end(rtosc_bundle_itr_t itr);
+
+/**
+ * Gets the next element of a bundle
+ * @param itr bundle iterator, must not be at its end
+ * @param len if non-NULL, receives the length of the element
+ * @returns the element, pointing into the bundle
+ */
+const char *rtosc_bundle_itr_next(rtosc_bundle_itr_t *itr, size_t *len);
+
+/**
+ * Build an offset table for random access to bundle elements
+ *
+ * @param msg  OSC bundle
+ * @param len  Upper bound on the length of the bundle
+ * @param elms Receives the elements, may be NULL
+ * @param lens Receives the element lengths, may be NULL
+ * @param max  Capacity of elms and lens
+ * @returns The number of elements in the bundle, which may be larger than
+ *          max (in which case only the first max elements are stored)
+ */
+size_t rtosc_bundle_index(const char *msg, size_t len,
+                          const char **elms, size_t *lens, size_t max);
+
+/**
+ * Call a function for each message in a bundle, descending into nested
+ * bundles, without copying any message
+ *
+ * @param msg  OSC message or bundle
+ * @param len  Upper bound on the length of msg
+ * @param cb   Callback receiving each message, its length and data
+ * @param data Data passed to cb
+ * @returns The number of messages for which cb has been called
+ */
+size_t rtosc_bundle_walk(const char *msg, size_t len,
+                         void (*cb)(const char *msg, size_t len, void *data),
+                         void *data);
+
+//! Maximum nesting depth of rtosc_bundle_writer sub-bundles
+#define RTOSC_BUNDLE_WRITER_DEPTH 8
+
+/**
+ * Streaming bundle writer
+ *
+ * Messages are appended in place, sub-bundles can be nested. If an element
+ * does not fit, the append function fails and leaves the buffer untouched,
+ * so the caller can finish the bundle, flush it (e.g. send it as one
+ * datagram), restart the writer and append the element again:
+ *
+ * @code
+ *     rtosc_bundle_writer w;
+ *     rtosc_bundle_writer_begin(&w, buffer, mtu, timetag);
+ *     while(next_message(&msg)) {
+ *         if(!rtosc_bundle_append(&w, msg, 0)) {
+ *             send(buffer, rtosc_bundle_writer_finish(&w));
+ *             rtosc_bundle_writer_restart(&w);
+ *             rtosc_bundle_append(&w, msg, 0);
+ *         }
+ *     }
+ *     send(buffer, rtosc_bundle_writer_finish(&w));
+ * @endcode
+ */
+typedef struct
+{
+    char    *buffer;
+    size_t   len;   //!< size of buffer
+    size_t   pos;   //!< end of the written data
+    uint64_t tt;    //!< timetag of the outermost bundle
+    unsigned depth; //!< number of open sub-bundles
+    //! offsets of the size fields of the open sub-bundles
+    size_t   open[RTOSC_BUNDLE_WRITER_DEPTH];
+} rtosc_bundle_writer;
+
+/**
+ * Start writing a bundle
+ * @returns 1 on success, 0 if not even the bundle header fits
+ */
+int rtosc_bundle_writer_begin(rtosc_bundle_writer *w, char *buffer,
+                              size_t len, uint64_t tt);
+
+/**
+ * Start over with an empty bundle, e.g. after flushing a full one
+ * @note open sub-bundles are discarded
+ */
+void rtosc_bundle_writer_restart(rtosc_bundle_writer *w);
+
+/**
+ * Append a message or bundle
+ * @param msg     message to copy into the bundle
+ * @param msg_len length of msg, or 0 to compute it
+ * @returns 1 on success, 0 if msg did not fit (the writer stays unchanged)
+ */
+int rtosc_bundle_append(rtosc_bundle_writer *w, const char *msg,
+                        size_t msg_len);
+
+/**
+ * Reserve space to build the next element in place, e.g. with
+ * rtosc_builder_begin()
+ * @param avail receives the number of bytes available at the result
+ * @returns where to write the element, commit it with
+ *          rtosc_bundle_append_commit()
+ */
+char *rtosc_bundle_append_reserve(rtosc_bundle_writer *w, size_t *avail);
+
+/**
+ * Commit an element written to the space of rtosc_bundle_append_reserve()
+ * @param msg_len length of the element, 0 to discard it
+ * @returns 1 on success, 0 if nothing has been committed
+ */
+int rtosc_bundle_append_commit(rtosc_bundle_writer *w, size_t msg_len);
+
+/**
+ * Open a sub-bundle, following appends go into it until it is closed
+ * @returns 1 on success, 0 if it does not fit or is nested too deeply
+ */
+int rtosc_bundle_open(rtosc_bundle_writer *w, uint64_t tt);
+
+/**
+ * Close the innermost sub-bundle
+ * @returns 1 on success, 0 if no sub-bundle is open
+ */
+int rtosc_bundle_close(rtosc_bundle_writer *w);
+
+/**
+ * Close all open sub-bundles
+ * @returns the length of the bundle
+ */
+size_t rtosc_bundle_writer_finish(rtosc_bundle_writer *w);
+
 
 /**
  * This is a non-compliant pattern matcher for dispatching OSC messages
@@ -372,6 +763,36 @@ bool rtosc_match(const char *pattern,
 const char *rtosc_match_path(const char *pattern,
                              const char *msg, const char** path_end);
 
+/**
+ * Compile a pattern for rtosc_pattern_match() and rtosc_pattern_match_path()
+ *
+ * The program replays the decisions which rtosc_match() takes for
+ * @p pattern, without interpreting the pattern syntax again on each call.
+ * It holds a copy of the pattern and does not refer to @p pattern, and it
+ * does not need to be aligned.
+ *
+ * @param prog Buffer for the program
+ * @param size Size of @p prog
+ * @returns The size of the program, which was only written if it is not
+ *   larger than @p size, or 0 if the pattern can not be compiled (e.g. for
+ *   options longer than 255 characters)
+ */
+size_t rtosc_pattern_compile(const char *pattern, char *prog, size_t size);
+
+/**
+ * Same as rtosc_match(), for a compiled pattern
+ */
+bool rtosc_pattern_match(const char *prog,
+                         const char *msg, const char** path_end);
+
+/**
+ * Same as rtosc_match_path(), for a compiled pattern
+ *
+ * @returns NULL if unmatched, else the argument part of the pattern's copy
+ */
+const char *rtosc_pattern_match_path(const char *prog,
+                                     const char *msg, const char** path_end);
+
 #ifdef __cplusplus
 };
 #endif
@@ -33,8 +33,10 @@
 #define RTOSC_SAVEFILE
 
 #include <string>
+#include <vector>
 #include <rtosc/rtosc.h>
 #include <rtosc/rtosc-version.h>
+#include <rtosc/pretty-format.h>
 
 namespace rtosc {
 
@@ -53,6 +55,210 @@ namespace rtosc {
  */
 std::string get_changed_values(const struct Ports& ports, void* runtime);
 
+/**
+ * Pass the list of all changed values to a sink while it is being printed
+ *
+ * The text is the same as the one of the function above, but it is not held
+ * in memory at once, so it can be written to a file directly.
+ * @param sink The sink which receives the text
+ * @param sink_data User data for the sink
+ * @return false if the sink stopped printing
+ */
+bool get_changed_values(const struct Ports& ports, void* runtime,
+                        rtosc_print_sink sink, void* sink_data);
+
+/**
+ * Return a string list of all changed values, computed on multiple threads
+ *
+ * The walk is split at the top level ports, and port arrays with subports
+ * (like "voice#8/") are split by index. The subtrees are walked on a thread
+ * pool, and the result is the same as the one of get_changed_values(). This
+ * is worth it for large port trees with multiple subtrees.
+ * @param threads Number of threads, 0 to use the shared pool (see
+ *   WorkerPool::shared())
+ * @warning The port callbacks of the runtime object are called concurrently.
+ *   Answering a query for a value (i.e. a message without arguments) must
+ *   not modify any shared state.
+ * @see get_changed_values
+ */
+std::string get_changed_values_parallel(const struct Ports& ports,
+                                        void* runtime, unsigned threads = 0);
+
+/**
+ * Pass the list of all changed values to a sink, computed on multiple threads
+ *
+ * The sink is only called from the calling thread, after all subtrees have
+ * been walked.
+ * @see get_changed_values_parallel
+ * @return false if the sink stopped printing
+ */
+bool get_changed_values_parallel(const struct Ports& ports, void* runtime,
+                                 rtosc_print_sink sink, void* sink_data,
+                                 unsigned threads = 0);
+
+class WorkerPool;
+
+/**
+ * Pass the list of all changed values to a sink, computed on @p pool
+ *
+ * @see get_changed_values_parallel
+ * @return false if the sink stopped printing
+ */
+bool get_changed_values_parallel(const struct Ports& ports, void* runtime,
+                                 WorkerPool& pool,
+                                 rtosc_print_sink sink, void* sink_data);
+
+class ChangeTracker;
+class ThreadLink;
+class WalkEnabledCache;
+
+/**
+ * Cache for the changed values, which only walks changed subtrees again
+ *
+ * The setters of port-sugar.h report changes to the ChangeTracker if
+ * RtData::changes points to it. Each call of get_changed_values() only walks
+ * the units of the tracker which have been changed since the last call, and
+ * reuses the cached values of all others. This makes frequent autosaves cheap.
+ * Units declared to be at their defaults (see ChangeTracker::mark_defaults())
+ * are dropped without being walked, so if the tracker has been constructed
+ * for a runtime object at its defaults, even the first call only walks the
+ * units which have been changed.
+ *
+ * @note Changes which are not done by the setters of port-sugar.h (e.g.
+ *   loading a whole subtree from a preset) must be reported with
+ *   ChangeTracker::mark() or ChangeTracker::mark_all().
+ */
+class changed_values_cache_t
+{
+public:
+    //! @param tracker The tracker of the runtime's changes, for @p ports
+    changed_values_cache_t(const struct Ports& ports, ChangeTracker& tracker);
+    changed_values_cache_t(const changed_values_cache_t&) = delete;
+
+    //! Same as rtosc::get_changed_values(), but only walks changed units
+    std::string get_changed_values(void* runtime);
+    //! @see rtosc::get_changed_values
+    bool get_changed_values(void* runtime,
+                            rtosc_print_sink sink, void* sink_data);
+
+    //! Same as rtosc::save_to_file(), but only walks changed units
+    std::string save_to_file(void* runtime,
+                             const char* appname, rtosc_version appver);
+    //! @see rtosc::save_to_file
+    bool save_to_file(void* runtime, const char* appname, rtosc_version appver,
+                      rtosc_print_sink sink, void* sink_data);
+
+private:
+    struct job_t
+    {
+        const struct Port* port;
+        int index;         //!< subtree index, or -1
+        std::size_t unit;  //!< the tracker's unit
+    };
+    const struct Ports& ports;
+    ChangeTracker& tracker;
+    std::vector<job_t> jobs;        //!< the parts of the walk in order
+    std::vector<std::string> texts; //!< cached changed values of each job
+};
+
+/**
+ * Values of all parameters, captured at once, for saving them later
+ *
+ * The values are queried from the runtime object in one block by capture(),
+ * which is meant to be called from the thread which owns the runtime object
+ * (usually the realtime thread), so the values can not change in between.
+ * capture() does not allocate memory: it stores the replies of the ports in
+ * a preallocated buffer, and its walk uses a preallocated WalkEnabledCache.
+ * It still calls each parameter's port callback once, so it is only
+ * realtime safe if these callbacks are, and its time grows with the number
+ * of parameters. The savefile is then printed from the snapshot on any other
+ * thread, without calling into the runtime object.
+ *
+ * Defaults depending on other ports (see rDefaultDepends) are resolved
+ * using the captured values.
+ */
+class values_snapshot_t
+{
+public:
+    /**
+     * Allocate all buffers
+     * @param capacity Bytes for the captured replies
+     * @param max_args Maximum number of arguments of one reply
+     */
+    explicit values_snapshot_t(const struct Ports& ports,
+                               std::size_t capacity = 1 << 20,
+                               std::size_t max_args = 2048);
+    ~values_snapshot_t();
+    values_snapshot_t(const values_snapshot_t&) = delete;
+
+    /**
+     * Query and store the values of all parameters with default values
+     *
+     * Disabled subtrees are skipped, like in get_changed_values().
+     * @return false if the buffer was too small; the snapshot is incomplete
+     *   then, and saving it fails
+     */
+    bool capture(void* runtime);
+
+    //! Number of captured values
+    std::size_t size() const { return entries.size(); }
+
+    //! Same as rtosc::get_changed_values(), for the captured values
+    std::string get_changed_values() const;
+    //! @see rtosc::get_changed_values
+    bool get_changed_values(rtosc_print_sink sink, void* sink_data) const;
+
+    //! Same as rtosc::save_to_file(), for the captured values
+    std::string save_to_file(const char* appname, rtosc_version appver) const;
+    //! @see rtosc::save_to_file
+    bool save_to_file(const char* appname, rtosc_version appver,
+                      rtosc_print_sink sink, void* sink_data) const;
+
+    //! Same as rtosc::save_to_binary_file(), for the captured values
+    std::string save_to_binary_file(const char* appname,
+                                    rtosc_version appver) const;
+    //! @see rtosc::save_to_binary_file
+    bool save_to_binary_file(const char* appname, rtosc_version appver,
+                             rtosc_print_sink sink, void* sink_data) const;
+
+private:
+    struct entry_t
+    {
+        const struct Port* port;
+        std::size_t offset;   //!< position of the reply in the buffer
+        std::size_t base_len; //!< length of the path to the port's Ports
+    };
+    static void on_capture(const struct Port* p, const char* port_buffer,
+                           const char* port_from_base,
+                           const struct Ports& base, void* data,
+                           void* runtime);
+    bool write_values(rtosc_print_sink sink, void* sink_data,
+                      bool binary) const;
+
+    const struct Ports& ports;
+    std::vector<char> buffer;           //!< the captured replies
+    std::size_t used;
+    bool overflow;
+    std::vector<entry_t> entries;       //!< the captured replies in order
+    std::vector<char> name_buffer, loc, query;
+    std::vector<rtosc_arg_val_t> args;  //!< scratch space for replies
+    std::vector<rtosc_arg_t> osc_args;
+    std::vector<char> tags;
+    WalkEnabledCache* enabled_cache;    //!< used by the walk of capture()
+};
+
+/**
+ * Progress callback for load_from_file_mapped()
+ * @param round 0 while the messages are scanned and dispatched for the first
+ *   time, 1 while they are dispatched for the second time
+ * @param bytes_done Position in the file which has been reached
+ * @param bytes_total Size of the file
+ * @param data User data
+ * @return false to abort loading
+ */
+typedef bool (*savefile_progress_cb)(int round, size_t bytes_done,
+                                     size_t bytes_total, void* data);
+
 //! @brief Class to modify and dispatch messages loaded from savefiles.
 //! Objects of this class shall be passed to savefile loading routines. You can
 //! inherit to change the behaviour, e.g. to modify or discard such messages.
@@ -74,6 +280,13 @@ protected:
         not_specified     //! it's not know which of the other enum values fit
     };
 
+    //! How files written with the current versions are loaded
+    enum fast_path_t {
+        no_fast_path,    //!< through the hooks, like all other files
+        direct_dispatch, //!< without calling the hooks
+        batch_dispatch   //!< the same, dispatching batches of messages
+    };
+
     rtosc_version rtosc_filever, //!< rtosc versinon savefile was written with
                   rtosc_curver, //!< rtosc version of this library
                   app_filever, //!< app version savefile was written with
@@ -85,6 +298,21 @@ protected:
     static int default_response(size_t nargs, bool first_round,
                                 dependency_t dependency);
 
+    /**
+     * Declare whether the hooks can be skipped for files written with the
+     * current rtosc and app version
+     *
+     * Most dispatchers only migrate files of older versions. If so, return
+     * direct_dispatch or batch_dispatch: if both versions of a file equal
+     * rtosc_curver and app_curver, its messages go straight into the ports,
+     * in the rounds of default_response(), without calling on_dispatch() or
+     * do_dispatch(). With batch_dispatch, they are dispatched by
+     * Ports::dispatch_batch() in batches, so loading only aborts if a whole
+     * batch has fewer matches than messages, and the error offset is the
+     * one of the batch's last message. The default is no_fast_path.
+     */
+    virtual fast_path_t fast_path(void) const { return no_fast_path; }
+
 private:
     //! callback for when a message shall be dispatched
     //! implement this if you need to change a message
@@ -95,6 +323,29 @@ private:
     //! call this to dispatch a message
     virtual bool do_dispatch(const char* msg);
 
+    //! let on_dispatch() modify a copy of the args, then dispatch them
+    //! to the port in @p portname
+    //! @return false if the loading shall be aborted
+    bool dispatch_arg_vals(char* portname, size_t portname_max,
+                           const rtosc_arg_val_t* args, int nargs,
+                           bool round2);
+    //! build the messages of @p args for @p portname and send() them
+    bool send_arg_vals(char* portname, const rtosc_arg_val_t* args,
+                       int nargs);
+
+    //! choose the fast path, if the file has the current versions
+    void set_versions(rtosc_version rtosc_file, rtosc_version app_file);
+    //! whether the fast path dispatches the message in this round
+    bool in_round(const char* portname, int nargs, bool round2) const;
+    //! dispatch a complete message through the hooks or the fast path
+    bool send(const char* msg);
+    //! dispatch the pending batch; false if some messages did not match
+    bool flush(void);
+
+    fast_path_t active_fast_path = no_fast_path;
+    std::vector<char> batch;               //!< pending messages
+    std::vector<std::size_t> batch_offsets; //!< their offsets in batch
+
     friend int dispatch_printed_messages(const char* messages,
                                          const struct Ports& ports,
                                          void* runtime,
@@ -105,6 +356,38 @@ private:
                               const char* appname,
                               rtosc_version appver,
                               savefile_dispatcher_t* dispatcher);
+
+    friend int load_from_binary_file(const char* file_content, size_t size,
+                                     const struct Ports& ports, void* runtime,
+                                     const char* appname,
+                                     rtosc_version appver,
+                                     savefile_dispatcher_t* dispatcher);
+
+    friend int load_from_file_mapped(int fd,
+                                     const struct Ports& ports, void* runtime,
+                                     const char* appname,
+                                     rtosc_version appver,
+                                     savefile_dispatcher_t* dispatcher,
+                                     savefile_progress_cb progress,
+                                     void* progress_data);
+};
+
+/**
+ * Dispatcher which writes the loaded messages into a ThreadLink instead of
+ * dispatching them
+ *
+ * This lets the reader of the link (e.g. the realtime thread) apply the
+ * messages while the file is still being parsed. If the link is full,
+ * loading waits until the reader has made space, so the link must be read
+ * concurrently. The messages can not be checked for matching ports here.
+ */
+class savefile_link_dispatcher_t : public savefile_dispatcher_t
+{
+public:
+    explicit savefile_link_dispatcher_t(ThreadLink& link) : link(link) {}
+private:
+    bool do_dispatch(const char* msg) override;
+    ThreadLink& link;
 };
 
 /**
@@ -134,6 +417,16 @@ int dispatch_printed_messages(const char* messages,
 std::string save_to_file(const struct Ports& ports, void* runtime,
                          const char* appname, rtosc_version appver);
 
+/**
+ * Pass a savefile to a sink while it is being printed
+ * @see save_to_file
+ * @see get_changed_values
+ * @return false if the sink stopped printing
+ */
+bool save_to_file(const struct Ports& ports, void* runtime,
+                  const char* appname, rtosc_version appver,
+                  rtosc_print_sink sink, void* sink_data);
+
 /**
  * Read save file and dispatch contained parameters.
  * @param file_content The file as a C string
@@ -152,6 +445,83 @@ int load_from_file(const char* file_content,
                    rtosc_version appver,
                    savefile_dispatcher_t* dispatcher = NULL);
 
+/**
+ * Read a savefile from a file descriptor and dispatch contained parameters
+ *
+ * The file is memory mapped and dispatched while it is being scanned, so
+ * it is never copied into memory as a whole, and only the offsets of the
+ * messages are kept for the second round. Binary savefiles (see
+ * save_to_binary_file()) are detected and loaded, too.
+ * @param fd A regular file, opened for reading
+ * @param progress Called every 64 KiB and at the end of each round, or NULL
+ * @param progress_data User data for @p progress
+ * @return Like load_from_file(), -1 if the file could not be mapped
+ * @see load_from_file
+ */
+int load_from_file_mapped(int fd,
+                          const struct Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher = NULL,
+                          savefile_progress_cb progress = NULL,
+                          void* progress_data = NULL);
+
+//! Same as the function above, for the file at @p path
+int load_from_file_mapped(const char* path,
+                          const struct Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher = NULL,
+                          savefile_progress_cb progress = NULL,
+                          void* progress_data = NULL);
+
+/**
+ * Pass a savefile in binary format to a sink
+ *
+ * The binary format contains the same messages as the text format of
+ * save_to_file(), but as OSC messages, so loading it requires no text
+ * parsing. It consists of:
+ *   - the 8 bytes "RTOSCBIN"
+ *   - the rtosc version and the app version, 4 bytes each: major, minor,
+ *     revision and a zero byte
+ *   - the app name, as a padded OSC string
+ *   - the messages, each prefixed by its size as a 32 bit big endian integer,
+ *     like the elements of an OSC bundle
+ *
+ * Arrays are written using the OSC array tags '[' and ']'. Values are
+ * written as they are, i.e. without being mapped to enumeration names.
+ * @see save_to_file
+ * @return false if the sink stopped saving
+ */
+bool save_to_binary_file(const struct Ports& ports, void* runtime,
+                         const char* appname, rtosc_version appver,
+                         rtosc_print_sink sink, void* sink_data);
+
+//! Return a savefile in binary format
+//! @see save_to_binary_file
+std::string save_to_binary_file(const struct Ports& ports, void* runtime,
+                                const char* appname, rtosc_version appver);
+
+//! Return whether @p file_content starts like a binary savefile
+bool is_binary_savefile(const char* file_content, size_t size);
+
+/**
+ * Read a savefile in binary format and dispatch contained parameters
+ *
+ * The messages are dispatched like in load_from_file(), including the calls
+ * of the dispatcher's hooks.
+ * @param file_content The file content
+ * @param size Size of @p file_content in bytes
+ * @return The number of messages read, or, if there was a read error,
+ *   the negated number of bytes read until the erroneous part minus one
+ * @see load_from_file
+ */
+int load_from_binary_file(const char* file_content, size_t size,
+                          const struct Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher = NULL);
+
 }
 
 #endif // RTOSC_SAVEFILE
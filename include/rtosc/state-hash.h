@@ -0,0 +1,105 @@
+/**
+ * @file state-hash.h
+ * Hash trees over the parameter values of a port tree
+ *
+ * @test default-value.cpp
+ */
+
+#ifndef RTOSC_STATE_HASH_H
+#define RTOSC_STATE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <rtosc/rtosc.h>
+
+namespace rtosc {
+
+struct Port;
+struct Ports;
+
+/**
+ * Hash of a port's values, independent of their encoding
+ *
+ * The values are canonicalized for @p port first (see
+ * canonicalize_arg_vals()), e.g. mapped strings are converted to their
+ * integers, so that all values which a port treats equally hash the same.
+ * The result is the same as rtosc_avmessage_hash() of the canonical values.
+ * @param av The values, which are canonicalized in place
+ * @param size Array size of @p av
+ * @param base The Ports containing @p port
+ */
+std::uint64_t canonical_hash(const char *address, rtosc_arg_val_t *av,
+                             std::size_t size, const Port &port,
+                             const Ports &base);
+
+/**
+ * Merkle tree of the parameter values of a port tree
+ *
+ * build() queries all parameters whose values can be queried, like
+ * get_changed_values() does, and hashes each value with canonical_hash()
+ * and its absolute path. Each subtree, like "/voice3/", is hashed from the
+ * hashes of its children, so two trees with equal root hashes have equal
+ * values, and diff() only descends into subtrees whose hashes differ.
+ * Comparing two states, e.g. of an autosave and the current state, or of two
+ * peers, thus costs time proportional to the changes, not to the tree.
+ *
+ * Disabled subtrees are skipped, like in walk_ports(). Hashes depend on the
+ * byte order, but not on the process, so they can be sent to other
+ * processes on the same kind of machine.
+ */
+class StateHash
+{
+    public:
+        //! A hashed port or subtree, the nodes are stored in pre-order
+        struct node_t
+        {
+            std::string   name;  //!< e.g. "voice3/" or "volume", "/" for root
+            std::uint64_t hash;
+            std::size_t   end;   //!< index after the node's last descendant
+        };
+
+        StateHash(void);
+        //! Same as build()
+        StateHash(const Ports &root, void *runtime);
+
+        /**
+         * Query and hash all parameter values of @p runtime
+         *
+         * This calls the ports like get_changed_values() does, so it must be
+         * called from the thread which owns the runtime object. It allocates.
+         */
+        void build(const Ports &root, void *runtime);
+
+        //! Hash of the whole tree
+        std::uint64_t root(void) const;
+        //! Hash of the port or subtree at @p path (subtrees end with '/'),
+        //! 0 if there is no such node
+        std::uint64_t at(const char *path) const;
+
+        /**
+         * Absolute paths of all parameters whose values differ from @p other
+         *
+         * Parameters which only exist in one of the trees, e.g. because of
+         * disabled subtrees, differ, too. The paths are in walk order,
+         * parameters which are only in @p other follow the others of their
+         * subtree.
+         */
+        std::vector<std::string> diff(const StateHash &other) const;
+
+        const std::vector<node_t> &nodes(void) const { return m_nodes; }
+
+    private:
+        std::size_t find(const char *path) const;
+        void diff(std::size_t i, const StateHash &other, std::size_t j,
+                  std::string &path, std::vector<std::string> &res) const;
+        void leaves(std::size_t i, std::string &path,
+                    std::vector<std::string> &res) const;
+
+        std::vector<node_t> m_nodes;
+};
+
+}
+
+#endif
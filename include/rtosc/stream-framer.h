@@ -0,0 +1,142 @@
+/**
+ * @file stream-framer.h
+ * Framing of OSC messages on streams, e.g. TCP connections
+ *
+ * This is part of the rtosc-net library.
+ *
+ * @test stream-framer.cpp
+ */
+
+#ifndef RTOSC_STREAM_FRAMER_H
+#define RTOSC_STREAM_FRAMER_H
+
+#include <cstddef>
+#include <type_traits>
+#include <sys/types.h>
+
+namespace rtosc {
+
+/**
+ * Splits a byte stream into OSC messages
+ *
+ * Two framings are supported:
+ *  - LENGTH_PREFIX: each message is preceded by its length as a big endian
+ *    int32 (OSC 1.0)
+ *  - SLIP: each message is enclosed in END bytes, with END and ESC bytes
+ *    inside being escaped (RFC 1055, double END variant of OSC 1.1)
+ *
+ * Incoming bytes are written into a ring, either by read_from(), or by
+ * writing into write_space() and calling commit(). read_all() then passes
+ * all complete messages to a callback, pointing into the ring. SLIP messages
+ * are unescaped in place. Only a message which wraps around the end of the
+ * ring is copied, into a buffer of the maximum message length, like
+ * ThreadLink does. The parser keeps its position within a partial message,
+ * so bytes are only scanned once, however the message is split by the
+ * stream.
+ *
+ * Messages longer than the maximum message length, and messages which are
+ * neither valid OSC messages nor bundles, are dropped. There is one thread
+ * using a framer at a time.
+ */
+class StreamFramer
+{
+    public:
+        enum framing_t
+        {
+            LENGTH_PREFIX,
+            SLIP
+        };
+
+        /**
+         * @param framing The framing of the stream
+         * @param max_message_length Maximum length of any (unescaped) message
+         * @param capacity Size of the ring, 0 for four times the maximum
+         *                 message length. It is made large enough for at
+         *                 least one framed message of maximum length.
+         */
+        StreamFramer(framing_t framing, size_t max_message_length,
+                     size_t capacity = 0);
+        ~StreamFramer(void);
+        StreamFramer(const StreamFramer&) = delete;
+
+        framing_t framing(void) const { return Framing; }
+
+        /**
+         * Contiguous free space in the ring
+         * @param len Will be set to the number of bytes available, which is
+         *            0 if the ring is full of incomplete messages
+         */
+        char *write_space(size_t *len);
+        //! Mark @p len bytes of the write_space() as received
+        void commit(size_t len);
+
+        /**
+         * Read from a stream into the free space
+         * @return The number of bytes read, 0 at the end of the stream, -1 on
+         *         errors (see errno) or if the ring is full
+         */
+        ssize_t read_from(int fd);
+
+        typedef void (*read_cb_t)(const char *msg, size_t len, void *data);
+
+        /**
+         * Pass all complete messages to @p cb
+         *
+         * Messages are only valid during the callback.
+         * @returns the number of messages passed
+         */
+        size_t read_all(read_cb_t cb, void *data);
+        template<class F>
+        size_t read_all(F &&f)
+        {
+            return read_all([](const char *msg, size_t len, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)(msg, len);
+                }, (void*)&f);
+        }
+
+        //! Number of messages which have been dropped
+        size_t dropped(void) const { return stat_dropped; }
+        //! Number of bytes received, but not yet part of a passed message
+        size_t pending(void) const { return tail - head; }
+        //! Forget all received bytes, e.g. after reconnecting
+        void reset(void);
+
+        /**
+         * Frame a message for sending
+         * @param buffer Where to write the framed message
+         * @param size Size of @p buffer
+         * @return The length of the framed message, or 0 if it does not fit
+         *         into @p buffer (max_framed_length() bytes always fit)
+         */
+        static size_t frame(framing_t framing, const char *msg, size_t len,
+                            char *buffer, size_t size);
+        //! Maximum length of a framed message of @p len bytes
+        static size_t max_framed_length(framing_t framing, size_t len);
+
+    private:
+        unsigned char at(size_t pos) const
+        { return (unsigned char)ring[pos % Capacity]; }
+        bool deliver(size_t start, size_t len, read_cb_t cb, void *data);
+        size_t parse_length_prefix(read_cb_t cb, void *data);
+        size_t parse_slip(read_cb_t cb, void *data);
+
+        const framing_t Framing;
+        const size_t MaxMsg;
+        const size_t Capacity;
+        char *ring;
+        char *wrap_buffer;
+
+        //positions in the stream, the ring holds bytes [head, tail)
+        size_t head, tail, scan;
+        //length prefix: bytes of an oversized message still to skip
+        size_t skip;
+        //slip: end of the unescaped bytes, and the parser state
+        size_t unescaped;
+        bool escaped, skipping;
+
+        size_t stat_dropped;
+};
+
+}
+
+#endif
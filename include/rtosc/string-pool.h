@@ -0,0 +1,76 @@
+/**
+ * @file string-pool.h
+ * Shared storage for port names and metadata of generated port trees
+ *
+ * @test metadata.cpp
+ */
+
+#ifndef RTOSC_STRING_POOL_H
+#define RTOSC_STRING_POOL_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+
+namespace rtosc {
+
+struct Ports;
+
+/**
+ * Pool which keeps one copy of each distinct name and metadata string
+ *
+ * Port tables generated at runtime usually build the same names and
+ * metadata for many ports. Interning them before constructing the Port
+ * entries keeps one copy per distinct string. The pool must outlive all
+ * Ports using its strings. It is not thread safe.
+ *
+ * Metadata is compared as a whole, including all its "\0"-separated
+ * entries, since ports point to the packed string. Identical string
+ * literals of static port tables are usually merged by the linker already;
+ * measure() reports how much would be saved for a tree.
+ */
+class StringPool
+{
+    public:
+        struct stats_t
+        {
+            std::size_t strings;        //!< number of strings
+            std::size_t distinct;       //!< number of distinct strings
+            std::size_t bytes;          //!< size of all strings
+            std::size_t distinct_bytes; //!< size of the distinct strings
+            //! bytes which are saved by keeping one copy of each string
+            std::size_t saved(void) const { return bytes - distinct_bytes; }
+        };
+
+        //! @return The pooled copy of the C string @p name
+        const char *intern_name(const char *name);
+        /**
+         * @return The pooled copy of the packed metadata @p metadata,
+         *         or NULL if @p metadata is NULL
+         */
+        const char *intern_metadata(const char *metadata);
+
+        //! Statistics of all strings interned so far
+        const stats_t &stats(void) const { return stat; }
+
+        /**
+         * Count the names and metadata of all ports in the tree @p root
+         *
+         * Each Ports object is only counted once, even if it is used by
+         * multiple ports (like by port arrays).
+         */
+        static stats_t measure(const Ports &root);
+
+        //! Size of a packed metadata string, including its terminating zeros
+        static std::size_t metadata_size(const char *metadata);
+
+    private:
+        const char *intern(const char *str, std::size_t size);
+
+        std::unordered_set<std::string> pool;
+        stats_t stat = {0, 0, 0, 0};
+};
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file subscriptions.h
+ * Registry of which subscribers are interested in which addresses
+ *
+ * @test broadcaster.cpp
+ */
+
+#ifndef RTOSC_SUBSCRIPTIONS_H
+#define RTOSC_SUBSCRIPTIONS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace rtosc {
+
+/**
+ * Address filters of subscribers, e.g. of UI clients showing parts of the
+ * port tree
+ *
+ * A filter is an OSC address pattern, like "/part[0-3]/volume", which must
+ * match all segments of an address. If it ends with '/', like "/part0/",
+ * it is a prefix, matching all addresses below. "/" matches everything.
+ *
+ * Filters are compiled when they are added. The subscribers interested in
+ * an address are remembered, so checking an address again only costs one
+ * lookup until the filters change.
+ *
+ * This is meant for the non-realtime side, and not thread safe.
+ */
+class Subscriptions
+{
+    public:
+        Subscriptions(void);
+        ~Subscriptions(void);
+        Subscriptions(const Subscriptions&) = delete;
+
+        /**
+         * Let subscriber @p id receive the addresses matching @p filter
+         * @return false if @p filter is no valid pattern
+         */
+        bool add(int id, const char *filter);
+        //! Remove a filter which has been added before
+        void remove(int id, const char *filter);
+        //! Remove all filters of @p id
+        void remove_all(int id);
+        //! Number of filters of @p id
+        size_t filters(int id) const;
+
+        //! IDs of all subscribers with a filter matching @p address, sorted
+        const std::vector<int> &interested(const char *address);
+        //! Whether @p id has a filter matching @p address
+        bool wants(int id, const char *address);
+
+    private:
+        struct internal_subscriptions_t *impl;
+};
+
+}
+
+#endif
@@ -1,12 +1,44 @@
 #ifndef RTOSC_SUBTREE_H
 #define RTOSC_SUBTREE_H
 #include <cstddef>
+#include <vector>
 
 namespace rtosc{struct Ports; struct RtData;}
 
+/**
+ * Capture the values of all ports of @p ports into a bundle
+ *
+ * Each port is queried once, in walk order, and its reply is stored with its
+ * absolute path. Each subtree is put into a sub-bundle. Values of any size
+ * are captured, the bundle grows as needed.
+ * This is not realtime safe.
+ * @return The bundle
+ */
+std::vector<char> subtree_serialize(void *object, const rtosc::Ports &ports);
+
+/**
+ * Capture the values of all ports of @p ports into @p buffer
+ * @return The length of the bundle, or 0 if it did not fit
+ * @see subtree_serialize(void*, const rtosc::Ports&)
+ */
 size_t subtree_serialize(char *buffer, size_t buffer_size,
         void *object, rtosc::Ports *ports);
 
+/**
+ * Messages which turn the state of one snapshot into another
+ *
+ * Both bundles must come from subtree_serialize() of the same port tree.
+ * The messages of @p from are indexed by path, and each message of @p to
+ * is looked up once, so this takes linear time. The result contains the
+ * messages of @p to which are missing in @p from, or which differ, so
+ * replaying it after @p from restores @p to.
+ * @return A flat bundle, without elements if both states are equal
+ */
+std::vector<char> subtree_diff(const char *from, size_t from_len,
+                               const char *to, size_t to_len);
+
+//! Replay all messages of a bundle from subtree_serialize(), including those
+//! of sub-bundles
 void subtree_deserialize(char *buffer, size_t buffer_size,
         void *object, rtosc::Ports *ports, rtosc::RtData &d);
 #endif
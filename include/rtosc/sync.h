@@ -0,0 +1,167 @@
+/**
+ * @file sync.h
+ * Syncing remote UIs with one snapshot, followed by a stream of changes
+ *
+ * A client which connects sends "/sync/connect", with the epoch and the
+ * sequence number of the last change it has seen if it synced before
+ * ("hh"). Each change has a sequence number, counting from 1 on. If the
+ * server still keeps all changes after the client's last one, the client
+ * resumes with these; otherwise, it gets a snapshot first. The packets of
+ * the server are bundles:
+ *
+ * - snapshot: "/sync/snapshot" with the epoch and the sequence number of
+ *   the last change included in the snapshot ("hh"), followed by the bundle
+ *   of subtree_serialize()
+ * - changes: "/sync/delta" with the epoch and the sequence number of the
+ *   first change ("hh"), followed by the changes, which are messages or
+ *   bundles, in order
+ *
+ * The epoch identifies the server's sequence numbers, so clients do not
+ * resume from sequence numbers of another server, e.g. after a restart.
+ *
+ * @test sync.cpp
+ */
+
+#ifndef RTOSC_SYNC_H
+#define RTOSC_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <rtosc/broadcaster.h>
+
+namespace rtosc {
+
+struct Ports;
+
+/**
+ * Server side of the sync protocol
+ *
+ * The changes are recorded with record(), usually by subscribing sink() to
+ * the Broadcaster, which then gets all broadcasts. The last changes are
+ * kept (by reference, see MessageRef) for clients which reconnect. Each
+ * flush() sends each client the changes since its last packet.
+ *
+ * Snapshots query the ports, so the server must be used from the thread
+ * which owns the runtime object, and which records the changes, so that
+ * each snapshot matches its sequence number. This is meant for the
+ * non-realtime side, and not thread safe.
+ */
+class SyncServer
+{
+    public:
+        //! Send a packet to one client
+        typedef std::function<void(const char *packet, size_t len)> send_t;
+
+        /**
+         * @param ports The port tree whose values are synced
+         * @param object The runtime object of @p ports
+         * @param capacity Number of changes kept for resuming clients
+         */
+        SyncServer(const Ports &ports, void *object, size_t capacity = 4096);
+        SyncServer(const SyncServer&) = delete;
+
+        //! Record a change, i.e. a message or bundle
+        void record(const MessageRef &msg);
+        void record(const char *msg);
+        //! Broadcaster subscriber recording all broadcasts
+        Broadcaster::sink_t sink(void);
+
+        //! Sequence number of the last recorded change, 0 if there is none
+        uint64_t sequence(void) const { return next_seq - 1; }
+        //! Number which identifies this server's sequence numbers
+        uint64_t epoch(void) const { return m_epoch; }
+        //! Whether a client which has seen change @p seq can resume
+        bool can_resume(uint64_t seq) const;
+
+        /**
+         * Answer the "/sync/connect" message @p msg of a new client
+         *
+         * The client gets a snapshot or the changes since its last one, and
+         * later changes from flush().
+         * @return An ID for disconnect(), or -1 if @p msg is no connect
+         *   message
+         */
+        int connect(const char *msg, send_t send);
+        void disconnect(int id);
+        size_t clients(void) const { return m_clients.size(); }
+
+        /**
+         * Send each client the changes since its last packet
+         *
+         * Clients which are at the same sequence number share one packet.
+         * @return The number of packets that have been sent
+         */
+        size_t flush(void);
+
+        //! A snapshot packet of the current state
+        std::vector<char> snapshot(void) const;
+        //! A packet with the changes after change @p seq, which may have no
+        //! changes; empty if the changes are not kept anymore
+        std::vector<char> deltas(uint64_t seq) const;
+
+    private:
+        struct client_t
+        {
+            int      id;
+            uint64_t seq;  //!< last change sent to the client
+            send_t   send;
+        };
+
+        const Ports &ports;
+        void *const  object;
+        const size_t capacity;
+        const uint64_t m_epoch;
+        std::deque<MessageRef> log; //!< changes kept for resuming
+        uint64_t next_seq;          //!< sequence number of the next change
+        std::vector<client_t> m_clients;
+        int next_id;
+};
+
+/**
+ * Client side of the sync protocol
+ *
+ * receive() applies the packets of the server, i.e. passes the messages of
+ * the snapshot and of the changes to a callback, skipping changes which it
+ * has seen before. If a packet does not continue the last one, e.g. after
+ * packets have been lost, the client has to reconnect, and only gets the
+ * changes it has missed.
+ */
+class SyncClient
+{
+    public:
+        //! Apply one message of a snapshot or a change
+        typedef std::function<void(const char *msg, size_t len)> apply_t;
+
+        SyncClient(void);
+
+        /**
+         * Write the "/sync/connect" message, to resume if possible
+         * @return The length of the message, 0 if it did not fit
+         */
+        size_t connect_message(char *buffer, size_t len) const;
+
+        /**
+         * Apply a packet of the server
+         * @return false if @p packet is no sync packet, or if the client
+         *   needs to reconnect because changes are missing
+         */
+        bool receive(const char *packet, size_t len, const apply_t &apply);
+
+        //! Whether a snapshot has been applied, and no change is missing
+        bool synced(void) const { return m_synced; }
+        //! Sequence number of the last applied change
+        uint64_t sequence(void) const { return seq; }
+        //! Forget the state, so the next connect gets a snapshot
+        void reset(void);
+
+    private:
+        uint64_t epoch, seq;
+        bool     m_synced;
+};
+
+}
+
+#endif
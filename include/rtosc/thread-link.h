@@ -28,22 +28,66 @@
 #include <cstring>
 #include <cassert>
 #include <cstdio>
+#include <type_traits>
 #include <rtosc/rtosc.h>
 
 namespace rtosc {
 typedef const char *msg_t;
+struct Port;
+struct Ports;
 
 /**
  * ThreadLink - A simple wrapper around jack's ringbuffers desinged to make
  * sending messages via rt-osc trivial.
  * This class provides the basics of reading and writing events via fixed sized
  * buffers, which can be specified at compile time.
+ *
+ * With statistics enabled, the link counts written, read and dropped
+ * messages, tracks its peak occupancy, and timestamps each message, to
+ * histogram how long messages wait in the link. This costs a clock read per
+ * written and read message.
+ *
+ * All buffers are prefaulted on construction, so the first pass over the
+ * ring does not cause page faults. The memory is then also local to the
+ * NUMA node of the constructing thread (with the default first touch
+ * policy), so links should be constructed on the node of their realtime
+ * thread. The buffers can also be locked into memory and put on huge pages.
  */
 class ThreadLink
 {
     public:
-        ThreadLink(size_t max_message_length, size_t max_messages);
+        //! Options of the constructor, or'ed together
+        enum {
+            with_stats  = 1, //!< collect statistics, see stats()
+            lock_memory = 2, //!< mlock() the buffers, see memory_locked()
+            huge_pages  = 4  //!< use huge pages if available
+        };
+
+        ThreadLink(size_t max_message_length, size_t max_messages,
+                   unsigned options = 0);
         ~ThreadLink(void);
+        ThreadLink(const ThreadLink&) = delete;
+
+        /**
+         * Create a link in the named shared memory segment @p name
+         * (see shm_open()), for sending messages to another process
+         *
+         * The ring protocol is the same as for links within a process, so
+         * messages pass without any system calls. The writing process and
+         * the reading process each use their own ThreadLink object, one of
+         * them created with create_shared(), the other one connecting with
+         * open_shared(). Bidirectional communication takes two links.
+         * The segment is removed when the creating object is destroyed.
+         * A segment of the same name is only replaced if its creator has
+         * exited without removing it, otherwise this fails.
+         * Shared links have no statistics and no wakeup channel.
+         * @returns the link, or NULL on errors
+         */
+        static ThreadLink *create_shared(const char *name,
+                                         size_t max_message_length,
+                                         size_t max_messages);
+        //! Connect to a link made by create_shared(), @returns NULL on errors
+        static ThreadLink *open_shared(const char *name);
 
         /**
          * Write message to ringbuffer
@@ -62,6 +106,34 @@ class ThreadLink
          */
         void raw_write(const char *msg);
 
+        /**
+         * Reserve space for a message of up to @p max_len bytes
+         *
+         * The message can be built in the returned buffer, usually directly
+         * in the ringbuffer, and is published with commit(). Messages which
+         * would wrap around the end of the ringbuffer are built in the write
+         * buffer instead, and copied on commit().
+         * @returns the buffer, or NULL if the link is too full
+         */
+        char *reserve(size_t max_len);
+
+        /**
+         * Publish the message built after reserve()
+         * @param len Length of the message, at most the reserved length,
+         *            or 0 to cancel
+         */
+        void commit(size_t len);
+
+        /**
+         * Writer side check whether a message of @p len bytes fits into the
+         * ringbuffer now, e.g. to wait for the reader before writing from a
+         * non-realtime thread instead of dropping the message
+         */
+        bool can_write(size_t len);
+
+        //! Maximum message length passed to the constructor
+        size_t max_message_length(void) const { return MaxMsg; }
+
         /**
          * @returns true iff there is another message to be read in the buffer
          */
@@ -72,6 +144,68 @@ class ThreadLink
          */
         msg_t read(void);
 
+        /**
+         * Set up a wakeup channel for wait() and wakeup_fd()
+         *
+         * Once enabled, writers signal the channel when they publish a
+         * message while the reader is waiting. Signaling is a single
+         * non-blocking system call, and only happens for the first message
+         * after the reader armed the channel.
+         * @returns false if the channel could not be created
+         */
+        bool enable_wakeup(void);
+
+        /**
+         * Block the (non-realtime) reader until a message is pending
+         *
+         * Without enable_wakeup(), this returns immediately.
+         * @param timeout_ms Maximum time to wait, -1 to wait forever
+         * @returns hasNext()
+         */
+        bool wait(int timeout_ms = -1);
+
+        /**
+         * File descriptor becoming readable when armed and a message gets
+         * written, for integrating the link into a poll loop:
+         *
+         * @code
+         *     if(link.arm_wakeup())
+         *         poll(..., link.wakeup_fd(), ...);
+         *     link.clear_wakeup();
+         *     while(link.hasNext())
+         *         handle(link.read());
+         * @endcode
+         * @returns the descriptor, or -1 if not available
+         */
+        int wakeup_fd(void) const;
+        //! Announce that the reader will sleep
+        //! @returns false if messages are pending already (do not sleep)
+        bool arm_wakeup(void);
+        //! Consume the signal after sleeping
+        void clear_wakeup(void);
+
+        typedef void (*read_cb_t)(const char *msg, size_t len, void *data);
+
+        /**
+         * Read all pending messages at once
+         *
+         * Messages are passed in place, if they do not wrap around the end
+         * of the ringbuffer, and are only valid during the callback. The
+         * space of all messages is given back to the writer after the last
+         * callback. The callback must not read from this link.
+         * @returns the number of messages read
+         */
+        size_t read_all(read_cb_t cb, void *data);
+
+        //! read_all() with any callable taking (const char *msg, size_t len)
+        template<class F>
+        size_t read_all(F &&f)
+        {
+            return read_all([](const char *msg, size_t len, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)(msg, len);
+                }, (void*)&f);
+        }
+
         /**
          * Peak at last message read without reading another
          */
@@ -85,13 +219,112 @@ class ThreadLink
          * Access to write buffer length
          */
         size_t buffer_size(void) const;
+
+        enum { latency_buckets = 16 };
+
+        struct stats_t
+        {
+            size_t   capacity;       //!< bytes, including message headers
+            size_t   occupancy;      //!< bytes currently in use
+            size_t   peak_occupancy; //!< bytes in use after any write
+            uint64_t written;
+            uint64_t read;
+            uint64_t dropped;  //!< writes which failed or did not fit
+            double   seconds;  //!< time since the statistics were reset
+            //! how long messages waited, bucket i counting waits below
+            //! 2^(i+6) ns (the last one counts all the longer ones)
+            uint32_t latency[latency_buckets];
+
+            double messages_per_second(void) const
+            {
+                return seconds > 0 ? read / seconds : 0;
+            }
+        };
+
+        /**
+         * Snapshot of the statistics, can be taken from any thread
+         *
+         * Without statistics enabled, only capacity and occupancy are set.
+         */
+        stats_t stats(void) const;
+        //! Restart the statistics (not synchronized with reader or writer)
+        void reset_stats(void);
+
+        //! @returns false if lock_memory was requested but failed, e.g. due
+        //!          to RLIMIT_MEMLOCK
+        bool memory_locked(void) const { return locked; }
+
+        /**
+         * Ports for reading the statistics; d.obj must be the link:
+         * - "occupancy:" replies "iii" (occupancy, peak, capacity in bytes)
+         * - "counters:" replies "hhh" (written, read and dropped messages)
+         * - "rate:" replies the read messages per second
+         * - "latency:" replies the latency histogram as int32
+         * - "reset:"
+         */
+        static const Ports ports;
+        //! Port "stats/" for merging ThreadLink::ports into a tree
+        Port statsPort(void);
     private:
+        ThreadLink(void *segment, size_t segment_size, const char *name);
+
         const size_t MaxMsg;
         const size_t BufferSize;
         char *write_buffer;
         char *read_buffer;
+        bool  locked;
 
         struct internal_ringbuffer_t *ring;
 };
+
+/**
+ * MultiProducerLink - A ThreadLink which any number of threads can write to
+ *
+ * Writers claim one of max_messages fixed size slots, then format or copy
+ * their message directly into it, and publish it. Claiming never blocks: if
+ * all slots are in use, the message is dropped, like in a full ThreadLink.
+ * There is still only one reader, which drains the slots in the order they
+ * were claimed. A writer which is interrupted between claiming and
+ * publishing delays the messages behind it until it publishes.
+ *
+ * There is no shared write buffer(), writers should use raw_write() for
+ * messages they build themselves.
+ */
+class MultiProducerLink
+{
+    public:
+        MultiProducerLink(size_t max_message_length, size_t max_messages);
+        ~MultiProducerLink(void);
+        MultiProducerLink(const MultiProducerLink&) = delete;
+
+        //! @see ThreadLink::write()
+        void write(const char *dest, const char *args, ...);
+        //! @see ThreadLink::writeArray()
+        void writeArray(const char *dest, const char *args,
+                        const rtosc_arg_t *aargs);
+        //! @see ThreadLink::raw_write()
+        void raw_write(const char *msg);
+
+        bool hasNext(void) const;
+        msg_t read(void);
+        //! @see ThreadLink::read_all(), all messages are passed in place
+        size_t read_all(ThreadLink::read_cb_t cb, void *data);
+        template<class F>
+        size_t read_all(F &&f)
+        {
+            return read_all([](const char *msg, size_t len, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)(msg, len);
+                }, (void*)&f);
+        }
+        msg_t peak(void) const;
+
+        size_t buffer_size(void) const;
+    private:
+        const size_t MaxMsg;
+        const size_t MaxMessages;
+        char *read_buffer;
+
+        struct internal_mpsc_ring_t *ring;
+};
 };
 #endif
@@ -0,0 +1,119 @@
+/**
+ * @file trace.h
+ * Timeline traces of dispatch, ThreadLink, savefile and automation activity
+ *
+ * rtosc has trace points at
+ * - each leaf port called by Ports::dispatch() (category "dispatch")
+ * - each message written to and read from a ThreadLink ("link")
+ * - saving and loading savefiles ("savefile")
+ * - automation processing and MIDI handling ("automation", "midi")
+ *
+ * and applications can add their own, e.g. around each audio period, to see
+ * xruns and OSC activity on one timeline. Events are recorded into a buffer
+ * per thread, without locks or allocations, and exported as Chrome trace
+ * JSON, which chrome://tracing and the Perfetto UI both open.
+ *
+ * While tracing is stopped, each trace point costs only one predictable
+ * branch. Threads must call attach_thread() before their events are
+ * recorded; events of other threads are dropped.
+ *
+ * @test trace.cpp
+ */
+
+#ifndef RTOSC_TRACE_H
+#define RTOSC_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rtosc {
+namespace trace {
+
+//! Whether tracing runs, see active()
+extern std::atomic<bool> enabled;
+
+//! Whether events are recorded now; check this before calling the functions
+//! recording events
+inline bool active(void)
+{
+#ifdef __GNUC__
+    return __builtin_expect(enabled.load(std::memory_order_relaxed), 0);
+#else
+    return enabled.load(std::memory_order_relaxed);
+#endif
+}
+
+//! Start recording events
+void start(void);
+//! Stop recording events, the recorded events are kept
+void stop(void);
+
+/**
+ * Give the calling thread a buffer of @p max_events events
+ *
+ * When the buffer is full, further events are dropped. The buffer is kept
+ * after the thread exits, until clear(). This allocates, so call it when
+ * the thread starts, not from the realtime thread's callback.
+ * @param name The thread's name in the trace, e.g. "audio"
+ * @return false if the thread already has a buffer
+ */
+bool attach_thread(const char *name, std::size_t max_events = 1 << 16);
+//! Stop recording events of the calling thread
+void detach_thread(void);
+
+/**
+ * Event recording
+ *
+ * @p cat and @p name are only referenced, so they must stay valid until the
+ * events are exported, like string literals or port names.
+ */
+//! Begin a slice, which ends with the next end() of the thread
+void begin(const char *cat, const char *name);
+void end(const char *cat, const char *name);
+//! An event without duration, with an optional value
+void instant(const char *cat, const char *name, int64_t value = 0);
+//! A sample of the counter @p name, e.g. a queue's fill level
+void counter(const char *cat, const char *name, int64_t value);
+
+//! Begins a slice if tracing is active, and ends it on destruction
+class scope_t
+{
+    public:
+        scope_t(const char *cat, const char *name)
+            :cat(cat), name(active() ? name : NULL)
+        {
+            if(this->name)
+                begin(cat, name);
+        }
+        ~scope_t(void)
+        {
+            if(name)
+                end(cat, name);
+        }
+        scope_t(const scope_t&) = delete;
+    private:
+        const char *cat, *name;
+};
+
+/**
+ * All recorded events, as Chrome trace JSON
+ *
+ * This can be called while tracing runs, then events recorded meanwhile may
+ * be missing.
+ */
+std::string chrome_json(void);
+//! Write chrome_json() to @p filename, @return false on errors
+bool write_chrome_json(const char *filename);
+
+//! Number of events dropped because of a full buffer, or a missing one
+uint64_t dropped(void);
+//! Drop all events and the buffers of exited threads; only call it while
+//! tracing is stopped
+void clear(void);
+
+}
+}
+
+#endif
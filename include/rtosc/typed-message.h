@@ -2,6 +2,8 @@
 #define RTOSC_TYPED_MESSAGE_H
 #include <rtosc/typestring.hh>
 #include <rtosc/rtosc.h>
+#include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <stdexcept>
 
@@ -161,5 +163,190 @@ second(rtMsg<Types...>&Tuple)
     return get<1>(Tuple);
 }
 
+/*
+ * Compile time message layouts
+ */
+
+//! OSC type tag and size of the fixed size argument types
+template<class T> struct osc_fixed_type;
+template<> struct osc_fixed_type<int32_t> { enum { tag = 'i', size = 4 }; };
+template<> struct osc_fixed_type<float>   { enum { tag = 'f', size = 4 }; };
+template<> struct osc_fixed_type<int64_t> { enum { tag = 'h', size = 8 }; };
+template<> struct osc_fixed_type<double>  { enum { tag = 'd', size = 8 }; };
+
+template<class... Types> struct osc_args_size { enum { value = 0 }; };
+template<class This, class... Rest>
+struct osc_args_size<This, Rest...>
+{
+    enum { value = osc_fixed_type<This>::size + osc_args_size<Rest...>::value };
+};
+
+//! offset of argument Index, relative to the first argument
+template<size_t Index, class... Types> struct osc_arg_offset;
+template<class This, class... Rest>
+struct osc_arg_offset<0, This, Rest...> { enum { value = 0 }; };
+template<size_t Index, class This, class... Rest>
+struct osc_arg_offset<Index, This, Rest...>
+{
+    enum { value = osc_fixed_type<This>::size +
+                   osc_arg_offset<Index-1, Rest...>::value };
+};
+
+template<size_t Index, class This, class... Rest>
+struct osc_nth_type { typedef typename osc_nth_type<Index-1, Rest...>::type type; };
+template<class This, class... Rest>
+struct osc_nth_type<0, This, Rest...> { typedef This type; };
+
+template<size_t... I> struct osc_index_seq {};
+template<size_t N, size_t... I>
+struct osc_make_index_seq : osc_make_index_seq<N-1, N-1, I...> {};
+template<size_t... I>
+struct osc_make_index_seq<0, I...> { typedef osc_index_seq<I...> type; };
+
+//! Big endian stores and loads; compilers turn the shifts into byte swaps
+inline void osc_store(uint8_t *p, int32_t v)
+{
+    const uint32_t u = v;
+    p[0] = u >> 24; p[1] = u >> 16; p[2] = u >> 8; p[3] = u;
+}
+inline void osc_store(uint8_t *p, int64_t v)
+{
+    osc_store(p,   (int32_t)((uint64_t)v >> 32));
+    osc_store(p+4, (int32_t)v);
+}
+inline void osc_store(uint8_t *p, float v)
+{
+    int32_t i;
+    memcpy(&i, &v, 4);
+    osc_store(p, i);
+}
+inline void osc_store(uint8_t *p, double v)
+{
+    int64_t i;
+    memcpy(&i, &v, 8);
+    osc_store(p, i);
+}
+
+template<class T> T osc_load(const uint8_t *p);
+template<> inline int32_t osc_load<int32_t>(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8  | (uint32_t)p[3];
+}
+template<> inline int64_t osc_load<int64_t>(const uint8_t *p)
+{
+    return (uint64_t)(uint32_t)osc_load<int32_t>(p) << 32 |
+           (uint32_t)osc_load<int32_t>(p+4);
+}
+template<> inline float osc_load<float>(const uint8_t *p)
+{
+    const int32_t i = osc_load<int32_t>(p);
+    float f;
+    memcpy(&f, &i, 4);
+    return f;
+}
+template<> inline double osc_load<double>(const uint8_t *p)
+{
+    const int64_t i = osc_load<int64_t>(p);
+    double d;
+    memcpy(&d, &i, 8);
+    return d;
+}
+
+/**
+ * Layout of messages with a fixed signature, known at compile time
+ *
+ * Types can be int32_t ('i'), float ('f'), int64_t ('h') and double ('d').
+ * The type tags, their padding and all argument offsets are constants, so
+ * writing and reading messages are straight stores and loads, plus one
+ * strlen() of the path. No type string is parsed.
+ *
+ * @code
+ *     typedef MsgLayout<int32_t, int32_t, float> Note; // "/note:iif"
+ *     size_t len = Note::write(buf, sizeof(buf), "/note", 0, 64, 0.5f);
+ *     if(Note::matches(msg))
+ *         play(Note::get<1>(msg), Note::get<2>(msg));
+ * @endcode
+ */
+template<class... Types>
+class MsgLayout
+{
+    public:
+        enum {
+            nargs     = sizeof...(Types),
+            //! size of the type tag string, including ',' and padding
+            tags_size = (1 + sizeof...(Types)) / 4 * 4 + 4,
+            args_size = osc_args_size<Types...>::value
+        };
+
+        //! the type tag string, including ',' and padding
+        static const char *tags(void)
+        {
+            static const char t[tags_size] = {',', osc_fixed_type<Types>::tag...};
+            return t;
+        }
+
+        //! @returns the message length for a path of @p path_len chars
+        static constexpr size_t length(size_t path_len)
+        {
+            return path_len / 4 * 4 + 4 + tags_size + args_size;
+        }
+
+        //! Offset of argument @p Index relative to the type tags
+        template<size_t Index>
+        static constexpr size_t offset(void)
+        {
+            return tags_size + osc_arg_offset<Index, Types...>::value;
+        }
+
+        /**
+         * Write a message
+         * @returns length of the message or zero if bounds are exceeded
+         */
+        static size_t write(char *buffer, size_t len, const char *path,
+                            Types... args)
+        {
+            const size_t path_len = strlen(path);
+            const size_t total    = length(path_len);
+            if(total > len)
+                return 0;
+            const size_t tag_pos = path_len / 4 * 4 + 4;
+            memset(buffer + path_len, 0, tag_pos - path_len);
+            memcpy(buffer, path, path_len);
+            memcpy(buffer + tag_pos, tags(), tags_size);
+            store((uint8_t*)buffer + tag_pos,
+                  typename osc_make_index_seq<nargs>::type(), args...);
+            return total;
+        }
+
+        //! @returns true iff @p msg has exactly this signature
+        static bool matches(const char *msg)
+        {
+            return !strcmp(type_pos(msg), tags());
+        }
+
+        //! Read argument @p Index, @p msg must match the layout
+        template<size_t Index>
+        static typename osc_nth_type<Index, Types...>::type
+        get(const char *msg)
+        {
+            typedef typename osc_nth_type<Index, Types...>::type T;
+            return osc_load<T>((const uint8_t*)type_pos(msg) + offset<Index>());
+        }
+
+    private:
+        static const char *type_pos(const char *msg)
+        {
+            return msg + strlen(msg) / 4 * 4 + 4;
+        }
+
+        template<size_t... I>
+        static void store(uint8_t *tag_pos, osc_index_seq<I...>, Types... args)
+        {
+            const int expand[] = {0, (osc_store(tag_pos + offset<I>(), args), 0)...};
+            (void)expand;
+        }
+};
+
 };
 #endif
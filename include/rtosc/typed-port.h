@@ -0,0 +1,209 @@
+/**
+ * @file typed-port.h
+ * Ports declared with C++ types instead of type strings
+ *
+ * A typed port is declared by its name, the C++ type of its value, how the
+ * value is read and written on the object, and its metadata. The port's
+ * name (like "volume::f") is generated at compile time, and its callback
+ * decodes the argument at a fixed offset, without parsing type strings or
+ * calling rtosc_argument(). The resulting Port can be put into any Ports
+ * table, next to the ports of port-sugar.h.
+ *
+ * @code
+ *     struct Voice {
+ *         float volume;
+ *         int   note(void) const;
+ *         void  set_note(int);
+ *     };
+ *     #define rObject Voice
+ *     Ports voice_ports = {
+ *         rTypedParam(volume, rLog(1e-3, 1), "loudness"),
+ *         rTypedProperty(note, note, set_note, "MIDI note")
+ *     };
+ *     #undef rObject
+ * @endcode
+ *
+ * @test typed-template-test.cpp
+ */
+
+#ifndef RTOSC_TYPED_PORT_H
+#define RTOSC_TYPED_PORT_H
+
+#include <cstdint>
+#include <utility>
+#include <rtosc/typed-message.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/change-tracker.h>
+
+namespace rtosc
+{
+
+template<class A, class B, class C> struct typestring_cat;
+template<char... A, char... B, char... C>
+struct typestring_cat<irqus::typestring<A...>, irqus::typestring<B...>,
+                      irqus::typestring<C...>>
+{
+    typedef irqus::typestring<A..., B..., C...> type;
+};
+
+/**
+ * OSC side of the value types of typed ports
+ *
+ * Numbers are passed as their MsgLayout type, bools as 'T' and 'F'.
+ */
+template<class T, class Enable = void> struct typed_port_value;
+
+template<class T>
+struct typed_port_value<T, typename std::enable_if<
+    std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value>::type>
+{
+    typedef irqus::typestring<(char)osc_fixed_type<T>::tag> tags;
+    typedef MsgLayout<T> layout;
+
+    //! Whether @p args (the type string) can set the value
+    static bool accepts(const char *args)
+    {
+        return args[0] == osc_fixed_type<T>::tag && !args[1];
+    }
+    //! Decode the argument; the type tags start at @p args - 1
+    static T load(const char *args)
+    {
+        return osc_load<T>((const uint8_t*)args - 1 + layout::tags_size);
+    }
+    static size_t write(char *buffer, size_t len, const char *path, T value)
+    {
+        return layout::write(buffer, len, path, value);
+    }
+};
+
+template<>
+struct typed_port_value<bool>
+{
+    typedef irqus::typestring<'T', ':', 'F'> tags;
+
+    static bool accepts(const char *args)
+    {
+        return (args[0] == 'T' || args[0] == 'F') && !args[1];
+    }
+    static bool load(const char *args) { return args[0] == 'T'; }
+    static size_t write(char *buffer, size_t len, const char *path, bool value)
+    {
+        return rtosc_message(buffer, len, path, value ? "T" : "F");
+    }
+};
+
+//! Access to a value through a data member
+template<class Obj, class T, T Obj::*Member>
+struct member_access
+{
+    typedef T type;
+    static T get(const Obj &obj) { return obj.*Member; }
+    static void set(Obj &obj, T value) { obj.*Member = value; }
+};
+
+//! Access to a value through a getter and a setter
+template<class Obj, class T, T (Obj::*Get)(void) const, void (Obj::*Set)(T)>
+struct method_access
+{
+    typedef T type;
+    static T get(const Obj &obj) { return (obj.*Get)(); }
+    static void set(Obj &obj, T value) { (obj.*Set)(value); }
+};
+
+/**
+ * A typed port
+ *
+ * Without arguments, the port replies the value. With an argument of its
+ * type, it sets the value, replies "/undo_change" if the value changed,
+ * broadcasts the new value and marks the change (see ChangeTracker). Like
+ * for rParamF(), this makes it a parameter if the metadata says so. Other
+ * arguments are ignored. Values are not limited to the "min" and "max"
+ * metadata; a setter can do that.
+ *
+ * @tparam Name The port's name as typestring, e.g. typestring_is("volume")
+ * @tparam Obj The type of RtData::obj
+ * @tparam Access member_access or method_access
+ */
+template<class Name, class Obj, class Access>
+struct typed_port
+{
+    typedef typename Access::type T;
+    typedef typed_port_value<T> value_t;
+    typedef typename typestring_cat<Name, irqus::typestring<':', ':'>,
+                                    typename value_t::tags>::type name_t;
+
+    //! The port's name, e.g. "volume::f"
+    static const char *name(void) { return name_t::data(); }
+
+    static void cb(const char *msg, RtData &data)
+    {
+        Obj &obj = *(Obj*)data.obj;
+        const char *args = rtosc_argument_string(msg);
+        const char *loc  = data.location();
+        char buffer[1024];
+
+        if(!*args) {
+            if(value_t::write(buffer, sizeof(buffer), loc, Access::get(obj)))
+                data.reply(buffer);
+        } else if(value_t::accepts(args)) {
+            const T old = Access::get(obj);
+            Access::set(obj, value_t::load(args));
+            const T cur = Access::get(obj);
+            if(old != cur)
+                reply_undo(data, loc, old, cur);
+            if(value_t::write(buffer, sizeof(buffer), loc, cur))
+                data.broadcast(buffer);
+            if(data.changes)
+                data.changes->mark(loc);
+        }
+    }
+
+    //! A Port with this name and callback, and @p metadata
+    static Port port(const char *metadata)
+    {
+        return Port{name(), metadata, nullptr, &typed_port::cb};
+    }
+
+    private:
+        static void reply_undo(RtData &data, const char *loc, T old, T cur)
+        {
+            const char tag = std::is_same<T, bool>::value
+                           ? 0 : osc_tag<T>::value;
+            if(tag) {
+                const char tags[] = {'s', tag, tag, 0};
+                data.reply("/undo_change", tags, loc, old, cur);
+            } else {
+                data.reply("/undo_change", old ? (cur ? "sTT" : "sTF")
+                                               : (cur ? "sFT" : "sFF"), loc);
+            }
+        }
+
+        template<class U, class Enable = void>
+        struct osc_tag { enum { value = 0 }; };
+        template<class U>
+        struct osc_tag<U, typename std::enable_if<
+            !std::is_same<U, bool>::value>::type>
+        { enum { value = osc_fixed_type<U>::tag }; };
+};
+
+}
+
+//! Typed parameter for the member @p name of rObject, see typed_port
+#define rTypedParam(name, ...) \
+    rtosc::typed_port<typestring_is(#name), rObject, \
+        rtosc::member_access<rObject, decltype(rObject::name), \
+                             &rObject::name>>::port( \
+        rProp(parameter) DOC(__VA_ARGS__))
+
+//! Typed parameter @p name of rObject, accessed through a getter and a
+//! setter, see typed_port
+#define rTypedProperty(name, getter, setter, ...) \
+    rtosc::typed_port<typestring_is(#name), rObject, \
+        rtosc::method_access<rObject, \
+            decltype(std::declval<const rObject&>().getter()), \
+            &rObject::getter, &rObject::setter>>::port( \
+        rProp(parameter) DOC(__VA_ARGS__))
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @file udp-transport.h
+ * Batched sending and receiving of OSC messages via UDP
+ *
+ * This is part of the rtosc-net library.
+ *
+ * @test udp-transport.cpp
+ */
+
+#ifndef RTOSC_UDP_TRANSPORT_H
+#define RTOSC_UDP_TRANSPORT_H
+
+#include <cstddef>
+#include <type_traits>
+
+namespace rtosc {
+
+class ThreadLink;
+
+//! Address of a UDP peer, large enough for IPv4 and IPv6 addresses
+struct UdpPeer
+{
+    //! storage for the struct sockaddr
+    alignas(8) unsigned char addr[128];
+    unsigned len;
+
+    /**
+     * Resolve a host and port
+     * @param host Host name or numeric address, NULL for localhost
+     * @return false if the host could not be resolved
+     */
+    bool resolve(const char *host, unsigned short port);
+    //! Port of the peer, 0 if unknown
+    unsigned short port(void) const;
+};
+
+/**
+ * UDP socket which moves multiple datagrams per system call
+ *
+ * Received datagrams are written into a pool of buffers which is allocated
+ * once, and then validated: datagrams which are neither valid OSC messages
+ * nor bundles, or which exceed the maximum message length, are dropped.
+ * All valid datagrams of one receive() call are visible at the same time,
+ * so they can be passed to a ThreadLink, or dispatched as a batch, e.g.
+ * by a ParallelDispatcher.
+ *
+ * Outgoing messages are copied into a second pool by queue() and sent
+ * together by flush(). Queueing into a full pool flushes it first.
+ *
+ * On Linux, recvmmsg() and sendmmsg() are used. Other systems fall back to
+ * one system call per datagram. The socket is not blocking for receive(),
+ * wait() can be used to sleep until datagrams arrive. A transport must only
+ * be used by one thread at a time.
+ */
+class UdpTransport
+{
+    public:
+        /**
+         * @param max_message_length Maximum length of any datagram
+         * @param batch Number of datagrams per system call, i.e. the size
+         *              of each buffer pool
+         */
+        UdpTransport(size_t max_message_length = 1024, size_t batch = 64);
+        ~UdpTransport(void);
+        UdpTransport(const UdpTransport&) = delete;
+
+        /**
+         * Open a socket bound to @p port
+         * @param port The port, 0 for any free port
+         * @param host Interface address to bind to, NULL for all interfaces
+         * @return false if the socket could not be opened
+         */
+        bool open(unsigned short port = 0, const char *host = nullptr);
+        void close(void);
+        bool is_open(void) const { return sock != -1; }
+        //! The socket, e.g. to poll it together with other files
+        int fd(void) const { return sock; }
+        //! The port the socket is bound to, 0 if it is not open
+        unsigned short port(void) const;
+
+        /**
+         * Wait until datagrams can be received
+         * @param timeout_ms Time to wait at most, -1 to wait forever
+         * @return false on timeout or error
+         */
+        bool wait(int timeout_ms = -1);
+
+        typedef void (*batch_cb_t)(const char *const *msgs, const size_t *lens,
+                                   const UdpPeer *from, size_t n, void *data);
+
+        /**
+         * Receive all datagrams which are pending, at most one batch
+         *
+         * This does not block. The valid messages are passed to @p cb with
+         * one call, in the order they arrived. They are only valid during
+         * the callback, which is not called if no message was received.
+         * @return The number of valid messages
+         */
+        size_t receive_batch(batch_cb_t cb, void *data);
+        //! receive_batch() with any callable taking the arguments of batch_cb_t
+        //! except for data
+        template<class F>
+        size_t receive_batch(F &&f)
+        {
+            return receive_batch([](const char *const *msgs, const size_t *lens,
+                                    const UdpPeer *from, size_t n, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)
+                        (msgs, lens, from, n);
+                }, (void*)&f);
+        }
+
+        typedef void (*read_cb_t)(const char *msg, size_t len,
+                                  const UdpPeer &from, void *data);
+
+        //! receive_batch(), but @p cb is called once per message
+        size_t receive(read_cb_t cb, void *data);
+        template<class F>
+        size_t receive(F &&f)
+        {
+            return receive([](const char *msg, size_t len,
+                              const UdpPeer &from, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)
+                        (msg, len, from);
+                }, (void*)&f);
+        }
+
+        /**
+         * Receive pending datagrams into @p link
+         *
+         * Messages which do not fit into the link are dropped.
+         * @return The number of messages written to the link
+         */
+        size_t receive(ThreadLink &link);
+
+        /**
+         * Queue a message for sending to @p to
+         * @param msg An OSC message or bundle
+         * @param len Length of @p msg
+         * @return false if the message is longer than the maximum message
+         *         length, or if the pool was full and could not be flushed
+         */
+        bool queue(const char *msg, size_t len, const UdpPeer &to);
+
+        /**
+         * Send all queued messages
+         *
+         * Messages which can not be sent are dropped, see send_errors().
+         * @return The number of messages sent
+         */
+        size_t flush(void);
+        //! Number of queued messages which have not been sent yet
+        size_t queued(void) const { return send_count; }
+
+        /**
+         * Send one message to multiple peers, without copying it
+         *
+         * Queued messages are flushed first. The message is sent directly
+         * from @p msg, with one system call per batch of peers.
+         * @return The number of peers the message has been sent to
+         */
+        size_t send_to_all(const char *msg, size_t len, const UdpPeer *to,
+                           size_t n);
+
+        //! Number of valid messages received since the socket was opened
+        size_t received(void) const { return stat_received; }
+        //! Number of received datagrams which have been dropped
+        size_t dropped(void) const  { return stat_dropped; }
+        //! Number of messages sent since the socket was opened
+        size_t sent(void) const     { return stat_sent; }
+        //! Number of queued messages which could not be sent
+        size_t send_errors(void) const { return stat_send_errors; }
+
+    private:
+        size_t fill(void);
+        size_t send_pool_messages(size_t count);
+
+        const size_t MaxMsg;
+        const size_t Batch;
+        int sock;
+
+        struct udp_pool_t *recv_pool, *send_pool;
+        size_t send_count;
+
+        //pointers to the valid messages of the last fill()
+        const char **msgs;
+        size_t      *lens;
+        UdpPeer     *peers;
+
+        size_t stat_received, stat_dropped, stat_sent, stat_send_errors;
+};
+
+}
+
+#endif
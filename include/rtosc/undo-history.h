@@ -1,20 +1,76 @@
 #ifndef RTOSC_UNDO_H
 #define RTOSC_UNDO_H
+#include <cstddef>
 #include <functional>
+#include <string>
 
 namespace rtosc
 {
+class AddressTable;
+
 /**
  * Known event types:
  * /undo_change /path/location old-data new-data
  */
 class UndoHistory
 {
-    //TODO think about the consequences of largish loads
     public:
+        //! Creates a history of at most 20 events in 16 KiB
         UndoHistory(void);
         ~UndoHistory(void);
 
+        /**
+         * Set the memory budget and clear the history
+         *
+         * All messages are stored in one buffer of @p max_bytes bytes,
+         * which is allocated here, so recording events does not allocate.
+         * If a new event exceeds one of the limits, the oldest events are
+         * dropped. Events larger than @p max_bytes are not recorded.
+         */
+        void setLimits(size_t max_bytes, size_t max_events);
+
+        /**
+         * Set the time window for coalescing events
+         *
+         * A change to a path which has been changed less than @p seconds
+         * ago is merged into the recorded event, which then holds the
+         * first old value and the last new value. The default is 2
+         * seconds, 0 disables merging outside of gestures.
+         */
+        void setMergeWindow(double seconds);
+
+        /**
+         * Store the events compactly and clear the history
+         *
+         * Paths which are interned in @p table are stored by their IDs.
+         * The values of blob and string ports are stored as differences:
+         * only the changed bytes of the old and the new value are kept,
+         * and the whole value is kept once per path, at the current
+         * history position. Editing one element of a large blob thus costs
+         * a few bytes per event instead of two copies of the blob. Other
+         * values are stored without their type tags and path.
+         *
+         * Recording allocates then, to keep the values per path, and
+         * getHistory() returns the events decoded. Events which are no
+         * "/undo_change path old new" with equal types are stored as is.
+         * @param table Table of the paths, may be NULL, must outlive the
+         *   history
+         */
+        void setCompact(bool compact, const AddressTable *table = nullptr);
+
+        /**
+         * Begin a gesture, e.g. when a slider is grabbed
+         *
+         * Until endGesture() is called, all changes to the same path are
+         * merged into one event, no matter how much time has passed.
+         * Changes of a gesture are never merged with events recorded
+         * before or after it. Gestures can be nested, only the outermost
+         * one counts.
+         */
+        void beginGesture(void);
+        //! End a gesture started with beginGesture()
+        void endGesture(void);
+
         //Records any undoable event
         void recordEvent(const char *msg);
 
@@ -25,7 +81,46 @@ class UndoHistory
         //Negative values mean undo, positive values mean redo
         void seekHistory(int distance);
 
+        /**
+         * Journal the history in a file, so it survives restarts
+         *
+         * The history is cleared and rebuilt from the operations in the
+         * file, if it exists. Then, all further operations are appended
+         * to it. The callbacks are not called for the journaled seeks,
+         * i.e. the application must restore its state itself, e.g. from
+         * a savefile. An incompletely written last record, e.g. after a
+         * crash, is cut off.
+         * @return false if the file could not be opened or is no journal.
+         *   The history then contains the operations read until the error,
+         *   and nothing is being journaled.
+         */
+        bool openJournal(const char *path);
+        //! Stop journaling; the destructor calls this, too
+        void closeJournal(void);
+
+        /**
+         * Enable checkpoints for seeking far
+         *
+         * A checkpoint stores a snapshot of the whole state, e.g. a
+         * savefile, at the current history position. When seeking, the
+         * nearest checkpoint is passed to @p restore if this saves
+         * replaying at least @p interval events (at least one), and only the
+         * events between the checkpoint and the destination are replayed.
+         * Checkpoints are journaled, too.
+         * @param interval Call @p snapshot automatically after this many
+         *   recorded events, 0 means only addCheckpoint() adds checkpoints
+         */
+        void setCheckpoints(size_t interval,
+                            std::function<std::string(void)> snapshot,
+                            std::function<void(const char*)> restore);
+        //! Add a checkpoint with the given snapshot at the current position
+        void addCheckpoint(const char *snapshot);
+        //! Number of checkpoints for the events in the history
+        size_t checkpoints(void) const;
+
         unsigned getPos(void) const;
+        //! The i-th event; compact events are decoded into a buffer which
+        //! is valid until the next call
         const char *getHistory(int i) const;
         size_t size(void) const;
 
@@ -0,0 +1,136 @@
+/**
+ * @file uring-transport.h
+ * UDP transport driven by io_uring (Linux only)
+ *
+ * This is part of the rtosc-net library, if it has been built with
+ * io_uring support.
+ *
+ * @test udp-transport.cpp
+ */
+
+#ifndef RTOSC_URING_TRANSPORT_H
+#define RTOSC_URING_TRANSPORT_H
+
+#include <cstddef>
+#include <type_traits>
+#include <rtosc/udp-transport.h>
+
+namespace rtosc {
+
+/**
+ * UDP socket served by an io_uring, with the interface of UdpTransport
+ *
+ * Receiving uses one multishot recvmsg request, which stays armed while
+ * the kernel writes datagrams into a ring of provided buffers. Completions
+ * are read from shared memory, so receive() only enters the kernel if the
+ * request has to be armed again, e.g. after all buffers had been in use.
+ * The buffers of a batch are given back to the kernel after the callback.
+ *
+ * flush() submits all queued messages with one system call and waits for
+ * their completion. With zero copy sends, the kernel sends from the queue's
+ * buffers directly, and flush() also waits until it has released them.
+ *
+ * Datagrams are validated like by UdpTransport. A transport must only be
+ * used by one thread at a time.
+ */
+class UringTransport
+{
+    public:
+        /**
+         * @param max_message_length Maximum length of any datagram
+         * @param batch Maximum number of messages per receive callback
+         *              and number of messages which can be queued
+         * @param buffers Number of receive buffers, rounded up to a power
+         *                of 2, 0 for four times @p batch
+         */
+        UringTransport(size_t max_message_length = 1024, size_t batch = 64,
+                       size_t buffers = 0);
+        ~UringTransport(void);
+        UringTransport(const UringTransport&) = delete;
+
+        /**
+         * Open a socket bound to @p port and set up the ring
+         * @return false if the socket could not be opened, or if the kernel
+         *         does not support the required io_uring features
+         */
+        bool open(unsigned short port = 0, const char *host = nullptr);
+        void close(void);
+        bool is_open(void) const { return sock != -1; }
+        //! The socket
+        int fd(void) const { return sock; }
+        //! The io_uring, which can be polled for incoming messages
+        int ring_fd(void) const;
+        unsigned short port(void) const;
+
+        //! Send with IORING_OP_SENDMSG_ZC instead of copying the messages
+        void set_zero_copy(bool zc) { zero_copy = zc; }
+
+        //! @see UdpTransport::wait()
+        bool wait(int timeout_ms = -1);
+
+        typedef UdpTransport::batch_cb_t batch_cb_t;
+        typedef UdpTransport::read_cb_t  read_cb_t;
+
+        //! @see UdpTransport::receive_batch()
+        size_t receive_batch(batch_cb_t cb, void *data);
+        template<class F>
+        size_t receive_batch(F &&f)
+        {
+            return receive_batch([](const char *const *msgs, const size_t *lens,
+                                    const UdpPeer *from, size_t n, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)
+                        (msgs, lens, from, n);
+                }, (void*)&f);
+        }
+
+        //! @see UdpTransport::receive()
+        size_t receive(read_cb_t cb, void *data);
+        template<class F>
+        size_t receive(F &&f)
+        {
+            return receive([](const char *msg, size_t len,
+                              const UdpPeer &from, void *data) {
+                    (*(typename std::remove_reference<F>::type*)data)
+                        (msg, len, from);
+                }, (void*)&f);
+        }
+        size_t receive(ThreadLink &link);
+
+        //! @see UdpTransport::queue()
+        bool queue(const char *msg, size_t len, const UdpPeer &to);
+        //! @see UdpTransport::flush()
+        size_t flush(void);
+        size_t queued(void) const { return send_count; }
+
+        size_t received(void) const { return stat_received; }
+        size_t dropped(void) const  { return stat_dropped; }
+        size_t sent(void) const     { return stat_sent; }
+        size_t send_errors(void) const { return stat_send_errors; }
+
+    private:
+        size_t fill(void);
+        void reap(void);
+        void give_back(void);
+
+        const size_t MaxMsg;
+        const size_t Batch;
+        const size_t Buffers;
+        int sock;
+        bool zero_copy;
+
+        struct uring_t *ring;
+        struct udp_pool_t *send_pool;
+        size_t send_count;
+
+        const char **msgs;
+        size_t      *lens;
+        UdpPeer     *peers;
+        unsigned short *bids; //!< buffers of the last batch
+        size_t nbids;
+
+        size_t stat_received, stat_dropped, stat_sent, stat_send_errors;
+};
+
+}
+
+#endif
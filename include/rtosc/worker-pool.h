@@ -0,0 +1,118 @@
+/**
+ * @file worker-pool.h
+ * Work stealing thread pool, shared by the non-realtime parts of rtosc
+ *
+ * @test worker-pool.cpp
+ */
+
+#ifndef RTOSC_WORKER_POOL_H
+#define RTOSC_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtosc {
+
+/**
+ * Pool of worker threads for the non-realtime parts of the library
+ *
+ * All jobs of one run() are distributed over the workers, and run() returns
+ * when all of them are done. Each worker starts with a contiguous range of
+ * the jobs, so neighboring jobs (e.g. neighboring subtrees) run on the same
+ * core, and workers which are done steal half of the remaining range of
+ * another worker.
+ *
+ * Parallel dispatch (ParallelDispatcher) and parallel saving
+ * (get_changed_values_parallel()) use shared() by default, so an
+ * application only has one set of worker threads. Concurrent calls of run()
+ * are done one after another, and calls of run() from inside a job of the
+ * same pool run all jobs on the calling worker.
+ *
+ * The workers can be kept off the core of the audio thread, pinned to cores
+ * and run with idle priority, see options_t. On other systems than Linux,
+ * these options are ignored.
+ */
+class WorkerPool
+{
+    public:
+        typedef std::function<void(size_t job, unsigned worker)> job_t;
+
+        struct options_t
+        {
+            //! Number of workers, 0 for one per usable core
+            unsigned threads = 0;
+            /**
+             * Core of the audio thread, e.g. from sched_getcpu(), or -1
+             *
+             * Workers are not placed on this core nor on its hyperthreads,
+             * and cores of its NUMA node, which share its memory, are used
+             * first. If no other core is usable, this is ignored.
+             */
+            int avoid_cpu = -1;
+            //! Pin each worker to one core, instead of letting it move
+            //! between the usable cores
+            bool pin = false;
+            //! Run the workers with idle priority (SCHED_IDLE), so they only
+            //! get cores which would idle otherwise
+            bool low_priority = false;
+        };
+
+        //! @param threads Number of workers, 0 for one per core
+        explicit WorkerPool(unsigned threads = 0);
+        explicit WorkerPool(const options_t &options);
+        ~WorkerPool(void);
+        WorkerPool(const WorkerPool&) = delete;
+
+        /**
+         * The pool shared by all subsystems of rtosc
+         *
+         * It is created on the first call, with the options of the last
+         * call of set_shared_options() before, or with one worker per core.
+         */
+        static WorkerPool &shared(void);
+        //! Options of shared(), which only apply before its first call
+        static void set_shared_options(const options_t &options);
+
+        unsigned size(void) const { return workers.size(); }
+        //! The core which @p worker has been pinned to, or -1
+        int cpu(unsigned worker) const { return cpus[worker]; }
+
+        //! Call job(i, worker) for all i in [0, njobs), where worker is the
+        //! index of the calling worker in [0, size())
+        void run(size_t njobs, const job_t &job);
+
+    private:
+        //! jobs [begin, end) of one worker, as begin << 32 | end
+        struct range_t
+        {
+            std::atomic<uint64_t> jobs;
+            char pad[64 - sizeof(std::atomic<uint64_t>)]; //!< own cache line
+        };
+
+        void work(unsigned worker);
+        //! take the next job of @p worker's range, or steal one
+        bool next(unsigned worker, uint32_t &job);
+        bool steal(unsigned thief);
+
+        std::vector<std::thread> workers;
+        std::vector<int>         cpus;
+        std::vector<range_t>     ranges;
+        std::mutex               run_mutex; //!< serializes run()
+        std::mutex               mutex;
+        std::condition_variable  wake, done;
+        const job_t             *current;
+        size_t                   offset;    //!< of the current jobs
+        unsigned                 busy;
+        unsigned long            generation;
+        bool                     quit;
+};
+
+}
+
+#endif
@@ -30,6 +30,121 @@ int rtosc_arg_vals_eq_after_abort(const rtosc_arg_val_itr* litr,
                   (ritr->av->type == '-' && !ritr->av->val.r.num));
 }
 
+/*
+ * Fast paths for runs of plain values
+ *
+ * Outside of ranges and arrays, the elements can be walked directly,
+ * without the iterators copying each value. A run consists of the elements
+ * which have the same type on both sides, like the floats of an rArrayF.
+ * Each run is compared by one loop for its type.
+ */
+
+static int is_plain_type(char type)
+{
+    return type != '-' && type != 'a';
+}
+
+//! number of elements from @p lhs and @p rhs with the type of *lhs
+static size_t plain_run(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                        size_t max)
+{
+    const char type = lhs->type;
+    size_t n = 0;
+    if(is_plain_type(type))
+        while(n < max && lhs[n].type == type && rhs[n].type == type)
+            ++n;
+    return n;
+}
+
+static int blobs_eq(const rtosc_blob_t* lhs, const rtosc_blob_t* rhs)
+{
+    return lhs->len == rhs->len &&
+           (lhs->data == rhs->data ||
+            0 == memcmp(lhs->data, rhs->data, lhs->len));
+}
+
+static int strings_eq(const char* lhs, const char* rhs)
+{
+    return (lhs == rhs) || (lhs && rhs && 0 == strcmp(lhs, rhs));
+}
+
+//! number of leading elements of a run of @p n elements which are equal,
+//! as for rtosc_arg_vals_eq_single()
+static size_t equal_prefix(const rtosc_arg_val_t* lhs,
+                           const rtosc_arg_val_t* rhs, size_t n,
+                           const rtosc_cmp_options* opt)
+{
+#define mfabs(val) (((val) >= 0) ? (val) : -(val))
+#define count_while(cond) for(; k < n && (cond); ++k) {}
+    size_t k = 0;
+    switch(lhs->type)
+    {
+        case 'i':
+        case 'c':
+        case 'r':
+            count_while(lhs[k].val.i == rhs[k].val.i);
+            break;
+        case 'f':
+            if(opt->float_tolerance == 0.0) {
+                count_while(lhs[k].val.f == rhs[k].val.f);
+            } else {
+                const float tolerance = (float)opt->float_tolerance;
+                count_while(mfabs(lhs[k].val.f - rhs[k].val.f) <= tolerance);
+            }
+            break;
+        case 'd':
+            if(opt->float_tolerance == 0.0) {
+                count_while(lhs[k].val.d == rhs[k].val.d);
+            } else {
+                count_while(mfabs(lhs[k].val.d - rhs[k].val.d) <=
+                            opt->float_tolerance);
+            }
+            break;
+        case 'h':
+            count_while(lhs[k].val.h == rhs[k].val.h);
+            break;
+        case 't':
+            count_while(lhs[k].val.t == rhs[k].val.t);
+            break;
+        case 'm':
+            count_while(0 == memcmp(lhs[k].val.m, rhs[k].val.m, 4));
+            break;
+        case 's':
+        case 'S':
+            count_while(strings_eq(lhs[k].val.s, rhs[k].val.s));
+            break;
+        case 'b':
+            count_while(blobs_eq(&lhs[k].val.b, &rhs[k].val.b));
+            break;
+        case 'I':
+        case 'T':
+        case 'F':
+        case 'N':
+            k = n;
+            break;
+    }
+    return k;
+#undef count_while
+#undef mfabs
+}
+
+static void itr_skip(rtosc_arg_val_itr* itr, size_t n)
+{
+    itr->av += n;
+    itr->i += n;
+}
+
+//! length of the run at the iterators, 0 if one of them is inside a range
+static size_t itr_plain_run(const rtosc_arg_val_itr* litr,
+                            const rtosc_arg_val_itr* ritr,
+                            size_t lsize, size_t rsize)
+{
+    size_t lleft = lsize - litr->i, rleft = rsize - ritr->i;
+    return (litr->range_i || ritr->range_i)
+           ? 0
+           : plain_run(litr->av, ritr->av, lleft < rleft ? lleft : rleft);
+}
+
 // compare single elements, ranges excluded
 int rtosc_arg_vals_eq_single(const rtosc_arg_val_t* _lhs,
                              const rtosc_arg_val_t* _rhs,
@@ -78,19 +193,11 @@ int rtosc_arg_vals_eq_single(const rtosc_arg_val_t* _lhs,
             break;
         case 's':
         case 'S':
-            rval = (_lhs->val.s == NULL || _rhs->val.s == NULL)
-                 ? _lhs->val.s == _rhs->val.s
-                 : (0 == strcmp(_lhs->val.s, _rhs->val.s));
+            rval = strings_eq(_lhs->val.s, _rhs->val.s);
             break;
         case 'b':
-        {
-            int32_t lbs = _lhs->val.b.len,
-                    rbs = _rhs->val.b.len;
-            rval = lbs == rbs;
-            if(rval)
-                rval = 0 == memcmp(_lhs->val.b.data, _rhs->val.b.data, lbs);
+            rval = blobs_eq(&_lhs->val.b, &_rhs->val.b);
             break;
-        }
         case 'a':
         {
             if(     _lhs->val.a.type != _rhs->val.a.type
@@ -139,6 +246,16 @@ int rtosc_arg_vals_eq(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
         rtosc_arg_val_itr_next(&litr),
         rtosc_arg_val_itr_next(&ritr))
     {
+        size_t run = itr_plain_run(&litr, &ritr, lsize, rsize);
+        if(run > 1)
+        {
+            if(equal_prefix(litr.av, ritr.av, run, opt) < run)
+                return 0;
+            // all equal, the loop steps over the last one
+            itr_skip(&litr, run - 1);
+            itr_skip(&ritr, run - 1);
+            continue;
+        }
         rval = rtosc_arg_vals_eq_single(rtosc_arg_val_itr_get(&litr, &rlhs),
                                         rtosc_arg_val_itr_get(&ritr, &rrhs),
                                         opt);
@@ -290,6 +407,20 @@ int rtosc_arg_vals_cmp(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
         rtosc_arg_val_itr_next(&litr),
         rtosc_arg_val_itr_next(&ritr))
     {
+        size_t run = itr_plain_run(&litr, &ritr, lsize, rsize);
+        if(run > 1)
+        {
+            size_t equal = equal_prefix(litr.av, ritr.av, run, opt);
+            if(equal == run)
+            {
+                itr_skip(&litr, run - 1);
+                itr_skip(&ritr, run - 1);
+                continue;
+            }
+            // compare the first different element below
+            itr_skip(&litr, equal);
+            itr_skip(&ritr, equal);
+        }
         rval = rtosc_arg_vals_cmp_single(rtosc_arg_val_itr_get(&litr, &rlhs),
                                          rtosc_arg_val_itr_get(&ritr, &rrhs),
                                          opt);
@@ -305,3 +436,145 @@ int rtosc_arg_vals_cmp(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
                         : -1;
 }
 
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len)
+{
+    // FNV-1a
+    const unsigned char* p = (const unsigned char*)data;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#define RTOSC_HASH_SEED 0xcbf29ce484222325ULL
+
+//! hash one value which is no array and no range
+static uint64_t hash_arg_val(uint64_t h, const rtosc_arg_val_t* cur)
+{
+    char type = cur->type;
+    h = hash_bytes(h, &type, 1);
+    switch(type)
+    {
+        case 'i':
+        case 'c':
+        case 'r':
+            h = hash_bytes(h, &cur->val.i, sizeof(cur->val.i));
+            break;
+        case 'f':
+        {
+            // 0.0 == -0.0
+            float f = cur->val.f == 0.0f ? 0.0f : cur->val.f;
+            h = hash_bytes(h, &f, sizeof(f));
+            break;
+        }
+        case 'd':
+        {
+            double d = cur->val.d == 0.0 ? 0.0 : cur->val.d;
+            h = hash_bytes(h, &d, sizeof(d));
+            break;
+        }
+        case 'h':
+            h = hash_bytes(h, &cur->val.h, sizeof(cur->val.h));
+            break;
+        case 't':
+            h = hash_bytes(h, &cur->val.t, sizeof(cur->val.t));
+            break;
+        case 'm':
+            h = hash_bytes(h, cur->val.m, 4);
+            break;
+        case 's':
+        case 'S':
+            // NULL differs from ""
+            h = cur->val.s ? hash_bytes(h, cur->val.s,
+                                        strlen(cur->val.s) + 1)
+                           : hash_bytes(h, "\xff", 1);
+            break;
+        case 'b':
+            h = hash_bytes(h, &cur->val.b.len, sizeof(cur->val.b.len));
+            h = hash_bytes(h, cur->val.b.data, cur->val.b.len);
+            break;
+    }
+    return h;
+}
+
+/*
+ * Arrays are hashed as 'a', their elements, and ']', both for argument
+ * values and for the brackets of messages, so an array hashes the same in
+ * both representations.
+ */
+static uint64_t hash_arg_vals(uint64_t h, const rtosc_arg_val_t* av,
+                              size_t size)
+{
+    rtosc_arg_val_t range_val;
+    rtosc_arg_val_itr itr;
+    rtosc_arg_val_itr_init(&itr, av);
+
+    while(itr.i < size)
+    {
+        const int infinite = itr.av->type == '-' && !itr.av->val.r.num;
+        const rtosc_arg_val_t* cur = rtosc_arg_val_itr_get(&itr, &range_val);
+        if(cur->type == 'a')
+        {
+            h = hash_bytes(h, "a", 1);
+            h = hash_arg_vals(h, cur + 1, cur->val.a.len);
+            h = hash_bytes(h, "]", 1);
+        }
+        else
+            h = hash_arg_val(h, cur);
+        if(infinite)
+        {
+            // hashed once, it would repeat forever
+            h = hash_bytes(h, "-", 1);
+            break;
+        }
+        rtosc_arg_val_itr_next(&itr);
+    }
+    return h;
+}
+
+//! hash the array brackets of a message's type string up to @p end
+static uint64_t hash_brackets(uint64_t h, const char* types, const char* end)
+{
+    for(; types != end && *types; ++types)
+        h = hash_bytes(h, *types == '[' ? "a" : "]", 1);
+    return h;
+}
+
+uint64_t rtosc_arg_vals_hash(const rtosc_arg_val_t* av, size_t size)
+{
+    return hash_arg_vals(RTOSC_HASH_SEED, av, size);
+}
+
+uint64_t rtosc_message_hash(const char* msg)
+{
+    uint64_t h = hash_bytes(RTOSC_HASH_SEED, msg, strlen(msg) + 1);
+    const char* types = rtosc_argument_string(msg);
+    rtosc_arg_itr_t itr = rtosc_itr_begin(msg);
+    while(!rtosc_itr_end(itr))
+    {
+        h = hash_brackets(h, types, itr.type_pos);
+        types = itr.type_pos + 1;
+        rtosc_arg_val_t av = rtosc_itr_next(&itr);
+        h = hash_arg_val(h, &av);
+    }
+    return hash_brackets(h, types, NULL);
+}
+
+uint64_t rtosc_avmessage_hash(const char* address,
+                              const rtosc_arg_val_t* args, size_t nargs)
+{
+    uint64_t h = hash_bytes(RTOSC_HASH_SEED, address, strlen(address) + 1);
+    return hash_arg_vals(h, args, nargs);
+}
+
+uint64_t rtosc_hash_combine(uint64_t h, uint64_t value)
+{
+    // hashing h first makes the result depend on the order
+    h = hash_bytes(RTOSC_HASH_SEED, &h, sizeof(h));
+    return hash_bytes(h, &value, sizeof(value));
+}
+
+#undef RTOSC_HASH_SEED
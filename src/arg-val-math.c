@@ -230,3 +230,332 @@ rtosc_arg_val_t* rtosc_arg_val_range_arg(const rtosc_arg_val_t *range_arg,
     rtosc_arg_val_add(range_arg+2, &mult, result);
     return result;
 }
+
+void rtosc_arg_val_range_args(const rtosc_arg_val_t *range_arg,
+                              int first, size_t n, rtosc_arg_val_t* result)
+{
+    const rtosc_arg_val_t *delta = range_arg + 1, *start = range_arg + 2;
+    const char type = start->type;
+    // the computations must match rtosc_arg_val_range_arg() exactly:
+    // ith is converted to the delta's type, multiplied, and then added
+    if(delta->type == type) switch(type)
+    {
+        case 'c':
+        case 'i':
+            for(size_t k = 0; k < n; ++k) {
+                result[k].type = type;
+                result[k].val.i = start->val.i + (first + (int)k) * delta->val.i;
+            }
+            return;
+        case 'h':
+            for(size_t k = 0; k < n; ++k) {
+                result[k].type = type;
+                result[k].val.h = start->val.h
+                                + (int64_t)(first + (int)k) * delta->val.h;
+            }
+            return;
+        case 'f':
+            for(size_t k = 0; k < n; ++k) {
+                float mult = (float)(first + (int)k) * delta->val.f;
+                result[k].type = type;
+                result[k].val.f = start->val.f + mult;
+            }
+            return;
+        case 'd':
+            for(size_t k = 0; k < n; ++k) {
+                double mult = (double)(first + (int)k) * delta->val.d;
+                result[k].type = type;
+                result[k].val.d = start->val.d + mult;
+            }
+            return;
+        default:
+            break;
+    }
+    for(size_t k = 0; k < n; ++k)
+        rtosc_arg_val_range_arg(range_arg, first + (int)k, result + k);
+}
+
+/*
+ * bulk functions for arrays of arg values
+ */
+
+typedef int (*binary_func_t)(const rtosc_arg_val_t*, const rtosc_arg_val_t*,
+                             rtosc_arg_val_t*);
+
+//! length of the run of values with the type of *lhs, in both arrays
+static size_t run_length(const rtosc_arg_val_t* lhs,
+                         const rtosc_arg_val_t* rhs, size_t n)
+{
+    const char type = lhs->type;
+    size_t len = 1;
+    if(rhs->type == type)
+        while(len < n && lhs[len].type == type && rhs[len].type == type)
+            ++len;
+    return len;
+}
+
+//! compute a run of @p n numbers of the same type, return false if the
+//! type has no fast path
+static int binary_run(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                      size_t n, rtosc_arg_val_t* res, char op)
+{
+#define binary_loop(field) \
+    switch(op) { \
+        case '+': for(size_t k = 0; k < n; ++k) \
+                      res[k].val.field = lhs[k].val.field + rhs[k].val.field; \
+                  break; \
+        case '-': for(size_t k = 0; k < n; ++k) \
+                      res[k].val.field = lhs[k].val.field - rhs[k].val.field; \
+                  break; \
+        case '*': for(size_t k = 0; k < n; ++k) \
+                      res[k].val.field = lhs[k].val.field * rhs[k].val.field; \
+                  break; \
+    }
+    const char type = lhs->type;
+    if(rhs->type != type)
+        return false;
+    switch(type)
+    {
+        case 'c':
+        case 'i': binary_loop(i); break;
+        case 'h': binary_loop(h); break;
+        case 'f': binary_loop(f); break;
+        case 'd': binary_loop(d); break;
+        default: return false;
+    }
+    for(size_t k = 0; k < n; ++k)
+        res[k].type = type;
+    return true;
+#undef binary_loop
+}
+
+static int binary_vals(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                       size_t n, rtosc_arg_val_t* res,
+                       char op, binary_func_t single)
+{
+    int ok = true;
+    while(n)
+    {
+        size_t len = run_length(lhs, rhs, n);
+        if(!binary_run(lhs, rhs, len, res, op))
+        {
+            // e.g. 'T' and 'F'
+            for(size_t k = 0; k < len; ++k)
+                ok = single(lhs + k, rhs + k, res + k) && ok;
+        }
+        lhs += len;
+        rhs += len;
+        res += len;
+        n -= len;
+    }
+    return ok;
+}
+
+int rtosc_arg_vals_add(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                       size_t n, rtosc_arg_val_t* res)
+{
+    return binary_vals(lhs, rhs, n, res, '+', rtosc_arg_val_add);
+}
+
+int rtosc_arg_vals_sub(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                       size_t n, rtosc_arg_val_t* res)
+{
+    return binary_vals(lhs, rhs, n, res, '-', rtosc_arg_val_sub);
+}
+
+int rtosc_arg_vals_mult(const rtosc_arg_val_t* lhs, const rtosc_arg_val_t* rhs,
+                        size_t n, rtosc_arg_val_t* res)
+{
+    return binary_vals(lhs, rhs, n, res, '*', rtosc_arg_val_mult);
+}
+
+int rtosc_arg_vals_round(rtosc_arg_val_t* av, size_t n)
+{
+    int ok = true;
+    while(n)
+    {
+        size_t len = run_length(av, av, n);
+        switch(av->type)
+        {
+            case 'd':
+                for(size_t k = 0; k < len; ++k) {
+                    int tmp = (int)(av[k].val.d);
+                    av[k].val.d = tmp + (int)(av[k].val.d - tmp >= 0.999);
+                }
+                break;
+            case 'f':
+                for(size_t k = 0; k < len; ++k) {
+                    int tmp = (int)(av[k].val.f);
+                    av[k].val.f = tmp + (int)(av[k].val.f - tmp >= 0.999f);
+                }
+                break;
+            default:
+                for(size_t k = 0; k < len; ++k)
+                    ok = rtosc_arg_val_round(av + k) && ok;
+        }
+        av += len;
+        n -= len;
+    }
+    return ok;
+}
+
+int rtosc_arg_vals_scale(rtosc_arg_val_t* av, size_t n,
+                         double mult, double add)
+{
+    const float fmult = (float)mult, fadd = (float)add;
+    int ok = true;
+    while(n)
+    {
+        size_t len = run_length(av, av, n);
+        switch(av->type)
+        {
+            case 'c':
+            case 'i':
+                for(size_t k = 0; k < len; ++k)
+                    av[k].val.i = av[k].val.i * mult + add;
+                break;
+            case 'h':
+                for(size_t k = 0; k < len; ++k)
+                    av[k].val.h = av[k].val.h * mult + add;
+                break;
+            case 'f':
+                for(size_t k = 0; k < len; ++k)
+                    av[k].val.f = av[k].val.f * fmult + fadd;
+                break;
+            case 'd':
+                for(size_t k = 0; k < len; ++k)
+                    av[k].val.d = av[k].val.d * mult + add;
+                break;
+            case 'T':
+            case 'F':
+                for(size_t k = 0; k < len; ++k)
+                    rtosc_arg_val_from_double(av + k, 'T',
+                                              av[k].val.T * mult + add);
+                break;
+            default:
+                ok = false;
+        }
+        av += len;
+        n -= len;
+    }
+    return ok;
+}
+
+static int is_bool(char type)
+{
+    return type == 'T' || type == 'F';
+}
+
+int rtosc_arg_vals_lerp(const rtosc_arg_val_t* from, const rtosc_arg_val_t* to,
+                        size_t n, double t, rtosc_arg_val_t* res)
+{
+    const float ft = (float)t;
+    int ok = true;
+    while(n)
+    {
+        size_t len = run_length(from, to, n);
+        const char type = from->type;
+        if(type != to->type && !(is_bool(type) && is_bool(to->type)))
+            ok = false;
+        else switch(type)
+        {
+            case 'c':
+            case 'i':
+                for(size_t k = 0; k < len; ++k) {
+                    res[k].type = type;
+                    res[k].val.i = from[k].val.i +
+                                   (to[k].val.i - (double)from[k].val.i) * t;
+                }
+                break;
+            case 'h':
+                for(size_t k = 0; k < len; ++k) {
+                    res[k].type = type;
+                    res[k].val.h = from[k].val.h +
+                                   (to[k].val.h - (double)from[k].val.h) * t;
+                }
+                break;
+            case 'f':
+                for(size_t k = 0; k < len; ++k) {
+                    res[k].type = type;
+                    res[k].val.f = from[k].val.f +
+                                   (to[k].val.f - from[k].val.f) * ft;
+                }
+                break;
+            case 'd':
+                for(size_t k = 0; k < len; ++k) {
+                    res[k].type = type;
+                    res[k].val.d = from[k].val.d +
+                                   (to[k].val.d - from[k].val.d) * t;
+                }
+                break;
+            default:
+            {
+                const rtosc_arg_val_t* src = (t < 0.5) ? from : to;
+                for(size_t k = 0; k < len; ++k)
+                    res[k] = src[k];
+            }
+        }
+        from += len;
+        to += len;
+        res += len;
+        n -= len;
+    }
+    return ok;
+}
+
+/*
+ * bulk functions for packed values
+ */
+
+void rtosc_floats_add(const float* lhs, const float* rhs, size_t n,
+                      float* res)
+{
+    for(size_t k = 0; k < n; ++k)
+        res[k] = lhs[k] + rhs[k];
+}
+
+void rtosc_floats_scale(float* v, size_t n, float mult, float add)
+{
+    for(size_t k = 0; k < n; ++k)
+        v[k] = v[k] * mult + add;
+}
+
+void rtosc_floats_clamp(float* v, size_t n, float min, float max)
+{
+    for(size_t k = 0; k < n; ++k)
+        v[k] = v[k] < min ? min : v[k] > max ? max : v[k];
+}
+
+void rtosc_floats_lerp(const float* from, const float* to, size_t n,
+                       float t, float* res)
+{
+    for(size_t k = 0; k < n; ++k)
+        res[k] = from[k] + (to[k] - from[k]) * t;
+}
+
+void rtosc_ints_add(const int32_t* lhs, const int32_t* rhs, size_t n,
+                    int32_t* res)
+{
+    // wrap around instead of overflowing
+    for(size_t k = 0; k < n; ++k)
+        res[k] = (int32_t)((uint32_t)lhs[k] + (uint32_t)rhs[k]);
+}
+
+void rtosc_ints_scale(int32_t* v, size_t n, float mult, float add)
+{
+    for(size_t k = 0; k < n; ++k)
+        v[k] = (int32_t)(v[k] * mult + add);
+}
+
+void rtosc_ints_clamp(int32_t* v, size_t n, int32_t min, int32_t max)
+{
+    for(size_t k = 0; k < n; ++k)
+        v[k] = v[k] < min ? min : v[k] > max ? max : v[k];
+}
+
+void rtosc_ints_lerp(const int32_t* from, const int32_t* to, size_t n,
+                     float t, int32_t* res)
+{
+    for(size_t k = 0; k < n; ++k)
+        res[k] = (int32_t)(from[k] + ((float)to[k] - (float)from[k]) * t);
+}
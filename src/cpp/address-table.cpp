@@ -0,0 +1,179 @@
+#include <rtosc/address-table.h>
+#include <rtosc/rtosc.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace rtosc {
+
+//FNV-1a
+static uint32_t hash_path(const char *path, uint32_t h = 2166136261u)
+{
+    for(; *path; ++path)
+        h = (h ^ (unsigned char)*path) * 16777619u;
+    return h;
+}
+
+//size of a padded OSC string of n characters
+static size_t padded(size_t n)
+{
+    return n + 4 - n%4;
+}
+
+AddressTable::AddressTable(void)
+    :sum(hash_path(""))
+{
+    rehash(64);
+}
+
+AddressTable::AddressTable(const Ports &root)
+    :AddressTable()
+{
+    char name[1024];
+    memset(name, 0, sizeof(name));
+    walk_ports(&root, name, sizeof(name), this,
+               [](const Port *p, const char *path, const char*,
+                  const Ports&, void *data, void*) {
+                   //patterns and unexpanded bundles can not be interned
+                   if(!p->ports && !strpbrk(path, "#*?[{"))
+                       ((AddressTable*)data)->add(path);
+               });
+}
+
+void AddressTable::rehash(size_t slots)
+{
+    table.assign(slots, -1);
+    for(unsigned i=0; i<paths.size(); ++i) {
+        size_t pos = hash_path(paths[i].c_str()) & (slots-1);
+        while(table[pos] != -1)
+            pos = (pos+1) & (slots-1);
+        table[pos] = i;
+    }
+}
+
+unsigned AddressTable::add(const char *path)
+{
+    const int existing = id(path);
+    if(existing >= 0)
+        return existing;
+
+    const unsigned new_id = paths.size();
+    paths.push_back(path);
+    sum = hash_path(path, sum * 16777619u);
+    if(2*paths.size() > table.size()) //keep half of the slots free
+        rehash(2*table.size());
+    else {
+        size_t pos = hash_path(path) & (table.size()-1);
+        while(table[pos] != -1)
+            pos = (pos+1) & (table.size()-1);
+        table[pos] = new_id;
+    }
+    return new_id;
+}
+
+int AddressTable::id(const char *path) const
+{
+    const size_t mask = table.size()-1;
+    for(size_t pos = hash_path(path) & mask; table[pos] != -1;
+        pos = (pos+1) & mask)
+        if(paths[table[pos]] == path)
+            return table[pos];
+    return -1;
+}
+
+const char *AddressTable::path(unsigned id) const
+{
+    return id < paths.size() ? paths[id].c_str() : NULL;
+}
+
+int AddressTable::compact_id(const char *msg)
+{
+    if(msg[0] != '/' || msg[1] != '#' || !isdigit(msg[2]))
+        return -1;
+    return atoi(msg+2);
+}
+
+size_t AddressTable::compress(const char *msg, char *buffer, size_t len) const
+{
+    const int n = id(msg);
+    if(n < 0)
+        return 0;
+
+    char address[16];
+    const size_t addr_len = snprintf(address, sizeof(address), "/#%d", n);
+    const size_t rest     = padded(strlen(msg));
+    const size_t msg_len  = rtosc_message_length(msg, -1);
+    const size_t total    = padded(addr_len) + msg_len - rest;
+    if(total > len)
+        return 0;
+
+    memmove(buffer + padded(addr_len), msg + rest, msg_len - rest);
+    memcpy(buffer, address, addr_len);
+    memset(buffer + addr_len, 0, padded(addr_len) - addr_len);
+    return total;
+}
+
+size_t AddressTable::expand(const char *msg, char *buffer, size_t len) const
+{
+    const int n = compact_id(msg);
+    if(n < 0 || (unsigned)n >= paths.size())
+        return 0;
+
+    const std::string &addr = paths[n];
+    const size_t rest    = padded(strlen(msg));
+    const size_t msg_len = rtosc_message_length(msg, -1);
+    const size_t total   = padded(addr.size()) + msg_len - rest;
+    if(total > len)
+        return 0;
+
+    memmove(buffer + padded(addr.size()), msg + rest, msg_len - rest);
+    memcpy(buffer, addr.c_str(), addr.size());
+    memset(buffer + addr.size(), 0, padded(addr.size()) - addr.size());
+    return total;
+}
+
+bool AddressTable::dispatch(const Ports &root, const char *msg, RtData &d,
+                            DispatchCache *cache) const
+{
+    char full[max_message];
+    if(compact_id(msg) >= 0) {
+        if(!expand(msg, full, sizeof(full)))
+            return false;
+        msg = full;
+    }
+    if(cache)
+        cache->dispatch(root, msg, d);
+    else
+        root.dispatch(msg+1, d, true);
+    return true;
+}
+
+#define TABLE (*(AddressTable*)d.obj)
+const Ports AddressTable::ports = {
+    {"checksum:", "", 0, [](msg_t, RtData &d) {
+        d.reply(d.location(), "i", (int)TABLE.checksum()); }},
+    {"size:", "", 0, [](msg_t, RtData &d) {
+        d.reply(d.location(), "i", (int)TABLE.size()); }},
+    {"lookup:s", "", 0, [](msg_t m, RtData &d) {
+        const char *path = rtosc_argument(m, 0).s;
+        d.reply(d.location(), "si", path, TABLE.id(path)); }},
+    {"path:i", "", 0, [](msg_t m, RtData &d) {
+        const int   n    = rtosc_argument(m, 0).i;
+        const char *path = n < 0 ? NULL : TABLE.path(n);
+        if(path)
+            d.reply(d.location(), "is", n, path); }},
+};
+#undef TABLE
+
+Port AddressTable::addressTablePort(void)
+{
+    return Port{"address-table/", "", &ports, [this](msg_t m, RtData &d) {
+            d.obj = this;
+            while(*m && *m != '/')
+                ++m;
+            ports.dispatch(*m ? m+1 : m, d);
+        }};
+}
+
+}
@@ -1,71 +1,127 @@
 #include "../util.h"
 #include <rtosc/automations.h>
+#include <rtosc/trace.h>
+#include <atomic>
 #include <cstring>
+#include <cstdint>
 #include <cmath>
+#include <vector>
 
 using namespace rtosc;
 
-AutomationMgr::AutomationMgr(int slots, int per_slot, int control_points)
-    :nslots(slots), per_slot(per_slot), active_slot(0), learn_queue_len(0), p(NULL), damaged(0)
+//Encode the message template once, so value updates only patch the argument
+static void encode_template(Automation &au)
 {
-    this->slots = new AutomationSlot[slots];
-    memset(this->slots, 0, sizeof(AutomationSlot)*slots);
-    for(int i=0; i<slots; ++i) {
-        auto &s = this->slots[i];
-        sprintf(s.name, "Slot %d", i + 1);
-        s.midi_cc  = -1;
-        s.midi_nrpn  = -1;
-        s.learning = -1;
+    char type[2] = {au.param_type, 0};
+    if(au.param_type == 'T')
+        au.param_msg_len = rtosc_message(au.param_msg, sizeof(au.param_msg),
+                                         au.param_path, type);
+    else if(au.param_type == 'f')
+        au.param_msg_len = rtosc_message(au.param_msg, sizeof(au.param_msg),
+                                         au.param_path, type, 0.0f);
+    else
+        au.param_msg_len = rtosc_message(au.param_msg, sizeof(au.param_msg),
+                                         au.param_path, type, 0);
+    //for 'T', the last type tag is patched, otherwise the last 4 bytes
+    au.param_arg_offset = au.param_type == 'T'
+        ? (int)(rtosc_argument_string(au.param_msg) - au.param_msg)
+        : au.param_msg_len - 4;
+}
 
-        s.automations = new Automation[per_slot];
-        memset(s.automations, 0, sizeof(Automation)*per_slot);
-        for(int j=0; j<per_slot; ++j) {
-            s.automations[j].map.control_points = new float[control_points];
-            s.automations[j].map.npoints = control_points;
-            s.automations[j].map.gain   = 100.0;
-            s.automations[j].map.offset = 0.0;
+static void patch_int32(char *dest, uint32_t v)
+{
+    dest[0] = v >> 24;
+    dest[1] = v >> 16;
+    dest[2] = v >> 8;
+    dest[3] = v;
+}
+
+//Map a slot value through the curve, before limiting it to the parameter
+static float map_value(const AutomationMapping &map, float value)
+{
+    const float *p = map.control_points;
+    const int points = map.upoints < map.npoints/2 ? map.upoints
+                                                   : map.npoints/2;
+    if(map.control_type != 1 || points < 2)
+        return value*(p[3]-p[1]) + p[1];
+
+    //piecewise linear through (x, y) pairs which are sorted by x
+    if(value <= p[0])
+        return p[1];
+    for(int i=1; i<points; ++i) {
+        const float *q = p + 2*i;
+        if(value <= q[0]) {
+            const float dx = q[0] - q[-2];
+            return dx > 0 ? q[-1] + (value-q[-2])*(q[1]-q[-1])/dx : q[1];
         }
     }
-
+    return p[2*points-1];
 }
-AutomationMgr::~AutomationMgr(void)
+
+//Patch the mapped value into the template of au
+//@param out the value as sent, i.e. limited and scaled
+//@return -1 if nothing can be sent, 1 if the message changed, otherwise 0
+static int patch_value(Automation &au, float v, float *out)
 {
+    char *arg = au.param_msg + au.param_arg_offset;
+    if(!au.param_msg_len)
+        return -1;
+    char old[4];
+    memcpy(old, arg, sizeof(old));
+
+    const char type = au.param_type;
+    if(type == 'i' || type == 'f') {
+        if(v > au.param_max)
+            v = au.param_max;
+        else if(v < au.param_min)
+            v = au.param_min;
+    }
+
+    if(type == 'i') {
+        v = roundf(v);
+        patch_int32(arg, (int32_t)v);
+    } else if(type == 'f') {
+        if(au.map.control_scale == 1)
+            v = expf(v);
+
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        patch_int32(arg, bits);
+    } else if(type == 'T' || type == 'F') {
+        v = v > 0.5 ? 1.0 : 0.0;
+        *arg = v == 1.0 ? 'T' : 'F';
+    } else
+        return -1;
+
+    *out = v;
+    return memcmp(old, arg, type == 'T' ? 1 : 4) ? 1 : 0;
 }
 
-void AutomationMgr::createBinding(int slot, const char *path, bool start_midi_learn)
+/**
+ * Resolve @p path and fill its parameter fields into @p au
+ *
+ * This looks the port up, so it is meant for the non-realtime side. The
+ * mapping's control points and gains are not touched.
+ */
+static bool build_automation(const Ports &p, const char *path, Automation &au)
 {
-    assert(p);
-    const Port *port = p->apropos(path);
+    const Port *port = p.apropos(path);
     if(!port) {
         fprintf(stderr, "[Zyn:Error] port '%s' does not exist\n", path);
-        return;
+        return false;
     }
     auto meta = port->meta();
     if(!(meta.find("min") && meta.find("max"))) {
         if(!strstr(port->name, ":T")) {
             fprintf(stderr, "No bounds for '%s' known\n", path);
-            return;
+            return false;
         }
     }
     if(meta.find("internal") || meta.find("no learn")) {
         fprintf(stderr, "[Warning] port '%s' is unlearnable\n", path);
-        return;
-    }
-    int ind = -1;
-    for(int i=0; i<per_slot; ++i) {
-        if(slots[slot].automations[i].used == false) {
-            ind = i;
-            break;
-        }
+        return false;
     }
 
-    if(ind == -1)
-        return;
-
-    slots[slot].used = true;
-
-    auto &au = slots[slot].automations[ind];
-
     au.used   = true;
     au.active = true;
     au.param_type = 'i';
@@ -81,6 +137,7 @@ void AutomationMgr::createBinding(int slot, const char *path, bool start_midi_le
         au.param_max = atof(meta["max"]);
     }
     fast_strcpy(au.param_path, path, sizeof(au.param_path));
+    encode_template(au);
 
     if(meta["scale"] && strstr(meta["scale"], "log")) {
         au.map.control_scale = 1;
@@ -88,17 +145,186 @@ void AutomationMgr::createBinding(int slot, const char *path, bool start_midi_le
         au.param_max = logf(au.param_max);
     } else
         au.map.control_scale = 0;
+    return true;
+}
+
+//Copy the fields filled by build_automation(), realtime safe
+static void install_automation(Automation &dest, const Automation &src)
+{
+    dest.used       = src.used;
+    dest.active     = src.active;
+    dest.param_type = src.param_type;
+    dest.param_min  = src.param_min;
+    dest.param_max  = src.param_max;
+    memcpy(dest.param_path, src.param_path, sizeof(dest.param_path));
+    memcpy(dest.param_msg, src.param_msg, sizeof(dest.param_msg));
+    dest.param_msg_len    = src.param_msg_len;
+    dest.param_arg_offset = src.param_arg_offset;
+    dest.map.control_scale = src.map.control_scale;
+}
+
+//A binding or learn request from the non-realtime side
+struct learn_request_t
+{
+    int  slot;
+    bool learn;
+    bool bind;       //!< whether au holds a built binding
+    Automation au;
+};
+
+//Buffers for evaluating all queued slots at once
+struct rtosc::AutomationMgrImpl
+{
+    std::vector<bool>  pending; //!< per slot
+    std::vector<float> target;  //!< per slot
+    std::vector<float> value;   //!< per slot, applied (smoothed) value
+    std::vector<int>   smoothing; //!< per slot, ramp time in frames
+    std::vector<int>   remaining; //!< per slot, frames left in the ramp
+    int sub_block;
+    std::vector<float> last;    //!< per binding, value as sent
+    std::vector<bool>  sent;    //!< per binding
+    std::vector<int>   batch;   //!< indices of the bindings being evaluated
+    std::vector<float> in, a, b, out;
+    std::vector<float> ramp;
+
+    //Single producer, single consumer ring of learn requests
+    enum { max_requests = 32 };
+    learn_request_t requests[max_requests];
+    std::atomic<unsigned> requests_head; //!< next to read, by the consumer
+    std::atomic<unsigned> requests_tail; //!< next to write, by the producer
+
+    AutomationMgrImpl(int slots, int bindings)
+        :pending(slots), target(slots), value(slots), smoothing(slots),
+         remaining(slots), sub_block(0), last(bindings), sent(bindings),
+         batch(bindings), in(bindings), a(bindings), b(bindings),
+         out(bindings), requests_head(0), requests_tail(0)
+    {}
+
+    bool push(const learn_request_t &req)
+    {
+        const unsigned tail = requests_tail.load(std::memory_order_relaxed);
+        if(tail - requests_head.load(std::memory_order_acquire) >=
+           max_requests)
+            return false;
+        requests[tail % max_requests] = req;
+        requests_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+AutomationMgr::AutomationMgr(int slots, int per_slot, int control_points)
+    :nslots(slots), per_slot(per_slot), active_slot(0), learn_queue_len(0),
+     impl(new AutomationMgrImpl(slots, slots*per_slot)), p(NULL), damaged(0)
+{
+    this->slots = new AutomationSlot[slots];
+    memset(this->slots, 0, sizeof(AutomationSlot)*slots);
+    for(int i=0; i<slots; ++i) {
+        auto &s = this->slots[i];
+        sprintf(s.name, "Slot %d", i + 1);
+        s.midi_cc  = -1;
+        s.midi_nrpn  = -1;
+        s.learning = -1;
+
+        s.automations = new Automation[per_slot];
+        memset(s.automations, 0, sizeof(Automation)*per_slot);
+        for(int j=0; j<per_slot; ++j) {
+            s.automations[j].map.control_points = new float[control_points];
+            s.automations[j].map.npoints = control_points;
+            s.automations[j].map.gain   = 100.0;
+            s.automations[j].map.offset = 0.0;
+        }
+    }
+
+}
+AutomationMgr::~AutomationMgr(void)
+{
+    delete impl;
+}
+
+void AutomationMgr::createBinding(int slot, const char *path, bool start_midi_learn)
+{
+    assert(p);
+    Automation au;
+    memset(&au, 0, sizeof(au));
+    if(build_automation(*p, path, au))
+        bind(slot, au, start_midi_learn);
+};
+
+void AutomationMgr::bind(int slot, const Automation &built, bool start_midi_learn)
+{
+    int ind = -1;
+    for(int i=0; i<per_slot; ++i) {
+        if(slots[slot].automations[i].used == false) {
+            ind = i;
+            break;
+        }
+    }
+
+    if(ind == -1)
+        return;
+
+    slots[slot].used = true;
+
+    auto &au = slots[slot].automations[ind];
+    install_automation(au, built);
 
     au.map.gain   = 100.0;
     au.map.offset = 0;
     updateMapping(slot, ind);
 
-    if(start_midi_learn && slots[slot].learning == -1 && slots[slot].midi_cc == -1)
-        slots[slot].learning = ++learn_queue_len;
+    if(start_midi_learn)
+        learn(slot);
 
     damaged = true;
+}
 
-};
+void AutomationMgr::learn(int slot)
+{
+    if(slots[slot].learning == -1 && slots[slot].midi_cc == -1)
+        slots[slot].learning = ++learn_queue_len;
+}
+
+bool AutomationMgr::queueBinding(int slot, const char *path,
+                                 bool start_midi_learn)
+{
+    assert(p);
+    if(slot >= nslots || slot < 0)
+        return false;
+    learn_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.slot  = slot;
+    req.learn = start_midi_learn;
+    req.bind  = true;
+    return build_automation(*p, path, req.au) && impl->push(req);
+}
+
+bool AutomationMgr::queueLearn(int slot)
+{
+    if(slot >= nslots || slot < 0)
+        return false;
+    learn_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.slot  = slot;
+    req.learn = true;
+    return impl->push(req);
+}
+
+int AutomationMgr::applyQueued(void)
+{
+    const unsigned tail = impl->requests_tail.load(std::memory_order_acquire);
+    unsigned head = impl->requests_head.load(std::memory_order_relaxed);
+    const int n = tail - head;
+    for(; head != tail; ++head) {
+        const learn_request_t &req =
+            impl->requests[head % AutomationMgrImpl::max_requests];
+        if(req.bind)
+            bind(req.slot, req.au, req.learn);
+        else if(req.learn)
+            learn(req.slot);
+        impl->requests_head.store(head + 1, std::memory_order_release);
+    }
+    return n;
+}
 
 void AutomationMgr::updateMapping(int slot_id, int sub)
 {
@@ -124,10 +350,14 @@ void AutomationMgr::setSlot(int slot_id, float value)
 {
     if(slot_id >= nslots || slot_id < 0)
         return;
+    if(trace::active())
+        trace::instant("automation", "slot", slot_id);
     for(int i=0; i<per_slot; ++i)
         setSlotSub(slot_id, i, value);
 
     slots[slot_id].current_state = value;
+    impl->value[slot_id] = value;
+    impl->remaining[slot_id] = 0;
 }
 
 void AutomationMgr::setSlotSub(int slot_id, int par, float value)
@@ -137,48 +367,123 @@ void AutomationMgr::setSlotSub(int slot_id, int par, float value)
     auto &au = slots[slot_id].automations[par];
     if(au.used == false)
         return;
-    const char *path = au.param_path;
-    float mn = au.param_min;
-    float mx = au.param_max;
 
-    float a  = au.map.control_points[1];
-    float b  = au.map.control_points[3];
+    float v;
+    if(patch_value(au, map_value(au.map, value), &v) < 0)
+        return;
+    impl->last[slot_id*per_slot + par] = v;
+    impl->sent[slot_id*per_slot + par] = true;
 
-    char type = au.param_type;
+    if(backend)
+        backend(au.param_msg);
+}
 
-    char msg[256] = {0};
-    if(type == 'i') {
-        float v = value*(b-a) + a;
-        if(v > mx)
-            v = mx;
-        else if(v < mn)
-            v = mn;
+void AutomationMgr::queueSlot(int slot_id, float value)
+{
+    if(slot_id >= nslots || slot_id < 0)
+        return;
+    impl->target[slot_id]  = value;
+    impl->remaining[slot_id] = impl->smoothing[slot_id];
+    if(!impl->remaining[slot_id]) {
+        impl->pending[slot_id] = true;
+        impl->value[slot_id] = value;
+    }
+    slots[slot_id].current_state = value;
+}
 
-        rtosc_message(msg, 256, path, "i", (int)roundf(v));
-    } else if(type == 'f') {
-        float v = value*(b-a) + a;
-        if(v > mx)
-            v = mx;
-        else if(v < mn)
-            v = mn;
+void AutomationMgr::setSlotSmoothing(int slot_id, int frames)
+{
+    if(slot_id >= nslots || slot_id < 0)
+        return;
+    impl->smoothing[slot_id] = frames > 0 ? frames : 0;
+}
 
-        if(au.map.control_scale == 1)
-            v = expf(v);
+void AutomationMgr::setSubBlock(int frames)
+{
+    impl->sub_block = frames > 0 ? frames : 0;
+}
 
-        rtosc_message(msg, 256, path, "f", v);
-    } else if(type == 'T' || type == 'F') {
-        float v = value*(b-a) + a;
-        if(v > 0.5)
-            v = 1.0;
-        else
-            v = 0.0;
+void AutomationMgr::process(int nframes)
+{
+    trace::scope_t scope("automation", "process");
+    applyQueued();
+    AutomationMgrImpl &im = *impl;
+    const int sub_block = im.sub_block ? im.sub_block : nframes;
+    int done = 0;
+    do {
+        const int len = nframes - done < sub_block ? nframes - done
+                                                   : sub_block;
+        //advance the ramps of smoothed slots by one sub block
+        for(int i=0; i<nslots; ++i) {
+            if(!im.remaining[i])
+                continue;
+            const int step = len < im.remaining[i] ? len : im.remaining[i];
+            im.value[i] += (im.target[i] - im.value[i])*step/im.remaining[i];
+            im.remaining[i] -= step;
+            im.pending[i] = true;
+        }
+        evaluate(len);
+        done += len;
+    } while(done < nframes);
+}
 
-        rtosc_message(msg, 256, path, v == 1.0 ? "T" : "F");
-    } else
-        return;
+void AutomationMgr::evaluate(int nframes)
+{
+    AutomationMgrImpl &im = *impl;
 
-    if(backend)
-        backend(msg);
+    //gather all bindings of the queued slots
+    int n = 0;
+    for(int i=0; i<nslots; ++i) {
+        if(!im.pending[i])
+            continue;
+        im.pending[i] = false;
+        for(int j=0; j<per_slot; ++j) {
+            Automation &au = slots[i].automations[j];
+            if(!au.used || !au.param_msg_len)
+                continue;
+            im.batch[n] = i*per_slot + j;
+            im.in[n]    = im.value[i];
+            im.a[n]     = au.map.control_points[1];
+            im.b[n]     = au.map.control_points[3];
+            ++n;
+        }
+    }
+
+    //linear mappings in one loop which the compiler can vectorize,
+    //piecewise linear ones are evaluated one by one afterwards
+    const float *in = im.in.data(), *a = im.a.data(), *b = im.b.data();
+    float *out = im.out.data();
+    for(int i=0; i<n; ++i)
+        out[i] = in[i]*(b[i]-a[i]) + a[i];
+    for(int i=0; i<n; ++i) {
+        const Automation &au = slots[im.batch[i]/per_slot]
+                                   .automations[im.batch[i]%per_slot];
+        if(au.map.control_type == 1)
+            out[i] = map_value(au.map, in[i]);
+    }
+
+    if((int)im.ramp.size() < nframes)
+        im.ramp.resize(nframes);
+    for(int i=0; i<n; ++i) {
+        const int idx = im.batch[i];
+        Automation &au = slots[idx/per_slot].automations[idx%per_slot];
+        float v;
+        const int changed = patch_value(au, out[i], &v);
+        if(ramp_backend && au.param_type == 'f' && im.sent[idx] &&
+           nframes > 0)
+        {
+            if(v != im.last[idx]) {
+                const float from = im.last[idx];
+                for(int k=0; k<nframes; ++k)
+                    im.ramp[k] = from + (v-from)*(k+1)/nframes;
+                ramp_backend(au.param_path, im.ramp.data(), nframes);
+            }
+        }
+        else if((changed > 0 || !im.sent[idx]) && backend)
+            backend(au.param_msg);
+        im.last[idx] = v;
+        im.sent[idx] = true;
+    }
 }
 
 float AutomationMgr::getSlot(int slot_id)
@@ -222,6 +527,8 @@ void AutomationMgr::clearSlotSub(int slot_id, int sub)
     a.relative = false;
     a.param_base_value = false;
     memset(a.param_path, 0, sizeof(a.param_path));
+    a.param_msg_len = 0;
+    impl->sent[slot_id*per_slot + sub] = false;
     a.param_type = 0;
     a.param_min  = 0;
     a.param_max  = 0;
@@ -237,54 +544,17 @@ void AutomationMgr::setSlotSubPath(int slot, int ind, const char *path)
     if(slot >= nslots || slot < 0)
         return;
 
-	assert(p);
-    const Port *port = p->apropos(path);
-    if(!port) {
-        fprintf(stderr, "[Zyn:Error] port '%s' does not exist\n", path);
-        return;
-    }
-    auto meta = port->meta();
-    if(!(meta.find("min") && meta.find("max"))) {
-        if(!strstr(port->name, ":T")) {
-            fprintf(stderr, "No bounds for '%s' known\n", path);
-            return;
-        }
-    }
-    if(meta.find("internal") || meta.find("no learn")) {
-        fprintf(stderr, "[Warning] port '%s' is unlearnable\n", path);
+    assert(p);
+    Automation built;
+    memset(&built, 0, sizeof(built));
+    if(!build_automation(*p, path, built))
         return;
-    }
 
     slots[slot].used = true;
-
-    auto &au = slots[slot].automations[ind];
-
-    au.used   = true;
-    au.active = true;
-    au.param_type = 'i';
-    if(strstr(port->name, ":f"))
-        au.param_type = 'f';
-    else if(strstr(port->name, ":T"))
-        au.param_type = 'T';
-    if(au.param_type == 'T') {
-        au.param_min = 0.0;
-        au.param_max = 1.0;
-    } else {
-        au.param_min = atof(meta["min"]);
-        au.param_max = atof(meta["max"]);
-    }
-    fast_strcpy(au.param_path, path, sizeof(au.param_path));
-
-    if(meta["scale"] && strstr(meta["scale"], "log")) {
-        au.map.control_scale = 1;
-        au.param_min = logf(au.param_min);
-        au.param_max = logf(au.param_max);
-    } else
-        au.map.control_scale = 0;
+    install_automation(slots[slot].automations[ind], built);
 
     updateMapping(slot, ind);
-	damaged = true;
-
+    damaged = true;
 }
 
 void  AutomationMgr::setSlotSubGain(int slot_id, int sub, float f)
@@ -331,34 +601,33 @@ const char *AutomationMgr::getName(int slot_id)
 }
 bool AutomationMgr::handleMidi(int channel, int type, int val)
 {
-    bool is_nrpn = false;
+    applyQueued();
+    if(trace::active())
+        trace::instant("midi", "automation midi", type);
+    //Process RPN and NRPN by the Master (ignore the chan)
+    const bool nrpn_part = (type == C_dataentryhi) || (type == C_dataentrylo)
+                        || (type == C_nrpnhi) || (type == C_nrpnlo);
+    MidiDecoder::Event ev;
+    if(!midi.feed(nrpn_part ? 0 : channel, type, val, &ev))
+        return 0;
+
+    bool is_nrpn = ev.type == MidiDecoder::nrpn;
     int par_id;
-    int value;
-    if((type == C_dataentryhi) || (type == C_dataentrylo)
-       || (type == C_nrpnhi) || (type == C_nrpnlo)) { //Process RPN and NRPN by the Master (ignore the chan)
-        
-        setparameternumber(type, val);
-
-        int parhi = -1, parlo = -1, valhi = -1, vallo = -1;
-        if(getnrpn(&parhi, &parlo, &valhi, &vallo) == 0){ //this is NRPN
-            is_nrpn = true;
-            par_id = (parhi<<7) + parlo;
-            value = (valhi<<7) + vallo;
-            bool bound_nrpn = false;
-            for(int i=0; i<nslots; ++i) {
-                if(slots[i].midi_nrpn == par_id) {
-                    bound_nrpn = true;
-                    setSlot(i, value/16383.0);
-                }
+    if(is_nrpn) {
+        par_id = ev.number;
+        bool bound_nrpn = false;
+        for(int i=0; i<nslots; ++i) {
+            if(slots[i].midi_nrpn == par_id) {
+                bound_nrpn = true;
+                setSlot(i, ev.value/16383.0);
             }
+        }
 
         if(bound_nrpn)
             return 1;
-        }
-        
     }
     else {
-        
+        //data entries without parameter number are plain CCs
         par_id = channel*128 + type;
 
         bool bound_cc = false;
@@ -371,7 +640,6 @@ bool AutomationMgr::handleMidi(int channel, int type, int val)
 
         if(bound_cc)
             return 1;
-        
     }
 
     //No bound CC, now to see if there's something to learn
@@ -397,8 +665,9 @@ bool AutomationMgr::handleMidi(int channel, int type, int val)
 //Returns 0 if there is NRPN or 1 if there is not
 int AutomationMgr::getnrpn(int *parhi, int *parlo, int *valhi, int *vallo)
 {
-    if((NRPN.parhi < 0) || (NRPN.parlo < 0) || (NRPN.valhi < 0)
-       || (NRPN.vallo < 0))
+    const MidiDecoder::ParameterState &NRPN = midi.parameter(0);
+    if(!NRPN.is_nrpn || (NRPN.parhi < 0) || (NRPN.parlo < 0)
+       || (NRPN.valhi < 0) || (NRPN.vallo < 0))
         return 1;
 
     *parhi = NRPN.parhi;
@@ -410,26 +679,8 @@ int AutomationMgr::getnrpn(int *parhi, int *parlo, int *valhi, int *vallo)
 
 void AutomationMgr::setparameternumber(unsigned int type, int value)
 {
-    switch(type) {
-        case C_nrpnhi:
-            NRPN.parhi = value;
-            NRPN.valhi = -1;
-            NRPN.vallo = -1; //clear the values
-            break;
-        case C_nrpnlo:
-            NRPN.parlo = value;
-            NRPN.valhi = -1;
-            NRPN.vallo = -1; //clear the values
-            break;
-        case C_dataentryhi:
-            if((NRPN.parhi >= 0) && (NRPN.parlo >= 0))
-                NRPN.valhi = value;
-            break;
-        case C_dataentrylo:
-            if((NRPN.parhi >= 0) && (NRPN.parlo >= 0))
-                NRPN.vallo = value;
-            break;
-    }
+    MidiDecoder::Event ev;
+    midi.feed(0, type, value, &ev);
 }
 
 void AutomationMgr::set_ports(const struct Ports &p_) {
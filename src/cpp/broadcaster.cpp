@@ -0,0 +1,316 @@
+#include <rtosc/broadcaster.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/rtosc.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace rtosc {
+
+struct shared_message_t
+{
+    std::atomic<unsigned> refs;
+    size_t len;
+    char   data[1];
+};
+
+MessageRef MessageRef::allocate(size_t len)
+{
+    MessageRef ref;
+    void *mem = ::operator new(offsetof(shared_message_t, data) + len);
+    ref.ptr = new (mem) shared_message_t;
+    ref.ptr->refs = 1;
+    ref.ptr->len  = len;
+    return ref;
+}
+
+MessageRef::MessageRef(const MessageRef &other)
+    :ptr(other.ptr)
+{
+    if(ptr)
+        ptr->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+MessageRef &MessageRef::operator=(MessageRef other)
+{
+    std::swap(ptr, other.ptr);
+    return *this;
+}
+
+MessageRef::~MessageRef(void)
+{
+    if(ptr && ptr->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ptr->~shared_message_t();
+        ::operator delete(ptr);
+    }
+}
+
+MessageRef MessageRef::copy(const char *msg, size_t len)
+{
+    MessageRef ref = allocate(len);
+    memcpy(ref.ptr->data, msg, len);
+    return ref;
+}
+
+MessageRef MessageRef::copy(const char *msg)
+{
+    return copy(msg, rtosc_message_length(msg, -1));
+}
+
+MessageRef MessageRef::format(const char *path, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    MessageRef ref = vformat(path, args, va);
+    va_end(va);
+    return ref;
+}
+
+MessageRef MessageRef::vformat(const char *path, const char *args,
+                               va_list va)
+{
+    va_list va2;
+    va_copy(va2, va);
+    const size_t len = rtosc_vmessage(nullptr, 0, path, args, va2);
+    va_end(va2);
+    MessageRef ref = allocate(len);
+    rtosc_vmessage(ref.ptr->data, len, path, args, va);
+    return ref;
+}
+
+MessageRef MessageRef::formatArray(const char *path, const char *args,
+                                   const rtosc_arg_t *vals)
+{
+    const size_t len = rtosc_amessage(nullptr, 0, path, args, vals);
+    MessageRef ref = allocate(len);
+    rtosc_amessage(ref.ptr->data, len, path, args, vals);
+    return ref;
+}
+
+const char *MessageRef::data(void) const
+{
+    return ptr ? ptr->data : nullptr;
+}
+
+size_t MessageRef::size(void) const
+{
+    return ptr ? ptr->len : 0;
+}
+
+unsigned MessageRef::use_count(void) const
+{
+    return ptr ? ptr->refs.load(std::memory_order_relaxed) : 0;
+}
+
+/*
+ * The messages of a tick are kept in broadcast order. To find identical
+ * messages, they are indexed by a hash of their bytes.
+ */
+struct sink_entry_t
+{
+    int                     id;
+    Broadcaster::sink_t     sink;
+    size_t                  nfilters;
+    std::vector<MessageRef> selected; //!< filtered messages of this tick
+};
+
+struct internal_broadcaster_t
+{
+    std::vector<sink_entry_t> sinks; //!< sorted by id
+    int next_id = 0;
+    Subscriptions subscriptions;
+
+    std::vector<MessageRef> tick;
+    std::unordered_multimap<size_t, size_t> index;
+    size_t merged = 0;
+};
+
+static size_t hash_bytes(const char *data, size_t len)
+{
+    //FNV-1a
+    size_t h = (size_t)14695981039346656037ull;
+    for(size_t i=0; i<len; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= (size_t)1099511628211ull;
+    }
+    return h;
+}
+
+Broadcaster::Broadcaster(void)
+    :impl(new internal_broadcaster_t)
+{}
+
+Broadcaster::~Broadcaster(void)
+{
+    delete impl;
+}
+
+static sink_entry_t *find_sink(internal_broadcaster_t *impl, int id)
+{
+    auto itr = std::lower_bound(impl->sinks.begin(), impl->sinks.end(), id,
+            [](const sink_entry_t &s, int id) { return s.id < id; });
+    return itr != impl->sinks.end() && itr->id == id ? &*itr : nullptr;
+}
+
+int Broadcaster::subscribe(sink_t sink)
+{
+    sink_entry_t entry;
+    entry.id       = impl->next_id;
+    entry.sink     = std::move(sink);
+    entry.nfilters = 0;
+    impl->sinks.push_back(std::move(entry));
+    return impl->next_id++;
+}
+
+void Broadcaster::unsubscribe(int id)
+{
+    sink_entry_t *s = find_sink(impl, id);
+    if(!s)
+        return;
+    impl->subscriptions.remove_all(id);
+    impl->sinks.erase(impl->sinks.begin() + (s - impl->sinks.data()));
+}
+
+bool Broadcaster::add_filter(int id, const char *filter)
+{
+    sink_entry_t *s = find_sink(impl, id);
+    if(!s || !impl->subscriptions.add(id, filter))
+        return false;
+    s->nfilters = impl->subscriptions.filters(id);
+    return true;
+}
+
+void Broadcaster::remove_filter(int id, const char *filter)
+{
+    sink_entry_t *s = find_sink(impl, id);
+    if(!s)
+        return;
+    impl->subscriptions.remove(id, filter);
+    s->nfilters = impl->subscriptions.filters(id);
+}
+
+bool Broadcaster::wants(int id, const char *address)
+{
+    sink_entry_t *s = find_sink(impl, id);
+    return s && (!s->nfilters || impl->subscriptions.wants(id, address));
+}
+
+size_t Broadcaster::subscribers(void) const
+{
+    return impl->sinks.size();
+}
+
+void Broadcaster::broadcast(const MessageRef &msg)
+{
+    if(!msg.size())
+        return;
+    const size_t h = hash_bytes(msg.data(), msg.size());
+    auto range = impl->index.equal_range(h);
+    for(auto itr = range.first; itr != range.second; ++itr) {
+        const MessageRef &other = impl->tick[itr->second];
+        if(other.size() == msg.size() &&
+           !memcmp(other.data(), msg.data(), msg.size())) {
+            ++impl->merged;
+            return;
+        }
+    }
+    impl->index.emplace(h, impl->tick.size());
+    impl->tick.push_back(msg);
+}
+
+void Broadcaster::broadcast(const char *msg)
+{
+    broadcast(MessageRef::copy(msg));
+}
+
+void Broadcaster::broadcast(const char *path, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    broadcast(MessageRef::vformat(path, args, va));
+    va_end(va);
+}
+
+size_t Broadcaster::flush(void)
+{
+    const size_t n = impl->tick.size();
+    if(!n)
+        return 0;
+
+    //sort the messages to the filtered subscribers
+    bool filtered = false;
+    for(const sink_entry_t &s : impl->sinks)
+        filtered |= s.nfilters != 0;
+    for(size_t i=0; filtered && i<n; ++i) {
+        const MessageRef &msg = impl->tick[i];
+        if(rtosc_bundle_p(msg.data())) {
+            for(sink_entry_t &s : impl->sinks)
+                if(s.nfilters)
+                    s.selected.push_back(msg);
+            continue;
+        }
+        for(int id : impl->subscriptions.interested(msg.data()))
+            if(sink_entry_t *s = find_sink(impl, id))
+                s->selected.push_back(msg);
+    }
+
+    for(sink_entry_t &s : impl->sinks) {
+        if(!s.nfilters)
+            s.sink(impl->tick.data(), n);
+        else if(!s.selected.empty()) {
+            s.sink(s.selected.data(), s.selected.size());
+            s.selected.clear();
+        }
+    }
+    impl->tick.clear();
+    impl->index.clear();
+    return n;
+}
+
+size_t Broadcaster::pending(void) const
+{
+    return impl->tick.size();
+}
+
+size_t Broadcaster::merged(void) const
+{
+    return impl->merged;
+}
+
+Broadcaster::sink_t Broadcaster::link_sink(ThreadLink &link)
+{
+    ThreadLink *l = &link;
+    return [l](const MessageRef *msgs, size_t n) {
+        for(size_t i=0; i<n; ++i) {
+            char *buf = l->reserve(msgs[i].size());
+            if(!buf)
+                continue;
+            memcpy(buf, msgs[i].data(), msgs[i].size());
+            l->commit(msgs[i].size());
+        }
+    };
+}
+
+void BroadcastData::broadcast(const char *path, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    broadcaster.broadcast(MessageRef::vformat(path, args, va));
+    va_end(va);
+}
+
+void BroadcastData::broadcast(const char *msg)
+{
+    broadcaster.broadcast(msg);
+}
+
+void BroadcastData::broadcastArray(const char *path, const char *args,
+                                   rtosc_arg_t *vals)
+{
+    broadcaster.broadcast(MessageRef::formatArray(path, args, vals));
+}
+
+}
@@ -0,0 +1,140 @@
+#include <rtosc/bundle-scheduler.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/rtosc.h>
+#include <cstring>
+
+namespace rtosc {
+
+//OSC's timetag for "immediately"
+static const uint64_t immediately = 1;
+
+BundleScheduler::BundleScheduler(size_t max_messages, size_t max_message_length)
+    :dropped(0), max_messages(max_messages),
+     max_message_length(max_message_length),
+     storage(new char[max_messages * max_message_length]),
+     heap(new entry_t[max_messages]), free_slots(new uint32_t[max_messages]),
+     block{0, 0, 0, 0, 0}
+{
+    clear();
+}
+
+BundleScheduler::~BundleScheduler(void)
+{
+    delete[] storage;
+    delete[] heap;
+    delete[] free_slots;
+}
+
+void BundleScheduler::clear(void)
+{
+    queued   = 0;
+    seq      = 0;
+    released = -1;
+    nfree    = max_messages;
+    for(size_t i=0; i<max_messages; ++i)
+        free_slots[i] = max_messages - 1 - i;
+}
+
+bool BundleScheduler::before(const entry_t &a, const entry_t &b)
+{
+    return a.tt < b.tt || (a.tt == b.tt && a.seq < b.seq);
+}
+
+bool BundleScheduler::push(const char *msg, size_t len, uint64_t tt)
+{
+    if(!nfree || !len || len > max_message_length) {
+        ++dropped;
+        return false;
+    }
+
+    const uint32_t slot = free_slots[--nfree];
+    memcpy(storage + slot * max_message_length, msg, len);
+
+    //sift up
+    entry_t e = {tt <= immediately ? 0 : tt, seq++, slot};
+    size_t  i = queued++;
+    while(i && before(e, heap[(i-1)/2])) {
+        heap[i] = heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    heap[i] = e;
+    return true;
+}
+
+bool BundleScheduler::schedule_bundle(const char *msg, size_t len, uint64_t tt)
+{
+    bool ok = true;
+    for(rtosc_bundle_itr_t itr = rtosc_bundle_itr_begin(msg, len);
+        !rtosc_bundle_itr_end(itr);) {
+        size_t elm_len;
+        const char *elm = rtosc_bundle_itr_next(&itr, &elm_len);
+        if(rtosc_bundle_p(elm)) {
+            //nested bundles must not be scheduled before their parents
+            uint64_t elm_tt = rtosc_bundle_timetag(elm);
+            ok &= schedule_bundle(elm, elm_len, elm_tt > tt ? elm_tt : tt);
+        }
+        else
+            ok &= push(elm, elm_len, tt);
+    }
+    return ok;
+}
+
+bool BundleScheduler::schedule(const char *msg, size_t len)
+{
+    if(rtosc_bundle_p(msg))
+        return schedule_bundle(msg, len, rtosc_bundle_timetag(msg));
+    return push(msg, rtosc_message_length(msg, len), immediately);
+}
+
+size_t BundleScheduler::schedule_from(ThreadLink &link)
+{
+    return link.read_all([this](const char *msg, size_t len) {
+            schedule(msg, len); });
+}
+
+void BundleScheduler::begin_block(uint64_t start, unsigned nframes,
+                                  double sample_rate)
+{
+    rtosc_block_time_init(&block, start, nframes, sample_rate);
+}
+
+const char *BundleScheduler::next(unsigned *offset)
+{
+    if(released >= 0) {
+        free_slots[nfree++] = released;
+        released = -1;
+    }
+    if(!queued || heap[0].tt >= block.end)
+        return NULL;
+
+    const entry_t top = heap[0];
+
+    //sift down
+    const entry_t last = heap[--queued];
+    size_t i = 0;
+    while(2*i+1 < queued) {
+        size_t child = 2*i+1;
+        if(child+1 < queued && before(heap[child+1], heap[child]))
+            ++child;
+        if(!before(heap[child], last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    if(offset) {
+        uint32_t frame;
+        rtosc_timetags2frames(&block, &top.tt, &frame, 1);
+        *offset = frame;
+    }
+    released = top.slot;
+    return storage + top.slot * max_message_length;
+}
+
+uint64_t BundleScheduler::next_timetag(void) const
+{
+    return queued ? heap[0].tt : 0;
+}
+
+}
@@ -0,0 +1,112 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <rtosc/ports.h>
+#include <rtosc/change-tracker.h>
+
+namespace rtosc {
+
+namespace {
+    std::size_t count_units(const Ports &root)
+    {
+        std::size_t n = 1; // the leaf unit
+        for(const Port &p : root)
+        {
+            if(p.ports)
+            {
+                const char *hash = strchr(p.name, '#');
+                n += hash ? atoi(hash + 1) : 1;
+            }
+        }
+        return n;
+    }
+}
+
+ChangeTracker::ChangeTracker(const Ports &root, bool at_defaults)
+    :flags(count_units(root))
+{
+    std::size_t next_unit = 1;
+    for(const Port &p : root)
+    {
+        if(p.ports)
+        {
+            const char *hash = strchr(p.name, '#');
+            int size = hash ? atoi(hash + 1) : -1;
+            subtrees.push_back(subtree_t{&p, strcspn(p.name, "#/"), size,
+                                         next_unit});
+            next_unit += hash ? size : 1;
+        }
+    }
+    // if nothing has been saved yet, everything counts as changed, unless
+    // everything is known to be at its defaults
+    set(units(), at_defaults ? ChangeTracker::at_defaults : changed);
+}
+
+std::size_t ChangeTracker::find(const char *path) const
+{
+    if(!path)
+        return units();
+    if(*path == '/')
+        ++path;
+    const char *slash = strchr(path, '/');
+    if(!slash)
+        return leaf_unit;
+
+    const std::size_t len = slash - path;
+    for(const subtree_t &s : subtrees)
+    {
+        if(len < s.prefix_len || strncmp(path, s.port->name, s.prefix_len))
+            continue;
+        if(s.size < 0)
+        {
+            if(len == s.prefix_len)
+                return s.first_unit;
+        }
+        else if(len > s.prefix_len && isdigit(path[s.prefix_len]))
+        {
+            int idx = atoi(path + s.prefix_len);
+            if(idx < s.size)
+                return s.first_unit + idx;
+        }
+    }
+    return units();
+}
+
+void ChangeTracker::set(std::size_t unit, state_t state)
+{
+    if(unit < flags.size())
+        flags[unit].store(state, std::memory_order_release);
+    else for(std::atomic<unsigned char> &flag : flags)
+        flag.store(state, std::memory_order_release);
+}
+
+void ChangeTracker::mark(const char *path)
+{
+    set(find(path), changed);
+}
+
+void ChangeTracker::mark_all(void)
+{
+    set(units(), changed);
+}
+
+void ChangeTracker::mark_defaults(const char *path)
+{
+    set(find(path), at_defaults);
+}
+
+std::size_t ChangeTracker::unit(const Port *p, int index) const
+{
+    for(const subtree_t &s : subtrees)
+        if(s.port == p)
+            return s.first_unit + (index < 0 ? 0 : index);
+    return leaf_unit;
+}
+
+ChangeTracker::state_t ChangeTracker::fetch_state(std::size_t unit)
+{
+    return (state_t)flags[unit].exchange(unchanged, std::memory_order_acq_rel);
+}
+
+}
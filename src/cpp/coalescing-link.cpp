@@ -0,0 +1,244 @@
+#include <rtosc/coalescing-link.h>
+#include <rtosc/rtosc.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+
+namespace rtosc {
+
+/*
+ * Each address has a slot holding its latest message, protected by a
+ * sequence lock: the writer makes seq odd while it copies the message. The
+ * reader copies the message and does not wait for a writer which got
+ * preempted meanwhile: if seq was odd or changed, it leaves the slot for the
+ * next read_all().
+ *
+ * A slot is pending from its first write until the reader takes it. Only
+ * the write which makes a slot pending puts its index into the queue, so the
+ * queue never holds more than one entry per slot. The reader clears pending
+ * before copying the message, so a write racing with the copy makes the slot
+ * pending again, and its value is read next time. If the copy was torn and
+ * no write made the slot pending again yet, the reader makes it pending
+ * itself and keeps its index in the deferred list, which it reads first.
+ *
+ * Only the writer looks up addresses, in an open addressing table of the
+ * slot indices, which compares the addresses with the slots' messages. The
+ * reader finds the slots by their index in the queue.
+ */
+struct slot_t
+{
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> len;
+    std::atomic<bool>     pending;
+};
+
+struct internal_coalescing_t
+{
+    size_t  max_message_length;
+    size_t  max_addresses;
+    slot_t *slots;
+    char   *messages;
+    char   *read_buffer;
+
+    //queue of pending slots, single producer and single consumer
+    uint32_t             *queue;
+    size_t                queue_size;
+    std::atomic<size_t>   queue_write;
+    std::atomic<size_t>   queue_read;
+
+    std::atomic<size_t>   coalesced;
+
+    //only used by the reader
+    uint32_t *deferred;
+    size_t    ndeferred;
+
+    //only used by the writer
+    uint32_t *ids;       //!< slot index + 1, or 0 for unused entries
+    uint32_t *id_hashes; //!< hash of the address of each entry in ids
+    size_t    ids_mask;
+    size_t    nids;
+};
+
+//FNV-1a hash of the address of @p msg
+static uint32_t address_hash(const char *msg)
+{
+    uint32_t h = 2166136261u;
+    for(; *msg; ++msg)
+        h = (h ^ (unsigned char)*msg) * 16777619u;
+    return h;
+}
+
+CoalescingLink::CoalescingLink(size_t max_message_length, size_t max_messages,
+                               size_t max_addresses)
+    :fifo(max_message_length, max_messages),
+     write_buffer(new char[max_message_length]),
+     impl(new internal_coalescing_t)
+{
+    impl->max_message_length = max_message_length;
+    impl->max_addresses      = max_addresses;
+    impl->slots              = new slot_t[max_addresses];
+    impl->messages           = new char[max_addresses * max_message_length];
+    impl->read_buffer        = new char[max_message_length];
+    impl->queue_size         = max_addresses + 1;
+    impl->queue              = new uint32_t[impl->queue_size];
+    impl->queue_write        = 0;
+    impl->queue_read         = 0;
+    impl->coalesced          = 0;
+    impl->deferred           = new uint32_t[max_addresses];
+    impl->ndeferred          = 0;
+    for(size_t i=0; i<max_addresses; ++i) {
+        impl->slots[i].seq     = 0;
+        impl->slots[i].len     = 0;
+        impl->slots[i].pending = false;
+    }
+    //at most half of the entries are used, so probe sequences stay short
+    size_t entries = 1;
+    while(entries < 2*max_addresses)
+        entries <<= 1;
+    impl->ids       = new uint32_t[entries]();
+    impl->id_hashes = new uint32_t[entries];
+    impl->ids_mask  = entries - 1;
+    impl->nids      = 0;
+}
+
+CoalescingLink::~CoalescingLink(void)
+{
+    delete[] impl->slots;
+    delete[] impl->messages;
+    delete[] impl->read_buffer;
+    delete[] impl->queue;
+    delete[] impl->deferred;
+    delete[] impl->ids;
+    delete[] impl->id_hashes;
+    delete   impl;
+    delete[] write_buffer;
+}
+
+void CoalescingLink::write(const char *dest, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    const size_t len = rtosc_vmessage(write_buffer, impl->max_message_length,
+                                      dest, args, va);
+    va_end(va);
+    if(len)
+        fifo.raw_write(write_buffer);
+}
+
+void CoalescingLink::raw_write(const char *msg)
+{
+    fifo.raw_write(msg);
+}
+
+void CoalescingLink::write_latest(const char *dest, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    const size_t len = rtosc_vmessage(write_buffer, impl->max_message_length,
+                                      dest, args, va);
+    va_end(va);
+    if(len)
+        raw_write_latest(write_buffer);
+}
+
+void CoalescingLink::raw_write_latest(const char *msg)
+{
+    const size_t len = rtosc_message_length(msg, -1);
+    if(!len || len > impl->max_message_length)
+        return;
+
+    const uint32_t hash = address_hash(msg);
+    size_t e = hash & impl->ids_mask;
+    for(; impl->ids[e]; e = (e+1) & impl->ids_mask)
+        if(impl->id_hashes[e] == hash &&
+           !strcmp(impl->messages +
+                   (impl->ids[e]-1)*impl->max_message_length, msg))
+            break;
+    if(!impl->ids[e]) {
+        if(impl->nids == impl->max_addresses) {
+            fifo.raw_write(msg); //out of slots
+            return;
+        }
+        impl->ids[e]       = ++impl->nids;
+        impl->id_hashes[e] = hash;
+    }
+    const uint32_t id = impl->ids[e] - 1;
+    slot_t &slot = impl->slots[id];
+
+    const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(impl->messages + id*impl->max_message_length, msg, len);
+    slot.len.store(len, std::memory_order_relaxed);
+    slot.seq.store(seq+2, std::memory_order_release);
+
+    if(slot.pending.exchange(true)) {
+        impl->coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const size_t w = impl->queue_write.load(std::memory_order_relaxed);
+    impl->queue[w] = id;
+    impl->queue_write.store((w+1) % impl->queue_size,
+                            std::memory_order_release);
+}
+
+bool CoalescingLink::hasNext(void) const
+{
+    return fifo.hasNext() || impl->ndeferred ||
+        impl->queue_read.load(std::memory_order_relaxed) !=
+        impl->queue_write.load(std::memory_order_acquire);
+}
+
+//Pass the latest message of slot @p id to @p cb, unless a write tears it
+static bool read_slot(internal_coalescing_t *impl, uint32_t id,
+                      ThreadLink::read_cb_t cb, void *data)
+{
+    slot_t &slot = impl->slots[id];
+    //an exchange reads the latest write's exchange, so that write's message
+    //is visible below
+    slot.pending.exchange(false);
+
+    const char    *src = impl->messages + id*impl->max_message_length;
+    const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+    const uint32_t len = slot.len.load(std::memory_order_relaxed);
+    memcpy(impl->read_buffer, src, len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(!(seq & 1) && seq == slot.seq.load(std::memory_order_relaxed)) {
+        cb(impl->read_buffer, len, data);
+        return true;
+    }
+    //the writer is copying a newer message, so take it next time, and
+    //queue the slot again unless the writer did already
+    if(!slot.pending.exchange(true))
+        impl->deferred[impl->ndeferred++] = id;
+    return false;
+}
+
+size_t CoalescingLink::read_all(ThreadLink::read_cb_t cb, void *data)
+{
+    size_t n = fifo.read_all(cb, data);
+
+    const size_t ndeferred = impl->ndeferred;
+    impl->ndeferred = 0;
+    for(size_t i = 0; i < ndeferred; ++i)
+        n += read_slot(impl, impl->deferred[i], cb, data);
+
+    const size_t end = impl->queue_write.load(std::memory_order_acquire);
+    for(size_t r = impl->queue_read.load(std::memory_order_relaxed);
+        r != end;) {
+        const uint32_t id = impl->queue[r];
+        //give the queue entry back before the slot can get pending again,
+        //so the queue never holds more entries than there are slots
+        r = (r+1) % impl->queue_size;
+        impl->queue_read.store(r, std::memory_order_release);
+        n += read_slot(impl, id, cb, data);
+    }
+    return n;
+}
+
+size_t CoalescingLink::coalesced(void) const
+{
+    return impl->coalesced.load(std::memory_order_relaxed);
+}
+
+}
@@ -1,5 +1,11 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <rtosc/pretty-format.h>
 #include <rtosc/ports.h>
 #include <rtosc/ports-runtime.h>
@@ -7,6 +13,205 @@
 
 namespace rtosc {
 
+namespace {
+
+/*
+    Cache of scanned and canonicalized default values
+
+    The metadata is static text, so the annotation chosen for a port and its
+    preset (i.e. the pointer returned by the string version of
+    get_default_value()) identifies the default value. Only scanning and
+    canonicalizing is cached, the preset is still looked up on each call.
+*/
+struct default_key_t
+{
+    const Port* port;
+    const char* pretty;
+    bool operator==(const default_key_t& other) const {
+        return port == other.port && pretty == other.pretty;
+    }
+};
+
+struct default_key_hash
+{
+    std::size_t operator()(const default_key_t& k) const {
+        std::hash<const void*> h;
+        return h(k.port) ^ (h(k.pretty) * 31);
+    }
+};
+
+struct default_entry_t
+{
+    //! the port args which the values have been canonicalized for
+    std::string port_args;
+    std::vector<rtosc_arg_val_t> args;
+    //! strings and blobs of all args, which point into this buffer
+    std::vector<char> strings;
+};
+
+struct default_cache_t
+{
+    std::mutex mutex;
+    unsigned long generation = Ports::magicGeneration();
+    std::unordered_map<default_key_t, default_entry_t, default_key_hash>
+        entries;
+};
+
+default_cache_t& default_cache()
+{
+    static default_cache_t cache;
+    return cache;
+}
+
+//! Move all string and blob pointers of @p args from @p from to @p to
+void rebase_strings(rtosc_arg_val_t* args, std::size_t nargs,
+                    const char* from, char* to)
+{
+    for(std::size_t i = 0; i < nargs; ++i)
+    {
+        switch(args[i].type)
+        {
+            case 's':
+            case 'S':
+                if(args[i].val.s)
+                    args[i].val.s = to + (args[i].val.s - from);
+                break;
+            case 'b':
+                if(args[i].val.b.data)
+                    args[i].val.b.data = (uint8_t*)to +
+                        (args[i].val.b.data - (const uint8_t*)from);
+                break;
+        }
+    }
+}
+
+//! Number of bytes at the start of @p strbuf which are used by @p args
+std::size_t strings_used(const rtosc_arg_val_t* args, std::size_t nargs,
+                         const char* strbuf)
+{
+    std::size_t used = 0;
+    for(std::size_t i = 0; i < nargs; ++i)
+    {
+        const char* end = nullptr;
+        switch(args[i].type)
+        {
+            case 's':
+            case 'S':
+                if(args[i].val.s)
+                    end = args[i].val.s + strlen(args[i].val.s) + 1;
+                break;
+            case 'b':
+                if(args[i].val.b.data)
+                    end = (const char*)args[i].val.b.data + args[i].val.b.len;
+                break;
+        }
+        if(end && end > strbuf && (std::size_t)(end - strbuf) > used)
+            used = end - strbuf;
+    }
+    return used;
+}
+
+//! Copy a cached entry to the caller's buffers, if found
+bool find_default(const default_key_t& key, const char* port_args,
+                  std::size_t n,
+                  rtosc_arg_val_t* res, char* strbuf, size_t strbufsize,
+                  int* nargs)
+{
+    default_cache_t& cache = default_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    const unsigned long generation = Ports::magicGeneration();
+    if(cache.generation != generation)
+    {
+        cache.generation = generation;
+        cache.entries.clear();
+        return false;
+    }
+
+    auto itr = cache.entries.find(key);
+    if(itr == cache.entries.end() || itr->second.port_args != port_args)
+        return false;
+
+    const default_entry_t& entry = itr->second;
+    assert(entry.args.size() < n);
+    assert(entry.strings.size() <= strbufsize);
+    (void)n; (void)strbufsize;
+    std::copy(entry.args.begin(), entry.args.end(), res);
+    if(!entry.strings.empty())
+        memcpy(strbuf, entry.strings.data(), entry.strings.size());
+    rebase_strings(res, entry.args.size(), entry.strings.data(), strbuf);
+    *nargs = (int)entry.args.size();
+    return true;
+}
+
+void store_default(const default_key_t& key, const char* port_args,
+                   const rtosc_arg_val_t* res, int nargs, const char* strbuf)
+{
+    default_entry_t entry;
+    entry.port_args = port_args;
+    entry.args.assign(res, res + nargs);
+    const std::size_t used = strings_used(res, nargs, strbuf);
+    entry.strings.assign(strbuf, strbuf + used);
+    rebase_strings(entry.args.data(), nargs, strbuf, entry.strings.data());
+
+    default_cache_t& cache = default_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if(cache.generation != Ports::magicGeneration())
+        return; // the ports changed while scanning
+    cache.entries[key] = std::move(entry);
+}
+
+//! Whether @p port_args equal the ones of @p port, which
+//! Ports::encodedDefault() has been canonicalized for
+bool same_port_args(const Port* port, const char* port_args)
+{
+    const char* own = strchr(port->name, ':');
+    if(!own)
+        own = "";
+    // like canonicalize_arg_vals(), ignore the leading "[]:"
+    for( ; *own && strchr("[]:", *own); ++own) ;
+    for( ; *port_args && strchr("[]:", *port_args); ++port_args) ;
+    return !strcmp(own, port_args);
+}
+
+//! Copy pre-encoded values to the caller's buffers
+int copy_encoded(const rtosc_arg_val_t* encoded, int nargs, std::size_t n,
+                 rtosc_arg_val_t* res, char* strbuf, size_t strbufsize)
+{
+    assert((size_t)nargs < n);
+    (void)n;
+    std::copy(encoded, encoded + nargs, res);
+    std::size_t used = 0;
+    for(int i = 0; i < nargs; ++i)
+    {
+        if((res[i].type == 's' || res[i].type == 'S') && res[i].val.s)
+        {
+            const std::size_t len = strlen(res[i].val.s) + 1;
+            assert(used + len <= strbufsize);
+            memcpy(strbuf + used, res[i].val.s, len);
+            res[i].val.s = strbuf + used;
+            used += len;
+        }
+        else if(res[i].type == 'b' && res[i].val.b.data)
+        {
+            assert(used + res[i].val.b.len <= strbufsize);
+            memcpy(strbuf + used, res[i].val.b.data, res[i].val.b.len);
+            res[i].val.b.data = (uint8_t*)strbuf + used;
+            used += res[i].val.b.len;
+        }
+    }
+    (void)strbufsize;
+    return nargs;
+}
+
+}
+
+void clear_default_value_cache()
+{
+    default_cache_t& cache = default_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+}
+
 const char* get_default_value(const char* port_name, const Ports& ports,
                               void* runtime, const Port* port_hint,
                               int32_t idx, int recursive)
@@ -26,7 +231,7 @@ const char* get_default_value(const char* port_name, const Ports& ports,
     if(!port_hint)
         port_hint = ports.apropos(port_name);
     assert(port_hint); // port must be found
-    const Port::MetaContainer metadata = port_hint->meta();
+    const Port::MetaContainer metadata = ports.meta(*port_hint);
 
     // Let complex cases depend upon a marker variable
     // If the runtime is available the exact preset number can be found
@@ -52,14 +257,38 @@ const char* get_default_value(const char* port_name, const Ports& ports,
         if(*dependent_port == '/')
             ++dependent_port;
 
-        const char* dependent_value =
-            runtime
-            ? helpers::get_value_from_runtime(runtime, ports,
-                                              buffersize, loc,
-                                              dependent_port,
-                                              buffersize-1, 0)
-            : get_default_value(dependent_port, ports,
-                                runtime, NULL, recursive-1);
+        char runtime_value[16];
+        const char* dependent_value = runtime_value;
+        if(runtime)
+        {
+            // capture the value typed, printing is only required for
+            // non-integer values
+            rtosc_arg_val_arena arena;
+            rtosc_arg_val_arena_init(&arena);
+            int nargs = helpers::get_value_from_runtime(runtime, ports,
+                                                        buffersize, loc,
+                                                        dependent_port,
+                                                        buffersize-1, &arena);
+            assert(nargs == 1);
+            (void)nargs;
+            if(arena.args[0].type == 'i')
+                snprintf(runtime_value, sizeof(runtime_value), "%d",
+                         (int)arena.args[0].val.i);
+            else
+            {
+                // the printer requires a whitespace in front of the value
+                char print_buf[sizeof(runtime_value) + 1] = " ";
+                rtosc_print_arg_vals(arena.args, 1, print_buf + 1,
+                                     sizeof(runtime_value), NULL, 0);
+                *runtime_value = 0;
+                strncat(runtime_value, print_buf + 1,
+                        sizeof(runtime_value) - 1);
+            }
+            rtosc_arg_val_arena_destroy(&arena);
+        }
+        else
+            dependent_value = get_default_value(dependent_port, ports,
+                                                runtime, NULL, recursive-1);
 
         assert(strlen(dependent_value) < 16); // must be an int
 
@@ -98,10 +327,23 @@ int get_default_value(const char* port_name, const char* port_args,
                       int32_t idx, std::size_t n, rtosc_arg_val_t* res,
                       char* strbuf, size_t strbufsize)
 {
+    if(!port_hint)
+        port_hint = ports.apropos(port_name);
+
+    const rtosc_arg_val_t* encoded;
+    const int nencoded = port_hint ? ports.encodedDefault(*port_hint, &encoded)
+                                   : -1;
+    if(nencoded >= 0 && same_port_args(port_hint, port_args))
+        return copy_encoded(encoded, nencoded, n, res, strbuf, strbufsize);
+
     const char* pretty = get_default_value(port_name, ports, runtime, port_hint,
                                            idx, 0);
 
     int nargs;
+    const default_key_t key = { port_hint, pretty };
+    if(pretty && find_default(key, port_args, n, res, strbuf, strbufsize, &nargs))
+        return nargs;
+
     if(pretty)
     {
         nargs = rtosc_count_printed_arg_vals(pretty);
@@ -111,7 +353,6 @@ int get_default_value(const char* port_name, const char* port_args,
         rtosc_scan_arg_vals(pretty, res, nargs, strbuf, strbufsize);
 
         {
-            // TODO: port_hint could be NULL here!
             int errs_found = canonicalize_arg_vals(res,
                                                    nargs,
                                                    port_args,
@@ -121,6 +362,7 @@ int get_default_value(const char* port_name, const char* port_args,
                         pretty, port_name);
             assert(!errs_found); // error in the metadata?
         }
+        store_default(key, port_args, res, nargs, strbuf);
     }
     else
         nargs = -1;
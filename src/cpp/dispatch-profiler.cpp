@@ -0,0 +1,171 @@
+#include "../util.h"
+#include <chrono>
+#include <cstring>
+
+#include <rtosc/rtosc.h>
+#include <rtosc/dispatch-profiler.h>
+
+namespace rtosc {
+
+DispatchProfiler::DispatchProfiler(unsigned ports, unsigned sample_interval)
+    :enabled(true), sample_interval(sample_interval), overflow(0), nused(0),
+     countdown(sample_interval)
+{
+    unsigned size = 1;
+    while(size < ports)
+        size <<= 1;
+    table = new stats_t[size];
+    used  = new unsigned[size];
+    mask  = size - 1;
+    reset();
+}
+
+DispatchProfiler::~DispatchProfiler(void)
+{
+    delete[] table;
+    delete[] used;
+}
+
+void DispatchProfiler::reset(void)
+{
+    memset(table, 0, (mask+1) * sizeof(stats_t));
+    nused     = 0;
+    overflow  = 0;
+    countdown = sample_interval;
+}
+
+DispatchProfiler::stats_t *DispatchProfiler::lookup(const Port &port,
+                                                    const RtData &d)
+{
+    uintptr_t h = (uintptr_t)&port;
+    h ^= h >> 17;
+    h *= 0x9e3779b1u;
+    for(unsigned i = 0, slot = h & mask; i <= mask; ++i, slot = (slot+1) & mask) {
+        stats_t &s = table[slot];
+        if(s.port == &port)
+            return &s;
+        if(s.port)
+            continue;
+        //keep one slot free, the table is never rehashed
+        if(nused == mask)
+            return NULL;
+        s.port = &port;
+        if(d.loc && d.loc_size)
+            fast_strcpy(s.path, d.location(), max_path);
+        else
+            fast_strcpy(s.path, port.name, max_path);
+        s.path[strcspn(s.path, ":")] = 0;
+        used[nused++] = slot;
+        return &s;
+    }
+    return NULL;
+}
+
+void DispatchProfiler::call(const Port &port, const char *m, RtData &d)
+{
+    if(!enabled) {
+        port.cb(m, d);
+        return;
+    }
+
+    stats_t *s = lookup(port, d);
+    if(!s) {
+        ++overflow;
+        port.cb(m, d);
+        return;
+    }
+    ++s->hits;
+
+    if(!sample_interval || --countdown) {
+        port.cb(m, d);
+        return;
+    }
+    countdown = sample_interval;
+
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+    port.cb(m, d);
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - start).count();
+
+    ++s->samples;
+    s->total_ns += ns;
+    if(ns > s->max_ns)
+        s->max_ns = ns;
+    int bucket = 0;
+    for(uint64_t t = ns >> 6; t && bucket < buckets-1; t >>= 1)
+        ++bucket;
+    ++s->histogram[bucket];
+}
+
+const DispatchProfiler::stats_t *DispatchProfiler::find(const char *path) const
+{
+    for(unsigned i=0; i<nused; ++i)
+        if(!strcmp(table[used[i]].path, path))
+            return &table[used[i]];
+    return NULL;
+}
+
+static void reply_stats(RtData &d, const DispatchProfiler::stats_t &s)
+{
+    d.reply(d.location(), "shhhh", s.path, (int64_t)s.hits,
+            (int64_t)s.samples, (int64_t)s.total_ns, (int64_t)s.max_ns);
+}
+
+#define PROFILER (*(DispatchProfiler*)d.obj)
+const Ports DispatchProfiler::ports = {
+    {"enable::T:F", "", 0, [](msg_t m, RtData &d) {
+        if(rtosc_narguments(m))
+            PROFILER.enabled = rtosc_argument(m, 0).T;
+        else
+            d.reply(d.location(), PROFILER.enabled ? "T" : "F");
+    }},
+    {"sample_interval::i", "", 0, [](msg_t m, RtData &d) {
+        if(rtosc_narguments(m)) {
+            const int n = rtosc_argument(m, 0).i;
+            PROFILER.sample_interval = n < 0 ? 0 : n;
+            PROFILER.countdown       = PROFILER.sample_interval;
+        } else
+            d.reply(d.location(), "i", (int)PROFILER.sample_interval);
+    }},
+    {"reset:", "", 0, [](msg_t, RtData &d) {
+        PROFILER.reset(); }},
+    {"count:", "", 0, [](msg_t, RtData &d) {
+        d.reply(d.location(), "i", (int)PROFILER.size()); }},
+    {"stats::s", "", 0, [](msg_t m, RtData &d) {
+        DispatchProfiler &p = PROFILER;
+        if(rtosc_narguments(m)) {
+            if(const stats_t *s = p.find(rtosc_argument(m, 0).s))
+                reply_stats(d, *s);
+        } else
+            for(unsigned i=0; i<p.size(); ++i)
+                reply_stats(d, p.stats(i));
+    }},
+    {"histogram:s", "", 0, [](msg_t m, RtData &d) {
+        const stats_t *s = PROFILER.find(rtosc_argument(m, 0).s);
+        if(!s)
+            return;
+        char types[buckets+2] = "s";
+        rtosc_arg_t vals[buckets+1];
+        vals[0].s = s->path;
+        for(int i=0; i<buckets; ++i) {
+            types[i+1]  = 'i';
+            vals[i+1].i = s->histogram[i];
+        }
+        types[buckets+1] = 0;
+        d.replyArray(d.location(), types, vals);
+    }},
+};
+#undef PROFILER
+
+Port DispatchProfiler::profilerPort(void)
+{
+    return Port{"profiler/", "", &ports, [this](msg_t m, RtData &d) {
+            d.obj = this;
+            while(*m && *m != '/')
+                ++m;
+            ports.dispatch(*m ? m+1 : m, d);
+        }};
+}
+
+}
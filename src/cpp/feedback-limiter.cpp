@@ -0,0 +1,146 @@
+#include <rtosc/feedback-limiter.h>
+#include <rtosc/rtosc.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rtosc {
+
+/*
+ * pending holds the messages in the order their addresses got pending, and
+ * slots maps each address to its message in pending. Bundles have no
+ * address to coalesce, they are appended. Messages which do not fit into
+ * pending anymore go to overflow and overflow_slots the same way, which
+ * become pending after the next flush.
+ */
+struct internal_limiter_t
+{
+    Broadcaster::sink_t out;
+    double interval;
+    size_t max_addresses;
+    double last;
+    bool   flushed_once;
+
+    std::vector<MessageRef> pending, overflow;
+    std::unordered_map<std::string, size_t> slots, overflow_slots;
+
+    size_t coalesced;
+    size_t dropped;
+};
+
+FeedbackLimiter::FeedbackLimiter(Broadcaster::sink_t out, double max_rate,
+                                 size_t max_addresses)
+    :impl(new internal_limiter_t)
+{
+    impl->out           = std::move(out);
+    impl->max_addresses = max_addresses;
+    impl->last          = 0;
+    impl->flushed_once  = false;
+    impl->coalesced     = 0;
+    impl->dropped       = 0;
+    impl->pending.reserve(max_addresses);
+    impl->slots.reserve(max_addresses);
+    impl->overflow.reserve(max_addresses);
+    impl->overflow_slots.reserve(max_addresses);
+    set_rate(max_rate);
+}
+
+FeedbackLimiter::~FeedbackLimiter(void)
+{
+    delete impl;
+}
+
+Broadcaster::sink_t FeedbackLimiter::sink(void)
+{
+    return [this](const MessageRef *msgs, size_t n) { add(msgs, n); };
+}
+
+//Keep msg in msgs, replacing the message for the same address, if any
+static bool keep(std::vector<MessageRef> &msgs,
+                 std::unordered_map<std::string, size_t> &slots,
+                 size_t max_addresses, const MessageRef &msg, size_t &coalesced)
+{
+    if(rtosc_bundle_p(msg.data())) {
+        if(msgs.size() == max_addresses)
+            return false;
+        msgs.push_back(msg);
+        return true;
+    }
+    auto itr = slots.find(msg.data());
+    if(itr != slots.end()) {
+        msgs[itr->second] = msg;
+        ++coalesced;
+    } else if(msgs.size() < max_addresses) {
+        slots.emplace(msg.data(), msgs.size());
+        msgs.push_back(msg);
+    } else
+        return false;
+    return true;
+}
+
+void FeedbackLimiter::add(const MessageRef *msgs, size_t n)
+{
+    for(size_t i=0; i<n; ++i) {
+        const MessageRef &msg = msgs[i];
+        //an address is pending or has overflowed, never both
+        if(!keep(impl->pending, impl->slots, impl->max_addresses, msg,
+                 impl->coalesced) &&
+           !keep(impl->overflow, impl->overflow_slots, impl->max_addresses,
+                 msg, impl->coalesced))
+            ++impl->dropped;
+    }
+}
+
+size_t FeedbackLimiter::tick(double now)
+{
+    if(impl->pending.empty() ||
+       (impl->flushed_once && now - impl->last < impl->interval))
+        return 0;
+    impl->last         = now;
+    impl->flushed_once = true;
+    return flush();
+}
+
+size_t FeedbackLimiter::tick(void)
+{
+    using namespace std::chrono;
+    const double now = duration_cast<duration<double>>(
+            steady_clock::now().time_since_epoch()).count();
+    return tick(now);
+}
+
+size_t FeedbackLimiter::flush(void)
+{
+    const size_t n = impl->pending.size();
+    if(n)
+        impl->out(impl->pending.data(), n);
+    impl->pending.clear();
+    impl->slots.clear();
+    //the overflowed messages are passed on with the next flush
+    impl->pending.swap(impl->overflow);
+    impl->slots.swap(impl->overflow_slots);
+    return n;
+}
+
+void FeedbackLimiter::set_rate(double max_rate)
+{
+    impl->interval = max_rate > 0 ? 1.0/max_rate : 0;
+}
+
+size_t FeedbackLimiter::pending(void) const
+{
+    return impl->pending.size();
+}
+
+size_t FeedbackLimiter::coalesced(void) const
+{
+    return impl->coalesced;
+}
+
+size_t FeedbackLimiter::dropped(void) const
+{
+    return impl->dropped;
+}
+
+}
@@ -0,0 +1,86 @@
+#include <rtosc/midi-decoder.h>
+
+namespace rtosc {
+
+MidiDecoder::MidiDecoder(void)
+{
+    for(role_t &r : role)
+        r = plain;
+    role[6]   = data_hi;
+    role[38]  = data_lo;
+    role[99]  = nrpn_hi;
+    role[98]  = nrpn_lo;
+    role[101] = rpn_hi;
+    role[100] = rpn_lo;
+    reset();
+}
+
+void MidiDecoder::setHighRes(int cc, bool high_res)
+{
+    // the data entry CCs keep their role
+    if(cc < 0 || cc >= 32 || cc == 6)
+        return;
+    role[cc]      = high_res ? coarse : plain;
+    role[cc + 32] = high_res ? fine : plain;
+}
+
+void MidiDecoder::reset(void)
+{
+    for(int ch = 0; ch < channels; ++ch) {
+        for(int i = 0; i < 32; ++i)
+            coarse_val[ch][i] = fine_val[ch][i] = 0;
+        params[ch] = ParameterState{-1, -1, -1, -1, false};
+    }
+}
+
+bool MidiDecoder::feed(int channel, int cc, int value, Event *ev)
+{
+    if(channel < 0 || channel >= channels || cc < 0 || cc >= 128 ||
+       value < 0 || value >= 128)
+        return false;
+    ParameterState &p = params[channel];
+
+    switch(role[cc])
+    {
+        case nrpn_hi:
+        case rpn_hi:
+            p.parhi   = value;
+            p.is_nrpn = role[cc] == nrpn_hi;
+            p.valhi = p.vallo = -1;
+            return false;
+        case nrpn_lo:
+        case rpn_lo:
+            p.parlo   = value;
+            p.is_nrpn = role[cc] == nrpn_lo;
+            p.valhi = p.vallo = -1;
+            return false;
+        case data_hi:
+        case data_lo:
+            // without (or after the RPN null) parameter, they are plain CCs
+            if(p.parhi < 0 || p.parlo < 0 ||
+               (!p.is_nrpn && p.parhi == 127 && p.parlo == 127))
+                break;
+            (role[cc] == data_hi ? p.valhi : p.vallo) = value;
+            if(p.valhi < 0 || p.vallo < 0)
+                return false;
+            *ev = Event{p.is_nrpn ? nrpn : rpn, channel,
+                        (p.parhi << 7) | p.parlo, (p.valhi << 7) | p.vallo};
+            return true;
+        case coarse:
+            coarse_val[channel][cc] = value;
+            *ev = Event{cc14, channel, cc,
+                        (value << 7) | fine_val[channel][cc]};
+            return true;
+        case fine:
+            fine_val[channel][cc - 32] = value;
+            *ev = Event{cc14, channel, cc - 32,
+                        (coarse_val[channel][cc - 32] << 7) | value};
+            return true;
+        case plain:
+            break;
+    }
+    *ev = Event{MidiDecoder::cc, channel, cc, value};
+    return true;
+}
+
+}
@@ -9,6 +9,7 @@
 
 #include <cassert>
 #include <rtosc/miditable.h>
+#include <rtosc/trace.h>
 
 using namespace rtosc;
 using std::string;
@@ -47,7 +48,7 @@ int getInd(const T&t,const U&u){
  * Storage *
  ***********/
 
-bool MidiMapperStorage::handleCC(int ID, int val, write_cb write)
+int MidiMapperStorage::apply(int ID, int val)
 {
     for(int i=0; i<mapping.size(); ++i)
     {
@@ -59,11 +60,21 @@ bool MidiMapperStorage::handleCC(int ID, int val, write_cb write)
                 values[ind] = (val<<7)|(values[ind]&0x7f);
             else
                 values[ind] = val|(values[ind]&0x3f80);
-            callbacks[ind](values[ind],write);
-            return true;
+            return ind;
         }
     }
-    return false;
+    return -1;
+}
+
+bool MidiMapperStorage::handleCC(int ID, int val, write_cb write)
+{
+    if(trace::active())
+        trace::instant("midi", "cc", ID);
+    const int ind = apply(ID, val);
+    if(ind < 0)
+        return false;
+    callbacks[ind](values[ind],write);
+    return true;
 }
 
 //TODO try to change O(n^2) algorithm to O(n)
@@ -99,6 +110,13 @@ void MidiMapperStorage::cloneValues(const MidiMapperStorage &storage)
     }
 }
 
+MidiMapperStorage::~MidiMapperStorage(void)
+{
+    mapping.release();
+    callbacks.release();
+    values.release();
+}
+
 MidiMapperStorage *MidiMapperStorage::clone(void)
 {
     MidiMapperStorage *nstorage = new MidiMapperStorage();
@@ -127,9 +145,55 @@ float MidiBijection::operator()(int x) const {
  * Non realtime portion *
  ************************/
 MidiMappernRT::MidiMappernRT(void)
-    :storage(0),base_ports(0)
+    :storage(0),base_ports(0),published(true),transaction(0)
 {}
 
+void MidiMappernRT::replaceStorage(MidiMapperStorage *nstorage, bool publish)
+{
+    //the realtime side has never seen an unpublished storage
+    if(!published)
+        delete storage;
+    storage   = nstorage;
+    published = false;
+    if(publish && !transaction)
+        publishStorage();
+}
+
+void MidiMappernRT::publishStorage(void)
+{
+    if(published)
+        return;
+    published = true;
+    char buf[1024];
+    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
+    rt_cb(buf);
+}
+
+void MidiMappernRT::beginTransaction(void)
+{
+    ++transaction;
+}
+
+void MidiMappernRT::commitTransaction(void)
+{
+    if(transaction && !--transaction)
+        publishStorage();
+}
+
+bool MidiMappernRT::reclaim(const char *msg)
+{
+    if(strcmp(msg, "/midi-retire") || strcmp(rtosc_argument_string(msg), "b"))
+        return false;
+    rtosc_blob_t b = rtosc_argument(msg, 0).b;
+    if(b.len != sizeof(MidiMapperStorage*))
+        return false;
+    MidiMapperStorage *old;
+    memcpy(&old, b.data, sizeof(old));
+    assert(old != storage);
+    delete old;
+    return true;
+}
+
 void MidiMappernRT::map(const char *addr, bool coarse)
 {
     for(auto x:learnQueue)
@@ -226,12 +290,8 @@ void MidiMappernRT::addNewMapper(int ID, const Port &port, std::string addr)
         nstorage->mapping   = nstorage->mapping.insert(std::make_tuple(ID, true, 0));
         nstorage->callbacks = nstorage->callbacks.insert(tmp);
     }
-    storage = nstorage;
-    inv_map[addr] = std::make_tuple(storage->callbacks.size()-1, ID,-1,bi);
-
-    char buf[1024];
-    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
-    rt_cb(buf);
+    inv_map[addr] = std::make_tuple(nstorage->callbacks.size()-1, ID,-1,bi);
+    replaceStorage(nstorage);
 }
 
 void MidiMappernRT::addFineMapper(int ID, const Port &port, std::string addr)
@@ -249,7 +309,7 @@ void MidiMappernRT::addFineMapper(int ID, const Port &port, std::string addr)
     nstorage->values    = storage->values.sized_clone();
     nstorage->mapping   = storage->mapping.insert(std::make_tuple(ID, false, mapped_ID));
     nstorage->callbacks = storage->callbacks.insert(storage->callbacks[mapped_ID]);
-    storage = nstorage;
+    replaceStorage(nstorage, false);
 }
 
 void killMap(int ID, MidiMapperStorage &m)
@@ -260,6 +320,7 @@ void killMap(int ID, MidiMapperStorage &m)
         if(get<0>(m.mapping[i]) != ID)
             nmapping[j++] = m.mapping[i];
     assert(j == nmapping.size());
+    m.mapping.release();
     m.mapping = nmapping;
 }
 
@@ -294,13 +355,9 @@ void MidiMappernRT::useFreeID(int ID)
             killMap(get<1>(imap), *nstorage);
         inv_map[addr] = make_tuple(get<0>(imap), get<1>(imap), ID, get<3>(imap));
     }
-    storage = nstorage;
 
     //TODO clean up unused value and callback objects
-
-    char buf[1024];
-    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
-    rt_cb(buf);
+    replaceStorage(nstorage);
 };
 
 void MidiMappernRT::unMap(const char *addr, bool coarse)
@@ -332,13 +389,9 @@ void MidiMappernRT::unMap(const char *addr, bool coarse)
 
     MidiMapperStorage *nstorage = storage->clone();
     killMap(kill_id, *nstorage);
-    storage = nstorage;
 
     //TODO clean up unused value and callback objects
-
-    char buf[1024];
-    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
-    rt_cb(buf);
+    replaceStorage(nstorage);
 }
 
 void MidiMappernRT::delMapping(int ID, bool coarse, const char *addr){
@@ -350,12 +403,9 @@ void MidiMappernRT::replaceMapping(int, bool, const char *){};
 
 void MidiMappernRT::clear(void)
 {
-    storage = new MidiMapperStorage();
     learnQueue.clear();
     inv_map.clear();
-    char buf[1024];
-    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
-    rt_cb(buf);
+    replaceStorage(new MidiMapperStorage());
 }
 
 
@@ -458,11 +508,7 @@ void MidiMappernRT::setBounds(const char *str, float low, float high)
         cb(buf);
     };
 
-    storage = nstorage;
-
-    char buf[1024];
-    rtosc_message(buf, 1024, "/midi-learn/midi-bind", "b", sizeof(storage), &storage);
-    rt_cb(buf);
+    replaceStorage(nstorage);
 }
 
 std::tuple<float,float,float,float> MidiMappernRT::getBounds(const char *str)
@@ -550,7 +596,11 @@ void MidiMapperRT::setBackendCb(std::function<void(const char*)> cb) {backend =
 void MidiMapperRT::setFrontendCb(std::function<void(const char*)> cb) {frontend = cb;}
 void MidiMapperRT::handleCC(int ID, int val) {
     //printf("handling CC(%d,%d){%d,%d,%d}\n", ID, val, (int)storage, pending.has(ID), watchSize);
-    if((!storage || !storage->handleCC(ID, val, backend)) && !pending.has(ID) && watchSize) {
+    if(!storage || !storage->handleCC(ID, val, backend))
+        unhandledCC(ID);
+}
+void MidiMapperRT::unhandledCC(int ID) {
+    if(!pending.has(ID) && watchSize) {
         watchSize--;
         pending.insert(ID);
         char msg[1024];
@@ -558,6 +608,53 @@ void MidiMapperRT::handleCC(int ID, int val) {
         frontend(msg);
     }
 }
+void MidiMapperRT::handleCCs(const MidiEvent *events, int n) {
+    //indices of the values changed in this block, in order of their first
+    //change, such that each target is only written once
+    int changed[64];
+    int nchanged = 0;
+    for(int i=0; i<n; ++i) {
+        const int ind = storage ? storage->apply(events[i].ID, events[i].val)
+                                : -1;
+        if(ind < 0) {
+            unhandledCC(events[i].ID);
+            continue;
+        }
+        int j = 0;
+        while(j < nchanged && changed[j] != ind)
+            ++j;
+        if(j < nchanged)
+            continue;
+        if(nchanged == sizeof(changed)/sizeof(changed[0])) {
+            flush(changed, nchanged);
+            nchanged = 0;
+        }
+        changed[nchanged++] = ind;
+    }
+    flush(changed, nchanged);
+}
+void MidiMapperRT::flush(const int *changed, int n) {
+    for(int i=0; i<n; ++i)
+        storage->callbacks[changed[i]](storage->values[changed[i]], backend);
+}
+void MidiMapperRT::bind(const char *msg)
+{
+    pending.pop();
+    MidiMapperStorage *nstorage =
+        *(MidiMapperStorage**)rtosc_argument(msg,0).b.data;
+    MidiMapperStorage *old = storage;
+    if(old)
+        nstorage->cloneValues(*old);
+    storage = nstorage;
+
+    //the old storage is freed by the non realtime side
+    if(old && frontend) {
+        char buf[64];
+        rtosc_message(buf, sizeof(buf), "/midi-retire", "b",
+                      sizeof(old), &old);
+        frontend(buf);
+    }
+}
 void MidiMapperRT::addWatch(void) {watchSize++;}
 void MidiMapperRT::remWatch(void) {if(watchSize) watchSize--;}
 
@@ -573,14 +670,7 @@ const rtosc::Ports MidiMapperRT::ports = {
     {"midi-bind:b","",0, [](msg_t msg, RtData&d)
         {
             auto &midi = *(MidiMapperRT*)d.obj;
-            midi.pending.pop();
-            MidiMapperStorage *nstorage =
-                *(MidiMapperStorage**)rtosc_argument(msg,0).b.data;
-            if(midi.storage) {
-                nstorage->cloneValues(*midi.storage);
-                midi.storage = nstorage;
-            } else
-                midi.storage = nstorage;}}
+            midi.bind(msg);}}
 };
 
 //Depricated
@@ -596,14 +686,6 @@ Port MidiMapperRT::removeWatchPort(void) {
 }
 Port MidiMapperRT::bindPort(void) {
     return Port{"midi-bind:b","",0, [this](msg_t msg, RtData&) {
-        pending.pop();
-        MidiMapperStorage *nstorage =
-            *(MidiMapperStorage**)rtosc_argument(msg,0).b.data;
-        if(storage) {
-            nstorage->cloneValues(*storage);
-            storage = nstorage;
-        } else
-            storage = nstorage;
-        //TODO memory deallocation
+        bind(msg);
     }};
 }
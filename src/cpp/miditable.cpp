@@ -5,7 +5,9 @@
 using namespace rtosc;
 
 #define RTOSC_INVALID_MIDI 255
-        
+#define MIDI_CHANNELS 16
+#define MIDI_CONTROLS 128
+
 class rtosc::MidiTable_Impl
 {
     public:
@@ -13,28 +15,91 @@ class rtosc::MidiTable_Impl
             :len(len), elms(elms)
         {
             table = new MidiAddr[elms];
+            targets = new target_t[elms];
             for(unsigned i=0; i<elms; ++i) {
                 table[i].ch   = RTOSC_INVALID_MIDI;
                 table[i].ctl  = RTOSC_INVALID_MIDI;
                 table[i].path = new char[len];
+                table[i].path[0] = 0;
                 table[i].conversion = NULL;
+                targets[i].msg = new char[len + 16];
+                targets[i].len = 0;
             }
-            //TODO initialize all elms
+            rebuild();
         }
         ~MidiTable_Impl()
         {
             for(unsigned i=0; i<elms; ++i) {
                 delete [] table[i].path;
+                delete [] targets[i].msg;
             }
             delete [] table;
+            delete [] targets;
         }
 
         MidiAddr *begin(void) {return table;}
         MidiAddr *end(void) {return table + elms;}
 
+        //! index of the element for ch and ctl, or -1
+        int find(uint8_t ch, uint8_t ctl) const
+        {
+            if(ch < MIDI_CHANNELS && ctl < MIDI_CONTROLS)
+                return lookup[ch][ctl];
+            for(unsigned i=0; i<elms; ++i)
+                if(table[i].ch == ch && table[i].ctl == ctl)
+                    return i;
+            return -1;
+        }
+
+        //! rebuild the lookup table after mappings changed
+        void rebuild(void)
+        {
+            for(auto &ch : lookup)
+                for(short &ctl : ch)
+                    ctl = -1;
+            for(unsigned i=elms; i-- > 0;) {
+                const MidiAddr &e = table[i];
+                if(e.ch < MIDI_CHANNELS && e.ctl < MIDI_CONTROLS)
+                    lookup[e.ch][e.ctl] = i;
+            }
+        }
+
+        //! prepare the message of element i, only its argument is patched
+        void encode(unsigned i)
+        {
+            const MidiAddr &e = table[i];
+            target_t &t = targets[i];
+            const char type[2] = {e.type, 0};
+            if(e.type == 'T')
+                t.len = rtosc_message(t.msg, len + 16, e.path, type);
+            else if(e.type == 'f')
+                t.len = rtosc_message(t.msg, len + 16, e.path, type, 0.0f);
+            else
+                t.len = rtosc_message(t.msg, len + 16, e.path, type, 0);
+            t.arg = e.type == 'T' ? (char*)rtosc_argument_string(t.msg)
+                                  : t.msg + t.len - 4;
+            if(e.type == 'f') {
+                t.conv = MidiTable::parseConversion(e.conversion);
+                for(int v=0; v<MIDI_CONTROLS; ++v)
+                    t.values[v] = MidiTable::translate(v, t.conv);
+            }
+        }
+
+        struct target_t
+        {
+            char *msg;   //!< message to the element's path
+            int   len;
+            char *arg;   //!< the argument, or the type tag for 'T'
+            MidiTable::Conversion conv;  //!< parsed conversion for 'f'
+            float values[MIDI_CONTROLS]; //!< translated values for 'f'
+        };
+
         unsigned len;
         unsigned elms;
         MidiAddr *table;
+        target_t *targets;
+        //! index of the first element for each channel and controller
+        short lookup[MIDI_CHANNELS][MIDI_CONTROLS];
 };
 
 //MidiAddr::MidiAddr(void)
@@ -67,27 +132,19 @@ MidiTable::~MidiTable()
 
 bool MidiTable::has(uint8_t ch, uint8_t ctl) const
 {
-    for(auto e: *impl) {
-        if(e.ch == ch && e.ctl == ctl)
-            return true;
-    }
-    return false;
+    return impl->find(ch, ctl) >= 0;
 }
 
 MidiAddr *MidiTable::get(uint8_t ch, uint8_t ctl)
 {
-    for(auto &e: *impl)
-        if(e.ch==ch && e.ctl == ctl)
-            return &e;
-    return NULL;
+    const int i = impl->find(ch, ctl);
+    return i < 0 ? NULL : impl->table + i;
 }
 
 const MidiAddr *MidiTable::get(uint8_t ch, uint8_t ctl) const
 {
-    for(auto &e:*impl)
-        if(e.ch==ch && e.ctl == ctl)
-            return &e;
-    return NULL;
+    const int i = impl->find(ch, ctl);
+    return i < 0 ? NULL : impl->table + i;
 }
 
 bool MidiTable::mash_port(MidiAddr &e, const Port &port)
@@ -126,7 +183,9 @@ void MidiTable::addElm(uint8_t ch, uint8_t ctl, const char *path)
             e->ch  = RTOSC_INVALID_MIDI;
             e->ctl = RTOSC_INVALID_MIDI;
             error_cb("Failed to read metadata", path);
-        }
+        } else
+            impl->encode(e - impl->table);
+        impl->rebuild();
         modify_cb("REPLACE", path, e->conversion, (int) ch, (int) ctl);
         return;
     }
@@ -140,7 +199,9 @@ void MidiTable::addElm(uint8_t ch, uint8_t ctl, const char *path)
                 e.ch  = RTOSC_INVALID_MIDI;
                 e.ctl = RTOSC_INVALID_MIDI;
                 error_cb("Failed to read metadata", path);
-            }
+            } else
+                impl->encode(&e - impl->table);
+            impl->rebuild();
             modify_cb("ADD", path, e.conversion, (int) ch, (int) ctl);
             return;
         }
@@ -175,6 +236,7 @@ void MidiTable::clear_entry(const char *s)
             //Invalidate
             impl->table[i].ch  = RTOSC_INVALID_MIDI;
             impl->table[i].ctl = RTOSC_INVALID_MIDI;
+            impl->rebuild();
             modify_cb("DEL", s, "", -1, -1);
             break;
         }
@@ -183,35 +245,40 @@ void MidiTable::clear_entry(const char *s)
 
 void MidiTable::process(uint8_t ch, uint8_t ctl, uint8_t val)
 {
-    const MidiAddr *addr = get(ch,ctl);
-    if(!addr) {
+    const int i = impl->find(ch,ctl);
+    if(i < 0) {
         unhandled_ctl = ctl;
         unhandled_ch  = ch;
         check_learn();
         return;
     }
 
-    char buffer[1024];
-    switch(addr->type)
+    //patch the value into the prepared message
+    const MidiAddr &addr = impl->table[i];
+    MidiTable_Impl::target_t &t = impl->targets[i];
+    uint32_t arg = val;
+    switch(addr.type)
     {
         case 'f':
-            rtosc_message(buffer, 1024, addr->path,
-                    "f", translate(val,addr->conversion));
-            break;
+        {
+            float f = val < MIDI_CONTROLS ? t.values[val]
+                                          : translate(val,t.conv);
+            memcpy(&arg, &f, sizeof(arg));
+        }
+        //fallthrough
         case 'i':
-            rtosc_message(buffer, 1024, addr->path,
-                    "i", val);
+        case 'c':
+            t.arg[0] = arg >> 24;
+            t.arg[1] = arg >> 16;
+            t.arg[2] = arg >> 8;
+            t.arg[3] = arg;
             break;
         case 'T':
-            rtosc_message(buffer, 1024, addr->path,
-                    (val<64 ? "F" : "T"));
+            *t.arg = val<64 ? 'F' : 'T';
             break;
-        case 'c':
-            rtosc_message(buffer, 1024, addr->path,
-                    "c", val);
     }
 
-    event_cb(buffer);
+    event_cb(t.msg);
 }
 
 Port MidiTable::learnPort(void)
@@ -238,31 +305,51 @@ Port MidiTable::registerPort(void)
             this->addElm(rtosc_argument(m,0).i,rtosc_argument(m,1).i,rtosc_argument(m,2).s);}};
 }
 
-//TODO generalize to an addScalingFunction() system
-float MidiTable::translate(uint8_t val, const char *meta_)
+MidiTable::Conversion MidiTable::parseConversion(const char *meta_)
 {
-    //Allow for middle value to be set
-    //TODO consider the centered trait for this op
-    float x = val!=64.0 ? val/127.0 : 0.5;
-
+    Conversion c = {Conversion::invalid, 0.0f, 0.0f};
     Port::MetaContainer meta(meta_);
 
     if(!meta["min"] || !meta["max"] || !meta["scale"]) {
         fprintf(stderr, "failed to get properties\n");
-        return 0.0f;
+        return c;
     }
 
     const float min   = atof(meta["min"]);
     const float max   = atof(meta["max"]);
     const char *scale = meta["scale"];
 
-    if(!strcmp(scale,"linear"))
-        return x*(max-min)+min;
-    else if(!strcmp(scale,"logarithmic")) {
-        const float b = log(min);
-        const float a = log(max)-b;
-        return expf(a*x+b);
+    if(!strcmp(scale,"linear")) {
+        c.scale  = Conversion::linear;
+        c.offset = min;
+        c.factor = max-min;
+    } else if(!strcmp(scale,"logarithmic")) {
+        c.scale  = Conversion::logarithmic;
+        c.offset = log(min);
+        c.factor = log(max)-c.offset;
+    }
+    return c;
+}
+
+float MidiTable::translate(uint8_t val, const Conversion &c)
+{
+    //Allow for middle value to be set
+    //TODO consider the centered trait for this op
+    float x = val!=64.0 ? val/127.0 : 0.5;
+
+    switch(c.scale)
+    {
+        case Conversion::linear:
+            return x*c.factor+c.offset;
+        case Conversion::logarithmic:
+            return expf(c.factor*x+c.offset);
+        default:
+            return 0.0f;
     }
+}
 
-    return 0.0f;
+//TODO generalize to an addScalingFunction() system
+float MidiTable::translate(uint8_t val, const char *meta_)
+{
+    return translate(val, parseConversion(meta_));
 }
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rtosc/ports.h>
+#include <rtosc/parallel-dispatch.h>
+#include <rtosc/worker-pool.h>
+
+namespace rtosc {
+
+ParallelDispatcher::ParallelDispatcher(unsigned threads)
+    :pool(threads ? new WorkerPool(threads) : &WorkerPool::shared()),
+     own_pool(threads)
+{}
+
+ParallelDispatcher::ParallelDispatcher(WorkerPool &pool)
+    :pool(&pool), own_pool(false)
+{}
+
+ParallelDispatcher::~ParallelDispatcher(void)
+{
+    if(own_pool)
+        delete pool;
+}
+
+unsigned ParallelDispatcher::threads(void) const
+{
+    return pool->size();
+}
+
+int ParallelDispatcher::dispatch(const Ports &root, const char *const *msgs,
+                                 size_t n, RtData *const *data)
+{
+    //partition by the first path segment, in order of appearance
+    std::vector<std::vector<const char*>> partitions;
+    std::unordered_map<std::string, size_t> index;
+    for(size_t i=0; i<n; ++i) {
+        const char *m   = msgs[i];
+        const char *seg = *m == '/' ? m+1 : m;
+        const std::string key(seg, strcspn(seg, "/"));
+        auto res = index.emplace(key, partitions.size());
+        if(res.second)
+            partitions.emplace_back();
+        partitions[res.first->second].push_back(m);
+    }
+
+    //start with the largest partitions to balance the workers
+    std::vector<size_t> order(partitions.size());
+    for(size_t i=0; i<order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return partitions[a].size() > partitions[b].size(); });
+
+    std::atomic<int> matches(0);
+    pool->run(order.size(), [&](size_t job, unsigned worker) {
+            const std::vector<const char*> &p = partitions[order[job]];
+            RtData &d = *data[worker];
+            root.dispatch_batch(p.data(), p.size(), d);
+            matches += d.matches;
+        });
+    return matches;
+}
+
+}
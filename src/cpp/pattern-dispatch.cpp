@@ -0,0 +1,354 @@
+#include "../util.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/pattern-dispatch.h>
+#include <rtosc/msg-view.h>
+
+namespace rtosc {
+
+bool CompiledPattern::compile(const char *pattern)
+{
+    nsegments = 0;
+    if(*pattern == '/')
+        ++pattern;
+    const size_t len = strlen(pattern);
+    if(len >= max_address)
+        return false;
+    memcpy(address, pattern, len+1);
+
+    int nops = 0, nsets = 0, nsegs = 0;
+    const char *p = address;
+    while(true) {
+        if(nsegs == max_segments)
+            return false;
+        seg_begin[nsegs] = nops;
+        seg_text[nsegs]  = p - address;
+        ++nsegs;
+
+        while(*p && *p != '/') {
+            if(nops == max_ops)
+                return false;
+            op_t &op = ops[nops++];
+            op.len    = 0;
+            op.offset = p - address;
+            if(*p == '*') {
+                op.type = STAR;
+                while(*p == '*')
+                    ++p;
+            } else if(*p == '?') {
+                op.type = ANY;
+                ++p;
+            } else if(*p == '[') {
+                if(nsets == max_sets)
+                    return false;
+                op.type   = SET;
+                op.offset = nsets;
+                uint8_t *set = sets[nsets++];
+                memset(set, 0, 32);
+                ++p;
+                const bool negate = *p == '!';
+                if(negate)
+                    ++p;
+                while(*p && *p != ']' && *p != '/') {
+                    uint8_t lo = *p, hi = *p;
+                    if(p[1] == '-' && p[2] && p[2] != ']') {
+                        hi = p[2];
+                        p += 2;
+                    }
+                    for(unsigned c = lo; c <= hi; ++c)
+                        set[c/8] |= 1 << (c%8);
+                    ++p;
+                }
+                if(*p != ']')
+                    return false;
+                ++p;
+                if(negate)
+                    for(int i=0; i<32; ++i)
+                        set[i] = ~set[i];
+            } else if(*p == '{') {
+                op.type   = OPTIONS;
+                op.offset = ++p - address;
+                while(*p && *p != '}' && *p != '/')
+                    ++p;
+                if(*p != '}')
+                    return false;
+                op.len = p++ - address - op.offset;
+            } else {
+                op.type = LITERAL;
+                while(*p && !strchr("/*?[{", *p))
+                    ++p;
+                op.len = p - address - op.offset;
+            }
+        }
+
+        if(!*p)
+            break;
+        ++p;
+    }
+
+    seg_begin[nsegs] = nops;
+    seg_text[nsegs]  = len+1;
+    nsegments = nsegs;
+    return true;
+}
+
+bool CompiledPattern::literal(int seg) const
+{
+    const int n = seg_begin[seg+1] - seg_begin[seg];
+    return !n || (n == 1 && ops[seg_begin[seg]].type == LITERAL);
+}
+
+const char *CompiledPattern::segment(int seg, int *len) const
+{
+    *len = seg_text[seg+1] - seg_text[seg] - 1;
+    return address + seg_text[seg];
+}
+
+bool CompiledPattern::match(int seg, const char *str, int len) const
+{
+    return match_ops(seg_begin[seg], seg_begin[seg+1], str, str+len);
+}
+
+bool CompiledPattern::match_ops(int op, int end_op,
+                                const char *s, const char *e) const
+{
+    for(; op < end_op; ++op) {
+        const op_t &o = ops[op];
+        switch(o.type) {
+            case LITERAL:
+                if(e - s < o.len || memcmp(s, address+o.offset, o.len))
+                    return false;
+                s += o.len;
+                break;
+            case ANY:
+                if(s == e)
+                    return false;
+                ++s;
+                break;
+            case SET:
+                if(s == e || !(sets[o.offset][(uint8_t)*s/8] &
+                               (1 << ((uint8_t)*s%8))))
+                    return false;
+                ++s;
+                break;
+            case STAR:
+                //longest match first, the rest is matched recursively
+                for(const char *t = e; t >= s; --t)
+                    if(match_ops(op+1, end_op, t, e))
+                        return true;
+                return false;
+            case OPTIONS:
+            {
+                const char *opt = address + o.offset;
+                const char *end = opt + o.len;
+                while(opt <= end) {
+                    const char *next = opt;
+                    while(next < end && *next != ',')
+                        ++next;
+                    const int n = next - opt;
+                    if(e - s >= n && !memcmp(s, opt, n) &&
+                       match_ops(op+1, end_op, s+n, e))
+                        return true;
+                    opt = next + 1;
+                }
+                return false;
+            }
+        }
+    }
+    return s == e;
+}
+
+PatternCache::PatternCache(void)
+    :clock(0)
+{
+    memset(last_use, 0, sizeof(last_use));
+}
+
+const CompiledPattern *PatternCache::get(const char *address)
+{
+    if(*address == '/')
+        ++address;
+    int lru = 0;
+    for(int i=0; i<size; ++i) {
+        if(entries[i].valid() && !strcmp(entries[i].pattern(), address)) {
+            last_use[i] = ++clock;
+            return &entries[i];
+        }
+        if(last_use[i] < last_use[lru])
+            lru = i;
+    }
+
+    last_use[lru] = ++clock;
+    if(!entries[lru].compile(address)) {
+        last_use[lru] = 0;
+        return NULL;
+    }
+    return &entries[lru];
+}
+
+bool is_pattern(const char *address)
+{
+    return strpbrk(address, "*?[{");
+}
+
+namespace {
+
+struct fan_out_t
+{
+    const Ports           &root;
+    const CompiledPattern &pattern;
+    const char            *msg;
+    RtData                &d;
+    int                    dispatched;
+    int                    matches;
+    char                   path[2*CompiledPattern::max_address];
+};
+
+/*
+ * Call emit(out_begin, len) for each concrete name the port name
+ * [name, end) can stand for, written to out. "#N" expands to 0..N-1 and
+ * "{a,b}" to a and b. Names with '*' can not be enumerated.
+ */
+template<class F>
+void expand_name(const char *name, const char *end, char *out,
+                 char *out_begin, char *out_end, F &emit)
+{
+    while(name < end && *name != '#' && *name != '{' && *name != '*') {
+        if(out == out_end)
+            return;
+        *out++ = *name++;
+    }
+
+    if(name == end)
+        emit(out_begin, out - out_begin);
+    else if(*name == '#') {
+        const int max = atoi(++name);
+        while(name < end && isdigit(*name))
+            ++name;
+        for(int i=0; i<max; ++i) {
+            const int n = snprintf(out, out_end - out, "%d", i);
+            if(n >= out_end - out)
+                return;
+            expand_name(name, end, out + n, out_begin, out_end, emit);
+        }
+    } else if(*name == '{') {
+        const char *close = name;
+        while(close < end && *close != '}')
+            ++close;
+        const char *opt = name + 1;
+        while(opt <= close && close < end) {
+            const char *next = opt;
+            while(next < close && *next != ',')
+                ++next;
+            if(next - opt > out_end - out)
+                return;
+            memcpy(out, opt, next - opt);
+            expand_name(close + 1, end, out + (next - opt), out_begin,
+                        out_end, emit);
+            opt = next + 1;
+        }
+    }
+}
+
+void dispatch_leaf(fan_out_t &f, const char *path)
+{
+    const char   *args  = rtosc_argument_string(f.msg);
+    const MsgView view(f.msg);
+    const int     nargs = view.size();
+    const size_t  size  = rtosc_message_length(f.msg, -1) + strlen(path) + 8;
+    STACKALLOC(rtosc_arg_t, vals, nargs+1);
+    STACKALLOC(char, buffer, size);
+    for(int i=0; i<nargs; ++i)
+        vals[i] = view[i];
+    if(!rtosc_amessage(buffer, size, path, args, vals))
+        return;
+
+    f.root.dispatch(buffer, f.d, true);
+    f.matches += f.d.matches;
+    ++f.dispatched;
+}
+
+void fan_out(fan_out_t &f, const Ports &ports, int seg, char *pos)
+{
+    const bool leaf_level = seg + 1 == f.pattern.segments();
+    const bool literal    = f.pattern.literal(seg);
+    char *const path_end  = f.path + sizeof(f.path) - 2;
+
+    for(unsigned i=0; i<ports.size(); ++i) {
+        const Port &port = ports[i];
+        int len = strcspn(port.name, ":");
+        const bool subtree = len && port.name[len-1] == '/';
+        if(subtree == leaf_level || (subtree && !port.ports))
+            continue;
+        if(subtree)
+            --len;
+
+        auto emit = [&](char *name, int name_len) {
+            if(!f.pattern.match(seg, name, name_len))
+                return;
+            char *end = name + name_len;
+            if(subtree) {
+                *end++ = '/';
+                *end   = 0;
+                fan_out(f, *port.ports, seg+1, end);
+                return;
+            }
+            *end = 0;
+            //skip addresses which an earlier port has dispatched already
+            for(unsigned j=0; j<i; ++j)
+                if(!strchr(ports[j].name, '/') &&
+                   (literal || !strchr(ports[j].name, '*')) &&
+                   rtosc_match_path(ports[j].name, name, NULL))
+                    return;
+            dispatch_leaf(f, f.path);
+        };
+
+        if(literal) {
+            //matching the literal against the port is enough, this also
+            //allows port names which can not be enumerated
+            int seg_len;
+            const char *text = f.pattern.segment(seg, &seg_len);
+            if(seg_len + 1 > path_end - pos)
+                continue;
+            memcpy(pos, text, seg_len);
+            pos[seg_len]   = subtree ? '/' : 0;
+            pos[seg_len+1] = 0;
+            if(rtosc_match_path(port.name, pos, NULL))
+                emit(pos, seg_len);
+        } else
+            expand_name(port.name, port.name + len, pos, pos, path_end, emit);
+    }
+}
+
+}
+
+int dispatch_pattern(const Ports &root, const char *m, RtData &d,
+                     PatternCache *cache)
+{
+    CompiledPattern local;
+    const CompiledPattern *pattern = NULL;
+    if(is_pattern(m)) {
+        if(cache)
+            pattern = cache->get(m);
+        else if(local.compile(m))
+            pattern = &local;
+    }
+
+    if(!pattern) {
+        root.dispatch(m, d, true);
+        return 1;
+    }
+
+    fan_out_t f = {root, *pattern, m, d, 0, 0, {0}};
+    f.path[0] = '/';
+    fan_out(f, root, 0, f.path + 1);
+    d.matches = f.matches;
+    return f.dispatched;
+}
+
+}
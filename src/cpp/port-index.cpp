@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <rtosc/bundle-foreach.h>
+#include <rtosc/port-index.h>
+
+#include "../util.h"
+
+namespace rtosc {
+
+PortIndex::PortIndex(const Ports &root, bool expand_bundles)
+    :max_path(0)
+{
+    char name_buffer[8192] = "";
+    std::vector<int> path_indices;
+    build(root, name_buffer, sizeof(name_buffer), path_indices,
+          expand_bundles);
+}
+
+void PortIndex::add(const Port &p, const Ports &base, const char *name_buffer,
+                    const char *old_end, const std::vector<int> &path_indices)
+{
+    const size_t len = strlen(name_buffer);
+    entries.push_back(entry_t{&p, &base, (uint32_t)strings.size(),
+                              (uint32_t)(old_end - name_buffer),
+                              (uint32_t)index_arena.size(),
+                              (uint32_t)path_indices.size()});
+    strings.insert(strings.end(), name_buffer, name_buffer + len + 1);
+    index_arena.insert(index_arena.end(),
+                       path_indices.begin(), path_indices.end());
+    if(len > max_path)
+        max_path = len;
+}
+
+// The same expansion as walk_port(), without a runtime object
+void PortIndex::build(const Ports &base, char *name_buffer, size_t buffer_size,
+                      std::vector<int> &path_indices, bool expand_bundles)
+{
+    if(name_buffer[0] == 0)
+        name_buffer[0] = '/';
+
+    for(const Port &p : base)
+    {
+        char *const old_end = name_buffer + strlen(name_buffer);
+        const size_t remain = buffer_size - (old_end - name_buffer);
+
+        if(p.ports) {
+            fast_strcpy(old_end, p.name, remain);
+            char *const hash = strchr(old_end, '#');
+            if(hash)
+            {
+                const int max = atoi(hash + 1);
+                for(int i = 0; i < max; ++i)
+                {
+                    sprintf(hash, "%d/", i);
+                    path_indices.push_back(i);
+                    build(*p.ports, name_buffer, buffer_size, path_indices,
+                          expand_bundles);
+                    path_indices.pop_back();
+                }
+            }
+            else
+                build(*p.ports, name_buffer, buffer_size, path_indices,
+                      expand_bundles);
+        } else if(strchr(p.name, '#')) {
+            int i = 0;
+            bundle_foreach(p, p.name, old_end, name_buffer, base, NULL, NULL,
+                [&](const Port *p, const char *name_buffer,
+                    const char *old_end, const Ports &base, void *, void *)
+                {
+                    if(expand_bundles)
+                        path_indices.push_back(i++);
+                    add(*p, base, name_buffer, old_end, path_indices);
+                    if(expand_bundles)
+                        path_indices.pop_back();
+                }, expand_bundles);
+        } else {
+            char *pos = old_end;
+            for(const char *n = p.name; *n && *n != ':'; )
+                *pos++ = *n++;
+            *pos = 0;
+            add(p, base, name_buffer, old_end, path_indices);
+        }
+
+        //Remove the rest of the path
+        memset(old_end, 0, strlen(old_end));
+    }
+}
+
+void PortIndex::walk(void *data, port_walker_t walker) const
+{
+    // room for walkers which append to the name buffer
+    std::vector<char> name_buffer(max_path + 1024);
+    for(const entry_t &e : entries)
+    {
+        const char *src = strings.data() + e.path;
+        memcpy(name_buffer.data(), src, strlen(src) + 1);
+        walker(e.port, name_buffer.data(), name_buffer.data() + e.from_base,
+               *e.base, data, NULL);
+    }
+}
+
+namespace {
+
+//! Length of a port name without its argument specs
+size_t name_length(const char *name)
+{
+    const char *colon = strchr(name, ':');
+    return colon ? colon - name : strlen(name);
+}
+
+bool by_name_less(const Port *lhs, const Port *rhs)
+{
+    return strcmp(lhs->name, rhs->name) < 0;
+}
+
+// <0, 0 or >0 if str is less, starts with or is greater than needle
+int compare_prefix(const char *str, const char *needle, size_t len)
+{
+    return strncmp(str, needle, len);
+}
+
+}
+
+PathSearchIndex::PathSearchIndex(const Ports &root, bool substrings)
+    :root_ports(root), has_suffixes(substrings)
+{
+    build(root, substrings);
+}
+
+void PathSearchIndex::build(const Ports &ports, bool substrings)
+{
+    if(nodes.count(&ports))
+        return;
+    node_t &node = nodes[&ports];
+
+    for(const Port &p : ports)
+        if(p.name)
+            node.by_name.push_back(&p);
+    std::sort(node.by_name.begin(), node.by_name.end(), by_name_less);
+
+    if(substrings)
+    {
+        for(uint32_t i = 0; i < node.by_name.size(); ++i)
+            for(uint32_t off = 0, len = name_length(node.by_name[i]->name);
+                off < len; ++off)
+                node.suffixes.emplace_back(i, off);
+        const std::vector<const Port*> &names = node.by_name;
+        std::sort(node.suffixes.begin(), node.suffixes.end(),
+                  [&names](const std::pair<uint32_t, uint32_t> &lhs,
+                           const std::pair<uint32_t, uint32_t> &rhs) {
+                      return strcmp(names[lhs.first]->name + lhs.second,
+                                    names[rhs.first]->name + rhs.second) < 0;
+                  });
+    }
+
+    // the node reference may be invalidated by inserting children
+    for(const Port &p : ports)
+        if(p.ports)
+            build(*p.ports, substrings);
+}
+
+int PathSearchIndex::search(const Ports &ports, const char *needle,
+                            bool substring, const Port **res,
+                            size_t max) const
+{
+    const auto itr = nodes.find(&ports);
+    if(itr == nodes.end() || (substring && !has_suffixes))
+        return -1;
+    const node_t &node = itr->second;
+    if(!needle)
+        needle = "";
+    const size_t len = strlen(needle);
+
+    size_t found = 0;
+
+    const auto first = std::lower_bound(
+        node.by_name.begin(), node.by_name.end(), needle,
+        [len](const Port *p, const char *needle) {
+            return compare_prefix(p->name, needle, len) < 0;
+        });
+    for(auto i = first; i != node.by_name.end() && found < max &&
+        !compare_prefix((*i)->name, needle, len); ++i)
+        res[found++] = *i;
+
+    if(substring && len && found < max)
+    {
+        typedef std::pair<uint32_t, uint32_t> suffix_t;
+        const std::vector<suffix_t> &suffixes = node.suffixes;
+        auto suffix_less = [&node, len](const suffix_t &s,
+                                        const char *needle) {
+            return compare_prefix(node.by_name[s.first]->name + s.second,
+                                  needle, len) < 0;
+        };
+        const auto sfirst = std::lower_bound(suffixes.begin(),
+                                             suffixes.end(), needle,
+                                             suffix_less);
+        std::vector<suffix_t> matches;
+        for(auto i = sfirst; i != suffixes.end() &&
+            !compare_prefix(node.by_name[i->first]->name + i->second,
+                            needle, len); ++i)
+            matches.push_back(*i);
+
+        // keep the first match of each name, names with a match at
+        // offset 0 have already been stored as prefix matches
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end(),
+                                  [](const suffix_t &l, const suffix_t &r) {
+                                      return l.first == r.first;
+                                  }), matches.end());
+        std::vector<std::pair<uint32_t, uint32_t>> ranked;
+        ranked.reserve(matches.size());
+        for(const suffix_t &m : matches)
+            if(m.second)
+                ranked.emplace_back(m.second, m.first);
+        std::sort(ranked.begin(), ranked.end());
+        for(size_t i = 0; i < ranked.size() && found < max; ++i)
+            res[found++] = node.by_name[ranked[i].second];
+    }
+
+    return (int)found;
+}
+
+namespace {
+
+void add_search_result(const Port &p, char *types, rtosc_arg_t *args,
+                       size_t &pos)
+{
+    types[pos]    = 's';
+    args[pos++].s = p.name;
+    types[pos]    = 'b';
+    if(p.metadata && *p.metadata) {
+        args[pos].b.data = (unsigned char*) p.metadata;
+        args[pos++].b.len = Port::MetaContainer(p.metadata).length();
+    } else {
+        args[pos].b.data = (unsigned char*) NULL;
+        args[pos++].b.len = 0;
+    }
+}
+
+}
+
+void path_search(const PathSearchIndex& index,
+                 const char *str, const char *needle,
+                 char *types, std::size_t max_types,
+                 rtosc_arg_t* args, std::size_t max_args,
+                 bool substring)
+{
+    if(!needle)
+        needle = "";
+
+    // the last char of "types" is being used for a terminating 0
+    const size_t max = std::min(max_types - 1, max_args);
+    size_t       pos = 0;
+
+    memset(types, 0, max + 1);
+    memset(args,  0, max);
+
+    const Ports *ports = nullptr;
+    if(!*str) {
+        ports = &index.root();
+    } else {
+        const Port *port = index.root().apropos(str);
+        if(!port)
+            return;
+        if(!port->ports) {
+            if(port->name && strstr(port->name, needle) == port->name)
+                add_search_result(*port, types, args, pos);
+            return;
+        }
+        ports = port->ports;
+    }
+
+    STACKALLOC(const Port*, found, max / 2 + 1);
+    const int nfound = index.search(*ports, needle, substring,
+                                    found, max / 2);
+    if(nfound >= 0) {
+        for(int i = 0; i < nfound; ++i)
+            add_search_result(*found[i], types, args, pos);
+    } else {
+        // not indexed, do what path_search() does
+        for(const Port &p : *ports)
+            if(p.name && pos + 1 < max &&
+               strstr(p.name, needle) == p.name)
+                add_search_result(p, types, args, pos);
+    }
+}
+
+std::size_t path_search(const PathSearchIndex& index, const char *m,
+                        std::size_t max_ports,
+                        char *msgbuf, std::size_t bufsize)
+{
+    const char *str    = rtosc_argument(m,0).s;
+    const char *needle = rtosc_argument(m,1).s;
+    const bool substring = rtosc_narguments(m) > 2 &&
+                           rtosc_type(m, 2) == 'T';
+    size_t max_args    = max_ports << 1;
+    size_t max_types   = max_args + 1;
+    STACKALLOC(char, types, max_types);
+    STACKALLOC(rtosc_arg_t, args, max_args);
+
+    path_search(index, str, needle, types, max_types, args, max_args,
+                substring);
+    return rtosc_amessage(msgbuf, bufsize, "/paths", types, args);
+}
+
+}
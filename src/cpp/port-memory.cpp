@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <rtosc/port-memory.h>
+
+namespace rtosc {
+
+namespace {
+    std::size_t category_bytes(const Ports::memory_t &m)
+    {
+        return m.ports + m.callbacks + m.strings + m.matcher + m.tables;
+    }
+
+    void add(Ports::memory_t &sum, const Ports::memory_t &m)
+    {
+        sum.ports     += m.ports;
+        sum.callbacks += m.callbacks;
+        sum.strings   += m.strings;
+        sum.matcher   += m.matcher;
+        sum.tables    += m.tables;
+    }
+
+    std::size_t mounts(const Port &port)
+    {
+        const char *hash = strchr(port.name, '#');
+        return hash ? std::max(1, atoi(hash + 1)) : 1;
+    }
+
+    unsigned depth(const std::string &path)
+    {
+        return std::count(path.begin(), path.end(), '/') - 1;
+    }
+
+    //! state of the walk over the Ports objects
+    struct walker_t
+    {
+        PortMemoryReport &report;
+        std::vector<const Ports*> stack;
+        std::unordered_set<const void*> matchers;
+        std::unordered_map<const Ports*, std::size_t> index;
+
+        void walk(const Ports &ports, const std::string &path,
+                  std::size_t instances)
+        {
+            // recursive trees are only walked once per path
+            if(std::find(stack.begin(), stack.end(), &ports) != stack.end())
+                return;
+
+            const auto found = index.emplace(&ports, report.subtrees.size());
+            const bool first = found.second;
+            const std::size_t idx = found.first->second;
+            if(first) {
+                PortMemoryReport::subtree_t s;
+                s.path      = path;
+                s.ports     = &ports;
+                s.self      = ports.memoryUsage();
+                s.instances = 0;
+                s.oversized = s.self.hash_slots >
+                    PortMemoryReport::oversized_hash * ports.size();
+                if(s.self.matcher_id &&
+                   !matchers.insert(s.self.matcher_id).second)
+                    s.self.matcher = 0;
+                s.bytes = category_bytes(s.self);
+                add(report.sum, s.self);
+                report.subtrees.push_back(s);
+            }
+            report.subtrees[idx].instances += instances;
+
+            // shared subtrees are walked again for their instances, but
+            // reported at their first path
+            stack.push_back(&ports);
+            for(const Port &port : ports)
+                if(port.ports)
+                    walk(*port.ports, path + port.name,
+                         instances * mounts(port));
+            stack.pop_back();
+            if(first)
+                report.subtrees[idx].end = report.subtrees.size();
+        }
+    };
+}
+
+constexpr double PortMemoryReport::oversized_hash;
+
+PortMemoryReport::PortMemoryReport(const Ports &root)
+    :sum()
+{
+    walker_t w{*this, {}, {}, {}};
+    w.walk(root, "/", 1);
+
+    // later subtrees are never above earlier ones
+    for(std::size_t i = subtrees.size(); i-- > 0;) {
+        subtrees[i].total = subtrees[i].bytes;
+        for(std::size_t j = i + 1; j < subtrees[i].end; j = subtrees[j].end)
+            subtrees[i].total += subtrees[j].total;
+    }
+}
+
+void PortMemoryReport::print(std::ostream &out, unsigned max_depth,
+                             std::size_t min_bytes) const
+{
+    out << std::setw(10) << "total" << std::setw(10) << "self"
+        << std::setw(10) << "ports" << std::setw(10) << "callbacks"
+        << std::setw(10) << "strings" << std::setw(10) << "matcher"
+        << std::setw(10) << "tables" << std::setw(8) << "inst"
+        << "  path\n";
+    for(const subtree_t &s : subtrees) {
+        if(depth(s.path) > max_depth || s.total < min_bytes)
+            continue;
+        out << std::setw(10) << s.total << std::setw(10) << s.bytes
+            << std::setw(10) << s.self.ports
+            << std::setw(10) << s.self.callbacks
+            << std::setw(10) << s.self.strings
+            << std::setw(10) << s.self.matcher
+            << std::setw(10) << s.self.tables
+            << std::setw(8) << s.instances << "  " << s.path << "\n";
+    }
+
+    std::size_t nports = 0, instances = 0, prepared = 0;
+    for(const subtree_t &s : subtrees) {
+        nports += s.ports->size();
+        instances += s.ports->size() * s.instances;
+        prepared += s.ports->prepared();
+    }
+    out << "\n" << subtrees.size() << " port tables, " << nports
+        << " ports (" << instances << " instances), " << total()
+        << " bytes\n"
+        << "  ports " << sum.ports << ", callbacks " << sum.callbacks
+        << ", strings " << sum.strings << ", matcher " << sum.matcher
+        << ", tables " << sum.tables << "\n";
+    if(prepared != subtrees.size())
+        out << "  " << subtrees.size() - prepared
+            << " tables are not built yet, see Ports::prepare()\n";
+    for(const subtree_t &s : subtrees)
+        if(s.oversized)
+            out << "  oversized hash at " << s.path << ": "
+                << s.self.hash_slots << " slots for " << s.ports->size()
+                << " ports\n";
+}
+
+}
@@ -1,7 +1,9 @@
 #include "../util.h"
+#include <algorithm>
 #include <cstdarg>
 #include <cstring>
 #include <cassert>
+#include <vector>
 
 #include <rtosc/pretty-format.h>
 #include <rtosc/ports.h>
@@ -131,7 +133,10 @@ class Capture : public RtData
         size_t cur_idx = 0;
         for(const char* ptr = args; *ptr; ++ptr, ++cur_idx)
         {
-            assert(cur_idx < max_args);
+            if(cur_idx == max_args) {
+                nargs = -1; // does not fit, see get_values_from_runtime
+                return;
+            }
             arg_vals[cur_idx].type = *ptr;
             arg_vals[cur_idx].val  = vals[cur_idx];
         }
@@ -141,9 +146,10 @@ class Capture : public RtData
     void reply_va(const char *args, va_list va)
     {
         nargs = strlen(args);
-        assert((size_t)nargs <= max_args);
-
-        rtosc_v2argvals(arg_vals, nargs, args, va);
+        if((size_t)nargs > max_args)
+            nargs = -1; // does not fit, see get_values_from_runtime
+        else
+            rtosc_v2argvals(arg_vals, nargs, args, va);
     }
 
     void broadcast(const char *, const char *args, ...) override
@@ -166,8 +172,6 @@ public:
     int size() const { return nargs; }
     Capture(std::size_t max_args, rtosc_arg_val_t* arg_vals) :
         max_args(max_args), arg_vals(arg_vals), nargs(-1) {}
-    //! Silence compiler warnings
-    std::size_t dont_use_this_function() { return max_args; }
 };
 
 size_t get_value_from_runtime(void* runtime, const Port& port,
@@ -203,6 +207,231 @@ size_t get_value_from_runtime(void* runtime, const Port& port,
     return d.size();
 }
 
+//! RtData subclass to capture argument values from a runtime object into
+//! an arena, including their strings
+class CaptureArena : public RtData
+{
+    rtosc_arg_val_arena* arena;
+    int nargs;
+
+    void reply(const char *) override { assert(false); }
+
+    void append(const rtosc_arg_val_t* arg_vals, int n)
+    {
+        nargs = rtosc_arg_val_arena_append(arena, arg_vals, n) ? n : -1;
+    }
+
+    void replyArray(const char*, const char *args,
+                    rtosc_arg_t *vals) override
+    {
+        const int n = strlen(args);
+        STACKALLOC(rtosc_arg_val_t, arg_vals, n);
+        for(int i = 0; i < n; ++i)
+        {
+            arg_vals[i].type = args[i];
+            arg_vals[i].val  = vals[i];
+        }
+        append(arg_vals, n);
+    }
+
+    void reply_va(const char *args, va_list va)
+    {
+        const int n = strlen(args);
+        STACKALLOC(rtosc_arg_val_t, arg_vals, n);
+        rtosc_v2argvals(arg_vals, n, args, va);
+        append(arg_vals, n);
+    }
+
+    void broadcast(const char *, const char *args, ...) override
+    {
+        va_list va;
+        va_start(va, args);
+        reply_va(args, va);
+        va_end(va);
+    }
+
+    void reply(const char *, const char *args, ...) override
+    {
+        va_list va;
+        va_start(va,args);
+        reply_va(args, va);
+        va_end(va);
+    }
+public:
+    //! Return the number of argument values appended, or -1
+    int size() const { return nargs; }
+    explicit CaptureArena(rtosc_arg_val_arena* arena) :
+        arena(arena), nargs(-1) {}
+};
+
+int get_value_from_runtime(void* runtime, const Ports& ports,
+                           size_t loc_size, char* loc,
+                           char* buffer_with_port, std::size_t buffersize,
+                           rtosc_arg_val_arena* arena)
+{
+    std::size_t addr_len = strlen(buffer_with_port);
+
+    CaptureArena d(arena);
+    d.obj = runtime;
+    d.loc_size = loc_size;
+    d.loc = loc;
+    d.matches = 0;
+
+    // does the message at least fit the arguments?
+    assert(buffersize - addr_len >= 8);
+    // append type
+    memset(buffer_with_port + addr_len, 0, 8); // cover string end and arguments
+    buffer_with_port[addr_len + (4-addr_len%4)] = ',';
+
+    d.message = buffer_with_port;
+
+    // buffer_with_port is a message in this call:
+    ports.dispatch(buffer_with_port, d, false);
+
+    return d.size();
+}
+
+void* get_child_runtime(void* runtime, const Port& port, const char* name)
+{
+    RtData r;
+    r.obj = runtime;
+    r.port = &port;
+
+    char buf[1024] = "";
+    fast_strcpy(buf, name, sizeof(buf));
+    // there is no "pointer" callback. thus, there will be nothing
+    // dispatched, but the rRecur*Cb already have set r.obj
+    // that way, we get our pointer
+    strncat(buf, "pointer", sizeof(buf) - strlen(buf) - 1);
+    assert(1024 - strlen(buf) >= 8);
+    fast_strcpy(buf + strlen(buf) + 1, ",", 2);
+
+    port.cb(buf, r);
+    return r.obj;
+}
+
+namespace {
+
+//! Length of the parent path of a query, including the last slash
+std::size_t parent_length(const char* path)
+{
+    const char* last_slash = strrchr(path, '/');
+    return last_slash ? last_slash - path + 1 : 0;
+}
+
+/*
+    Find the Ports and runtime object of the parent path @p dir of length
+    @p len, return false if it does not exist
+*/
+bool resolve_parent(const Ports*& ports, void*& runtime,
+                    const char* dir, std::size_t len)
+{
+    char name[1024];
+    const char* rest = dir;
+    const char* const end = dir + len;
+    if(rest < end && *rest == '/')
+        ++rest;
+    while(rest < end)
+    {
+        const Port* child = nullptr;
+        const char* path_end = nullptr;
+        for(const Port& p : *ports)
+            if(p.ports && strchr(p.name, '/') &&
+               rtosc_match_path(p.name, rest, &path_end))
+            {
+                child = &p;
+                break;
+            }
+        // path_end points behind the child's slash
+        if(!child || path_end > end ||
+           (std::size_t)(path_end - rest) >= sizeof(name))
+            return false;
+
+        memcpy(name, rest, path_end - rest);
+        name[path_end - rest] = 0;
+        runtime = get_child_runtime(runtime, *child, name);
+        if(!runtime)
+            return false;
+        ports = child->ports;
+        rest = path_end;
+    }
+    return true;
+}
+
+}
+
+std::size_t get_values_from_runtime(void* runtime, const Ports& root,
+                                    value_query_t* queries,
+                                    std::size_t nqueries,
+                                    std::size_t max_args,
+                                    rtosc_arg_val_t* arg_vals)
+{
+    std::vector<std::size_t> order(nqueries), parent_len(nqueries);
+    for(std::size_t i = 0; i < nqueries; ++i)
+    {
+        order[i] = i;
+        parent_len[i] = parent_length(queries[i].path);
+        queries[i].offset = 0;
+        queries[i].nargs = -1;
+    }
+    auto parent_cmp = [&](std::size_t l, std::size_t r) {
+        const std::size_t len = std::min(parent_len[l], parent_len[r]);
+        const int cmp = strncmp(queries[l].path, queries[r].path, len);
+        return cmp ? cmp < 0 : parent_len[l] < parent_len[r];
+    };
+    std::stable_sort(order.begin(), order.end(), parent_cmp);
+
+    char loc[1024];
+    char buffer_with_port[1024];
+    std::size_t used = 0;
+    for(std::size_t first = 0, last; first < nqueries; first = last)
+    {
+        // the group of queries with the same parent
+        for(last = first + 1; last < nqueries &&
+            !parent_cmp(order[first], order[last]); ++last) ;
+
+        const char* dir = queries[order[first]].path;
+        const Ports* ports = &root;
+        void* parent_runtime = runtime;
+        if(!resolve_parent(ports, parent_runtime, dir,
+                           parent_len[order[first]]))
+            continue;
+
+        for(std::size_t i = first; i < last; ++i)
+        {
+            value_query_t& q = queries[order[i]];
+            const char* leaf = q.path + parent_len[order[i]];
+            const Port* port = *leaf ? ports->apropos(leaf) : nullptr;
+            if(!port || port->ports || strlen(q.path) >= sizeof(loc) ||
+               strlen(leaf) + 8 >= sizeof(buffer_with_port))
+                continue;
+
+            fast_strcpy(loc, q.path, sizeof(loc));
+            Capture d(max_args - used, arg_vals + used);
+            d.obj = parent_runtime;
+            d.loc_size = sizeof(loc);
+            d.loc = loc;
+            d.port = port;
+            d.matches = 0;
+
+            fast_strcpy(buffer_with_port, leaf, sizeof(buffer_with_port));
+            std::size_t addr_len = strlen(buffer_with_port);
+            memset(buffer_with_port + addr_len, 0, 8);
+            buffer_with_port[addr_len + (4-addr_len%4)] = ',';
+            d.message = buffer_with_port;
+            port->cb(buffer_with_port, d);
+
+            if(d.size() >= 0)
+            {
+                q.offset = used;
+                q.nargs = d.size();
+                used += d.size();
+            }
+        }
+    }
+    return used;
+}
+
 } // namespace helpers
 } // namespace rtosc
 
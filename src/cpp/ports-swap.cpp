@@ -0,0 +1,66 @@
+#include <rtosc/ports-swap.h>
+
+namespace rtosc {
+
+PortsSwap::PortsSwap(Ports *initial)
+    :cur(initial), epoch(0), rt_epoch(0)
+{
+    if(initial)
+        initial->prepare();
+}
+
+PortsSwap::~PortsSwap(void)
+{
+    delete cur.load();
+    for(const retired_t &r : retired)
+        delete r.ports;
+}
+
+void PortsSwap::publish(Ports *ports)
+{
+    if(ports)
+        ports->prepare();
+    Ports *old = cur.exchange(ports, std::memory_order_acq_rel);
+    //the new tree is stored before the epoch, so a realtime thread seeing
+    //the epoch in quiescent() only loads the new tree afterwards
+    const uint64_t e = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if(old)
+        retired.push_back(retired_t{old, e});
+}
+
+std::size_t PortsSwap::reclaim(void)
+{
+    const uint64_t done = rt_epoch.load(std::memory_order_acquire);
+    std::size_t kept = 0;
+    for(const retired_t &r : retired) {
+        if(r.epoch <= done)
+            delete r.ports;
+        else
+            retired[kept++] = r;
+    }
+    retired.resize(kept);
+    return kept;
+}
+
+void PortsSwap::dispatch(const char *m, RtData &d, bool base_dispatch) const
+{
+    if(const Ports *ports = current())
+        ports->dispatch(m, d, base_dispatch);
+}
+
+void PortsSwap::dispatch_cb(const char *m, RtData &d, void *swap)
+{
+    while(*m && *m != '/')
+        ++m;
+    if(*m)
+        ++m;
+    ((const PortsSwap*)swap)->dispatch(m, d);
+}
+
+Port PortsSwap::port(const char *name, const char *metadata) const
+{
+    return Port{name, metadata, nullptr,
+                PortCallback(&PortsSwap::dispatch_cb, (void*)this)};
+}
+
+}
@@ -2,13 +2,25 @@
 #include "../../include/rtosc/ports.h"
 #include "../../include/rtosc/ports-runtime.h"
 #include "../../include/rtosc/bundle-foreach.h"
-
+#include "../../include/rtosc/dispatch-profiler.h"
+#include "../../include/rtosc/rt-checker.h"
+#include "../../include/rtosc/trace.h"
+#include "../../include/rtosc/pretty-format.h"
+#include "../../include/rtosc/osc-doc.h"
+#include "../../include/rtosc/arg-val-cmp.h"
+
+#include <atomic>
 #include <ostream>
+#include <sstream>
 #include <cassert>
 #include <limits>
+#include <climits>
 #include <cstring>
 #include <string>
 #include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
 
 /* Compatibility with non-clang compilers */
 #ifndef __has_feature
@@ -41,25 +53,40 @@ static inline void scat(char *dest, const char *src)
 }
 
 RtData::RtData(void)
-    :loc(NULL), loc_size(0), obj(NULL), matches(0), message(NULL)
+    :loc(NULL), loc_size(0), lazy_loc(false), loc_depth(0), obj(NULL),
+     matches(0), message(NULL), cache(NULL),
+     profiler(NULL), checker(NULL), changes(NULL)
 {
-    for(size_t i=0; i<sizeof(idx)/sizeof(int); ++i)
-        idx[i] = 0;
 }
 
-void RtData::push_index(int ind)
+void RtData::push_loc(const char *str, int len)
 {
-    for(size_t i=1; i<sizeof(idx)/sizeof(int); ++i)
-        idx[i] = idx[i-1];
-    idx[0] = ind;
+    if(loc_depth < max_loc_depth) {
+        loc_stack[loc_depth].str = str;
+        loc_stack[loc_depth].len = len;
+    }
+    ++loc_depth;
 }
 
-void RtData::pop_index(void)
+const char *RtData::location(void) const
 {
-    int n = sizeof(idx)/sizeof(int);
-    for(int i=n-2; i >= 0; --i)
-        idx[i] = idx[i+1];
-    idx[n-1] = 0;
+    if(!lazy_loc || !loc || !loc_size)
+        return loc;
+
+    char *pos = loc;
+    char *end = loc + loc_size - 1;
+    if(pos != end)
+        *pos++ = '/';
+    const int depth = loc_depth < max_loc_depth ? loc_depth : max_loc_depth;
+    for(int i=0; i<depth; ++i) {
+        int len = loc_stack[i].len;
+        if(len > end - pos)
+            len = end - pos;
+        memcpy(pos, loc_stack[i].str, len);
+        pos += len;
+    }
+    *pos = 0;
+    return loc;
 }
 
 void RtData::replyArray(const char *path, const char *args,
@@ -170,8 +197,36 @@ Port::MetaIterator::operator bool(void) const
     return title;
 }
 
-Port::MetaContainer::MetaContainer(const char *str_)
-:str_ptr(str_)
+const char *const Port::meta_key_names[Port::meta_key_count] = {
+    "parameter", "default", "default depends", "enabled by",
+    "min", "max", "scale", "no walk", "internal"
+};
+
+//! @return The well-known key named @p str, or -1
+static int meta_key_of(const char *str)
+{
+    for(int k = 0; k < Port::meta_key_count; ++k)
+        if(!strcmp(Port::meta_key_names[k], str))
+            return k;
+    return -1;
+}
+
+Port::MetaIndex::MetaIndex(const MetaContainer &meta)
+{
+    for(int k = 0; k < meta_key_count; ++k)
+        title[k] = value[k] = NULL;
+    for(const auto x : meta) {
+        //the first occurrence wins, as for MetaContainer::find()
+        const int k = meta_key_of(x.title);
+        if(k >= 0 && !title[k]) {
+            title[k] = x.title;
+            value[k] = x.value;
+        }
+    }
+}
+
+Port::MetaContainer::MetaContainer(const char *str_, const MetaIndex *index_)
+:str_ptr(str_), index(index_)
 {}
 
 Port::MetaIterator Port::MetaContainer::begin(void) const
@@ -189,12 +244,24 @@ Port::MetaIterator Port::MetaContainer::end(void) const
 
 Port::MetaIterator Port::MetaContainer::find(const char *str) const
 {
+    if(index) {
+        const int k = meta_key_of(str);
+        if(k >= 0)
+            return find((meta_key_t)k);
+    }
     for(const auto x : *this)
         if(!strcmp(x.title, str))
             return x;
     return NULL;
 }
 
+Port::MetaIterator Port::MetaContainer::find(meta_key_t key) const
+{
+    if(index)
+        return index->title[key] ? MetaIterator(index->title[key]) : end();
+    return find(meta_key_names[key]);
+}
+
 size_t Port::MetaContainer::length(void) const
 {
         if(!str_ptr || !*str_ptr)
@@ -208,11 +275,21 @@ size_t Port::MetaContainer::length(void) const
 
 const char *Port::MetaContainer::operator[](const char *str) const
 {
+    if(index) {
+        const int k = meta_key_of(str);
+        if(k >= 0)
+            return index->value[k];
+    }
     for(const auto x : *this)
         if(!strcmp(x.title, str))
             return x.value;
     return NULL;
 }
+
+const char *Port::MetaContainer::operator[](meta_key_t key) const
+{
+    return index ? index->value[key] : (*this)[meta_key_names[key]];
+}
 //Match the arg string or fail
 inline bool arg_matcher(const char *pattern, const char *args)
 {
@@ -242,95 +319,508 @@ inline bool scmp(const char *a, const char *b)
     return a[0] == b[0];
 }
 
+template<class T>
+static std::size_t vector_bytes(const std::vector<T> &v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+//! Heap bytes of @p s, 0 if it is stored in the object itself
+static std::size_t string_bytes(const std::string &s)
+{
+    const char *data = s.data();
+    const bool local = data >= (const char*)&s && data < (const char*)(&s+1);
+    return local ? 0 : s.capacity() + 1;
+}
+
 typedef std::vector<std::string>  words_t;
 typedef std::vector<std::string>  svec_t;
-typedef std::vector<const char *> cvec_t;
 typedef std::vector<int> ivec_t;
-typedef std::vector<int> tuple_t;
-typedef std::vector<tuple_t> tvec_t;
 
 namespace rtosc{
+/*
+ * Tables which only depend on the names of the ports. They do not refer to
+ * the ports, so Ports with the same names share one matcher.
+ */
 class Port_Matcher
 {
     public:
-        bool *enump;
+        svec_t names; //!< copies of the port names
+        std::vector<char> enump;
         svec_t fixed;
-        cvec_t arg_spec;
-        ivec_t pos;
-        ivec_t assoc;
-        ivec_t remap;
 
-        bool rtosc_match_args(const char *pattern, const char *msg)
+        /*
+         * Minimal perfect hash over the fixed part of the port names, built
+         * in "hash and displace" style: each key falls into a bucket by its
+         * hash, and each bucket stores a pilot value which moves all its keys
+         * to free slots of the table. The table is empty if there's no hash.
+         */
+        uint64_t seed;
+        ivec_t   pilot; //!< pilot value per bucket
+        ivec_t   remap; //!< slot -> port index, -1 for unused slots
+
+        static uint64_t hash_key(const char *key, unsigned len, uint64_t seed)
+        {
+            uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+            for(unsigned i=0; i<len; ++i)
+                h = (h ^ (uint8_t)key[i]) * 0x100000001b3ULL;
+            //avalanche, so the bucket and the slot bits are independent
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        int slot(uint64_t h, uint32_t pilot_val) const
+        {
+            uint32_t p = pilot_val * 0x9e3779b1U;
+            p ^= p >> 16;
+            return (((uint32_t)(h >> 32)) ^ p) % remap.size();
+        }
+
+        //! @return The port whose fixed name might be @p key, or -1
+        int lookup(const char *key, unsigned len) const
+        {
+            if(remap.empty())
+                return -1;
+            const uint64_t h = hash_key(key, len, seed);
+            return remap[slot(h, pilot[(uint32_t)h % pilot.size()])];
+        }
+
+        //! Serialized table layout, in 32 bit words of host byte order:
+        //! id, #keys, seed (2 words), #buckets, #slots, pilots, slots
+        static const uint32_t table_id = 0x7274ad01;
+
+        std::string save(void) const
+        {
+            if(remap.empty())
+                return "";
+            std::vector<uint32_t> data = {table_id, (uint32_t)fixed.size(),
+                (uint32_t)seed, (uint32_t)(seed >> 32),
+                (uint32_t)pilot.size(), (uint32_t)remap.size()};
+            data.insert(data.end(), pilot.begin(), pilot.end());
+            data.insert(data.end(), remap.begin(), remap.end());
+            return std::string((const char*)data.data(),
+                               data.size()*sizeof(uint32_t));
+        }
+
+        //! Load a table written by save() and check it against the keys
+        bool load(const char *buf, size_t len)
+        {
+            const unsigned n = fixed.size();
+            if(!buf || len < 6*sizeof(uint32_t) || len % sizeof(uint32_t))
+                return false;
+            std::vector<uint32_t> data(len/sizeof(uint32_t));
+            memcpy(data.data(), buf, len);
+            if(data[0] != table_id || data[1] != n || !n || !data[4] ||
+               data[5] < n || data.size() != 6 + data[4] + data[5])
+                return false;
+
+            seed = data[2] | ((uint64_t)data[3] << 32);
+            pilot.assign(data.begin()+6, data.begin()+6+data[4]);
+            remap.assign(data.begin()+6+data[4], data.end());
+            bool valid = true;
+            for(int port:remap)
+                valid &= port >= -1 && port < (int)n;
+            for(unsigned i=0; i<n && valid; ++i)
+                valid = lookup(fixed[i].c_str(), fixed[i].length()) == (int)i;
+            if(!valid) {
+                pilot.clear();
+                remap.clear();
+            }
+            return valid;
+        }
+
+        /*
+         * Argument specs of all ports, compiled from the part of the name
+         * starting at the first ':'. Each spec is a list of alternative type
+         * strings, e.g. "::i:c" allows "", "i" and "c". As in rtosc_match(),
+         * only the last alternative is matched as a prefix, unless empty.
+         */
+        struct arg_alt_t
+        {
+            const char *types;
+            int         len;
+        };
+        struct arg_spec_t
+        {
+            int      first, count; //!< alternatives in arg_alts
+            bool     any;          //!< no spec, i.e. any arguments match
+            bool     prefix_last;
+            uint32_t lengths;      //!< bit n set if an alternative has length n
+        };
+        std::vector<arg_alt_t>  arg_alts;
+        std::vector<arg_spec_t> arg_specs;
+
+        void build_arg_specs(void)
+        {
+            arg_alts.clear();
+            arg_specs.clear();
+            for(const std::string &name : names) {
+                arg_spec_t spec = {(int)arg_alts.size(), 0, true, false, 0};
+                const char *p = strchr(name.c_str(), ':');
+                if(p) {
+                    spec.any = false;
+                    while(*p++ == ':') {
+                        const char *end = p;
+                        while(*end && *end != ':')
+                            ++end;
+                        const int len = end - p;
+                        arg_alts.push_back(arg_alt_t{p, len});
+                        if(!*end && len)
+                            spec.prefix_last = true;
+                        else if(len < 32)
+                            spec.lengths |= 1u << len;
+                        else
+                            spec.lengths = ~0u;
+                        p = end;
+                    }
+                    spec.count = arg_alts.size() - spec.first;
+                }
+                arg_specs.push_back(spec);
+            }
+        }
+
+        bool match_args(int i, const char *msg) const
         {
-            //match anything if no arg restriction is present
-            //(ie the ':')
-            if(*pattern++ != ':')
+            const arg_spec_t &spec = arg_specs[i];
+            if(spec.any)
                 return true;
 
-            const char *arg_str = rtosc_argument_string(msg);
-            bool      arg_match = *pattern || *pattern == *arg_str;
+            const char  *args = rtosc_argument_string(msg);
+            const size_t len  = strlen(args);
+            const int    last = spec.first + spec.count - 1;
+            if((len >= 32 || (spec.lengths >> len) & 1)) {
+                const int exact_end = spec.prefix_last ? last : last + 1;
+                for(int a = spec.first; a < exact_end; ++a)
+                    if(arg_alts[a].len == (int)len &&
+                       !memcmp(arg_alts[a].types, args, len))
+                        return true;
+            }
+            return spec.prefix_last && len >= (size_t)arg_alts[last].len &&
+                   !memcmp(arg_alts[last].types, args, arg_alts[last].len);
+        }
 
-            while(*pattern && *pattern != ':')
-                arg_match &= (*pattern++==*arg_str++);
+        /*
+         * Compiled path patterns of all ports (see rtosc_pattern_compile()),
+         * concatenated. Names which could not be compiled have offset -1.
+         */
+        std::vector<char> path_progs;
+        ivec_t            path_prog_offsets;
 
-            if(*pattern==':') {
-                if(arg_match && !*arg_str)
-                    return true;
-                else
-                    return rtosc_match_args(pattern, msg); //retry
+        void build_path_progs(const std::vector<Port> &ports)
+        {
+            path_progs.clear();
+            path_prog_offsets.assign(ports.size(), -1);
+            for(size_t i = 0; i < ports.size(); ++i) {
+                const size_t offset = path_progs.size();
+                const size_t len = rtosc_pattern_compile(ports[i].name,
+                                                         NULL, 0);
+                if(!len)
+                    continue;
+                path_progs.resize(offset + len);
+                rtosc_pattern_compile(ports[i].name, &path_progs[offset], len);
+                path_prog_offsets[i] = offset;
             }
+        }
 
-            return arg_match;
+        //! rtosc_match() of port @p i using the compiled path and argument
+        //! spec
+        bool match(int i, const char *name, const char *msg,
+                   const char **path_end) const
+        {
+            const int prog = path_prog_offsets[i];
+            const char *args = prog >= 0
+                ? rtosc_pattern_match_path(&path_progs[prog], msg, path_end)
+                : rtosc_match_path(name, msg, path_end);
+            return args && match_args(i, msg);
         }
 
-        bool hard_match(int i, const char *msg)
+        bool hard_match(int i, const char *msg) const
         {
             if(strncmp(msg, fixed[i].c_str(), fixed[i].length()))
                 return false;
-            if(arg_spec[i])
-                return rtosc_match_args(arg_spec[i], msg);
-            else
-                return true;
+            return match_args(i, msg);
         }
-};
 
-}
+        /*
+         * Prefix trie over the literal part of each port name, i.e. the part
+         * in front of the first pattern character ('#', '{', '*' or ':').
+         * It is used if no minimal perfect hash could be found: a port can
+         * only match if its literal part is a prefix of the message, so
+         * walking the message through the trie yields all candidates in
+         * O(path length).
+         */
+        struct trie_node_t
+        {
+            char c;
+            int  child;   //!< first child or -1
+            int  sibling; //!< next sibling or -1
+            int  first;   //!< ports ending here are trie_ports[first, last)
+            int  last;
+        };
+        std::vector<trie_node_t> trie;
+        ivec_t trie_ports;
+        ivec_t trie_min; //!< lowest port index in the subtree of each node
+
+        static bool literal_char(char c)
+        {
+            return c && c != '#' && c != '{' && c != '*' && c != ':';
+        }
+
+        void build_trie(const std::vector<Port> &ports)
+        {
+            std::vector<ivec_t> node_ports(1);
+            trie.assign(1, trie_node_t{0, -1, -1, 0, 0});
+            for(int i=0; i<(int)ports.size(); ++i) {
+                int node = 0;
+                for(const char *c = ports[i].name; literal_char(*c); ++c) {
+                    int next = trie[node].child;
+                    while(next != -1 && trie[next].c != *c)
+                        next = trie[next].sibling;
+                    if(next == -1) {
+                        next = trie.size();
+                        trie.push_back(trie_node_t{*c, -1, trie[node].child,
+                                                   0, 0});
+                        trie[node].child = next;
+                        node_ports.emplace_back();
+                    }
+                    node = next;
+                }
+                node_ports[node].push_back(i);
+            }
+
+            trie_ports.clear();
+            for(unsigned n=0; n<trie.size(); ++n) {
+                trie[n].first = trie_ports.size();
+                trie_ports.insert(trie_ports.end(),
+                                  node_ports[n].begin(), node_ports[n].end());
+                trie[n].last  = trie_ports.size();
+            }
+
+            //children are created after their parents
+            trie_min.assign(trie.size(), INT_MAX);
+            for(int n=trie.size()-1; n >= 0; --n) {
+                if(trie[n].first != trie[n].last)
+                    trie_min[n] = std::min(trie_min[n],
+                                           trie_ports[trie[n].first]);
+                for(int c=trie[n].child; c != -1; c=trie[c].sibling)
+                    trie_min[n] = std::min(trie_min[n], trie_min[c]);
+            }
+        }
+
+        //! Write the indices of all ports that may match @p m into @p res,
+        //! in ascending order. @p res must hold at least one int per port.
+        //! @return The number of candidates
+        int trie_candidates(const char *m, int *res) const
+        {
+            int n = 0;
+            int node = 0;
+            while(true) {
+                //ports of one node are ascending, keep the result sorted
+                for(int i=trie[node].first; i<trie[node].last; ++i) {
+                    int j = n++;
+                    for(; j > 0 && res[j-1] > trie_ports[i]; --j)
+                        res[j] = res[j-1];
+                    res[j] = trie_ports[i];
+                }
+                if(!*m)
+                    break;
+                int next = trie[node].child;
+                while(next != -1 && trie[next].c != *m)
+                    next = trie[next].sibling;
+                if(next == -1)
+                    break;
+                node = next;
+                ++m;
+            }
+            return n;
+        }
+
+        //! @return The lowest index of the ports whose literal part starts
+        //! with @p path, or INT_MAX
+        int trie_prefixed(const char *path) const
+        {
+            int node = 0;
+            for(; *path; ++path) {
+                node = trie[node].child;
+                while(node != -1 && trie[node].c != *path)
+                    node = trie[node].sibling;
+                if(node == -1)
+                    return INT_MAX;
+            }
+            return trie_min[node];
+        }
+
+        /*
+         * Open addressing table from the name of each port up to its first
+         * ':' to the first port of that name. Further ports of the same name
+         * are chained in ascending order through name_next.
+         */
+        ivec_t name_table;
+        ivec_t name_next;
+
+        static unsigned name_len(const char *name)
+        {
+            return strcspn(name, ":");
+        }
+
+        void build_name_index(const std::vector<Port> &ports)
+        {
+            unsigned size = 2;
+            while(size < 2*ports.size())
+                size <<= 1;
+            name_table.assign(size, -1);
+            name_next.assign(ports.size(), -1);
+            std::vector<int> last(size, -1);
+            for(int i=0; i<(int)ports.size(); ++i) {
+                const char *name = ports[i].name;
+                const unsigned len = name_len(name);
+                unsigned slot = hash_key(name, len, 0) & (size-1);
+                for(;; slot = (slot+1) & (size-1)) {
+                    const int p = name_table[slot];
+                    if(p == -1) {
+                        name_table[slot] = last[slot] = i;
+                        break;
+                    }
+                    if(name_len(ports[p].name) == len &&
+                       !strncmp(ports[p].name, name, len)) {
+                        name_next[last[slot]] = i;
+                        last[slot] = i;
+                        break;
+                    }
+                }
+            }
+        }
+
+        //! @return The first port named like @p name up to the first ':',
+        //! continue with name_next, or -1
+        int find_name(const std::vector<Port> &ports, const char *name) const
+        {
+            const unsigned len  = name_len(name);
+            const unsigned mask = name_table.size() - 1;
+            for(unsigned slot = hash_key(name, len, 0) & mask;;
+                slot = (slot+1) & mask) {
+                const int p = name_table[slot];
+                if(p == -1 || (name_len(ports[p].name) == len &&
+                               !strncmp(ports[p].name, name, len)))
+                    return p;
+            }
+        }
 
+        std::size_t bytes(void) const
+        {
+            std::size_t res = sizeof(*this) + vector_bytes(names) +
+                vector_bytes(enump) + vector_bytes(fixed) +
+                vector_bytes(pilot) + vector_bytes(remap) +
+                vector_bytes(arg_alts) + vector_bytes(arg_specs) +
+                vector_bytes(path_progs) + vector_bytes(path_prog_offsets) +
+                vector_bytes(trie) + vector_bytes(trie_ports) +
+                vector_bytes(trie_min) + vector_bytes(name_table) +
+                vector_bytes(name_next);
+            for(const std::string &name : names)
+                res += string_bytes(name);
+            for(const std::string &name : fixed)
+                res += string_bytes(name);
+            return res;
+        }
+};
 
-tvec_t do_hash(const words_t &strs, const ivec_t &pos)
+/*
+ * All tables of one Ports object, built on first use
+ */
+class Port_Tables
 {
-    tvec_t  tvec;
-    for(auto &s:strs) {
-        tuple_t tuple;
-        tuple.push_back(s.length());
-        for(const auto &p:pos)
-            if(p < (int)s.size())
-                tuple.push_back(s[p]);
-        tvec.push_back(std::move(tuple));
-    }
-    return tvec;
-}
+    public:
+        std::shared_ptr<const Port_Matcher> matcher;
+        unsigned elms; //!< number of ports when the tables were built
 
-template<class T>
-int count_dups(std::vector<T> &t)
-{
-    int dups = 0;
-    int N = t.size();
-    STACKALLOC(bool, mark, t.size());
-    memset(mark, 0, N);
-    for(int i=0; i<N; ++i) {
-        if(mark[i])
-            continue;
-        for(int j=i+1; j<N; ++j) {
-            if(t[i] == t[j]) {
-                dups++;
-                mark[j] = true;
+        std::vector<Port::MetaIndex> meta_index;
+
+        void build_meta_index(const std::vector<Port> &ports)
+        {
+            meta_index.clear();
+            meta_index.reserve(ports.size());
+            for(const Port &port : ports)
+                meta_index.emplace_back(port.meta());
+        }
+
+        struct default_t
+        {
+            int first; //!< index into default_args
+            int nargs; //!< -1 if the port has no pre-encoded default
+        };
+        std::vector<default_t>       defaults;
+        std::vector<rtosc_arg_val_t> default_args;
+        //! strings and blobs of default_args, never reallocated
+        std::vector<char>            default_strings;
+
+        //! The default value of @p port if it does not depend on others
+        static const char *plain_default(const Port &port)
+        {
+            if(!port.metadata)
+                return NULL;
+            const Port::MetaContainer meta = port.meta();
+            return meta["default depends"] ? NULL : meta["default"];
+        }
+
+        void build_defaults(const std::vector<Port> &ports)
+        {
+            defaults.assign(ports.size(), default_t{0, -1});
+            default_args.clear();
+            default_strings.clear();
+
+            // scanned strings never need more than their printed text
+            size_t text_size = 0;
+            for(const Port &port : ports) {
+                const char *pretty = plain_default(port);
+                if(pretty)
+                    text_size += strlen(pretty) + 1;
+            }
+            default_strings.resize(text_size);
+
+            size_t used = 0;
+            for(size_t i = 0; i < ports.size(); ++i) {
+                const Port &port = ports[i];
+                const char *pretty = plain_default(port);
+                if(!pretty)
+                    continue;
+                // errors in the metadata are left to get_default_value()
+                const int nargs = rtosc_count_printed_arg_vals(pretty);
+                if(nargs <= 0)
+                    continue;
+                const size_t first = default_args.size();
+                default_args.resize(first + nargs);
+                rtosc_scan_arg_vals(pretty, default_args.data() + first, nargs,
+                                    default_strings.data() + used,
+                                    text_size - used);
+                used += strlen(pretty) + 1;
+
+                const char *port_args = strchr(port.name, ':');
+                if(!port_args)
+                    port_args = port.name + strlen(port.name);
+                if(canonicalize_arg_vals(default_args.data() + first, nargs,
+                                         port_args, port.meta())) {
+                    default_args.resize(first);
+                    continue;
+                }
+                defaults[i] = default_t{(int)first, nargs};
             }
         }
-    }
-    return dups;
+
+        std::size_t bytes(void) const
+        {
+            return sizeof(*this) + vector_bytes(meta_index) +
+                vector_bytes(defaults) + vector_bytes(default_args) +
+                vector_bytes(default_strings);
+        }
+};
+
 }
 
+
 template<class T, class Z>
 bool has(T &t, Z&z)
 {
@@ -340,163 +830,148 @@ bool has(T &t, Z&z)
     return false;
 }
 
-static int int_max(int a, int b) { return a<b?b:a;}
-
-static ivec_t find_pos(words_t &strs)
+/*
+ * Try to place all buckets of keys into @p nslots slots, largest buckets
+ * first. Fails if some bucket does not find a pilot within a bounded number
+ * of attempts, in which case the caller retries with another seed.
+ */
+static bool place_buckets(const words_t &keys, Port_Matcher &pm,
+                          unsigned nslots, uint64_t seed)
 {
-    ivec_t pos;
-    int current_dups = strs.size();
-    int N = 0;
-    for(auto w:strs)
-        N = int_max(N,w.length());
-
-    int pos_best = -1;
-    int pos_best_val = std::numeric_limits<int>::max();
-    while(true)
-    {
-        for(int i=0; i<N; ++i) {
-            ivec_t npos = pos;
-            if(has(pos, i))
-                continue;
-            npos.push_back(i);
-            auto hashed = do_hash(strs, npos);
-            int d = count_dups(hashed);
-            if(d < pos_best_val) {
-                pos_best_val = d;
-                pos_best = i;
-            }
-        }
-        if(pos_best_val >= current_dups)
-            break;
-        current_dups = pos_best_val;
-        pos.push_back(pos_best);
-    }
-    auto hashed = do_hash(strs, pos);
-    int d = count_dups(hashed);
-    //printf("Total Dups: %d\n", d);
-    if(d != 0)
-        pos.clear();
-    return pos;
-}
-
-static ivec_t do_hash(const words_t &strs, const ivec_t &pos, const ivec_t &assoc)
-{
-    ivec_t ivec;
-    ivec.reserve(strs.size());
-    for(auto &s:strs) {
-        int t = s.length();
-        for(auto p:pos)
-            if(p < (int)s.size())
-                t += assoc[s[p]];
-        ivec.push_back(t);
+    const unsigned n        = keys.size();
+    const unsigned nbuckets = (n+3)/4;
+    const int      max_pilot = 1024 + 16*nslots;
+
+    pm.seed = seed;
+    pm.pilot.assign(nbuckets, 0);
+    pm.remap.assign(nslots, -1);
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<ivec_t>   buckets(nbuckets);
+    for(unsigned i=0; i<n; ++i) {
+        hashes[i] = Port_Matcher::hash_key(keys[i].c_str(), keys[i].length(),
+                                           seed);
+        buckets[(uint32_t)hashes[i] % nbuckets].push_back(i);
     }
-    return ivec;
-}
-
-static ivec_t find_assoc(const words_t &strs, const ivec_t &pos)
-{
-    ivec_t assoc;
-    int current_dups = strs.size();
-    int N = 127;
-    std::vector<char> useful_chars;
-    for(auto w:strs)
-        for(auto c:w)
-            if(!has(useful_chars, c))
-                useful_chars.push_back(c);
 
-    for(int i=0; i<N; ++i)
-        assoc.push_back(0);
+    ivec_t order(nbuckets);
+    for(unsigned i=0; i<nbuckets; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&buckets](int a, int b) {
+            return buckets[a].size() > buckets[b].size();});
 
-    int assoc_best = -1;
-    int assoc_best_val = std::numeric_limits<int>::max();;
-    for(int k=0; k<4; ++k)
-    {
-        for(int i:useful_chars) {
-            assoc_best_val = std::numeric_limits<int>::max();
-            for(int j=0; j<100; ++j) {
-                //printf(".");
-                assoc[i] = j;
-                auto hashed = do_hash(strs, pos, assoc);
-                //for(int i=0; i<hashed.size(); ++i)
-                //    printf("%d ", hashed[i]);
-                //printf("\n");
-                int d = count_dups(hashed);
-                //printf("dup %d\n",d);
-                if(d < assoc_best_val) {
-                    assoc_best_val = d;
-                    assoc_best = j;
+    ivec_t slots;
+    for(int b:order) {
+        const ivec_t &bucket = buckets[b];
+        if(bucket.empty())
+            break;
+        int p = 0;
+        for(; p<max_pilot; ++p) {
+            bool free = true;
+            slots.clear();
+            for(int k:bucket) {
+                int s = pm.slot(hashes[k], p);
+                if(pm.remap[s] != -1 || has(slots, s)) {
+                    free = false;
+                    break;
                 }
+                slots.push_back(s);
             }
-            assoc[i] = assoc_best;
+            if(free)
+                break;
         }
-        if(assoc_best_val >= current_dups)
-            break;
-        current_dups = assoc_best_val;
+        if(p == max_pilot)
+            return false;
+        pm.pilot[b] = p;
+        for(unsigned i=0; i<bucket.size(); ++i)
+            pm.remap[slots[i]] = bucket[i];
     }
-    auto hashed = do_hash(strs, pos, assoc);
-    //int d = count_dups(hashed);
-    //printf("Total Dups Assoc: %d\n", d);
-    return assoc;
-}
-
-static ivec_t find_remap(words_t &strs, ivec_t &pos, ivec_t &assoc)
-{
-    ivec_t remap;
-    auto hashed = do_hash(strs, pos, assoc);
-    //for(int i=0; i<strs.size(); ++i)
-    //    printf("%d) '%s'\n", hashed[i], strs[i].c_str());
-    int N = 0;
-    for(auto h:hashed)
-        N = int_max(N,h+1);
-    for(int i=0; i<N; ++i)
-        remap.push_back(0);
-    for(int i=0; i<(int)hashed.size(); ++i)
-        remap[hashed[i]] = i;
-
-    return remap;
+    return true;
 }
 
-static void generate_minimal_hash(std::vector<std::string> str, Port_Matcher &pm)
+static void generate_minimal_hash(const words_t &keys, Port_Matcher &pm)
 {
-    if(str.empty())
+    if(keys.empty())
         return;
-    pm.pos   = find_pos(str);
-    if(pm.pos.empty()) {
-        fprintf(stderr, "rtosc: Failed to generate minimal hash\n");
+
+    //identical keys can not be told apart, dispatch will use the prefix trie
+    words_t sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    if(std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
         return;
-    }
-    pm.assoc = find_assoc(str, pm.pos);
-    pm.remap = find_remap(str, pm.pos, pm.assoc);
+
+    //Each failure changes the hash, and every few failures the table grows,
+    //so this terminates for any set of distinct keys
+    unsigned nslots = keys.size();
+    uint64_t seed   = 0;
+    while(!place_buckets(keys, pm, nslots, seed))
+        if(++seed % 4 == 0)
+            nslots += nslots/8 + 1;
 }
 
-static void generate_minimal_hash(Ports &p, Port_Matcher &pm)
+static void generate_minimal_hash(Port_Matcher &pm,
+                                  const char *magic, size_t magic_len)
 {
     svec_t keys;
-    cvec_t args;
 
     bool enump = false;
-    for(unsigned i=0; i<p.ports.size(); ++i)
-        if(strchr(p.ports[i].name, '#'))
+    for(unsigned i=0; i<pm.names.size(); ++i)
+        if(pm.enump[i])
             enump = true;
     if(enump)
         return;
-    for(unsigned i=0; i<p.ports.size(); ++i)
+    for(unsigned i=0; i<pm.names.size(); ++i)
     {
-        std::string tmp = p.ports[i].name;
-        const char *arg = NULL;
+        std::string tmp = pm.names[i];
         int idx = tmp.find(':');
-        if(idx > 0) {
-            arg = p.ports[i].name+idx;
+        if(idx > 0)
             tmp = tmp.substr(0,idx);
-        }
         keys.push_back(tmp);
-        args.push_back(arg);
+    }
+    pm.fixed = keys;
+
+    if(!pm.load(magic, magic_len))
+        generate_minimal_hash(keys, pm);
+}
+
+namespace {
+    /*
+     * Matchers of all name sets in use, by the names, separated by '\0'.
+     * Building any tables locks the mutex, too. The registry is never
+     * destroyed, since static Ports may be used after static destruction.
+     */
+    struct matcher_registry_t
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string,
+                           std::weak_ptr<const Port_Matcher>> matchers;
+        std::size_t sweep_at = 64; //!< size at which expired ones are erased
+    };
 
+    matcher_registry_t &matcher_registry(void)
+    {
+        static matcher_registry_t *registry = new matcher_registry_t;
+        return *registry;
     }
-    pm.fixed    = keys;
-    pm.arg_spec = args;
 
-    generate_minimal_hash(keys, pm);
+    std::shared_ptr<const Port_Matcher> make_matcher(
+        const std::vector<Port> &ports, const std::string &magic)
+    {
+        std::shared_ptr<Port_Matcher> pm = std::make_shared<Port_Matcher>();
+        pm->names.reserve(ports.size());
+        for(const Port &port : ports)
+            pm->names.emplace_back(port.name);
+        pm->enump.resize(ports.size());
+        for(int i=0; i<(int)ports.size(); ++i)
+            pm->enump[i] = strchr(ports[i].name, '#') != NULL;
+        generate_minimal_hash(*pm, magic.empty() ? NULL : magic.data(),
+                              magic.size());
+        pm->build_trie(ports);
+        pm->build_arg_specs();
+        pm->build_path_progs(ports);
+        pm->build_name_index(ports);
+        return pm;
+    }
 }
 
 Ports::Ports(std::initializer_list<Port> l)
@@ -505,23 +980,144 @@ Ports::Ports(std::initializer_list<Port> l)
     refreshMagic();
 }
 
+Ports::Ports(std::initializer_list<Port> l, const char *magic,
+             size_t magic_len)
+    :ports(l), impl(NULL)
+{
+    refreshMagic(magic, magic_len);
+}
+
 Ports::~Ports()
 {
-    delete []impl->enump;
-    delete impl;
+    delete impl.load();
 }
 
 #if !defined(__GNUC__)
 #define __builtin_expect(a,b) a
 #endif
 
+const Port_Tables &Ports::tables(void) const
+{
+    const Port_Tables *t = impl.load(std::memory_order_acquire);
+    return __builtin_expect(t != NULL, 1) ? *t : build_tables();
+}
+
+const Port_Tables &Ports::build_tables(void) const
+{
+    //e.g. a checked callback which dispatches into another tree
+    RtChecker::note("Ports::build_tables");
+    matcher_registry_t &registry = matcher_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if(const Port_Tables *t = impl.load(std::memory_order_acquire))
+        return *t; // built by another thread meanwhile
+
+    std::string key;
+    for(const Port &port : ports)
+        key.append(port.name).push_back('\0');
+    std::weak_ptr<const Port_Matcher> &shared = registry.matchers[key];
+
+    Port_Tables *t = new Port_Tables;
+    t->matcher = shared.lock();
+    if(!t->matcher) {
+        t->matcher = make_matcher(ports, pending_magic);
+        shared = t->matcher;
+        if(registry.matchers.size() >= registry.sweep_at) {
+            for(auto itr = registry.matchers.begin();
+                itr != registry.matchers.end();)
+                itr = itr->second.expired() ? registry.matchers.erase(itr)
+                                            : std::next(itr);
+            registry.sweep_at = 2 * registry.matchers.size() + 64;
+        }
+    }
+    t->elms = ports.size();
+    t->build_meta_index(ports);
+    t->build_defaults(ports);
+    impl.store(t, std::memory_order_release);
+    return *t;
+}
+
+bool Ports::prepared(void) const
+{
+    return impl.load(std::memory_order_acquire) != NULL;
+}
+
+Ports::memory_t Ports::memoryUsage(void) const
+{
+    memory_t res = memory_t();
+    res.ports = sizeof(*this) + vector_bytes(ports) +
+                string_bytes(pending_magic);
+    for(const Port &port : ports) {
+        res.callbacks += port.cb.heap_size();
+        res.strings += strlen(port.name) + 1 +
+                       Port::MetaContainer(port.metadata).length();
+    }
+    if(const Port_Tables *t = impl.load(std::memory_order_acquire)) {
+        res.tables        = t->bytes();
+        res.matcher       = t->matcher->bytes();
+        res.hash_slots    = t->matcher->remap.size();
+        res.matcher_id    = t->matcher.get();
+        res.matcher_users = t->matcher.use_count();
+    }
+    return res;
+}
+
+void Ports::prepare(void) const
+{
+    //subtrees can be shared or even recursive, so each is visited once
+    std::vector<const Ports*> todo = {this}, seen;
+    while(!todo.empty()) {
+        const Ports *p = todo.back();
+        todo.pop_back();
+        if(std::find(seen.begin(), seen.end(), p) != seen.end())
+            continue;
+        seen.push_back(p);
+        p->tables();
+        for(const Port &port : p->ports)
+            if(port.ports)
+                todo.push_back(port.ports);
+    }
+}
+
+static void call_leaf_port(const Port &port, const char *m, RtData &d)
+{
+    const bool traced = trace::active();
+    if(traced)
+        trace::begin("dispatch", port.name);
+    if(d.checker)
+        d.checker->call(port, m, d);
+    else if(d.profiler)
+        d.profiler->call(port, m, d);
+    else
+        port.cb(m, d);
+    if(traced)
+        trace::end("dispatch", port.name);
+}
+
+static inline void call_port(const Port &port, const char *m, RtData &d)
+{
+    if(__builtin_expect((d.profiler || d.checker ||
+                         trace::enabled.load(std::memory_order_relaxed)) &&
+                        !port.ports, 0))
+        call_leaf_port(port, m, d);
+    else
+        port.cb(m, d);
+}
+
 void Ports::dispatch(const char *m, rtosc::RtData &d, bool base_dispatch) const
 {
     // rRecur*Cb have already set d.loc to the required pointer
     // in case no port will match, d.loc will not be touched
     // this enables returning the address of a runtime object
 
+    //building the tables allocates, which the checked thread must not do
+    if(__builtin_expect(d.checker != NULL, 0) && !prepared())
+        d.checker->report("Ports::build_tables",
+                          base_dispatch ? NULL : d.port,
+                          base_dispatch || !d.message ? m : d.message);
+
     void *obj = d.obj;
+    const Port_Tables &t = tables();
+    const Port_Matcher *impl = t.matcher.get();
 
     //handle the first dispatch layer
     if(base_dispatch) {
@@ -535,34 +1131,55 @@ void Ports::dispatch(const char *m, rtosc::RtData &d, bool base_dispatch) const
 
     //simple case
     if(!d.loc || !d.loc_size) {
-        for(const Port &port: ports) {
-            if(rtosc_match(port.name,m, NULL))
-                d.port = &port, port.cb(m,d), d.obj = obj;
+        STACKALLOC(int, candidates, t.elms+1);
+        const int ncandidates = impl->trie_candidates(m, candidates);
+        for(int c=0; c<ncandidates; ++c) {
+            const Port &port = ports[candidates[c]];
+            if(!impl->match(candidates[c], port.name, m, NULL))
+                continue;
+            d.port = &port;
+            if(d.cache && !port.ports)
+                d.cache->record(&port, m, d);
+            call_port(port, m, d), d.obj = obj;
         }
     } else {
 
-        //TODO this function is certainly buggy at the moment, some tests
-        //are needed to make it clean
-        //XXX buffer_size is not properly handled yet
-        if(__builtin_expect(d.loc[0] == 0, 0)) {
-            memset(d.loc, 0, d.loc_size);
-            d.loc[0] = '/';
-        }
-
+        //a lazy location is only recorded, location() writes it to d.loc
+        const bool lazy = d.lazy_loc;
         char *old_end = d.loc;
-        while(*old_end) ++old_end;
+        if(lazy) {
+            if(base_dispatch)
+                d.loc_depth = 0;
+        } else {
+            //TODO this function is certainly buggy at the moment, some tests
+            //are needed to make it clean
+            //XXX buffer_size is not properly handled yet
+            if(__builtin_expect(d.loc[0] == 0, 0)) {
+                memset(d.loc, 0, d.loc_size);
+                d.loc[0] = '/';
+            }
 
-        if(impl->pos.empty()) { //No perfect minimal hash function
-            for(unsigned i=0; i<elms; ++i) {
-                const Port &port = ports[i];
+            while(*old_end) ++old_end;
+        }
+
+        if(impl->remap.empty()) { //No perfect minimal hash function
+            STACKALLOC(int, candidates, t.elms+1);
+            const int ncandidates = impl->trie_candidates(m, candidates);
+            for(int c=0; c<ncandidates; ++c) {
+                const Port &port = ports[candidates[c]];
                 const char* m_end;
-                if(!rtosc_match(port.name, m, &m_end))
+                if(!impl->match(candidates[c], port.name, m, &m_end))
                     continue;
                 if(!port.ports)
                     d.matches++;
 
                 //Append the path
-                if(strchr(port.name,'#')) {
+                if(lazy) {
+                    if(strchr(port.name,'#'))
+                        d.push_loc(m, m_end - m);
+                    else
+                        d.push_loc(port.name, strcspn(port.name, ":"));
+                } else if(strchr(port.name,'#')) {
                     const char *msg = m;
                     char       *pos = old_end;
                     while(*msg && msg != m_end)
@@ -572,13 +1189,19 @@ void Ports::dispatch(const char *m, rtosc::RtData &d, bool base_dispatch) const
                     scat(d.loc, port.name);
 
                 d.port = &port;
+                if(d.cache && !port.ports)
+                    d.cache->record(&port, m, d);
 
                 //Apply callback
-                port.cb(m,d), d.obj = obj;
+                call_port(port, m, d), d.obj = obj;
 
                 //Remove the rest of the path
-                char *tmp = old_end;
-                while(*tmp) *tmp++=0;
+                if(lazy)
+                    d.pop_loc();
+                else {
+                    char *tmp = old_end;
+                    while(*tmp) *tmp++=0;
+                }
             }
         } else {
 
@@ -593,28 +1216,20 @@ void Ports::dispatch(const char *m, rtosc::RtData &d, bool base_dispatch) const
             len = tmp-m;
 
             //Compute the hash
-            int t = len;
-            for(auto p:impl->pos)
-                if(p < (int)len)
-                    t += impl->assoc[m[p]];
-            if(t >= (int)impl->remap.size() && !default_handler)
-                return;
-            else if(t >= (int)impl->remap.size() && default_handler) {
-                d.matches++;
-                default_handler(m,d), d.obj = obj;
-                return;
-            }
-
-            int port_num = impl->remap[t];
+            const int port_num = impl->lookup(m, len);
 
             //Verify the chosen port is correct
-            if(__builtin_expect(impl->hard_match(port_num, m), 1)) {
-                const Port &port = ports[impl->remap[t]];
+            if(__builtin_expect(port_num >= 0 &&
+                                impl->hard_match(port_num, m), 1)) {
+                const Port &port = ports[port_num];
                 if(!port.ports)
                     d.matches++;
 
                 //Append the path
-                if(impl->enump[port_num]) {
+                if(lazy)
+                    d.push_loc(impl->fixed[port_num].c_str(),
+                               impl->fixed[port_num].length());
+                else if(impl->enump[port_num]) {
                     const char *msg = m;
                     char       *pos = old_end;
                     while(*msg && *msg != '/')
@@ -627,20 +1242,87 @@ void Ports::dispatch(const char *m, rtosc::RtData &d, bool base_dispatch) const
                             impl->fixed[port_num].length()+1);
 
                 d.port = &port;
+                if(d.cache && !port.ports)
+                    d.cache->record(&port, m, d);
 
                 //Apply callback
-                port.cb(m,d), d.obj = obj;
+                call_port(port, m, d), d.obj = obj;
 
                 //Remove the rest of the path
-                old_end[0] = '\0';
+                if(lazy)
+                    d.pop_loc();
+                else
+                    old_end[0] = '\0';
             } else if(default_handler) {
                 d.matches++;
+                if(d.cache)
+                    d.cache->record(NULL, m, d);
                 default_handler(m,d), d.obj = obj;
             }
         }
     }
 }
 
+//Prepare d for several base dispatches
+static void prepare_batch(RtData &d)
+{
+    if(d.loc && d.loc_size) {
+        memset(d.loc, 0, d.loc_size);
+        d.loc[0] = '/';
+    }
+}
+
+//Base dispatch of one message after prepare_batch()
+static int dispatch_prepared(const Ports &p, const char *m, RtData &d)
+{
+    d.matches = 0;
+    d.message = m;
+    d.loc_depth = 0;
+    if(d.loc && d.loc_size > 1) //previous dispatches clean up behind them
+        d.loc[0] = '/', d.loc[1] = 0;
+    p.dispatch(*m == '/' ? m+1 : m, d);
+    return d.matches;
+}
+
+static int dispatch_bundle_prepared(const Ports &p, const char *bundle,
+                                    size_t len, RtData &d)
+{
+    //"#bundle\0", time tag, then each element prefixed by its length
+    int matches = 0;
+    const char *pos = bundle + 16;
+    const char *end = bundle + len;
+    while(pos + 4 <= end) {
+        const uint8_t *size_ptr = (const uint8_t*)pos;
+        const size_t size = (size_ptr[0] << 24) | (size_ptr[1] << 16) |
+                            (size_ptr[2] << 8)  |  size_ptr[3];
+        pos += 4;
+        if(!size || pos + size > end)
+            break;
+        if(rtosc_bundle_p(pos))
+            matches += dispatch_bundle_prepared(p, pos, size, d);
+        else
+            matches += dispatch_prepared(p, pos, d);
+        pos += size;
+    }
+    return matches;
+}
+
+void Ports::dispatch_batch(const char *const *msgs, size_t n,
+                           RtData &d) const
+{
+    int matches = 0;
+    prepare_batch(d);
+    for(size_t i=0; i<n; ++i)
+        matches += dispatch_prepared(*this, msgs[i], d);
+    d.matches = matches;
+}
+
+void Ports::dispatch_bundle(const char *bundle, size_t len, RtData &d) const
+{
+    prepare_batch(d);
+    d.matches = dispatch_bundle_prepared(*this, bundle, len, d);
+}
+
 int rtosc::canonicalize_arg_vals(rtosc_arg_val_t* av, size_t n,
                                  const char* port_args,
                                  Port::MetaContainer meta)
@@ -731,17 +1413,27 @@ void rtosc::map_arg_vals(rtosc_arg_val_t* av, size_t n,
  * Miscellaneous
  */
 
+static bool name_matches(const char *needle, const char *haystack)
+{
+    while(*needle && *needle==*haystack)needle++,haystack++;
+    return *needle == 0 && (*haystack == ':' || *haystack == '\0');
+}
+
 const Port *Ports::operator[](const char *name) const
 {
-    for(const Port &port:ports) {
-        const char *_needle = name,
-              *_haystack = port.name;
-        while(*_needle && *_needle==*_haystack)_needle++,_haystack++;
+    const Port_Matcher *impl = tables().matcher.get();
+    //the index is stale if ports has been changed without refreshMagic()
+    if(impl->name_next.size() == ports.size()) {
+        for(int i = impl->find_name(ports, name); i != -1;
+            i = impl->name_next[i])
+            if(name_matches(name, ports[i].name))
+                return &ports[i];
+        return NULL;
+    }
 
-        if(*_needle == 0 && (*_haystack == ':' || *_haystack == '\0')) {
+    for(const Port &port:ports)
+        if(name_matches(name, port.name))
             return &port;
-        }
-    }
     return NULL;
 }
 
@@ -750,6 +1442,39 @@ const Port *Ports::apropos(const char *path) const
     if(path && path[0] == '/')
         ++path;
 
+    const Port_Tables &t = tables();
+    const Port_Matcher *impl = t.matcher.get();
+    if(t.elms != ports.size() || !path)
+        return apropos_linear(path);
+
+    //only ports whose literal part is a prefix of path can match it
+    STACKALLOC(int, candidates, t.elms+1);
+    const int ncandidates = impl->trie_candidates(path, candidates);
+
+    const char* path_end;
+    for(int c=0; c<ncandidates; ++c) {
+        const Port &port = ports[candidates[c]];
+        if(strchr(port.name,'/') && rtosc_match_path(port.name,path, &path_end))
+            return (port.ports && strchr(path,'/')[1])
+                ? port.ports->apropos(path_end)
+                : &port;
+    }
+
+    //This is the lowest level, now find the best port
+    if(!*path)
+        return NULL;
+    int best = impl->trie_prefixed(path);
+    for(int c=0; c<ncandidates && candidates[c] < best; ++c) {
+        const Port &port = ports[candidates[c]];
+        if(strstr(port.name, path)==port.name ||
+           rtosc_match_path(port.name, path, NULL))
+            best = candidates[c];
+    }
+    return best == INT_MAX ? NULL : &ports[best];
+}
+
+const Port *Ports::apropos_linear(const char *path) const
+{
     const char* path_end;
     for(const Port &port: ports)
         if(strchr(port.name,'/') && rtosc_match_path(port.name,path, &path_end))
@@ -831,27 +1556,256 @@ char *Ports::collapsePath(char *p)
     return write_pos+1;
 };
 
-void Ports::refreshMagic()
+std::string Ports::saveMagic(void) const
 {
-    delete impl;
-    impl = new Port_Matcher;
-    generate_minimal_hash(*this, *impl);
-    impl->enump = new bool[ports.size()];
-    for(int i=0; i<(int)ports.size(); ++i)
-        impl->enump[i] = strchr(ports[i].name, '#');
-
-    elms = ports.size();
+    return tables().matcher->save();
 }
 
-ClonePorts::ClonePorts(const Ports &ports_,
-        std::initializer_list<ClonePort> c)
+//! Increased by each refreshMagic(), which invalidates all DispatchCaches
+static std::atomic<unsigned long> magic_generation(0);
+
+unsigned long Ports::magicGeneration(void)
+{
+    return magic_generation;
+}
+
+void Ports::refreshMagic(const char *magic, size_t magic_len)
+{
+    ++magic_generation;
+    delete impl.exchange(NULL);
+    if(magic)
+        pending_magic.assign(magic, magic_len);
+    else
+        pending_magic.clear();
+}
+
+Port::MetaContainer Ports::meta(const Port &p) const
+{
+    if(ports.empty())
+        return p.meta();
+    const Port_Tables *impl = &tables();
+    // the index is stale if ports has been changed without refreshMagic()
+    if(impl->meta_index.size() != ports.size())
+        return p.meta();
+    const std::less<const Port*> less;
+    if(less(&p, ports.data()) || !less(&p, ports.data() + ports.size()))
+        return p.meta();
+    const Port::MetaContainer meta = p.meta();
+    return Port::MetaContainer(meta.str_ptr,
+                               &impl->meta_index[&p - ports.data()]);
+}
+
+int Ports::encodedDefault(const Port &p, const rtosc_arg_val_t **args) const
+{
+    if(ports.empty())
+        return -1;
+    const Port_Tables *impl = &tables();
+    // the index is stale if ports has been changed without refreshMagic()
+    if(impl->defaults.size() != ports.size())
+        return -1;
+    const std::less<const Port*> less;
+    if(less(&p, ports.data()) || !less(&p, ports.data() + ports.size()))
+        return -1;
+    const Port_Tables::default_t &d = impl->defaults[&p - ports.data()];
+    if(d.nargs >= 0)
+        *args = impl->default_args.data() + d.first;
+    return d.nargs;
+}
+
+struct DispatchCache::entry_t
+{
+    struct leaf_t
+    {
+        const Port *port;
+        void       *obj;
+        int         idx[IndexStack::default_depth]; //!< outermost first
+        int         nidx;   //!< indices pushed since the base dispatch
+        unsigned    offset; //!< of the leaf's message in the full message
+        char        loc[max_loc];
+    };
+
+    bool        used;
+    bool        has_loc;
+    bool        valid;   //!< false if the recording can not be cached
+    const char *message; //!< message being recorded
+    unsigned    addr_len;
+    int         idx_base; //!< depth of the index stack when recording
+    unsigned    keylen;
+    char        key[max_key]; //!< address, '\0', argument types, '\0'
+    int         nleaves;
+    leaf_t      leaves[max_leaves];
+};
+
+DispatchCache::DispatchCache(unsigned n)
+    :hits(0), misses(0), recording(NULL), mask(1),
+     generation(magic_generation)
+{
+    while(mask < n)
+        mask <<= 1;
+    entries = new entry_t[mask];
+    mask -= 1;
+    invalidate();
+}
+
+DispatchCache::~DispatchCache(void)
+{
+    delete [] entries;
+}
+
+void DispatchCache::invalidate(void)
+{
+    for(unsigned i=0; i<=mask; ++i)
+        entries[i].used = false;
+}
+
+void DispatchCache::invalidate(const char *prefix)
+{
+    const size_t len = strlen(prefix);
+    for(unsigned i=0; i<=mask; ++i)
+        if(!strncmp(entries[i].key, prefix, len))
+            entries[i].used = false;
+}
+
+void DispatchCache::record(const Port *port, const char *m, const RtData &d)
+{
+    entry_t *e = recording;
+    if(!e || !e->valid)
+        return;
+    //default handlers, too many leaves or messages which are not part of
+    //the original one can not be replayed
+    if(!port || e->nleaves == max_leaves || d.message != e->message ||
+       m < e->message || m > e->message + e->addr_len) {
+        e->valid = false;
+        return;
+    }
+
+    entry_t::leaf_t &leaf = e->leaves[e->nleaves++];
+    leaf.port   = port;
+    leaf.obj    = d.obj;
+    leaf.offset = m - e->message;
+    leaf.nidx   = d.idx.size() - e->idx_base;
+    if(leaf.nidx < 0 || leaf.nidx > IndexStack::default_depth) {
+        e->valid = false;
+        return;
+    }
+    for(int i=0; i<leaf.nidx; ++i)
+        leaf.idx[i] = d.idx[leaf.nidx-1-i];
+    leaf.loc[0] = 0;
+    if(d.loc && d.loc_size) {
+        const char  *loc = d.location();
+        const size_t len = strlen(loc);
+        if(len >= max_loc)
+            e->valid = false;
+        else
+            memcpy(leaf.loc, loc, len+1);
+    }
+}
+
+void DispatchCache::dispatch(const Ports &root, const char *m, RtData &d)
+{
+    if(generation != magic_generation) {
+        generation = magic_generation;
+        invalidate();
+    }
+
+    const bool   with_loc = d.loc && d.loc_size;
+    const size_t addr_len = strlen(m);
+    const char  *args     = rtosc_argument_string(m);
+    const size_t args_len = strlen(args);
+    if(addr_len + args_len + 2 > max_key) {
+        root.dispatch(m, d, true);
+        return;
+    }
+
+    char key[max_key];
+    memcpy(key, m, addr_len+1);
+    memcpy(key+addr_len+1, args, args_len+1);
+    const unsigned keylen = addr_len + args_len + 2;
+    entry_t &e = entries[Port_Matcher::hash_key(key, keylen, 0) & mask];
+
+    if(e.used && e.keylen == keylen && !memcmp(e.key, key, keylen) &&
+       (e.has_loc || !with_loc)) {
+        ++hits;
+        void *obj = d.obj;
+        d.matches = 0;
+        d.message = m;
+        for(int i=0; i<e.nleaves; ++i) {
+            const entry_t::leaf_t &leaf = e.leaves[i];
+            d.obj  = leaf.obj;
+            d.port = leaf.port;
+            for(int j=0; j<leaf.nidx; ++j)
+                d.idx.push(leaf.idx[j]);
+            if(with_loc) {
+                if(d.lazy_loc) {
+                    d.loc_depth = 0;
+                    d.push_loc(leaf.loc+1, strlen(leaf.loc+1));
+                } else
+                    fast_strcpy(d.loc, leaf.loc, d.loc_size);
+                d.matches++;
+            }
+            call_port(*leaf.port, m + leaf.offset, d);
+            for(int j=0; j<leaf.nidx; ++j)
+                d.idx.pop();
+        }
+        d.obj = obj;
+        if(with_loc && d.lazy_loc)
+            d.loc_depth = 0;
+        else if(with_loc)
+            d.loc[d.loc_size > 1] = 0;
+        return;
+    }
+
+    ++misses;
+    e.used     = false;
+    e.valid    = true;
+    e.has_loc  = with_loc;
+    e.message  = m;
+    e.addr_len = addr_len;
+    e.idx_base = d.idx.size();
+    e.nleaves  = 0;
+    recording  = &e;
+
+    DispatchCache *outer = d.cache;
+    d.cache = this;
+    root.dispatch(m, d, true);
+    d.cache = outer;
+    recording = NULL;
+
+    if(e.valid && e.nleaves) {
+        memcpy(e.key, key, keylen);
+        e.keylen = keylen;
+        e.used   = true;
+    }
+}
+
+namespace {
+//! Map from full port names to ports, for composing Ports
+struct port_name_hash {
+    size_t operator()(const char *name) const {
+        return Port_Matcher::hash_key(name, strlen(name), 0); }
+};
+struct port_name_eq {
+    bool operator()(const char *a, const char *b) const {
+        return !strcmp(a, b); }
+};
+typedef std::unordered_map<const char*, const Port*, port_name_hash,
+                           port_name_eq> port_name_map_t;
+}
+
+ClonePorts::ClonePorts(const Ports &ports_,
+        std::initializer_list<ClonePort> c,
+        const char *magic, size_t magic_len)
     :Ports({})
 {
+    //the last port of a name is the one being cloned
+    port_name_map_t by_name(2*ports_.ports.size());
+    for(auto &p:ports_.ports)
+        by_name[p.name] = &p;
+
+    ports.reserve(c.size());
     for(auto &to_clone:c) {
-        const Port *clone_port = NULL;
-        for(auto &p:ports_.ports)
-            if(!strcmp(p.name, to_clone.name))
-                clone_port = &p;
+        auto itr = by_name.find(to_clone.name);
+        const Port *clone_port = itr == by_name.end() ? NULL : itr->second;
         if(!clone_port && strcmp("*", to_clone.name)) {
             fprintf(stderr, "Cannot find a clone port for '%s'\n",to_clone.name);
             assert(false);
@@ -865,46 +1819,106 @@ ClonePorts::ClonePorts(const Ports &ports_,
         }
     }
 
-    refreshMagic();
+    refreshMagic(magic, magic_len);
 }
-MergePorts::MergePorts(std::initializer_list<const rtosc::Ports*> c)
+
+MergePorts::MergePorts(std::initializer_list<const rtosc::Ports*> c,
+                       const char *magic, size_t magic_len)
     :Ports({})
 {
-    //XXX TODO remove duplicates in some sane and documented way
-    //e.g. repeated ports override and remove older ones
-    for(auto *to_clone:c) {
-        assert(to_clone);
-        for(auto &p:to_clone->ports) {
-            bool already_there = false;
-            for(auto &pp:ports)
-                if(!strcmp(pp.name, p.name))
-                    already_there = true;
-
-            if(!already_there)
+    size_t total = 0;
+    for(auto *to_merge:c) {
+        assert(to_merge);
+        total += to_merge->ports.size();
+    }
+
+    //the first port of a name wins, later ones are dropped
+    port_name_map_t seen(2*total);
+    ports.reserve(total);
+    for(auto *to_merge:c)
+        for(auto &p:to_merge->ports)
+            if(seen.emplace(p.name, &p).second)
                 ports.push_back(p);
+
+    refreshMagic(magic, magic_len);
+}
+
+namespace {
+
+/*
+    Values of "enabled by" toggles, valid during one walk_ports() call.
+    A toggle is identified by the runtime object and the port which are
+    queried. For toggles in a child's Ports object, the queried location is
+    part of the key, too.
+*/
+struct enabled_key_t
+{
+    const void* runtime;
+    const Port* toggle;
+    std::string loc;
+    bool operator==(const enabled_key_t& other) const
+    {
+        return runtime == other.runtime && toggle == other.toggle &&
+               loc == other.loc;
+    }
+};
+
+struct enabled_key_hash_t
+{
+    std::size_t operator()(const enabled_key_t& k) const
+    {
+        return std::hash<const void*>()(k.runtime) ^
+               (std::hash<const void*>()(k.toggle) << 1) ^
+               std::hash<std::string>()(k.loc);
+    }
+};
+
+typedef std::unordered_map<enabled_key_t, bool, enabled_key_hash_t>
+    enabled_cache_t;
+
+//! cache of the outermost walk on this thread, or NULL outside of walks
+thread_local enabled_cache_t* walk_enabled_cache = nullptr;
+//! preallocated cache used instead, or NULL, see WalkEnabledCache::install()
+thread_local WalkEnabledCache* installed_enabled_cache = nullptr;
+//! the installed cache during the outermost walk, or NULL
+thread_local WalkEnabledCache* walk_fixed_cache = nullptr;
+
+//! Installs a cache for the lifetime of the outermost walk
+class enabled_cache_scope_t
+{
+    enabled_cache_t cache;
+    const bool outermost;
+public:
+    enabled_cache_scope_t()
+        : outermost(!walk_enabled_cache && !walk_fixed_cache)
+    {
+        if(!outermost)
+            return;
+        if(installed_enabled_cache) {
+            walk_fixed_cache = installed_enabled_cache;
+            walk_fixed_cache->clear();
+        }
+        else
+            walk_enabled_cache = &cache;
+    }
+    ~enabled_cache_scope_t()
+    {
+        if(outermost) {
+            walk_enabled_cache = nullptr;
+            walk_fixed_cache = nullptr;
         }
     }
+};
 
-    refreshMagic();
 }
 
-/**
- * @brief Check if the port @p port is enabled
- * @param port The port to be checked. Usually of type rRecur* or rSelf.
- * @param loc The absolute path of @p port
- * @param loc_size The maximum usable size of @p loc
- * @param ports The Ports object containing @p port
- * @param runtime The runtime object (optional)
- * @return True if no runtime is provided or @p port has no enabled property.
- *         Otherwise, the state of the "enabled by" toggle
- */
-bool port_is_enabled(const Port* port, char* loc, size_t loc_size,
-                     const Ports& base, void *runtime)
+bool rtosc::port_is_enabled(const Port* port, char* loc, size_t loc_size,
+                            const Ports& base, void *runtime)
 {
     // TODO: this code should be improved
     if(port && runtime)
     {
-        const char* enable_port = port->meta()["enabled by"];
+        const char* enable_port = base.meta(*port)[Port::meta_enabled_by];
         if(enable_port)
         {
             /*
@@ -953,10 +1967,32 @@ bool port_is_enabled(const Port* port, char* loc, size_t loc_size,
             fast_strcpy(buf, last_slash ? last_slash + 1 : collapsed_loc,
                         loc_size);
 
+            const char* key_loc = subport ? collapsed_loc : "";
+            enabled_key_t key;
+            if(walk_fixed_cache)
+            {
+                int state = walk_fixed_cache->find(runtime, ask_port,
+                                                   key_loc);
+                if(state >= 0)
+                    return state;
+            }
+            else if(walk_enabled_cache)
+            {
+                key = enabled_key_t{runtime, ask_port, key_loc};
+                auto itr = walk_enabled_cache->find(key);
+                if(itr != walk_enabled_cache->end())
+                    return itr->second;
+            }
+
             helpers::get_value_from_runtime(runtime,
                 *ask_port, loc_size, collapsed_loc, ask_port_str,
                 buf, 0, 1, &rval);
             assert(rval.type == 'T' || rval.type == 'F');
+            if(walk_fixed_cache)
+                walk_fixed_cache->insert(runtime, ask_port, key_loc,
+                                         rval.type == 'T');
+            else if(walk_enabled_cache)
+                walk_enabled_cache->emplace(std::move(key), rval.type == 'T');
             return rval.type == 'T';
         }
         else // Port has no "enabled" property, so it is always enabled
@@ -966,129 +2002,218 @@ bool port_is_enabled(const Port* port, char* loc, size_t loc_size,
         return true;
 }
 
-// TODO: copy the changes into walk_ports_2
-void rtosc::walk_ports(const Ports  *base,
-                       char         *name_buffer,
-                       size_t        buffer_size,
-                       void         *data,
-                       port_walker_t walker,
-                       bool          expand_bundles,
-                       void*         runtime)
+WalkEnabledCache::WalkEnabledCache(unsigned entries)
+    :nused(0), outer(NULL)
+{
+    unsigned size = 1;
+    while(size < entries)
+        size <<= 1;
+    //twice as many slots as entries keep the probe sequences short
+    size <<= 1;
+    table = new entry_t[size];
+    used  = new unsigned[size];
+    mask  = size - 1;
+    for(unsigned i = 0; i <= mask; ++i)
+        table[i].toggle = NULL;
+}
+
+WalkEnabledCache::~WalkEnabledCache(void)
+{
+    if(installed_enabled_cache == this)
+        uninstall();
+    delete[] table;
+    delete[] used;
+}
+
+void WalkEnabledCache::install(void)
+{
+    outer = installed_enabled_cache;
+    installed_enabled_cache = this;
+}
+
+void WalkEnabledCache::uninstall(void)
+{
+    assert(installed_enabled_cache == this);
+    installed_enabled_cache = outer;
+    outer = NULL;
+}
+
+unsigned WalkEnabledCache::slot(const void *runtime, const Port *toggle,
+                                const char *loc) const
+{
+    //FNV-1a over the location, mixed with both pointers
+    uint64_t h = 14695981039346656037ull;
+    for(const char *c = loc; *c; ++c)
+        h = (h ^ (unsigned char)*c) * 1099511628211ull;
+    h ^= (uintptr_t)runtime;
+    h *= 0x9e3779b97f4a7c15ull;
+    h ^= (uintptr_t)toggle;
+    h *= 0x9e3779b97f4a7c15ull;
+    return (h >> 32) & mask;
+}
+
+int WalkEnabledCache::find(const void *runtime, const Port *toggle,
+                           const char *loc) const
+{
+    for(unsigned i = 0, s = slot(runtime, toggle, loc); i <= mask;
+        ++i, s = (s+1) & mask) {
+        const entry_t &e = table[s];
+        if(!e.toggle)
+            return -1;
+        if(e.toggle == toggle && e.runtime == runtime && !strcmp(e.loc, loc))
+            return e.enabled;
+    }
+    return -1;
+}
+
+void WalkEnabledCache::insert(const void *runtime, const Port *toggle,
+                              const char *loc, bool enabled)
 {
-    auto walk_ports_recurse = [](const Port& p, char* name_buffer,
-                                 size_t buffer_size, const Ports& base,
-                                 void* data, port_walker_t walker,
-                                 void* runtime, const char* old_end,
-                                 bool expand_bundles)
+    //keep half of the slots free, the table is never rehashed
+    if(strlen(loc) >= max_loc || nused > mask/2)
+        return;
+    for(unsigned i = 0, s = slot(runtime, toggle, loc); i <= mask;
+        ++i, s = (s+1) & mask) {
+        entry_t &e = table[s];
+        if(e.toggle)
+            continue;
+        e.runtime = runtime;
+        e.toggle  = toggle;
+        e.enabled = enabled;
+        strcpy(e.loc, loc);
+        used[nused++] = s;
+        return;
+    }
+}
+
+void WalkEnabledCache::clear(void)
+{
+    for(unsigned i = 0; i < nused; ++i)
+        table[used[i]].toggle = NULL;
+    nused = 0;
+}
+
+/*
+    With a runtime object, check whether the subtree of @p p shall be walked,
+    and let @p runtime point to the subtree's runtime object
+*/
+static bool subtree_is_walked(const Port& p, char* name_buffer,
+                              size_t buffer_size, const Ports& base,
+                              const char* old_end, void*& runtime)
+{
+    // TODO: all/most of these checks must also be done for the
+    // first, non-recursive call
+    bool enabled = true;
+    if(runtime)
     {
-        // TODO: all/most of these checks must also be done for the
-        // first, non-recursive call
-        bool enabled = true;
-        if(runtime)
+        const Port::MetaContainer meta = base.meta(p);
+        enabled = (meta.find(Port::meta_no_walk) == meta.end());
+        if(enabled)
         {
-            enabled = (p.meta().find("no walk") == p.meta().end());
+            // get child runtime and check if it's NULL
+            void* child = helpers::get_child_runtime(runtime, p, old_end);
+            // if there is runtime information (see above), but this pointer
+            // is NULL, the port is not enabled
+            enabled = (bool) child;
             if(enabled)
             {
-                // get child runtime and check if it's NULL
-                RtData r;
-                r.obj = runtime;
-                r.port = &p;
-
-                char buf[1024] = "";
-                fast_strcpy(buf, old_end, sizeof(buf));
-                // there is no "pointer" callback. thus, there will be nothing
-                // dispatched, but the rRecur*Cb already have set r.obj
-                // that way, we get our pointer
-                strncat(buf, "pointer", sizeof(buf) - strlen(buf) - 1);
-                assert(1024 - strlen(buf) >= 8);
-                fast_strcpy(buf + strlen(buf) + 1, ",", 2);
-
-                p.cb(buf, r);
-                // if there is runtime information (see above), but this pointer
-                // is NULL, the port is not enabled
-                enabled = (bool) r.obj; // r.obj = the next runtime object
-                if(enabled)
-                {
-                    // check if the port is disabled by a switch
-                    enabled = port_is_enabled(&p, name_buffer, buffer_size,
-                                              base, runtime);
-                }
-                runtime = r.obj; // callback has stored the child pointer here
+                // check if the port is disabled by a switch
+                enabled = port_is_enabled(&p, name_buffer, buffer_size,
+                                          base, runtime);
             }
+            runtime = child;
         }
-        if(enabled)
-            rtosc::walk_ports(p.ports, name_buffer, buffer_size,
-                              data, walker, expand_bundles, runtime);
-    };
+    }
+    return enabled;
+}
 
-    //only walk valid ports
-    if(!base)
-        return;
+// TODO: copy the changes into walk_ports_2
+static void walk_ports_recurse(const Port& p, char* name_buffer,
+                               size_t buffer_size, const Ports& base,
+                               void* data, port_walker_t walker,
+                               void* runtime, const char* old_end,
+                               bool expand_bundles)
+{
+    if(subtree_is_walked(p, name_buffer, buffer_size, base, old_end, runtime))
+        rtosc::walk_ports(p.ports, name_buffer, buffer_size,
+                          data, walker, expand_bundles, runtime);
+}
 
+void rtosc::walk_port(const Ports  *base,
+                      const Port   &p,
+                      char         *name_buffer,
+                      size_t        buffer_size,
+                      void         *data,
+                      port_walker_t walker,
+                      bool          expand_bundles,
+                      void*         runtime,
+                      int           index)
+{
     assert(name_buffer);
     //XXX buffer_size is not properly handled yet
     if(name_buffer[0] == 0)
         name_buffer[0] = '/';
 
+    enabled_cache_scope_t enabled_cache;
     char * const old_end = name_buffer + strlen(name_buffer);
 
-    if(port_is_enabled((*base)["self:"], name_buffer, buffer_size, *base,
-                       runtime))
-    for(const Port &p: *base) {
-        //if(strchr(p.name, '/')) {//it is another tree
-        if(p.ports) {//it is another tree
+    //if(strchr(p.name, '/')) {//it is another tree
+    if(p.ports) {//it is another tree
 
-            //Append the path
-            fast_strcpy(old_end, p.name, buffer_size - (old_end - name_buffer));
+        //Append the path
+        fast_strcpy(old_end, p.name, buffer_size - (old_end - name_buffer));
 
-            char* const hashPtr = strchr(old_end,'#');
-            if(hashPtr)
+        char* const hashPtr = strchr(old_end,'#');
+        if(hashPtr)
+        {
+            //Overwrite the "#.../" by "0/", "1/" ...
+            //TODO: still invalid for ports like /a#2/b#2
+            const unsigned max = atoi(hashPtr+1);
+            for(unsigned i = (index < 0) ? 0 : index;
+                i < ((index < 0) ? max : (unsigned)index + 1); ++i)
             {
-                //Overwrite the "#.../" by "0/", "1/" ...
-                //TODO: still invalid for ports like /a#2/b#2
-                const unsigned max = atoi(hashPtr+1);
-                for(unsigned i=0; i<max; ++i)
-                {
-                    sprintf(hashPtr,"%d/",i);
+                sprintf(hashPtr,"%d/",i);
 
-                    //Recurse
-                    walk_ports_recurse(p, name_buffer, buffer_size,
-                                       *base, data, walker, runtime, old_end,
-                                       expand_bundles);
-                }
-            }
-            else
-            {
                 //Recurse
                 walk_ports_recurse(p, name_buffer, buffer_size,
                                    *base, data, walker, runtime, old_end,
                                    expand_bundles);
             }
+        }
+        else
+        {
+            //Recurse
+            walk_ports_recurse(p, name_buffer, buffer_size,
+                               *base, data, walker, runtime, old_end,
+                               expand_bundles);
+        }
+    } else {
+        if(strchr(p.name,'#')) {
+            bundle_foreach(p, p.name, old_end, name_buffer, *base,
+                           data, runtime, walker, expand_bundles);
         } else {
-            if(strchr(p.name,'#')) {
-                bundle_foreach(p, p.name, old_end, name_buffer, *base,
-                               data, runtime, walker, expand_bundles);
-            } else {
-                //Append the path
-                scat(name_buffer, p.name);
+            //Append the path
+            scat(name_buffer, p.name);
 
-                //Apply walker function
-                walker(&p, name_buffer, old_end, *base, data, runtime);
-            }
+            //Apply walker function
+            walker(&p, name_buffer, old_end, *base, data, runtime);
         }
-
-        //Remove the rest of the path
-        char *tmp = old_end;
-        while(*tmp) *tmp++=0;
     }
+
+    //Remove the rest of the path
+    char *tmp = old_end;
+    while(*tmp) *tmp++=0;
 }
 
-void walk_ports2(const rtosc::Ports *base,
-                 char         *name_buffer,
-                 size_t        buffer_size,
-                 void         *data,
-                 rtosc::port_walker_t walker)
+void rtosc::walk_ports(const Ports  *base,
+                       char         *name_buffer,
+                       size_t        buffer_size,
+                       void         *data,
+                       port_walker_t walker,
+                       bool          expand_bundles,
+                       void*         runtime)
 {
+    //only walk valid ports
     if(!base)
         return;
 
@@ -1097,63 +2222,139 @@ void walk_ports2(const rtosc::Ports *base,
     if(name_buffer[0] == 0)
         name_buffer[0] = '/';
 
-    char *old_end         = name_buffer;
-    while(*old_end) ++old_end;
+    enabled_cache_scope_t enabled_cache;
+    if(port_is_enabled((*base)["self:"], name_buffer, buffer_size, *base,
+                       runtime))
+    for(const Port &p: *base)
+        walk_port(base, p, name_buffer, buffer_size, data, walker,
+                  expand_bundles, runtime);
+}
 
-    for(const rtosc::Port &p: *base) {
-        if(strchr(p.name, '/')) {//it is another tree
-            if(strchr(p.name,'#')) {
-                const char *name = p.name;
-                char       *pos  = old_end;
-                while(*name != '#') *pos++ = *name++;
-                const unsigned max = atoi(name+1);
+PortWalk::PortWalk(const Ports &root, void *runtime, bool expand_bundles,
+                   size_t buffer_size)
+    :name_buffer(buffer_size), expand(expand_bundles)
+{
+    assert(buffer_size > 1);
+    name_buffer[0] = '/';
+    cur = item_t{NULL, NULL, NULL, NULL, NULL};
+    push(root, 1, runtime);
+}
 
-                //for(unsigned i=0; i<max; ++i)
-                {
-                    sprintf(pos,"[0,%d]",max-1);
+void PortWalk::push(const Ports &ports, size_t base_len, void *runtime)
+{
+    // like walk_ports(), check whether the Ports are enabled as a whole
+    if(port_is_enabled(ports["self:"], name_buffer.data(), name_buffer.size(),
+                       ports, runtime))
+        stack.push_back(frame_t{&ports, 0, 0, base_len, runtime});
+}
 
-                    //Ensure the result is a path
-                    if(strrchr(name_buffer, '/')[1] != '/')
-                        strcat(name_buffer, "/");
+bool PortWalk::next(void)
+{
+    char *const buf = name_buffer.data();
+    const size_t size = name_buffer.size();
+    while(!stack.empty())
+    {
+        frame_t &f = stack.back();
+        if(f.idx == f.ports->ports.size()) {
+            stack.pop_back();
+            continue;
+        }
+        const Port &p = f.ports->ports[f.idx];
+        char *const old_end = buf + f.base_len;
+        const size_t remain = size - f.base_len;
+        const char *hash = strchr(p.name, '#');
+        const unsigned elems = hash && (p.ports || expand) ? atoi(hash+1) : 1;
+        if(f.elem >= elems) {
+            ++f.idx;
+            f.elem = 0;
+            continue;
+        }
+        const unsigned i = f.elem++;
+
+        if(p.ports) {
+            //same path as walk_port(): "#.../" is replaced by "0/", "1/", ...
+            fast_strcpy(old_end, p.name, remain);
+            if(hash)
+                snprintf(old_end + (hash - p.name), remain - (hash - p.name),
+                         "%u/", i);
+            void *runtime = f.runtime;
+            const Ports &base = *f.ports;
+            if(subtree_is_walked(p, buf, size, base, old_end, runtime))
+                push(*p.ports, strlen(buf), runtime); // invalidates f
+            continue;
+        }
 
-                    //Recurse
-                    walk_ports2(p.ports, name_buffer, buffer_size,
-                                data, walker);
-                }
-            } else {
-                //Append the path
-                scat(name_buffer, p.name);
+        // same path as bundle_foreach() and scat()
+        char *pos = old_end;
+        const char *name = p.name;
+        if(hash)
+        {
+            for( ; name != hash; ++name)
+                *pos++ = *name;
+            ++name;
+            while(isdigit(*name))
+                ++name;
+            if(expand)
+                pos += snprintf(pos, size - (pos - buf), "%u", i);
+        }
+        while(*name && *name != ':')
+            *pos++ = *name++;
+        *pos = 0;
 
-                //Recurse
-                walk_ports2(p.ports, name_buffer, buffer_size,
-                        data, walker);
-            }
-        } else {
-            if(strchr(p.name,'#')) {
-                const char *name = p.name;
-                char       *pos  = old_end;
-                while(*name != '#') *pos++ = *name++;
-                const unsigned max = atoi(name+1);
+        cur = item_t{&p, buf, old_end, f.ports, f.runtime};
+        return true;
+    }
+    cur = item_t{NULL, NULL, NULL, NULL, NULL};
+    return false;
+}
 
-                //for(unsigned i=0; i<max; ++i)
-                {
-                    sprintf(pos,"[0,%d]",max-1);
+void dump_ports_cb(const rtosc::Port *p, const char *name,const char*,
+                   const Ports&,void *v, void*);
 
-                    //Apply walker function
-                    walker(&p, name_buffer, old_end, *base, data, nullptr);
-                }
-            } else {
-                //Append the path
-                scat(name_buffer, p.name);
+//! subtree handler of doc_level(), gets the subtree's path in name_buffer
+typedef std::function<void(const rtosc::Port&, char*)> doc_subtree_t;
 
-                //Apply walker function
-                walker(&p, name_buffer, old_end, *base, data, nullptr);
-            }
-        }
+/**
+ * Document the leaves of one Ports object, and pass its subtrees on
+ *
+ * Array ports are documented once, as "name[0,N-1]". The walk stops when
+ * the stream fails.
+ */
+static void doc_level(const rtosc::Ports &base,
+                      char         *name_buffer,
+                      std::ostream &o,
+                      const doc_subtree_t &subtree)
+{
+    if(name_buffer[0] == 0)
+        name_buffer[0] = '/';
+
+    char *old_end         = name_buffer;
+    while(*old_end) ++old_end;
+
+    for(const rtosc::Port &p: base) {
+        if(strchr(p.name,'#')) {
+            const char *name = p.name;
+            char       *pos  = old_end;
+            while(*name != '#') *pos++ = *name++;
+            const unsigned max = atoi(name+1);
+            sprintf(pos,"[0,%d]",max-1);
+        } else
+            scat(name_buffer, p.name);
+
+        if(strchr(p.name, '/')) {//it is another tree
+            //Ensure the result is a path
+            if(strchr(p.name,'#') && strrchr(name_buffer, '/')[1] != '/')
+                strcat(name_buffer, "/");
+            subtree(p, name_buffer);
+        } else
+            dump_ports_cb(&p, name_buffer, old_end, base, &o, nullptr);
 
         //Remove the rest of the path
         char *tmp = old_end;
         while(*tmp) *tmp++=0;
+
+        if(!o)
+            return;
     }
 }
 
@@ -1475,7 +2676,7 @@ void dump_ports_cb(const rtosc::Port *p, const char *name,const char*,
         fprintf(stderr, "Skipping [UNDOCUMENTED] \"%s\"\n", name);
 }
 
-std::ostream &rtosc::operator<<(std::ostream &o, rtosc::OscDocFormatter &formatter)
+static void doc_header(std::ostream &o, const rtosc::OscDocFormatter &formatter)
 {
     o << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
     o << "<osc_unit format_version=\"1.0\">\n";
@@ -1486,10 +2687,229 @@ std::ostream &rtosc::operator<<(std::ostream &o, rtosc::OscDocFormatter &formatt
     o << "  <author><firstname>" << formatter.author_first;
     o << "</firstname><lastname>" << formatter.author_last << "</lastname></author>\n";
     o << " </meta>\n";
+}
+
+static const char doc_footer[] = "</osc_unit>\n";
+
+//! document @p ports and all its subtrees
+static void doc_tree(const rtosc::Ports *ports, std::ostream &o)
+{
     char buffer[1024];
     memset(buffer, 0, sizeof(buffer));
-    walk_ports2(formatter.p, buffer, 1024, &o, dump_ports_cb);
-    o << "</osc_unit>\n";
+    doc_subtree_t subtree = [&](const rtosc::Port &p, char *) {
+        if(p.ports)
+            doc_level(*p.ports, buffer, o, subtree);
+    };
+    if(ports)
+        doc_level(*ports, buffer, o, subtree);
+}
+
+std::ostream &rtosc::operator<<(std::ostream &o, rtosc::OscDocFormatter &formatter)
+{
+    doc_header(o, formatter);
+    doc_tree(formatter.p, o);
+    o << doc_footer;
     return o;
 }
 
+namespace {
+//! stream buffer passing chunks to an rtosc_print_sink
+class doc_sink_buf : public std::streambuf
+{
+    public:
+        doc_sink_buf(rtosc_print_sink sink, void *sink_data)
+            :stopped(false), sink(sink), sink_data(sink_data)
+        {
+            setp(chunk, chunk + sizeof(chunk));
+        }
+
+        //! whether the sink stopped printing
+        bool stopped;
+
+    protected:
+        int overflow(int c) override
+        {
+            if(pass_on())
+                return traits_type::eof();
+            if(!traits_type::eq_int_type(c, traits_type::eof()))
+                sputc(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+        int sync(void) override { return pass_on(); }
+
+    private:
+        //! pass the chunk to the sink, non-zero if the sink stopped
+        int pass_on(void)
+        {
+            const std::size_t len = pptr() - pbase();
+            if(!stopped && len && sink(pbase(), len, sink_data))
+                stopped = true;
+            setp(chunk, chunk + sizeof(chunk));
+            return stopped ? -1 : 0;
+        }
+
+        rtosc_print_sink sink;
+        void *sink_data;
+        char chunk[4096];
+};
+
+int doc_append(const char *str, size_t len, void *data)
+{
+    ((std::string*)data)->append(str, len);
+    return 0;
+}
+}
+
+bool rtosc::write_osc_doc(const OscDocFormatter &formatter,
+                          rtosc_print_sink sink, void *sink_data)
+{
+    doc_sink_buf buf(sink, sink_data);
+    std::ostream o(&buf);
+    doc_header(o, formatter);
+    doc_tree(formatter.p, o);
+    o << doc_footer;
+    o.flush();
+    return !buf.stopped;
+}
+
+rtosc::OscDocCache::OscDocCache(const OscDocFormatter &formatter)
+    :formatter(formatter), rebuilt(0)
+{
+}
+
+//! identifies the ports of a Ports object, 0 is reserved for invalidation
+static uint64_t doc_fingerprint(const rtosc::Ports &ports)
+{
+    uint64_t h = rtosc_hash_combine(0, ports.ports.size());
+    for(const rtosc::Port &p : ports) {
+        h = rtosc_hash_combine(h, (uint64_t)(uintptr_t)p.name);
+        h = rtosc_hash_combine(h, (uint64_t)(uintptr_t)p.metadata);
+        h = rtosc_hash_combine(h, (uint64_t)(uintptr_t)p.ports);
+    }
+    return h ? h : 1;
+}
+
+std::size_t rtosc::OscDocCache::update(void)
+{
+    std::ostringstream o;
+    doc_header(o, formatter);
+    header = o.str();
+    footer = doc_footer;
+
+    std::vector<node_t> old;
+    std::unordered_map<std::string, std::size_t> old_index;
+    old.swap(nodes);
+    old_index.swap(index);
+    rebuilt = 0;
+    if(formatter.p)
+        build(formatter.p, "/", old, old_index);
+    return rebuilt;
+}
+
+void rtosc::OscDocCache::build(const Ports *ports, const std::string &path,
+                               const std::vector<node_t> &old,
+                               const std::unordered_map<std::string,
+                                                        std::size_t> &old_index)
+{
+    const std::size_t me = nodes.size();
+    nodes.push_back(node_t{path, ports, doc_fingerprint(*ports), {}, {}});
+    index[path] = me;
+
+    auto found = old_index.find(path);
+    const node_t *prev = found == old_index.end() ? nullptr
+                                                  : &old[found->second];
+
+    if(prev && prev->ports == ports &&
+       prev->fingerprint == nodes[me].fingerprint) {
+        // the same subtrees are found at the same paths
+        nodes[me].segments = prev->segments;
+        std::vector<std::pair<std::string, const Ports*>> children;
+        for(std::size_t c : prev->children)
+            children.emplace_back(old[c].path, old[c].ports);
+        for(const auto &c : children) {
+            nodes[me].children.push_back(nodes.size());
+            build(c.second, c.first, old, old_index);
+        }
+        return;
+    }
+
+    ++rebuilt;
+    std::ostringstream o;
+    char buffer[1024];
+    memset(buffer, 0, sizeof(buffer));
+    strncpy(buffer, path.c_str(), sizeof(buffer) - 1);
+    doc_subtree_t subtree = [&](const Port &p, char *name) {
+        if(!p.ports)
+            return;
+        nodes[me].segments.push_back(o.str());
+        o.str("");
+        nodes[me].children.push_back(nodes.size());
+        build(p.ports, name, old, old_index);
+    };
+    doc_level(*ports, buffer, o, subtree);
+    nodes[me].segments.push_back(o.str());
+}
+
+void rtosc::OscDocCache::invalidate(const char *prefix)
+{
+    const std::size_t len = strlen(prefix);
+    node_t *deepest = nullptr;
+    for(node_t &n : nodes) {
+        if(!n.path.compare(0, len, prefix))
+            n.fingerprint = 0;
+        else if(!strncmp(prefix, n.path.c_str(), n.path.size()) &&
+                (!deepest || n.path.size() > deepest->path.size()))
+            deepest = &n;
+    }
+    // leaves are documented by the Ports object containing them
+    if(deepest && (!len || prefix[len-1] != '/'))
+        deepest->fingerprint = 0;
+}
+
+bool rtosc::OscDocCache::write(std::size_t node, rtosc_print_sink sink,
+                               void *sink_data) const
+{
+    const node_t &n = nodes[node];
+    for(std::size_t i = 0; i < n.segments.size(); ++i) {
+        const std::string &seg = n.segments[i];
+        if(!seg.empty() && sink(seg.data(), seg.size(), sink_data))
+            return false;
+        if(i < n.children.size() && !write(n.children[i], sink, sink_data))
+            return false;
+    }
+    return true;
+}
+
+bool rtosc::OscDocCache::write(rtosc_print_sink sink, void *sink_data) const
+{
+    return !sink(header.data(), header.size(), sink_data) &&
+           (nodes.empty() || write(0, sink, sink_data)) &&
+           !sink(footer.data(), footer.size(), sink_data);
+}
+
+std::string rtosc::OscDocCache::str(void) const
+{
+    std::string res;
+    write(doc_append, &res);
+    return res;
+}
+
+std::ostream &rtosc::operator<<(std::ostream &o,
+                                const rtosc::MagicFormatter &formatter)
+{
+    const std::string magic = formatter.p->saveMagic();
+    const size_t words = magic.size()/sizeof(uint32_t);
+    char word[16];
+
+    o << "static const uint32_t " << formatter.name << "[] = {";
+    for(size_t i=0; i<words; ++i) {
+        uint32_t w;
+        memcpy(&w, magic.data()+i*sizeof(uint32_t), sizeof(uint32_t));
+        snprintf(word, sizeof(word), "0x%08x,", (unsigned)w);
+        o << (i%6 ? " " : "\n    ") << word;
+    }
+    if(!words) //no hash, which will be rejected when loading
+        o << "0";
+    o << "\n};\n";
+    return o;
+}
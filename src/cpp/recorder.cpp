@@ -0,0 +1,296 @@
+#include <rtosc/recorder.h>
+#include <rtosc/ports.h>
+#include <rtosc/rtosc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rtosc {
+
+static const char   magic[8]     = {'r','t','o','s','c','l','o','g'};
+static const size_t record_head  = 8+4; //timetag and length
+static const size_t chunk_size   = 1<<20;
+//seconds from the NTP epoch (1900) to the unix epoch (1970)
+static const uint64_t ntp_offset = 2208988800u;
+
+/*
+ * Recorder
+ */
+
+Recorder::Recorder(size_t max_message_length, size_t max_messages)
+    //messages are wrapped into a bundle with one element in the link
+    :max_message_length(max_message_length),
+     link(max_message_length + 20, max_messages),
+     fd(-1), map(NULL), mapped(0), written(0), records(0)
+{}
+
+Recorder::~Recorder(void)
+{
+    close();
+}
+
+uint64_t Recorder::now(void)
+{
+    using namespace std::chrono;
+    const uint64_t ns = duration_cast<nanoseconds>(
+            system_clock::now().time_since_epoch()).count();
+    const uint64_t sec = ns / 1000000000u;
+    const uint64_t frac = ((ns % 1000000000u) << 32) / 1000000000u;
+    return (sec + ntp_offset) << 32 | frac;
+}
+
+#ifndef _WIN32
+bool Recorder::open(const char *path)
+{
+    close();
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return false;
+    written = 0;
+    records = 0;
+    if(!reserve(sizeof(magic))) {
+        close();
+        return false;
+    }
+    memcpy(map, magic, sizeof(magic));
+    written = sizeof(magic);
+    return true;
+}
+
+void Recorder::close(void)
+{
+    if(fd < 0)
+        return;
+    flush();
+    if(map)
+        munmap(map, mapped);
+    //cut the unused rest of the last chunk
+    if(ftruncate(fd, written)) {}
+    ::close(fd);
+    fd     = -1;
+    map    = NULL;
+    mapped = 0;
+}
+
+bool Recorder::reserve(size_t len)
+{
+    if(written + len <= mapped)
+        return true;
+
+    const size_t new_size = std::max(mapped + chunk_size,
+                                     (written + len + chunk_size - 1)
+                                     / chunk_size * chunk_size);
+    if(ftruncate(fd, new_size))
+        return false;
+    if(map)
+        munmap(map, mapped);
+    void *m = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(m == MAP_FAILED) {
+        map    = NULL;
+        mapped = 0;
+        return false;
+    }
+    map    = (char*)m;
+    mapped = new_size;
+    return true;
+}
+#else
+//No memory mapped logs on Windows
+bool Recorder::open(const char *) { return false; }
+void Recorder::close(void) {}
+bool Recorder::reserve(size_t) { return false; }
+#endif
+
+void Recorder::record(const char *msg, uint64_t timetag)
+{
+    const size_t len = rtosc_message_length(msg, -1);
+    if(!len || len > max_message_length)
+        return;
+
+    //"#bundle", timetag, length and message, built in place
+    char *buf = link.reserve(20+len);
+    if(!buf)
+        return;
+    const uint32_t len32 = len;
+    memcpy(buf, "#bundle", 8);
+    rtosc_pack64((uint8_t*)buf+8, &timetag, 1);
+    rtosc_pack32((uint8_t*)buf+16, &len32, 1);
+    memcpy(buf+20, msg, len);
+    link.commit(20+len);
+}
+
+size_t Recorder::flush(void)
+{
+    size_t n = 0;
+    link.read_all([this, &n](const char *bundle, size_t) {
+        uint32_t len;
+        rtosc_unpack32(&len, (const uint8_t*)bundle+16, 1);
+        if(fd < 0 || !reserve(record_head + len))
+            return; //drain anyways
+
+        //timetag and length are already in the big endian record format
+        memcpy(map + written, bundle + 8, record_head);
+        memcpy(map + written + record_head, bundle + 20, len);
+        written += record_head + len;
+        ++records;
+        ++n;
+    });
+    return n;
+}
+
+/*
+ * LogReplay
+ */
+
+LogReplay::LogReplay(void)
+    :map(NULL), mapped(0), length(0), pos(header_size), records(0), first_tt(0),
+     last_tt(0)
+{}
+
+LogReplay::~LogReplay(void)
+{
+    close();
+}
+
+#ifndef _WIN32
+bool LogReplay::open(const char *path)
+{
+    close();
+    const int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    void *m = MAP_FAILED;
+    if(!fstat(fd, &st) && (size_t)st.st_size >= header_size)
+        m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(m == MAP_FAILED)
+        return false;
+    map    = (const char*)m;
+    mapped = length = st.st_size;
+    if(memcmp(map, magic, sizeof(magic))) {
+        close();
+        return false;
+    }
+
+    //Build the sparse index. A log which has not been closed ends with
+    //zeros, which read as records of length 0.
+    for(pos = header_size; pos + record_head <= length;) {
+        uint64_t tt;
+        uint32_t len;
+        rtosc_unpack64(&tt,  (const uint8_t*)map+pos, 1);
+        rtosc_unpack32(&len, (const uint8_t*)map+pos+8, 1);
+        if(!len || pos + record_head + len > length)
+            break;
+        if(records % index_stride == 0)
+            index.push_back(index_entry_t{tt, pos});
+        if(!records)
+            first_tt = tt;
+        last_tt = tt;
+        ++records;
+        pos += record_head + len;
+    }
+    length = pos;
+    rewind();
+    return true;
+}
+
+void LogReplay::close(void)
+{
+    if(map)
+        munmap((void*)map, mapped);
+    map      = NULL;
+    mapped   = 0;
+    length   = 0;
+    records  = 0;
+    first_tt = last_tt = 0;
+    index.clear();
+    rewind();
+}
+#else
+bool LogReplay::open(const char *) { return false; }
+void LogReplay::close(void) {}
+#endif
+
+const char *LogReplay::next(uint64_t *timetag)
+{
+    if(pos + record_head > length)
+        return NULL;
+    uint32_t len;
+    if(timetag)
+        rtosc_unpack64(timetag, (const uint8_t*)map+pos, 1);
+    rtosc_unpack32(&len, (const uint8_t*)map+pos+8, 1);
+    const char *msg = map + pos + record_head;
+    pos += record_head + len;
+    return msg;
+}
+
+void LogReplay::seek(uint64_t timetag)
+{
+    //last indexed record before the timetag, then scan up to it
+    auto itr = std::lower_bound(index.begin(), index.end(), timetag,
+                                [](const index_entry_t &e, uint64_t tt) {
+                                    return e.timetag < tt; });
+    pos = itr == index.begin() ? (size_t)header_size : std::prev(itr)->pos;
+
+    for(;;) {
+        const size_t here = pos;
+        uint64_t tt;
+        if(!next(&tt) || tt >= timetag) {
+            pos = here;
+            return;
+        }
+    }
+}
+
+struct replay_data_t
+{
+    const Ports &root;
+    RtData      &d;
+};
+
+static void dispatch_replayed(const char *msg, size_t, void *data)
+{
+    replay_data_t &r = *(replay_data_t*)data;
+    r.root.dispatch(msg+1, r.d, true);
+}
+
+size_t LogReplay::replay(const Ports &root, RtData &d, speed_t speed,
+                         uint64_t until)
+{
+    using namespace std::chrono;
+    const steady_clock::time_point start = steady_clock::now();
+    uint64_t start_tt = 0;
+    replay_data_t data = {root, d};
+
+    size_t n = 0;
+    for(bool first = true;; first = false) {
+        const size_t here = pos;
+        uint64_t tt;
+        const char *msg = next(&tt);
+        if(!msg || tt > until) {
+            pos = here;
+            break;
+        }
+        if(first)
+            start_tt = tt;
+        if(speed == original_speed && tt > start_tt) {
+            //timetags are 32.32 fixed point seconds
+            const uint64_t dt = tt - start_tt;
+            std::this_thread::sleep_until(start + seconds(dt >> 32) +
+                    nanoseconds(((dt & 0xffffffffu) * 1000000000u) >> 32));
+        }
+        n += rtosc_bundle_walk(msg, -1, dispatch_replayed, &data);
+    }
+    return n;
+}
+
+}
@@ -0,0 +1,182 @@
+#include <cstdarg>
+#include <cstring>
+#include <rtosc/reply-bundler.h>
+
+namespace rtosc {
+
+namespace {
+    //! replies of RtData are formatted into buffers of this size
+    constexpr std::size_t max_message = 1024;
+}
+
+ReplyBundler::ReplyBundler(sink_t sink, std::size_t max_size)
+    :sink(std::move(sink)), nmessages(0), nbundles(0)
+{
+    for(pending_t *p : {&replies, &broadcasts}) {
+        p->buffer.resize(max_size < 16 ? 16 : max_size);
+        rtosc_bundle_writer_begin(&p->writer, p->buffer.data(),
+                                  p->buffer.size(), 1);
+        p->count = 0;
+    }
+    broadcasts.broadcast = true;
+    replies.broadcast = false;
+}
+
+ReplyBundler::~ReplyBundler(void)
+{
+    flush();
+}
+
+void ReplyBundler::dispatch(const Ports &ports, const char *msg)
+{
+    ports.dispatch(msg, *this, true);
+    flush();
+}
+
+void ReplyBundler::flush(void)
+{
+    send(replies);
+    send(broadcasts);
+}
+
+void ReplyBundler::pass_on(const pending_t &p, const char *msg,
+                           std::size_t len)
+{
+    sink(msg, len, p.broadcast);
+}
+
+void ReplyBundler::send(pending_t &p)
+{
+    if(!p.count)
+        return;
+    const std::size_t len = rtosc_bundle_writer_finish(&p.writer);
+    if(p.count == 1) //the message behind the header and its size
+        pass_on(p, p.buffer.data() + 20, len - 20);
+    else {
+        pass_on(p, p.buffer.data(), len);
+        ++nbundles;
+    }
+    nmessages += p.count;
+    p.count = 0;
+    rtosc_bundle_writer_restart(&p.writer);
+}
+
+void ReplyBundler::add(pending_t &p, const char *msg)
+{
+    const size_t len = rtosc_message_length(msg, -1);
+    if(rtosc_bundle_append(&p.writer, msg, len)) {
+        ++p.count;
+        return;
+    }
+    send(p);
+    if(rtosc_bundle_append(&p.writer, msg, len))
+        ++p.count;
+    else {
+        pass_on(p, msg, len);
+        ++nmessages;
+    }
+}
+
+void ReplyBundler::add(pending_t &p, const char *path, const char *args,
+                       va_list va)
+{
+    //format in place, retry in an empty bundle if the message does not fit
+    for(int attempt = 0; attempt < 2; ++attempt) {
+        size_t avail;
+        char *buf = rtosc_bundle_append_reserve(&p.writer, &avail);
+        va_list copy;
+        va_copy(copy, va);
+        const size_t len = avail ? rtosc_vmessage(buf, avail, path, args, copy)
+                                 : 0;
+        va_end(copy);
+        if(len) {
+            rtosc_bundle_append_commit(&p.writer, len);
+            ++p.count;
+            return;
+        }
+        if(!p.count)
+            break;
+        send(p);
+    }
+    char buffer[max_message];
+    if(const size_t len = rtosc_vmessage(buffer, sizeof(buffer), path, args,
+                                         va)) {
+        pass_on(p, buffer, len);
+        ++nmessages;
+    }
+}
+
+void ReplyBundler::add(pending_t &p, const char *path, const char *args,
+                       const rtosc_arg_t *vals)
+{
+    for(int attempt = 0; attempt < 2; ++attempt) {
+        size_t avail;
+        char *buf = rtosc_bundle_append_reserve(&p.writer, &avail);
+        const size_t len = avail ? rtosc_amessage(buf, avail, path, args, vals)
+                                 : 0;
+        if(len) {
+            rtosc_bundle_append_commit(&p.writer, len);
+            ++p.count;
+            return;
+        }
+        if(!p.count)
+            break;
+        send(p);
+    }
+    char buffer[max_message];
+    if(const size_t len = rtosc_amessage(buffer, sizeof(buffer), path, args,
+                                         vals)) {
+        pass_on(p, buffer, len);
+        ++nmessages;
+    }
+}
+
+void ReplyBundler::reply(const char *path, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    add(replies, path, args, va);
+    va_end(va);
+}
+
+void ReplyBundler::reply(const char *msg)
+{
+    add(replies, msg);
+}
+
+void ReplyBundler::replyArray(const char *path, const char *args,
+                              rtosc_arg_t *vals)
+{
+    add(replies, path, args, vals);
+}
+
+void ReplyBundler::broadcast(const char *path, const char *args, ...)
+{
+    va_list va;
+    va_start(va, args);
+    add(broadcasts, path, args, va);
+    va_end(va);
+}
+
+void ReplyBundler::broadcast(const char *msg)
+{
+    add(broadcasts, msg);
+}
+
+void ReplyBundler::broadcastArray(const char *path, const char *args,
+                                  rtosc_arg_t *vals)
+{
+    add(broadcasts, path, args, vals);
+}
+
+ReplyBundler::sink_t ReplyBundler::link_sink(ThreadLink &link)
+{
+    return [&link](const char *msg, std::size_t len, bool) {
+        if(char *buf = link.reserve(len)) {
+            memcpy(buf, msg, len);
+            link.commit(len);
+        }
+    };
+}
+
+}
@@ -0,0 +1,53 @@
+#include <cstddef>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <rtosc/rt-checker.h>
+
+//Replaces the allocation and locking functions of glibc by functions which
+//report to the RtChecker of the current thread before calling glibc. The
+//functions are found by the linker before the ones of libc, so this works
+//for all allocations of the program, including those of shared libraries.
+
+extern "C" {
+int rtosc_rt_check_interposer = 1;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void  __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    rtosc::RtChecker::note("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    rtosc::RtChecker::note("calloc");
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    rtosc::RtChecker::note("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if(ptr)
+        rtosc::RtChecker::note("free");
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    typedef int (*lock_t)(pthread_mutex_t*);
+    //dlsym() does not lock mutexes, and it only allocates on errors
+    static lock_t next = (lock_t)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    rtosc::RtChecker::note("pthread_mutex_lock");
+    return next(mutex);
+}
+}
@@ -0,0 +1,202 @@
+#include "../util.h"
+#include <chrono>
+#include <cstring>
+
+#include <rtosc/rtosc.h>
+#include <rtosc/dispatch-profiler.h>
+#include <rtosc/rt-checker.h>
+
+//defined by the interposer library, if it is linked
+extern "C" int rtosc_rt_check_interposer __attribute__((weak));
+
+namespace rtosc {
+
+//the checker whose callback runs on this thread, if any
+static thread_local RtChecker *current = NULL;
+
+RtChecker::RtChecker(unsigned ports)
+    :violation_overflow(0), nused(0), worst_stats(NULL), nviolations(0),
+     cur_port(NULL), cur_path(NULL)
+{
+    unsigned size = 1;
+    while(size < ports)
+        size <<= 1;
+    table = new stats_t[size];
+    used  = new unsigned[size];
+    mask  = size - 1;
+    reset();
+}
+
+RtChecker::~RtChecker(void)
+{
+    delete[] table;
+    delete[] used;
+}
+
+void RtChecker::reset(void)
+{
+    memset(table, 0, (mask+1) * sizeof(stats_t));
+    nused       = 0;
+    worst_stats = NULL;
+    nviolations = 0;
+    violation_overflow = 0;
+}
+
+RtChecker::stats_t *RtChecker::lookup(const Port &port)
+{
+    uintptr_t h = (uintptr_t)&port;
+    h ^= h >> 17;
+    h *= 0x9e3779b1u;
+    for(unsigned i = 0, slot = h & mask; i <= mask; ++i, slot = (slot+1) & mask) {
+        stats_t &s = table[slot];
+        if(s.port == &port)
+            return &s;
+        if(s.port)
+            continue;
+        //keep one slot free, the table is never rehashed
+        if(nused == mask)
+            return NULL;
+        s.port = &port;
+        used[nused++] = slot;
+        return &s;
+    }
+    return NULL;
+}
+
+static void copy_path(char *dest, const char *path)
+{
+    fast_strcpy(dest, path, RtChecker::max_path);
+    dest[strcspn(dest, ":")] = 0;
+}
+
+void RtChecker::call(const Port &port, const char *m, RtData &d)
+{
+    const char *path = d.loc && d.loc_size ? d.location() : port.name;
+    RtChecker *outer = current;
+    const Port *outer_port = cur_port;
+    const char *outer_path = cur_path;
+    cur_port = &port;
+    cur_path = path;
+
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+    current = this;
+    if(d.profiler)
+        d.profiler->call(port, m, d);
+    else
+        port.cb(m, d);
+    current = outer;
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - start).count();
+
+    cur_port = outer_port;
+    cur_path = outer_path;
+
+    stats_t *s = lookup(port);
+    if(!s)
+        return;
+    ++s->calls;
+    if(ns >= s->max_ns) {
+        s->max_ns = ns;
+        copy_path(s->path, path);
+    }
+    if(!worst_stats || s->max_ns >= worst_stats->max_ns)
+        worst_stats = s;
+}
+
+void RtChecker::add_violation(const char *call, const Port *port,
+                              const char *path)
+{
+    for(unsigned i = 0; i < nviolations; ++i) {
+        violation_t &v = viol[i];
+        if(v.port == port && !strcmp(v.call, call)) {
+            ++v.count;
+            return;
+        }
+    }
+    if(nviolations == max_violations) {
+        ++violation_overflow;
+        return;
+    }
+    violation_t &v = viol[nviolations++];
+    v.port  = port;
+    v.call  = call;
+    v.count = 1;
+    copy_path(v.path, path);
+}
+
+void RtChecker::report(const char *call, const Port *port, const char *path)
+{
+    //like note(), ignore what the checker itself calls while recording
+    RtChecker *outer = current;
+    current = NULL;
+    add_violation(call, port, path);
+    current = outer;
+}
+
+void RtChecker::note(const char *call)
+{
+    RtChecker *c = current;
+    if(!c)
+        return;
+    //ignore what the checker itself calls while recording
+    current = NULL;
+    c->add_violation(call, c->cur_port, c->cur_path);
+    current = c;
+}
+
+bool RtChecker::active(void)
+{
+    return current;
+}
+
+bool RtChecker::interposed(void)
+{
+    return &rtosc_rt_check_interposer;
+}
+
+namespace {
+    struct exercise_t
+    {
+        RtChecker *checker;
+        std::size_t called;
+        char loc[1024];
+        char msg[1024];
+    };
+}
+
+std::size_t RtChecker::exercise(const Ports &ports, void *runtime)
+{
+    //only the callbacks are checked, not building the tables
+    ports.prepare();
+    exercise_t ex;
+    ex.checker = this;
+    ex.called  = 0;
+    char name_buffer[1024] = "";
+    walk_ports(&ports, name_buffer, sizeof(name_buffer), &ex,
+               [](const Port *p, const char *port_buffer,
+                  const char *port_from_base, const Ports &base, void *data,
+                  void *runtime) {
+            if(p->ports || !runtime ||
+               p->meta().find("internal") != p->meta().end())
+                return;
+            exercise_t &ex = *(exercise_t*)data;
+            if(!rtosc_message(ex.msg, sizeof(ex.msg), port_from_base, ""))
+                return;
+
+            //dispatch at the parent, like when reading the port's value
+            const std::size_t base_len = port_from_base - port_buffer;
+            memcpy(ex.loc, port_buffer, base_len);
+            ex.loc[base_len] = 0;
+            RtData d;
+            d.loc      = ex.loc;
+            d.loc_size = sizeof(ex.loc);
+            d.obj      = runtime;
+            d.checker  = ex.checker;
+            base.dispatch(ex.msg, d, false);
+            ++ex.called;
+        }, true, runtime);
+    return ex.called;
+}
+
+}
@@ -2,6 +2,16 @@
 #include <cassert>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #include "../util.h"
 #include <rtosc/arg-val-cmp.h>
@@ -11,6 +21,10 @@
 #include <rtosc/ports-runtime.h>
 #include <rtosc/default-value.h>
 #include <rtosc/savefile.h>
+#include <rtosc/change-tracker.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/trace.h>
+#include <rtosc/worker-pool.h>
 
 namespace rtosc {
 
@@ -19,245 +33,507 @@ namespace {
     constexpr size_t max_arg_vals = 2048;
 }
 
-std::string get_changed_values(const Ports& ports, void* runtime)
-{
-    std::string res;
-    char port_buffer[buffersize];
-    memset(port_buffer, 0, buffersize); // requirement for walk_ports
+namespace {
+    //! destination of get_changed_values()
+    struct changed_values_sink_t
+    {
+        rtosc_print_sink sink;
+        void* data;
+        bool first; //!< no message has been written yet
+        bool failed;
+        bool binary; //!< write OSC messages instead of printing them
+    };
 
-    auto on_reach_port =
-            [](const Port* p, const char* port_buffer,
-               const char* port_from_base, const Ports& base,
-               void* data, void* runtime)
+    int append_to_string(const char* str, size_t len, void* data)
     {
+        ((std::string*)data)->append(str, len);
+        return 0;
+    }
 
-        assert(runtime);
-        const Port::MetaContainer meta = p->meta();
-#if 0
-// practical for debugging if a parameter was changed, but not saved
-        const char* cmp = "/part15/kit0/adpars/GlobalPar/Reson/Prespoints";
-        if(!strncmp(port_buffer, cmp, strlen(cmp)))
+    constexpr char binary_magic[] = "RTOSCBIN";
+    constexpr std::size_t binary_magic_len = sizeof(binary_magic) - 1;
+
+    /**
+     * Convert arg vals into OSC args, expanding ranges and writing arrays
+     * with '[' and ']' type tags
+     * @param vals Array for the args, or NULL to only count them
+     * @param tags Array for the type tags, or NULL to only count them
+     * @param ntags Will be set to the number of type tags
+     * @return The number of OSC args
+     */
+    std::size_t flatten_arg_vals(const rtosc_arg_val_t* av, std::size_t n,
+                                 rtosc_arg_t* vals, char* tags,
+                                 std::size_t* ntags)
+    {
+        std::size_t nvals = 0, pos = 0;
+        rtosc_arg_val_itr itr;
+        rtosc_arg_val_itr_init(&itr, av);
+        while(itr.i < n)
         {
-            puts("break here");
+            // runtime values never contain infinite ranges
+            assert(itr.av->type != '-' || itr.av->val.r.num);
+            if(itr.av->type == 'a')
+            {
+                std::size_t subtags;
+                if(tags)
+                    tags[pos] = '[';
+                ++pos;
+                nvals += flatten_arg_vals(itr.av + 1, itr.av->val.a.len,
+                                          vals ? vals + nvals : NULL,
+                                          tags ? tags + pos : NULL, &subtags);
+                pos += subtags;
+                if(tags)
+                    tags[pos] = ']';
+                ++pos;
+            }
+            else
+            {
+                rtosc_arg_val_t buffer;
+                const rtosc_arg_val_t* cur = rtosc_arg_val_itr_get(&itr,
+                                                                   &buffer);
+                if(vals)
+                    vals[nvals] = cur->val;
+                if(tags)
+                    tags[pos] = cur->type;
+                ++nvals;
+                ++pos;
+            }
+            rtosc_arg_val_itr_next(&itr);
         }
-#endif
+        *ntags = pos;
+        return nvals;
+    }
+
+    //! write a message and its size, as in bundles, to the sink
+    void write_binary_message(changed_values_sink_t* res, const char* address,
+                              const rtosc_arg_val_t* args, std::size_t n)
+    {
+        std::size_t ntags;
+        std::size_t nvals = flatten_arg_vals(args, n, NULL, NULL, &ntags);
+        std::vector<rtosc_arg_t> vals(nvals);
+        std::string tags(ntags, '\0');
+        flatten_arg_vals(args, n, vals.data(), &tags[0], &ntags);
+
+        std::size_t len = rtosc_amessage(NULL, 0, address,
+                                         tags.c_str(), vals.data());
+        std::vector<char> msg(4 + len);
+        msg[0] = (char)((len >> 24) & 0xff);
+        msg[1] = (char)((len >> 16) & 0xff);
+        msg[2] = (char)((len >>  8) & 0xff);
+        msg[3] = (char)( len        & 0xff);
+        rtosc_amessage(msg.data() + 4, len, address,
+                       tags.c_str(), vals.data());
+        if(res->sink(msg.data(), msg.size(), res->data))
+            res->failed = true;
+    }
+
+    //! a part of the top level walk: a port of the root, and for port
+    //! arrays with subports the index of the subtree, otherwise -1
+    struct walk_job_t
+    {
+        const Port* port;
+        int index;
+    };
+
+    //! whether the root's "self:" port is enabled
+    bool root_is_enabled(const Ports& ports, void* runtime);
+    //! split the walk at the top level ports and at the indices of top level
+    //! port arrays with subports, like "part#16/"
+    std::vector<walk_job_t> top_level_jobs(const Ports& ports);
+    //! print the changed values of one job into @p text
+    void print_job(const Ports& ports, void* runtime, const walk_job_t& job,
+                   bool binary, std::string& text);
+    //! pass the texts of multiple jobs to the sink, in order
+    bool write_texts(const std::vector<std::string>& texts,
+                     changed_values_sink_t& res);
+
+    //! write all changed values to res' sink
+    //! @param pool If not NULL, walk the top level subtrees on its workers
+    bool write_changed_values(const Ports& ports, void* runtime,
+                              changed_values_sink_t& res,
+                              WorkerPool* pool = nullptr);
+}
+
+bool get_changed_values(const Ports& ports, void* runtime,
+                        rtosc_print_sink sink, void* sink_data)
+{
+    changed_values_sink_t res { sink, sink_data, true, false, false };
+    return write_changed_values(ports, runtime, res);
+}
 
-        if((p->name[strlen(p->name)-1] != ':' && !strstr(p->name, "::"))
-            || meta.find("parameter") == meta.end())
+namespace {
+//! whether @p p is a parameter whose value can be queried, and thus compared
+//! with the default value
+bool is_saved_port(const Port* p, const Ports* base = nullptr)
+{
+    const Port::MetaContainer meta = base ? base->meta(*p) : p->meta();
+    if((p->name[strlen(p->name)-1] != ':' && !strstr(p->name, "::"))
+        || meta.find(Port::meta_parameter) == meta.end())
+    {
+        // runtime information can not be retrieved,
+        // thus, it can not be compared with the default value
+        return false;
+    }
+    else
+    { // TODO: duplicate to above? (colon[1])
+        const char* colon = strchr(p->name, ':');
+        if(!colon || !colon[1])
         {
-            // runtime information can not be retrieved,
-            // thus, it can not be compared with the default value
-            return;
+            // runtime information can not be loaded, so don't save it
+            // a possible FEATURE would be to save it anyways
+            return false;
         }
-        else
-        { // TODO: duplicate to above? (colon[1])
-            const char* colon = strchr(p->name, ':');
-            if(!colon || !colon[1])
-            {
-                // runtime information can not be loaded, so don't save it
-                // a possible FEATURE would be to save it anyways
-                return;
-            }
+    }
+    return true;
+}
+
+//! write a message with @p values if they differ from @p defaults
+void write_changed_message(changed_values_sink_t* res,
+                           const Port::MetaContainer& meta,
+                           const char* address,
+                           const rtosc_arg_val_t* defaults, int ndefaults,
+                           rtosc_arg_val_t* values, size_t nvalues)
+{
+    if(!rtosc_arg_vals_eq(defaults, values, ndefaults, nvalues, nullptr))
+    {
+        if(res->failed)
+            return;
+        if(res->binary)
+        {
+            write_binary_message(res, address, values, nvalues);
+            return;
         }
 
-        char loc[buffersize] = ""; // buffer to hold the dispatched path
-        rtosc_arg_val_t arg_vals_default[max_arg_vals];
-        rtosc_arg_val_t arg_vals_runtime[max_arg_vals];
-        // buffer to hold the message (i.e. /port ..., without port's bases)
-        char buffer_with_port[buffersize];
-        char strbuf[buffersize]; // temporary string buffer for pretty-printing
-
-        std::string* res = (std::string*)data;
-        assert(strlen(port_buffer) + 1 < buffersize);
-        // copy the path until before the message
-        fast_strcpy(loc, port_buffer, std::min((ptrdiff_t)buffersize,
-                                               port_from_base - port_buffer + 1
-                                               ));
-        char* loc_end = loc + (port_from_base - port_buffer);
-        size_t loc_remain_size = buffersize - (port_from_base - port_buffer);
-        *loc_end = 0;
-
-        const char* portargs = strchr(p->name, ':');
-        if(!portargs)
-            portargs = p->name + strlen(p->name);
+        map_arg_vals(values, nvalues, meta);
 
-#if 0 // debugging stuff
-        if(!strncmp(port_buffer, "/part1/Penabled", 5) &&
-           !strncmp(port_buffer+6, "/Penabled", 9))
+        // one message per line, without a trailing newline
+        if(!res->first && res->sink("\n", 1, res->data))
         {
-            printf("runtime: %ld\n", (long int)runtime);
+            res->failed = true;
+            return;
         }
+        res->first = false;
+        rtosc_print_message_to_sink(address, values, nvalues,
+            [](const char* str, size_t len, void* data) {
+                changed_values_sink_t* res = (changed_values_sink_t*)data;
+                if(res->sink(str, len, res->data))
+                    res->failed = true;
+                return (int)res->failed;
+            }, res, NULL, 0);
+    }
+}
+
+//! port walker which prints the port's value if it differs from the default
+void on_reach_port(const Port* p, const char* port_buffer,
+                   const char* port_from_base, const Ports& base,
+                   void* data, void* runtime)
+{
+    assert(runtime);
+    const Port::MetaContainer meta = base.meta(*p);
+#if 0
+// practical for debugging if a parameter was changed, but not saved
+    const char* cmp = "/part15/kit0/adpars/GlobalPar/Reson/Prespoints";
+    if(!strncmp(port_buffer, cmp, strlen(cmp)))
+    {
+        puts("break here");
+    }
 #endif
-// TODO: p->name: duplicate to p
-        int nargs_default = get_default_value(p->name,
-                                              portargs,
-                                              base,
-                                              runtime,
-                                              p,
-                                              -1,
-                                              max_arg_vals,
-                                              arg_vals_default,
-                                              strbuf,
-                                              buffersize);
-
-        if(nargs_default > 0)
-        {
-            size_t nargs_runtime = 0;
 
-            auto ftor = [&](const Port* p, const char* ,
-                            const char* old_end,
-                            const Ports& ,void* ,void* runtime)
-            {
-                fast_strcpy(buffer_with_port, p->name, buffersize);
-
-                // the caller of ftor (in some cases bundle_foreach) has
-                // already filled old_end correctly, but we have to copy this
-                // over to loc_end
-                fast_strcpy(loc_end, old_end, loc_remain_size);
-
-                size_t nargs_runtime_cur =
-                    helpers::get_value_from_runtime(runtime, *p,
-                                                    buffersize, loc, old_end,
-                                                    buffer_with_port,
-                                                    buffersize,
-                                                    max_arg_vals,
-                                                    arg_vals_runtime +
-                                                        nargs_runtime);
-                nargs_runtime += nargs_runtime_cur;
-            };
+    if(!is_saved_port(p, &base))
+        return;
+
+    char loc[buffersize] = ""; // buffer to hold the dispatched path
+    rtosc_arg_val_t arg_vals_default[max_arg_vals];
+    rtosc_arg_val_t arg_vals_runtime[max_arg_vals];
+    // buffer to hold the message (i.e. /port ..., without port's bases)
+    char buffer_with_port[buffersize];
+    char strbuf[buffersize]; // temporary string buffer for pretty-printing
+
+    changed_values_sink_t* res = (changed_values_sink_t*)data;
+    assert(strlen(port_buffer) + 1 < buffersize);
+    // copy the path until before the message
+    fast_strcpy(loc, port_buffer, std::min((ptrdiff_t)buffersize,
+                                           port_from_base - port_buffer + 1
+                                           ));
+    char* loc_end = loc + (port_from_base - port_buffer);
+    size_t loc_remain_size = buffersize - (port_from_base - port_buffer);
+    *loc_end = 0;
+
+    const char* portargs = strchr(p->name, ':');
+    if(!portargs)
+        portargs = p->name + strlen(p->name);
 
-            auto refix_old_end = [&base](const Port* _p, char* _old_end)
-            { // TODO: remove base capture
-                bundle_foreach(*_p, _p->name, _old_end, NULL,
-                               base, NULL, NULL, bundle_foreach_do_nothing,
-                               false, false);
-            };
+#if 0 // debugging stuff
+    if(!strncmp(port_buffer, "/part1/Penabled", 5) &&
+       !strncmp(port_buffer+6, "/Penabled", 9))
+    {
+        printf("runtime: %ld\n", (long int)runtime);
+    }
+#endif
+// TODO: p->name: duplicate to p
+    int nargs_default = get_default_value(p->name,
+                                          portargs,
+                                          base,
+                                          runtime,
+                                          p,
+                                          -1,
+                                          max_arg_vals,
+                                          arg_vals_default,
+                                          strbuf,
+                                          buffersize);
+
+    if(nargs_default > 0)
+    {
+        size_t nargs_runtime = 0;
 
-            if(strchr(p->name, '#'))
-            {
-                // idea:
-                //                    p/a/b
-                // bundle_foreach =>  p/a#0/b, p/a#1/b, ... p/a#n/b, p
-                // bundle_foreach =>  p/a/b
-                // => justification for const_cast
-
-                // Skip the array element (type 'a') for now...
-                ++nargs_runtime;
-
-                // Start filling at arg_vals_runtime + 1
-                char* old_end_noconst = const_cast<char*>(port_from_base);
-                bundle_foreach(*p, p->name, old_end_noconst, port_buffer + 1,
-                               base, data, runtime,
-                               ftor, true);
-
-                // glue the old end behind old_end_noconst again
-                refix_old_end(p, old_end_noconst);
-
-                // "Go back" to fill arg_vals_runtime + 0
-                arg_vals_runtime[0].type = 'a';
-                arg_vals_runtime[0].val.a.len = nargs_runtime-1;
-                arg_vals_runtime[0].val.a.type = arg_vals_runtime[1].type;
-            }
-            else
-                ftor(p, port_buffer, port_from_base, base, NULL, runtime);
+        auto ftor = [&](const Port* p, const char* ,
+                        const char* old_end,
+                        const Ports& ,void* ,void* runtime)
+        {
+            fast_strcpy(buffer_with_port, p->name, buffersize);
+
+            // the caller of ftor (in some cases bundle_foreach) has
+            // already filled old_end correctly, but we have to copy this
+            // over to loc_end
+            fast_strcpy(loc_end, old_end, loc_remain_size);
+
+            size_t nargs_runtime_cur =
+                helpers::get_value_from_runtime(runtime, *p,
+                                                buffersize, loc, old_end,
+                                                buffer_with_port,
+                                                buffersize,
+                                                max_arg_vals,
+                                                arg_vals_runtime +
+                                                    nargs_runtime);
+            nargs_runtime += nargs_runtime_cur;
+        };
+
+        auto refix_old_end = [&base](const Port* _p, char* _old_end)
+        { // TODO: remove base capture
+            bundle_foreach(*_p, _p->name, _old_end, NULL,
+                           base, NULL, NULL, bundle_foreach_do_nothing,
+                           false, false);
+        };
+
+        if(strchr(p->name, '#'))
+        {
+            // idea:
+            //                    p/a/b
+            // bundle_foreach =>  p/a#0/b, p/a#1/b, ... p/a#n/b, p
+            // bundle_foreach =>  p/a/b
+            // => justification for const_cast
+
+            // Skip the array element (type 'a') for now...
+            ++nargs_runtime;
+
+            // Start filling at arg_vals_runtime + 1
+            char* old_end_noconst = const_cast<char*>(port_from_base);
+            bundle_foreach(*p, p->name, old_end_noconst, port_buffer + 1,
+                           base, data, runtime,
+                           ftor, true);
+
+            // glue the old end behind old_end_noconst again
+            refix_old_end(p, old_end_noconst);
+
+            // "Go back" to fill arg_vals_runtime + 0
+            arg_vals_runtime[0].type = 'a';
+            arg_vals_runtime[0].val.a.len = nargs_runtime-1;
+            arg_vals_runtime[0].val.a.type = arg_vals_runtime[1].type;
+        }
+        else
+            ftor(p, port_buffer, port_from_base, base, NULL, runtime);
 
 #if 0
 // practical for debugging if a parameter was changed, but not saved
-            const char* cmp = "/part15/kit0/adpars/GlobalPar/Reson/Prespoints";
-            if(!strncmp(port_buffer, cmp, strlen(cmp)))
-            {
-                puts("break here");
-            }
+        const char* cmp = "/part15/kit0/adpars/GlobalPar/Reson/Prespoints";
+        if(!strncmp(port_buffer, cmp, strlen(cmp)))
+        {
+            puts("break here");
+        }
 #endif
-            canonicalize_arg_vals(arg_vals_default, nargs_default,
-                                  strchr(p->name, ':'), meta);
+        canonicalize_arg_vals(arg_vals_default, nargs_default,
+                              strchr(p->name, ':'), meta);
 
-            auto write_msg = [&res, &meta, &port_buffer]
-                                 (const rtosc_arg_val_t* arg_vals_default,
-                                  rtosc_arg_val_t* arg_vals_runtime,
-                                  int nargs_default, size_t nargs_runtime)
+        auto write_msg = [&res, &meta, &port_buffer]
+                             (const rtosc_arg_val_t* arg_vals_default,
+                              rtosc_arg_val_t* arg_vals_runtime,
+                              int nargs_default, size_t nargs_runtime)
+        {
+            write_changed_message(res, meta, port_buffer,
+                                  arg_vals_default, nargs_default,
+                                  arg_vals_runtime, nargs_runtime);
+        };
+
+        if(arg_vals_runtime[0].type == 'a' && strchr(port_from_base, '/'))
+        {
+            // These are grouped as an array, but the port structure
+            // implicits that they shall be handled as single values
+            // inside their subtrees
+            //  => We don't print this as an array
+            //  => All arrays in savefiles have their numbers after
+            //     the last port separator ('/')
+
+            // used if the value of lhs or rhs is range-computed:
+            rtosc_arg_val_t rlhs, rrhs;
+
+            rtosc_arg_val_itr litr, ritr;
+            rtosc_arg_val_itr_init(&litr, arg_vals_default+1);
+            rtosc_arg_val_itr_init(&ritr, arg_vals_runtime+1);
+
+            auto write_msg_adaptor = [&litr, &ritr,&rlhs,&rrhs,&write_msg](
+                const Port* p,
+                const char* port_buffer, const char* old_end,
+                const Ports&, void*, void*)
             {
-                if(!rtosc_arg_vals_eq(arg_vals_default, arg_vals_runtime,
-                                      nargs_default, nargs_runtime, nullptr))
+                const rtosc_arg_val_t
+                    * lcur = rtosc_arg_val_itr_get(&litr, &rlhs),
+                    * rcur = rtosc_arg_val_itr_get(&ritr, &rrhs);
+
+                if(!rtosc_arg_vals_eq_single(
+                        rtosc_arg_val_itr_get(&litr, &rlhs),
+                        rtosc_arg_val_itr_get(&ritr, &rrhs), nullptr))
                 {
-                    char cur_value_pretty[buffersize] = " ";
+                    auto get_sz = [](const rtosc_arg_val_t* a) {
+                        return a->type == 'a' ? (a->val.a.len + 1) : 1; };
+                    // the const-ness does not matter
+                    write_msg(lcur,
+                        const_cast<rtosc_arg_val_t*>(rcur),
+                        get_sz(lcur), get_sz(rcur));
+                }
 
-                    map_arg_vals(arg_vals_runtime, nargs_runtime, meta);
+                rtosc_arg_val_itr_next(&litr);
+                rtosc_arg_val_itr_next(&ritr);
+            };
 
-                    rtosc_print_arg_vals(arg_vals_runtime, nargs_runtime,
-                                         cur_value_pretty + 1, buffersize - 1,
-                                         NULL, strlen(port_buffer) + 1);
-                    *res += port_buffer;
-                    *res += cur_value_pretty;
-                    *res += "\n";
-                }
-            }; // functor write_msg
+            char* old_end_noconst = const_cast<char*>(port_from_base);
 
-            if(arg_vals_runtime[0].type == 'a' && strchr(port_from_base, '/'))
-            {
-                // These are grouped as an array, but the port structure
-                // implicits that they shall be handled as single values
-                // inside their subtrees
-                //  => We don't print this as an array
-                //  => All arrays in savefiles have their numbers after
-                //     the last port separator ('/')
-
-                // used if the value of lhs or rhs is range-computed:
-                rtosc_arg_val_t rlhs, rrhs;
-
-                rtosc_arg_val_itr litr, ritr;
-                rtosc_arg_val_itr_init(&litr, arg_vals_default+1);
-                rtosc_arg_val_itr_init(&ritr, arg_vals_runtime+1);
-
-                auto write_msg_adaptor = [&litr, &ritr,&rlhs,&rrhs,&write_msg](
-                    const Port* p,
-                    const char* port_buffer, const char* old_end,
-                    const Ports&, void*, void*)
-                {
-                    const rtosc_arg_val_t
-                        * lcur = rtosc_arg_val_itr_get(&litr, &rlhs),
-                        * rcur = rtosc_arg_val_itr_get(&ritr, &rrhs);
-
-                    if(!rtosc_arg_vals_eq_single(
-                            rtosc_arg_val_itr_get(&litr, &rlhs),
-                            rtosc_arg_val_itr_get(&ritr, &rrhs), nullptr))
-                    {
-                        auto get_sz = [](const rtosc_arg_val_t* a) {
-                            return a->type == 'a' ? (a->val.a.len + 1) : 1; };
-                        // the const-ness does not matter
-                        write_msg(lcur,
-                            const_cast<rtosc_arg_val_t*>(rcur),
-                            get_sz(lcur), get_sz(rcur));
-                    }
-
-                    rtosc_arg_val_itr_next(&litr);
-                    rtosc_arg_val_itr_next(&ritr);
-                };
-
-                char* old_end_noconst = const_cast<char*>(port_from_base);
-
-                // iterate over the whole array
-                bundle_foreach(*p, p->name, old_end_noconst, port_buffer,
-                               base, NULL, NULL,
-                               write_msg_adaptor, true);
-
-                // glue the old end behind old_end_noconst again
-                refix_old_end(p, old_end_noconst);
+            // iterate over the whole array
+            bundle_foreach(*p, p->name, old_end_noconst, port_buffer,
+                           base, NULL, NULL,
+                           write_msg_adaptor, true);
+
+            // glue the old end behind old_end_noconst again
+            refix_old_end(p, old_end_noconst);
 
-            }
-            else
-            {
-                write_msg(arg_vals_default, arg_vals_runtime,
-                          nargs_default, nargs_runtime);
-            }
         }
-    };
+        else
+        {
+            write_msg(arg_vals_default, arg_vals_runtime,
+                      nargs_default, nargs_runtime);
+        }
+    }
+}
+
+bool root_is_enabled(const Ports& ports, void* runtime)
+{
+    char port_buffer[buffersize] = "/";
+    return port_is_enabled(ports["self:"], port_buffer, buffersize, ports,
+                           runtime);
+}
+
+std::vector<walk_job_t> top_level_jobs(const Ports& ports)
+{
+    std::vector<walk_job_t> jobs;
+    for(const Port& p : ports)
+    {
+        const char* hash = strchr(p.name, '#');
+        if(p.ports && hash)
+            for(int i = 0, max = atoi(hash + 1); i < max; ++i)
+                jobs.push_back(walk_job_t{&p, i});
+        else
+            jobs.push_back(walk_job_t{&p, -1});
+    }
+    return jobs;
+}
+
+void print_job(const Ports& ports, void* runtime, const walk_job_t& job,
+               bool binary, std::string& text)
+{
+    trace::scope_t scope("savefile", "print subtree");
+    char name_buffer[buffersize];
+    memset(name_buffer, 0, buffersize);
+    name_buffer[0] = '/';
+    text.clear();
+    changed_values_sink_t res { append_to_string, &text, true, false, binary };
+    walk_port(&ports, *job.port, name_buffer, buffersize,
+              &res, on_reach_port, false, runtime, job.index);
+}
+
+bool write_texts(const std::vector<std::string>& texts,
+                 changed_values_sink_t& res)
+{
+    for(const std::string& text : texts)
+    {
+        if(text.empty())
+            continue;
+        if(!res.binary && !res.first && res.sink("\n", 1, res.data))
+            return false;
+        res.first = false;
+        if(res.sink(text.data(), text.length(), res.data))
+            return false;
+    }
+    return true;
+}
+
+bool write_changed_values(const Ports& ports, void* runtime,
+                          changed_values_sink_t& res,
+                          WorkerPool* pool)
+{
+    trace::scope_t scope("savefile", "save values");
+    char port_buffer[buffersize];
+    memset(port_buffer, 0, buffersize); // requirement for walk_ports
+
+    if(!pool)
+    {
+        walk_ports(&ports, port_buffer, buffersize, &res, on_reach_port, false,
+                   runtime);
+        return !res.failed;
+    }
+
+    if(!root_is_enabled(ports, runtime))
+        return true;
+    std::vector<walk_job_t> jobs = top_level_jobs(ports);
+    std::vector<std::string> texts(jobs.size());
+    pool->run(jobs.size(), [&](size_t job, unsigned)
+    {
+        print_job(ports, runtime, jobs[job], res.binary, texts[job]);
+    });
+    return write_texts(texts, res);
+}
+}
+
+std::string get_changed_values(const Ports& ports, void* runtime)
+{
+    std::string res;
+    get_changed_values(ports, runtime, append_to_string, &res);
+    return res;
+}
 
-    walk_ports(&ports, port_buffer, buffersize, &res, on_reach_port, false,
-               runtime);
+bool get_changed_values_parallel(const Ports& ports, void* runtime,
+                                 rtosc_print_sink sink, void* sink_data,
+                                 unsigned threads)
+{
+    if(!threads)
+        return get_changed_values_parallel(ports, runtime, WorkerPool::shared(),
+                                           sink, sink_data);
+    WorkerPool pool(threads);
+    return get_changed_values_parallel(ports, runtime, pool, sink, sink_data);
+}
 
-    if(res.length()) // remove trailing newline
-        res.resize(res.length()-1);
+bool get_changed_values_parallel(const Ports& ports, void* runtime,
+                                 WorkerPool& pool,
+                                 rtosc_print_sink sink, void* sink_data)
+{
+    changed_values_sink_t res { sink, sink_data, true, false, false };
+    return write_changed_values(ports, runtime, res, &pool);
+}
+
+std::string get_changed_values_parallel(const Ports& ports, void* runtime,
+                                        unsigned threads)
+{
+    std::string res;
+    get_changed_values_parallel(ports, runtime, append_to_string, &res,
+                                threads);
     return res;
 }
 
@@ -296,24 +572,228 @@ int savefile_dispatcher_t::on_dispatch(size_t, char *,
     return default_response(nargs, round2, dependency);
 }
 
+namespace {
+    //! messages of one batch of the fast path
+    constexpr std::size_t max_batch = 256;
+
+    //! same as savefile_dispatcher_t::dependency_t
+    int dependency_of(const Port* port)
+    {
+        return port ? !!port->meta()["default depends"] : 2;
+    }
+}
+
+void savefile_dispatcher_t::set_versions(rtosc_version rtosc_file,
+                                         rtosc_version app_file)
+{
+    rtosc_filever = rtosc_file;
+    app_filever = app_file;
+    const bool current = !rtosc_version_cmp(rtosc_filever, rtosc_curver) &&
+                         !rtosc_version_cmp(app_filever, app_curver);
+    active_fast_path = current ? fast_path() : no_fast_path;
+    batch.clear(); // left by an aborted load
+    batch_offsets.clear();
+}
+
+bool savefile_dispatcher_t::in_round(const char* portname, int nargs,
+                                     bool round2) const
+{
+    const dependency_t dependency =
+        (dependency_t)dependency_of(ports->apropos(portname));
+    return default_response(nargs, round2, dependency) != discard;
+}
+
+bool savefile_dispatcher_t::send(const char* msg)
+{
+    if(active_fast_path == no_fast_path)
+        return (*this)(msg);
+    if(active_fast_path == direct_dispatch)
+        return savefile_dispatcher_t::do_dispatch(msg);
+
+    const std::size_t len = rtosc_message_length(msg, -1);
+    batch_offsets.push_back(batch.size());
+    batch.insert(batch.end(), msg, msg + len);
+    return batch_offsets.size() < max_batch || flush();
+}
+
+bool savefile_dispatcher_t::flush(void)
+{
+    if(batch_offsets.empty())
+        return true;
+    std::vector<const char*> msgs;
+    msgs.reserve(batch_offsets.size());
+    for(std::size_t offset : batch_offsets)
+        msgs.push_back(batch.data() + offset);
+
+    RtData d;
+    d.obj = runtime;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    ports->dispatch_batch(msgs.data(), msgs.size(), d);
+    const bool ok = d.matches >= (int)msgs.size();
+    batch.clear();
+    batch_offsets.clear();
+    return ok;
+}
+
+bool savefile_dispatcher_t::dispatch_arg_vals(char* portname,
+                                              size_t portname_max,
+                                              const rtosc_arg_val_t* args,
+                                              int nargs, bool round2)
+{
+    if(active_fast_path != no_fast_path)
+        return !in_round(portname, nargs, round2) ||
+               send_arg_vals(portname, args, nargs);
+
+    bool ok = true;
+    // nargs << 1 is usually too much, but it allows the user to use
+    // these values (using on_dispatch())
+    size_t maxargs = std::max(nargs << 1, 16);
+    STACKALLOC(rtosc_arg_val_t, arg_vals, maxargs);
+    std::copy(args, args + nargs, arg_vals);
+
+    savefile_dispatcher_t::dependency_t dependency =
+        (savefile_dispatcher_t::dependency_t)
+        dependency_of(ports->apropos(portname));
+
+    // let the user modify the message and the args
+    // the argument number may have changed, or the user
+    // wants to discard the message or abort the savefile loading
+    nargs = on_dispatch(portname_max, portname,
+                        maxargs, nargs, arg_vals,
+                        round2, dependency);
+
+    if(nargs == savefile_dispatcher_t::abort)
+        ok = false;
+    else if(nargs != savefile_dispatcher_t::discard)
+        ok = send_arg_vals(portname, arg_vals, nargs);
+    return ok;
+}
+
+bool savefile_dispatcher_t::send_arg_vals(char* portname,
+                                          const rtosc_arg_val_t* arg_vals,
+                                          int nargs)
+{
+    char message[buffersize];
+    bool ok = true;
+    const rtosc_arg_val_t* arg_val_ptr;
+    bool is_array;
+    if(nargs && arg_vals[0].type == 'a')
+    {
+        is_array = true;
+        // arrays of arrays are not yet supported -
+        // neither by rtosc_*message, nor by the inner for
+        // loop below.
+        // arrays will probably have an 'a' (or #)
+        assert(arg_vals[0].val.a.type != 'a' &&
+               arg_vals[0].val.a.type != '#');
+        // we won't read the array arg val anymore
+        --nargs;
+        arg_val_ptr = arg_vals + 1;
+    }
+    else {
+        is_array = false;
+        arg_val_ptr = arg_vals;
+    }
+
+    char* portname_end = portname + strlen(portname);
+
+    rtosc_arg_val_itr itr;
+    rtosc_arg_val_t buffer;
+    const rtosc_arg_val_t* cur;
+
+    rtosc_arg_val_itr_init(&itr, arg_val_ptr);
+
+    // for bundles, send each element separately
+    // for non-bundles, send all elements at once
+    // (messages without arguments are sent once)
+    for(size_t arr_idx = 0;
+        (!arr_idx || itr.i < (size_t)nargs) && ok; ++arr_idx)
+    {
+        // this will fail for arrays of arrays,
+        // since it only copies one arg val
+        // (arrays are not yet specified)
+        size_t i;
+        const size_t last_pos = itr.i;
+        const size_t elem_limit = is_array
+              ? 1 : std::numeric_limits<int>::max();
+
+        // equivalent to the for loop below, in order to
+        // find out the array size
+        size_t val_max = 0;
+        {
+            rtosc_arg_val_itr itr2 = itr;
+            for(val_max = 0;
+                itr2.i - last_pos < (size_t)nargs &&
+                    val_max < elem_limit;
+                ++val_max)
+            {
+                rtosc_arg_val_itr_next(&itr2);
+            }
+        }
+        STACKALLOC(rtosc_arg_t, vals, val_max);
+        STACKALLOC(char, argstr, val_max+1);
+
+        for(i = 0;
+            itr.i - last_pos < (size_t)nargs &&
+                i < elem_limit;
+            ++i)
+        {
+            cur = rtosc_arg_val_itr_get(&itr, &buffer);
+            vals[i] = cur->val;
+            argstr[i] = cur->type;
+            rtosc_arg_val_itr_next(&itr);
+        }
+
+        argstr[i] = 0;
+
+        if(is_array)
+            snprintf(portname_end, 8, "%d", (int)arr_idx);
+
+        rtosc_amessage(message, buffersize, portname,
+                       argstr, vals);
+
+        ok = send(message);
+    }
+    return ok;
+}
+
 int dispatch_printed_messages(const char* messages,
                               const Ports& ports, void* runtime,
                               savefile_dispatcher_t* dispatcher)
 {
     constexpr std::size_t buffersize = 8192;
-    char portname[buffersize], message[buffersize], strbuf[buffersize];
-    int rd, rd_total = 0;
-    int nargs;
+    trace::scope_t scope("savefile", "load messages");
+    char portname[buffersize];
+    int rd_total = 0;
     int msgs_read = 0;
     bool ok = true;
 
     savefile_dispatcher_t dummy_dispatcher;
+    // the default hooks do what the fast path does
+    dummy_dispatcher.active_fast_path = savefile_dispatcher_t::direct_dispatch;
     if(!dispatcher)
         dispatcher = &dummy_dispatcher;
     dispatcher->ports = &ports;
     dispatcher->runtime = runtime;
 
-    // scan all messages twice:
+    // messages are only scanned once, in the first round; the second round
+    // dispatches them from the arena
+    struct scanned_message_t
+    {
+        std::size_t portname; //!< offset in portnames
+        std::size_t first_arg; //!< offset in the arena
+        int nargs;
+        int rd;
+    };
+    std::vector<scanned_message_t> scanned;
+    std::string portnames;
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    // savefiles repeat strings, like enum names, for many ports
+    rtosc_arg_val_arena_intern(&arena, true);
+
+    // dispatch all messages twice:
     //  * in the second round, only dispatch those with ports that depend on
     //    other ports
     //  * in the first round, only dispatch all others
@@ -321,120 +801,39 @@ int dispatch_printed_messages(const char* messages,
     {
         msgs_read = 0;
         rd_total = 0;
-        const char* msg_ptr = messages;
-        while(*msg_ptr && ok)
+        if(round)
+        {
+            for(const scanned_message_t& scanned_msg : scanned)
+            {
+                fast_strcpy(portname, portnames.data() + scanned_msg.portname,
+                            buffersize);
+                rd_total += scanned_msg.rd;
+                ok = dispatcher->dispatch_arg_vals(
+                         portname, buffersize,
+                         arena.args + scanned_msg.first_arg,
+                         scanned_msg.nargs, round);
+                if(!ok)
+                    break;
+                ++msgs_read;
+            }
+        }
+        else for(const char* msg_ptr = messages; *msg_ptr && ok; )
         {
-            nargs = rtosc_count_printed_arg_vals_of_msg(msg_ptr);
+            size_t rd;
+            const std::size_t first_arg = arena.nargs;
+            int nargs = rtosc_scan_message_arena(msg_ptr, portname, buffersize,
+                                                 &arena, &rd);
             if(nargs >= 0)
             {
-                // nargs << 1 is usually too much, but it allows the user to use
-                // these values (using on_dispatch())
-                size_t maxargs = std::max(nargs << 1, 16);
-                STACKALLOC(rtosc_arg_val_t, arg_vals, maxargs);
-                rd = rtosc_scan_message(msg_ptr, portname, buffersize,
-                                        arg_vals, nargs, strbuf, buffersize);
                 rd_total += rd;
+                scanned.push_back(scanned_message_t{portnames.size(), first_arg,
+                                                    nargs, (int)rd});
+                portnames += portname;
+                portnames += '\0';
 
-                const Port* port = ports.apropos(portname);
-                savefile_dispatcher_t::dependency_t dependency =
-                    (savefile_dispatcher_t::dependency_t)
-                    (port
-                    ? !!port->meta()["default depends"]
-                    : (int)savefile_dispatcher_t::not_specified);
-
-                // let the user modify the message and the args
-                // the argument number may have changed, or the user
-                // wants to discard the message or abort the savefile loading
-                nargs = dispatcher->on_dispatch(buffersize, portname,
-                                                maxargs, nargs, arg_vals,
-                                                round, dependency);
-
-                if(nargs == savefile_dispatcher_t::abort)
-                    ok = false;
-                else
-                {
-                    if(nargs != savefile_dispatcher_t::discard)
-                    {
-                        const rtosc_arg_val_t* arg_val_ptr;
-                        bool is_array;
-                        if(nargs && arg_vals[0].type == 'a')
-                        {
-                            is_array = true;
-                            // arrays of arrays are not yet supported -
-                            // neither by rtosc_*message, nor by the inner for
-                            // loop below.
-                            // arrays will probably have an 'a' (or #)
-                            assert(arg_vals[0].val.a.type != 'a' &&
-                                   arg_vals[0].val.a.type != '#');
-                            // we won't read the array arg val anymore
-                            --nargs;
-                            arg_val_ptr = arg_vals + 1;
-                        }
-                        else {
-                            is_array = false;
-                            arg_val_ptr = arg_vals;
-                        }
-
-                        char* portname_end = portname + strlen(portname);
-
-                        rtosc_arg_val_itr itr;
-                        rtosc_arg_val_t buffer;
-                        const rtosc_arg_val_t* cur;
-
-                        rtosc_arg_val_itr_init(&itr, arg_val_ptr);
-
-                        // for bundles, send each element separately
-                        // for non-bundles, send all elements at once
-                        for(size_t arr_idx = 0;
-                            itr.i < (size_t)std::max(nargs,1) && ok; ++arr_idx)
-                        {
-                            // this will fail for arrays of arrays,
-                            // since it only copies one arg val
-                            // (arrays are not yet specified)
-                            size_t i;
-                            const size_t last_pos = itr.i;
-                            const size_t elem_limit = is_array
-                                  ? 1 : std::numeric_limits<int>::max();
-
-                            // equivalent to the for loop below, in order to
-                            // find out the array size
-                            size_t val_max = 0;
-                            {
-                                rtosc_arg_val_itr itr2 = itr;
-                                for(val_max = 0;
-                                    itr2.i - last_pos < (size_t)nargs &&
-                                        val_max < elem_limit;
-                                    ++val_max)
-                                {
-                                    rtosc_arg_val_itr_next(&itr2);
-                                }
-                            }
-                            STACKALLOC(rtosc_arg_t, vals, val_max);
-                            STACKALLOC(char, argstr, val_max+1);
-
-                            for(i = 0;
-                                itr.i - last_pos < (size_t)nargs &&
-                                    i < elem_limit;
-                                ++i)
-                            {
-                                cur = rtosc_arg_val_itr_get(&itr, &buffer);
-                                vals[i] = cur->val;
-                                argstr[i] = cur->type;
-                                rtosc_arg_val_itr_next(&itr);
-                            }
-
-                            argstr[i] = 0;
-
-                            if(is_array)
-                                snprintf(portname_end, 8, "%d", (int)arr_idx);
-
-                            rtosc_amessage(message, buffersize, portname,
-                                           argstr, vals);
-
-                            ok = (*dispatcher)(message);
-                        }
-                    }
-                }
+                ok = dispatcher->dispatch_arg_vals(portname, buffersize,
+                                                   arena.args + first_arg,
+                                                   nargs, round);
 
                 msg_ptr += rd;
                 ++msgs_read;
@@ -449,14 +848,19 @@ int dispatch_printed_messages(const char* messages,
                 ok = false;
             }
         }
+        ok = ok && dispatcher->flush();
     }
+
+    rtosc_arg_val_arena_destroy(&arena);
     return ok ? msgs_read : -rd_total-1;
 }
 
-std::string save_to_file(const Ports &ports, void *runtime,
-                         const char *appname, rtosc_version appver)
+namespace {
+//! write the header of a text savefile
+bool write_header(const char *appname, rtosc_version appver,
+                  rtosc_print_sink sink, void* sink_data)
 {
-    std::string res;
+    std::string header;
     char rtosc_vbuf[12], app_vbuf[12];
 
     {
@@ -465,64 +869,855 @@ std::string save_to_file(const Ports &ports, void *runtime,
         rtosc_version_print_to_12byte_str(&appver, app_vbuf);
     }
 
-    res += "% RT OSC v"; res += rtosc_vbuf; res += " savefile\n"
-           "% "; res += appname; res += " v"; res += app_vbuf; res += "\n";
-    res += get_changed_values(ports, runtime);
+    header += "% RT OSC v"; header += rtosc_vbuf; header += " savefile\n"
+              "% "; header += appname; header += " v"; header += app_vbuf;
+    header += "\n";
+    return !sink(header.data(), header.length(), sink_data);
+}
+}
+
+bool save_to_file(const Ports &ports, void *runtime,
+                  const char *appname, rtosc_version appver,
+                  rtosc_print_sink sink, void* sink_data)
+{
+    return write_header(appname, appver, sink, sink_data) &&
+           get_changed_values(ports, runtime, sink, sink_data);
+}
 
+std::string save_to_file(const Ports &ports, void *runtime,
+                         const char *appname, rtosc_version appver)
+{
+    std::string res;
+    save_to_file(ports, runtime, appname, appver, append_to_string, &res);
     return res;
 }
 
+changed_values_cache_t::changed_values_cache_t(const Ports& ports,
+                                               ChangeTracker& tracker)
+    :ports(ports), tracker(tracker)
+{
+    for(const walk_job_t& job : top_level_jobs(ports))
+        jobs.push_back(job_t{job.port, job.index,
+                             tracker.unit(job.port, job.index)});
+    texts.resize(jobs.size());
+}
+
+bool changed_values_cache_t::get_changed_values(void* runtime,
+                                                rtosc_print_sink sink,
+                                                void* sink_data)
+{
+    if(!root_is_enabled(ports, runtime))
+        return true;
+
+    // fetch each flag once, since multiple jobs can share a unit
+    std::vector<ChangeTracker::state_t> states(tracker.units());
+    for(std::size_t unit = 0; unit < states.size(); ++unit)
+        states[unit] = tracker.fetch_state(unit);
+
+    for(std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        switch(states[jobs[i].unit])
+        {
+            case ChangeTracker::changed:
+                print_job(ports, runtime,
+                          walk_job_t{jobs[i].port, jobs[i].index},
+                          false, texts[i]);
+                break;
+            case ChangeTracker::at_defaults:
+                // nothing differs from the defaults, so there is no need to
+                // walk the subtree
+                texts[i].clear();
+                break;
+            case ChangeTracker::unchanged:
+                break;
+        }
+    }
+
+    changed_values_sink_t res { sink, sink_data, true, false, false };
+    return write_texts(texts, res);
+}
+
+std::string changed_values_cache_t::get_changed_values(void* runtime)
+{
+    std::string res;
+    get_changed_values(runtime, append_to_string, &res);
+    return res;
+}
+
+bool changed_values_cache_t::save_to_file(void* runtime, const char* appname,
+                                          rtosc_version appver,
+                                          rtosc_print_sink sink,
+                                          void* sink_data)
+{
+    return write_header(appname, appver, sink, sink_data) &&
+           get_changed_values(runtime, sink, sink_data);
+}
+
+std::string changed_values_cache_t::save_to_file(void* runtime,
+                                                 const char* appname,
+                                                 rtosc_version appver)
+{
+    std::string res;
+    save_to_file(runtime, appname, appver, append_to_string, &res);
+    return res;
+}
+
+namespace {
+    /*
+        scan the two header lines of a text savefile
+        returns the number of bytes read, or the negated number of bytes
+        read until the erroneous line minus one
+    */
+    int scan_text_header(const char* file_content, const char* appname,
+                         rtosc_version* rtosc_filever,
+                         rtosc_version* app_filever)
+    {
+        char appbuf[128];
+        int bytes_read = 0;
+        unsigned vma, vmi, vre;
+        int n = 0;
+
+        sscanf(file_content,
+               "%% RT OSC v%u.%u.%u savefile%n ", &vma, &vmi, &vre, &n);
+        if(n <= 0 || vma > 255 || vmi > 255 || vre > 255)
+            return -bytes_read-1;
+        *rtosc_filever = rtosc_version {(unsigned char)vma,
+                                        (unsigned char)vmi,
+                                        (unsigned char)vre};
+        file_content += n;
+        bytes_read += n;
+        n = 0;
+
+        sscanf(file_content,
+               "%% %128s v%u.%u.%u%n ", appbuf, &vma, &vmi, &vre, &n);
+        if(n <= 0 || strcmp(appbuf, appname) ||
+           vma > 255 || vmi > 255 || vre > 255)
+            return -bytes_read-1;
+        *app_filever = rtosc_version {(unsigned char)vma,
+                                      (unsigned char)vmi,
+                                      (unsigned char)vre};
+        bytes_read += n;
+        return bytes_read;
+    }
+}
+
 int load_from_file(const char* file_content,
                    const Ports& ports, void* runtime,
                    const char* appname,
                    rtosc_version appver,
                    savefile_dispatcher_t* dispatcher)
 {
-    char appbuf[128];
-    int bytes_read = 0;
+    rtosc_version rtosc_filever, app_filever;
+    int bytes_read = scan_text_header(file_content, appname,
+                                      &rtosc_filever, &app_filever);
+    if(bytes_read < 0)
+        return bytes_read;
 
     if(dispatcher)
     {
         dispatcher->app_curver = appver;
         dispatcher->rtosc_curver = rtosc_current_version();
+        dispatcher->set_versions(rtosc_filever, app_filever);
     }
 
-    unsigned vma, vmi, vre;
-    int n = 0;
-
-    sscanf(file_content,
-           "%% RT OSC v%u.%u.%u savefile%n ", &vma, &vmi, &vre, &n);
-    if(n <= 0 || vma > 255 || vmi > 255 || vre > 255)
-        return -bytes_read-1;
+    int rval = dispatch_printed_messages(file_content + bytes_read,
+                                         ports, runtime, dispatcher);
     if(dispatcher)
+        dispatcher->active_fast_path = savefile_dispatcher_t::no_fast_path;
+    return (rval < 0) ? (rval-bytes_read) : rval;
+}
+
+namespace {
+//! write the header of a binary savefile
+bool write_binary_header(const char *appname, rtosc_version appver,
+                         rtosc_print_sink sink, void* sink_data)
+{
+    std::string header(binary_magic, binary_magic_len);
+    rtosc_version rtoscver = rtosc_current_version();
+    for(const rtosc_version& v : { rtoscver, appver })
     {
-        dispatcher->rtosc_filever.major = vma;
-        dispatcher->rtosc_filever.minor = vmi;
-        dispatcher->rtosc_filever.revision = vre;
+        header += (char)v.major;
+        header += (char)v.minor;
+        header += (char)v.revision;
+        header += '\0';
     }
-    file_content += n;
-    bytes_read += n;
-    n = 0;
+    header += appname;
+    header.append(4 - header.size() % 4, '\0');
+    return !sink(header.data(), header.length(), sink_data);
+}
+}
 
-    sscanf(file_content,
-           "%% %128s v%u.%u.%u%n ", appbuf, &vma, &vmi, &vre, &n);
-    if(n <= 0 || strcmp(appbuf, appname) || vma > 255 || vmi > 255 || vre > 255)
-        return -bytes_read-1;
+bool save_to_binary_file(const Ports &ports, void *runtime,
+                         const char *appname, rtosc_version appver,
+                         rtosc_print_sink sink, void* sink_data)
+{
+    if(!write_binary_header(appname, appver, sink, sink_data))
+        return false;
 
-    if(dispatcher)
+    changed_values_sink_t res { sink, sink_data, true, false, true };
+    return write_changed_values(ports, runtime, res);
+}
+
+std::string save_to_binary_file(const Ports &ports, void *runtime,
+                                const char *appname, rtosc_version appver)
+{
+    std::string res;
+    save_to_binary_file(ports, runtime, appname, appver,
+                        append_to_string, &res);
+    return res;
+}
+
+bool is_binary_savefile(const char* file_content, size_t size)
+{
+    return size >= binary_magic_len &&
+           !memcmp(file_content, binary_magic, binary_magic_len);
+}
+
+namespace {
+    //! check that the message has no nested or unbalanced array tags
+    bool valid_array_tags(const char* msg)
     {
-        dispatcher->app_filever.major = vma;
-        dispatcher->app_filever.minor = vmi;
-        dispatcher->app_filever.revision = vre;
+        bool in_array = false;
+        for(const char* tags = rtosc_argument_string(msg); *tags; ++tags)
+        {
+            if(*tags == '[' || *tags == ']')
+            {
+                if(in_array == (*tags == '['))
+                    return false;
+                in_array = !in_array;
+            }
+        }
+        return !in_array;
     }
-    file_content += n;
-    bytes_read += n;
-    n = 0;
 
-    int rval = dispatch_printed_messages(file_content,
-                                         ports, runtime, dispatcher);
-    return (rval < 0) ? (rval-bytes_read) : rval;
+    //! convert the args of a message into arg vals, arrays become 'a'
+    void arg_vals_of_message(const char* msg,
+                             std::vector<rtosc_arg_val_t>& args)
+    {
+        args.clear();
+        rtosc_arg_itr_t itr = rtosc_itr_begin(msg);
+        std::size_t array_start = 0;
+        for(const char* tags = rtosc_argument_string(msg); *tags; ++tags)
+        {
+            if(*tags == '[')
+            {
+                array_start = args.size();
+                args.push_back(rtosc_arg_val_t());
+                args.back().type = 'a';
+            }
+            else if(*tags == ']')
+            {
+                rtosc_arg_val_t& arr = args[array_start];
+                arr.val.a.len = args.size() - array_start - 1;
+                arr.val.a.type = arr.val.a.len ? args[array_start + 1].type
+                                               : 'i';
+            }
+            else
+                args.push_back(rtosc_itr_next(&itr));
+        }
+    }
+}
+
+int load_from_binary_file(const char* file_content, size_t size,
+                          const Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher)
+{
+    const unsigned char* u = (const unsigned char*)file_content;
+    trace::scope_t scope("savefile", "load binary");
+    std::size_t pos = binary_magic_len;
+
+    savefile_dispatcher_t dummy_dispatcher;
+    // the default hooks do what the fast path does
+    dummy_dispatcher.active_fast_path = savefile_dispatcher_t::direct_dispatch;
+    if(!dispatcher)
+        dispatcher = &dummy_dispatcher;
+    dispatcher->ports = &ports;
+    dispatcher->runtime = runtime;
+    dispatcher->app_curver = appver;
+    dispatcher->rtosc_curver = rtosc_current_version();
+
+    if(!is_binary_savefile(file_content, size) || size < pos + 8)
+        return -1;
+    if(dispatcher != &dummy_dispatcher)
+        dispatcher->set_versions(rtosc_version { u[pos], u[pos+1], u[pos+2] },
+                                 rtosc_version { u[pos+4], u[pos+5], u[pos+6] });
+    pos += 8;
+
+    const char* name_end =
+        (const char*)memchr(file_content + pos, 0, size - pos);
+    if(!name_end || strcmp(file_content + pos, appname))
+        return -(int)pos-1;
+    pos = name_end - file_content;
+    pos += 4 - pos % 4;
+
+    // check all messages before dispatching any of them
+    std::vector<std::size_t> msg_offsets;
+    while(pos < size)
+    {
+        if(size - pos < 4)
+            return -(int)pos-1;
+        std::size_t len = ((std::size_t)u[pos] << 24) | (u[pos+1] << 16) |
+                          (u[pos+2] << 8) | u[pos+3];
+        const char* msg = file_content + pos + 4;
+        if(len > size - pos - 4 || !rtosc_valid_message_p(msg, len) ||
+           strlen(msg) >= buffersize || !valid_array_tags(msg))
+            return -(int)pos-1;
+        msg_offsets.push_back(pos);
+        pos += 4 + len;
+    }
+
+    // dispatch all messages twice, like dispatch_printed_messages()
+    char portname[buffersize];
+    std::vector<rtosc_arg_val_t> args;
+    int rval = msg_offsets.size();
+    for(int round = 0; round < 2 && rval >= 0; ++round)
+    {
+        for(std::size_t offset : msg_offsets)
+        {
+            const char* msg = file_content + offset + 4;
+            bool ok;
+            if(dispatcher->active_fast_path !=
+                   savefile_dispatcher_t::no_fast_path &&
+               !strchr(rtosc_argument_string(msg), '['))
+            {
+                // the message can be dispatched as it is
+                ok = !dispatcher->in_round(msg, rtosc_narguments(msg),
+                                           round) ||
+                     dispatcher->send(msg);
+            }
+            else
+            {
+                arg_vals_of_message(msg, args);
+                fast_strcpy(portname, msg, buffersize);
+                ok = dispatcher->dispatch_arg_vals(portname, buffersize,
+                                                   args.data(), args.size(),
+                                                   round);
+            }
+            if(!ok) {
+                rval = -(int)offset-1;
+                break;
+            }
+        }
+        if(rval >= 0 && !dispatcher->flush())
+            rval = -(int)msg_offsets.back()-1;
+    }
+    dispatcher->active_fast_path = savefile_dispatcher_t::no_fast_path;
+    return rval;
 }
 
+namespace {
+    //! bytes between two calls of the progress callback
+    constexpr std::size_t progress_step = 1 << 16;
+
+    /*
+        read-only mapping of a whole file, followed by at least one zero
+        byte, so the text scanner finds the end of the file
+    */
+    class mapped_file_t
+    {
+        char* map = nullptr;
+        std::size_t len = 0, mapped = 0;
+        std::string copy; //!< file content if it can not be mapped
+
+    public:
+        explicit mapped_file_t(int fd)
+        {
+            struct stat st;
+            if(fstat(fd, &st) || !S_ISREG(st.st_mode))
+                return;
+            len = st.st_size;
+#ifndef _WIN32
+            const std::size_t page = sysconf(_SC_PAGESIZE);
+            mapped = (len / page + 1) * page;
+            // the file's last page is filled up with zeros, and the
+            // anonymous mapping adds zeros if the file ends at a page
+            void* area = mmap(nullptr, mapped, PROT_READ,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(area == MAP_FAILED)
+                return;
+            if(len && mmap(area, len, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                           fd, 0) == MAP_FAILED)
+            {
+                munmap(area, mapped);
+                return;
+            }
+            if(len)
+                madvise(area, len, MADV_SEQUENTIAL);
+            map = (char*)area;
+#else
+            copy.resize(len);
+            std::size_t got = 0;
+            for(int rd; got < len; got += rd)
+                if((rd = read(fd, &copy[got], len - got)) <= 0)
+                    return;
+            map = &copy[0];
+#endif
+        }
+        ~mapped_file_t()
+        {
+#ifndef _WIN32
+            if(map)
+                munmap(map, mapped);
+#endif
+        }
+        mapped_file_t(const mapped_file_t&) = delete;
+
+        const char* data() const { return map; }
+        std::size_t size() const { return len; }
+    };
+
+    //! report progress, at most once per progress_step bytes
+    class progress_reporter_t
+    {
+        savefile_progress_cb cb;
+        void* data;
+        std::size_t total, next = 0;
+    public:
+        progress_reporter_t(savefile_progress_cb cb, void* data,
+                            std::size_t total)
+            : cb(cb), data(data), total(total) {}
+        //! @return false if loading shall be aborted
+        bool operator()(int round, std::size_t done, bool force = false)
+        {
+            if(!cb || (done < next && !force))
+                return true;
+            next = done + progress_step;
+            return cb(round, done, total, data);
+        }
+        void restart() { next = 0; }
+    };
 }
 
+int load_from_file_mapped(int fd,
+                          const Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher,
+                          savefile_progress_cb progress,
+                          void* progress_data)
+{
+    mapped_file_t file(fd);
+    const char* content = file.data();
+    const std::size_t size = file.size();
+    if(!content || size > (std::size_t)std::numeric_limits<int>::max())
+        return -1;
+    progress_reporter_t report(progress, progress_data, size);
+
+    if(is_binary_savefile(content, size))
+    {
+        // nothing to parse, the messages are only checked
+        int rval = load_from_binary_file(content, size, ports, runtime,
+                                         appname, appver, dispatcher);
+        report(1, size, true);
+        return rval;
+    }
+
+    savefile_dispatcher_t dummy_dispatcher;
+    // the default hooks do what the fast path does
+    dummy_dispatcher.active_fast_path = savefile_dispatcher_t::direct_dispatch;
+    if(!dispatcher)
+        dispatcher = &dummy_dispatcher;
+    dispatcher->ports = &ports;
+    dispatcher->runtime = runtime;
+    dispatcher->app_curver = appver;
+    dispatcher->rtosc_curver = rtosc_current_version();
+
+    rtosc_version rtosc_filever, app_filever;
+    int header = scan_text_header(content, appname,
+                                  &rtosc_filever, &app_filever);
+    if(header < 0)
+        return header;
+    if(dispatcher != &dummy_dispatcher)
+        dispatcher->set_versions(rtosc_filever, app_filever);
+
+    // unlike dispatch_printed_messages(), only the message offsets are
+    // kept; the second round scans the messages again from the mapping, so
+    // the memory does not grow with the size of the values
+    char portname[buffersize];
+    std::vector<std::size_t> msg_offsets;
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    int rval = 0;
+
+    for(std::size_t pos = header; content[pos] && rval >= 0; )
+    {
+        size_t rd;
+        rtosc_arg_val_arena_clear(&arena);
+        int nargs = rtosc_scan_message_arena(content + pos,
+                                             portname, buffersize,
+                                             &arena, &rd);
+        if(nargs == std::numeric_limits<int>::min())
+            break; // the rest of the file is whitespace only
+        if(nargs < 0)
+        {
+            rval = -(int)pos-1;
+            break;
+        }
+        msg_offsets.push_back(pos);
+        pos += rd;
+        if(!dispatcher->dispatch_arg_vals(portname, buffersize,
+                                          arena.args, nargs, false) ||
+           !report(0, pos))
+            rval = -(int)pos-1;
+    }
+    if(rval >= 0 && !dispatcher->flush())
+        rval = -(int)msg_offsets.back()-1;
+    if(rval >= 0 && !report(0, size, true))
+        rval = -(int)size-1;
+
+    report.restart();
+    for(std::size_t i = 0; i < msg_offsets.size() && rval >= 0; ++i)
+    {
+        const std::size_t pos = msg_offsets[i];
+        size_t rd;
+        rtosc_arg_val_arena_clear(&arena);
+        int nargs = rtosc_scan_message_arena(content + pos,
+                                             portname, buffersize,
+                                             &arena, &rd);
+        if(!dispatcher->dispatch_arg_vals(portname, buffersize,
+                                          arena.args, nargs, true) ||
+           !report(1, pos + rd))
+            rval = -(int)(pos + rd)-1;
+    }
+    if(rval >= 0 && !dispatcher->flush())
+        rval = -(int)msg_offsets.back()-1;
+    if(rval >= 0 && !report(1, size, true))
+        rval = -(int)size-1;
+
+    dispatcher->active_fast_path = savefile_dispatcher_t::no_fast_path;
+    rtosc_arg_val_arena_destroy(&arena);
+    return rval < 0 ? rval : (int)msg_offsets.size();
+}
+
+int load_from_file_mapped(const char* path,
+                          const Ports& ports, void* runtime,
+                          const char* appname,
+                          rtosc_version appver,
+                          savefile_dispatcher_t* dispatcher,
+                          savefile_progress_cb progress,
+                          void* progress_data)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return -1;
+    int rval = load_from_file_mapped(fd, ports, runtime, appname, appver,
+                                     dispatcher, progress, progress_data);
+    close(fd);
+    return rval;
+}
+
+bool savefile_link_dispatcher_t::do_dispatch(const char* msg)
+{
+    const size_t len = rtosc_message_length(msg, -1);
+    if(len > link.max_message_length())
+        return false;
+    // the reader makes space while the file is still being parsed
+    while(!link.can_write(len))
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    link.raw_write(msg);
+    return true;
+}
+
+namespace {
+    //! whether @p p is saved and has a default value to compare with
+    bool has_default(const Port* p, const Ports& base)
+    {
+        const Port::MetaContainer meta = base.meta(*p);
+        return is_saved_port(p, &base) &&
+               (meta[Port::meta_default] || meta[Port::meta_default_depends]);
+    }
+
+    void count_saved_ports(const Port* p, const char*, const char*,
+                           const Ports& base, void* data, void*)
+    {
+        if(has_default(p, base))
+            ++*(std::size_t*)data;
+    }
+}
+
+values_snapshot_t::values_snapshot_t(const Ports& ports, std::size_t capacity,
+                                     std::size_t max_args)
+    :ports(ports), buffer(capacity), used(0), overflow(false),
+     name_buffer(buffersize), loc(buffersize), query(buffersize),
+     args(max_args), osc_args(max_args), tags(max_args + 1),
+     enabled_cache(new WalkEnabledCache)
+{
+    // the static walk visits each port which capture() can visit
+    std::size_t max_entries = 0;
+    walk_ports(&ports, name_buffer.data(), buffersize, &max_entries,
+               count_saved_ports, true, NULL);
+    entries.reserve(max_entries);
+}
+
+values_snapshot_t::~values_snapshot_t()
+{
+    delete enabled_cache;
+}
+
+void values_snapshot_t::on_capture(const Port* p, const char* port_buffer,
+                                   const char* port_from_base,
+                                   const Ports& base,
+                                   void* data, void* runtime)
+{
+    values_snapshot_t& snap = *(values_snapshot_t*)data;
+    if(snap.overflow || !has_default(p, base))
+        return;
+    if(snap.entries.size() == snap.entries.capacity())
+    {
+        snap.overflow = true;
+        return;
+    }
+
+    // the path until the port's Ports is the location to dispatch at
+    const std::size_t base_len = port_from_base - port_buffer;
+    memcpy(snap.loc.data(), port_buffer, base_len);
+    snap.loc[base_len] = 0;
+    size_t nargs = helpers::get_value_from_runtime(runtime, *p, buffersize,
+                                                   snap.loc.data(),
+                                                   port_from_base,
+                                                   snap.query.data(),
+                                                   buffersize,
+                                                   snap.args.size(),
+                                                   snap.args.data());
+    for(size_t i = 0; i < nargs; ++i)
+    {
+        snap.tags[i] = snap.args[i].type;
+        snap.osc_args[i] = snap.args[i].val;
+    }
+    snap.tags[nargs] = 0;
+
+    char* const dest = snap.buffer.data() + snap.used;
+    const std::size_t len = rtosc_amessage(dest, snap.buffer.size() -
+                                                 snap.used,
+                                           port_buffer, snap.tags.data(),
+                                           snap.osc_args.data());
+    if(!len)
+    {
+        snap.overflow = true;
+        return;
+    }
+    snap.entries.push_back(entry_t{p, snap.used, base_len});
+    snap.used += len;
+}
+
+bool values_snapshot_t::capture(void* runtime)
+{
+    used = 0;
+    overflow = false;
+    entries.clear();
+    name_buffer[0] = 0;
+    enabled_cache->install();
+    walk_ports(&ports, name_buffer.data(), buffersize, this, on_capture,
+               true, runtime);
+    enabled_cache->uninstall();
+    return !overflow;
+}
+
+namespace {
+    //! the captured replies of a snapshot, and lookup of their paths
+    class snapshot_values_t
+    {
+    public:
+        template<class Entries>
+        snapshot_values_t(const char* buffer, const Entries& entries)
+        {
+            for(const auto& e : entries)
+                by_path.emplace(buffer + e.offset, buffer + e.offset);
+        }
+
+        //! the captured reply for @p path, or NULL
+        const char* find(const char* path) const
+        {
+            auto itr = by_path.find(path);
+            return itr == by_path.end() ? nullptr : itr->second;
+        }
+
+    private:
+        std::unordered_map<std::string, const char*> by_path;
+    };
+
+    //! like get_default_value(), resolving dependencies from the snapshot
+    const char* snapshot_default(const Ports& ports, const Port* p,
+                                 const char* path,
+                                 const snapshot_values_t& values)
+    {
+        const Port::MetaContainer meta = p->meta();
+        const char* dependent = meta["default depends"];
+        if(!dependent)
+            return meta["default"];
+
+        char dependent_path[buffersize];
+        snprintf(dependent_path, buffersize, "%s/../%s", path, dependent);
+        const char* dependent_msg =
+            values.find(Ports::collapsePath(dependent_path));
+        if(!dependent_msg)
+        {
+            // the dependency has not been captured, so it has its default
+            return get_default_value(path + 1, ports, NULL, p);
+        }
+
+        rtosc_arg_val_t dependent_value;
+        dependent_value.type = rtosc_type(dependent_msg, 0);
+        dependent_value.val = rtosc_argument(dependent_msg, 0);
+        char default_variant[32] = "default ";
+        // the printer requires a whitespace in front of the value
+        char value_buf[20] = " ";
+        rtosc_print_arg_vals(&dependent_value, 1, value_buf + 1,
+                             sizeof(value_buf) - 1, NULL, 0);
+        strncat(default_variant, value_buf + 1,
+                sizeof(default_variant) - strlen(default_variant) - 1);
+        const char* rval = meta[default_variant];
+        return rval ? rval : meta["default"];
+    }
+
+    //! scan and canonicalize a default value
+    int scan_default(const Port* p, const char* pretty,
+                     std::vector<rtosc_arg_val_t>& args,
+                     std::vector<char>& strbuf)
+    {
+        int nargs = rtosc_count_printed_arg_vals(pretty);
+        assert(nargs > 0); // parse error => error in the metadata?
+        args.resize(nargs);
+        strbuf.resize(strlen(pretty) + 1);
+        rtosc_scan_arg_vals(pretty, args.data(), nargs,
+                            strbuf.data(), strbuf.size());
+        canonicalize_arg_vals(args.data(), nargs, strchr(p->name, ':'),
+                              p->meta());
+        return nargs;
+    }
+}
+
+bool values_snapshot_t::write_values(rtosc_print_sink sink, void* sink_data,
+                                     bool binary) const
+{
+    if(overflow)
+        return false;
+
+    changed_values_sink_t res { sink, sink_data, true, false, binary };
+    const snapshot_values_t values(buffer.data(), entries);
+    std::vector<rtosc_arg_val_t> defaults, runtime_vals, element;
+    std::vector<char> strbuf;
+
+    for(std::size_t i = 0; i < entries.size() && !res.failed; )
+    {
+        const entry_t& entry = entries[i];
+        const Port* p = entry.port;
+        const char* msg = buffer.data() + entry.offset;
+        const char* pretty = snapshot_default(ports, p, msg, values);
+        if(!pretty)
+        {
+            ++i;
+            continue;
+        }
+        int ndefaults = scan_default(p, pretty, defaults, strbuf);
+
+        const char* hash = strchr(p->name, '#');
+        if(hash && !strchr(hash, '/'))
+        {
+            // all elements of the array are captured one after another,
+            // and, like in get_changed_values(), they are saved as one
+            // array with the address before the '#'
+            std::size_t end = i;
+            runtime_vals.assign(1, rtosc_arg_val_t());
+            for(; end < entries.size() && entries[end].port == p &&
+                  entries[end].base_len == entry.base_len &&
+                  !memcmp(buffer.data() + entries[end].offset, msg,
+                          entry.base_len);
+                ++end)
+            {
+                arg_vals_of_message(buffer.data() + entries[end].offset,
+                                    element);
+                runtime_vals.insert(runtime_vals.end(),
+                                    element.begin(), element.end());
+            }
+            runtime_vals[0].type = 'a';
+            runtime_vals[0].val.a.len = runtime_vals.size() - 1;
+            runtime_vals[0].val.a.type = runtime_vals.size() > 1
+                                       ? runtime_vals[1].type : 'i';
+
+            std::string address(msg, entry.base_len);
+            address.append(p->name, hash - p->name);
+            write_changed_message(&res, p->meta(), address.c_str(),
+                                  defaults.data(), ndefaults,
+                                  runtime_vals.data(), runtime_vals.size());
+            i = end;
+            continue;
+        }
+
+        arg_vals_of_message(msg, runtime_vals);
+        if(hash && defaults[0].type == 'a')
+        {
+            // an element of an array with subports, like "a#N/b",
+            // is compared with its element of the default array
+            rtosc_arg_val_itr itr;
+            rtosc_arg_val_t range_buffer;
+            rtosc_arg_val_itr_init(&itr, defaults.data() + 1);
+            // the index follows the port's name until the '#'
+            for(int idx = atoi(msg + entry.base_len + (hash - p->name));
+                idx > 0; --idx)
+                rtosc_arg_val_itr_next(&itr);
+            const rtosc_arg_val_t* def = rtosc_arg_val_itr_get(&itr,
+                                                               &range_buffer);
+            write_changed_message(&res, p->meta(), msg, def, 1,
+                                  runtime_vals.data(), runtime_vals.size());
+        }
+        else
+            write_changed_message(&res, p->meta(), msg,
+                                  defaults.data(), ndefaults,
+                                  runtime_vals.data(), runtime_vals.size());
+        ++i;
+    }
+    return !res.failed;
+}
+
+bool values_snapshot_t::get_changed_values(rtosc_print_sink sink,
+                                           void* sink_data) const
+{
+    return write_values(sink, sink_data, false);
+}
+
+std::string values_snapshot_t::get_changed_values() const
+{
+    std::string res;
+    get_changed_values(append_to_string, &res);
+    return res;
+}
+
+bool values_snapshot_t::save_to_file(const char* appname,
+                                     rtosc_version appver,
+                                     rtosc_print_sink sink,
+                                     void* sink_data) const
+{
+    return !overflow && write_header(appname, appver, sink, sink_data) &&
+           write_values(sink, sink_data, false);
+}
+
+std::string values_snapshot_t::save_to_file(const char* appname,
+                                            rtosc_version appver) const
+{
+    std::string res;
+    save_to_file(appname, appver, append_to_string, &res);
+    return res;
+}
+
+bool values_snapshot_t::save_to_binary_file(const char* appname,
+                                            rtosc_version appver,
+                                            rtosc_print_sink sink,
+                                            void* sink_data) const
+{
+    return !overflow &&
+           write_binary_header(appname, appver, sink, sink_data) &&
+           write_values(sink, sink_data, true);
+}
+
+std::string values_snapshot_t::save_to_binary_file(const char* appname,
+                                                   rtosc_version appver) const
+{
+    std::string res;
+    save_to_binary_file(appname, appver, append_to_string, &res);
+    return res;
+}
+
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstring>
+
+#include <rtosc/arg-val-cmp.h>
+#include <rtosc/ports.h>
+#include <rtosc/ports-runtime.h>
+#include <rtosc/state-hash.h>
+
+namespace rtosc {
+
+namespace {
+    constexpr std::size_t buffersize = 8192;
+    constexpr std::size_t max_arg_vals = 2048;
+
+    //! whether the value of parameter @p p can be queried
+    bool is_hashed_port(const Port* p, const Ports& base)
+    {
+        const Port::MetaContainer meta = base.meta(*p);
+        const char* colon = strchr(p->name, ':');
+        return colon && colon[1] &&
+               (p->name[strlen(p->name)-1] == ':' || strstr(p->name, "::")) &&
+               meta.find(Port::meta_parameter) != meta.end();
+    }
+
+    std::uint64_t combine_children(const std::vector<StateHash::node_t>& nodes,
+                                   std::size_t i)
+    {
+        std::uint64_t h = 0;
+        for(std::size_t j = i + 1; j < nodes[i].end; j = nodes[j].end)
+            h = rtosc_hash_combine(h, nodes[j].hash);
+        return h;
+    }
+
+    //! state of StateHash::build()
+    struct builder_t
+    {
+        explicit builder_t(std::vector<StateHash::node_t>& nodes)
+            :nodes(nodes), open{0}, paths{"/"},
+             loc(buffersize), query(buffersize), args(max_arg_vals)
+        {}
+
+        //! finish the innermost open subtree
+        void close(void)
+        {
+            const std::size_t i = open.back();
+            nodes[i].end = nodes.size();
+            nodes[i].hash = combine_children(nodes, i);
+            open.pop_back();
+            paths.pop_back();
+        }
+
+        //! add the port at the absolute @p path, in walk order
+        void add(const char* path, std::uint64_t hash)
+        {
+            // close the subtrees which do not contain path
+            while(open.size() > 1 &&
+                  strncmp(path, paths.back().c_str(), paths.back().size()))
+                close();
+            // open the subtrees between the innermost open one and the port
+            const char* seg = path + paths.back().size();
+            const char* slash;
+            while((slash = strchr(seg, '/')))
+            {
+                open.push_back(nodes.size());
+                paths.emplace_back(path, slash + 1);
+                nodes.push_back(StateHash::node_t{std::string(seg, slash + 1),
+                                                  0, 0});
+                seg = slash + 1;
+            }
+            nodes.push_back(StateHash::node_t{seg, hash, nodes.size() + 1});
+        }
+
+        std::vector<StateHash::node_t>& nodes;
+        std::vector<std::size_t> open;  //!< indices of the open subtrees
+        std::vector<std::string> paths; //!< absolute paths of open subtrees
+        std::vector<char> loc, query;
+        std::vector<rtosc_arg_val_t> args;
+    };
+
+    void hash_port(const Port* p, const char* port_buffer,
+                   const char* port_from_base, const Ports& base,
+                   void* data, void* runtime)
+    {
+        if(!is_hashed_port(p, base))
+            return;
+        builder_t& b = *(builder_t*)data;
+
+        // the path until the port's Ports is the location to dispatch at
+        const std::size_t base_len = port_from_base - port_buffer;
+        memcpy(b.loc.data(), port_buffer, base_len);
+        b.loc[base_len] = 0;
+        size_t nargs = helpers::get_value_from_runtime(runtime, *p, buffersize,
+                                                       b.loc.data(),
+                                                       port_from_base,
+                                                       b.query.data(),
+                                                       buffersize,
+                                                       max_arg_vals,
+                                                       b.args.data());
+        b.add(port_buffer,
+              canonical_hash(port_buffer, b.args.data(), nargs, *p, base));
+    }
+}
+
+std::uint64_t canonical_hash(const char* address, rtosc_arg_val_t* av,
+                             std::size_t size, const Port& port,
+                             const Ports& base)
+{
+    const char* port_args = strchr(port.name, ':');
+    if(port_args)
+        canonicalize_arg_vals(av, size, port_args, base.meta(port));
+    return rtosc_avmessage_hash(address, av, size);
+}
+
+StateHash::StateHash(void)
+    :m_nodes{node_t{"/", 0, 1}}
+{}
+
+StateHash::StateHash(const Ports& root, void* runtime)
+{
+    build(root, runtime);
+}
+
+void StateHash::build(const Ports& root, void* runtime)
+{
+    m_nodes.clear();
+    m_nodes.push_back(node_t{"/", 0, 0});
+
+    builder_t b(m_nodes);
+    std::vector<char> name_buffer(buffersize);
+    walk_ports(&root, name_buffer.data(), buffersize, &b, hash_port, true,
+               runtime);
+    while(!b.open.empty())
+        b.close();
+}
+
+std::uint64_t StateHash::root(void) const
+{
+    return m_nodes[0].hash;
+}
+
+std::size_t StateHash::find(const char* path) const
+{
+    if(*path == '/')
+        ++path;
+    std::size_t i = 0;
+    while(*path)
+    {
+        const std::size_t len = strcspn(path, "/") + (strchr(path, '/') != 0);
+        std::size_t j = i + 1;
+        for(; j < m_nodes[i].end; j = m_nodes[j].end)
+            if(m_nodes[j].name.size() == len &&
+               !strncmp(m_nodes[j].name.c_str(), path, len))
+                break;
+        if(j >= m_nodes[i].end)
+            return m_nodes.size();
+        i = j;
+        path += len;
+    }
+    return i;
+}
+
+std::uint64_t StateHash::at(const char* path) const
+{
+    std::size_t i = find(path);
+    return i < m_nodes.size() ? m_nodes[i].hash : 0;
+}
+
+std::vector<std::string> StateHash::diff(const StateHash& other) const
+{
+    std::vector<std::string> res;
+    std::string path;
+    diff(0, other, 0, path, res);
+    return res;
+}
+
+void StateHash::leaves(std::size_t i, std::string& path,
+                       std::vector<std::string>& res) const
+{
+    const std::size_t path_len = path.size();
+    path += m_nodes[i].name;
+    if(m_nodes[i].end == i + 1 && path.back() != '/')
+        res.push_back(path);
+    for(std::size_t j = i + 1; j < m_nodes[i].end; j = m_nodes[j].end)
+        leaves(j, path, res);
+    path.resize(path_len);
+}
+
+void StateHash::diff(std::size_t i, const StateHash& other, std::size_t j,
+                     std::string& path, std::vector<std::string>& res) const
+{
+    const std::vector<node_t>& rhs = other.m_nodes;
+    if(m_nodes[i].hash == rhs[j].hash)
+        return;
+    const std::size_t path_len = path.size();
+    path += m_nodes[i].name;
+    if(m_nodes[i].end == i + 1 && rhs[j].end == j + 1)
+    {
+        res.push_back(path);
+        path.resize(path_len);
+        return;
+    }
+
+    // both trees were usually built from the same ports, so the children
+    // are searched from the last match on
+    std::vector<std::size_t> matched;
+    std::size_t first_rhs = j + 1, next_rhs = first_rhs;
+    for(std::size_t c = i + 1; c < m_nodes[i].end; c = m_nodes[c].end)
+    {
+        std::size_t found = rhs.size();
+        for(std::size_t pass = 0; pass < 2 && found == rhs.size(); ++pass)
+        {
+            std::size_t d = pass ? first_rhs : next_rhs,
+                        stop = pass ? next_rhs : rhs[j].end;
+            for(; d < stop; d = rhs[d].end)
+                if(rhs[d].name == m_nodes[c].name) {
+                    found = d;
+                    break;
+                }
+        }
+        if(found == rhs.size())
+            leaves(c, path, res);
+        else
+        {
+            diff(c, other, found, path, res);
+            matched.push_back(found);
+            next_rhs = rhs[found].end;
+        }
+    }
+    std::sort(matched.begin(), matched.end());
+    for(std::size_t d = first_rhs; d < rhs[j].end; d = rhs[d].end)
+        if(!std::binary_search(matched.begin(), matched.end(), d))
+            other.leaves(d, path, res);
+    path.resize(path_len);
+}
+
+}
@@ -0,0 +1,231 @@
+#include <rtosc/stream-framer.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "udp-pool.h"
+
+namespace rtosc {
+
+using helpers::valid_datagram;
+
+static const unsigned char SLIP_END     = 0xc0;
+static const unsigned char SLIP_ESC     = 0xdb;
+static const unsigned char SLIP_ESC_END = 0xdc;
+static const unsigned char SLIP_ESC_ESC = 0xdd;
+
+static size_t ring_size(StreamFramer::framing_t framing, size_t max_msg,
+                        size_t capacity)
+{
+    const size_t min = StreamFramer::max_framed_length(framing, max_msg);
+    if(!capacity)
+        capacity = 4*max_msg;
+    return capacity < min ? min : capacity;
+}
+
+StreamFramer::StreamFramer(framing_t framing, size_t max_message_length,
+                           size_t capacity)
+    :Framing(framing), MaxMsg(max_message_length),
+     Capacity(ring_size(framing, max_message_length, capacity)),
+     ring(new char[Capacity]), wrap_buffer(new char[MaxMsg ? MaxMsg : 1]),
+     stat_dropped(0)
+{
+    reset();
+}
+
+StreamFramer::~StreamFramer(void)
+{
+    delete[] ring;
+    delete[] wrap_buffer;
+}
+
+void StreamFramer::reset(void)
+{
+    head = tail = scan = skip = unescaped = 0;
+    escaped = skipping = false;
+}
+
+char *StreamFramer::write_space(size_t *len)
+{
+    const size_t pos  = tail % Capacity;
+    const size_t free = Capacity - (tail - head);
+    *len = free < Capacity - pos ? free : Capacity - pos;
+    return ring + pos;
+}
+
+void StreamFramer::commit(size_t len)
+{
+    tail += len;
+}
+
+ssize_t StreamFramer::read_from(int fd)
+{
+    size_t len;
+    char *space = write_space(&len);
+    if(!len) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    ssize_t ret;
+    do
+        ret = ::read(fd, space, len);
+    while(ret == -1 && errno == EINTR);
+    if(ret > 0)
+        commit(ret);
+    return ret;
+}
+
+/*
+ * Pass the bytes [start, start+len) of the stream, which are contiguous
+ * unless they wrap around the end of the ring
+ */
+bool StreamFramer::deliver(size_t start, size_t len, read_cb_t cb,
+                           void *data)
+{
+    const size_t pos = start % Capacity;
+    const char  *msg = ring + pos;
+    if(pos + len > Capacity) {
+        const size_t first = Capacity - pos;
+        memcpy(wrap_buffer, ring + pos, first);
+        memcpy(wrap_buffer + first, ring, len - first);
+        msg = wrap_buffer;
+    }
+    if(!valid_datagram(msg, len)) {
+        ++stat_dropped;
+        return false;
+    }
+    cb(msg, len, data);
+    return true;
+}
+
+/*
+ * scan is the start of the next length, which is read again if the message
+ * is not complete yet. Oversized messages are skipped without storing them.
+ */
+size_t StreamFramer::parse_length_prefix(read_cb_t cb, void *data)
+{
+    size_t n = 0;
+    for(;;) {
+        if(skip) {
+            const size_t avail = tail - scan;
+            const size_t k     = skip < avail ? skip : avail;
+            scan += k;
+            skip -= k;
+            head  = scan;
+            if(skip)
+                break;
+            continue;
+        }
+        if(tail - scan < 4)
+            break;
+        const size_t len = ((size_t)at(scan)   << 24) |
+                           ((size_t)at(scan+1) << 16) |
+                           ((size_t)at(scan+2) <<  8) |
+                            (size_t)at(scan+3);
+        if(len > MaxMsg) {
+            ++stat_dropped;
+            skip  = len;
+            scan += 4;
+            head  = scan;
+            continue;
+        }
+        if(tail - scan - 4 < len)
+            break;
+        n += deliver(scan+4, len, cb, data);
+        scan += 4 + len;
+        head  = scan;
+    }
+    return n;
+}
+
+/*
+ * The current message starts at head. Its unescaped bytes are written back
+ * to [head, unescaped), which never overtakes the scan position, so no byte
+ * is scanned twice. After an oversized message has been detected, its bytes
+ * are skipped up to the next END.
+ */
+size_t StreamFramer::parse_slip(read_cb_t cb, void *data)
+{
+    size_t n = 0;
+    while(scan < tail) {
+        unsigned char c = at(scan++);
+        if(c == SLIP_END) {
+            //empty frames are the start of the double END framing
+            if(!skipping && unescaped > head)
+                n += deliver(head, unescaped - head, cb, data);
+            escaped  = false;
+            skipping = false;
+            head = unescaped = scan;
+            continue;
+        }
+        if(escaped) {
+            escaped = false;
+            if(c == SLIP_ESC_END)
+                c = SLIP_END;
+            else if(c == SLIP_ESC_ESC)
+                c = SLIP_ESC;
+        } else if(c == SLIP_ESC) {
+            escaped = true;
+            continue;
+        }
+        if(skipping)
+            continue;
+        if(unescaped - head == MaxMsg) {
+            ++stat_dropped;
+            skipping = true;
+            continue;
+        }
+        ring[unescaped++ % Capacity] = c;
+    }
+    if(skipping)
+        head = unescaped = scan;
+    return n;
+}
+
+size_t StreamFramer::read_all(read_cb_t cb, void *data)
+{
+    return Framing == SLIP ? parse_slip(cb, data)
+                           : parse_length_prefix(cb, data);
+}
+
+size_t StreamFramer::max_framed_length(framing_t framing, size_t len)
+{
+    return framing == SLIP ? 2*len + 2 : len + 4;
+}
+
+size_t StreamFramer::frame(framing_t framing, const char *msg, size_t len,
+                           char *buffer, size_t size)
+{
+    if(framing == LENGTH_PREFIX) {
+        if(size < len + 4 || len > 0xffffffffu)
+            return 0;
+        buffer[0] = (char)(len >> 24);
+        buffer[1] = (char)(len >> 16);
+        buffer[2] = (char)(len >>  8);
+        buffer[3] = (char)len;
+        memcpy(buffer+4, msg, len);
+        return len + 4;
+    }
+
+    size_t pos = 0;
+    if(size < 2)
+        return 0;
+    buffer[pos++] = (char)SLIP_END;
+    for(size_t i=0; i<len; ++i) {
+        const unsigned char c = msg[i];
+        const bool special = c == SLIP_END || c == SLIP_ESC;
+        //one byte more, plus the final END
+        if(pos + special + 2 > size)
+            return 0;
+        if(special) {
+            buffer[pos++] = (char)SLIP_ESC;
+            buffer[pos++] = (char)(c == SLIP_END ? SLIP_ESC_END
+                                                 : SLIP_ESC_ESC);
+        } else
+            buffer[pos++] = (char)c;
+    }
+    buffer[pos++] = (char)SLIP_END;
+    return pos;
+}
+
+}
@@ -0,0 +1,66 @@
+#include <cstring>
+#include <rtosc/ports.h>
+#include <rtosc/string-pool.h>
+
+namespace rtosc {
+
+std::size_t StringPool::metadata_size(const char *metadata)
+{
+    if(!metadata)
+        return 0;
+    // entries are separated by single zeros, two zeros end the metadata
+    const char *itr = metadata;
+    while(*itr || (itr != metadata && itr[-1]))
+        ++itr;
+    return itr - metadata + 1;
+}
+
+const char *StringPool::intern(const char *str, std::size_t size)
+{
+    ++stat.strings;
+    stat.bytes += size;
+    auto res = pool.emplace(str, size);
+    if(res.second) {
+        ++stat.distinct;
+        stat.distinct_bytes += size;
+    }
+    // the pooled string contains the terminating zero(s) itself
+    return res.first->data();
+}
+
+const char *StringPool::intern_name(const char *name)
+{
+    return intern(name, strlen(name) + 1);
+}
+
+const char *StringPool::intern_metadata(const char *metadata)
+{
+    return metadata ? intern(metadata, metadata_size(metadata)) : NULL;
+}
+
+namespace {
+
+void measure_rec(const Ports &ports, StringPool &pool,
+                 std::unordered_set<const Ports*> &seen)
+{
+    if(!seen.insert(&ports).second)
+        return;
+    for(const Port &p : ports) {
+        pool.intern_name(p.name);
+        pool.intern_metadata(p.metadata);
+        if(p.ports)
+            measure_rec(*p.ports, pool, seen);
+    }
+}
+
+}
+
+StringPool::stats_t StringPool::measure(const Ports &root)
+{
+    StringPool pool;
+    std::unordered_set<const Ports*> seen;
+    measure_rec(root, pool, seen);
+    return pool.stats();
+}
+
+}
@@ -0,0 +1,135 @@
+#include <rtosc/subscriptions.h>
+#include <rtosc/pattern-dispatch.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace rtosc {
+
+struct filter_t
+{
+    int             id;
+    std::string     text;
+    bool            all;    //!< "/"
+    bool            prefix; //!< ends with '/'
+    CompiledPattern pattern;
+};
+
+/*
+ * Results of interested() are cached per address. The cache is dropped
+ * whenever the filters change, and when it gets too large, so it never
+ * holds outdated results.
+ */
+struct internal_subscriptions_t
+{
+    std::vector<filter_t> filters;
+    std::unordered_map<std::string, std::vector<int>> cache;
+    enum { max_cache = 4096 };
+};
+
+static bool filter_matches(const filter_t &f, const char *address)
+{
+    if(f.all)
+        return true;
+    const char *p = address + (*address == '/');
+    bool end = false;
+    for(int seg = 0; seg < f.pattern.segments(); ++seg) {
+        if(end)
+            return false;
+        const char *e = strchr(p, '/');
+        if(!e)
+            e = p + strlen(p);
+        if(!f.pattern.match(seg, p, e-p))
+            return false;
+        if(*e == '/')
+            p = e+1;
+        else
+            end = true;
+    }
+    //prefixes match the addresses below, other filters the address itself
+    return f.prefix ? !end && *p : end;
+}
+
+Subscriptions::Subscriptions(void)
+    :impl(new internal_subscriptions_t)
+{}
+
+Subscriptions::~Subscriptions(void)
+{
+    delete impl;
+}
+
+bool Subscriptions::add(int id, const char *filter)
+{
+    filter_t f;
+    f.id     = id;
+    f.text   = filter;
+    f.all    = f.text == "/" || f.text.empty();
+    f.prefix = !f.all && f.text.back() == '/';
+    if(!f.all) {
+        std::string pattern = f.text;
+        if(f.prefix)
+            pattern.pop_back();
+        if(!f.pattern.compile(pattern.c_str()))
+            return false;
+    }
+    impl->filters.push_back(f);
+    impl->cache.clear();
+    return true;
+}
+
+void Subscriptions::remove(int id, const char *filter)
+{
+    auto &v = impl->filters;
+    for(auto itr = v.begin(); itr != v.end(); ++itr) {
+        if(itr->id == id && itr->text == filter) {
+            v.erase(itr);
+            impl->cache.clear();
+            return;
+        }
+    }
+}
+
+void Subscriptions::remove_all(int id)
+{
+    auto &v = impl->filters;
+    v.erase(std::remove_if(v.begin(), v.end(),
+                           [id](const filter_t &f) { return f.id == id; }),
+            v.end());
+    impl->cache.clear();
+}
+
+size_t Subscriptions::filters(int id) const
+{
+    size_t n = 0;
+    for(const filter_t &f : impl->filters)
+        n += f.id == id;
+    return n;
+}
+
+const std::vector<int> &Subscriptions::interested(const char *address)
+{
+    auto itr = impl->cache.find(address);
+    if(itr != impl->cache.end())
+        return itr->second;
+
+    std::vector<int> ids;
+    for(const filter_t &f : impl->filters)
+        if(filter_matches(f, address))
+            ids.push_back(f.id);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    if(impl->cache.size() >= internal_subscriptions_t::max_cache)
+        impl->cache.clear();
+    return impl->cache.emplace(address, std::move(ids)).first->second;
+}
+
+bool Subscriptions::wants(int id, const char *address)
+{
+    const std::vector<int> &ids = interested(address);
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+}
@@ -1,155 +1,220 @@
 #include <rtosc/subtree-serialize.h>
 #include <rtosc/ports.h>
+#include <rtosc/ports-runtime.h>
+#include <rtosc/pretty-format.h>
 #include <rtosc/rtosc.h>
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <string>
+#include <unordered_map>
 
 
 using namespace rtosc;
 
-static void emplace_uint32(uint8_t *buffer, uint32_t d)
-{
-    buffer[0] = ((d>>24) & 0xff);
-    buffer[1] = ((d>>16) & 0xff);
-    buffer[2] = ((d>>8)  & 0xff);
-    buffer[3] = ((d>>0)  & 0xff);
-}
-
-/*
- * Append another message onto a bundle if the space permits it.
- * If insufficient space is available, then zero is returned and the buffer is
- * untouched.
- *
- * If this is useful it may be generalized to rtosc_bundle_append()
- */
-static size_t append_bundle(char *dst, const char *src,
-        size_t max_len, size_t dst_len, size_t src_len)
-{
-    assert(rtosc_message_length(src,src_len) == src_len);
+namespace {
 
-    //Handle Edge case alignment
-    //if(rtosc_bundle_elements(dst, dst_len) == 0)
-    //    dst_len -= 4;
+constexpr uint64_t serialize_tt = 0xdeadbeef0a0b0c0dULL;
+constexpr std::size_t buffersize = 1024;
 
+//A bundle which grows as needed
+struct growable_bundle_t
+{
+    std::vector<char> buffer;
+    rtosc_bundle_writer writer;
+
+    growable_bundle_t(void)
+        :buffer(1024)
+    {
+        rtosc_bundle_writer_begin(&writer, buffer.data(), buffer.size(),
+                                  serialize_tt);
+    }
 
-    if(max_len < dst_len + src_len + 4 || dst_len == 0 || src_len == 0)
-        return 0;
-    emplace_uint32((uint8_t*)(dst+dst_len), src_len);
+    //! make space for at least @p len more bytes
+    void grow(size_t len)
+    {
+        buffer.resize(std::max(2 * buffer.size(), writer.pos + len + 64));
+        writer.buffer = buffer.data();
+        writer.len    = buffer.size();
+    }
 
-    memcpy(dst+dst_len+4, src, src_len);
+    void append(const char *msg, size_t len)
+    {
+        while(!rtosc_bundle_append(&writer, msg, len))
+            grow(len + 4);
+    }
 
-    return dst_len + src_len + 4;
-}
+    std::vector<char> finish(void)
+    {
+        buffer.resize(rtosc_bundle_writer_finish(&writer));
+        return std::move(buffer);
+    }
+};
 
-//This object captures the output of any given port by calling it through a no
-//argument message
-//Assuming that the loc field is set correctly the message stored here will be
-//able to be replayed to get an object to a previous state
-class VarCapture : public RtData
+//Captures the values of all ports of a tree into a bundle. Each port is
+//queried with a message without arguments, at the runtime object which
+//walk_ports() resolved for its parent, and each subtree gets its own
+//sub-bundle. Replaying the messages restores the state.
+struct serializer_t : public growable_bundle_t
 {
-    public:
-        char buf[128];
-        char location[128];
-        char msg[128];
-        const char *dummy;
-        bool success;
-
-        VarCapture(void)
-            :dummy("/ser\0\0\0\0,\0\0\0")
-        {
-            memset(buf, 0, sizeof(buf));
-            memset(location, 0, sizeof(buf));
-            this->loc = location;
-            success = false;
+    //! paths of the open subtrees, and whether they opened a sub-bundle
+    std::vector<std::pair<std::string, bool>> open;
+    char loc[buffersize];
+    char query[buffersize];
+    rtosc_arg_val_arena arena;
+
+    serializer_t(void) { rtosc_arg_val_arena_init(&arena); }
+    ~serializer_t(void) { rtosc_arg_val_arena_destroy(&arena); }
+
+    //! close and open sub-bundles such that @p path is in the innermost one
+    void enter(const char *path)
+    {
+        while(!open.empty() && strncmp(path, open.back().first.c_str(),
+                                       open.back().first.size())) {
+            if(open.back().second)
+                rtosc_bundle_close(&writer);
+            open.pop_back();
         }
-
-        const char *capture(const Ports *p, const char *path, void *obj_)
-        {
-            this->loc = location;
-            assert(this->loc == location);
-            this->obj  = obj_;
-            location[0] = '/';
-            strcpy(location+1, path);
-            success = false;
-            size_t len = rtosc_message(msg, 128, path, "");
-            (void) len;
-            assert(len);
-            assert(!strchr(path, ':'));
-
-            p->dispatch(msg, *this);
-            return success ? buf : NULL;
+        const char *seg = path + (open.empty() ? 1 : open.back().first.size());
+        for(const char *slash; (slash = strchr(seg, '/')); seg = slash + 1) {
+            bool nested = writer.depth < RTOSC_BUNDLE_WRITER_DEPTH;
+            while(nested && !rtosc_bundle_open(&writer, serialize_tt))
+                grow(20);
+            open.emplace_back(std::string(path, slash + 1), nested);
         }
+    }
 
-        virtual void reply(const char *path, const char *args, ...)
-        {
-            assert(!success);
-            assert(*path);
-            va_list va;
-            va_start(va, args);
-            size_t len = rtosc_vmessage(buf, 128, path, args, va);
-            (void) len;
-            assert(len != 0);
-            success = true;
-            va_end(va);
-        }
-        virtual void broadcast(const char *msg)
-        {
-            (void) msg;
-        }
+    void append_values(const char *path, const rtosc_arg_val_t *args,
+                       size_t nargs)
+    {
+        const size_t len = rtosc_avmessage(NULL, 0, path, nargs, args);
+        size_t avail;
+        char *dst;
+        while(!(dst = rtosc_bundle_append_reserve(&writer, &avail)) ||
+              avail < len)
+            grow(len + 4);
+        rtosc_avmessage(dst, avail, path, nargs, args);
+        rtosc_bundle_append_commit(&writer, len);
+    }
+
+    static void on_port(const Port *p, const char *port_buffer,
+                        const char *port_from_base, const Ports &base,
+                        void *data, void *runtime)
+    {
+        if(p->meta().find("internal") != p->meta().end())
+            return;
+        serializer_t &s = *(serializer_t*)data;
+
+        const size_t base_len = port_from_base - port_buffer;
+        memcpy(s.loc, port_buffer, base_len);
+        s.loc[base_len] = 0;
+        if(strlen(port_from_base) + 8 > sizeof(s.query))
+            return;
+        strcpy(s.query, port_from_base);
+
+        rtosc_arg_val_arena_clear(&s.arena);
+        const int nargs = helpers::get_value_from_runtime(runtime, base,
+                                                          sizeof(s.loc), s.loc,
+                                                          s.query,
+                                                          sizeof(s.query),
+                                                          &s.arena);
+        if(nargs <= 0)
+            return; // no value, or out of memory
+        s.enter(port_buffer);
+        s.append_values(port_buffer, s.arena.args, nargs);
+    }
 };
 
-struct subtree_args_t
+}
+
+std::vector<char> subtree_serialize(void *object, const rtosc::Ports &ports)
 {
-    VarCapture v, vv;
-    size_t len;
-    char *buffer;
-    size_t buffer_size;
-    void *object;
-    rtosc::Ports *ports;
-};
+    serializer_t s;
+    char name_buffer[buffersize] = "";
+    //TODO FIXME this is not currently RT safe at the moment
+    walk_ports(&ports, name_buffer, sizeof(name_buffer), &s,
+               serializer_t::on_port, true, object);
+    return s.finish();
+}
 
 size_t subtree_serialize(char *buffer, size_t buffer_size,
         void *object, rtosc::Ports *ports)
 {
-    (void) object;
     assert(buffer);
     assert(ports);
 
-    subtree_args_t args;
-    args.v.obj       = object;
-    args.len         = rtosc_bundle(buffer, buffer_size, 0xdeadbeef0a0b0c0dULL, 0);
-    args.buffer      = buffer;
-    args.buffer_size = buffer_size;
-    args.object      = object;
-    args.ports       = ports;
+    const std::vector<char> bundle = subtree_serialize(object, *ports);
+    if(bundle.size() > buffer_size)
+        return 0;
+    memcpy(buffer, bundle.data(), bundle.size());
+    return bundle.size();
+}
 
+namespace {
+struct path_hash
+{
+    size_t operator()(const char *path) const
+    {
+        // FNV-1a
+        size_t h = 2166136261u;
+        for(; *path; ++path)
+            h = (h ^ (unsigned char)*path) * 16777619u;
+        return h;
+    }
+};
+struct path_eq
+{
+    bool operator()(const char *l, const char *r) const
+    {
+        return !strcmp(l, r);
+    }
+};
+//! the messages of a snapshot, by path
+typedef std::unordered_map<const char*, std::pair<const char*, size_t>,
+                           path_hash, path_eq> snapshot_index_t;
+}
 
-    //TODO FIXME this is not currently RT safe at the moment
-    walk_ports(ports, args.v.loc, 128, &args, [](const Port *p, const char *,
-                                                 const char*,
-                                                 const Ports&, void *dat,
-						 void*) {
-            if(p->meta().find("internal") != p->meta().end())
-                return;
-
-            subtree_args_t *args = (subtree_args_t*) dat;
-
-            const char *buf = args->vv.capture(args->ports, args->v.loc+1, args->object);
-            if(buf)
-                args->len = append_bundle(args->buffer, buf, args->buffer_size, args->len,
-                    rtosc_message_length(buf, 128));
-            });
-
-    return args.len;
+std::vector<char> subtree_diff(const char *from, size_t from_len,
+                               const char *to, size_t to_len)
+{
+    snapshot_index_t index;
+    rtosc_bundle_walk(from, from_len, [](const char *msg, size_t len,
+                                         void *data) {
+            (*(snapshot_index_t*)data)[msg] = std::make_pair(msg, len);
+        }, &index);
+
+    struct diff_t
+    {
+        const snapshot_index_t &index;
+        growable_bundle_t res;
+    } diff{index, {}};
+    rtosc_bundle_walk(to, to_len, [](const char *msg, size_t len, void *data) {
+            diff_t &d = *(diff_t*)data;
+            auto itr = d.index.find(msg);
+            if(itr == d.index.end() || itr->second.second != len ||
+               memcmp(itr->second.first, msg, len))
+                d.res.append(msg, len);
+        }, &diff);
+    return diff.res.finish();
+}
+
+namespace {
+struct replay_t
+{
+    rtosc::Ports *ports;
+    RtData *d;
+};
 }
 
 void subtree_deserialize(char *buffer, size_t buffer_size,
         void *object, rtosc::Ports *ports, RtData &d)
 {
     d.obj = object;
-    //simply replay all objects seen here
-    for(unsigned i=0; i<rtosc_bundle_elements(buffer, buffer_size); ++i) {
-        const char *msg = rtosc_bundle_fetch(buffer, i);
-        ports->dispatch(msg+1, d);
-    }
+    //simply replay all objects seen here, including those of sub-bundles
+    replay_t replay{ports, &d};
+    rtosc_bundle_walk(buffer, buffer_size, [](const char *msg, size_t,
+                                              void *data) {
+            replay_t &r = *(replay_t*)data;
+            r.ports->dispatch(msg+1, *r.d);
+        }, &replay);
 }
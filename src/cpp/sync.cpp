@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <utility>
+
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/subtree-serialize.h>
+#include <rtosc/sync.h>
+
+namespace rtosc {
+
+namespace {
+    //! OSC's "immediately"
+    constexpr uint64_t immediate_tt = 1;
+
+    //! A sync packet, i.e. a bundle which grows as needed
+    struct packet_t
+    {
+        std::vector<char> buffer;
+        rtosc_bundle_writer writer;
+
+        packet_t(const char *path, uint64_t epoch, uint64_t seq)
+            :buffer(1024)
+        {
+            rtosc_bundle_writer_begin(&writer, buffer.data(), buffer.size(),
+                                      immediate_tt);
+            char header[64];
+            const size_t len = rtosc_message(header, sizeof(header), path,
+                                             "hh", (int64_t)epoch,
+                                             (int64_t)seq);
+            append(header, len);
+        }
+
+        void append(const char *msg, size_t len)
+        {
+            while(!rtosc_bundle_append(&writer, msg, len))
+            {
+                buffer.resize(std::max(2 * buffer.size(),
+                                       writer.pos + len + 64));
+                writer.buffer = buffer.data();
+                writer.len    = buffer.size();
+            }
+        }
+
+        std::vector<char> finish(void)
+        {
+            buffer.resize(rtosc_bundle_writer_finish(&writer));
+            return std::move(buffer);
+        }
+    };
+
+    uint64_t make_epoch(void)
+    {
+        std::random_device rd;
+        uint64_t epoch = (uint64_t)rd() << 32 ^ rd() ^
+            std::chrono::steady_clock::now().time_since_epoch().count();
+        return epoch ? epoch : 1;
+    }
+
+    //! pass all messages of a message or bundle to @p apply
+    void apply_all(const char *msg, size_t len,
+                   const SyncClient::apply_t &apply)
+    {
+        rtosc_bundle_walk(msg, len, [](const char *m, size_t l, void *data) {
+                (*(const SyncClient::apply_t*)data)(m, l);
+            }, (void*)&apply);
+    }
+}
+
+SyncServer::SyncServer(const Ports &ports, void *object, size_t capacity)
+    :ports(ports), object(object), capacity(capacity), m_epoch(make_epoch()),
+     next_seq(1), next_id(0)
+{}
+
+void SyncServer::record(const MessageRef &msg)
+{
+    log.push_back(msg);
+    if(log.size() > capacity)
+        log.pop_front();
+    ++next_seq;
+}
+
+void SyncServer::record(const char *msg)
+{
+    record(MessageRef::copy(msg));
+}
+
+Broadcaster::sink_t SyncServer::sink(void)
+{
+    return [this](const MessageRef *msgs, size_t n) {
+        for(size_t i = 0; i < n; ++i)
+            record(msgs[i]);
+    };
+}
+
+bool SyncServer::can_resume(uint64_t seq) const
+{
+    return seq < next_seq && seq + 1 >= next_seq - log.size();
+}
+
+int SyncServer::connect(const char *msg, send_t send)
+{
+    if(strcmp(msg, "/sync/connect"))
+        return -1;
+    const char *args = rtosc_argument_string(msg);
+    std::vector<char> packet;
+    if(!strcmp(args, "hh"))
+    {
+        const uint64_t epoch = rtosc_argument(msg, 0).h,
+                       seq   = rtosc_argument(msg, 1).h;
+        if(epoch == m_epoch)
+            packet = deltas(seq);
+    }
+    else if(*args)
+        return -1;
+
+    if(packet.empty())
+        packet = snapshot();
+    send(packet.data(), packet.size());
+    m_clients.push_back(client_t{next_id, sequence(), std::move(send)});
+    return next_id++;
+}
+
+void SyncServer::disconnect(int id)
+{
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [id](const client_t &c) {
+                                       return c.id == id; }),
+                    m_clients.end());
+}
+
+size_t SyncServer::flush(void)
+{
+    // usually, all clients are at the same sequence number
+    std::vector<std::pair<uint64_t, std::vector<char>>> packets;
+    size_t sent = 0;
+    for(client_t &c : m_clients)
+    {
+        if(c.seq == sequence())
+            continue;
+        auto itr = std::find_if(packets.begin(), packets.end(),
+                                [&c](const std::pair<uint64_t,
+                                                     std::vector<char>> &p) {
+                                    return p.first == c.seq; });
+        if(itr == packets.end())
+        {
+            std::vector<char> packet = deltas(c.seq);
+            // more changes than kept since the last flush
+            if(packet.empty())
+                packet = snapshot();
+            packets.emplace_back(c.seq, std::move(packet));
+            itr = packets.end() - 1;
+        }
+        c.send(itr->second.data(), itr->second.size());
+        c.seq = sequence();
+        ++sent;
+    }
+    return sent;
+}
+
+std::vector<char> SyncServer::snapshot(void) const
+{
+    packet_t packet("/sync/snapshot", m_epoch, sequence());
+    const std::vector<char> values = subtree_serialize(object, ports);
+    packet.append(values.data(), values.size());
+    return packet.finish();
+}
+
+std::vector<char> SyncServer::deltas(uint64_t seq) const
+{
+    if(!can_resume(seq))
+        return std::vector<char>();
+    packet_t packet("/sync/delta", m_epoch, seq + 1);
+    const uint64_t first_kept = next_seq - log.size();
+    for(uint64_t s = seq + 1; s < next_seq; ++s)
+    {
+        const MessageRef &msg = log[s - first_kept];
+        packet.append(msg.data(), msg.size());
+    }
+    return packet.finish();
+}
+
+SyncClient::SyncClient(void)
+    :epoch(0), seq(0), m_synced(false)
+{}
+
+size_t SyncClient::connect_message(char *buffer, size_t len) const
+{
+    return epoch ? rtosc_message(buffer, len, "/sync/connect", "hh",
+                                 (int64_t)epoch, (int64_t)seq)
+                 : rtosc_message(buffer, len, "/sync/connect", "");
+}
+
+bool SyncClient::receive(const char *packet, size_t len, const apply_t &apply)
+{
+    if(!rtosc_bundle_p(packet))
+        return false;
+    rtosc_bundle_itr_t itr = rtosc_bundle_itr_begin(packet, len);
+    if(rtosc_bundle_itr_end(itr))
+        return false;
+    size_t header_len;
+    const char *header = rtosc_bundle_itr_next(&itr, &header_len);
+    if(rtosc_bundle_p(header) || !rtosc_message_length(header, header_len) ||
+       strcmp(rtosc_argument_string(header), "hh"))
+        return false;
+    const uint64_t packet_epoch = rtosc_argument(header, 0).h,
+                   packet_seq   = rtosc_argument(header, 1).h;
+
+    if(!strcmp(header, "/sync/snapshot"))
+    {
+        if(rtosc_bundle_itr_end(itr))
+            return false;
+        size_t values_len;
+        const char *values = rtosc_bundle_itr_next(&itr, &values_len);
+        apply_all(values, values_len, apply);
+        epoch = packet_epoch;
+        seq = packet_seq;
+        m_synced = true;
+        return true;
+    }
+    if(strcmp(header, "/sync/delta"))
+        return false;
+
+    if(!epoch || packet_epoch != epoch || packet_seq > seq + 1)
+    {
+        // changes are missing, but the ones before can still be resumed
+        m_synced = false;
+        return false;
+    }
+    for(uint64_t s = packet_seq; !rtosc_bundle_itr_end(itr); ++s)
+    {
+        size_t msg_len;
+        const char *msg = rtosc_bundle_itr_next(&itr, &msg_len);
+        if(s > seq)
+        {
+            apply_all(msg, msg_len, apply);
+            seq = s;
+        }
+    }
+    m_synced = true;
+    return true;
+}
+
+void SyncClient::reset(void)
+{
+    epoch = 0;
+    seq = 0;
+    m_synced = false;
+}
+
+}
@@ -1,5 +1,26 @@
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
 #include "../../include/rtosc/thread-link.h"
+#include "../../include/rtosc/trace.h"
+#include "../../include/rtosc/ports.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 namespace rtosc {
 #ifdef off_t
@@ -8,133 +29,604 @@ namespace rtosc {
 #define off_t signed long
 
 
-//Ringbuffer internal structure
-struct internal_ringbuffer_t {
-    char *buffer;
+//Size of a cache line, to keep the reader's and the writer's data apart
+#define CACHE_LINE 64
+
+/*
+ * Ringbuffer internal structure
+ *
+ * Each message is stored behind a header with its length, so readers do not
+ * need to scan a message to find its end. With statistics, the header also
+ * holds the time the message was written. Messages may wrap around at the
+ * end of the buffer.
+ *
+ * The writer only stores the write index, the reader only the read index.
+ * Both keep a cached copy of the other index, which only needs to be
+ * reloaded when the cached copy does not show enough data or space.
+ */
+struct link_stats_t {
+    //written by the writer
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<size_t>   peak;
+    char pad0[CACHE_LINE - 2*sizeof(std::atomic<uint64_t>)
+              - sizeof(std::atomic<size_t>)];
+
+    //written by the reader
+    std::atomic<uint64_t> read;
+    std::atomic<uint32_t> latency[ThreadLink::latency_buckets];
+
+    std::atomic<int64_t>  start_ns; //!< time of the last reset
+};
+
+/*
+ * Wakeup channel
+ *
+ * A reader which is about to sleep sets waiting, then checks the ring once
+ * more. A writer only signals the channel if it sees waiting set after
+ * publishing, so writers do not make any system calls while the reader is
+ * busy. The channel is an eventfd on Linux and a pipe on other POSIX
+ * systems. Without either, wait() polls.
+ */
+struct link_wakeup_t {
+    std::atomic<bool> waiting;
+    int fd[2]; //!< read and write end, equal for eventfds
+};
+
+/*
+ * Indices of the ring, which may be shared between processes, so they must
+ * not contain any pointers.
+ */
+struct ring_indices_t {
+    //written by the writer
     std::atomic<off_t> write;
+    off_t read_cache;
+    char pad1[CACHE_LINE - sizeof(std::atomic<off_t>) - sizeof(off_t)];
+
+    //written by the reader
     std::atomic<off_t> read;
+    off_t write_cache;
+    char pad2[CACHE_LINE - sizeof(std::atomic<off_t>) - sizeof(off_t)];
+};
+
+/*
+ * Shared memory segment of a link between processes: this header, followed
+ * by the ring. The indices are lock-free atomics, which work across
+ * processes. Atomics with a lock would keep it in each process' memory, so
+ * they could not be used in the segment.
+ */
+struct shm_segment_t {
+    char     magic[8]; //!< written last, when the segment is set up
+    uint64_t max_message_length;
+    uint64_t max_messages;
+    uint64_t size;
+    uint64_t header;
+    int64_t  owner;    //!< pid of the creating process
+    char pad[CACHE_LINE - 8 - 5*sizeof(uint64_t)];
+
+    ring_indices_t idx;
+};
+
+static_assert(ATOMIC_LONG_LOCK_FREE == 2,
+              "shared links need lock-free atomic indices");
+
+static const char shm_magic[8] = {'r','t','o','s','c','s','h','m'};
+
+struct internal_ringbuffer_t {
+    char *buffer;
+    ring_indices_t *idx;
     size_t size;
+    size_t header;
+    link_stats_t *stats; //!< NULL without statistics
+    link_wakeup_t *wakeup; //!< NULL without wakeup channel
+    size_t options;
+    char *reservation; //!< the pending reserve(), or NULL (writer only)
+
+    alignas(CACHE_LINE) ring_indices_t indices; //!< idx of private links
+
+    shm_segment_t *segment;      //!< mapping of shared links, or NULL
+    size_t         segment_size;
+    char          *shm_name;     //!< to unlink by the creator, or NULL
+
+    //new does not align to CACHE_LINE before C++17
+    static void *operator new(size_t size)
+    {
+        void *mem;
+#ifdef _WIN32
+        mem = _aligned_malloc(size, CACHE_LINE);
+#else
+        if(posix_memalign(&mem, CACHE_LINE, size))
+            mem = NULL;
+#endif
+        if(!mem)
+            throw std::bad_alloc();
+        return mem;
+    }
+    static void operator delete(void *mem)
+    {
+#ifdef _WIN32
+        _aligned_free(mem);
+#else
+        free(mem);
+#endif
+    }
 };
 
 typedef internal_ringbuffer_t ringbuffer_t;
 
-static size_t ring_read_size(ringbuffer_t *ring)
+enum {
+    HEADER       = sizeof(uint32_t),
+    STATS_HEADER = sizeof(uint32_t) + sizeof(int64_t)
+};
+
+static int64_t now_ns(void)
 {
-    const size_t w = ring->write;
-    const size_t r = ring->read;
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+            steady_clock::now().time_since_epoch()).count();
+}
 
+static size_t ring_read_size(const ringbuffer_t *ring, off_t w)
+{
+    const off_t r = ring->idx->read.load(std::memory_order_relaxed);
     return (w-r+ring->size) % ring->size;
 }
-static size_t ring_write_size(ringbuffer_t *ring)
+static size_t ring_write_size(const ringbuffer_t *ring, off_t r)
 {
     //leave one forbidden element
-    const size_t w = ring->write;
-    const size_t r = ring->read;
-    if(r == w)
-        return ring->size - 1;
-    return ((r - w + ring->size) % ring->size) - 1;
+    const off_t w = ring->idx->write.load(std::memory_order_relaxed);
+    return ((r-w+ring->size-1) % ring->size);
 }
-static void ring_write(ringbuffer_t *ring, const char *data, size_t len)
+
+//Writer side: is there space for len bytes?
+static bool ring_can_write(ringbuffer_t *ring, size_t len)
 {
-    assert(ring_write_size(ring) >= len);
-    const off_t  next_write = (ring->write + len)%ring->size;
+    if(ring_write_size(ring, ring->idx->read_cache) >= len)
+        return true;
+    ring->idx->read_cache = ring->idx->read.load(std::memory_order_acquire);
+    return ring_write_size(ring, ring->idx->read_cache) >= len;
+}
 
-    //discontinuous write
-    if(next_write < ring->write) {
-        const size_t w1 = ring->size - ring->write - 1;
-        const size_t w2 = len - w1;
-        memcpy(ring->buffer+ring->write, data,    w1);
-        memcpy(ring->buffer,             data+w1, w2);
-    } else { //contiguous
-        memcpy(ring->buffer+ring->write, data, len);
+//Reader side: pending bytes
+static size_t ring_pending(ringbuffer_t *ring)
+{
+    size_t pending = ring_read_size(ring, ring->idx->write_cache);
+    if(!pending) {
+        ring->idx->write_cache = ring->idx->write.load(std::memory_order_acquire);
+        pending = ring_read_size(ring, ring->idx->write_cache);
     }
-    ring->write = next_write;
+    return pending;
 }
-static void ring_read(ringbuffer_t *ring, char *data, size_t len)
+
+static off_t ring_put(ringbuffer_t *ring, off_t pos, const char *data,
+                      size_t len)
 {
-    assert(ring_read_size(ring) >= len);
-    const off_t  next_read = (ring->read + len)%ring->size;
+    const size_t w1 = ring->size - pos;
+    if(len > w1) { //discontinuous write
+        memcpy(ring->buffer+pos, data,    w1);
+        memcpy(ring->buffer,     data+w1, len-w1);
+    } else { //contiguous
+        memcpy(ring->buffer+pos, data, len);
+    }
+    return (pos+len)%ring->size;
+}
 
-    //discontinuous read
-    if(next_read < ring->read) {
-        const size_t r1 = ring->size - ring->read - 1;
-        const size_t r2 = len - r1;
-        memcpy(data,    ring->buffer+ring->read, r1);
-        memcpy(data+r1, ring->buffer,             r2);
+static off_t ring_get(const ringbuffer_t *ring, off_t pos, char *data,
+                      size_t len)
+{
+    const size_t r1 = ring->size - pos;
+    if(len > r1) { //discontinuous read
+        memcpy(data,    ring->buffer+pos, r1);
+        memcpy(data+r1, ring->buffer,     len-r1);
     } else { //contiguous
-        memcpy(data, ring->buffer+ring->read, len);
+        memcpy(data, ring->buffer+pos, len);
+    }
+    return (pos+len)%ring->size;
+}
+
+//Single writer and single reader, relaxed loads and stores suffice
+static void count(std::atomic<uint64_t> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+}
+
+static void count_drop(ringbuffer_t *ring)
+{
+    if(ring->stats)
+        count(ring->stats->dropped);
+}
+
+static off_t ring_put_header(ringbuffer_t *ring, off_t pos, size_t len)
+{
+    char header[STATS_HEADER];
+    const uint32_t len32 = len;
+    memcpy(header, &len32, sizeof(len32));
+    if(ring->stats) {
+        const int64_t ns = now_ns();
+        memcpy(header+sizeof(len32), &ns, sizeof(ns));
+    }
+    if(trace::active())
+        trace::instant("link", "enqueue", len);
+    return ring_put(ring, pos, header, ring->header);
+}
+
+//Publish everything up to @p pos
+static void ring_publish(ringbuffer_t *ring, off_t pos)
+{
+    ring->idx->write.store(pos, std::memory_order_release);
+    if(link_stats_t *stats = ring->stats) {
+        count(stats->written);
+        const size_t occupancy = ring_read_size(ring, pos);
+        if(occupancy > stats->peak.load(std::memory_order_relaxed))
+            stats->peak.store(occupancy, std::memory_order_relaxed);
+    }
+    if(link_wakeup_t *wakeup = ring->wakeup) {
+        //order the publishing store before loading the reader's flag
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(wakeup->waiting.load(std::memory_order_relaxed) &&
+           wakeup->waiting.exchange(false)) {
+#ifndef _WIN32
+            const uint64_t one = 1;
+            if(::write(wakeup->fd[1], &one,
+                       wakeup->fd[0] == wakeup->fd[1] ? 8 : 1) < 0) {}
+#endif
+        }
+    }
+}
+
+//Read the header at @p pos, @returns the position of its message
+static off_t ring_get_header(ringbuffer_t *ring, off_t pos, uint32_t *len)
+{
+    char header[STATS_HEADER];
+    pos = ring_get(ring, pos, header, ring->header);
+    memcpy(len, header, sizeof(*len));
+    if(trace::active())
+        trace::instant("link", "dequeue", *len);
+    if(link_stats_t *stats = ring->stats) {
+        int64_t written;
+        memcpy(&written, header+sizeof(*len), sizeof(written));
+        int bucket = 0;
+        for(uint64_t t = (now_ns() - written) >> 6;
+            t && bucket < ThreadLink::latency_buckets-1; t >>= 1)
+            ++bucket;
+        stats->latency[bucket].store(
+                stats->latency[bucket].load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        count(stats->read);
     }
-    ring->read = next_read;
+    return pos;
+}
+
+//Write a message and its header, if there is space
+static void ring_write(ringbuffer_t *ring, const char *data, size_t len)
+{
+    if(!len || !ring_can_write(ring, ring->header+len)) {
+        count_drop(ring);
+        return;
+    }
+    off_t pos = ring->idx->write.load(std::memory_order_relaxed);
+    pos = ring_put_header(ring, pos, len);
+    pos = ring_put(ring, pos, data, len);
+    ring_publish(ring, pos);
+}
+
+static char *ring_reserve(ringbuffer_t *ring, size_t max_len,
+                          char *write_buffer)
+{
+    assert(!ring->reservation);
+    if(!ring_can_write(ring, ring->header+max_len))
+        return NULL;
+    const off_t w   = ring->idx->write.load(std::memory_order_relaxed);
+    const off_t pos = (w+ring->header)%ring->size;
+    //messages which would wrap around are built in the write buffer
+    ring->reservation = pos + max_len <= ring->size ? ring->buffer + pos
+                                                    : write_buffer;
+    return ring->reservation;
+}
+
+/*
+ * Buffer allocation
+ *
+ * Locked buffers are mapped separately, so they can be locked without
+ * locking unrelated heap pages. All buffers are prefaulted by clearing them,
+ * which also places them on the NUMA node of the constructing thread.
+ */
+#ifndef _WIN32
+static size_t mapped_size(size_t len, size_t options)
+{
+    const size_t page = options & ThreadLink::huge_pages ? 2u<<20 : 4096;
+    return (len + page - 1) / page * page;
 }
-static void ring_read_vector(ringbuffer_t *ring, ring_t *r)
+#endif
+
+static char *link_alloc(size_t len, size_t options, bool *locked)
 {
-    assert(r);
-    size_t read_size = ring_read_size(ring);
-    off_t  read      = ring->read;
-    r[0].data = ring->buffer+ring->read;
-    if(read_size+read > ring->size) { //discontinuous
-        size_t r2 = (read_size+1+read)%ring->size;
-        size_t r1 = read_size - r2;
-        r[0].len  = r1;
-        r[1].data = ring->buffer;
-        r[1].len  = r2;
-    } else {
-        r[0].len  = read_size;
-        r[1].data = NULL;
-        r[1].len  = 0;
+    char *buf = NULL;
+#ifndef _WIN32
+    if(options & (ThreadLink::lock_memory | ThreadLink::huge_pages)) {
+        void *m = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if(options & ThreadLink::huge_pages)
+            m = mmap(NULL, mapped_size(len, options), PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+        if(m == MAP_FAILED) { //no reserved huge pages, ask for THP
+            m = mmap(NULL, mapped_size(len, options), PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if(m != MAP_FAILED && (options & ThreadLink::huge_pages))
+                madvise(m, mapped_size(len, options), MADV_HUGEPAGE);
+#endif
+        }
+        if(m != MAP_FAILED) {
+            buf = (char*)m;
+            if(options & ThreadLink::lock_memory)
+                *locked &= !mlock(buf, mapped_size(len, options));
+        }
+    }
+#endif
+    if(!buf) {
+        buf = new char[len];
+        *locked &= !(options & ThreadLink::lock_memory);
     }
+    memset(buf, 0, len);
+    return buf;
 }
 
-ThreadLink::ThreadLink(size_t max_message_length, size_t max_messages)
+static void link_free(char *buf, size_t len, size_t options)
+{
+#ifndef _WIN32
+    if(options & (ThreadLink::lock_memory | ThreadLink::huge_pages)) {
+        munmap(buf, mapped_size(len, options));
+        return;
+    }
+#endif
+    delete[] buf;
+}
+
+ThreadLink::ThreadLink(size_t max_message_length, size_t max_messages,
+                       unsigned options)
     :MaxMsg(max_message_length),
     BufferSize(MaxMsg*max_messages),
-    write_buffer(new char[MaxMsg]),
-    read_buffer(new char[MaxMsg]),
     ring(new ringbuffer_t)
 {
-    ring->buffer = new char[BufferSize];
-    ring->size   = BufferSize;
-    ring->read   = 0;
-    ring->write  = 0;
-    memset(write_buffer, 0, MaxMsg);
-    memset(read_buffer, 0, MaxMsg);
+    const bool stats = options & with_stats;
+    //locked or huge page buffers are not allocated with new
+    ring->options     = options;
+#ifdef _WIN32
+    ring->options    &= ~(lock_memory | huge_pages);
+#endif
+    locked            = true;
+    //huge pages only pay off for the ring itself
+    write_buffer      = link_alloc(MaxMsg, ring->options & ~huge_pages,
+                                   &locked);
+    read_buffer       = link_alloc(MaxMsg, ring->options & ~huge_pages,
+                                   &locked);
+
+    //room for the headers and the forbidden element
+    ring->header      = stats ? STATS_HEADER : HEADER;
+    ring->size        = BufferSize + ring->header*max_messages + 1;
+    ring->buffer      = link_alloc(ring->size, ring->options, &locked);
+    ring->segment     = NULL;
+    ring->shm_name    = NULL;
+    ring->idx         = &ring->indices;
+    ring->idx->read        = 0;
+    ring->idx->write       = 0;
+    ring->idx->read_cache  = 0;
+    ring->idx->write_cache = 0;
+    ring->reservation = NULL;
+    ring->stats       = stats ? new link_stats_t : NULL;
+    ring->wakeup      = NULL;
+    reset_stats();
+}
+
+ThreadLink::ThreadLink(void *segment, size_t segment_size, const char *name)
+    :MaxMsg(((shm_segment_t*)segment)->max_message_length),
+    BufferSize(MaxMsg*((shm_segment_t*)segment)->max_messages),
+    locked(true),
+    ring(new ringbuffer_t)
+{
+    shm_segment_t *seg = (shm_segment_t*)segment;
+    ring->options      = 0;
+    write_buffer       = link_alloc(MaxMsg, 0, &locked);
+    read_buffer        = link_alloc(MaxMsg, 0, &locked);
+    ring->header       = seg->header;
+    ring->size         = seg->size;
+    ring->buffer       = (char*)(seg+1);
+    ring->idx          = &seg->idx;
+    ring->segment      = seg;
+    ring->segment_size = segment_size;
+    ring->shm_name     = name ? strdup(name) : NULL;
+    ring->reservation  = NULL;
+    ring->stats        = NULL;
+    ring->wakeup       = NULL;
+}
+
+#ifndef _WIN32
+//whether the segment was set up by a process which does not exist anymore
+static bool shm_stale(const char *name)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    void *m = MAP_FAILED;
+    if(!fstat(fd, &st) && (size_t)st.st_size >= sizeof(shm_segment_t))
+        m = mmap(NULL, sizeof(shm_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED)
+        return false;
+
+    //a segment without the magic may still be set up by its creator
+    const shm_segment_t *seg = (const shm_segment_t*)m;
+    const bool stale = !memcmp(seg->magic, shm_magic, sizeof(shm_magic)) &&
+        kill((pid_t)seg->owner, 0) && errno == ESRCH;
+    munmap(m, sizeof(shm_segment_t));
+    return stale;
+}
+#endif
+
+ThreadLink *ThreadLink::create_shared(const char *name,
+                                      size_t max_message_length,
+                                      size_t max_messages)
+{
+#ifndef _WIN32
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    //a segment left over by a crashed process is replaced, a live one not
+    if(fd < 0 && errno == EEXIST && shm_stale(name)) {
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if(fd < 0)
+        return NULL;
+    const size_t size  = max_message_length*max_messages +
+                         HEADER*max_messages + 1;
+    const size_t total = sizeof(shm_segment_t) + size;
+    void *m = MAP_FAILED;
+    if(!ftruncate(fd, total))
+        m = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    shm_segment_t *seg = (shm_segment_t*)m;
+    seg->max_message_length = max_message_length;
+    seg->max_messages       = max_messages;
+    seg->size               = size;
+    seg->header             = HEADER;
+    seg->owner              = getpid();
+    seg->idx.write          = 0;
+    seg->idx.read           = 0;
+    seg->idx.read_cache     = 0;
+    seg->idx.write_cache    = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(seg->magic, shm_magic, sizeof(shm_magic));
+    return new ThreadLink(m, total, name);
+#else
+    return NULL;
+#endif
+}
+
+ThreadLink *ThreadLink::open_shared(const char *name)
+{
+#ifndef _WIN32
+    const int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0)
+        return NULL;
+    struct stat st;
+    void *m = MAP_FAILED;
+    if(!fstat(fd, &st) && (size_t)st.st_size >= sizeof(shm_segment_t))
+        m = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED)
+        return NULL;
+
+    const shm_segment_t *seg = (const shm_segment_t*)m;
+    const bool valid = !memcmp(seg->magic, shm_magic, sizeof(shm_magic)) &&
+        sizeof(shm_segment_t) + seg->size == (size_t)st.st_size;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(!valid) {
+        munmap(m, st.st_size);
+        return NULL;
+    }
+    return new ThreadLink(m, st.st_size, NULL);
+#else
+    return NULL;
+#endif
 }
 
 ThreadLink::~ThreadLink(void)
 {
-    delete[] ring->buffer;
+#ifndef _WIN32
+    if(ring->segment) {
+        munmap(ring->segment, ring->segment_size);
+        if(ring->shm_name)
+            shm_unlink(ring->shm_name);
+        free(ring->shm_name);
+    } else
+#endif
+    link_free(ring->buffer, ring->size, ring->options);
+    link_free(write_buffer, MaxMsg, ring->options & ~huge_pages);
+    link_free(read_buffer, MaxMsg, ring->options & ~huge_pages);
+    delete   ring->stats;
+    if(ring->wakeup) {
+#ifndef _WIN32
+        close(ring->wakeup->fd[0]);
+        if(ring->wakeup->fd[1] != ring->wakeup->fd[0])
+            close(ring->wakeup->fd[1]);
+#endif
+        delete ring->wakeup;
+    }
     delete   ring;
-    delete[] write_buffer;
-    delete[] read_buffer;
 }
 
 void ThreadLink::write(const char *dest, const char *args, ...)
 {
+    //format in place if there is space for any message, otherwise there
+    //might still be space for this one
+    char *buf = ring_reserve(ring, MaxMsg, write_buffer);
     va_list va;
     va_start(va,args);
     const size_t len =
-        rtosc_vmessage(write_buffer,MaxMsg,dest,args,va);
+        rtosc_vmessage(buf ? buf : write_buffer,MaxMsg,dest,args,va);
     va_end(va);
-    if(ring_write_size(ring) >= len)
+    if(buf)
+        commit(len);
+    else
         ring_write(ring,write_buffer,len);
 }
 
 void ThreadLink::writeArray(const char *dest, const char *args, const rtosc_arg_t *aargs)
 {
+    char *buf = ring_reserve(ring, MaxMsg, write_buffer);
     const size_t len =
-        rtosc_amessage(write_buffer, MaxMsg, dest, args, aargs);
-    if(ring_write_size(ring) >= len)
+        rtosc_amessage(buf ? buf : write_buffer, MaxMsg, dest, args, aargs);
+    if(buf)
+        commit(len);
+    else
         ring_write(ring,write_buffer,len);
 }
 
+char *ThreadLink::reserve(size_t max_len)
+{
+    char *buf = max_len <= MaxMsg ? ring_reserve(ring, max_len, write_buffer)
+                                  : NULL;
+    if(!buf)
+        count_drop(ring);
+    return buf;
+}
+
+void ThreadLink::commit(size_t len)
+{
+    char *reservation = ring->reservation;
+    assert(reservation);
+    ring->reservation = NULL;
+    if(!len)
+        return;
+    if(reservation == write_buffer) {
+        ring_write(ring,write_buffer,len);
+        return;
+    }
+    const off_t w = ring->idx->write.load(std::memory_order_relaxed);
+    ring_put_header(ring, w, len);
+    ring_publish(ring, (w+ring->header+len)%ring->size);
+}
+
 /**
  * Directly write message to ringbuffer
  */
 void ThreadLink::raw_write(const char *msg)
 {
     const size_t len = rtosc_message_length(msg, -1);//assumed valid
-    if(ring_write_size(ring) >= len)
-        ring_write(ring,msg,len);
+    ring_write(ring,msg,len);
+}
+
+bool ThreadLink::can_write(size_t len)
+{
+    return len <= MaxMsg && ring_can_write(ring, ring->header+len);
 }
 
 /**
@@ -142,23 +634,47 @@ void ThreadLink::raw_write(const char *msg)
  */
 bool ThreadLink::hasNext(void) const
 {
-    return ring_read_size(ring);
+    return ring_pending(ring);
 }
 
 /**
  * Read a new message from the ringbuffer
  */
 msg_t ThreadLink::read(void) {
-    ring_t r[2];
-    ring_read_vector(ring,r);
-    const size_t len =
-        rtosc_message_ring_length(r);
-    assert(ring_read_size(ring) >= len);
+    assert(ring_pending(ring) > ring->header);
+    uint32_t len;
+    off_t pos = ring->idx->read.load(std::memory_order_relaxed);
+    pos = ring_get_header(ring, pos, &len);
     assert(len <= MaxMsg);
-    ring_read(ring, read_buffer, len);
+    pos = ring_get(ring, pos, read_buffer, len);
+    ring->idx->read.store(pos, std::memory_order_release);
     return read_buffer;
 }
 
+size_t ThreadLink::read_all(read_cb_t cb, void *data)
+{
+    //only messages pending now, the writer may add more meanwhile
+    ring->idx->write_cache = ring->idx->write.load(std::memory_order_acquire);
+    const off_t end   = ring->idx->write_cache;
+    off_t       pos = ring->idx->read.load(std::memory_order_relaxed);
+
+    size_t n = 0;
+    for(; pos != end; ++n) {
+        uint32_t len;
+        pos = ring_get_header(ring, pos, &len);
+        assert(len <= MaxMsg);
+        if(pos + len <= (off_t)ring->size) //contiguous, pass it in place
+            cb(ring->buffer + pos, len, data);
+        else {
+            ring_get(ring, pos, read_buffer, len);
+            cb(read_buffer, len, data);
+        }
+        pos = (pos+len)%ring->size;
+    }
+    ring->idx->read.store(pos, std::memory_order_release);
+    return n;
+}
+
 /**
  * Peak at last message read without reading another
  */
@@ -176,4 +692,329 @@ char *ThreadLink::buffer(void) {return write_buffer;}
  */
 size_t ThreadLink::buffer_size(void) const {return BufferSize;}
 
+bool ThreadLink::enable_wakeup(void)
+{
+    if(ring->wakeup)
+        return true;
+    if(ring->segment) //the other process could not signal it
+        return false;
+    int fd[2] = {-1, -1};
+#ifdef __linux__
+    fd[0] = fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd[0] < 0)
+        return false;
+#elif !defined(_WIN32)
+    if(pipe(fd))
+        return false;
+    for(int i=0; i<2; ++i) {
+        fcntl(fd[i], F_SETFL, fcntl(fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fd[i], F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    link_wakeup_t *wakeup = new link_wakeup_t;
+    wakeup->waiting = false;
+    wakeup->fd[0]   = fd[0];
+    wakeup->fd[1]   = fd[1];
+    ring->wakeup    = wakeup;
+    return true;
+}
+
+int ThreadLink::wakeup_fd(void) const
+{
+    return ring->wakeup ? ring->wakeup->fd[0] : -1;
+}
+
+bool ThreadLink::arm_wakeup(void)
+{
+    link_wakeup_t *wakeup = ring->wakeup;
+    if(!wakeup)
+        return false;
+    wakeup->waiting.store(true, std::memory_order_relaxed);
+    //order the flag before loading the write index
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ring->idx->write_cache = ring->idx->write.load(std::memory_order_acquire);
+    if(ring_read_size(ring, ring->idx->write_cache)) {
+        wakeup->waiting.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void ThreadLink::clear_wakeup(void)
+{
+    link_wakeup_t *wakeup = ring->wakeup;
+    if(!wakeup)
+        return;
+    wakeup->waiting.store(false, std::memory_order_relaxed);
+#ifndef _WIN32
+    char drain[64];
+    while(::read(wakeup->fd[0], drain, sizeof(drain)) > 0 &&
+          wakeup->fd[0] != wakeup->fd[1]) {}
+#endif
+}
+
+bool ThreadLink::wait(int timeout_ms)
+{
+    if(!arm_wakeup())
+        return hasNext();
+#ifndef _WIN32
+    struct pollfd pfd = {wakeup_fd(), POLLIN, 0};
+    poll(&pfd, 1, timeout_ms);
+#else
+    //no wakeup channel, poll the ring every millisecond
+    using namespace std::chrono;
+    const steady_clock::time_point end =
+        steady_clock::now() + milliseconds(timeout_ms);
+    while(!ring_pending(ring) && (timeout_ms < 0 || steady_clock::now() < end))
+        std::this_thread::sleep_for(milliseconds(1));
+#endif
+    clear_wakeup();
+    return hasNext();
+}
+
+ThreadLink::stats_t ThreadLink::stats(void) const
+{
+    stats_t s;
+    memset(&s, 0, sizeof(s));
+    s.capacity  = ring->size - 1;
+    s.occupancy = ring_read_size(ring, ring->idx->write.load());
+    if(const link_stats_t *stats = ring->stats) {
+        s.peak_occupancy = stats->peak;
+        s.written        = stats->written;
+        s.read           = stats->read;
+        s.dropped        = stats->dropped;
+        s.seconds        = (now_ns() - stats->start_ns) * 1e-9;
+        for(int i=0; i<latency_buckets; ++i)
+            s.latency[i] = stats->latency[i];
+    }
+    return s;
+}
+
+void ThreadLink::reset_stats(void)
+{
+    link_stats_t *stats = ring->stats;
+    if(!stats)
+        return;
+    stats->written  = 0;
+    stats->dropped  = 0;
+    stats->peak     = 0;
+    stats->read     = 0;
+    stats->start_ns = now_ns();
+    for(int i=0; i<latency_buckets; ++i)
+        stats->latency[i] = 0;
+}
+
+#define LINK (*(ThreadLink*)d.obj)
+const Ports ThreadLink::ports = {
+    {"occupancy:", "", 0, [](msg_t, RtData &d) {
+        const stats_t s = LINK.stats();
+        d.reply(d.location(), "iii", (int)s.occupancy, (int)s.peak_occupancy,
+                (int)s.capacity); }},
+    {"counters:", "", 0, [](msg_t, RtData &d) {
+        const stats_t s = LINK.stats();
+        d.reply(d.location(), "hhh", (int64_t)s.written, (int64_t)s.read,
+                (int64_t)s.dropped); }},
+    {"rate:", "", 0, [](msg_t, RtData &d) {
+        d.reply(d.location(), "f", (float)LINK.stats().messages_per_second());
+    }},
+    {"latency:", "", 0, [](msg_t, RtData &d) {
+        const stats_t s = LINK.stats();
+        char types[latency_buckets+1];
+        rtosc_arg_t vals[latency_buckets];
+        for(int i=0; i<latency_buckets; ++i) {
+            types[i]  = 'i';
+            vals[i].i = s.latency[i];
+        }
+        types[latency_buckets] = 0;
+        d.replyArray(d.location(), types, vals);
+    }},
+    {"reset:", "", 0, [](msg_t, RtData &d) {
+        LINK.reset_stats(); }},
+};
+#undef LINK
+
+Port ThreadLink::statsPort(void)
+{
+    return Port{"stats/", "", &ports, [this](msg_t m, RtData &d) {
+            d.obj = this;
+            while(*m && *m != '/')
+                ++m;
+            ports.dispatch(*m ? m+1 : m, d);
+        }};
+}
+
+/*
+ * Multi producer ring
+ *
+ * A bounded queue of fixed size slots (after D. Vyukov). Each slot has a
+ * sequence number: pos while the slot is free for the write at position pos,
+ * pos+1 once that write got published, and pos+size after it has been read.
+ */
+struct mpsc_slot_t {
+    std::atomic<uint64_t> seq;
+    uint32_t len;
+};
+
+struct internal_mpsc_ring_t {
+    mpsc_slot_t *slots;
+    char *data;
+    size_t size;
+    char pad0[CACHE_LINE - sizeof(void*) - sizeof(char*) - sizeof(size_t)];
+
+    //shared by all writers
+    std::atomic<uint64_t> write;
+    char pad1[CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+
+    //only used by the reader
+    uint64_t read;
+    char pad2[CACHE_LINE - sizeof(uint64_t)];
+};
+
+typedef internal_mpsc_ring_t mpsc_ring_t;
+
+//Claim the slot for the next write, @returns its position or -1 if full
+static int64_t mpsc_claim(mpsc_ring_t *ring)
+{
+    uint64_t pos = ring->write.load(std::memory_order_relaxed);
+    for(;;) {
+        const uint64_t seq =
+            ring->slots[pos%ring->size].seq.load(std::memory_order_acquire);
+        const int64_t diff = (int64_t)(seq - pos);
+        if(diff == 0) {
+            if(ring->write.compare_exchange_weak(pos, pos+1,
+                                                 std::memory_order_relaxed))
+                return pos;
+        } else if(diff < 0)
+            return -1; //the slot still holds an unread message
+        else
+            pos = ring->write.load(std::memory_order_relaxed);
+    }
+}
+
+static void mpsc_publish(mpsc_ring_t *ring, uint64_t pos, size_t len)
+{
+    mpsc_slot_t &slot = ring->slots[pos%ring->size];
+    slot.len = len;
+    slot.seq.store(pos+1, std::memory_order_release);
+}
+
+//Reader side: the next published slot, skipping failed writes, or NULL
+static mpsc_slot_t *mpsc_front(mpsc_ring_t *ring)
+{
+    for(;;) {
+        mpsc_slot_t &slot = ring->slots[ring->read%ring->size];
+        if(slot.seq.load(std::memory_order_acquire) != ring->read+1)
+            return NULL;
+        if(slot.len)
+            return &slot;
+        slot.seq.store(ring->read + ring->size, std::memory_order_release);
+        ++ring->read;
+    }
+}
+
+static void mpsc_pop(mpsc_ring_t *ring, mpsc_slot_t *slot)
+{
+    slot->seq.store(ring->read + ring->size, std::memory_order_release);
+    ++ring->read;
+}
+
+MultiProducerLink::MultiProducerLink(size_t max_message_length,
+                                     size_t max_messages)
+    :MaxMsg(max_message_length),
+    MaxMessages(max_messages),
+    read_buffer(new char[MaxMsg]),
+    ring(new mpsc_ring_t)
+{
+    ring->slots = new mpsc_slot_t[max_messages];
+    ring->data  = new char[MaxMsg*max_messages];
+    ring->size  = max_messages;
+    ring->write = 0;
+    ring->read  = 0;
+    for(size_t i=0; i<max_messages; ++i) {
+        ring->slots[i].seq = i;
+        ring->slots[i].len = 0;
+    }
+    memset(read_buffer, 0, MaxMsg);
+}
+
+MultiProducerLink::~MultiProducerLink(void)
+{
+    delete[] ring->slots;
+    delete[] ring->data;
+    delete   ring;
+    delete[] read_buffer;
+}
+
+void MultiProducerLink::write(const char *dest, const char *args, ...)
+{
+    const int64_t pos = mpsc_claim(ring);
+    if(pos < 0)
+        return;
+    va_list va;
+    va_start(va,args);
+    const size_t len = rtosc_vmessage(ring->data + (pos%ring->size)*MaxMsg,
+                                      MaxMsg, dest, args, va);
+    va_end(va);
+    mpsc_publish(ring, pos, len);
+}
+
+void MultiProducerLink::writeArray(const char *dest, const char *args,
+                                   const rtosc_arg_t *aargs)
+{
+    const int64_t pos = mpsc_claim(ring);
+    if(pos < 0)
+        return;
+    const size_t len = rtosc_amessage(ring->data + (pos%ring->size)*MaxMsg,
+                                      MaxMsg, dest, args, aargs);
+    mpsc_publish(ring, pos, len);
+}
+
+void MultiProducerLink::raw_write(const char *msg)
+{
+    const size_t len = rtosc_message_length(msg, -1);//assumed valid
+    if(!len || len > MaxMsg)
+        return;
+    const int64_t pos = mpsc_claim(ring);
+    if(pos < 0)
+        return;
+    memcpy(ring->data + (pos%ring->size)*MaxMsg, msg, len);
+    mpsc_publish(ring, pos, len);
+}
+
+bool MultiProducerLink::hasNext(void) const
+{
+    return mpsc_front(ring);
+}
+
+msg_t MultiProducerLink::read(void)
+{
+    mpsc_slot_t *slot = mpsc_front(ring);
+    assert(slot);
+    memcpy(read_buffer, ring->data + (ring->read%ring->size)*MaxMsg,
+           slot->len);
+    mpsc_pop(ring, slot);
+    return read_buffer;
+}
+
+size_t MultiProducerLink::read_all(ThreadLink::read_cb_t cb, void *data)
+{
+    //at most one round, writers may keep publishing meanwhile
+    size_t n = 0;
+    for(mpsc_slot_t *slot; n < ring->size && (slot = mpsc_front(ring)); ++n) {
+        cb(ring->data + (ring->read%ring->size)*MaxMsg, slot->len, data);
+        mpsc_pop(ring, slot);
+    }
+    return n;
+}
+
+msg_t MultiProducerLink::peak(void) const
+{
+    return read_buffer;
+}
+
+size_t MultiProducerLink::buffer_size(void) const
+{
+    return MaxMsg*MaxMessages;
+}
+
 };
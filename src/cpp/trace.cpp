@@ -0,0 +1,221 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <rtosc/trace.h>
+
+namespace rtosc {
+namespace trace {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+    struct event_t
+    {
+        uint64_t    ns;    //!< time since epoch
+        const char *cat;
+        const char *name;
+        int64_t     value;
+        char        phase; //!< Chrome trace phase, 'B', 'E', 'i' or 'C'
+    };
+
+    //! The events of one thread, written by the thread only
+    struct thread_buffer_t
+    {
+        std::string name;
+        unsigned tid;
+        std::vector<event_t> events;
+        //! number of recorded events, others may read until there
+        std::atomic<std::size_t> count;
+        std::atomic<bool> attached;
+    };
+
+    //! Unregisters the buffer of an exiting thread
+    struct local_t
+    {
+        thread_buffer_t *buffer = nullptr;
+        ~local_t(void)
+        {
+            if(buffer)
+                buffer->attached.store(false);
+        }
+    };
+
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point epoch = clock::now();
+
+    std::mutex registry_lock;
+    std::vector<std::unique_ptr<thread_buffer_t>> registry;
+    unsigned next_tid = 1;
+    std::atomic<uint64_t> dropped_events(0);
+    thread_local local_t local;
+
+    void record(char phase, const char *cat, const char *name, int64_t value)
+    {
+        thread_buffer_t *b = local.buffer;
+        const std::size_t n = b ? b->count.load(std::memory_order_relaxed) : 0;
+        if(!b || n == b->events.size()) {
+            dropped_events.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const uint64_t ns = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(clock::now() - epoch).count();
+        b->events[n] = event_t{ns, cat, name, value, phase};
+        b->count.store(n + 1, std::memory_order_release);
+    }
+
+    void append_string(std::string &out, const char *str)
+    {
+        out += '"';
+        for(; *str; ++str) {
+            const unsigned char c = *str;
+            if(c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if(c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            } else
+                out += c;
+        }
+        out += '"';
+    }
+
+    void append_event(std::string &out, const event_t &ev, unsigned tid)
+    {
+        char buf[128];
+        out += ",\n{\"name\":";
+        append_string(out, ev.name);
+        out += ",\"cat\":";
+        append_string(out, ev.cat);
+        snprintf(buf, sizeof(buf),
+                 ",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%u",
+                 ev.phase, ev.ns / 1000, (unsigned)(ev.ns % 1000), tid);
+        out += buf;
+        if(ev.phase == 'i')
+            out += ",\"s\":\"t\"";
+        if(ev.phase == 'C') {
+            out += ",\"args\":{";
+            append_string(out, ev.name);
+            snprintf(buf, sizeof(buf), ":%" PRId64 "}", ev.value);
+            out += buf;
+        } else if(ev.value) {
+            snprintf(buf, sizeof(buf), ",\"args\":{\"value\":%" PRId64 "}",
+                     ev.value);
+            out += buf;
+        }
+        out += '}';
+    }
+}
+
+void start(void)
+{
+    enabled.store(true);
+}
+
+void stop(void)
+{
+    enabled.store(false);
+}
+
+bool attach_thread(const char *name, std::size_t max_events)
+{
+    if(local.buffer)
+        return false;
+    std::unique_ptr<thread_buffer_t> b(new thread_buffer_t);
+    b->name = name;
+    b->events.resize(max_events);
+    b->count.store(0);
+    b->attached.store(true);
+    local.buffer = b.get();
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    b->tid = next_tid++;
+    registry.push_back(std::move(b));
+    return true;
+}
+
+void detach_thread(void)
+{
+    if(local.buffer)
+        local.buffer->attached.store(false);
+    local.buffer = nullptr;
+}
+
+void begin(const char *cat, const char *name)
+{
+    record('B', cat, name, 0);
+}
+
+void end(const char *cat, const char *name)
+{
+    record('E', cat, name, 0);
+}
+
+void instant(const char *cat, const char *name, int64_t value)
+{
+    record('i', cat, name, value);
+}
+
+void counter(const char *cat, const char *name, int64_t value)
+{
+    record('C', cat, name, value);
+}
+
+std::string chrome_json(void)
+{
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                      "\"args\":{\"name\":\"rtosc\"}}";
+    std::lock_guard<std::mutex> guard(registry_lock);
+    for(const std::unique_ptr<thread_buffer_t> &b : registry) {
+        char buf[128];
+        snprintf(buf, sizeof(buf),
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%u,\"args\":{\"name\":", b->tid);
+        out += buf;
+        append_string(out, b->name.c_str());
+        out += "}}";
+
+        const std::size_t n = b->count.load(std::memory_order_acquire);
+        for(std::size_t i = 0; i < n; ++i)
+            append_event(out, b->events[i], b->tid);
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool write_chrome_json(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    if(!f)
+        return false;
+    const std::string json = chrome_json();
+    const bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+    return !fclose(f) && ok;
+}
+
+uint64_t dropped(void)
+{
+    return dropped_events.load(std::memory_order_relaxed);
+}
+
+void clear(void)
+{
+    std::lock_guard<std::mutex> guard(registry_lock);
+    std::vector<std::unique_ptr<thread_buffer_t>> kept;
+    for(std::unique_ptr<thread_buffer_t> &b : registry)
+        if(b->attached.load()) {
+            b->count.store(0);
+            kept.push_back(std::move(b));
+        }
+    registry.swap(kept);
+    dropped_events.store(0);
+}
+
+}
+}
@@ -0,0 +1,55 @@
+#ifndef RTOSC_UDP_POOL_H
+#define RTOSC_UDP_POOL_H
+
+#include <cstddef>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <rtosc/udp-transport.h>
+
+#ifdef __linux__
+#define RTOSC_HAVE_MMSG 1
+#endif
+
+namespace rtosc {
+
+/*
+ * One pool of datagram buffers, with the message headers pointing into it
+ * set up once, so a batch of datagrams needs no further setup than the
+ * lengths.
+ */
+struct udp_pool_t
+{
+    char    *buffer;
+    iovec   *iov;
+    UdpPeer *peers;
+#ifdef RTOSC_HAVE_MMSG
+    mmsghdr *hdr;
+#else
+    msghdr  *hdr;
+#endif
+};
+
+namespace helpers {
+
+#ifdef RTOSC_HAVE_MMSG
+inline msghdr &hdr_of(udp_pool_t *pool, size_t i) { return pool->hdr[i].msg_hdr; }
+#else
+inline msghdr &hdr_of(udp_pool_t *pool, size_t i) { return pool->hdr[i]; }
+#endif
+
+//! Pool of @p batch buffers of @p max_msg bytes each
+udp_pool_t *new_pool(size_t max_msg, size_t batch);
+void delete_pool(udp_pool_t *pool);
+
+//! Open a UDP socket bound to @p host and @p port, -1 on failure
+int open_socket(unsigned short port, const char *host);
+//! Port a socket is bound to, 0 if unknown
+unsigned short socket_port(int sock);
+
+//! Messages must be valid, and bundles must only hold valid elements
+bool valid_datagram(const char *msg, size_t len);
+
+}
+}
+
+#endif
@@ -0,0 +1,356 @@
+#include <rtosc/udp-transport.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/rtosc.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "udp-pool.h"
+
+namespace rtosc {
+
+using namespace helpers;
+
+static_assert(sizeof(UdpPeer::addr) >= sizeof(sockaddr_storage),
+              "UdpPeer can not hold all socket addresses");
+
+bool UdpPeer::resolve(const char *host, unsigned short port)
+{
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *res = nullptr;
+    if(getaddrinfo(host ? host : "localhost", service, &hints, &res) || !res)
+        return false;
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+unsigned short UdpPeer::port(void) const
+{
+    const sockaddr *sa = (const sockaddr*)addr;
+    if(len >= sizeof(sockaddr_in) && sa->sa_family == AF_INET)
+        return ntohs(((const sockaddr_in*)addr)->sin_port);
+    if(len >= sizeof(sockaddr_in6) && sa->sa_family == AF_INET6)
+        return ntohs(((const sockaddr_in6*)addr)->sin6_port);
+    return 0;
+}
+
+udp_pool_t *helpers::new_pool(size_t max_msg, size_t batch)
+{
+    udp_pool_t *pool = new udp_pool_t;
+    pool->buffer = new char[max_msg*batch];
+    pool->iov    = new iovec[batch];
+    pool->peers  = new UdpPeer[batch];
+#ifdef RTOSC_HAVE_MMSG
+    pool->hdr    = new mmsghdr[batch];
+#else
+    pool->hdr    = new msghdr[batch];
+#endif
+    memset(pool->hdr, 0, sizeof(*pool->hdr)*batch);
+    for(size_t i=0; i<batch; ++i) {
+        pool->iov[i].iov_base = pool->buffer + i*max_msg;
+        pool->iov[i].iov_len  = max_msg;
+        msghdr &h = hdr_of(pool, i);
+        h.msg_name    = pool->peers[i].addr;
+        h.msg_namelen = sizeof(pool->peers[i].addr);
+        h.msg_iov     = pool->iov + i;
+        h.msg_iovlen  = 1;
+    }
+    return pool;
+}
+
+void helpers::delete_pool(udp_pool_t *pool)
+{
+    delete[] pool->buffer;
+    delete[] pool->iov;
+    delete[] pool->peers;
+    delete[] pool->hdr;
+    delete pool;
+}
+
+static uint32_t read_be32(const char *p)
+{
+    const unsigned char *u = (const unsigned char*)p;
+    return ((uint32_t)u[0]<<24) | ((uint32_t)u[1]<<16) |
+           ((uint32_t)u[2]<<8)  |  (uint32_t)u[3];
+}
+
+bool helpers::valid_datagram(const char *msg, size_t len)
+{
+    if(len < 16 || len%4 || !rtosc_bundle_p(msg))
+        return rtosc_valid_message_p(msg, len);
+    for(size_t pos = 16; pos < len;) {
+        if(len - pos < 4)
+            return false;
+        const size_t size = read_be32(msg+pos);
+        pos += 4;
+        if(size%4 || size > len - pos || !valid_datagram(msg+pos, size))
+            return false;
+        pos += size;
+    }
+    return true;
+}
+
+int helpers::open_socket(unsigned short port, const char *host)
+{
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = AI_PASSIVE;
+    addrinfo *res = nullptr;
+    if(getaddrinfo(host, service, &hints, &res))
+        return -1;
+    int sock = -1;
+    for(addrinfo *ai = res; ai && sock == -1; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(sock == -1)
+            continue;
+        if(bind(sock, ai->ai_addr, ai->ai_addrlen)) {
+            ::close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+unsigned short helpers::socket_port(int sock)
+{
+    if(sock == -1)
+        return 0;
+    UdpPeer self;
+    socklen_t len = sizeof(self.addr);
+    if(getsockname(sock, (sockaddr*)self.addr, &len))
+        return 0;
+    self.len = len;
+    return self.port();
+}
+
+UdpTransport::UdpTransport(size_t max_message_length, size_t batch)
+    :MaxMsg(max_message_length), Batch(batch ? batch : 1), sock(-1),
+     recv_pool(new_pool(MaxMsg, Batch)), send_pool(new_pool(MaxMsg, Batch)),
+     send_count(0), msgs(new const char*[Batch]), lens(new size_t[Batch]),
+     peers(new UdpPeer[Batch]),
+     stat_received(0), stat_dropped(0), stat_sent(0), stat_send_errors(0)
+{
+}
+
+UdpTransport::~UdpTransport(void)
+{
+    close();
+    delete_pool(recv_pool);
+    delete_pool(send_pool);
+    delete[] msgs;
+    delete[] lens;
+    delete[] peers;
+}
+
+bool UdpTransport::open(unsigned short port, const char *host)
+{
+    close();
+    sock = open_socket(port, host);
+    stat_received = stat_dropped = stat_sent = stat_send_errors = 0;
+    return sock != -1;
+}
+
+void UdpTransport::close(void)
+{
+    if(sock != -1)
+        ::close(sock);
+    sock       = -1;
+    send_count = 0;
+}
+
+unsigned short UdpTransport::port(void) const
+{
+    return socket_port(sock);
+}
+
+bool UdpTransport::wait(int timeout_ms)
+{
+    pollfd pfd;
+    pfd.fd      = sock;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do
+        ret = poll(&pfd, 1, timeout_ms);
+    while(ret == -1 && errno == EINTR);
+    return ret > 0 && (pfd.revents & POLLIN);
+}
+
+/*
+ * Receive one batch into the pool and collect the valid messages in
+ * msgs, lens and peers
+ */
+size_t UdpTransport::fill(void)
+{
+    if(sock == -1)
+        return 0;
+    for(size_t i=0; i<Batch; ++i)
+        hdr_of(recv_pool, i).msg_namelen = sizeof(recv_pool->peers[i].addr);
+
+#ifdef RTOSC_HAVE_MMSG
+    int n;
+    do
+        n = recvmmsg(sock, recv_pool->hdr, Batch, MSG_DONTWAIT, nullptr);
+    while(n == -1 && errno == EINTR);
+    if(n <= 0)
+        return 0;
+#else
+    size_t n = 0;
+    for(; n<Batch; ++n) {
+        ssize_t len = recvmsg(sock, recv_pool->hdr + n, MSG_DONTWAIT);
+        if(len < 0)
+            break;
+        lens[n] = len; //valid messages are compacted in order below
+    }
+#endif
+
+    size_t valid = 0;
+    for(size_t i=0; i<(size_t)n; ++i) {
+#ifdef RTOSC_HAVE_MMSG
+        const size_t len = recv_pool->hdr[i].msg_len;
+#else
+        const size_t len = lens[i];
+#endif
+        const msghdr &h   = hdr_of(recv_pool, i);
+        const char   *msg = (const char*)recv_pool->iov[i].iov_base;
+        if((h.msg_flags & MSG_TRUNC) || !valid_datagram(msg, len)) {
+            ++stat_dropped;
+            continue;
+        }
+        msgs[valid] = msg;
+        lens[valid] = len;
+        memcpy(peers[valid].addr, h.msg_name, h.msg_namelen);
+        peers[valid].len = h.msg_namelen;
+        ++valid;
+    }
+    stat_received += valid;
+    return valid;
+}
+
+size_t UdpTransport::receive_batch(batch_cb_t cb, void *data)
+{
+    const size_t n = fill();
+    if(n)
+        cb(msgs, lens, peers, n, data);
+    return n;
+}
+
+size_t UdpTransport::receive(read_cb_t cb, void *data)
+{
+    const size_t n = fill();
+    for(size_t i=0; i<n; ++i)
+        cb(msgs[i], lens[i], peers[i], data);
+    return n;
+}
+
+size_t UdpTransport::receive(ThreadLink &link)
+{
+    const size_t n = fill();
+    size_t written = 0;
+    for(size_t i=0; i<n; ++i) {
+        char *buf = link.reserve(lens[i]);
+        if(!buf)
+            continue;
+        memcpy(buf, msgs[i], lens[i]);
+        link.commit(lens[i]);
+        ++written;
+    }
+    return written;
+}
+
+bool UdpTransport::queue(const char *msg, size_t len, const UdpPeer &to)
+{
+    if(len > MaxMsg || to.len > sizeof(to.addr) || sock == -1)
+        return false;
+    if(send_count == Batch && (flush(), send_count == Batch))
+        return false;
+    const size_t i = send_count++;
+    memcpy(send_pool->iov[i].iov_base, msg, len);
+    send_pool->iov[i].iov_len = len;
+    memcpy(send_pool->peers[i].addr, to.addr, to.len);
+    hdr_of(send_pool, i).msg_namelen = to.len;
+    return true;
+}
+
+//Send the first count messages of the send pool
+size_t UdpTransport::send_pool_messages(size_t count)
+{
+    size_t done = 0, sent = 0;
+    while(done < count) {
+#ifdef RTOSC_HAVE_MMSG
+        const int n = sendmmsg(sock, send_pool->hdr + done, count - done, 0);
+#else
+        const int n = sendmsg(sock, send_pool->hdr + done, 0) < 0 ? -1 : 1;
+#endif
+        if(n > 0) {
+            done += n;
+            sent += n;
+        } else if(n == -1 && errno == EINTR) {
+            continue;
+        } else {
+            //the first message of the rest failed, skip it
+            ++done;
+            ++stat_send_errors;
+        }
+    }
+    stat_sent += sent;
+    return sent;
+}
+
+size_t UdpTransport::flush(void)
+{
+    const size_t sent = send_pool_messages(send_count);
+    for(size_t i=0; i<send_count; ++i)
+        send_pool->iov[i].iov_len = MaxMsg;
+    send_count = 0;
+    return sent;
+}
+
+size_t UdpTransport::send_to_all(const char *msg, size_t len,
+                                 const UdpPeer *to, size_t n)
+{
+    if(sock == -1)
+        return 0;
+    flush();
+    //point the headers of the send pool to the message and the peers
+    size_t sent = 0;
+    for(size_t first = 0; first < n; first += Batch) {
+        const size_t count = n - first < Batch ? n - first : Batch;
+        for(size_t i=0; i<count; ++i) {
+            msghdr &h = hdr_of(send_pool, i);
+            send_pool->iov[i].iov_base = (void*)msg;
+            send_pool->iov[i].iov_len  = len;
+            h.msg_name    = (void*)to[first+i].addr;
+            h.msg_namelen = to[first+i].len;
+        }
+        sent += send_pool_messages(count);
+    }
+    const size_t used = n < Batch ? n : Batch;
+    for(size_t i=0; i<used; ++i) {
+        send_pool->iov[i].iov_base     = send_pool->buffer + i*MaxMsg;
+        send_pool->iov[i].iov_len      = MaxMsg;
+        hdr_of(send_pool, i).msg_name  = send_pool->peers[i].addr;
+    }
+    return sent;
+}
+
+}
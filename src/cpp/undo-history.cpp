@@ -1,85 +1,645 @@
-#include <deque>
+#include <vector>
+#include <string>
+#include <unordered_map>
 #include <cstring>
 #include <cstdio>
+#include <cstdint>
+#include <cstdlib>
 #include <cassert>
 #include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 #include <rtosc/rtosc.h>
 #include <rtosc/undo-history.h>
-
-using std::pair;
-using std::make_pair;
+#include <rtosc/address-table.h>
 
 namespace rtosc {
+/*
+    The messages are stored in one ring of bytes, and their positions in a
+    ring of events, so recording needs no allocation, and the oldest events
+    are dropped by advancing the start of both rings.
+
+    The journal starts with journal_magic, followed by a sequence of
+    records, each being a type character, the
+    payload size and the time (in host byte order) followed by the payload.
+    It contains the operations on the history, which are applied again when
+    the journal is opened.
+
+    In compact mode, eligible events are stored as compact records, which
+    start with compact_marker instead of '/'. A record is a record_t, the
+    path (unless it is stored by ID), and then either the old and the new
+    rtosc_arg_t of fixed size values, or span diffs of blob and string
+    values. A span diff keeps the common prefix and suffix lengths and the
+    differing middles of both values, so it can be applied in both
+    directions. The whole value of each such path is kept in a shadow_t for
+    the current history position: rewinding an event replaces the middle of
+    the shadow by the old middle, replaying by the new one. If the old value
+    of an event differs from the shadow when it is recorded (the value had
+    been changed without undo event), a second span diff from the shadow to
+    the old value is kept, too. The journal always holds full messages.
+*/
+static const char journal_magic[8] = {'r','t','o','s','c','u','n','1'};
+static const char compact_marker = 1;
+
+namespace {
+struct record_t
+{
+    char     marker; //!< compact_marker
+    char     tag;    //!< type of the values
+    uint8_t  flags;
+    uint8_t  unused;
+    uint32_t id;     //!< of the path, if stored by ID
+};
+enum { by_id = 1, base_diff = 2 };
+
+struct span_t
+{
+    uint32_t prefix, suffix; //!< lengths of the common parts
+    uint32_t a_len, b_len;   //!< lengths of the differing middles
+    const char *a, *b;       //!< the middles, pointing into the record
+};
+
+//! the position of a compact record's parts
+struct parsed_t
+{
+    char        tag;
+    const char *path;
+    rtosc_arg_t old_arg, new_arg; //!< fixed size values
+    span_t      diff;             //!< from the old to the new value
+    bool        has_base;
+    span_t      base;             //!< from the previous shadow to the old one
+};
+
+bool is_fixed(char tag)
+{
+    return strchr("ifhdtcrm", tag) != NULL;
+}
+bool is_diffable(char tag)
+{
+    return tag == 's' || tag == 'b';
+}
+
+//! bytes of a blob or string argument, strings include their terminator
+void value_bytes(char tag, const rtosc_arg_t &arg, const char **data,
+                 size_t *len)
+{
+    if(tag == 's') {
+        *data = arg.s;
+        *len  = strlen(arg.s) + 1;
+    } else {
+        *data = (const char*)arg.b.data;
+        *len  = arg.b.len;
+    }
+}
+
+void append(std::vector<char> &out, const void *data, size_t len)
+{
+    out.insert(out.end(), (const char*)data, (const char*)data + len);
+}
+
+void write_span(std::vector<char> &out, const char *a, size_t a_len,
+                const char *b, size_t b_len)
+{
+    uint32_t head[4] = {0, 0, 0, 0};
+    const size_t common = a_len < b_len ? a_len : b_len;
+    while(head[0] < common && a[head[0]] == b[head[0]])
+        ++head[0];
+    while(head[1] < common - head[0] &&
+          a[a_len - 1 - head[1]] == b[b_len - 1 - head[1]])
+        ++head[1];
+    head[2] = a_len - head[0] - head[1];
+    head[3] = b_len - head[0] - head[1];
+    append(out, head, sizeof(head));
+    append(out, a + head[0], head[2]);
+    append(out, b + head[0], head[3]);
+}
+
+const char *read_span(const char *p, span_t &s)
+{
+    memcpy(&s.prefix, p, sizeof(uint32_t));
+    memcpy(&s.suffix, p + 4, sizeof(uint32_t));
+    memcpy(&s.a_len, p + 8, sizeof(uint32_t));
+    memcpy(&s.b_len, p + 12, sizeof(uint32_t));
+    s.a = p + 16;
+    s.b = s.a + s.a_len;
+    return s.b + s.b_len;
+}
+
+//! replace the middle of @p value between the span's prefix and suffix
+void splice(std::vector<char> &value, const span_t &s, bool forward)
+{
+    const size_t prefix = s.prefix < value.size() ? s.prefix : value.size();
+    const size_t suffix = s.suffix < value.size() - prefix
+                        ? s.suffix : value.size() - prefix;
+    const char *mid = forward ? s.b : s.a;
+    const size_t mid_len = forward ? s.b_len : s.a_len;
+    value.erase(value.begin() + prefix, value.end() - suffix);
+    value.insert(value.begin() + prefix, mid, mid + mid_len);
+}
+
+bool same_value(const std::vector<char> &value, const char *data, size_t len)
+{
+    return value.size() == len && !memcmp(value.data(), data, len);
+}
+}
+
 class UndoHistoryImpl
 {
     public:
         UndoHistoryImpl(void)
-            :max_history_size(20)
-        {}
-        ~UndoHistoryImpl(void)
+            :history_pos(0), merge_window(2), gesture_depth(0),
+             journal(-1), replaying(false), checkpoint_interval(0),
+             since_checkpoint(0), compact(false), table(nullptr)
         {
-            clear();
+            setLimits(16384, 20);
         }
-        std::deque<pair<time_t, const char *>> history;
+
+        struct event_t
+        {
+            time_t time;
+            size_t offset; //!< of the message in the arena
+            size_t size;   //!< bytes reserved for the message
+            bool closed;   //!< no further events are merged into this one
+        };
+
+        std::vector<char>    arena;
+        std::vector<event_t> events;
+        size_t first;  //!< index of the oldest event in events
+        size_t count;  //!< number of events
         long history_pos;
-        unsigned max_history_size;//XXX Expose this via a public API
+        double merge_window;
+        int gesture_depth;
+        std::vector<char> merge_buf;
         std::function<void(const char*)> cb;
 
-        void rewind(const char *msg);
-        void replay(const char *msg);
-        bool mergeEvent(time_t t, const char *msg, char *buf, size_t N);
+        struct checkpoint_t
+        {
+            size_t pos; //!< history position, counting dropped events
+            std::string snapshot;
+        };
+        std::vector<checkpoint_t> checkpoints;
+        size_t dropped; //!< number of events dropped at the front
+        int journal;    //!< file descriptor, -1 if not journaling
+        bool replaying; //!< whether the journal is currently being read
+        std::function<std::string(void)> snapshot_cb;
+        std::function<void(const char*)> restore_cb;
+        size_t checkpoint_interval;
+        size_t since_checkpoint; //!< events recorded since last checkpoint
+
+        //! whole value of a diffed path at the history position
+        struct shadow_t
+        {
+            char tag;
+            std::vector<char> value;
+        };
+        bool compact;
+        const AddressTable *table;
+        std::unordered_map<std::string, shadow_t> shadows;
+        std::vector<char> encode_buf;
+        std::vector<char> send_buf;
+        std::vector<char> value_buf;
+        std::vector<char> history_buf;
+
+        event_t &event(size_t i) { return events[(first + i) % events.size()]; }
+        const event_t &event(size_t i) const
+        {
+            return events[(first + i) % events.size()];
+        }
+        const char *message(size_t i) const
+        {
+            return arena.data() + event(i).offset;
+        }
+
+        void setLimits(size_t max_bytes, size_t max_events);
+        bool isCompact(size_t i) const { return *message(i) == compact_marker; }
+        parsed_t parse(size_t i) const;
+        const char *path(size_t i) const;
+        const char *encode(const char *msg, size_t *len);
+        void step(const parsed_t &p, std::vector<char> &value,
+                  bool forward, std::vector<char> *old_value) const;
+        void send(const char *path, char tag, const rtosc_arg_t &arg);
+        void sendValue(const char *path, char tag,
+                       const std::vector<char> &value);
+        void shift(long dest);
+        const char *decode(size_t i);
+        bool mergeCompact(size_t i, time_t t, const char *msg);
+        void dropOldest(void);
+        void dropNewest(void);
+        bool push(time_t t, const char *msg, size_t len);
+        void rewind(size_t i);
+        void replay(size_t i);
+        bool mergeEvent(time_t t, const char *msg);
+        void closeEvents(void);
         void clear(void);
+
+        void record(time_t t, const char *msg);
+        void seek(int distance);
+        void moveTo(long dest);
+        void addCheckpoint(time_t t, std::string snapshot);
+        void dropCheckpoints(void);
+        void write(char type, time_t t, const void *data, size_t len);
+        bool readJournal(const std::vector<char> &content, size_t pos,
+                         size_t *good);
 };
 
+void UndoHistoryImpl::setLimits(size_t max_bytes, size_t max_events)
+{
+    assert(max_events > 0);
+    arena.assign(max_bytes, 0);
+    events.assign(max_events, event_t{0, 0, 0, false});
+    merge_buf.assign(max_bytes, 0);
+    clear();
+}
+
+void UndoHistoryImpl::dropOldest(void)
+{
+    first = (first + 1) % events.size();
+    --count;
+    ++dropped;
+    if(history_pos)
+        --history_pos;
+    dropCheckpoints();
+}
+
+void UndoHistoryImpl::dropNewest(void)
+{
+    --count;
+    dropCheckpoints();
+}
+
+//! drop checkpoints whose events are not in the history anymore
+void UndoHistoryImpl::dropCheckpoints(void)
+{
+    for(size_t i = 0; i < checkpoints.size();)
+        if(checkpoints[i].pos < dropped ||
+           checkpoints[i].pos > dropped + count)
+            checkpoints.erase(checkpoints.begin() + i);
+        else
+            ++i;
+}
+
+bool UndoHistoryImpl::push(time_t t, const char *msg, size_t len)
+{
+    if(len > arena.size())
+        return false;
+    if(count == events.size())
+        dropOldest();
+
+    // find free space after the newest event, dropping the oldest ones
+    size_t pos;
+    for(;;)
+    {
+        if(!count) {
+            pos = 0;
+            break;
+        }
+        const event_t &newest = event(count - 1);
+        const size_t begin = event(0).offset;
+        const size_t end   = newest.offset + newest.size;
+        if(begin < end) { // free space behind end and in front of begin
+            if(end + len <= arena.size()) {
+                pos = end;
+                break;
+            }
+            if(len <= begin) {
+                pos = 0;
+                break;
+            }
+        } else if(end + len <= begin) { // free space between end and begin
+            pos = end;
+            break;
+        }
+        dropOldest();
+    }
+
+    memcpy(arena.data() + pos, msg, len);
+    event(count++) = event_t{t, pos, len, false};
+    return true;
+}
+
+void UndoHistoryImpl::closeEvents(void)
+{
+    for(size_t i = 0; i < count; ++i)
+        event(i).closed = true;
+}
+
+void UndoHistoryImpl::clear(void)
+{
+    first = 0;
+    count = 0;
+    history_pos = 0;
+    dropped = 0;
+    since_checkpoint = 0;
+    checkpoints.clear();
+    shadows.clear();
+}
+
+void UndoHistoryImpl::write(char type, time_t t, const void *data, size_t len)
+{
+    if(journal < 0 || replaying)
+        return;
+    char header[1 + sizeof(uint32_t) + sizeof(int64_t)];
+    uint32_t size = len;
+    int64_t time = t;
+    header[0] = type;
+    memcpy(header + 1, &size, sizeof(size));
+    memcpy(header + 1 + sizeof(size), &time, sizeof(time));
+    if(::write(journal, header, sizeof(header)) != (ssize_t)sizeof(header) ||
+       (len && ::write(journal, data, len) != (ssize_t)len))
+    {
+        // stop journaling instead of writing an inconsistent journal
+        close(journal);
+        journal = -1;
+    }
+}
+
+void UndoHistoryImpl::record(time_t now, const char *msg)
+{
+    //TODO Properly account for when you have traveled back in time.
+    //while this could result in another branch of history, the simple method
+    //would be to kill off any future redos when new history is recorded
+    while(count != (size_t) history_pos)
+        dropNewest();
+
+    size_t len = rtosc_message_length(msg, -1);
+    write('e', now, msg, len);
+    if(mergeEvent(now, msg))
+        return;
+    const char *stored = encode(msg, &len);
+    //the oldest events may be dropped, the position is behind the newest one
+    if(push(now, stored, len)) {
+        history_pos = count;
+        if(checkpoint_interval && snapshot_cb && !replaying &&
+           ++since_checkpoint >= checkpoint_interval)
+            addCheckpoint(now, snapshot_cb());
+    }
+}
+
+void UndoHistoryImpl::addCheckpoint(time_t now, std::string snapshot)
+{
+    write('c', now, snapshot.data(), snapshot.size());
+    //merging events before the checkpoint would invalidate it
+    closeEvents();
+    since_checkpoint = 0;
+    const size_t pos = dropped + history_pos;
+    for(checkpoint_t &c : checkpoints)
+        if(c.pos == pos) {
+            c.snapshot = std::move(snapshot);
+            return;
+        }
+    checkpoints.push_back(checkpoint_t{pos, std::move(snapshot)});
+}
+
+//! move to @p dest without calling any callbacks
+void UndoHistoryImpl::moveTo(long dest)
+{
+    if(dest < 0)
+        dest = 0;
+    if(dest > (long) count)
+        dest = count;
+    shift(dest);
+}
+
+void UndoHistoryImpl::seek(int distance)
+{
+    //TODO print out the events that would need to take place to get to the
+    //final destination
+
+    //TODO limit the distance to be to applicable sizes
+    //ie ones that do not exceed the known history/future
+    long dest = history_pos + distance;
+    if(dest < 0)
+        distance -= dest;
+    if(dest > (long) count)
+        distance  = count - history_pos;
+    if(!distance)
+        return;
+    dest = history_pos + distance;
+    write('s', time(NULL), &distance, sizeof(distance));
+
+    //restore the nearest checkpoint if this saves enough callbacks
+    if(restore_cb && !checkpoints.empty()) {
+        const checkpoint_t *best = nullptr;
+        long best_steps = labs(distance);
+        const long min_saved = checkpoint_interval ? checkpoint_interval : 1;
+        for(const checkpoint_t &c : checkpoints) {
+            long steps = labs(dest - (long)(c.pos - dropped));
+            if(steps + min_saved <= best_steps) {
+                best = &c;
+                best_steps = steps;
+            }
+        }
+        if(best) {
+            restore_cb(best->snapshot.c_str());
+            shift(best->pos - dropped);
+        }
+    }
+
+    //TODO account for traveling back in time
+    while(history_pos > dest)
+        rewind(--history_pos);
+    while(history_pos < dest)
+        replay(history_pos++);
+}
+
+bool UndoHistoryImpl::readJournal(const std::vector<char> &content,
+                                  size_t pos, size_t *good)
+{
+    const size_t header = 1 + sizeof(uint32_t) + sizeof(int64_t);
+    replaying = true;
+    while(content.size() - pos >= header) {
+        const char type = content[pos];
+        uint32_t size;
+        int64_t t;
+        memcpy(&size, content.data() + pos + 1, sizeof(size));
+        memcpy(&t, content.data() + pos + 1 + sizeof(size), sizeof(t));
+        if(content.size() - pos - header < size)
+            break; // the last record had not been written completely
+        const char *data = content.data() + pos + header;
+        switch(type)
+        {
+            case 'e':
+                if(size < 4 || rtosc_message_length(data, size) != size)
+                    goto error;
+                record(t, data);
+                break;
+            case 's':
+            {
+                int distance;
+                if(size != sizeof(distance))
+                    goto error;
+                memcpy(&distance, data, sizeof(distance));
+                moveTo(history_pos + distance);
+                break;
+            }
+            case 'c':
+                addCheckpoint(t, std::string(data, size));
+                break;
+            case 'b':
+                if(!gesture_depth++)
+                    closeEvents();
+                break;
+            case 'g':
+                if(gesture_depth && !--gesture_depth)
+                    closeEvents();
+                break;
+            default:
+                goto error;
+        }
+        pos += header + size;
+    }
+    replaying = false;
+    *good = pos;
+    return true;
+error:
+    replaying = false;
+    *good = pos;
+    return false;
+}
+
 UndoHistory::UndoHistory(void)
 {
     impl = new UndoHistoryImpl;
-    impl->history_pos  = 0;
 }
 
 UndoHistory::~UndoHistory(void)
 {
+    closeJournal();
     delete impl;
 }
 
+void UndoHistory::setLimits(size_t max_bytes, size_t max_events)
+{
+    impl->setLimits(max_bytes, max_events);
+}
+
+void UndoHistory::setMergeWindow(double seconds)
+{
+    impl->merge_window = seconds;
+}
+
+void UndoHistory::setCompact(bool compact, const AddressTable *table)
+{
+    impl->compact = compact;
+    impl->table = table;
+    impl->clear();
+}
+
+void UndoHistory::beginGesture(void)
+{
+    impl->write('b', time(NULL), nullptr, 0);
+    if(!impl->gesture_depth++)
+        impl->closeEvents();
+}
+
+void UndoHistory::endGesture(void)
+{
+    impl->write('g', time(NULL), nullptr, 0);
+    if(impl->gesture_depth && !--impl->gesture_depth)
+        impl->closeEvents();
+}
+
 void UndoHistory::recordEvent(const char *msg)
 {
-    //TODO Properly account for when you have traveled back in time.
-    //while this could result in another branch of history, the simple method
-    //would be to kill off any future redos when new history is recorded
-    if(impl->history.size() != (unsigned) impl->history_pos) {
-        impl->history.resize(impl->history_pos);
+    impl->record(time(NULL), msg);
+}
+
+bool UndoHistory::openJournal(const char *path)
+{
+    closeJournal();
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+        return false;
+
+    std::vector<char> content;
+    char buf[4096];
+    for(ssize_t rd; (rd = read(fd, buf, sizeof(buf))) != 0;) {
+        if(rd < 0) {
+            close(fd);
+            return false;
+        }
+        content.insert(content.end(), buf, buf + rd);
     }
 
-    size_t len = rtosc_message_length(msg, -1);
-    char *data = new char[len];
-    time_t now = time(NULL);
-    //printf("now = '%ld'\n", now);
-    if(!impl->mergeEvent(now, msg, data, len)) {
-        memcpy(data, msg, len);
-        impl->history.push_back(make_pair(now, data));
-        impl->history_pos++;
-        if(impl->history.size() > impl->max_history_size)
-        {
-            delete[] impl->history[0].second;
-            impl->history.pop_front();
-            impl->history_pos--;
+    const size_t magic = sizeof(journal_magic);
+    if(content.empty()) {
+        if(::write(fd, journal_magic, magic) != (ssize_t)magic) {
+            close(fd);
+            return false;
         }
+        content.assign(journal_magic, journal_magic + magic);
+    }
+    else if(content.size() < magic ||
+            memcmp(content.data(), journal_magic, magic)) {
+        close(fd);
+        return false;
+    }
+
+    impl->clear();
+    impl->gesture_depth = 0;
+    size_t good;
+    // cut off an incompletely written record, then append behind the rest
+    if(!impl->readJournal(content, magic, &good) ||
+       (good != content.size() && ftruncate(fd, good)) ||
+       lseek(fd, good, SEEK_SET) < 0)
+    {
+        close(fd);
+        return false;
     }
+    impl->journal = fd;
+    return true;
+}
+
+void UndoHistory::closeJournal(void)
+{
+    if(impl->journal >= 0)
+        close(impl->journal);
+    impl->journal = -1;
+}
+
+void UndoHistory::setCheckpoints(size_t interval,
+                                 std::function<std::string(void)> snapshot,
+                                 std::function<void(const char*)> restore)
+{
+    impl->checkpoint_interval = interval;
+    impl->snapshot_cb = snapshot;
+    impl->restore_cb = restore;
+}
 
+void UndoHistory::addCheckpoint(const char *snapshot)
+{
+    impl->addCheckpoint(time(NULL), snapshot);
+}
+
+size_t UndoHistory::checkpoints(void) const
+{
+    return impl->checkpoints.size();
 }
 
 void UndoHistory::showHistory(void) const
 {
-    int i = 0;
-    for(auto s : impl->history)
-        printf("#%d type: %s dest: %s arguments: %s\n", i++,
-                s.second, rtosc_argument(s.second, 0).s, rtosc_argument_string(s.second));
+    for(size_t i = 0; i < impl->count; ++i) {
+        const char *msg = impl->decode(i);
+        printf("#%d type: %s dest: %s arguments: %s\n", (int)i,
+                msg, rtosc_argument(msg, 0).s, rtosc_argument_string(msg));
+    }
 }
 
 static char tmp[256];
-void UndoHistoryImpl::rewind(const char *msg)
+void UndoHistoryImpl::rewind(size_t i)
 {
+    if(isCompact(i)) {
+        const parsed_t p = parse(i);
+        if(is_fixed(p.tag))
+            send(p.path, p.tag, p.old_arg);
+        else {
+            std::vector<char> &value = shadows[p.path].value;
+            step(p, value, false, &value_buf);
+            sendValue(p.path, p.tag, value_buf);
+        }
+        return;
+    }
+    const char *msg = message(i);
     memset(tmp, 0, sizeof(tmp));
     rtosc_arg_t arg = rtosc_argument(msg,1);
     rtosc_amessage(tmp, 256, rtosc_argument(msg,0).s,
@@ -88,8 +648,20 @@ void UndoHistoryImpl::rewind(const char *msg)
     cb(tmp);
 }
 
-void UndoHistoryImpl::replay(const char *msg)
+void UndoHistoryImpl::replay(size_t i)
 {
+    if(isCompact(i)) {
+        const parsed_t p = parse(i);
+        if(is_fixed(p.tag))
+            send(p.path, p.tag, p.new_arg);
+        else {
+            std::vector<char> &value = shadows[p.path].value;
+            step(p, value, true, nullptr);
+            sendValue(p.path, p.tag, value);
+        }
+        return;
+    }
+    const char *msg = message(i);
     rtosc_arg_t arg = rtosc_argument(msg,2);
     int len = rtosc_amessage(tmp, 256, rtosc_argument(msg,0).s,
             rtosc_argument_string(msg)+2,
@@ -99,70 +671,288 @@ void UndoHistoryImpl::replay(const char *msg)
         cb(tmp);
 }
 
+parsed_t UndoHistoryImpl::parse(size_t i) const
+{
+    const char *rec = message(i);
+    record_t head;
+    memcpy(&head, rec, sizeof(head));
+    const char *pos = rec + sizeof(head);
+
+    parsed_t p;
+    p.tag = head.tag;
+    if(head.flags & by_id)
+        p.path = table->path(head.id);
+    else {
+        p.path = pos;
+        pos += strlen(pos) + 1;
+    }
+    p.has_base = head.flags & base_diff;
+    if(is_fixed(p.tag)) {
+        memcpy(&p.old_arg, pos, sizeof(rtosc_arg_t));
+        memcpy(&p.new_arg, pos + sizeof(rtosc_arg_t), sizeof(rtosc_arg_t));
+    } else {
+        pos = read_span(pos, p.diff);
+        if(p.has_base)
+            read_span(pos, p.base);
+    }
+    return p;
+}
+
+const char *UndoHistoryImpl::path(size_t i) const
+{
+    return isCompact(i) ? parse(i).path : rtosc_argument(message(i), 0).s;
+}
+
+//! @return @p msg or its compact record, which is valid until the next call
+const char *UndoHistoryImpl::encode(const char *msg, size_t *len)
+{
+    const char *types = rtosc_argument_string(msg);
+    const char tag = types[1];
+    if(!compact || strcmp(msg, "/undo_change") ||
+       types[0] != 's' || !tag || types[2] != tag || types[3] ||
+       !(is_fixed(tag) || is_diffable(tag)))
+        return msg;
+    const char *path = rtosc_argument(msg, 0).s;
+    auto shadow = shadows.find(path);
+    if(is_diffable(tag) && shadow != shadows.end() &&
+       shadow->second.tag != tag)
+        return msg;
+
+    const int id = table ? table->id(path) : -1;
+    record_t head{compact_marker, tag, 0, 0, 0};
+    if(id >= 0) {
+        head.flags |= by_id;
+        head.id = id;
+    }
+    const rtosc_arg_t old_arg = rtosc_argument(msg, 1);
+    const rtosc_arg_t new_arg = rtosc_argument(msg, 2);
+    const char *old_data = nullptr, *new_data = nullptr;
+    size_t old_len = 0, new_len = 0;
+    if(is_diffable(tag)) {
+        value_bytes(tag, old_arg, &old_data, &old_len);
+        value_bytes(tag, new_arg, &new_data, &new_len);
+        if(shadow != shadows.end() &&
+           !same_value(shadow->second.value, old_data, old_len))
+            head.flags |= base_diff;
+    }
+
+    encode_buf.clear();
+    append(encode_buf, &head, sizeof(head));
+    if(id < 0)
+        append(encode_buf, path, strlen(path) + 1);
+    if(is_fixed(tag)) {
+        append(encode_buf, &old_arg, sizeof(old_arg));
+        append(encode_buf, &new_arg, sizeof(new_arg));
+    } else {
+        write_span(encode_buf, old_data, old_len, new_data, new_len);
+        if(head.flags & base_diff) {
+            const std::vector<char> &prev = shadow->second.value;
+            write_span(encode_buf, prev.data(), prev.size(),
+                       old_data, old_len);
+        }
+        // the shadow follows the newest event, even if it is not stored
+        shadow_t &s = shadows[path];
+        s.tag = tag;
+        s.value.assign(new_data, new_data + new_len);
+    }
+    *len = encode_buf.size();
+    return encode_buf.data();
+}
+
+/**
+ * Move @p value over the compact event @p p
+ *
+ * Forward, @p value must be the shadow before the event and becomes the
+ * new value, otherwise it must be the new value and becomes the shadow
+ * before the event. @p old_value receives the old value of the event.
+ */
+void UndoHistoryImpl::step(const parsed_t &p, std::vector<char> &value,
+                           bool forward, std::vector<char> *old_value) const
+{
+    if(forward) {
+        if(p.has_base)
+            splice(value, p.base, true);
+        if(old_value)
+            *old_value = value;
+        splice(value, p.diff, true);
+    } else {
+        splice(value, p.diff, false);
+        if(old_value)
+            *old_value = value;
+        if(p.has_base)
+            splice(value, p.base, false);
+    }
+}
+
+void UndoHistoryImpl::send(const char *path, char tag, const rtosc_arg_t &arg)
+{
+    const char types[2] = {tag, 0};
+    size_t len = rtosc_amessage(NULL, 0, path, types, &arg);
+    send_buf.resize(len);
+    if(rtosc_amessage(send_buf.data(), len, path, types, &arg))
+        cb(send_buf.data());
+}
+
+void UndoHistoryImpl::sendValue(const char *path, char tag,
+                                const std::vector<char> &value)
+{
+    rtosc_arg_t arg;
+    if(tag == 's')
+        arg.s = value.empty() ? "" : value.data();
+    else {
+        arg.b.len  = value.size();
+        arg.b.data = (uint8_t*)value.data();
+    }
+    send(path, tag, arg);
+}
+
+//! move the position to @p dest, updating the shadows, but not calling cb
+void UndoHistoryImpl::shift(long dest)
+{
+    for(; history_pos > dest; --history_pos)
+        if(isCompact(history_pos - 1)) {
+            const parsed_t p = parse(history_pos - 1);
+            if(is_diffable(p.tag))
+                step(p, shadows[p.path].value, false, nullptr);
+        }
+    for(; history_pos < dest; ++history_pos)
+        if(isCompact(history_pos)) {
+            const parsed_t p = parse(history_pos);
+            if(is_diffable(p.tag))
+                step(p, shadows[p.path].value, true, nullptr);
+        }
+}
+
+//! the full message of event @p i
+const char *UndoHistoryImpl::decode(size_t i)
+{
+    if(!isCompact(i))
+        return message(i);
+    const parsed_t p = parse(i);
+    rtosc_arg_t args[3];
+    args[0].s = p.path;
+    std::vector<char> old_value, new_value;
+    if(is_fixed(p.tag)) {
+        args[1] = p.old_arg;
+        args[2] = p.new_arg;
+    } else {
+        // walk the shadow from the history position to the event
+        new_value = shadows[p.path].value;
+        for(size_t j = history_pos; j > i + 1; --j)
+            if(isCompact(j - 1) && !strcmp(path(j - 1), p.path))
+                step(parse(j - 1), new_value, false, nullptr);
+        for(size_t j = history_pos; j < i; ++j)
+            if(isCompact(j) && !strcmp(path(j), p.path))
+                step(parse(j), new_value, true, nullptr);
+        if(i >= (size_t)history_pos)
+            step(p, new_value, true, &old_value);
+        else {
+            old_value = new_value;
+            splice(old_value, p.diff, false);
+        }
+        for(int k = 1; k < 3; ++k) {
+            const std::vector<char> &v = k == 1 ? old_value : new_value;
+            if(p.tag == 's')
+                args[k].s = v.empty() ? "" : v.data();
+            else {
+                args[k].b.len  = v.size();
+                args[k].b.data = (uint8_t*)v.data();
+            }
+        }
+    }
+    const char types[4] = {'s', p.tag, p.tag, 0};
+    const size_t len = rtosc_amessage(NULL, 0, "/undo_change", types, args);
+    history_buf.resize(len);
+    rtosc_amessage(history_buf.data(), len, "/undo_change", types, args);
+    return history_buf.data();
+}
+
 const char *getUndoAddress(const char *msg)
 {
     return rtosc_argument(msg,0).s;
 }
 
-bool UndoHistoryImpl::mergeEvent(time_t now, const char *msg, char *buf, size_t N)
+bool UndoHistoryImpl::mergeEvent(time_t now, const char *msg)
 {
     if(history_pos == 0)
         return false;
     for(int i=history_pos-1; i>=0; --i) {
-        if(difftime(now, history[i].first) > 2)
+        //closed events are followed by open ones only
+        if(event(i).closed)
             break;
-        if(!strcmp(getUndoAddress(msg),
-                    getUndoAddress(history[i].second)))
-        {
-            //We can splice events together, merging them into one event
-            rtosc_arg_t args[3];
-            args[0] = rtosc_argument(msg, 0);
-            args[1] = rtosc_argument(history[i].second,1);
-            args[2] = rtosc_argument(msg, 2);
+        if(!gesture_depth && !(merge_window > 0 &&
+                               difftime(now, event(i).time) <= merge_window))
+            break;
+        if(strcmp(getUndoAddress(msg), path(i)))
+            continue;
+        if(isCompact(i))
+            return mergeCompact(i, now, msg);
+        //We can splice events together, merging them into one event
+        const char *old = message(i);
+        rtosc_arg_t args[3];
+        args[0] = rtosc_argument(msg, 0);
+        args[1] = rtosc_argument(old,1);
+        args[2] = rtosc_argument(msg, 2);
 
-            rtosc_amessage(buf, N, msg, rtosc_argument_string(msg), args);
+        size_t len = rtosc_amessage(merge_buf.data(), merge_buf.size(),
+                                    msg, rtosc_argument_string(msg), args);
+        //The merged event must fit where the old one is stored
+        if(!len || len > event(i).size)
+            return false;
 
-            delete [] history[i].second;
-            history[i].second = buf;
-            history[i].first = now;
-            return true;
-        }
+        memcpy(arena.data() + event(i).offset, merge_buf.data(), len);
+        event(i).time = now;
+        return true;
     }
     return false;
 }
 
-void UndoHistoryImpl::clear(void)
+
+
+
+//! merge @p msg into the compact event @p i, which changed the same path
+bool UndoHistoryImpl::mergeCompact(size_t i, time_t now, const char *msg)
 {
-    for(auto elm : history)
-        delete [] elm.second;
-    history.clear();
-    history_pos = 0;
-}
+    const parsed_t p = parse(i);
+    const char types[4] = {'s', p.tag, p.tag, 0};
+    if(strcmp(rtosc_argument_string(msg), types))
+        return false;
+    char *rec = arena.data() + event(i).offset;
+    const rtosc_arg_t new_arg = rtosc_argument(msg, 2);
+    if(is_fixed(p.tag)) {
+        memcpy(rec + event(i).size - sizeof(new_arg), &new_arg,
+               sizeof(new_arg));
+        event(i).time = now;
+        return true;
+    }
 
+    // the event is the newest one of its path, so the shadow is its value
+    shadow_t &shadow = shadows[p.path];
+    std::vector<char> old_value = shadow.value;
+    splice(old_value, p.diff, false);
+    const char *new_data;
+    size_t new_len;
+    value_bytes(p.tag, new_arg, &new_data, &new_len);
 
+    encode_buf.assign((const char*)rec, p.diff.a - 4*sizeof(uint32_t));
+    write_span(encode_buf, old_value.data(), old_value.size(),
+               new_data, new_len);
+    if(p.has_base) {
+        const char *base = p.base.a - 4*sizeof(uint32_t);
+        append(encode_buf, base, p.base.b + p.base.b_len - base);
+    }
+    //The merged event must fit where the old one is stored
+    if(encode_buf.size() > event(i).size)
+        return false;
+    memcpy(rec, encode_buf.data(), encode_buf.size());
+    event(i).time = now;
+    shadow.value.assign(new_data, new_data + new_len);
+    return true;
+}
 
 void UndoHistory::seekHistory(int distance)
 {
-    //TODO print out the events that would need to take place to get to the
-    //final destination
-    
-    //TODO limit the distance to be to applicable sizes
-    //ie ones that do not exceed the known history/future
-    long dest = impl->history_pos + distance;
-    if(dest < 0)
-        distance -= dest;
-    if(dest > (long) impl->history.size())
-        distance  = impl->history.size() - impl->history_pos;
-    if(!distance)
-        return;
-    
-    //TODO account for traveling back in time
-    if(distance<0)
-        while(distance++)
-            impl->rewind(impl->history[--impl->history_pos].second);
-    else
-        while(distance--)
-            impl->replay(impl->history[impl->history_pos++].second);
+    impl->seek(distance);
 }
 
 unsigned UndoHistory::getPos(void) const
@@ -172,12 +962,12 @@ unsigned UndoHistory::getPos(void) const
 
 const char *UndoHistory::getHistory(int i) const
 {
-    return impl->history[i].second;
+    return impl->decode(i);
 }
 
 size_t UndoHistory::size() const
 {
-    return impl->history.size();
+    return impl->count;
 }
 
 void UndoHistory::setCallback(std::function<void(const char*)> cb)
@@ -0,0 +1,511 @@
+#include <rtosc/uring-transport.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/rtosc.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "udp-pool.h"
+
+namespace rtosc {
+
+using namespace helpers;
+
+/*
+ * The ring is driven without liburing, by the three system calls and the
+ * memory they share with the kernel. Sends use the index of their slot in
+ * the send pool as user data, the multishot receive uses RECV_TAG.
+ */
+static const uint64_t RECV_TAG = ~(uint64_t)0;
+static const unsigned short BUF_GROUP = 0;
+
+static int uring_setup(unsigned entries, io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned submit, unsigned min_complete,
+                       unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, min_complete, flags,
+                        nullptr, 0);
+}
+
+static int uring_register(int fd, unsigned op, void *arg, unsigned n)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+struct uring_t
+{
+    int fd;
+
+    //submission queue, sq_array maps each entry to the sqe of same index
+    void         *sq_map;
+    size_t        sq_map_len;
+    unsigned     *sq_head, *sq_tail, *sq_mask;
+    io_uring_sqe *sqes;
+    size_t        sqes_len;
+    unsigned      sq_local_tail;
+    unsigned      to_submit;
+
+    //completion queue
+    void         *cq_map;
+    size_t        cq_map_len;
+    unsigned     *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    //provided buffers, each one holding an io_uring_recvmsg_out, the
+    //sender's address and the datagram. The ring is used as an array, as
+    //io_uring_buf_ring's flexible array member has another offset in C++.
+    //The tail of the ring is the resv field of the first entry.
+    io_uring_buf      *br;
+    size_t             br_len;
+    char              *bufs;
+    size_t             buf_size;
+    unsigned           nbufs;
+    unsigned short     br_tail;
+    msghdr             recv_hdr;
+    bool               armed;
+    bool               failed; //!< receiving failed for another reason
+                               //!< than all buffers being in use
+
+    //filled buffers, in the order they have been received
+    unsigned short *done;
+    size_t          done_head, done_count;
+
+    size_t sends_pending, notifs_pending, sends_ok, sends_failed;
+};
+
+static unsigned round_pow2(size_t n)
+{
+    unsigned r = 1;
+    while(r < n && r < 32768)
+        r <<= 1;
+    return r;
+}
+
+static void unmap_ring(uring_t *r)
+{
+    if(r->fd != -1)
+        ::close(r->fd);
+    if(r->sqes)
+        munmap(r->sqes, r->sqes_len);
+    if(r->cq_map && r->cq_map != r->sq_map)
+        munmap(r->cq_map, r->cq_map_len);
+    if(r->sq_map)
+        munmap(r->sq_map, r->sq_map_len);
+    if(r->br)
+        munmap(r->br, r->br_len);
+    r->fd     = -1;
+    r->sqes   = nullptr;
+    r->sq_map = r->cq_map = nullptr;
+    r->br     = nullptr;
+}
+
+static void add_buffer(uring_t *r, unsigned short bid)
+{
+    io_uring_buf &buf = r->br[r->br_tail & (r->nbufs-1)];
+    buf.addr = (uint64_t)(uintptr_t)(r->bufs + bid*r->buf_size);
+    buf.len  = r->buf_size;
+    buf.bid  = bid;
+    ++r->br_tail;
+}
+
+static void publish_buffers(uring_t *r)
+{
+    __atomic_store_n(&r->br[0].resv, r->br_tail, __ATOMIC_RELEASE);
+}
+
+static bool map_ring(uring_t *r, unsigned entries, unsigned cq_entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags      = IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+    r->fd = uring_setup(entries, &p);
+    if(r->fd < 0) {
+        r->fd = -1;
+        return false;
+    }
+
+    r->sq_map_len = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    r->cq_map_len = p.cq_off.cqes  + p.cq_entries*sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if(single && r->cq_map_len > r->sq_map_len)
+        r->sq_map_len = r->cq_map_len;
+    void *sq = mmap(nullptr, r->sq_map_len, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if(sq == MAP_FAILED)
+        return false;
+    r->sq_map = sq;
+    void *cq = sq;
+    if(!single) {
+        cq = mmap(nullptr, r->cq_map_len, PROT_READ|PROT_WRITE,
+                  MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if(cq == MAP_FAILED)
+            return false;
+    }
+    r->cq_map = cq;
+    r->sqes_len = p.sq_entries*sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, r->sqes_len, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED)
+        return false;
+    r->sqes = (io_uring_sqe*)sqes;
+
+    char *sqc = (char*)sq, *cqc = (char*)cq;
+    r->sq_head = (unsigned*)(sqc + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sqc + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sqc + p.sq_off.ring_mask);
+    unsigned *sq_array = (unsigned*)(sqc + p.sq_off.array);
+    for(unsigned i=0; i<p.sq_entries; ++i)
+        sq_array[i] = i;
+    r->sq_local_tail = *r->sq_tail;
+    r->to_submit     = 0;
+    r->cq_head = (unsigned*)(cqc + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cqc + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cqc + p.cq_off.ring_mask);
+    r->cqes    = (io_uring_cqe*)(cqc + p.cq_off.cqes);
+
+    //ring of provided buffers
+    r->br_len = r->nbufs*sizeof(io_uring_buf);
+    void *br = mmap(nullptr, r->br_len, PROT_READ|PROT_WRITE,
+                    MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if(br == MAP_FAILED)
+        return false;
+    r->br = (io_uring_buf*)br;
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)(uintptr_t)br;
+    reg.ring_entries = r->nbufs;
+    reg.bgid         = BUF_GROUP;
+    if(uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+        return false;
+    r->br_tail = 0;
+    for(unsigned i=0; i<r->nbufs; ++i)
+        add_buffer(r, i);
+    publish_buffers(r);
+    return true;
+}
+
+static io_uring_sqe *get_sqe(uring_t *r)
+{
+    const unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if(r->sq_local_tail - head > *r->sq_mask)
+        return nullptr;
+    io_uring_sqe *sqe = r->sqes + (r->sq_local_tail++ & *r->sq_mask);
+    memset(sqe, 0, sizeof(*sqe));
+    ++r->to_submit;
+    return sqe;
+}
+
+static int submit(uring_t *r, unsigned min_complete = 0)
+{
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    const unsigned n = r->to_submit;
+    int ret;
+    do
+        ret = uring_enter(r->fd, n, min_complete,
+                          min_complete ? IORING_ENTER_GETEVENTS : 0);
+    while(ret == -1 && errno == EINTR);
+    if(ret >= 0)
+        r->to_submit -= (unsigned)ret < n ? ret : n;
+    return ret;
+}
+
+static void arm_receive(uring_t *r, int sock)
+{
+    io_uring_sqe *sqe = get_sqe(r);
+    if(!sqe)
+        return;
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = sock;
+    sqe->addr      = (uint64_t)(uintptr_t)&r->recv_hdr;
+    sqe->len       = 1;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = RECV_TAG;
+    r->armed = submit(r) >= 0;
+}
+
+UringTransport::UringTransport(size_t max_message_length, size_t batch,
+                               size_t buffers)
+    :MaxMsg(max_message_length), Batch(batch ? batch : 1),
+     Buffers(round_pow2(buffers ? buffers : 4*Batch)), sock(-1),
+     zero_copy(false), ring(new uring_t), send_pool(new_pool(MaxMsg, Batch)),
+     send_count(0), msgs(new const char*[Batch]), lens(new size_t[Batch]),
+     peers(new UdpPeer[Batch]), bids(new unsigned short[Batch]), nbids(0),
+     stat_received(0), stat_dropped(0), stat_sent(0), stat_send_errors(0)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->fd       = -1;
+    ring->nbufs    = Buffers;
+    ring->buf_size = (sizeof(io_uring_recvmsg_out) + sizeof(UdpPeer::addr) +
+                      MaxMsg + 7) & ~(size_t)7;
+    ring->bufs     = new char[ring->nbufs*ring->buf_size];
+    ring->done     = new unsigned short[ring->nbufs];
+    ring->recv_hdr.msg_namelen = sizeof(UdpPeer::addr);
+}
+
+UringTransport::~UringTransport(void)
+{
+    close();
+    delete[] ring->bufs;
+    delete[] ring->done;
+    delete ring;
+    delete_pool(send_pool);
+    delete[] msgs;
+    delete[] lens;
+    delete[] peers;
+    delete[] bids;
+}
+
+bool UringTransport::open(unsigned short port, const char *host)
+{
+    close();
+    stat_received = stat_dropped = stat_sent = stat_send_errors = 0;
+    //room for all sends of a flush and for arming the receive
+    if(!map_ring(ring, Batch+1, ring->nbufs + 2*Batch + 2)) {
+        unmap_ring(ring);
+        return false;
+    }
+    sock = open_socket(port, host);
+    if(sock == -1) {
+        unmap_ring(ring);
+        return false;
+    }
+    arm_receive(ring, sock);
+    if(!ring->armed) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UringTransport::close(void)
+{
+    //closing the ring cancels the receive request
+    unmap_ring(ring);
+    if(sock != -1)
+        ::close(sock);
+    sock              = -1;
+    send_count        = 0;
+    nbids             = 0;
+    ring->armed       = false;
+    ring->failed      = false;
+    ring->done_head   = ring->done_count = 0;
+    ring->sends_pending = ring->notifs_pending = 0;
+}
+
+int UringTransport::ring_fd(void) const
+{
+    return ring->fd;
+}
+
+unsigned short UringTransport::port(void) const
+{
+    return socket_port(sock);
+}
+
+//Move all completions out of the completion queue
+void UringTransport::reap(void)
+{
+    uring_t *r = ring;
+    unsigned head = *r->cq_head;
+    const unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; ++head) {
+        const io_uring_cqe &cqe = r->cqes[head & *r->cq_mask];
+        if(cqe.user_data == RECV_TAG) {
+            if(!(cqe.flags & IORING_CQE_F_MORE))
+                r->armed = false;
+            if(cqe.res < 0 && cqe.res != -ENOBUFS)
+                r->failed = true;
+            if(cqe.res >= 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+                const size_t at = (r->done_head + r->done_count++) % r->nbufs;
+                r->done[at] = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            }
+        } else if(cqe.flags & IORING_CQE_F_NOTIF) {
+            --r->notifs_pending;
+        } else {
+            --r->sends_pending;
+            if(cqe.res < 0)
+                ++r->sends_failed;
+            else
+                ++r->sends_ok;
+            if(cqe.flags & IORING_CQE_F_MORE)
+                ++r->notifs_pending;
+        }
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+void UringTransport::give_back(void)
+{
+    for(size_t i=0; i<nbids; ++i)
+        add_buffer(ring, bids[i]);
+    if(nbids)
+        publish_buffers(ring);
+    nbids = 0;
+    //the receive ends if all buffers have been in use
+    if(!ring->armed && !ring->failed && sock != -1)
+        arm_receive(ring, sock);
+}
+
+size_t UringTransport::fill(void)
+{
+    if(sock == -1)
+        return 0;
+    reap();
+    size_t valid = 0;
+    uring_t *r = ring;
+    while(nbids < Batch && r->done_count) {
+        const unsigned short bid = r->done[r->done_head];
+        r->done_head = (r->done_head + 1) % r->nbufs;
+        --r->done_count;
+        bids[nbids++] = bid;
+
+        const char *buf = r->bufs + bid*r->buf_size;
+        const io_uring_recvmsg_out *out = (const io_uring_recvmsg_out*)buf;
+        const char *name = (const char*)(out+1);
+        const char *msg  = name + sizeof(UdpPeer::addr);
+        const size_t len = out->payloadlen;
+        if((out->flags & MSG_TRUNC) || len > MaxMsg ||
+           !valid_datagram(msg, len)) {
+            ++stat_dropped;
+            continue;
+        }
+        msgs[valid] = msg;
+        lens[valid] = len;
+        const size_t namelen = out->namelen < sizeof(UdpPeer::addr)
+                             ? out->namelen : sizeof(UdpPeer::addr);
+        memcpy(peers[valid].addr, name, namelen);
+        peers[valid].len = namelen;
+        ++valid;
+    }
+    stat_received += valid;
+    if(!valid)
+        give_back();
+    return valid;
+}
+
+bool UringTransport::wait(int timeout_ms)
+{
+    if(sock == -1)
+        return false;
+    reap();
+    if(ring->done_count)
+        return true;
+    if(ring->failed)
+        return false;
+    if(!ring->armed)
+        arm_receive(ring, sock);
+    pollfd pfd;
+    pfd.fd      = ring->fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do
+        ret = poll(&pfd, 1, timeout_ms);
+    while(ret == -1 && errno == EINTR);
+    return ret > 0 && (pfd.revents & POLLIN);
+}
+
+size_t UringTransport::receive_batch(batch_cb_t cb, void *data)
+{
+    const size_t n = fill();
+    if(n) {
+        cb(msgs, lens, peers, n, data);
+        give_back();
+    }
+    return n;
+}
+
+size_t UringTransport::receive(read_cb_t cb, void *data)
+{
+    const size_t n = fill();
+    for(size_t i=0; i<n; ++i)
+        cb(msgs[i], lens[i], peers[i], data);
+    if(n)
+        give_back();
+    return n;
+}
+
+size_t UringTransport::receive(ThreadLink &link)
+{
+    const size_t n = fill();
+    size_t written = 0;
+    for(size_t i=0; i<n; ++i) {
+        char *buf = link.reserve(lens[i]);
+        if(!buf)
+            continue;
+        memcpy(buf, msgs[i], lens[i]);
+        link.commit(lens[i]);
+        ++written;
+    }
+    if(n)
+        give_back();
+    return written;
+}
+
+bool UringTransport::queue(const char *msg, size_t len, const UdpPeer &to)
+{
+    if(len > MaxMsg || to.len > sizeof(to.addr) || sock == -1)
+        return false;
+    if(send_count == Batch && (flush(), send_count == Batch))
+        return false;
+    const size_t i = send_count++;
+    memcpy(send_pool->iov[i].iov_base, msg, len);
+    send_pool->iov[i].iov_len = len;
+    memcpy(send_pool->peers[i].addr, to.addr, to.len);
+    hdr_of(send_pool, i).msg_namelen = to.len;
+    return true;
+}
+
+size_t UringTransport::flush(void)
+{
+    if(!send_count)
+        return 0;
+    uring_t *r = ring;
+    r->sends_ok = r->sends_failed = 0;
+    for(size_t i=0; i<send_count; ++i) {
+        io_uring_sqe *sqe = get_sqe(r);
+        if(!sqe) {
+            ++stat_send_errors;
+            continue;
+        }
+        sqe->opcode    = zero_copy ? IORING_OP_SENDMSG_ZC : IORING_OP_SENDMSG;
+        sqe->fd        = sock;
+        sqe->addr      = (uint64_t)(uintptr_t)&hdr_of(send_pool, i);
+        sqe->len       = 1;
+        sqe->user_data = i;
+        ++r->sends_pending;
+    }
+    submit(r);
+    //the pool can only be reused when the kernel is done with it
+    reap();
+    while(r->sends_pending || r->notifs_pending) {
+        int ret;
+        do
+            ret = uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS);
+        while(ret == -1 && errno == EINTR);
+        if(ret < 0)
+            break;
+        reap();
+    }
+    for(size_t i=0; i<send_count; ++i)
+        send_pool->iov[i].iov_len = MaxMsg;
+    send_count        = 0;
+    stat_sent        += r->sends_ok;
+    stat_send_errors += r->sends_failed;
+    return r->sends_ok;
+}
+
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <rtosc/worker-pool.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rtosc {
+
+namespace {
+    //! the pool and the index of the worker running on this thread
+    thread_local const WorkerPool *this_pool = nullptr;
+    thread_local unsigned this_worker = 0;
+
+    //! jobs of one round of run(), so they fit into a range_t
+    constexpr size_t max_jobs = 0xffffffff;
+
+    std::mutex shared_mutex;
+    WorkerPool::options_t shared_options;
+
+    WorkerPool::options_t get_shared_options(void)
+    {
+        std::lock_guard<std::mutex> lock(shared_mutex);
+        return shared_options;
+    }
+
+    WorkerPool::options_t with_threads(unsigned threads)
+    {
+        WorkerPool::options_t options;
+        options.threads = threads;
+        return options;
+    }
+
+#ifdef __linux__
+    //! read a list of cores from sysfs, like "0-3,8"
+    std::vector<int> read_cpulist(const char *path)
+    {
+        std::vector<int> res;
+        FILE *fp = fopen(path, "r");
+        if(!fp)
+            return res;
+        int first, last;
+        while(fscanf(fp, "%d", &first) == 1)
+        {
+            last = first;
+            int c = fgetc(fp);
+            if(c == '-') {
+                if(fscanf(fp, "%d", &last) != 1)
+                    break;
+                c = fgetc(fp);
+            }
+            for(int cpu = first; cpu <= last; ++cpu)
+                res.push_back(cpu);
+            if(c != ',')
+                break;
+        }
+        fclose(fp);
+        return res;
+    }
+
+    //! NUMA node of @p cpu, or -1 if unknown
+    int node_of(int cpu)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR *dir = opendir(path);
+        if(!dir)
+            return -1;
+        int node = -1;
+        while(const dirent *entry = readdir(dir))
+            if(sscanf(entry->d_name, "node%d", &node) == 1)
+                break;
+        closedir(dir);
+        return node;
+    }
+
+    /*
+        cores of this process which the workers can use: all but the one
+        to avoid and its hyperthreads, the ones of its NUMA node first
+    */
+    std::vector<int> usable_cpus(int avoid_cpu)
+    {
+        std::vector<int> all;
+        cpu_set_t set;
+        if(sched_getaffinity(0, sizeof(set), &set))
+            return all;
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if(CPU_ISSET(cpu, &set))
+                all.push_back(cpu);
+        if(avoid_cpu < 0)
+            return all;
+
+        char path[96];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+                 avoid_cpu);
+        std::vector<int> avoid = read_cpulist(path);
+        avoid.push_back(avoid_cpu);
+        const int node = node_of(avoid_cpu);
+
+        std::vector<int> local, remote;
+        for(int cpu : all)
+            if(std::find(avoid.begin(), avoid.end(), cpu) == avoid.end())
+                (node_of(cpu) == node ? local : remote).push_back(cpu);
+        local.insert(local.end(), remote.begin(), remote.end());
+        return local.empty() ? all : local;
+    }
+
+    void place(std::thread &t, const std::vector<int> &cpus, bool idle)
+    {
+        if(!cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(int cpu : cpus)
+                CPU_SET(cpu, &set);
+            pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+        }
+        if(idle)
+        {
+            sched_param param;
+            param.sched_priority = 0;
+            pthread_setschedparam(t.native_handle(), SCHED_IDLE, &param);
+        }
+    }
+#else
+    std::vector<int> usable_cpus(int) { return std::vector<int>(); }
+    void place(std::thread&, const std::vector<int>&, bool) {}
+#endif
+}
+
+WorkerPool::WorkerPool(unsigned threads)
+    :WorkerPool(with_threads(threads))
+{}
+
+WorkerPool::WorkerPool(const options_t &options)
+    :current(nullptr), offset(0), busy(0), generation(0), quit(false)
+{
+    const std::vector<int> usable = usable_cpus(options.avoid_cpu);
+    unsigned threads = options.threads;
+    if(!threads)
+        threads = usable.size();
+    if(!threads)
+        threads = std::thread::hardware_concurrency();
+    if(!threads)
+        threads = 1;
+
+    ranges = std::vector<range_t>(threads);
+    for(unsigned i=0; i<threads; ++i)
+    {
+        cpus.push_back((options.pin && !usable.empty())
+                       ? usable[i % usable.size()] : -1);
+        workers.emplace_back(&WorkerPool::work, this, i);
+        // unpinned workers may run anywhere, but away from the core to avoid
+        std::vector<int> allowed;
+        if(cpus[i] >= 0)
+            allowed.push_back(cpus[i]);
+        else if(options.avoid_cpu >= 0)
+            allowed = usable;
+        place(workers[i], allowed, options.low_priority);
+    }
+}
+
+WorkerPool::~WorkerPool(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for(std::thread &t : workers)
+        t.join();
+}
+
+WorkerPool &WorkerPool::shared(void)
+{
+    static WorkerPool pool(get_shared_options());
+    return pool;
+}
+
+void WorkerPool::set_shared_options(const options_t &options)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    shared_options = options;
+}
+
+void WorkerPool::run(size_t n, const job_t &job)
+{
+    if(this_pool == this)
+    {
+        // the workers are busy with the jobs of the outer run()
+        for(size_t i = 0; i < n; ++i)
+            job(i, this_worker);
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(run_mutex);
+    const uint64_t nworkers = workers.size();
+    for(size_t first = 0; first < n; first += max_jobs)
+    {
+        const uint64_t count = std::min(n - first, max_jobs);
+        for(uint64_t i = 0; i < nworkers; ++i)
+            ranges[i].jobs.store((count * i / nworkers) << 32 |
+                                 (count * (i + 1) / nworkers),
+                                 std::memory_order_relaxed);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        current = &job;
+        offset  = first;
+        busy    = nworkers;
+        ++generation;
+        wake.notify_all();
+        done.wait(lock, [this]{ return !busy; });
+        current = nullptr;
+    }
+}
+
+bool WorkerPool::next(unsigned worker, uint32_t &job)
+{
+    std::atomic<uint64_t> &own = ranges[worker].jobs;
+    while(true)
+    {
+        uint64_t range = own.load(std::memory_order_acquire);
+        const uint32_t begin = range >> 32, end = range;
+        if(begin < end)
+        {
+            if(own.compare_exchange_weak(range,
+                                         (uint64_t)(begin + 1) << 32 | end,
+                                         std::memory_order_acq_rel)) {
+                job = begin;
+                return true;
+            }
+        }
+        else if(!steal(worker))
+            return false;
+    }
+}
+
+bool WorkerPool::steal(unsigned thief)
+{
+    const unsigned n = ranges.size();
+    for(unsigned k = 1; k < n; ++k)
+    {
+        std::atomic<uint64_t> &victim = ranges[(thief + k) % n].jobs;
+        uint64_t range = victim.load(std::memory_order_acquire);
+        uint32_t begin = range >> 32, end = range;
+        while(begin < end)
+        {
+            // take the upper half, which the victim would run last
+            const uint32_t mid = begin + (end - begin) / 2;
+            if(victim.compare_exchange_weak(range,
+                                            (uint64_t)begin << 32 | mid,
+                                            std::memory_order_acq_rel)) {
+                // the own range is empty, so no other thief changes it
+                ranges[thief].jobs.store((uint64_t)mid << 32 | end,
+                                         std::memory_order_release);
+                return true;
+            }
+            begin = range >> 32;
+            end = range;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::work(unsigned worker)
+{
+    this_pool = this;
+    this_worker = worker;
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        wake.wait(lock, [&]{ return quit || generation != seen; });
+        if(quit)
+            return;
+        seen = generation;
+        const job_t &job  = *current;
+        const size_t first = offset;
+
+        lock.unlock();
+        uint32_t i;
+        while(next(worker, i))
+            job(first + i, worker);
+        lock.lock();
+
+        if(!--busy)
+            done.notify_one();
+    }
+}
+
+}
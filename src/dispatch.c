@@ -142,6 +142,217 @@ bool rtosc_match(const char *pattern,
     return true;
 }
 
+/*
+ * Compiled patterns
+ *
+ * A program is a sequence of operations, which replay the decisions of
+ * rtosc_match_path() for one pattern, followed by a copy of the pattern.
+ * Operations which end the match refer to the argument part of that copy.
+ * Numbers are stored unaligned in host byte order.
+ */
+enum {
+    PAT_LIT,    //!< length byte and characters, compared verbatim
+    PAT_NUM,    //!< '#': 32 bit bound
+    PAT_OPT,    //!< '{}': count byte, then length byte and chars per option
+    PAT_STAR,   //!< '*': skip the message until '/' or its end
+    PAT_COLON,  //!< ':': accept at the message end, else compare ':'
+    PAT_ACCEPT, //!< accept after a trailing '/'
+    PAT_END,    //!< accept at the message end, else fail
+    PAT_FAIL
+};
+
+typedef struct {
+    char  *prog;
+    size_t size, len;
+} pat_writer;
+
+static void pat_put(pat_writer *w, const void *data, size_t len)
+{
+    if(w->len + len <= w->size)
+        memcpy(w->prog + w->len, data, len);
+    w->len += len;
+}
+
+static void pat_op(pat_writer *w, uint8_t op)
+{
+    pat_put(w, &op, 1);
+}
+
+static void pat_op32(pat_writer *w, uint8_t op, uint32_t val)
+{
+    pat_op(w, op);
+    pat_put(w, &val, 4);
+}
+
+static uint32_t pat_get32(const uint8_t *p)
+{
+    uint32_t val;
+    memcpy(&val, p, 4);
+    return val;
+}
+
+static bool pat_is_special(char c)
+{
+    return !c || c == ':' || c == '{' || c == '*' || c == '#' || c == '/';
+}
+
+size_t rtosc_pattern_compile(const char *pattern, char *prog, size_t size)
+{
+    pat_writer w = {prog, size, 0};
+    const char *p = pattern;
+    //the copy of the pattern follows the program, whose size is not known
+    //yet, so offsets are relative to the pattern until the end
+    uint32_t fixups[64];
+    size_t   nfixups = 0;
+
+    while(1) {
+        const char *lit = p;
+        while(!pat_is_special(*p) && p - lit < 255)
+            ++p;
+        if(p != lit) {
+            const uint8_t len = p - lit;
+            pat_op(&w, PAT_LIT);
+            pat_put(&w, &len, 1);
+            pat_put(&w, lit, len);
+            continue;
+        }
+        if(*p == ':' || !*p) {
+            if(nfixups == sizeof(fixups)/sizeof(fixups[0]))
+                return 0;
+            fixups[nfixups++] = w.len + 1;
+            pat_op32(&w, *p ? PAT_COLON : PAT_END, p - pattern);
+            if(!*p++)
+                break;
+        } else if(*p == '/') {
+            pat_op(&w, PAT_LIT);
+            pat_put(&w, "\1/", 2);
+            if(!*++p || *p == ':') {
+                if(nfixups == sizeof(fixups)/sizeof(fixups[0]))
+                    return 0;
+                fixups[nfixups++] = w.len + 1;
+                pat_op32(&w, PAT_ACCEPT, p - pattern);
+                break;
+            }
+        } else if(*p == '#') {
+            if(!isdigit(*++p)) {
+                pat_op(&w, PAT_FAIL);
+                break;
+            }
+            pat_op32(&w, PAT_NUM, atoi(p));
+            while(isdigit(*p))
+                ++p;
+        } else if(*p == '*') {
+            while(*p && *p != '/' && *p != ':')
+                ++p;
+            if(*p)
+                pat_op(&w, PAT_STAR);
+        } else { // '{'
+            const size_t count_pos = w.len + 1;
+            uint8_t count = 0;
+            pat_op(&w, PAT_OPT);
+            pat_put(&w, &count, 1);
+            for(++p;;) {
+                const char *opt = p;
+                while(*p && *p != ',' && *p != '}')
+                    ++p;
+                if(!*p) //an unterminated last option never matches
+                    break;
+                if(p - opt > 255 || count == 255)
+                    return 0;
+                const uint8_t len = p - opt;
+                pat_put(&w, &len, 1);
+                pat_put(&w, opt, len);
+                ++count;
+                if(*p++ == '}')
+                    break;
+            }
+            if(count_pos < w.size)
+                w.prog[count_pos] = count;
+        }
+    }
+
+    //relocate the offsets to the copy of the pattern and append it
+    const uint32_t base = w.len;
+    for(size_t i = 0; i < nfixups && w.len <= w.size; ++i) {
+        const uint32_t off = pat_get32((const uint8_t*)prog + fixups[i]) + base;
+        memcpy(prog + fixups[i], &off, 4);
+    }
+    pat_put(&w, pattern, strlen(pattern) + 1);
+    return w.len;
+}
+
+const char *rtosc_pattern_match_path(const char *prog, const char *msg,
+                                     const char **path_end)
+{
+    const uint8_t *op = (const uint8_t*)prog;
+    while(1) {
+        switch(*op) {
+            case PAT_LIT:
+                if(strncmp((const char*)op + 2, msg, op[1]))
+                    return NULL;
+                msg += op[1];
+                op  += 2 + op[1];
+                break;
+            case PAT_NUM:
+                if(!isdigit(*msg) || (unsigned)atoi(msg) >= pat_get32(op+1))
+                    return NULL;
+                while(isdigit(*msg))
+                    ++msg;
+                op += 5;
+                break;
+            case PAT_OPT:
+            {
+                const uint8_t *opt = op + 2;
+                const uint8_t *matched = NULL;
+                for(int i = 0; i < op[1]; ++i, opt += 1 + *opt)
+                    if(!matched && !strncmp((const char*)opt + 1, msg, *opt))
+                        matched = opt;
+                if(!matched)
+                    return NULL;
+                msg += *matched;
+                op = opt;
+                break;
+            }
+            case PAT_STAR:
+                while(*msg && *msg != '/')
+                    ++msg;
+                ++op;
+                break;
+            case PAT_COLON:
+                if(!*msg) {
+                    if(path_end)
+                        *path_end = msg;
+                    return prog + pat_get32(op+1);
+                }
+                if(*msg++ != ':')
+                    return NULL;
+                op += 5;
+                break;
+            case PAT_END:
+                if(*msg)
+                    return NULL;
+                // fall through
+            case PAT_ACCEPT:
+                if(path_end)
+                    *path_end = msg;
+                return prog + pat_get32(op+1);
+            default:
+                return NULL;
+        }
+    }
+}
+
+bool rtosc_pattern_match(const char *prog, const char *msg,
+                         const char **path_end)
+{
+    const char *arg_pattern = rtosc_pattern_match_path(prog, msg, path_end);
+    if(!arg_pattern)
+        return false;
+    else if(*arg_pattern == ':')
+        return rtosc_match_args(arg_pattern, msg);
+    return true;
+}
+
 
 
 /*
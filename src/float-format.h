@@ -0,0 +1,45 @@
+ /**
+ * @file float-format.h
+ * Formatting of floating point numbers without printf
+ *
+ * @test pretty-format.c
+ */
+
+#ifndef FLOAT_FORMAT_H
+#define FLOAT_FORMAT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Buffer size which is sufficient for all functions below
+#define RTOSC_FLOAT_BUFSIZE 32
+
+/**
+ * Write the shortest decimal number which reads back as exactly @p f
+ *
+ * The number always contains a period, so it can not be confused with an
+ * integer, e.g. "1.0", "0.1", "1.5e+20". Infinity and NaN are written as
+ * "inf" and "nan", with an optional minus.
+ * @param buffer Must hold RTOSC_FLOAT_BUFSIZE bytes
+ * @return The number of bytes written, excluding the null byte
+ */
+size_t rtosc_shortest_float(float f, char *buffer);
+//! Same as rtosc_shortest_float(), for doubles
+size_t rtosc_shortest_double(double d, char *buffer);
+
+/**
+ * Write @p d in hexadecimal floating point notation, like printf's "%a"
+ * does in glibc, e.g. "0x1.8p+0"
+ * @param buffer Must hold RTOSC_FLOAT_BUFSIZE bytes
+ * @return The number of bytes written, excluding the null byte
+ */
+size_t rtosc_hex_double(double d, char *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLOAT_FORMAT_H
@@ -1,7 +1,10 @@
 #include "util.h"
+#include "float-format.h"
 #include <assert.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
@@ -27,7 +30,7 @@
 */
 
 static const rtosc_print_options* default_print_options
- = &((rtosc_print_options) { true, 2, " ", 80, true});
+ = &((rtosc_print_options) { true, 2, " ", 80, true, false});
 
 /** Call snprintf and assert() that it did fit into the buffer */
 static int asnprintf(char* str, size_t size, const char* format, ...)
@@ -201,14 +204,25 @@ static int rtosc_print_range(const rtosc_arg_val_t* arg,
     char* last_sep = buffer - 1;
     int args_written_this_line = (cols_used) ? 1 : 0;
 
+    // range args are computed in chunks
+    rtosc_arg_val_t chunk[32];
+    int chunk_start = start, chunk_end = start;
+
     for(int i = start; i < val->r.num; ++i)
     {
-        rtosc_arg_val_t tmparg;
         const rtosc_arg_val_t *cur;
         if(val->r.has_delta)
         {
-            rtosc_arg_val_range_arg(arg, i, &tmparg);
-            cur = &tmparg;
+            if(i == chunk_end)
+            {
+                int n = val->r.num - i;
+                if(n > (int)(sizeof(chunk)/sizeof(chunk[0])))
+                    n = sizeof(chunk)/sizeof(chunk[0]);
+                rtosc_arg_val_range_args(arg, i, n, chunk);
+                chunk_start = i;
+                chunk_end = i + n;
+            }
+            cur = chunk + (i - chunk_start);
         }
         else
             cur = arg + 1;
@@ -290,6 +304,69 @@ static const char* numeric_range_convertible_types()
 //! @param arg_out array, output which must have the size of arg or more;
 //!        may be the same as arg
 //! @return The number of really skipped argument values
+//! types which simple_run() can handle
+static const char* simple_range_types() { return "cihfdTF"; }
+
+/**
+ * Find the run of arguments which continue the first two arguments' delta
+ *
+ * Equivalent to the generic loop in rtosc_convert_to_range(), but it only
+ * dispatches the type once and then compares the raw values in a tight loop.
+ * @param arg Argument array, at least 2 arguments of the same type
+ *   from simple_range_types()
+ * @param skipped Will be set to the length of the run
+ * @param has_delta Will be set to whether the run has a non-zero delta
+ * @return false if a run is impossible for this type
+ */
+static int simple_run(const rtosc_arg_val_t* arg, size_t size,
+                      int32_t* skipped, int* has_delta)
+{
+    const char type = arg->type;
+    size_t i = 2;
+    switch(type)
+    {
+        case 'c':
+        case 'i':
+        {
+            // unsigned arithmetic to wrap like rtosc_arg_val_add()
+            const uint32_t d = (uint32_t)arg[1].val.i - (uint32_t)arg[0].val.i;
+            for(; i < size && arg[i].type == type &&
+                  (uint32_t)arg[i].val.i - (uint32_t)arg[i-1].val.i == d; ++i) ;
+            *has_delta = !!d;
+            break;
+        }
+        case 'h':
+        {
+            const uint64_t d = (uint64_t)arg[1].val.h - (uint64_t)arg[0].val.h;
+            for(; i < size && arg[i].type == type &&
+                  (uint64_t)arg[i].val.h - (uint64_t)arg[i-1].val.h == d; ++i) ;
+            *has_delta = !!d;
+            break;
+        }
+        // floats are no range convertible types, so only repetitions count
+        case 'f':
+            if(arg[1].val.f != arg[0].val.f)
+                return false;
+            for(; i < size && arg[i].type == type &&
+                  arg[i].val.f == arg[0].val.f; ++i) ;
+            *has_delta = false;
+            break;
+        case 'd':
+            if(arg[1].val.d != arg[0].val.d)
+                return false;
+            for(; i < size && arg[i].type == type &&
+                  arg[i].val.d == arg[0].val.d; ++i) ;
+            *has_delta = false;
+            break;
+        default: // 'T', 'F'
+            for(; i < size && arg[i].type == type; ++i) ;
+            *has_delta = false;
+            break;
+    }
+    *skipped = (int32_t)i;
+    return true;
+}
+
 static int32_t rtosc_convert_to_range(const rtosc_arg_val_t* const arg,
                                       size_t size,
                                       rtosc_arg_val_t* arg_out,
@@ -299,7 +376,10 @@ static int32_t rtosc_convert_to_range(const rtosc_arg_val_t* const arg,
         return 0;
     char type = arg->type;
     size_t num_common = 0;
-    for(size_t i = 0; i < size; i += incsize(arg+i), ++num_common)
+    // the loops below check the types of all further args, so only
+    // check as many as required for a range
+    for(size_t i = 0; i < size && num_common < range_min;
+        i += incsize(arg+i), ++num_common)
     {
         if(type != arg[i].type)
             break;
@@ -308,32 +388,45 @@ static int32_t rtosc_convert_to_range(const rtosc_arg_val_t* const arg,
         return 0;
 
     int32_t skipped;
-    num_common = 1;
     int has_delta;
     rtosc_arg_val_t delta, added;
 
-    if(rtosc_arg_vals_eq_single(arg, arg + incsize(arg), NULL))
-        has_delta = 0;
-    else if(strchr(numeric_range_convertible_types(), arg->type)) {
-        has_delta = 1;
-        rtosc_arg_val_sub(arg+1, arg, &delta);
+    if(strchr(simple_range_types(), type))
+    {
+        // fast path: arguments without size and with simple comparison
+        if(!simple_run(arg, size, &skipped, &has_delta))
+            return 0;
+        if(has_delta)
+            rtosc_arg_val_sub(arg+1, arg, &delta);
+        num_common = skipped;
     }
-    else return 0;
-
+    else
     {
-        int go_on = 1;
-        size_t next;
-        for(skipped = incsize(arg); go_on; skipped = next, ++num_common)
+        num_common = 1;
+
+        if(rtosc_arg_vals_eq_single(arg, arg + incsize(arg), NULL))
+            has_delta = 0;
+        else if(strchr(numeric_range_convertible_types(), arg->type)) {
+            has_delta = 1;
+            rtosc_arg_val_sub(arg+1, arg, &delta);
+        }
+        else return 0;
+
         {
-            next = skipped + incsize(arg+skipped);
+            int go_on = 1;
+            size_t next;
+            for(skipped = incsize(arg); go_on; skipped = next, ++num_common)
+            {
+                next = skipped + incsize(arg+skipped);
 
-            if(has_delta)
-                rtosc_arg_val_add(arg+skipped, &delta, &added);
+                if(has_delta)
+                    rtosc_arg_val_add(arg+skipped, &delta, &added);
 
-            if(next >= size || !rtosc_arg_vals_eq_single(has_delta ? &added
-                                                                   : arg,
-                                                         arg+next, NULL))
-                go_on = false;
+                if(next >= size ||
+                   !rtosc_arg_vals_eq_single(has_delta ? &added : arg,
+                                             arg+next, NULL))
+                    go_on = false;
+            }
         }
     }
 
@@ -444,6 +537,22 @@ size_t rtosc_print_arg_val(const rtosc_arg_val_t *arg,
         case 'd':
         case 'f':
         {
+            char num[RTOSC_FLOAT_BUFSIZE];
+            size_t len;
+            if(opt->shortest_floats)
+            {
+                // reads back exactly, so no lossless part is required
+                len = (arg->type == 'f') ? rtosc_shortest_float(val->f, num)
+                                         : rtosc_shortest_double(val->d, num);
+                if(arg->type == 'd')
+                    num[len++] = 'd';
+                assert(len < bs);
+                memcpy(buffer, num, len);
+                buffer[len] = 0;
+                wrt = len;
+                break;
+            }
+
             int prec = opt->floating_point_precision;
             assert(prec>=0);
             assert(prec<100);
@@ -453,18 +562,25 @@ size_t rtosc_print_arg_val(const rtosc_arg_val_t *arg,
                 // e.g. "%.42f" or "%.0f.":
                 asnprintf(fmtstr, 6, "%%#.%df", prec);
                 wrt = asnprintf(buffer, bs, fmtstr, val->f);
-                if(opt->lossless)
-                    wrt += asnprintf(buffer + wrt, bs - wrt,
-                                     " (%a)", val->f);
             }
             else
             {
                 // e.g. "%.42lfd" or "%.0lf.d"
                 asnprintf(fmtstr, 8, "%%#.%dlfd", prec);
                 wrt = asnprintf(buffer, bs, fmtstr, val->d);
-                if(opt->lossless)
-                    wrt += asnprintf(buffer + wrt, bs - wrt,
-                                     " (%la)", val->d);
+            }
+            if(opt->lossless)
+            {
+                // same as " (%a)", without another snprintf() call
+                len = rtosc_hex_double((arg->type == 'f') ? val->f : val->d,
+                                       num);
+                assert(wrt + len + 3 < bs);
+                buffer[wrt++] = ' ';
+                buffer[wrt++] = '(';
+                memcpy(buffer + wrt, num, len);
+                wrt += len;
+                buffer[wrt++] = ')';
+                buffer[wrt] = 0;
             }
             break;
         }
@@ -682,6 +798,326 @@ size_t rtosc_print_message(const char* address,
     return wrt;
 }
 
+/*
+ * Streaming printer
+ *
+ * Values are printed like in rtosc_print_arg_vals(), but only a small window
+ * is kept in memory: the separator that has not been passed to the sink yet,
+ * followed by the value being printed. Line breaks only modify the window.
+ * Top level arrays and blobs are passed to the sink element by element.
+ */
+
+typedef struct
+{
+    rtosc_print_sink sink;
+    void* data;
+    size_t written; //!< bytes passed to the sink
+    int failed;     //!< the sink has returned non-zero
+    char* window;   //!< window[0] is a guard, which is whitespace
+    size_t window_size;
+    size_t out_len;
+    char out[4096]; //!< output which will be passed to the sink at once
+} print_stream;
+
+static void stream_flush(print_stream* st)
+{
+    if(st->out_len && !st->failed)
+    {
+        if(st->sink(st->out, st->out_len, st->data))
+            st->failed = 1;
+        else
+            st->written += st->out_len;
+    }
+    st->out_len = 0;
+}
+
+static void stream_write(print_stream* st, const char* str, size_t len)
+{
+    if(st->out_len + len > sizeof(st->out))
+    {
+        stream_flush(st);
+        if(len > sizeof(st->out))
+        {
+            if(!st->failed && st->sink(str, len, st->data))
+                st->failed = 1;
+            else if(!st->failed)
+                st->written += len;
+            return;
+        }
+    }
+    memcpy(st->out + st->out_len, str, len);
+    st->out_len += len;
+}
+
+/**
+ * Return a window holding @p prefix and @p size more bytes
+ * @return A pointer to the prefix. The byte before is a whitespace guard.
+ */
+static char* stream_window(print_stream* st, const char* prefix, size_t size)
+{
+    size_t prefix_len = strlen(prefix);
+    size_t required = 1 + prefix_len + size;
+    if(required > st->window_size)
+    {
+        char* window = realloc(st->window, required);
+        if(!window)
+            return NULL;
+        st->window = window;
+        st->window_size = required;
+    }
+    st->window[0] = ' ';
+    memcpy(st->window + 1, prefix, prefix_len);
+    return st->window + 1;
+}
+
+//! Pass the window to the sink, after a value of @p len bytes was printed
+static void stream_write_window(print_stream* st, const char* window,
+                                size_t len)
+{
+    // a line break before the first value also modifies the guard
+    if(window[-1] != ' ')
+        stream_write(st, window - 1, 1);
+    stream_write(st, window, len);
+}
+
+//! Upper bound for the bytes that rtosc_print_arg_val() writes
+static size_t print_size_bound(const rtosc_arg_val_t* arg,
+                               const rtosc_print_options* opt)
+{
+    // numbers, "%#.99f" with 309 digits before the period being the largest
+    const size_t scalar_bound = 512;
+    // line breaks insert at most 8 bytes
+    const size_t break_bound = 8;
+    switch(arg->type)
+    {
+        case 's':
+        case 'S':
+        {
+            // all characters may be escaped, and strings break at the line
+            // length or at newline characters
+            size_t len = 0, newlines = 0;
+            for(const char* s = arg->val.s; *s; ++s, ++len)
+                newlines += (*s == '\n');
+            size_t chars_per_line = (opt->linelength > 9)
+                                  ? (size_t)opt->linelength - 8 : 1;
+            size_t breaks = (2 * len) / chars_per_line + newlines + 2;
+            return 8 + 2 * len + break_bound * breaks;
+        }
+        case 'b':
+            return 32 + (5 + break_bound) * arg->val.b.len;
+        case 'a':
+        {
+            size_t bound = 8;
+            for(int32_t i = 1; i <= arg->val.a.len;)
+            {
+                bound += print_size_bound(arg + i, opt) + break_bound + 1;
+                i += next_arg_offset(arg + i);
+            }
+            return bound;
+        }
+        case '-':
+        {
+            size_t elem_bound = arg->val.r.has_delta
+                ? scalar_bound : print_size_bound(arg + 1, opt);
+            size_t printed = opt->compress_ranges ? 3 : (arg->val.r.num + 1);
+            return 32 + printed * (elem_bound + break_bound + 1);
+        }
+        default:
+            return scalar_bound;
+    }
+}
+
+/**
+ * Print a value (but no array or blob) into the window, behind @p prefix
+ * @param last_sep Offset of the separator in @p prefix which is replaced by a
+ *   line break, -1 for the byte in front of the prefix
+ * @param check_linebreak Whether the value can break the line behind prefix
+ */
+static void stream_value(print_stream* st, const rtosc_arg_val_t* arg,
+                         const char* prefix, ptrdiff_t last_sep,
+                         int check_linebreak,
+                         const rtosc_print_options* opt, int* cols_used,
+                         int* args_written_this_line)
+{
+    size_t prefix_len = strlen(prefix);
+    size_t bs = print_size_bound(arg, opt) + 8;
+    char* window = stream_window(st, prefix, bs);
+    if(!window)
+    {
+        st->failed = 1;
+        return;
+    }
+    char* buffer = window + prefix_len;
+    size_t tmp = rtosc_print_arg_val(arg, buffer, bs, opt, cols_used);
+    size_t wrt = prefix_len + tmp;
+    buffer += tmp;
+    bs -= tmp;
+    if(check_linebreak)
+    {
+        linebreak_check_after_write(cols_used, &wrt,
+                                    window + last_sep, &buffer, &bs,
+                                    tmp, args_written_this_line,
+                                    opt->linelength);
+    }
+    stream_write_window(st, window, wrt);
+}
+
+static void stream_blob(print_stream* st, const rtosc_arg_val_t* arg,
+                        const char* prefix, const rtosc_print_options* opt,
+                        int* cols_used)
+{
+    // like rtosc_print_arg_val(), where each separator is the space of the
+    // previous byte
+    char tmp[32];
+    stream_write(st, prefix, strlen(prefix));
+    int wrt = asnprintf(tmp, sizeof(tmp), "BLOB [%d", arg->val.b.len);
+    stream_write(st, tmp, wrt);
+    *cols_used += wrt + 1;
+    for(int32_t i = 0; i < arg->val.b.len; ++i)
+    {
+        if(*cols_used >= opt->linelength - 6)
+        {
+            stream_write(st, "\n    ", 5);
+            *cols_used = 4;
+        }
+        else
+            stream_write(st, " ", 1);
+        asnprintf(tmp, sizeof(tmp), "0x%02x", arg->val.b.data[i]);
+        stream_write(st, tmp, 4);
+        *cols_used += 5;
+    }
+    stream_write(st, "]", 1);
+}
+
+static void stream_array(print_stream* st, const rtosc_arg_val_t* arg,
+                         const char* prefix, const rtosc_print_options* opt,
+                         int* cols_used)
+{
+    // like rtosc_print_arg_val(), where the separator in front of the array
+    // and the opening bracket are the prefix of the first element
+    int32_t len = arg->val.a.len;
+    int args_written_this_line = (*cols_used) ? 1 : 0;
+    STACKALLOC(rtosc_arg_val_t, args_converted, len ? len : 1);
+
+    size_t prefix_len = strlen(prefix);
+    char* first_prefix = malloc(prefix_len + 2);
+    if(!first_prefix)
+    {
+        st->failed = 1;
+        return;
+    }
+    memcpy(first_prefix, prefix, prefix_len);
+    first_prefix[prefix_len] = '[';
+    first_prefix[prefix_len + 1] = 0;
+    ++*cols_used;
+
+    if(!len)
+    {
+        stream_write(st, first_prefix, prefix_len + 1);
+        stream_write(st, "]", 1);
+        *cols_used += 2;
+    }
+    for(int32_t i = 1; i <= len && !st->failed; )
+    {
+        int32_t conv = rtosc_convert_to_range(arg+i, len+1-i,
+                                              args_converted, opt);
+        const rtosc_arg_val_t* input = conv ? args_converted : arg+i;
+
+        if(i == 1)
+            stream_value(st, input, first_prefix, (ptrdiff_t)prefix_len - 1,
+                         1, opt, cols_used, &args_written_this_line);
+        else
+            stream_value(st, input, " ", 0, 1, opt, cols_used,
+                         &args_written_this_line);
+        i += conv ? conv : next_arg_offset(arg+i);
+        ++*cols_used; // the separator
+    }
+    if(len)
+    {
+        // the last separator is replaced by the closing bracket
+        stream_write(st, "]", 1);
+        ++*cols_used;
+    }
+    free(first_prefix);
+}
+
+static void stream_arg_vals(print_stream* st, const rtosc_arg_val_t *args,
+                            size_t n, const char* prefix,
+                            const rtosc_print_options *opt, int cols_used)
+{
+    int args_written_this_line = (cols_used) ? 1 : 0;
+    size_t sep_len = strlen(opt->sep);
+    STACKALLOC(rtosc_arg_val_t, args_converted, n ? n : 1);
+
+    for(size_t i = 0; i < n && !st->failed;)
+    {
+        int32_t conv = rtosc_convert_to_range(args, n-i, args_converted, opt);
+        const rtosc_arg_val_t* input = conv ? args_converted : args;
+
+        if(input->type == 'a')
+            stream_array(st, input, prefix, opt, &cols_used);
+        else if(input->type == 'b')
+            stream_blob(st, input, prefix, opt, &cols_used);
+        else
+            // these compute the newlines themselves
+            stream_value(st, input, prefix, *prefix ? 0 : -1,
+                         !strchr("-asb", args->type), opt, &cols_used,
+                         &args_written_this_line);
+
+        size_t inc = conv ? conv : next_arg_offset(args);
+        i += inc;
+        args += inc;
+        prefix = opt->sep;
+        cols_used += sep_len;
+    }
+}
+
+size_t rtosc_print_arg_vals_to_sink(const rtosc_arg_val_t *args, size_t n,
+                                    rtosc_print_sink sink, void* data,
+                                    const rtosc_print_options* opt,
+                                    int cols_used)
+{
+    if(!opt)
+        opt = default_print_options;
+    print_stream* st = calloc(1, sizeof(print_stream));
+    if(!st)
+        return 0;
+    st->sink = sink;
+    st->data = data;
+    stream_arg_vals(st, args, n, "", opt, cols_used);
+    stream_flush(st);
+    size_t written = st->written;
+    free(st->window);
+    free(st);
+    return written;
+}
+
+size_t rtosc_print_message_to_sink(const char* address,
+                                   const rtosc_arg_val_t *args, size_t n,
+                                   rtosc_print_sink sink, void* data,
+                                   const rtosc_print_options* opt,
+                                   int cols_used)
+{
+    if(!opt)
+        opt = default_print_options;
+    print_stream* st = calloc(1, sizeof(print_stream));
+    if(!st)
+        return 0;
+    st->sink = sink;
+    st->data = data;
+    size_t len = strlen(address);
+    stream_write(st, address, len);
+    // the space behind the address is the first value's separator
+    stream_arg_vals(st, args, n, " ", opt, cols_used + len + 1);
+    if(!n)
+        stream_write(st, " ", 1);
+    stream_flush(st);
+    size_t written = st->written;
+    free(st->window);
+    free(st);
+    return written;
+}
+
 /**
  * Increase @p s while property @property is true and the end has not yet
  * been reached
@@ -691,6 +1127,45 @@ static void skip_while(const char** s, int (*property)(int))
     for(;**s && (*property)(**s);++*s);
 }
 
+//! Number of bytes that scan_window() copies
+#define SCAN_WINDOW_SIZE 64
+
+/**
+ * sscanf() that only reads the next bytes of @p src, if possible
+ *
+ * sscanf() computes the length of its input first, which made scanning each
+ * value of a long text quadratic in the text's length. The formats in this
+ * file match few tokens, so they are applied to a copy of the next bytes.
+ * If the match failed, or ended close to the copy's end, it may depend on
+ * the following bytes, and sscanf() is applied to @p src.
+ * @param rd The variable for the last conversion, which must be "%n". It is
+ *   0 if the format did not match
+ */
+static int scan_window(const char* src, int* rd, const char* fmt, ...)
+{
+    char window[SCAN_WINDOW_SIZE + 1];
+    size_t len = 0;
+    for(; len < SCAN_WINDOW_SIZE && (window[len] = src[len]); ++len) ;
+    window[len] = 0;
+    const bool truncated = src[len];
+
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    *rd = -1;
+    int res = vsscanf(window, fmt, ap2);
+    va_end(ap2);
+    if(truncated && (*rd < 0 || *rd + 1 >= SCAN_WINDOW_SIZE))
+    {
+        *rd = -1;
+        res = vsscanf(src, fmt, ap);
+    }
+    va_end(ap);
+    if(*rd < 0)
+        *rd = 0;
+    return res;
+}
+
 /**
  * Parse the string pointed to by @p src conforming to the format string @p
  * @param src Pointer to the input string
@@ -701,8 +1176,8 @@ static void skip_while(const char** s, int (*property)(int))
 static int skip_fmt(const char** src, const char* fmt)
 {
     assert(!strncmp(fmt + strlen(fmt) - 2, "%n", 2));
-    int rd = 0;
-    sscanf(*src, fmt, &rd);
+    int rd;
+    scan_window(*src, &rd, fmt, &rd);
     *src += rd;
     return rd;
 }
@@ -723,8 +1198,20 @@ static int skip_fmt_null(const char** src, const char* fmt)
 static const char* try_fmt(const char* src, int exp, const char* fmt,
                            char* typesrc, char type)
 {
+    // the numeric ends at src[exp], so the format can not match more bytes,
+    // and a copy, which needs no strlen() of the rest, behaves the same
+    char token[SCAN_WINDOW_SIZE + 1];
     int rd = 0;
-    sscanf(src, fmt, &rd);
+    if(exp + 2 <= SCAN_WINDOW_SIZE)
+    {
+        int len = 0;
+        for(; len < exp + 2 && src[len]; ++len) ;
+        memcpy(token, src, len);
+        token[len] = 0;
+        sscanf(token, fmt, &rd);
+    }
+    else
+        sscanf(src, fmt, &rd);
     if(rd == exp)
     {
         *typesrc = type;
@@ -787,9 +1274,24 @@ static const char* scanf_fmtstr_scan(const char* src, char* bytes16, char* type)
 /** Skip the next numeric at @p src */
 static size_t skip_numeric(const char** src, char* type)
 {
-    const char* scan_str = scanf_fmtstr(*src, type);
+    char tmp;
+    char* _type = type ? type : &tmp;
+    const char* start = *src;
+    const char* scan_str = scanf_fmtstr(*src, _type);
     if(!scan_str) return 0;
-    else return skip_fmt(src, scan_str);
+    size_t rd = skip_fmt(src, scan_str);
+    if(rd && (*_type == 'f' || *_type == 'd'))
+    {
+        // scanf() skips incomplete exponents, like in "1e", but strtod()
+        // stops before them, and so does rtosc_scan_arg_val()
+        char* end;
+        strtod(start, &end);
+        if(*end == *_type)
+            ++end;
+        if(end != *src)
+            return 0;
+    }
+    return rd;
 }
 
 /**
@@ -840,8 +1342,9 @@ static const char* end_of_printed_string(const char* src)
             escaped = (*src == '\\') ? (!escaped) : false;
         }
         if(*src == '"' && src[1] == '\\') {
+            // NULL if the backslash is not followed by another string
             skip_fmt_null(&src, "\"\\ \"%n");
-            cont = true;
+            cont = (src != NULL);
         }
         else
             cont = false;
@@ -973,6 +1476,9 @@ int arraytypes_match(char type1, char type2)
            types_match(type1, type2);
 }
 
+//! arrays nested deeper are rejected, which bounds the recursion
+static const int max_array_depth = 32;
+
 const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                                         char* type, const char* llhssrc,
                                         int follow_ellipsis, int inside_bundle)
@@ -1040,7 +1546,7 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
         case '\'':
         {
             int esc = -1;
-            if(strlen(src) < 3)
+            if(!src[1] || !src[2])
                 return NULL;
             // type 1: '<noslash>' => normal char
             // type 2: '\<noquote>' => escaped char
@@ -1087,6 +1593,12 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
             break;
         case '[':
         {
+            // inside_bundle is the nesting depth of arrays
+            if(inside_bundle >= max_array_depth)
+            {
+                src = NULL;
+                break;
+            }
             while(isspace(*++src));
             char arraytype = 0;
             const char* recent_src = NULL;
@@ -1097,7 +1609,8 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                 const char* newsrc = rtosc_skip_next_printed_arg(src, &skipped2,
                                                                  &arraytype_cur,
                                                                  recent_src, 1,
-                                                                 true);
+                                                                 inside_bundle
+                                                                 + 1);
                 recent_src = src;
                 src = newsrc;
 
@@ -1127,7 +1640,7 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
             {
                 *type = 'b';
                 int rd = 0, blobsize = 0;
-                sscanf(src, "%i %n", &blobsize, &rd);
+                scan_window(src, &rd, "%i %n", &blobsize, &rd);
                 src = rd ? (src + rd) : NULL;
                 for(;src && *src == '0';) // i.e. 0x...
                 {
@@ -1155,13 +1668,25 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                 ++src;
 
                 int skipped2;
-                src = rtosc_skip_next_printed_arg(src, &skipped2,
+                // ranges of ranges, like "3x3x1", are not allowed
+                src = is_range_multiplier(src)
+                    ? NULL
+                    : rtosc_skip_next_printed_arg(src, &skipped2,
                                                   &deltaless_range_type,
                                                   NULL, 0, inside_bundle);
                 if(src) {
                     *type = '-';
                     *skipped += skipped2;
                 }
+                // ranges starting with a multiplied value, like "3x-6 ... -3",
+                // are not implemented in rtosc_scan_arg_val()
+                const char* after_range = src;
+                if(follow_ellipsis && after_range)
+                {
+                    skip_while(&after_range, isspace);
+                    if(!strncmp(after_range, "...", 3))
+                        src = NULL;
+                }
             }
             // is it an identifier?
             else if(*src == '_' || isalpha(*src))
@@ -1170,11 +1695,14 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                 *type = 'S';
             }
             // is it a date? (vs a numeric)
-            else if(skip_fmt(&src, "%*4d-%*1d%*1d-%*1d%*1d%n"))
+            // "%*4d" would also match fewer digits, which are no year
+            else if(isdigit(src[0]) && isdigit(src[1]) && isdigit(src[2])
+                    && isdigit(src[3]) && src[4] == '-'
+                    && skip_fmt(&src, "%*4d-%*1d%*1d-%*1d%*1d%n"))
             {
                 if(skip_fmt(&src, " %*2d:%*1d%*1d%n"))
                 if(skip_fmt(&src, ":%*1d%*1d%n"))
-                if(skip_fmt(&src, ".%*d%n"))
+                if(*src == '.' && isdigit(src[1]) && skip_fmt(&src, ".%*d%n"))
                 {
                     if(skip_fmt(&src, " ( ... + 0x%n"))
                     {
@@ -1182,7 +1710,8 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                         if(skip_fmt(&src, "%*xp%n"))
                         {
                             int rd = 0, expm;
-                            sscanf(src, "-%d s )%n", &expm, &rd);
+                            scan_window(src, &rd, "-%d s )%n", &expm,
+                                        &rd);
                             if(rd && expm > 0 && expm <= 32)
                             {
                                 // ok
@@ -1274,7 +1803,9 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                 const char* endsrc;
                 if(*rhssrc == ']')
                 {
-                    assert(inside_bundle);
+                    // infinite ranges are only allowed in arrays
+                    if(!inside_bundle)
+                        break;
                     // we're still not finished. find out if delta-less or not
                     *rhstype = lhstype;
                     endsrc = rhssrc;
@@ -1289,7 +1820,11 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                     endsrc = rtosc_skip_next_printed_arg(rhssrc, &rhsskipped,
                                                          rhstype, NULL, 0,
                                                          inside_bundle);
-                    if(!endsrc)
+                    // ranges ending in a multiplied value, like
+                    // "'a' ... 3x'f'", are not implemented, and non-numeric
+                    // values can not be scanned without string buffer
+                    if(!endsrc || rhsskipped != 1 ||
+                       !strchr(numeric_range_types(), *rhstype))
                         break;
 
                     rtosc_scan_arg_val(rhssrc, &rhsarg, 1, NULL, &zero, 0, 0);
@@ -1329,7 +1864,8 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                     rtosc_skip_next_printed_arg(llhssrc,
                                                 &llhsskipped, &llhstype,
                                                 NULL, 0, inside_bundle);
-                    if(types_match(llhstype, lhstype))
+                    // arrays would not fit into llhsarg, and have no delta
+                    if(llhsskipped == 1 && types_match(llhstype, lhstype))
                     {
                         rtosc_scan_arg_val(llhssrc, &llhsarg, 1,
                                            NULL, &zero, 0, 0);
@@ -1362,16 +1898,15 @@ const char* rtosc_skip_next_printed_arg(const char* src, int* skipped,
                                                       &delta,
                                                       llhsarg_is_useless);
 
-                    if(num == -1)
+                    if(num == -1 && infinite_range)
                     {
-                        if(infinite_range)
-                        {
-                            has_delta = false;
-                        }
-                        else
-                        {
-                            break;
-                        }
+                        has_delta = false;
+                    }
+                    else if(num <= 0 && !infinite_range)
+                    {
+                        // no delta fits, or rhs lies in the wrong direction,
+                        // e.g. "0 32 ... 96 2 ... 96"
+                        break;
                     }
                 }
 
@@ -1570,9 +2105,9 @@ size_t rtosc_scan_arg_val(const char* src,
             {
                 arg->type = 'm';
                 int32_t tmp[4];
-                sscanf(src, "MIDI [ 0x%"PRIx32" 0x%"PRIx32
-                                  " 0x%"PRIx32" 0x%"PRIx32" ]%n",
-                       tmp, tmp + 1, tmp + 2, tmp + 3, &rd); src+=rd;
+                scan_window(src, &rd, "MIDI [ 0x%"PRIx32" 0x%"PRIx32
+                                      " 0x%"PRIx32" 0x%"PRIx32" ]%n",
+                            tmp, tmp + 1, tmp + 2, tmp + 3, &rd); src+=rd;
                 for(size_t i = 0; i < 4; ++i)
                     arg->val.m[i] = tmp[i]; // copy to 8 bit array
             }
@@ -1595,7 +2130,8 @@ size_t rtosc_scan_arg_val(const char* src,
                 last_bufsize = *bufsize;
 
                 src += rtosc_scan_arg_val(src, arg, nargs,
-                                          buffer_for_strings, bufsize, i, 1);
+                                          buffer_for_strings, bufsize,
+                                          num_read, 1);
                 arrtype = arg->type;
                 if(arrtype == '-')
                     arrtype = arg->val.r.has_delta ? arg[2].type : arg[1].type;
@@ -1622,7 +2158,8 @@ size_t rtosc_scan_arg_val(const char* src,
         case 'B': // blob
         {
             arg->type = 'b';
-            sscanf(src, "BLOB [ %"PRIi32" %n", &arg->val.b.len, &rd);
+            scan_window(src, &rd, "BLOB [ %"PRIi32" %n", &arg->val.b.len,
+                        &rd);
             if(rd)
             {
                 src +=rd;
@@ -1634,7 +2171,7 @@ size_t rtosc_scan_arg_val(const char* src,
                 {
                     int32_t tmp;
                     int rd;
-                    sscanf(src, "0x%x %n", &tmp, &rd);
+                    scan_window(src, &rd, "0x%x %n", &tmp, &rd);
                     arg->val.b.data[i] = tmp;
                     src+=rd;
                 }
@@ -1651,7 +2188,7 @@ size_t rtosc_scan_arg_val(const char* src,
             {
                 // collect information for range_arg
                 int multiplier, rd = 0;
-                sscanf(src, "%dx%n", &multiplier, &rd);
+                scan_window(src, &rd, "%dx%n", &multiplier, &rd);
                 src += rd;
                 arg->type = '-';
                 arg->val.r.num = multiplier;
@@ -1686,8 +2223,9 @@ size_t rtosc_scan_arg_val(const char* src,
                 *buffer_for_strings = 0;
                 ++buffer_for_strings;
             }
-            // "YYYY-" => it's a date
-            else if(src[0] && src[1] && src[2] && src[3] && src[4] == '-')
+            // "YYYY-" => it's a date (vs a float like "1.0e-06")
+            else if(isdigit(src[0]) && isdigit(src[1]) && isdigit(src[2])
+                    && isdigit(src[3]) && src[4] == '-')
             {
                 arg->val.t = 0;
 
@@ -1695,44 +2233,52 @@ size_t rtosc_scan_arg_val(const char* src,
                 m_tm.tm_hour = 0;
                 m_tm.tm_min = 0;
                 m_tm.tm_sec = 0;
-                sscanf(src, "%4d-%2d-%2d%n",
-                       &m_tm.tm_year, &m_tm.tm_mon, &m_tm.tm_mday, &rd);
+                scan_window(src, &rd, "%4d-%2d-%2d%n",
+                            &m_tm.tm_year, &m_tm.tm_mon, &m_tm.tm_mday, &rd);
                 src+=rd;
-                float secfracsf;
-
-                rd = 0;
-                sscanf(src, " %2d:%2d%n", &m_tm.tm_hour, &m_tm.tm_min, &rd);
-                if(rd)
-                 src+=rd;
 
+                // minutes and seconds have two digits, and fractions are
+                // only allowed after seconds, like for
+                // rtosc_skip_next_printed_arg()
+                bool has_secs = false;
                 rd = 0;
-                sscanf(src, ":%2d%n", &m_tm.tm_sec, &rd);
-                if(rd)
-                 src+=rd;
-
-                uint64_t secfracs;
-
-                // lossless format is appended in parantheses?
-                //  => take it directly from there
-                if(skip_fmt(&src, "%*f (%n"))
+                scan_window(src, &rd, " %2d:%n", &m_tm.tm_hour, &rd);
+                if(rd && isdigit(src[rd]) && isdigit(src[rd+1]))
                 {
-                    sscanf(src, " ... + 0x%8"PRIx64"p-32 s )%n",
-                           &secfracs, &rd);
                     src += rd;
+                    m_tm.tm_min = (src[0] - '0') * 10 + (src[1] - '0');
+                    src += 2;
+                    if(src[0] == ':' && isdigit(src[1]) && isdigit(src[2]))
+                    {
+                        m_tm.tm_sec = (src[1] - '0') * 10 + (src[2] - '0');
+                        src += 3;
+                        has_secs = true;
+                    }
                 }
-                // float number, but not lossless?
-                //  => convert it to fractions of seconds
-                else if(*src == '.')
-                {
-                    sscanf(src, "%f%n", &secfracsf, &rd);
-                    src += rd;
 
-                    secfracs = rtosc_float2secfracs(secfracsf);
-                }
-                else
+                uint64_t secfracs = 0;
+                if(has_secs && *src == '.' && isdigit(src[1]))
                 {
-                    // no fractional / floating seconds part
-                    secfracs = 0;
+                    // more digits than a float can hold are ignored
+                    char frac[16] = "0";
+                    size_t len = 1 + strspn(src + 1, "0123456789");
+                    memcpy(frac + 1, src, len < 14 ? len : 14);
+                    frac[1 + (len < 14 ? len : 14)] = 0;
+                    src += len;
+
+                    // lossless format is appended in parantheses?
+                    //  => take it directly from there
+                    if(skip_fmt(&src, " ( ... + 0x%n"))
+                    {
+                        char* end;
+                        // the hex float has at most 32 significant bits
+                        double lossless = strtod(src - 2, &end);
+                        src = end;
+                        skip_fmt(&src, " s )%n");
+                        secfracs = (uint64_t)(lossless * 4294967296.0);
+                    }
+                    else
+                        secfracs = rtosc_float2secfracs(strtof(frac, NULL));
                 }
 
                 rtosc_arg_val_from_params(arg, &m_tm, secfracs);
@@ -1755,13 +2301,28 @@ size_t rtosc_scan_arg_val(const char* src,
                     switch(type)
                     {
                         case 'h':
-                            sscanf(src, fmtstr, &arg->val.h, &rd); break;
+                            scan_window(src, &rd, fmtstr, &arg->val.h, &rd);
+                            break;
                         case 'i':
-                            sscanf(src, fmtstr, &arg->val.i, &rd); break;
+                            scan_window(src, &rd, fmtstr, &arg->val.i, &rd);
+                            break;
                         case 'f':
-                            sscanf(src, fmtstr, &arg->val.f, &rd); break;
                         case 'd':
-                            sscanf(src, fmtstr, &arg->val.d, &rd); break;
+                        {
+                            // The lossless part has no 'd' suffix, so it is
+                            // detected as float. Read it as the number's
+                            // type, which the first part determined.
+                            char *end;
+                            if(arg->type == 'd')
+                                arg->val.d = strtod(src, &end);
+                            else
+                                arg->val.f = strtof(src, &end);
+                            // skip the suffix from "%lfd" and "%ff"
+                            if(*end == type)
+                                ++end;
+                            rd = end - src;
+                            break;
+                        }
                     }
                     src += rd;
 
@@ -1829,8 +2390,14 @@ size_t rtosc_scan_arg_val(const char* src,
                       ? arg-1
                       : arg-1; // normal case
 
+        // the values of arrays are no llhs, like in "[0 1] 2 ... 5"
+        const rtosc_arg_val_t* prev = arg - args_before;
+        for(const rtosc_arg_val_t* cur = prev; cur < arg;
+            cur += next_arg_offset(cur))
+            prev = cur;
+
         bool llhsarg_is_useless =
-            (args_before < 1 ||
+            (args_before < 1 || prev->type == 'a' ||
             lhsarg.type == '-' || !types_match(llhsarg->type, lhsarg.type)
             /* this includes llhsarg == '-' */ );
 
@@ -1866,6 +2433,14 @@ size_t rtosc_scan_arg_vals(const char* src,
 {
     size_t last_bufsize;
     size_t rd=0;
+    // comments in front of the first value, like the counting functions and
+    // rtosc_scan_arg_vals_arena() skip them
+    while(n && (isspace(*src) || *src == '%'))
+    {
+        rd += skip_fmt(&src, " %n");
+        while(*src == '%')
+            rd += skip_fmt(&src, "%*[^\n]%n");
+    }
     for(size_t i = 0; i < n; )
     {
         last_bufsize = bufsize;
@@ -1902,10 +2477,12 @@ size_t rtosc_scan_message(const char* src,
         rd += skip_fmt(&src, "%*[^\n] %n");
 
     assert(*src == '/');
-    for(; *src && !isspace(*src) && rd < adrsize; ++rd)
+    size_t len = 0;
+    for(; *src && !isspace(*src) && len < adrsize; ++len)
         *address++ = *src++;
-    assert(rd < adrsize); // otherwise, the address was too long
+    assert(len < adrsize); // otherwise, the address was too long
     *address = 0;
+    rd += len;
 
     for(;*src && isspace(*src); ++src) ++rd;
 
@@ -1914,3 +2491,376 @@ size_t rtosc_scan_message(const char* src,
     return rd;
 }
 
+
+/*
+ * The strings and blobs of an arena are stored in chunks, which are never
+ * moved. Each chunk starts with a pointer to the previous chunk, strbuf
+ * points behind the pointer of the newest chunk.
+ */
+static char* arena_prev_chunk(const char* strbuf)
+{
+    char* prev;
+    memcpy(&prev, strbuf - sizeof(char*), sizeof(char*));
+    return prev;
+}
+
+static void arena_free_chunks(char* strbuf)
+{
+    while(strbuf)
+    {
+        char* prev = arena_prev_chunk(strbuf);
+        free(strbuf - sizeof(char*));
+        strbuf = prev;
+    }
+}
+
+//! Table of all strings and blobs kept by an interning arena
+struct rtosc_arg_val_interned
+{
+    struct intern_entry
+    {
+        const char* data;
+        size_t len;
+        uint64_t hash;
+    } *entries;
+    size_t capacity; //!< 0 or 2^n
+    size_t used;
+};
+
+static uint64_t intern_hash(const char* data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < len; ++i)
+        h = (h ^ (uint8_t)data[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static bool intern_grow(struct rtosc_arg_val_interned* t)
+{
+    size_t capacity = t->capacity ? t->capacity * 2 : 64;
+    struct intern_entry* entries = calloc(capacity, sizeof(struct intern_entry));
+    if(!entries)
+        return false;
+    for(size_t i = 0; i < t->capacity; ++i)
+    {
+        if(!t->entries[i].data)
+            continue;
+        size_t slot = t->entries[i].hash & (capacity - 1);
+        while(entries[slot].data)
+            slot = (slot + 1) & (capacity - 1);
+        entries[slot] = t->entries[i];
+    }
+    free(t->entries);
+    t->entries = entries;
+    t->capacity = capacity;
+    return true;
+}
+
+/**
+ * Find the kept copy of @p len bytes at @p data, or keep @p data
+ * @return The kept copy, or NULL if @p data is kept now (or on errors)
+ */
+static const char* intern(struct rtosc_arg_val_interned* t,
+                          const char* data, size_t len)
+{
+    if(2 * (t->used + 1) > t->capacity && !intern_grow(t))
+        return NULL;
+    const uint64_t hash = intern_hash(data, len);
+    size_t slot = hash & (t->capacity - 1);
+    for(; t->entries[slot].data; slot = (slot + 1) & (t->capacity - 1))
+    {
+        const struct intern_entry* e = t->entries + slot;
+        if(e->hash == hash && e->len == len && !memcmp(e->data, data, len))
+            return e->data;
+    }
+    t->entries[slot].data = data;
+    t->entries[slot].len = len;
+    t->entries[slot].hash = hash;
+    ++t->used;
+    return NULL;
+}
+
+//! The string or blob data of @p arg, or NULL if it has none
+static const char* arg_data(const rtosc_arg_val_t* arg, size_t* len)
+{
+    if((arg->type == 's' || arg->type == 'S') && arg->val.s)
+    {
+        *len = strlen(arg->val.s) + 1;
+        return arg->val.s;
+    }
+    else if(arg->type == 'b' && arg->val.b.len)
+    {
+        *len = arg->val.b.len;
+        return (const char*)arg->val.b.data;
+    }
+    return NULL;
+}
+
+static void set_arg_data(rtosc_arg_val_t* arg, const char* data)
+{
+    if(arg->type == 'b')
+        arg->val.b.data = (uint8_t*)data;
+    else
+        arg->val.s = data;
+}
+
+void rtosc_arg_val_arena_init(rtosc_arg_val_arena* arena)
+{
+    memset(arena, 0, sizeof(rtosc_arg_val_arena));
+}
+
+void rtosc_arg_val_arena_destroy(rtosc_arg_val_arena* arena)
+{
+    free(arena->args);
+    arena_free_chunks(arena->strbuf);
+    if(arena->interned)
+    {
+        free(arena->interned->entries);
+        free(arena->interned);
+    }
+    rtosc_arg_val_arena_init(arena);
+}
+
+void rtosc_arg_val_arena_clear(rtosc_arg_val_arena* arena)
+{
+    arena->nargs = 0;
+    arena->strbuf_used = 0;
+    if(arena->strbuf)
+    {
+        // keep the newest chunk, which is the largest one
+        arena_free_chunks(arena_prev_chunk(arena->strbuf));
+        const char* none = NULL;
+        memcpy(arena->strbuf - sizeof none, &none, sizeof none);
+    }
+    if(arena->interned)
+    {
+        struct rtosc_arg_val_interned* t = arena->interned;
+        if(t->entries)
+            memset(t->entries, 0, t->capacity * sizeof(struct intern_entry));
+        t->used = 0;
+    }
+}
+
+bool rtosc_arg_val_arena_intern(rtosc_arg_val_arena* arena, bool intern)
+{
+    if(intern && !arena->interned)
+    {
+        arena->interned = calloc(1, sizeof(struct rtosc_arg_val_interned));
+        if(!arena->interned)
+            return false;
+        // strings which are already in the arena are not found
+    }
+    else if(!intern && arena->interned)
+    {
+        free(arena->interned->entries);
+        free(arena->interned);
+        arena->interned = NULL;
+    }
+    return true;
+}
+
+bool rtosc_arg_val_arena_reserve(rtosc_arg_val_arena* arena, size_t nargs)
+{
+    if(arena->nargs + nargs <= arena->args_capacity)
+        return true;
+    size_t capacity = arena->args_capacity ? arena->args_capacity * 2 : 16;
+    while(capacity < arena->nargs + nargs)
+        capacity *= 2;
+    rtosc_arg_val_t* args = realloc(arena->args,
+                                    capacity * sizeof(rtosc_arg_val_t));
+    if(!args)
+        return false;
+    arena->args = args;
+    arena->args_capacity = capacity;
+    return true;
+}
+
+//! Make sure that @p bytes more bytes fit into the newest chunk
+static bool arena_reserve_strings(rtosc_arg_val_arena* arena, size_t bytes)
+{
+    if(arena->strbuf_used + bytes <= arena->strbuf_capacity)
+        return true;
+    size_t capacity = arena->strbuf_capacity ? arena->strbuf_capacity * 2
+                                             : 256;
+    while(capacity < bytes)
+        capacity *= 2;
+    char* chunk = malloc(sizeof(char*) + capacity);
+    if(!chunk)
+        return false;
+    // older chunks are kept, so strings and blobs never move
+    memcpy(chunk, &arena->strbuf, sizeof(char*));
+    arena->strbuf = chunk + sizeof(char*);
+    arena->strbuf_used = 0;
+    arena->strbuf_capacity = capacity;
+    return true;
+}
+
+/**
+ * Intern the strings and blobs of the @p n newest values, which have been
+ * scanned to the newest chunk, from offset @p first on
+ *
+ * Data which is kept already is dropped, all other data is moved together.
+ * This relies on the scanner writing the data in the order of the values.
+ */
+static void arena_intern_scanned(rtosc_arg_val_arena* arena, size_t n,
+                                 size_t first)
+{
+    rtosc_arg_val_t* args = arena->args + arena->nargs;
+    const char* begin = arena->strbuf + first;
+    const char* end = arena->strbuf + arena->strbuf_used;
+
+    const char* pos = begin;
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t len;
+        const char* data = arg_data(args + i, &len);
+        if(!data || data < begin || data >= end)
+            continue;
+        if(data < pos) // not in order, keep everything as it is
+            return;
+        pos = data + len;
+    }
+
+    char* dest = arena->strbuf + first;
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t len;
+        const char* data = arg_data(args + i, &len);
+        if(!data || data < begin || data >= end)
+            continue;
+        memmove(dest, data, len);
+        const char* kept = intern(arena->interned, dest, len);
+        set_arg_data(args + i, kept ? kept : dest);
+        if(!kept)
+            dest += len;
+    }
+    arena->strbuf_used = dest - arena->strbuf;
+}
+
+bool rtosc_arg_val_arena_append(rtosc_arg_val_arena* arena,
+                                const rtosc_arg_val_t* args, size_t n)
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t len;
+        if(arg_data(args + i, &len))
+            bytes += len;
+    }
+    if(!rtosc_arg_val_arena_reserve(arena, n) ||
+       !arena_reserve_strings(arena, bytes))
+        return false;
+
+    rtosc_arg_val_t* dest = arena->args + arena->nargs;
+    memcpy(dest, args, n * sizeof(rtosc_arg_val_t));
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t len;
+        const char* data = arg_data(dest + i, &len);
+        if(!data)
+            continue;
+        char* strbuf = arena->strbuf + arena->strbuf_used;
+        memcpy(strbuf, data, len);
+        const char* kept = arena->interned
+                         ? intern(arena->interned, strbuf, len) : NULL;
+        set_arg_data(dest + i, kept ? kept : strbuf);
+        if(!kept)
+            arena->strbuf_used += len;
+    }
+    arena->nargs += n;
+    return true;
+}
+
+int rtosc_scan_arg_vals_arena(const char* src, rtosc_arg_val_arena* arena,
+                              size_t* rd)
+{
+    const char* start = src;
+    int num = 0;
+
+    skip_while(&src, isspace);
+    while (*src == '%')
+        skip_fmt(&src, "%*[^\n] %n");
+
+    const char* recent_src = NULL;
+    size_t args_before = 0;
+    while(*src && *src != '/')
+    {
+        // check the next value, and find out how much space it needs
+        int skipped;
+        const char* end = rtosc_skip_next_printed_arg(src, &skipped, NULL,
+                                                      recent_src, 1, 0);
+        num += skipped;
+        if(!end)
+        {
+            num = -num;
+            break;
+        }
+        // strings never need more bytes than their printed text, plus one
+        // terminating zero for each value
+        if(!rtosc_arg_val_arena_reserve(arena, skipped) ||
+           !arena_reserve_strings(arena, (end - src) + skipped + 1))
+        {
+            num = -num;
+            break;
+        }
+
+        rtosc_arg_val_t* args = arena->args + arena->nargs;
+        char* strbuf = arena->strbuf + arena->strbuf_used;
+        size_t bufsize = arena->strbuf_capacity - arena->strbuf_used;
+        const size_t last_bufsize = bufsize;
+        recent_src = src;
+        src += rtosc_scan_arg_val(src, args, skipped, strbuf, &bufsize,
+                                  args_before, 1);
+        const size_t length = next_arg_offset(args);
+        assert(length == (size_t)skipped);
+        const size_t first_byte = arena->strbuf_used;
+        arena->strbuf_used += last_bufsize - bufsize;
+        if(arena->interned)
+            arena_intern_scanned(arena, length, first_byte);
+        arena->nargs += length;
+        args_before += length;
+
+        do
+        {
+            skip_fmt(&src, " %n");
+            while(*src == '%')
+                skip_fmt(&src, "%*[^\n]%n");
+        } while(isspace(*src));
+    }
+
+    if(rd)
+        *rd = src - start;
+    return num;
+}
+
+int rtosc_scan_message_arena(const char* src,
+                             char* address, size_t adrsize,
+                             rtosc_arg_val_arena* arena, size_t* rd)
+{
+    const char* start = src;
+    skip_while(&src, isspace);
+    while (*src == '%')
+        skip_fmt(&src, "%*[^\n] %n");
+
+    if(rd)
+        *rd = src - start;
+    if(!*src)
+        return INT_MIN;
+    if(*src != '/')
+        return -1;
+
+    size_t len = 0;
+    for(; src[len] && !isspace(src[len]); ++len) ;
+    if(len >= adrsize)
+        return -1;
+    memcpy(address, src, len);
+    address[len] = 0;
+    src += len;
+
+    size_t args_rd;
+    int nargs = rtosc_scan_arg_vals_arena(src, arena, &args_rd);
+    src += args_rd;
+    if(rd)
+        *rd = src - start;
+    return nargs;
+}
@@ -1,3 +1,6 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
 #include <inttypes.h>
 #include <assert.h>
 #include <stdio.h>
@@ -36,27 +39,13 @@ rtosc_arg_val_t *rtosc_arg_val_from_params(rtosc_arg_val_t *dest,
 
 uint64_t rtosc_float2secfracs(float secfracsf)
 {
-    char secfracs_as_hex[16];
-    int written = snprintf(secfracs_as_hex, 16, "%a", secfracsf);
-    assert(written >= 0); // no error
-    assert(written < 16); // size suffices
-    (void) written;
-    assert(secfracs_as_hex[3]=='.'); // 0x?.
-    secfracs_as_hex[3] = secfracs_as_hex[2]; // remove '.'
-
-    uint64_t secfracs;
-    int exp;
-    sscanf(secfracs_as_hex + 3,
-           "%"PRIx64"p-%i", &secfracs, &exp);
-
-    const char* p = strchr(secfracs_as_hex, 'p');
-    assert(p);
-    int lshift = 32-exp-((int)(p-(secfracs_as_hex+4))<<2);
-    assert(lshift > 0);
-    secfracs <<= lshift;
-    assert((secfracs & 0xFFFFFFFF) == secfracs);
-
-    return secfracs;
+    // a float has 24 significant bits, so this is exact for fractions down
+    // to 2^-32, and also for fractions like 0.5 which have no hex digits
+    // after the point
+    assert(secfracsf >= 0.0f);
+    double secfracs = (double)secfracsf * 4294967296.0;
+    // fractions which rounded up to 1.0f
+    return secfracs < 4294967295.0 ? (uint64_t)secfracs : 0xFFFFFFFF;
 }
 
 
@@ -102,3 +91,108 @@ float rtosc_secfracs2float(uint64_t secfracs)
     assert(rd);
     return flt;
 }
+
+/*
+ * fast timetags
+ */
+
+uint64_t rtosc_ns2timetag(uint64_t ns)
+{
+    const uint64_t sec = ns / 1000000000u;
+    const uint64_t rem = ns - sec * 1000000000u;
+    // rem * 2^32 / 10^9, with 2^63 / 10^9 rounded up, exact to 0.07 units
+    return (sec << 32) + ((rem * UINT64_C(9223372037)) >> 31);
+}
+
+static void read_clock(int monotonic, uint64_t *sec, uint64_t *nsec)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    (void)monotonic;
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(monotonic ? CLOCK_MONOTONIC : CLOCK_REALTIME, &ts);
+#endif
+    *sec  = (uint64_t)ts.tv_sec;
+    *nsec = (uint64_t)ts.tv_nsec;
+}
+
+uint64_t rtosc_monotonic_ns(void)
+{
+    uint64_t sec, nsec;
+    read_clock(1, &sec, &nsec);
+    return sec * 1000000000u + nsec;
+}
+
+void rtosc_timetag_clock_calibrate(rtosc_timetag_clock_t *clock)
+{
+    // take the wall clock between two monotonic readings
+    uint64_t sec, nsec;
+    const uint64_t before = rtosc_monotonic_ns();
+    read_clock(0, &sec, &nsec);
+    const uint64_t after = rtosc_monotonic_ns();
+
+    clock->base_tt = (sec << 32) + rtosc_ns2timetag(nsec);
+    clock->base_ns = before + (after - before) / 2;
+}
+
+uint64_t rtosc_timetag_clock_at(const rtosc_timetag_clock_t *clock,
+                                uint64_t monotonic_ns)
+{
+    return monotonic_ns >= clock->base_ns
+        ? clock->base_tt + rtosc_ns2timetag(monotonic_ns - clock->base_ns)
+        : clock->base_tt - rtosc_ns2timetag(clock->base_ns - monotonic_ns);
+}
+
+uint64_t rtosc_timetag_clock_now(const rtosc_timetag_clock_t *clock)
+{
+    return rtosc_timetag_clock_at(clock, rtosc_monotonic_ns());
+}
+
+rtosc_arg_val_t *rtosc_arg_val_from_clock(rtosc_arg_val_t *dest,
+                                          const rtosc_timetag_clock_t *clock)
+{
+    dest->val.t = rtosc_timetag_clock_now(clock);
+    dest->type = 't';
+    return dest;
+}
+
+void rtosc_block_time_init(rtosc_block_time_t *block, uint64_t start,
+                           uint32_t nframes, double sample_rate)
+{
+    block->start       = start;
+    block->end         = start + (uint64_t)(nframes * 4294967296.0 /
+                                            sample_rate);
+    block->nframes     = nframes;
+    block->frames_mult = (uint64_t)(sample_rate * 256.0 + 0.5);
+    block->tt_mult     = (uint64_t)(281474976710656.0 / sample_rate + 0.5);
+}
+
+void rtosc_timetags2frames(const rtosc_block_time_t *block,
+                           const uint64_t *timetags, uint32_t *frames,
+                           size_t n)
+{
+    const uint64_t start = block->start, span = block->end - block->start;
+    const uint64_t mult = block->frames_mult;
+    const uint32_t nframes = block->nframes;
+    const uint32_t last = nframes ? nframes - 1 : 0;
+    // no branches, so compilers can vectorize the loop
+    for(size_t i = 0; i < n; ++i)
+    {
+        const uint64_t d = timetags[i] > start ? timetags[i] - start : 0;
+        const int in_block = d < span;
+        const uint64_t f = ((in_block ? d : 0) * mult +
+                            (UINT64_C(1) << 39)) >> 40;
+        const uint32_t frame = f < nframes ? (uint32_t)f : last;
+        frames[i] = in_block ? frame : nframes;
+    }
+}
+
+void rtosc_frames2timetags(const rtosc_block_time_t *block,
+                           const uint32_t *frames, uint64_t *timetags,
+                           size_t n)
+{
+    const uint64_t start = block->start, mult = block->tt_mult;
+    for(size_t i = 0; i < n; ++i)
+        timetags[i] = start + ((frames[i] * mult) >> 16);
+}
@@ -22,7 +22,7 @@ unsigned rtosc_narguments(const char *msg)
 {
     const char *args = rtosc_argument_string(msg);
     int nargs = 0;
-    while(*args++)
+    for(; *args; ++args)
         nargs += (*args == ']' || *args == '[') ? 0 : 1;
     return nargs;
 }
@@ -57,6 +57,80 @@ static int has_reserved(char type)
     return 0;
 }
 
+/*
+ * Byte order conversion. On little endian hosts, the loops below are
+ * vectorized into byte shuffles by the compiler.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define RTOSC_BE32(x) (x)
+#define RTOSC_BE64(x) (x)
+#elif defined(__GNUC__) || defined(__clang__)
+#define RTOSC_BE32(x) __builtin_bswap32(x)
+#define RTOSC_BE64(x) __builtin_bswap64(x)
+#else
+static uint32_t rtosc_bswap32(uint32_t x)
+{
+    return (x>>24) | ((x>>8) & 0xff00) | ((x<<8) & 0xff0000) | (x<<24);
+}
+static uint64_t rtosc_bswap64(uint64_t x)
+{
+    return ((uint64_t)rtosc_bswap32(x) << 32) | rtosc_bswap32(x>>32);
+}
+#define RTOSC_BE32(x) rtosc_bswap32(x)
+#define RTOSC_BE64(x) rtosc_bswap64(x)
+#endif
+
+void rtosc_pack32(uint8_t *dst, const void *src, size_t n)
+{
+    const uint8_t *s = (const uint8_t*)src;
+    for(size_t i=0; i<n; ++i) {
+        uint32_t v;
+        memcpy(&v, s + 4*i, 4);
+        v = RTOSC_BE32(v);
+        memcpy(dst + 4*i, &v, 4);
+    }
+}
+
+void rtosc_unpack32(void *dst, const uint8_t *src, size_t n)
+{
+    //the conversion is symmetric
+    rtosc_pack32((uint8_t*)dst, src, n);
+}
+
+void rtosc_pack64(uint8_t *dst, const void *src, size_t n)
+{
+    const uint8_t *s = (const uint8_t*)src;
+    for(size_t i=0; i<n; ++i) {
+        uint64_t v;
+        memcpy(&v, s + 8*i, 8);
+        v = RTOSC_BE64(v);
+        memcpy(dst + 8*i, &v, 8);
+    }
+}
+
+void rtosc_unpack64(void *dst, const uint8_t *src, size_t n)
+{
+    rtosc_pack64((uint8_t*)dst, src, n);
+}
+
+//size of the types which can be converted in runs, 0 for all others
+static unsigned run_size(char type)
+{
+    switch(type)
+    {
+        case 'i':
+        case 'f':
+        case 'c':
+        case 'r':
+            return 4;
+        case 'h':
+        case 't':
+        case 'd':
+            return 8;
+    }
+    return 0;
+}
+
 static unsigned nreserved(const char *args)
 {
     unsigned res = 0;
@@ -402,13 +476,38 @@ size_t rtosc_avmessage(char                  *buffer,
     STACKALLOC(char, argstr,val_max+1);
 
     int i;
-    for(i = 0; i < val_max; ++i)
+    for(i = 0; i < val_max; )
     {
-        rtosc_arg_val_t av_buffer;
-        const rtosc_arg_val_t* cur = rtosc_arg_val_itr_get(&itr, &av_buffer);
-        vals[i] = cur->val;
-        argstr[i] = cur->type;
-        rtosc_arg_val_itr_next(&itr);
+        if(itr.av->type == '-' && itr.av->val.r.has_delta && itr.av->val.r.num)
+        {
+            // expand the rest of the range in chunks
+            rtosc_arg_val_t chunk[32];
+            int left = itr.av->val.r.num - itr.range_i;
+            while(left)
+            {
+                int n = left < 32 ? left : 32;
+                rtosc_arg_val_range_args(itr.av, itr.range_i, n, chunk);
+                for(int k = 0; k < n; ++k, ++i) {
+                    vals[i] = chunk[k].val;
+                    argstr[i] = chunk[k].type;
+                }
+                itr.range_i += n;
+                left -= n;
+            }
+            // let the iterator leave the range
+            --itr.range_i;
+            rtosc_arg_val_itr_next(&itr);
+        }
+        else
+        {
+            rtosc_arg_val_t av_buffer;
+            const rtosc_arg_val_t* cur = rtosc_arg_val_itr_get(&itr,
+                                                               &av_buffer);
+            vals[i] = cur->val;
+            argstr[i] = cur->type;
+            rtosc_arg_val_itr_next(&itr);
+            ++i;
+        }
     }
     argstr[i] = 0;
 
@@ -456,7 +555,6 @@ size_t rtosc_amessage(char              *buffer,
         char arg = *arguments++;
         assert(arg);
         int32_t i;
-        int64_t d;
         const uint8_t *m;
         const char *s;
         const unsigned char *u;
@@ -465,26 +563,16 @@ size_t rtosc_amessage(char              *buffer,
             case 'h':
             case 't':
             case 'd':
-                d = args[arg_pos++].t;
-                buffer[pos++] = ((d>>56) & 0xff);
-                buffer[pos++] = ((d>>48) & 0xff);
-                buffer[pos++] = ((d>>40) & 0xff);
-                buffer[pos++] = ((d>>32) & 0xff);
-                buffer[pos++] = ((d>>24) & 0xff);
-                buffer[pos++] = ((d>>16) & 0xff);
-                buffer[pos++] = ((d>>8) & 0xff);
-                buffer[pos++] = (d & 0xff);
+                rtosc_pack64((uint8_t*)buffer+pos, &args[arg_pos++].t, 1);
+                pos += 8;
                 --toparse;
                 break;
             case 'r':
             case 'f':
             case 'c':
             case 'i':
-                i = args[arg_pos++].i;
-                buffer[pos++] = ((i>>24) & 0xff);
-                buffer[pos++] = ((i>>16) & 0xff);
-                buffer[pos++] = ((i>>8) & 0xff);
-                buffer[pos++] = (i & 0xff);
+                rtosc_pack32((uint8_t*)buffer+pos, &args[arg_pos++].i, 1);
+                pos += 4;
                 --toparse;
                 break;
             case 'm':
@@ -530,6 +618,213 @@ size_t rtosc_amessage(char              *buffer,
     return pos;
 }
 
+//size of a padded string of n characters, including at least one null
+static size_t padded(size_t n)
+{
+    return n + 4 - n%4;
+}
+
+int rtosc_builder_begin(rtosc_builder *b, char *buffer, size_t len,
+                        const char *path, unsigned max_tags)
+{
+    const size_t path_len = padded(strlen(path));
+    const size_t tags_len = padded(1 + max_tags);
+
+    b->buffer   = buffer;
+    b->len      = len;
+    b->tags     = path_len;
+    b->args     = path_len + tags_len;
+    b->pos      = b->args;
+    b->ntags    = 0;
+    b->max_tags = max_tags;
+    b->overflow = b->args > len;
+    if(b->overflow)
+        return 0;
+
+    memset(buffer, 0, b->args);
+    memcpy(buffer, path, strlen(path));
+    buffer[b->tags] = ',';
+    return 1;
+}
+
+//append a type tag and reserve size bytes for its value
+static uint8_t *builder_reserve(rtosc_builder *b, char type, size_t size)
+{
+    if(b->overflow || b->ntags == b->max_tags || b->pos + size > b->len) {
+        b->overflow = 1;
+        return NULL;
+    }
+    b->buffer[b->tags + 1 + b->ntags++] = type;
+    uint8_t *value = (uint8_t*)b->buffer + b->pos;
+    b->pos += size;
+    return value;
+}
+
+static int builder_add32(rtosc_builder *b, char type, uint32_t i)
+{
+    uint8_t *v = builder_reserve(b, type, 4);
+    if(!v)
+        return 0;
+    v[0] = (i>>24) & 0xff;
+    v[1] = (i>>16) & 0xff;
+    v[2] = (i>>8)  & 0xff;
+    v[3] =  i      & 0xff;
+    return 1;
+}
+
+static int builder_add64(rtosc_builder *b, char type, uint64_t t)
+{
+    uint8_t *v = builder_reserve(b, type, 8);
+    if(!v)
+        return 0;
+    for(int shift = 56; shift >= 0; shift -= 8)
+        *v++ = (t>>shift) & 0xff;
+    return 1;
+}
+
+static int builder_add_str(rtosc_builder *b, char type, const char *s)
+{
+    assert(s && "Input strings CANNOT be NULL");
+    const size_t n = strlen(s);
+    uint8_t *v = builder_reserve(b, type, padded(n));
+    if(!v)
+        return 0;
+    memcpy(v, s, n);
+    memset(v + n, 0, padded(n) - n);
+    return 1;
+}
+
+int rtosc_builder_add_i32(rtosc_builder *b, int32_t i)
+{
+    return builder_add32(b, 'i', i);
+}
+
+int rtosc_builder_add_i64(rtosc_builder *b, int64_t h)
+{
+    return builder_add64(b, 'h', h);
+}
+
+int rtosc_builder_add_float(rtosc_builder *b, float f)
+{
+    rtosc_arg_t a;
+    a.f = f;
+    return builder_add32(b, 'f', a.i);
+}
+
+int rtosc_builder_add_double(rtosc_builder *b, double d)
+{
+    rtosc_arg_t a;
+    a.d = d;
+    return builder_add64(b, 'd', a.t);
+}
+
+int rtosc_builder_add_timetag(rtosc_builder *b, uint64_t t)
+{
+    return builder_add64(b, 't', t);
+}
+
+int rtosc_builder_add_char(rtosc_builder *b, char c)
+{
+    return builder_add32(b, 'c', c);
+}
+
+int rtosc_builder_add_rgba(rtosc_builder *b, int32_t r)
+{
+    return builder_add32(b, 'r', r);
+}
+
+int rtosc_builder_add_midi(rtosc_builder *b, const uint8_t m[4])
+{
+    uint8_t *v = builder_reserve(b, 'm', 4);
+    if(!v)
+        return 0;
+    memcpy(v, m, 4);
+    return 1;
+}
+
+int rtosc_builder_add_string(rtosc_builder *b, const char *s)
+{
+    return builder_add_str(b, 's', s);
+}
+
+int rtosc_builder_add_symbol(rtosc_builder *b, const char *S)
+{
+    return builder_add_str(b, 'S', S);
+}
+
+int rtosc_builder_add_blob(rtosc_builder *b, int32_t len, const uint8_t *data)
+{
+    const size_t size = 4 + len + (len%4 ? 4 - len%4 : 0);
+    uint8_t *v = builder_reserve(b, 'b', size);
+    if(!v)
+        return 0;
+    v[0] = (len>>24) & 0xff;
+    v[1] = (len>>16) & 0xff;
+    v[2] = (len>>8)  & 0xff;
+    v[3] =  len      & 0xff;
+    if(data)
+        memcpy(v + 4, data, len);
+    else
+        memset(v + 4, 0, len);
+    memset(v + 4 + len, 0, size - 4 - len);
+    return 1;
+}
+
+int rtosc_builder_add_run(rtosc_builder *b, char type, const void *src,
+                          size_t n)
+{
+    const unsigned size = run_size(type);
+    assert(size);
+    if(b->overflow || b->ntags + n > b->max_tags ||
+       b->pos + n * size > b->len) {
+        b->overflow = 1;
+        return 0;
+    }
+    memset(b->buffer + b->tags + 1 + b->ntags, type, n);
+    b->ntags += n;
+    if(size == 4)
+        rtosc_pack32((uint8_t*)b->buffer + b->pos, src, n);
+    else
+        rtosc_pack64((uint8_t*)b->buffer + b->pos, src, n);
+    b->pos += n * size;
+    return 1;
+}
+
+int rtosc_builder_add_bool(rtosc_builder *b, int T)
+{
+    return builder_reserve(b, T ? 'T' : 'F', 0) != NULL;
+}
+
+int rtosc_builder_add_nil(rtosc_builder *b)
+{
+    return builder_reserve(b, 'N', 0) != NULL;
+}
+
+int rtosc_builder_add_inf(rtosc_builder *b)
+{
+    return builder_reserve(b, 'I', 0) != NULL;
+}
+
+int rtosc_builder_array(rtosc_builder *b, int begin)
+{
+    return builder_reserve(b, begin ? '[' : ']', 0) != NULL;
+}
+
+size_t rtosc_builder_finish(rtosc_builder *b)
+{
+    if(b->overflow)
+        return 0;
+
+    //move the arguments behind the used type tags
+    const size_t args = b->tags + padded(1 + b->ntags);
+    if(args != b->args) {
+        memmove(b->buffer + args, b->buffer + b->args, b->pos - b->args);
+        b->pos -= b->args - args;
+        b->args = args;
+    }
+    return b->pos;
+}
+
 static rtosc_arg_t extract_arg(const uint8_t *arg_pos, char type)
 {
     rtosc_arg_t result = {0};
@@ -552,23 +847,13 @@ static rtosc_arg_t extract_arg(const uint8_t *arg_pos, char type)
             case 'h':
             case 't':
             case 'd':
-                result.t |= (((uint64_t)*arg_pos++) << 56);
-                result.t |= (((uint64_t)*arg_pos++) << 48);
-                result.t |= (((uint64_t)*arg_pos++) << 40);
-                result.t |= (((uint64_t)*arg_pos++) << 32);
-                result.t |= (((uint64_t)*arg_pos++) << 24);
-                result.t |= (((uint64_t)*arg_pos++) << 16);
-                result.t |= (((uint64_t)*arg_pos++) << 8);
-                result.t |= (((uint64_t)*arg_pos++));
+                rtosc_unpack64(&result.t, arg_pos, 1);
                 break;
             case 'r':
             case 'f':
             case 'c':
             case 'i':
-                result.i |= (*arg_pos++ << 24);
-                result.i |= (*arg_pos++ << 16);
-                result.i |= (*arg_pos++ << 8);
-                result.i |= (*arg_pos++);
+                rtosc_unpack32(&result.i, arg_pos, 1);
                 break;
             case 'm':
                 result.m[0] = *arg_pos++;
@@ -632,6 +917,165 @@ int rtosc_itr_end(rtosc_arg_itr_t itr)
     return !itr.type_pos  || !*itr.type_pos;
 }
 
+size_t rtosc_itr_read_run(rtosc_arg_itr_t *itr, void *dst, size_t max)
+{
+    if(rtosc_itr_end(*itr))
+        return 0;
+    const char     type = *itr->type_pos;
+    const unsigned size = run_size(type);
+    if(!size)
+        return 0;
+
+    size_t n = 0;
+    while(n < max && itr->type_pos[n] == type)
+        ++n;
+    if(size == 4)
+        rtosc_unpack32(dst, itr->value_pos, n);
+    else
+        rtosc_unpack64(dst, itr->value_pos, n);
+
+    itr->type_pos   = advance_past_dummy_args(itr->type_pos + n);
+    itr->value_pos += n * size;
+    return n;
+}
+
+int rtosc_decode_plan_init(rtosc_decode_plan_t *plan, const char *types)
+{
+    plan->nruns = 0;
+    plan->nargs = 0;
+    plan->native_size = 0;
+    int native = 1;
+    for(; *types; ++types) {
+        const char type = *types;
+        if(type == '[' || type == ']')
+            continue;
+        uint8_t size;
+        if(strchr("ifcrm", type))
+            size = 4;
+        else if(strchr("htd", type))
+            size = 8;
+        else if(strchr("TFNI", type))
+            size = 0;
+        else if(strchr("sSb", type)) {
+            size = 255;
+            native = 0;
+        } else
+            return 0;
+
+        rtosc_decode_run_t *last = plan->nruns ? plan->runs + plan->nruns - 1
+                                               : NULL;
+        if(last && last->type == type)
+            ++last->count;
+        else {
+            if(plan->nruns == RTOSC_DECODE_PLAN_MAX_RUNS)
+                return 0;
+            rtosc_decode_run_t run = {type, size, 1};
+            plan->runs[plan->nruns++] = run;
+            //64 bit runs start 8 byte aligned
+            if(size == 8)
+                plan->native_size += (8 - plan->native_size % 8) % 8;
+        }
+        ++plan->nargs;
+        if(size != 255)
+            plan->native_size += size;
+    }
+    if(!native)
+        plan->native_size = 0;
+    return 1;
+}
+
+int rtosc_decode_plan_matches(const rtosc_decode_plan_t *plan,
+                              const char *msg)
+{
+    const char *types = rtosc_argument_string(msg);
+    for(unsigned r = 0; r < plan->nruns; ++r)
+        for(uint32_t n = 0; n < plan->runs[r].count; ++n) {
+            types = advance_past_dummy_args(types);
+            if(*types++ != plan->runs[r].type)
+                return 0;
+        }
+    return !*advance_past_dummy_args(types);
+}
+
+size_t rtosc_plan_decode(const rtosc_decode_plan_t *plan, const char *msg,
+                         rtosc_arg_t *args, size_t max)
+{
+    const uint8_t *pos = (const uint8_t*)msg + arg_start(msg);
+    size_t n = 0;
+    for(unsigned r = 0; r < plan->nruns && n < max; ++r) {
+        const rtosc_decode_run_t *run = plan->runs + r;
+        const size_t end = n + run->count < max ? n + run->count : max;
+        switch(run->type)
+        {
+            case 'i':
+            case 'f':
+            case 'c':
+            case 'r':
+                for(; n < end; ++n, pos += 4) {
+                    memset(args + n, 0, sizeof(*args));
+                    rtosc_unpack32(&args[n].i, pos, 1);
+                }
+                break;
+            case 'h':
+            case 't':
+            case 'd':
+                for(; n < end; ++n, pos += 8) {
+                    memset(args + n, 0, sizeof(*args));
+                    rtosc_unpack64(&args[n].t, pos, 1);
+                }
+                break;
+            case 'm':
+                for(; n < end; ++n, pos += 4) {
+                    memset(args + n, 0, sizeof(*args));
+                    memcpy(args[n].m, pos, 4);
+                }
+                break;
+            case 's':
+            case 'S':
+            case 'b':
+                for(; n < end; ++n) {
+                    args[n] = extract_arg(pos, run->type);
+                    pos += arg_size(pos, run->type);
+                }
+                break;
+            default:
+                for(; n < end; ++n) {
+                    memset(args + n, 0, sizeof(*args));
+                    args[n].T = run->type == 'T';
+                }
+        }
+    }
+    return n;
+}
+
+size_t rtosc_plan_decode_native(const rtosc_decode_plan_t *plan,
+                                const char *msg, void *dst, size_t len)
+{
+    if(!plan->native_size && plan->nargs)
+        for(unsigned r = 0; r < plan->nruns; ++r)
+            if(plan->runs[r].size == 255)
+                return 0;
+    if(len < plan->native_size)
+        return 0;
+    const uint8_t *pos = (const uint8_t*)msg + arg_start(msg);
+    uint8_t *out = (uint8_t*)dst;
+    size_t written = 0;
+    for(unsigned r = 0; r < plan->nruns; ++r) {
+        const rtosc_decode_run_t *run = plan->runs + r;
+        const size_t bytes = run->size * run->count;
+        if(run->size == 8) {
+            written += (8 - written % 8) % 8;
+            rtosc_unpack64(out + written, pos, run->count);
+        } else if(run->type == 'm')
+            memcpy(out + written, pos, bytes);
+        else if(run->size == 4)
+            rtosc_unpack32(out + written, pos, run->count);
+        written += bytes;
+        pos += bytes;
+    }
+    return written;
+}
+
 rtosc_arg_t rtosc_argument(const char *msg, unsigned idx)
 {
     char type = rtosc_type(msg, idx);
@@ -639,6 +1083,62 @@ rtosc_arg_t rtosc_argument(const char *msg, unsigned idx)
     return extract_arg(arg_mem, type);
 }
 
+size_t rtosc_argument_run(const char *msg, unsigned i, void *dst, size_t max)
+{
+    if(i >= rtosc_narguments(msg))
+        return 0;
+    rtosc_arg_itr_t itr;
+    itr.type_pos  = rtosc_argument_string(msg);
+    //skip to the ith argument, like arg_off()
+    for(unsigned skipped = 0;; ++itr.type_pos) {
+        const char type = *itr.type_pos;
+        if(type == '[' || type == ']')
+            continue;
+        if(skipped++ == i)
+            break;
+    }
+    itr.value_pos = (const uint8_t*)msg + arg_off(msg, i);
+    return rtosc_itr_read_run(&itr, dst, max);
+}
+
+unsigned rtosc_msg_view_init(rtosc_msg_view *view, const char *msg)
+{
+    const char *args = rtosc_argument_string(msg);
+    unsigned    pos  = arg_start(msg);
+    unsigned    n    = 0;
+
+    view->msg = msg;
+    for(; *args; ++args) {
+        const char type = *args;
+        if(type == '[' || type == ']')
+            continue;
+        if(n < RTOSC_MSG_VIEW_MAX_ARGS) {
+            view->types[n]   = type;
+            view->offsets[n] = pos;
+            pos += arg_size((const uint8_t*)msg + pos, type);
+        }
+        ++n;
+    }
+    view->nargs = n;
+    return n;
+}
+
+char rtosc_msg_view_type(const rtosc_msg_view *view, unsigned i)
+{
+    assert(i < view->nargs);
+    return i < RTOSC_MSG_VIEW_MAX_ARGS ? view->types[i]
+                                       : rtosc_type(view->msg, i);
+}
+
+rtosc_arg_t rtosc_msg_view_argument(const rtosc_msg_view *view, unsigned i)
+{
+    assert(i < view->nargs);
+    if(i >= RTOSC_MSG_VIEW_MAX_ARGS)
+        return rtosc_argument(view->msg, i);
+    return extract_arg((const uint8_t*)view->msg + view->offsets[i],
+                       view->types[i]);
+}
+
 static unsigned char deref(unsigned pos, ring_t *ring)
 {
     return pos<ring[0].len ? ring[0].data[pos] :
@@ -650,6 +1150,11 @@ static size_t bundle_ring_length(ring_t *ring)
     unsigned pos = 8+8;//goto first length field
     uint32_t advance = 0;
     do {
+        //A '/' or '#' can not start a sane element size (>500MiB), it is the
+        //start of the next message, e.g. in a ThreadLink
+        const unsigned char first = deref(pos, ring);
+        if(first == '/' || first == '#')
+            break;
         advance = deref(pos+0, ring) << (8*3) |
                   deref(pos+1, ring) << (8*2) |
                   deref(pos+2, ring) << (8*1) |
@@ -661,20 +1166,122 @@ static size_t bundle_ring_length(ring_t *ring)
     return pos <= (ring[0].len+ring[1].len) ? pos : 0;
 }
 
+/*
+ * Contiguous version of the scans in rtosc_message_ring_length(). Bytes at
+ * or after len read as 0, like past the end of a ring. The null terminator
+ * scans use memchr()/strlen(), which the C libraries implement with SIMD
+ * and select for the running CPU, instead of one byte per iteration.
+ */
+static size_t next_nul(const char *msg, size_t len, size_t pos)
+{
+    if(pos >= len)
+        return pos;
+    if(len == (size_t)-1) //unbounded
+        return pos + strlen(msg+pos);
+    const char *nul = (const char*)memchr(msg+pos, 0, len-pos);
+    return nul ? (size_t)(nul-msg) : len;
+}
+
+static unsigned char flat_deref(const char *msg, size_t len, size_t pos)
+{
+    return pos < len ? (unsigned char)msg[pos] : 0;
+}
+
+static size_t flat_message_length(const char *msg, size_t len)
+{
+    //Consume path
+    size_t pos = next_nul(msg, len, 0);
+
+    //Travel through the null word end [1..4] bytes
+    for(int i=0; i<4; ++i)
+        if(flat_deref(msg, len, ++pos))
+            break;
+
+    if(flat_deref(msg, len, pos) != ',')
+        return 0;
+
+    const size_t aligned_pos = pos;
+    size_t arguments = pos+1;
+    pos = next_nul(msg, len, pos+1);
+    pos += 4-(pos-aligned_pos)%4;
+
+    unsigned toparse = 0;
+    for(size_t arg = arguments; flat_deref(msg, len, arg); ++arg)
+        toparse += has_reserved(msg[arg]);
+
+    //Take care of varargs
+    while(toparse)
+    {
+        char arg = flat_deref(msg, len, arguments++);
+        assert(arg);
+        uint32_t i;
+        switch(arg) {
+            case 'h':
+            case 't':
+            case 'd':
+                pos += 8;
+                --toparse;
+                break;
+            case 'm':
+            case 'r':
+            case 'c':
+            case 'f':
+            case 'i':
+                pos += 4;
+                --toparse;
+                break;
+            case 'S':
+            case 's':
+                pos = next_nul(msg, len, pos+1);
+                pos += 4-(pos-aligned_pos)%4;
+                --toparse;
+                break;
+            case 'b':
+                i = 0;
+                i |= (flat_deref(msg, len, pos++) << 24);
+                i |= (flat_deref(msg, len, pos++) << 16);
+                i |= (flat_deref(msg, len, pos++) << 8);
+                i |= (flat_deref(msg, len, pos++));
+                pos += i;
+                if((pos-aligned_pos)%4)
+                    pos += 4-(pos-aligned_pos)%4;
+                --toparse;
+                break;
+            default:
+                ;
+        }
+    }
+
+    return pos <= len ? pos : 0;
+}
+
 //Zero means no full message present
 size_t rtosc_message_ring_length(ring_t *ring)
 {
     //Check if the message is a bundle
-    if(deref(0,ring) == '#' &&
+    //(one compare, unless the bundle header itself wraps around)
+    int bundle;
+    if(ring[0].len >= 8)
+        bundle = !memcmp(ring[0].data, "#bundle", 8);
+    else
+        bundle = deref(0,ring) == '#' &&
             deref(1,ring) == 'b' &&
             deref(2,ring) == 'u' &&
             deref(3,ring) == 'n' &&
             deref(4,ring) == 'd' &&
             deref(5,ring) == 'l' &&
             deref(6,ring) == 'e' &&
-            deref(7,ring) == '\0')
+            deref(7,ring) == '\0';
+    if(bundle)
         return bundle_ring_length(ring);
 
+    //Messages which do not wrap around need no ring accesses.
+    //If the first segment only holds a part of the message, the flat walk
+    //always ends behind it and reports no message.
+    const size_t flat_len = flat_message_length(ring[0].data, ring[0].len);
+    if(flat_len || !ring[1].len)
+        return flat_len;
+
     //Proceed for normal messages
     //Consume path
     unsigned pos = 0;
@@ -757,16 +1364,18 @@ size_t rtosc_message_length(const char *msg, size_t len)
 bool rtosc_valid_message_p(const char *msg, size_t len)
 {
     //Validate Path Characters (assumes printable characters are sufficient)
-    if(*msg != '/')
+    if(!len || *msg != '/')
         return false;
-    const char *tmp = msg;
-    for(unsigned i=0; i<len; ++i) {
-        if(*tmp == 0)
-            break;
-        if(!isprint(*tmp))
-            return false;
-        tmp++;
+    const size_t path_len = next_nul(msg, len, 0);
+    //branch free, so the compiler can vectorize it
+    unsigned char unprintable = 0;
+    for(size_t i=0; i<path_len; ++i) {
+        const unsigned char c = msg[i];
+        unprintable |= (c < 0x20) | (c > 0x7e);
     }
+    if(unprintable)
+        return false;
+    const char *tmp = msg + path_len;
 
     //tmp is now either pointing to a null or the end of the string
     const size_t offset1 = tmp-msg;
@@ -906,3 +1515,159 @@ uint64_t rtosc_bundle_timetag(const char *msg)
 {
     return extract_uint64((const uint8_t*)msg+8);
 }
+
+rtosc_bundle_itr_t rtosc_bundle_itr_begin(const char *msg, size_t len)
+{
+    rtosc_bundle_itr_t itr;
+    itr.pos       = msg + 16;
+    itr.remaining = len > 16 ? len - 16 : 0;
+    return itr;
+}
+
+int rtosc_bundle_itr_end(rtosc_bundle_itr_t itr)
+{
+    if(itr.remaining < 4)
+        return 1;
+    const uint32_t size = extract_uint32((const uint8_t*)itr.pos);
+    return !size || size > itr.remaining - 4;
+}
+
+const char *rtosc_bundle_itr_next(rtosc_bundle_itr_t *itr, size_t *len)
+{
+    const uint32_t size = extract_uint32((const uint8_t*)itr->pos);
+    const char    *elm  = itr->pos + 4;
+    if(len)
+        *len = size;
+    //elements are 4 byte aligned
+    const size_t step = 4 + size + (size%4 ? 4 - size%4 : 0);
+    itr->pos       += step;
+    itr->remaining  = step < itr->remaining ? itr->remaining - step : 0;
+    return elm;
+}
+
+size_t rtosc_bundle_index(const char *msg, size_t len,
+                          const char **elms, size_t *lens, size_t max)
+{
+    size_t n = 0;
+    for(rtosc_bundle_itr_t itr = rtosc_bundle_itr_begin(msg, len);
+        !rtosc_bundle_itr_end(itr); ++n) {
+        size_t elm_len;
+        const char *elm = rtosc_bundle_itr_next(&itr, &elm_len);
+        if(n < max) {
+            if(elms)
+                elms[n] = elm;
+            if(lens)
+                lens[n] = elm_len;
+        }
+    }
+    return n;
+}
+
+size_t rtosc_bundle_walk(const char *msg, size_t len,
+                         void (*cb)(const char *msg, size_t len, void *data),
+                         void *data)
+{
+    if(!rtosc_bundle_p(msg)) {
+        cb(msg, len, data);
+        return 1;
+    }
+
+    size_t n = 0;
+    for(rtosc_bundle_itr_t itr = rtosc_bundle_itr_begin(msg, len);
+        !rtosc_bundle_itr_end(itr);) {
+        size_t elm_len;
+        const char *elm = rtosc_bundle_itr_next(&itr, &elm_len);
+        n += rtosc_bundle_walk(elm, elm_len, cb, data);
+    }
+    return n;
+}
+
+static void bundle_header(char *buffer, uint64_t tt)
+{
+    memcpy(buffer, "#bundle", 8);
+    emplace_uint64((uint8_t*)buffer + 8, tt);
+}
+
+int rtosc_bundle_writer_begin(rtosc_bundle_writer *w, char *buffer,
+                              size_t len, uint64_t tt)
+{
+    w->buffer = buffer;
+    w->len    = len;
+    w->tt     = tt;
+    if(len < 16) {
+        w->pos   = len;
+        w->depth = 0;
+        return 0;
+    }
+    rtosc_bundle_writer_restart(w);
+    return 1;
+}
+
+void rtosc_bundle_writer_restart(rtosc_bundle_writer *w)
+{
+    if(w->len < 16)
+        return;
+    bundle_header(w->buffer, w->tt);
+    w->pos   = 16;
+    w->depth = 0;
+}
+
+int rtosc_bundle_append(rtosc_bundle_writer *w, const char *msg,
+                        size_t msg_len)
+{
+    if(!msg_len)
+        msg_len = rtosc_message_length(msg, -1);
+    size_t avail;
+    char *dst = rtosc_bundle_append_reserve(w, &avail);
+    if(!msg_len || msg_len > avail)
+        return 0;
+    memcpy(dst, msg, msg_len);
+    return rtosc_bundle_append_commit(w, msg_len);
+}
+
+char *rtosc_bundle_append_reserve(rtosc_bundle_writer *w, size_t *avail)
+{
+    *avail = w->pos + 4 <= w->len ? w->len - w->pos - 4 : 0;
+    return w->buffer + w->pos + 4;
+}
+
+int rtosc_bundle_append_commit(rtosc_bundle_writer *w, size_t msg_len)
+{
+    if(!msg_len || w->pos + 4 + msg_len > w->len)
+        return 0;
+    assert(msg_len%4 == 0);
+    emplace_uint32((uint8_t*)w->buffer + w->pos, msg_len);
+    w->pos += 4 + msg_len;
+    return 1;
+}
+
+int rtosc_bundle_open(rtosc_bundle_writer *w, uint64_t tt)
+{
+    if(w->depth == RTOSC_BUNDLE_WRITER_DEPTH || w->pos + 20 > w->len)
+        return 0;
+    w->open[w->depth++] = w->pos;
+    bundle_header(w->buffer + w->pos + 4, tt);
+    w->pos += 20;
+    return 1;
+}
+
+int rtosc_bundle_close(rtosc_bundle_writer *w)
+{
+    if(!w->depth)
+        return 0;
+    const size_t size_pos = w->open[--w->depth];
+    emplace_uint32((uint8_t*)w->buffer + size_pos, w->pos - size_pos - 4);
+    return 1;
+}
+
+size_t rtosc_bundle_writer_finish(rtosc_bundle_writer *w)
+{
+    if(w->len < 16)
+        return 0;
+    while(rtosc_bundle_close(w))
+        ;
+    //terminate the element list for readers without an exact length
+    if(w->pos + 4 <= w->len)
+        memset(w->buffer + w->pos, 0, 4);
+    return w->pos;
+}
@@ -0,0 +1,170 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/address-table.h>
+#include <cstring>
+#include "common.h"
+
+using namespace rtosc;
+
+struct Voice
+{
+    int   detune = 0;
+    float volume = 0.0f;
+    static const Ports ports;
+};
+
+struct Synth
+{
+    Voice voice[4];
+    float gain = 0.0f;
+    static const Ports ports;
+};
+
+#define rObject Voice
+const Ports Voice::ports = {
+    rParamI(detune, "Detune"),
+    rParamF(volume, "Volume"),
+};
+#undef rObject
+
+#define rObject Synth
+const Ports Synth::ports = {
+    rRecurs(voice, 4, "Voices"),
+    rParamF(gain, "Gain"),
+};
+#undef rObject
+
+char msg[256], compact[256], full[256];
+
+void test_table(void)
+{
+    AddressTable table(Synth::ports);
+    assert_int_eq(9, table.size(), "all leaf ports interned", __LINE__);
+    assert_true(table.id("/voice2/volume") >= 0, "bundle paths interned",
+                __LINE__);
+    assert_str_eq("/voice2/volume", table.path(table.id("/voice2/volume")),
+                  "paths and ids agree", __LINE__);
+    assert_int_eq(-1, table.id("/voice9/volume"), "unknown path", __LINE__);
+    assert_null(table.path(100), "unknown id", __LINE__);
+
+    AddressTable other(Synth::ports);
+    assert_true(table.checksum() == other.checksum(),
+                "equal trees give equal tables", __LINE__);
+    other.add("/extra");
+    assert_false(table.checksum() == other.checksum(),
+                 "checksums differ for different tables", __LINE__);
+    assert_int_eq(9, other.add("/extra"), "adding twice keeps the id",
+                  __LINE__);
+
+    AddressTable big;
+    for(int i=0; i<1000; ++i) {
+        char path[32];
+        snprintf(path, sizeof(path), "/path%d", i);
+        big.add(path);
+    }
+    assert_int_eq(567, big.id("/path567"), "table grows", __LINE__);
+}
+
+void test_compact(void)
+{
+    AddressTable table(Synth::ports);
+    const size_t len = rtosc_message(msg, sizeof(msg), "/voice3/volume",
+                                     "f", 0.5f);
+    const size_t clen = table.compress(msg, compact, sizeof(compact));
+    assert_true(clen && clen < len, "compact messages are shorter", __LINE__);
+    assert_int_eq(table.id("/voice3/volume"), AddressTable::compact_id(compact),
+                  "compact message carries the id", __LINE__);
+    assert_flt_eq(0.5f, rtosc_argument(compact, 0).f,
+                  "compact message keeps the arguments", __LINE__);
+    assert_int_eq(-1, AddressTable::compact_id(msg),
+                  "full messages are not compact", __LINE__);
+
+    assert_hex_eq(msg, full, len, table.expand(compact, full, sizeof(full)),
+                  "expanding restores the message", __LINE__);
+
+    //in place
+    memcpy(full, msg, len);
+    table.expand(compact, compact, sizeof(compact));
+    assert_hex_eq(msg, compact, len, rtosc_message_length(compact, -1),
+                  "expanding in place", __LINE__);
+
+    rtosc_message(msg, sizeof(msg), "/unknown", "i", 1);
+    assert_int_eq(0, table.compress(msg, compact, sizeof(compact)),
+                  "unknown addresses are not compressed", __LINE__);
+}
+
+void test_dispatch(void)
+{
+    AddressTable table(Synth::ports);
+    Synth synth;
+    char loc[128];
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    d.obj      = &synth;
+
+    rtosc_message(msg, sizeof(msg), "/voice1/detune", "i", 7);
+    table.compress(msg, compact, sizeof(compact));
+    assert_true(table.dispatch(Synth::ports, compact, d),
+                "dispatch compact message", __LINE__);
+    assert_int_eq(7, synth.voice[1].detune, "compact message applied",
+                  __LINE__);
+
+    DispatchCache cache;
+    rtosc_message(msg, sizeof(msg), "/gain", "f", 0.25f);
+    table.compress(msg, compact, sizeof(compact));
+    for(int i=0; i<3; ++i) {
+        d.obj = &synth;
+        table.dispatch(Synth::ports, compact, d, &cache);
+    }
+    assert_flt_eq(0.25f, synth.gain, "cached compact dispatch", __LINE__);
+    assert_int_eq(2, cache.hits, "repeated ids hit the cache", __LINE__);
+
+    rtosc_message(compact, sizeof(compact), "/#1000", "i", 1);
+    assert_false(table.dispatch(Synth::ports, compact, d),
+                 "unknown ids are rejected", __LINE__);
+}
+
+class ReplyData : public RtData
+{
+    public:
+        char reply_msg[256];
+        ReplyData(void) { reply_msg[0] = 0; }
+        void reply(const char *path, const char *args, ...) override
+        {
+            va_list va;
+            va_start(va, args);
+            rtosc_vmessage(reply_msg, sizeof(reply_msg), path, args, va);
+            va_end(va);
+        }
+};
+
+void test_ports(void)
+{
+    AddressTable table(Synth::ports);
+    Ports root = {table.addressTablePort()};
+    char loc[128];
+    ReplyData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+
+    rtosc_message(msg, sizeof(msg), "/address-table/lookup", "s", "/gain");
+    root.dispatch(msg+1, d, true);
+    assert_int_eq(table.id("/gain"), rtosc_argument(d.reply_msg, 1).i,
+                  "ids can be looked up over OSC", __LINE__);
+
+    rtosc_message(msg, sizeof(msg), "/address-table/checksum", "");
+    root.dispatch(msg+1, d, true);
+    assert_true((uint32_t)rtosc_argument(d.reply_msg, 0).i == table.checksum(),
+                "checksum can be queried over OSC", __LINE__);
+}
+
+int main()
+{
+    test_table();
+    test_compact();
+    test_dispatch();
+    test_ports();
+    return test_summary();
+}
@@ -392,6 +392,147 @@ void different_sizes()
     cmp_gt(l, l, 2, 1, NULL, "size-2-array", "size-1-array", __LINE__);
 }
 
+void long_arrays()
+{
+    // long runs of one type take the fast path
+    enum { n = 256 };
+    static rtosc_arg_val_t la[n + 3], ra[n + 3];
+    for(int i = 0; i < n; ++i)
+    {
+        la[i].type = ra[i].type = 'f';
+        la[i].val.f = ra[i].val.f = i * 0.5f;
+    }
+    cmp_1(eq, la, ra, n, n, NULL, "float run", "same float run", __LINE__);
+
+    ra[n-1].val.f += 1.0f;
+    cmp_gt(ra, la, n, n, NULL,
+           "float run, last greater", "float run", __LINE__);
+
+    rtosc_cmp_options very_tolerant = { 2.0 };
+    cmp_1(eq, la, ra, n, n, &very_tolerant,
+          "float run", "float run, last greater (2.0 tolerance)", __LINE__);
+
+    // the first difference decides, not the later ones
+    ra[n-1].val.f = la[n-1].val.f;
+    ra[10].val.f = -1.0f;
+    ra[20].val.f = 1000.0f;
+    cmp_gt(la, ra, n, n, NULL,
+           "float run", "float run, 10th smaller", __LINE__);
+    ra[10].val.f = la[10].val.f;
+    ra[20].val.f = la[20].val.f;
+
+    // a run followed by a range
+    la[n].type = '-';
+    la[n].val.r.num = 2;
+    la[n].val.r.has_delta = 0;
+    la[n+1].type = 'f';
+    la[n+1].val.f = 3.0f;
+    ra[n].type = ra[n+1].type = 'f';
+    ra[n].val.f = ra[n+1].val.f = 3.0f;
+    cmp_1(eq, la, ra, n+2, n+2, NULL,
+          "float run, range", "float run, expanded range", __LINE__);
+    ra[n+1].val.f = 4.0f;
+    cmp_gt(ra, la, n+2, n+2, NULL,
+           "float run, different values", "float run, range", __LINE__);
+
+    // blobs, once with the same data
+    static uint8_t data1[] = { 1, 2, 3 }, data2[] = { 1, 2, 4 };
+    for(int i = 0; i < n; ++i)
+    {
+        la[i].type = ra[i].type = 'b';
+        la[i].val.b.len = ra[i].val.b.len = 3;
+        la[i].val.b.data = ra[i].val.b.data = data1;
+    }
+    cmp_1(eq, la, ra, n, n, NULL, "blob run", "same blob run", __LINE__);
+    ra[n/2].val.b.data = data2;
+    cmp_gt(ra, la, n, n, NULL, "blob run, middle greater", "blob run",
+           __LINE__);
+}
+
+void hashes()
+{
+    enum { n = 8 };
+    rtosc_arg_val_t la[n], ra[n];
+    for(int i = 0; i < n; ++i)
+    {
+        la[i].type = ra[i].type = 'i';
+        la[i].val.i = ra[i].val.i = 7;
+    }
+    assert_true(rtosc_arg_vals_hash(la, n) == rtosc_arg_vals_hash(ra, n),
+                "equal arrays have equal hashes", __LINE__);
+    ra[n-1].val.i = 8;
+    assert_true(rtosc_arg_vals_hash(la, n) != rtosc_arg_vals_hash(ra, n),
+                "different arrays have different hashes", __LINE__);
+
+    // 7 7 7 7 7 7 7 7 (expanded) vs 7 ... (a range of 8)
+    ra[0].type = '-';
+    ra[0].val.r.num = n;
+    ra[0].val.r.has_delta = 0;
+    ra[1].type = 'i';
+    ra[1].val.i = 7;
+    assert_true(rtosc_arg_vals_hash(la, n) == rtosc_arg_vals_hash(ra, 2),
+                "ranges hash like the values they expand to", __LINE__);
+
+    la[0].type = ra[0].type = 'f';
+    la[0].val.f = 0.0f;
+    ra[0].val.f = -0.0f;
+    assert_true(rtosc_arg_vals_hash(la, 1) == rtosc_arg_vals_hash(ra, 1),
+                "0.0 and -0.0 have equal hashes", __LINE__);
+
+    la[0].type = ra[0].type = 's';
+    la[0].val.s = NULL;
+    ra[0].val.s = "";
+    assert_true(rtosc_arg_vals_hash(la, 1) != rtosc_arg_vals_hash(ra, 1),
+                "NULL and empty strings have different hashes", __LINE__);
+}
+
+void message_hashes()
+{
+    char buf[64];
+    rtosc_arg_val_t av[4];
+    av[0].type = 'a';
+    av[0].val.a.type = 'i';
+    av[0].val.a.len = 2;
+    for(int i = 1; i < 4; ++i)
+    {
+        av[i].type = 'i';
+        av[i].val.i = i;
+    }
+
+    // "/x [1 2] 3"
+    rtosc_message(buf, sizeof(buf), "/x", "[ii]i", 1, 2, 3);
+    uint64_t h = rtosc_message_hash(buf);
+    assert_true(h == rtosc_avmessage_hash("/x", av, 4),
+                "messages hash like their argument values", __LINE__);
+    assert_true(h != rtosc_avmessage_hash("/y", av, 4),
+                "the address is part of the hash", __LINE__);
+    assert_true(h != rtosc_avmessage_hash("/x", av + 1, 3),
+                "arrays differ from plain values", __LINE__);
+
+    // "/x 1 2 3"
+    rtosc_avmessage(buf, sizeof(buf), "/x", 3, av + 1);
+    assert_true(rtosc_message_hash(buf) == rtosc_avmessage_hash("/x", av + 1, 3),
+                "messages without arrays", __LINE__);
+
+    // "/x 1 ... 3" (a range with delta)
+    rtosc_arg_val_t rng[3];
+    rng[0].type = '-';
+    rng[0].val.r.num = 3;
+    rng[0].val.r.has_delta = 1;
+    rng[1].type = 'i';
+    rng[1].val.i = 1;
+    rng[2] = av[1];
+    assert_true(rtosc_avmessage_hash("/x", rng, 3) == rtosc_message_hash(buf),
+                "range messages hash like the expanded message", __LINE__);
+
+    rtosc_message(buf, sizeof(buf), "/x", "");
+    assert_true(rtosc_message_hash(buf) == rtosc_avmessage_hash("/x", av, 0),
+                "messages without arguments", __LINE__);
+
+    assert_true(rtosc_hash_combine(1, 2) != rtosc_hash_combine(2, 1),
+                "combined hashes depend on the order", __LINE__);
+}
+
 int main()
 {
     ints();
@@ -407,6 +548,9 @@ int main()
     different_types();
     multiple_args();
     different_sizes();
+    long_arrays();
+    hashes();
+    message_hashes();
 
     return test_summary();
 }
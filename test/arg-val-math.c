@@ -117,6 +117,165 @@ void special_null_test()
 /*
     all tests
 */
+void test_range_args(char type, double start, double delta)
+{
+    rtosc_arg_val_t range[3], bulk[100], single;
+    range[0].type = '-';
+    range[0].val.r.num = 1000;
+    range[0].val.r.has_delta = 1;
+    rtosc_arg_val_from_double(range + 1, type, delta);
+    rtosc_arg_val_from_double(range + 2, type, start);
+
+    int all_equal = 1;
+    for(int first = 0; first < 1000; first += 100)
+    {
+        rtosc_arg_val_range_args(range, first, 100, bulk);
+        for(int k = 0; k < 100; ++k)
+        {
+            rtosc_arg_val_range_arg(range, first + k, &single);
+            // exact comparison: bulk computation must not differ
+            all_equal = all_equal &&
+                        rtosc_arg_vals_eq_single(&single, bulk + k, NULL);
+        }
+    }
+
+    char str[32];
+    snprintf(str, 32, "bulk range args of type '%c'", type);
+    assert_int_eq(1, all_equal, str, __LINE__);
+}
+
+//! compare each bulk binary op with the single op, on mixed types
+void test_bulk_binary()
+{
+    enum { n = 12 };
+    const char types[n] = { 'i', 'i', 'i', 'f', 'f', 'd', 'T', 'F', 'h', 'h',
+                            'c', 'f' };
+    rtosc_arg_val_t lhs[n], rhs[n], bulk[n], single;
+    for(int k = 0; k < n; ++k)
+    {
+        rtosc_arg_val_from_double(lhs + k, types[k], k + 1.5);
+        rtosc_arg_val_from_double(rhs + k, types[k], 2.25 - k);
+    }
+    binary_arg_func_ptr singles[3] = { rtosc_arg_val_add, rtosc_arg_val_sub,
+                                       rtosc_arg_val_mult };
+    int (*bulks[3])(const rtosc_arg_val_t *, const rtosc_arg_val_t *,
+                    size_t, rtosc_arg_val_t *) = {
+        rtosc_arg_vals_add, rtosc_arg_vals_sub, rtosc_arg_vals_mult };
+    const char* names[3] = { "bulk add", "bulk sub", "bulk mult" };
+
+    for(int op = 0; op < 3; ++op)
+    {
+        int ok = bulks[op](lhs, rhs, n, bulk);
+        int all_equal = 1;
+        for(int k = 0; k < n; ++k)
+        {
+            singles[op](lhs + k, rhs + k, &single);
+            all_equal = all_equal &&
+                        rtosc_arg_vals_eq_single(&single, bulk + k, NULL);
+        }
+        assert_true(ok, names[op], __LINE__);
+        assert_true(all_equal, names[op], __LINE__);
+    }
+
+    // in place, 1 + 2
+    rtosc_arg_vals_add(lhs, rhs, n, lhs);
+    assert_int_eq(3, lhs[0].val.i, "bulk add in place", __LINE__);
+
+    rhs[3].type = 's';
+    rhs[3].val.s = "no number";
+    assert_true(!rtosc_arg_vals_add(lhs, rhs, n, bulk),
+                "bulk add fails on strings", __LINE__);
+}
+
+void test_bulk_scale_lerp()
+{
+    rtosc_arg_val_t av[5], from[5], to[5], res[5];
+    rtosc_arg_val_from_double(av + 0, 'f', 0.5);
+    rtosc_arg_val_from_double(av + 1, 'f', -1.0);
+    rtosc_arg_val_from_double(av + 2, 'i', 3);
+    rtosc_arg_val_from_double(av + 3, 'd', 0.25);
+    rtosc_arg_val_from_double(av + 4, 'F', 0);
+    assert_true(rtosc_arg_vals_scale(av, 5, 2.0, 1.0), "bulk scale", __LINE__);
+    assert_flt_eq(2.0f, av[0].val.f, "scale float", __LINE__);
+    assert_flt_eq(-1.0f, av[1].val.f, "scale float", __LINE__);
+    assert_int_eq(7, av[2].val.i, "scale int", __LINE__);
+    assert_flt_eq(1.5f, (float)av[3].val.d, "scale double", __LINE__);
+    assert_int_eq('T', av[4].type, "scale false to true", __LINE__);
+
+    rtosc_arg_val_from_double(from + 0, 'f', 0.0);
+    rtosc_arg_val_from_double(to + 0, 'f', 10.0);
+    rtosc_arg_val_from_double(from + 1, 'i', 100);
+    rtosc_arg_val_from_double(to + 1, 'i', 0);
+    rtosc_arg_val_from_double(from + 2, 'T', 1);
+    rtosc_arg_val_from_double(to + 2, 'F', 0);
+    from[3].type = to[3].type = 's';
+    from[3].val.s = "from";
+    to[3].val.s = "to";
+    rtosc_arg_val_from_double(from + 4, 'd', -1.0);
+    rtosc_arg_val_from_double(to + 4, 'd', 1.0);
+
+    assert_true(rtosc_arg_vals_lerp(from, to, 5, 0.25, res),
+                "bulk lerp", __LINE__);
+    assert_flt_eq(2.5f, res[0].val.f, "lerp float", __LINE__);
+    assert_int_eq(75, res[1].val.i, "lerp int", __LINE__);
+    assert_int_eq('T', res[2].type, "lerp bool before 0.5", __LINE__);
+    assert_str_eq("from", res[3].val.s, "lerp string before 0.5", __LINE__);
+    assert_flt_eq(-0.5f, (float)res[4].val.d, "lerp double", __LINE__);
+
+    rtosc_arg_vals_lerp(from, to, 5, 0.5, res);
+    assert_int_eq('F', res[2].type, "lerp bool at 0.5", __LINE__);
+    assert_str_eq("to", res[3].val.s, "lerp string at 0.5", __LINE__);
+
+    to[1].type = 'f';
+    assert_true(!rtosc_arg_vals_lerp(from, to, 5, 0.5, res),
+                "lerp fails on different types", __LINE__);
+}
+
+void test_packed()
+{
+    enum { n = 1000 };
+    static float f1[n], f2[n], fres[n];
+    static int32_t i1[n], i2[n], ires[n];
+    for(int k = 0; k < n; ++k)
+    {
+        f1[k] = k * 0.5f;
+        f2[k] = -k * 0.25f;
+        i1[k] = k;
+        i2[k] = -2 * k;
+    }
+
+    int all_ok = 1;
+    rtosc_floats_add(f1, f2, n, fres);
+    for(int k = 0; k < n; ++k)
+        all_ok = all_ok && fres[k] == f1[k] + f2[k];
+    rtosc_floats_lerp(f1, f2, n, 0.5f, fres);
+    for(int k = 0; k < n; ++k)
+        all_ok = all_ok && fres[k] == f1[k] + (f2[k] - f1[k]) * 0.5f;
+    rtosc_floats_scale(fres, n, 4.0f, 1.0f);
+    rtosc_floats_clamp(fres, n, -10.0f, 10.0f);
+    for(int k = 0; k < n; ++k) {
+        float exp = (f1[k] + (f2[k] - f1[k]) * 0.5f) * 4.0f + 1.0f;
+        exp = exp < -10.0f ? -10.0f : exp > 10.0f ? 10.0f : exp;
+        all_ok = all_ok && fres[k] == exp;
+    }
+    assert_true(all_ok, "packed float functions", __LINE__);
+
+    all_ok = 1;
+    rtosc_ints_add(i1, i2, n, ires);
+    for(int k = 0; k < n; ++k)
+        all_ok = all_ok && ires[k] == -k;
+    rtosc_ints_lerp(i1, i2, n, 0.5f, ires);
+    for(int k = 0; k < n; ++k)
+        all_ok = all_ok && ires[k] == (int32_t)(k + (-3.0f * k) * 0.5f);
+    rtosc_ints_scale(i1, n, 0.5f, 0.0f);
+    rtosc_ints_clamp(i1, n, 0, 100);
+    for(int k = 0; k < n; ++k) {
+        int32_t exp = (int32_t)(k * 0.5f);
+        all_ok = all_ok && i1[k] == (exp > 100 ? 100 : exp);
+    }
+    assert_true(all_ok, "packed int functions", __LINE__);
+}
+
 int main()
 {
     test_add('T', 0, 0, 0);
@@ -186,6 +345,15 @@ int main()
 
     // rtosc_arg_val_range_arg is being (indirectly)
     // tested in the pretty-format tests
+    test_range_args('i', 7, -3);
+    test_range_args('c', 'a', 1);
+    test_range_args('h', 5000000000, 3000000000);
+    test_range_args('f', 0.5, 0.1);
+    test_range_args('d', -1.0, 0.3333333333);
+
+    test_bulk_binary();
+    test_bulk_scale_lerp();
+    test_packed();
 
     return test_summary();
 }
@@ -0,0 +1,305 @@
+#include <rtosc/broadcaster.h>
+#include <rtosc/feedback-limiter.h>
+#include <rtosc/thread-link.h>
+#include <rtosc/ports.h>
+#include <rtosc/rtosc.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+void message_ref(void)
+{
+    MessageRef a = MessageRef::format("/ref", "if", 1, 2.0f);
+    assert_int_eq(1, a.use_count(), "new message has one reference",
+                  __LINE__);
+    {
+        MessageRef b = a;
+        assert_int_eq(2, a.use_count(), "copies share the message", __LINE__);
+        assert_true(a.data() == b.data(), "copies share the buffer",
+                    __LINE__);
+    }
+    assert_int_eq(1, a.use_count(), "references are released", __LINE__);
+
+    char buf[32];
+    const size_t len = rtosc_message(buf, sizeof(buf), "/ref", "if", 1, 2.0f);
+    assert_int_eq(len, a.size(), "formatted length", __LINE__);
+    assert_true(!memcmp(buf, a.data(), len), "formatted message", __LINE__);
+
+    MessageRef c = MessageRef::copy(buf);
+    assert_true(c.size() == len && !memcmp(buf, c.data(), len),
+                "copied message", __LINE__);
+    assert_int_eq(0, MessageRef().use_count(), "empty reference", __LINE__);
+}
+
+struct client_t
+{
+    std::vector<MessageRef> got;
+    int calls = 0;
+};
+
+void fan_out(void)
+{
+    Broadcaster b;
+    client_t clients[3];
+    for(client_t &c : clients)
+        b.subscribe([&c](const MessageRef *msgs, size_t n) {
+                ++c.calls;
+                c.got.insert(c.got.end(), msgs, msgs+n);
+            });
+    assert_int_eq(3, b.subscribers(), "clients are subscribed", __LINE__);
+
+    b.broadcast("/volume", "f", 0.5f);
+    b.broadcast("/pan", "f", 0.1f);
+    b.broadcast("/volume", "f", 0.5f);
+    b.broadcast("/volume", "f", 0.75f);
+    assert_int_eq(3, b.pending(), "identical broadcasts are merged", __LINE__);
+    assert_int_eq(1, b.merged(), "merges are counted", __LINE__);
+    assert_int_eq(3, b.flush(), "the tick is flushed", __LINE__);
+    assert_int_eq(0, b.pending(), "nothing is pending after flush",
+                  __LINE__);
+
+    int ok = 1;
+    for(client_t &c : clients)
+        ok &= c.calls == 1 && c.got.size() == 3 &&
+              c.got[0].data() == clients[0].got[0].data() &&
+              c.got[2].data() == clients[0].got[2].data();
+    assert_true(ok, "all clients get the same buffers with one call",
+                __LINE__);
+    assert_true(!strcmp(clients[1].got[1].data(), "/pan") &&
+                rtosc_argument(clients[1].got[2].data(), 0).f == 0.75f,
+                "messages are kept in broadcast order", __LINE__);
+    assert_int_eq(3, clients[0].got[0].use_count(),
+                  "the broadcaster keeps no references after flush",
+                  __LINE__);
+
+    //the next tick sends the same message again
+    b.broadcast("/volume", "f", 0.5f);
+    b.flush();
+    assert_int_eq(4, clients[2].got.size(), "merging is per tick", __LINE__);
+    b.flush();
+    assert_int_eq(2, clients[2].calls, "empty ticks are not passed",
+                  __LINE__);
+}
+
+void to_link(void)
+{
+    Broadcaster b;
+    ThreadLink link(64, 8);
+    b.subscribe(Broadcaster::link_sink(link));
+    b.broadcast("/a", "i", 1);
+    b.broadcast("/b", "i", 2);
+    b.flush();
+    int n = 0, ok = 1;
+    while(link.hasNext()) {
+        const char *msg = link.read();
+        ok &= rtosc_argument(msg, 0).i == ++n;
+    }
+    assert_int_eq(2, n, "broadcasts are written to the link", __LINE__);
+    assert_true(ok, "link holds the broadcasts in order", __LINE__);
+}
+
+static const Ports ports = {
+    {"value::i", "", 0, [](const char *msg, RtData &d) {
+            d.broadcast(d.loc, "i", rtosc_argument(msg, 0).i);
+        }},
+    {"array:", "", 0, [](const char *, RtData &d) {
+            rtosc_arg_t vals[2];
+            vals[0].i = 3;
+            vals[1].i = 4;
+            d.broadcastArray("/array", "ii", vals);
+        }},
+};
+
+void from_dispatch(void)
+{
+    Broadcaster b;
+    std::vector<MessageRef> got;
+    b.subscribe([&got](const MessageRef *msgs, size_t n) {
+            got.insert(got.end(), msgs, msgs+n);
+        });
+
+    char loc[128];
+    BroadcastData d(b);
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    char msg[32];
+    for(int i=0; i<3; ++i) {
+        rtosc_message(msg, sizeof(msg), "/value", "i", 7);
+        loc[0] = 0;
+        ports.dispatch(msg, d, true);
+    }
+    rtosc_message(msg, sizeof(msg), "/array", "");
+    ports.dispatch(msg, d, true);
+    b.flush();
+
+    assert_int_eq(2, got.size(), "broadcasts of dispatches are merged",
+                  __LINE__);
+    assert_true(got.size() == 2 && !strcmp(got[0].data(), "/value") &&
+                rtosc_argument(got[0].data(), 0).i == 7,
+                "broadcast of a port", __LINE__);
+    assert_true(got.size() == 2 && !strcmp(got[1].data(), "/array") &&
+                rtosc_argument(got[1].data(), 1).i == 4,
+                "array broadcast of a port", __LINE__);
+}
+
+void subscriptions(void)
+{
+    Subscriptions subs;
+    assert_true(subs.add(1, "/part0/"), "prefix filter", __LINE__);
+    assert_true(subs.add(2, "/part[0-3]/volume"), "pattern filter",
+                __LINE__);
+    assert_true(subs.add(3, "/"), "filter for everything", __LINE__);
+    assert_true(subs.add(4, "/part*/voice?/"), "pattern prefix", __LINE__);
+    assert_true(!subs.add(5, "/part[0-3/volume"), "invalid filter",
+                __LINE__);
+    assert_int_eq(0, subs.filters(5), "invalid filters are not added",
+                  __LINE__);
+
+    std::vector<int> ids = subs.interested("/part0/volume");
+    assert_true(ids == std::vector<int>({1, 2, 3}),
+                "all matching subscribers", __LINE__);
+    ids = subs.interested("/part2/voice1/detune");
+    assert_true(ids == std::vector<int>({3, 4}), "prefix with patterns",
+                __LINE__);
+    ids = subs.interested("/part0");
+    assert_true(ids == std::vector<int>({3}),
+                "prefixes only match addresses below", __LINE__);
+    ids = subs.interested("/part5/volume");
+    assert_true(ids == std::vector<int>({3}), "pattern does not match",
+                __LINE__);
+    assert_true(!subs.wants(2, "/part1/volume/x"),
+                "patterns match whole addresses", __LINE__);
+
+    //cached results are dropped when the filters change
+    assert_true(subs.wants(1, "/part0/pan"), "cached before", __LINE__);
+    subs.remove(1, "/part0/");
+    assert_true(!subs.wants(1, "/part0/pan"), "removed filter", __LINE__);
+    subs.add(1, "/fx/");
+    subs.add(1, "/part1/");
+    assert_int_eq(2, subs.filters(1), "filters are counted", __LINE__);
+    subs.remove_all(1);
+    assert_true(!subs.wants(1, "/fx/x") && !subs.wants(1, "/part1/x"),
+                "all filters are removed", __LINE__);
+}
+
+void filtered(void)
+{
+    Broadcaster b;
+    std::vector<std::string> got[3];
+    int ids[3];
+    for(int i=0; i<3; ++i)
+        ids[i] = b.subscribe([&got, i](const MessageRef *msgs, size_t n) {
+                for(size_t j=0; j<n; ++j)
+                    got[i].push_back(msgs[j].data());
+            });
+    b.add_filter(ids[0], "/part0/");
+    b.add_filter(ids[1], "/part1/");
+    b.add_filter(ids[1], "/master");
+
+    b.broadcast("/part0/volume", "f", 0.5f);
+    b.broadcast("/part1/volume", "f", 0.5f);
+    b.broadcast("/master", "f", 1.0f);
+    b.flush();
+    assert_true(got[0] == std::vector<std::string>({"/part0/volume"}),
+                "subscriber gets its subtree only", __LINE__);
+    assert_true(got[1] == std::vector<std::string>({"/part1/volume",
+                                                    "/master"}),
+                "subscriber with multiple filters", __LINE__);
+    assert_int_eq(3, got[2].size(), "unfiltered subscriber gets everything",
+                  __LINE__);
+    assert_true(b.wants(ids[0], "/part0/pan") &&
+                !b.wants(ids[0], "/master") && b.wants(ids[2], "/master"),
+                "replies can be filtered, too", __LINE__);
+
+    //subscribers without matching messages are not called
+    got[0].clear();
+    b.broadcast("/part1/pan", "f", 0.5f);
+    b.remove_filter(ids[0], "/part0/");
+    b.add_filter(ids[0], "/fx/");
+    b.flush();
+    assert_int_eq(0, got[0].size(), "no call without matches", __LINE__);
+    assert_int_eq(3, got[1].size(), "others are not affected", __LINE__);
+}
+
+void rate_limited(void)
+{
+    Broadcaster b;
+    std::vector<std::string> got;
+    int flushes = 0;
+    FeedbackLimiter slow([&](const MessageRef *msgs, size_t n) {
+            ++flushes;
+            for(size_t i=0; i<n; ++i) {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%s=%d", msgs[i].data(),
+                         rtosc_argument(msgs[i].data(), 0).i);
+                got.push_back(buf);
+            }
+        }, 10, 3);
+    b.subscribe(slow.sink());
+
+    //a dispatch rate of 1 kHz for 0.25 s
+    int sent = 0;
+    for(int ms=0; ms<250; ++ms) {
+        b.broadcast("/meter", "i", ms);
+        if(ms%2)
+            b.broadcast("/value", "i", ms);
+        b.flush();
+        sent += 1 + ms%2;
+        slow.tick(ms/1000.0);
+    }
+    assert_int_eq(3, flushes, "flushes are limited to the rate", __LINE__);
+    assert_int_eq(5, got.size(), "only the latest values are passed",
+                  __LINE__);
+    assert_true(got.size() == 5 && got[0] == "/meter=0" &&
+                got[1] == "/meter=100" && got[2] == "/value=99" &&
+                got[3] == "/meter=200" && got[4] == "/value=199",
+                "values at the time of each flush", __LINE__);
+    assert_int_eq(sent - 5 - (int)slow.pending(), slow.coalesced(),
+                  "replaced values are counted", __LINE__);
+
+    //bounded memory
+    assert_int_eq(2, slow.flush(), "pending values can be flushed at once",
+                  __LINE__);
+    b.broadcast("/a", "i", 1);
+    b.broadcast("/b", "i", 2);
+    b.broadcast("/c", "i", 3);
+    b.broadcast("/d", "i", 4);
+    b.flush();
+    assert_int_eq(3, slow.pending(), "pending messages are bounded",
+                  __LINE__);
+    assert_int_eq(0, slow.dropped(), "further addresses are kept", __LINE__);
+    b.broadcast("/d", "i", 5);
+    b.broadcast("/e", "i", 6);
+    b.broadcast("/f", "i", 7);
+    b.broadcast("/g", "i", 8);
+    b.flush();
+    assert_int_eq(1, slow.dropped(), "addresses beyond the kept are dropped",
+                  __LINE__);
+
+    slow.set_rate(0);
+    got.clear();
+    assert_int_eq(3, slow.tick(0.3), "rate 0 is unlimited", __LINE__);
+    assert_int_eq(3, slow.pending(), "kept addresses are pending now",
+                  __LINE__);
+    assert_int_eq(3, slow.tick(0.31), "kept addresses are flushed", __LINE__);
+    assert_true(got.size() == 6 && got[3] == "/d=5" && got[4] == "/e=6" &&
+                got[5] == "/f=7", "kept addresses arrive after a later tick",
+                __LINE__);
+    assert_int_eq(0, slow.pending(), "nothing is pending anymore", __LINE__);
+}
+
+int main()
+{
+    message_ref();
+    fan_out();
+    to_link();
+    from_dispatch();
+    subscriptions();
+    filtered();
+    rate_limited();
+    return test_summary();
+}
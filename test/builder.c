@@ -0,0 +1,169 @@
+#include <rtosc/rtosc.h>
+#include <string.h>
+#include "common.h"
+
+char expected[256];
+char buffer[256];
+
+void all_types(void)
+{
+    uint8_t midi[4] = {0x12, 0x23, 0x34, 0x45};
+    size_t exp_len = rtosc_message(expected, sizeof(expected), "/dest",
+                                   "ifsbhtdScrmTFNI[i]",
+                                   42, 0.25f, "string", 3, "str",
+                                   (int64_t)-125, (uint64_t)22412, 0.125,
+                                   "Symbol", 25, 0x12345678, midi, 7);
+
+    rtosc_builder b;
+    memset(buffer, 0xff, sizeof(buffer));
+    assert_true(rtosc_builder_begin(&b, buffer, sizeof(buffer), "/dest", 18),
+                "builder starts a message", __LINE__);
+    rtosc_builder_add_i32(&b, 42);
+    rtosc_builder_add_float(&b, 0.25f);
+    rtosc_builder_add_string(&b, "string");
+    rtosc_builder_add_blob(&b, 3, (const uint8_t*)"str");
+    rtosc_builder_add_i64(&b, -125);
+    rtosc_builder_add_timetag(&b, 22412);
+    rtosc_builder_add_double(&b, 0.125);
+    rtosc_builder_add_symbol(&b, "Symbol");
+    rtosc_builder_add_char(&b, 25);
+    rtosc_builder_add_rgba(&b, 0x12345678);
+    rtosc_builder_add_midi(&b, midi);
+    rtosc_builder_add_bool(&b, 1);
+    rtosc_builder_add_bool(&b, 0);
+    rtosc_builder_add_nil(&b);
+    rtosc_builder_add_inf(&b);
+    rtosc_builder_array(&b, 1);
+    rtosc_builder_add_i32(&b, 7);
+    rtosc_builder_array(&b, 0);
+    size_t len = rtosc_builder_finish(&b);
+
+    assert_hex_eq(expected, buffer, exp_len, len,
+                  "builder equals rtosc_message", __LINE__);
+}
+
+void unused_tags(void)
+{
+    size_t exp_len = rtosc_message(expected, sizeof(expected), "/volume",
+                                   "if", 3, 0.5f);
+
+    rtosc_builder b;
+    memset(buffer, 0xff, sizeof(buffer));
+    rtosc_builder_begin(&b, buffer, sizeof(buffer), "/volume", 20);
+    rtosc_builder_add_i32(&b, 3);
+    rtosc_builder_add_float(&b, 0.5f);
+    size_t len = rtosc_builder_finish(&b);
+
+    assert_hex_eq(expected, buffer, exp_len, len,
+                  "builder moves arguments behind the used tags", __LINE__);
+    assert_true(rtosc_valid_message_p(buffer, len),
+                "built message is valid", __LINE__);
+}
+
+void overflow(void)
+{
+    rtosc_builder b;
+    assert_false(rtosc_builder_begin(&b, buffer, 8, "/a/long/path", 2),
+                 "builder detects too long paths", __LINE__);
+    assert_int_eq(0, rtosc_builder_finish(&b),
+                  "no message for too long paths", __LINE__);
+
+    rtosc_builder_begin(&b, buffer, 16, "/a", 2);
+    assert_true(rtosc_builder_add_i32(&b, 1),
+                "builder accepts fitting arguments", __LINE__);
+    assert_false(rtosc_builder_add_string(&b, "too long"),
+                 "builder detects too long arguments", __LINE__);
+    assert_int_eq(0, rtosc_builder_finish(&b),
+                  "no message after argument overflow", __LINE__);
+
+    rtosc_builder_begin(&b, buffer, sizeof(buffer), "/a", 1);
+    rtosc_builder_add_i32(&b, 1);
+    assert_false(rtosc_builder_add_i32(&b, 2),
+                 "builder detects too many type tags", __LINE__);
+    assert_int_eq(0, rtosc_builder_finish(&b),
+                  "no message after type tag overflow", __LINE__);
+}
+
+void empty(void)
+{
+    size_t exp_len = rtosc_message(expected, sizeof(expected), "/empty", "");
+    rtosc_builder b;
+    rtosc_builder_begin(&b, buffer, sizeof(buffer), "/empty", 0);
+    size_t len = rtosc_builder_finish(&b);
+    assert_hex_eq(expected, buffer, exp_len, len,
+                  "builder without arguments", __LINE__);
+}
+
+void runs(void)
+{
+    float   table[100];
+    double  dbl[3] = {0.5, -1.0, 1e10};
+    int32_t ints[2] = {-7, 0x12345678};
+    for(int i=0; i<100; ++i)
+        table[i] = i * 0.25f;
+
+    rtosc_builder b;
+    rtosc_builder_begin(&b, buffer, sizeof(buffer), "/w", 1);
+    assert_false(rtosc_builder_add_run(&b, 'f', table, 100),
+                 "runs honor the type tag reservation", __LINE__);
+
+    static char big[2048];
+    rtosc_builder_begin(&b, big, sizeof(big), "/wavetable", 106);
+    rtosc_builder_add_run(&b, 'i', ints, 2);
+    rtosc_builder_array(&b, 1);
+    rtosc_builder_add_run(&b, 'f', table, 100);
+    rtosc_builder_array(&b, 0);
+    rtosc_builder_add_run(&b, 'd', dbl, 1);
+    size_t len = rtosc_builder_finish(&b);
+    assert_true(len && rtosc_valid_message_p(big, len),
+                "runs build valid messages", __LINE__);
+
+    int ok = 1;
+    for(int i=0; i<100; ++i)
+        ok &= rtosc_argument(big, 2+i).f == table[i];
+    assert_true(ok, "runs equal single arguments", __LINE__);
+    assert_int_eq(-7, rtosc_argument(big, 0).i, "run of ints", __LINE__);
+    assert_true(rtosc_argument(big, 102).d == 0.5, "run of doubles", __LINE__);
+
+    float read[128];
+    assert_int_eq(100, rtosc_argument_run(big, 2, read, 128),
+                  "runs end at array delimiters", __LINE__);
+    assert_true(!memcmp(read, table, sizeof(table)),
+                "read runs equal the written ones", __LINE__);
+    assert_int_eq(10, rtosc_argument_run(big, 50, read, 10),
+                  "runs are limited by the capacity", __LINE__);
+    assert_flt_eq(table[57], read[9], "runs start at the given argument",
+                  __LINE__);
+
+    rtosc_arg_itr_t itr = rtosc_itr_begin(big);
+    int32_t iread[4];
+    assert_int_eq(2, rtosc_itr_read_run(&itr, iread, 4),
+                  "iterator reads runs", __LINE__);
+    assert_int_eq(0x12345678, iread[1], "iterator run values", __LINE__);
+    assert_int_eq(100, rtosc_itr_read_run(&itr, read, 128),
+                  "iterator continues behind runs", __LINE__);
+    assert_true(rtosc_itr_next(&itr).val.d == 0.5,
+                "iterator continues after runs", __LINE__);
+
+    rtosc_message(big, sizeof(big), "/s", "s", "str");
+    assert_int_eq(0, rtosc_argument_run(big, 0, read, 1),
+                  "no runs of variable size types", __LINE__);
+
+    uint32_t blob_src[3] = {1, 2, 0xdeadbeef}, blob_dst[3];
+    uint8_t  packed[12];
+    rtosc_pack32(packed, blob_src, 3);
+    assert_int_eq(0xde, packed[8], "packing is big endian", __LINE__);
+    rtosc_unpack32(blob_dst, packed, 3);
+    assert_true(!memcmp(blob_src, blob_dst, sizeof(blob_src)),
+                "unpacking inverts packing", __LINE__);
+}
+
+int main()
+{
+    all_types();
+    unused_tags();
+    overflow();
+    empty();
+    runs();
+    return test_summary();
+}
@@ -0,0 +1,110 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/bundle-foreach.h>
+#include <string>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+char buffer_a[256];
+char buffer_b[256];
+char buffer_c[256];
+char bundle[1024];
+
+static void cb(const char *, RtData &) {}
+
+static Ports osc = {
+    {"freq::f", "", 0, cb},
+    {"wave#3::i", "", 0, cb},
+};
+static Ports voice = {
+    {"osc#2/", "", &osc, cb},
+    {"gain::f", "", 0, cb},
+};
+static Ports root = {
+    {"voice#4/", "", &voice, cb},
+    {"panic:", "", 0, cb},
+};
+
+static void collect(const Port *, const char *name, const char *,
+                    const Ports &, void *data, void *)
+{
+    ((std::vector<std::string>*)data)->push_back(name);
+}
+
+static void port_elements(void)
+{
+    std::vector<std::string> walked, enumerated;
+    char name_buffer[256] = {0};
+    walk_ports(&root, name_buffer, sizeof(name_buffer), &walked, collect);
+
+    unsigned last_wave = 0;
+    walk_port_elements(root, [&](const port_element_t &e) {
+        char name[256];
+        assert_true(e.name(name, sizeof(name)) > 0,
+                    "Element names fit", __LINE__);
+        enumerated.push_back(name);
+        if(!strcmp(e.port().name, "wave#3::i"))
+            last_wave = e.index();
+    });
+    assert_int_eq(walked.size(), enumerated.size(),
+                  "Enumeration visits all elements", __LINE__);
+    bool same = walked.size() == enumerated.size();
+    for(size_t i = 0; same && i < walked.size(); ++i)
+        same = walked[i] == enumerated[i];
+    assert_true(same, "Enumeration yields the walk's names in its order",
+                __LINE__);
+    assert_str_eq("/voice3/osc1/wave2", enumerated.size() < 35 ? "" :
+                  enumerated[3*9 + 4 + 3].c_str(),
+                  "Names contain all indices", __LINE__);
+    assert_int_eq(2, last_wave, "Innermost index", __LINE__);
+
+    unsigned indices = 0;
+    walk_port_elements(root, [&](const port_element_t &e) {
+        if(e.depth == 3 && e.indices[0] == 1 && e.indices[1] == 0)
+            ++indices;
+    });
+    assert_int_eq(4, indices, "Indices of outer arrays", __LINE__);
+
+    char small[8];
+    size_t fits = 1;
+    walk_port_elements(root, [&](const port_element_t &e) {
+        fits = fits && e.name(small, sizeof(small));
+    });
+    assert_int_eq(0, fits, "Names which do not fit are rejected", __LINE__);
+}
+
+int main()
+{
+    port_elements();
+
+    rtosc_message(buffer_a, 256, "/a", "i", 1);
+    rtosc_message(buffer_b, 256, "/bb", "s", "two");
+    rtosc_bundle(buffer_c, 256, 0, 1, buffer_a);
+    const size_t len = rtosc_bundle(bundle, sizeof(bundle), 0, 3,
+                                    buffer_a, buffer_b, buffer_c);
+
+    std::vector<bundle_element_t> elms;
+    for(bundle_element_t e : BundleRange(bundle, len))
+        elms.push_back(e);
+    assert_int_eq(3, elms.size(), "Range visits all elements", __LINE__);
+    assert_ptr_eq(rtosc_bundle_fetch(bundle, 1), elms[1].msg,
+                  "Range points into the bundle", __LINE__);
+    assert_int_eq(rtosc_message_length(buffer_b, -1), elms[1].len,
+                  "Range yields element lengths", __LINE__);
+    assert_true(rtosc_bundle_p(elms[2].msg),
+                "Range yields nested bundles as elements", __LINE__);
+
+    int nested = 0;
+    for(bundle_element_t e : BundleRange(elms[2].msg, elms[2].len))
+        nested += !strcmp(e.msg, "/a");
+    assert_int_eq(1, nested, "Range over nested bundle", __LINE__);
+
+    int empty = 0;
+    rtosc_bundle(bundle, sizeof(bundle), 0, 0);
+    for(bundle_element_t e : BundleRange(bundle, 16))
+        empty += e.len > 0;
+    assert_int_eq(0, empty, "Range over empty bundle", __LINE__);
+
+    return test_summary();
+}
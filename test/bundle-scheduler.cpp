@@ -0,0 +1,106 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/bundle-scheduler.h>
+#include <rtosc/thread-link.h>
+#include <cstring>
+#include "common.h"
+
+using namespace rtosc;
+
+//one second in NTP time
+static const uint64_t second = 1ull << 32;
+
+char msg_a[64], msg_b[64], msg_c[64];
+char bundle[512], nested[256];
+
+void timing(void)
+{
+    BundleScheduler s(16, 64);
+    rtosc_message(msg_a, sizeof(msg_a), "/a", "i", 1);
+    rtosc_message(msg_b, sizeof(msg_b), "/b", "i", 2);
+    rtosc_message(msg_c, sizeof(msg_c), "/c", "");
+
+    //a at 10.5s, b at 10s, c immediately
+    uint64_t t0 = 10 * second;
+    rtosc_bundle(bundle, sizeof(bundle), t0 + second/2, 1, msg_a);
+    assert_true(s.schedule(bundle), "schedule a bundle", __LINE__);
+    rtosc_bundle(bundle, sizeof(bundle), t0, 1, msg_b);
+    s.schedule(bundle);
+    s.schedule(msg_c);
+    assert_int_eq(3, s.size(), "all messages are queued", __LINE__);
+
+    //block of 100 frames at 1 kHz, starting 50ms before b
+    unsigned offset = 99;
+    s.begin_block(t0 - second/20, 100, 1000);
+    assert_str_eq("/c", s.next(&offset), "immediate first", __LINE__);
+    assert_int_eq(0, offset, "immediate at offset 0", __LINE__);
+    assert_str_eq("/b", s.next(&offset), "then b", __LINE__);
+    assert_int_eq(50, offset, "b sample accurately", __LINE__);
+    assert_null(s.next(&offset), "a not due yet", __LINE__);
+    assert_true(s.next_timetag() == t0 + second/2, "a stays queued", __LINE__);
+
+    //late: a block after a's time
+    s.begin_block(t0 + second, 100, 1000);
+    assert_str_eq("/a", s.next(&offset), "late message", __LINE__);
+    assert_int_eq(0, offset, "late message at offset 0", __LINE__);
+    assert_null(s.next(&offset), "queue empty", __LINE__);
+    assert_int_eq(0, s.size(), "all messages released", __LINE__);
+}
+
+void ordering(void)
+{
+    BundleScheduler s(16, 64);
+    uint64_t t0 = 5 * second;
+
+    //nested bundles can not be earlier than their parents
+    rtosc_bundle(nested, sizeof(nested), t0 - second, 2, msg_b, msg_c);
+    rtosc_bundle(bundle, sizeof(bundle), t0, 2, msg_a, nested);
+    s.schedule(bundle);
+    assert_int_eq(3, s.size(), "nested bundles are split", __LINE__);
+
+    s.begin_block(t0, 64, 48000);
+    const char *order[3];
+    for(int i=0; i<3; ++i)
+        order[i] = s.next(NULL);
+    assert_str_eq("/a", order[0], "equal timetags in arrival order", __LINE__);
+    assert_non_null(order[2], "nested messages released", __LINE__);
+}
+
+void capacity(void)
+{
+    BundleScheduler s(2, 64);
+    rtosc_bundle(bundle, sizeof(bundle), 1, 3, msg_a, msg_b, msg_c);
+    assert_false(s.schedule(bundle), "full queue is reported", __LINE__);
+    assert_int_eq(1, s.dropped, "dropped messages are counted", __LINE__);
+
+    //message slots are reused
+    s.begin_block(0, 64, 48000);
+    while(s.next(NULL))
+        ;
+    assert_true(s.schedule(msg_a) && s.schedule(msg_b),
+                "slots are reused", __LINE__);
+
+    BundleScheduler small(4, 8);
+    assert_false(small.schedule(msg_a), "too long messages are dropped",
+                 __LINE__);
+}
+
+void thread_link(void)
+{
+    BundleScheduler s(16, 64);
+    ThreadLink link(128, 16);
+    rtosc_bundle(bundle, sizeof(bundle), 3 * second, 2, msg_a, msg_b);
+    link.raw_write(bundle);
+    link.write("/d", "");
+    assert_int_eq(2, s.schedule_from(link), "read from a thread link",
+                  __LINE__);
+    assert_int_eq(3, s.size(), "thread link messages queued", __LINE__);
+}
+
+int main()
+{
+    timing();
+    ordering();
+    capacity();
+    thread_link();
+    return test_summary();
+}
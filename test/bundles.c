@@ -75,5 +75,65 @@ int main()
     assert_int_eq(1, rtosc_bundle_timetag(buffer_c),
             "Verify rtosc_bundle_timetag() Works", __LINE__);
 
+    //Streaming writer
+    char stream[256];
+    rtosc_bundle_writer w;
+    assert_true(rtosc_bundle_writer_begin(&w, stream, sizeof(stream), 0),
+            "Begin A Streamed Bundle", __LINE__);
+    rtosc_bundle_append(&w, buffer_a, 0);
+    rtosc_bundle_append(&w, buffer_b, len_b);
+    assert_hex_eq(RESULT, stream, sizeof(RESULT)-1,
+            rtosc_bundle_writer_finish(&w),
+            "Verify Streamed Bundle Equals rtosc_bundle()", __LINE__);
+
+    //Build an element in place
+    rtosc_bundle_writer_restart(&w);
+    size_t avail;
+    char *slot = rtosc_bundle_append_reserve(&w, &avail);
+    rtosc_builder b;
+    rtosc_builder_begin(&b, slot, avail, "/flying-monkey", 1);
+    rtosc_builder_add_string(&b, "bannana");
+    assert_true(rtosc_bundle_append_commit(&w, rtosc_builder_finish(&b)),
+            "Commit A Message Built In Place", __LINE__);
+    rtosc_bundle_append(&w, buffer_b, len_b);
+    assert_hex_eq(RESULT, stream, sizeof(RESULT)-1,
+            rtosc_bundle_writer_finish(&w),
+            "Verify Bundle With Message Built In Place", __LINE__);
+
+    //Nested bundles
+    rtosc_bundle_writer_restart(&w);
+    rtosc_bundle_append(&w, buffer_a, 0);
+    assert_true(rtosc_bundle_open(&w, 1),
+            "Open Nested Bundle", __LINE__);
+    rtosc_bundle_append(&w, buffer_a, 0);
+    rtosc_bundle_append(&w, buffer_b, 0);
+    assert_true(rtosc_bundle_close(&w),
+            "Close Nested Bundle", __LINE__);
+    rtosc_bundle_append(&w, buffer_b, 0);
+    size_t nested_len = rtosc_bundle_writer_finish(&w);
+    rtosc_bundle(buffer_c, 256, 1, 2, buffer_a, buffer_b);
+    char expected[512];
+    size_t exp_len = rtosc_bundle(expected, sizeof(expected), 0, 3,
+                                  buffer_a, buffer_c, buffer_b);
+    assert_hex_eq(expected, stream, exp_len, nested_len,
+            "Verify Streamed Nested Bundle", __LINE__);
+    assert_false(rtosc_bundle_close(&w),
+            "No Bundle Left To Close", __LINE__);
+
+    //Full buffers are reported and left untouched
+    rtosc_bundle_writer_begin(&w, stream, 16 + 4 + len_a + 4, 0);
+    assert_true(rtosc_bundle_append(&w, buffer_a, 0),
+            "Append To A Small Bundle", __LINE__);
+    assert_false(rtosc_bundle_append(&w, buffer_b, 0),
+            "Report A Full Bundle", __LINE__);
+    assert_int_eq(16 + 4 + len_a, rtosc_bundle_writer_finish(&w),
+            "Full Bundle Keeps Its Contents", __LINE__);
+    rtosc_bundle_writer_restart(&w);
+    assert_true(rtosc_bundle_append(&w, buffer_b, 0),
+            "Append After Flushing", __LINE__);
+    assert_int_eq(1, rtosc_bundle_elements(stream,
+                                           rtosc_bundle_writer_finish(&w)),
+            "Flushed Bundle Only Has New Messages", __LINE__);
+
     return test_summary();
 }
@@ -3,6 +3,13 @@
 #include <rtosc/default-value.h>
 #include <rtosc/savefile.h>
 #include <rtosc/port-sugar.h>
+#include <rtosc/rt-checker.h>
+#include <rtosc/change-tracker.h>
+#include <rtosc/state-hash.h>
+#include <rtosc/arg-val-cmp.h>
+#include <rtosc/thread-link.h>
+#include <cstdlib>
+#include <unistd.h>
 
 #include "common.h"
 
@@ -267,6 +274,21 @@ void envelope_types()
     assert_str_eq(exp_savefile.c_str(), savefile.c_str(),
                   "save testfile", __LINE__);
 
+    std::string streamed;
+    auto append = [](const char* str, size_t len, void* data) {
+        ((std::string*)data)->append(str, len);
+        return 0;
+    };
+    assert_true(save_to_file(envelope_ports, &e2, appname.c_str(), appver,
+                             append, &streamed),
+                "save testfile to a sink", __LINE__);
+    assert_str_eq(exp_savefile.c_str(), streamed.c_str(),
+                  "save the same testfile to a sink", __LINE__);
+    assert_false(save_to_file(envelope_ports, &e2, appname.c_str(), appver,
+                              [](const char*, size_t, void*) { return 1; },
+                              NULL),
+                 "the sink can stop saving", __LINE__);
+
     Envelope e2_restored; // e2 will be loaded from the savefile
 
     int rval = load_from_file(exp_savefile.c_str(),
@@ -289,6 +311,422 @@ void envelope_types()
     check_restored(e2.array[2], e2_restored.array[2], "array[2]");
     check_restored(e2.array[3], e2_restored.array[3], "array[3]");
     check_restored(e2.env_type, e2_restored.env_type, "envelope type");
+
+    // the same, with a binary savefile
+    std::string binfile = save_to_binary_file(envelope_ports, &e2,
+                                              appname.c_str(), appver);
+    assert_true(is_binary_savefile(binfile.data(), binfile.size()),
+                "binary savefiles are recognized", __LINE__);
+    assert_false(is_binary_savefile(savefile.data(), savefile.size()),
+                 "text savefiles are no binary savefiles", __LINE__);
+
+    Envelope e2_bin_restored;
+    rval = load_from_binary_file(binfile.data(), binfile.size(),
+                                 envelope_ports, &e2_bin_restored,
+                                 appname.c_str(), appver);
+    assert_int_eq(4, rval, "load binary savefile, 4 messages read", __LINE__);
+    assert_str_eq(changed_e2,
+                  get_changed_values(envelope_ports,
+                                     &e2_bin_restored).c_str(),
+                  "restore all values from a binary savefile", __LINE__);
+
+    rval = load_from_binary_file(binfile.data(), binfile.size() - 1,
+                                 envelope_ports, &e2_bin_restored,
+                                 appname.c_str(), appver);
+    assert_true(rval < -1, "reject truncated binary savefile", __LINE__);
+    rval = load_from_binary_file(binfile.data(), binfile.size(),
+                                 envelope_ports, &e2_bin_restored,
+                                 "another-app", appver);
+    assert_int_eq(-17, rval,
+                  "reject binary file from another application", __LINE__);
+}
+
+struct Synth
+{
+    static const rtosc::Ports& ports;
+    Envelope master;
+    Envelope voice[5];
+    int volume = 100;
+};
+
+#define rObject Synth
+static const Ports synth_ports = {
+    rRecur(master, "master envelope"),
+    rRecurs(voice, 5, "voice envelopes"),
+    {"volume::i", rProp(parameter) rDefault(100), NULL,
+        [](const char* m, RtData& d) {
+            Synth* obj = static_cast<Synth*>(d.obj);
+            if(*rtosc_argument_string(m))
+                obj->volume = rtosc_argument(m, 0).i;
+            else
+                d.reply(d.loc, "i", obj->volume); }}
+};
+#undef rObject
+
+const rtosc::Ports& Synth::ports = synth_ports;
+
+void encoded_default_values()
+{
+    const rtosc_arg_val_t* args = NULL;
+    assert_int_eq(1, ports.encodedDefault(*ports.apropos("B"), &args),
+                  "pre-encoded default: nargs", __LINE__);
+    assert_char_eq('i', args[0].type, "pre-encoded default: canonicalized",
+                   __LINE__);
+    assert_int_eq(-1, args[0].val.i, "pre-encoded default: value", __LINE__);
+    assert_int_eq(-1, ports.encodedDefault(*ports.apropos("E"), &args),
+                  "no pre-encoded default without default", __LINE__);
+    assert_int_eq(-1, envelope_ports.encodedDefault(
+                      *envelope_ports.apropos("sustain"), &args),
+                  "no pre-encoded default for dependent defaults", __LINE__);
+    assert_int_eq(-1, envelope_ports.encodedDefault(*ports.apropos("A"),
+                                                    &args),
+                  "no pre-encoded default for foreign ports", __LINE__);
+
+    const Ports str_ports = {
+        {"name::s", rDefault("init"), NULL, NULL}
+    };
+    rtosc_arg_val_t av[2];
+    char strbuf[16];
+    int nargs = get_default_value("name", "s", str_ports, NULL, NULL,
+                                  -1, 2, av, strbuf, sizeof(strbuf));
+    assert_int_eq(1, nargs, "default from pre-encoded value", __LINE__);
+    assert_str_eq("init", av[0].val.s, "string from pre-encoded value",
+                  __LINE__);
+    assert_true(av[0].val.s == strbuf,
+                "pre-encoded string is copied to the caller's buffer",
+                __LINE__);
+}
+
+void cached_default_values()
+{
+    const Ports str_ports = {
+        {"name::s", rDefault("init"), NULL, NULL}
+    };
+    const Port* name_port = str_ports.apropos("name");
+
+    rtosc_arg_val_t av[4];
+    char strbuf1[32], strbuf2[32];
+    for(int i = 0; i < 2; ++i)
+    {
+        char* strbuf = i ? strbuf2 : strbuf1;
+        memset(strbuf, 0, 32);
+        int nargs = get_default_value("name", "s", str_ports, NULL, name_port,
+                                      -1, 4, av, strbuf, 32);
+        assert_int_eq(1, nargs, "cached string default: nargs", __LINE__);
+        assert_char_eq('s', av[0].type,
+                       "cached string default: type", __LINE__);
+        assert_str_eq("init", av[0].val.s,
+                      "cached string default: value", __LINE__);
+        assert_true(av[0].val.s == strbuf,
+                    "cached string default: string is in caller's buffer",
+                    __LINE__);
+    }
+
+    // presets must still be resolved on each call
+    Envelope e1, e2;
+    e2.env_type = 1;
+    const Port* attack_port = envelope_ports.apropos("attack_rate");
+    for(int i = 0; i < 2; ++i)
+    {
+        int nargs = get_default_value("attack_rate", "i", envelope_ports, &e1,
+                                      attack_port, -1, 4, av, strbuf1, 32);
+        assert_int_eq(1, nargs, "cached preset default (1)", __LINE__);
+        assert_int_eq(40, av[0].val.i, "cached preset default (2)", __LINE__);
+        nargs = get_default_value("attack_rate", "i", envelope_ports, &e2,
+                                  attack_port, -1, 4, av, strbuf1, 32);
+        assert_int_eq(1, nargs, "cached preset default (3)", __LINE__);
+        assert_int_eq(127, av[0].val.i, "cached preset default (4)", __LINE__);
+    }
+
+    // constructing ports runs refreshMagic, which invalidates the cache
+    unsigned long generation = Ports::magicGeneration();
+    const Ports other_ports = {
+        {"x::i", rDefault(1), NULL, NULL}
+    };
+    assert_true(Ports::magicGeneration() != generation,
+                "refreshMagic increases the magic generation", __LINE__);
+    int nargs = get_default_value("name", "s", str_ports, NULL, name_port,
+                                  -1, 4, av, strbuf2, 32);
+    assert_int_eq(1, nargs, "default after invalidation (1)", __LINE__);
+    assert_str_eq("init", av[0].val.s,
+                  "default after invalidation (2)", __LINE__);
+    clear_default_value_cache();
+}
+
+void parallel_changed_values()
+{
+    Synth synth;
+    synth.master.sustain = 1;
+    synth.voice[1].env_type = 1;
+    synth.voice[1].update_env_type_dependencies();
+    synth.voice[1].attack_rate = 2;
+    synth.voice[4].array[2] = 7;
+    synth.volume = 3;
+
+    std::string serial = get_changed_values(synth_ports, &synth);
+    assert_str_eq("/master/sustain 1\n"
+                  "/voice1/attack_rate 2\n/voice1/env_type 1\n"
+                  "/voice4/array [0 0 7 0]\n"
+                  "/volume 3",
+                  serial.c_str(), "changed values of subtrees", __LINE__);
+    for(unsigned threads : { 1, 2, 4 })
+    {
+        assert_str_eq(serial.c_str(),
+                      get_changed_values_parallel(synth_ports, &synth,
+                                                  threads).c_str(),
+                      "parallel changed values are the same", __LINE__);
+    }
+
+    Synth unchanged;
+    assert_str_eq("", get_changed_values_parallel(synth_ports,
+                                                  &unchanged).c_str(),
+                  "no parallel changed values if nothing changed", __LINE__);
+}
+
+struct Osc
+{
+    static const rtosc::Ports& ports;
+    int freq = 440;
+    int gain = 64;
+};
+
+#define rObject Osc
+static const Ports osc_ports = {
+    rParamI(freq, rDefault(440), "frequency"),
+    rParamI(gain, rDefault(64), "gain")
+};
+#undef rObject
+
+const rtosc::Ports& Osc::ports = osc_ports;
+
+struct Rack
+{
+    static const rtosc::Ports& ports;
+    Osc osc[3];
+    Osc lfo;
+    int tempo = 120;
+};
+
+#define rObject Rack
+static const Ports rack_ports = {
+    rRecurs(osc, 3, "oscillators"),
+    rRecur(lfo, "lfo"),
+    rParamI(tempo, rDefault(120), "tempo")
+};
+#undef rObject
+
+const rtosc::Ports& Rack::ports = rack_ports;
+
+void snapshot_values()
+{
+    Synth synth;
+    synth.master.sustain = 1;
+    synth.voice[1].env_type = 1;
+    synth.voice[1].update_env_type_dependencies();
+    synth.voice[1].attack_rate = 2;
+    synth.voice[4].array[2] = 7;
+    synth.voice[3].scale_type = 0;
+    synth.volume = 3;
+
+    values_snapshot_t snapshot(synth_ports);
+    assert_true(snapshot.capture(&synth), "capture a snapshot", __LINE__);
+    assert_true(snapshot.size() > 0, "snapshot has values", __LINE__);
+
+    // the runtime object may change after the capture
+    const std::string serial = get_changed_values(synth_ports, &synth);
+    synth.volume = 4;
+    assert_str_eq(serial.c_str(), snapshot.get_changed_values().c_str(),
+                  "changed values of a snapshot", __LINE__);
+
+    synth.volume = 3;
+    const rtosc_version appver = rtosc_version { 1, 2, 3 };
+    assert_str_eq(save_to_file(synth_ports, &synth, "synth", appver).c_str(),
+                  snapshot.save_to_file("synth", appver).c_str(),
+                  "savefile of a snapshot", __LINE__);
+    assert_true(save_to_binary_file(synth_ports, &synth, "synth", appver) ==
+                snapshot.save_to_binary_file("synth", appver),
+                "binary savefile of a snapshot", __LINE__);
+
+    values_snapshot_t small_snapshot(synth_ports, 64);
+    assert_false(small_snapshot.capture(&synth),
+                 "capture into a too small buffer", __LINE__);
+    assert_str_eq("", small_snapshot.save_to_file("synth", appver).c_str(),
+                  "incomplete snapshots are not saved", __LINE__);
+}
+
+//subtrees enabled by a toggle, whose state the walk caches
+struct Bank
+{
+    Osc osc[4];
+    bool on = true;
+};
+
+#define rObject Bank
+static const Ports bank_ports = {
+    rRecurs(osc, 4, rEnabledBy(on), "oscillators"),
+    rToggle(on, rDefault(true), "enable the oscillators")
+};
+#undef rObject
+
+struct capture_job_t
+{
+    values_snapshot_t* snapshot;
+    void* runtime;
+    bool complete;
+};
+
+void snapshot_capture_without_allocations()
+{
+    // without the interposer, allocations can not be detected
+    if(!RtChecker::interposed())
+        return;
+
+    Bank bank;
+    bank.osc[2].freq = 220;
+    values_snapshot_t snapshot(bank_ports);
+    capture_job_t job = {&snapshot, &bank, false};
+
+    // run capture() like a port callback, so the checker reports allocations
+    const Port capture_port = {"capture:", "", NULL,
+        [](const char*, RtData& d) {
+            capture_job_t* job = (capture_job_t*)d.obj;
+            job->complete = job->snapshot->capture(job->runtime);
+        }};
+    RtChecker checker;
+    RtData d;
+    d.obj = &job;
+    for(int i = 0; i < 2; ++i)
+        checker.call(capture_port, "", d);
+
+    assert_true(job.complete, "capture a snapshot with toggles", __LINE__);
+    assert_str_eq(get_changed_values(bank_ports, &bank).c_str(),
+                  snapshot.get_changed_values().c_str(),
+                  "changed values of a snapshot with toggles", __LINE__);
+    assert_int_eq(0, checker.violations(), "capture() does not allocate",
+                  __LINE__);
+}
+
+void incremental_changed_values()
+{
+    Rack rack;
+    ChangeTracker tracker(rack_ports);
+    changed_values_cache_t cache(rack_ports, tracker);
+    assert_int_eq(5, tracker.units(), "one unit per subtree and one for leaves",
+                  __LINE__);
+
+    assert_str_eq("", cache.get_changed_values(&rack).c_str(),
+                  "no cached changed values if nothing changed", __LINE__);
+
+    char loc[1024];
+    RtData d;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    d.obj = &rack;
+    d.changes = &tracker;
+    auto set = [&d](const char* path, int value) {
+        char msg[64];
+        rtosc_message(msg, sizeof(msg), path, "i", value);
+        *d.loc = 0;
+        rack_ports.dispatch(msg, d, true);
+    };
+
+    set("/osc1/freq", 220);
+    set("/tempo", 90);
+    const char* exp = "/osc1/freq 220\n/tempo 90";
+    assert_str_eq(exp, get_changed_values(rack_ports, &rack).c_str(),
+                  "serial changed values", __LINE__);
+    assert_str_eq(exp, cache.get_changed_values(&rack).c_str(),
+                  "setters mark their subtree as changed", __LINE__);
+
+    // changes which are not reported are not noticed
+    rack.lfo.gain = 1;
+    assert_str_eq(exp, cache.get_changed_values(&rack).c_str(),
+                  "unchanged subtrees are not walked again", __LINE__);
+    tracker.mark("/lfo/gain");
+    assert_str_eq("/osc1/freq 220\n/lfo/gain 1\n/tempo 90",
+                  cache.get_changed_values(&rack).c_str(),
+                  "marked subtrees are walked again", __LINE__);
+
+    set("/osc1/freq", 440);
+    assert_str_eq("/lfo/gain 1\n/tempo 90",
+                  cache.get_changed_values(&rack).c_str(),
+                  "values changed back to default are removed", __LINE__);
+
+    // a tracker for a runtime object at its defaults only walks the units
+    // changed since, which shows for changes that are not reported
+    Rack fresh;
+    ChangeTracker fresh_tracker(rack_ports, true);
+    changed_values_cache_t fresh_cache(rack_ports, fresh_tracker);
+    fresh.lfo.gain = 1;
+    fresh.osc[2].freq = 220;
+    fresh_tracker.mark("/osc2/freq");
+    assert_str_eq("/osc2/freq 220",
+                  fresh_cache.get_changed_values(&fresh).c_str(),
+                  "units at defaults are not walked", __LINE__);
+
+    fresh.osc[2] = Osc();
+    fresh_tracker.mark_defaults("/osc2/");
+    assert_str_eq("",
+                  fresh_cache.get_changed_values(&fresh).c_str(),
+                  "units reset to defaults are dropped", __LINE__);
+
+    fresh.osc[0].gain = 5;
+    fresh_tracker.mark_defaults("/osc0/");
+    fresh_tracker.mark("/osc0/gain");
+    assert_str_eq("/osc0/gain 5",
+                  fresh_cache.get_changed_values(&fresh).c_str(),
+                  "changes after a reset to defaults are walked", __LINE__);
+}
+
+void state_hashes()
+{
+    const Ports ports = {
+        { "A::i:S", rOpt(1, one) rOpt(2, two), NULL, NULL }
+    };
+    rtosc_arg_val_t sym, num;
+    sym.type = 'S';
+    sym.val.s = "two";
+    num.type = 'i';
+    num.val.i = 2;
+    const Port* p = ports.apropos("A");
+    assert_true(canonical_hash("/A", &sym, 1, *p, ports) ==
+                canonical_hash("/A", &num, 1, *p, ports),
+                "canonical hashes of a symbol and its value", __LINE__);
+
+    Rack lhs, rhs;
+    StateHash lhash(rack_ports, &lhs), rhash(rack_ports, &rhs);
+    assert_true(lhash.root() == rhash.root(), "equal trees", __LINE__);
+    assert_int_eq(0, lhash.diff(rhash).size(), "no differences", __LINE__);
+    assert_int_eq(1 + 4 + 3*2 + 2 + 1, lhash.nodes().size(),
+                  "one node per parameter and subtree", __LINE__);
+
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), "/osc1/freq", "i", 440);
+    assert_true(lhash.at("/osc1/freq") == rtosc_message_hash(msg),
+                "parameters hash like their messages", __LINE__);
+    assert_true(lhash.at("/osc1/nothing") == 0, "unknown paths", __LINE__);
+
+    rhs.osc[1].freq = 220;
+    rhs.tempo = 90;
+    rhash.build(rack_ports, &rhs);
+    assert_true(lhash.root() != rhash.root(), "changed trees", __LINE__);
+    assert_true(lhash.at("/osc1/") != rhash.at("/osc1/"),
+                "changed subtrees", __LINE__);
+    assert_true(lhash.at("/osc0/") == rhash.at("/osc0/") &&
+                lhash.at("/lfo/") == rhash.at("/lfo/"),
+                "unchanged subtrees", __LINE__);
+    std::vector<std::string> diff = lhash.diff(rhash);
+    assert_int_eq(2, diff.size(), "two changed parameters", __LINE__);
+    if(diff.size() == 2)
+    {
+        assert_str_eq("/osc1/freq", diff[0].c_str(),
+                      "changed parameter of a subtree", __LINE__);
+        assert_str_eq("/tempo", diff[1].c_str(),
+                      "changed parameter of the root", __LINE__);
+    }
+
+    assert_int_eq(3*2 + 2 + 1, lhash.diff(StateHash()).size(),
+                  "parameters only in one tree differ", __LINE__);
 }
 
 void presets()
@@ -465,7 +903,212 @@ void savefiles()
                   "no further parameter is being dispatched for v0.0.4",
                   __LINE__);
 
+    // the mapped loader must give the same results
+    auto write_tmpfile = [](const char* content) {
+        char path[] = "/tmp/rtosc-savefile-XXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        unlink(path);
+        ssize_t written = write(fd, content, strlen(content));
+        assert(written == (ssize_t)strlen(content));
+        (void)written;
+        return fd;
+    };
+    struct progress_t { int calls; size_t done[2]; };
+    auto on_progress = [](int round, size_t done, size_t total, void* data) {
+        progress_t* p = static_cast<progress_t*>(data);
+        ++p->calls;
+        p->done[round] = done;
+        return done <= total;
+    };
+
+    reset_savefile(sft);
+    int fd = write_tmpfile(MAKE_TESTFILE("v0.0.1"));
+    progress_t progress = { 0, { 0, 0 } };
+    rval = load_from_file_mapped(fd, savefile_test_ports, &sft,
+                                 "savefiletest", rtosc_version {1, 2, 3},
+                                 &my_dispatcher, on_progress, &progress);
+    close(fd);
+    assert_int_eq(2, rval, "mapped savefile: 2 messages read for v0.0.1",
+                  __LINE__);
+    assert_int_eq(42, sft.new_param, "port renaming works for mapped files",
+                  __LINE__);
+    assert_true(sft.very_old_version,
+                "additional messages work for mapped files", __LINE__);
+    assert_int_eq(123, sft.further_param,
+                  "further parameter is being dispatched from mapped files",
+                  __LINE__);
+    // first message and end of each round
+    assert_int_eq(4, progress.calls, "mapped savefile: progress calls",
+                  __LINE__);
+    assert_int_eq(strlen(MAKE_TESTFILE("v0.0.1")), progress.done[1],
+                  "mapped savefile: progress reaches the end", __LINE__);
+
+    fd = write_tmpfile(MAKE_TESTFILE("v0.0.3"));
+    rval = load_from_file_mapped(fd, savefile_test_ports, &sft,
+                                 "savefiletest", rtosc_version {1, 2, 3},
+                                 &my_dispatcher);
+    close(fd);
+    assert_int_eq(-59, rval, "mapped savefile: 1 error for v0.0.3", __LINE__);
+
+    assert_int_eq(-1, load_from_file_mapped("/nonexistent/savefile",
+                                            savefile_test_ports, &sft,
+                                            "savefiletest",
+                                            rtosc_version {1, 2, 3}),
+                  "mapped savefile: missing file", __LINE__);
+
+    // messages can be passed to a ThreadLink instead of being dispatched
+    {
+        ThreadLink link(128, 16);
+        savefile_link_dispatcher_t link_dispatcher(link);
+        reset_savefile(sft);
+        fd = write_tmpfile(MAKE_TESTFILE("v0.0.5"));
+        rval = load_from_file_mapped(fd, savefile_test_ports, &sft,
+                                     "savefiletest", rtosc_version {1, 2, 3},
+                                     &link_dispatcher);
+        close(fd);
+        assert_int_eq(2, rval, "link savefile: 2 messages read", __LINE__);
+        assert_int_eq(0, sft.further_param,
+                      "link savefile: messages are not dispatched", __LINE__);
+        int further = 0;
+        std::string paths;
+        while(link.hasNext())
+        {
+            const char* msg = link.read();
+            paths += msg;
+            paths += ' ';
+            if(!strcmp(msg, "/further_param"))
+                further = rtosc_argument(msg, 0).i;
+        }
+        // no port is known for "/old_param", so it is sent in both rounds
+        assert_str_eq("/old_param /further_param /old_param ", paths.c_str(),
+                      "link savefile: messages are in the link", __LINE__);
+        assert_int_eq(123, further, "link savefile: message args", __LINE__);
+    }
+
 #undef MAKE_TESTFILE
+
+    // the dispatcher works the same way for binary savefiles
+    auto make_binary_testfile = [](unsigned char rtosc_revision) {
+        std::string file = "RTOSCBIN";
+        const char versions[8] = { 0, 0, (char)rtosc_revision, 0, 1, 2, 3, 0 };
+        file.append(versions, 8);
+        file.append("savefiletest\0\0\0\0", 16);
+        char msg[32];
+        auto append_msg = [&file](const char* msg, std::size_t len) {
+            const char size[4] = { 0, 0, 0, (char)len };
+            file.append(size, 4);
+            file.append(msg, len);
+        };
+        append_msg(msg, rtosc_message(msg, 32, "/old_param", ""));
+        append_msg(msg, rtosc_message(msg, 32, "/further_param", "i", 123));
+        return file;
+    };
+
+    reset_savefile(sft);
+    std::string binfile = make_binary_testfile(1);
+    rval = load_from_binary_file(binfile.data(), binfile.size(),
+                                 savefile_test_ports, &sft,
+                                 "savefiletest", rtosc_version {1, 2, 3},
+                                 &my_dispatcher);
+    assert_int_eq(2, rval, "binary savefile: 2 messages read for v0.0.1",
+                  __LINE__);
+    assert_int_eq(42, sft.new_param, "port renaming works for binary files",
+                  __LINE__);
+    assert_true(sft.very_old_version,
+                "additional messages work for binary files", __LINE__);
+    assert_int_eq(123, sft.further_param,
+                  "further parameter is being dispatched from binary files",
+                  __LINE__);
+
+    reset_savefile(sft);
+    binfile = make_binary_testfile(3);
+    rval = load_from_binary_file(binfile.data(), binfile.size(),
+                                 savefile_test_ports, &sft,
+                                 "savefiletest", rtosc_version {1, 2, 3},
+                                 &my_dispatcher);
+    assert_int_eq(-33, rval, "binary savefile: 1 error for v0.0.3", __LINE__);
+}
+
+//! counts the calls of the hooks, and skips them for current files
+struct fast_dispatcher_t : public rtosc::savefile_dispatcher_t
+{
+    //! @param mode 1 for direct_dispatch, 2 for batch_dispatch
+    explicit fast_dispatcher_t(int mode) : mode((fast_path_t)mode) {}
+    fast_path_t fast_path(void) const override { return mode; }
+    int on_dispatch(size_t, char*, size_t, size_t nargs, rtosc_arg_val_t*,
+                    bool round2, dependency_t dependency) override
+    {
+        ++hooks;
+        return default_response(nargs, round2, dependency);
+    }
+    fast_path_t mode;
+    int hooks = 0;
+};
+
+void savefile_fast_path()
+{
+    const rtosc_version cur = rtosc_current_version();
+    char header[128];
+    snprintf(header, sizeof(header),
+             "%% RT OSC v%d.%d.%d savefile\n%% savefiletest v1.2.3\n",
+             cur.major, cur.minor, cur.revision);
+    const std::string file = std::string(header) +
+                             "/new_param 7\n/further_param 123\n";
+    SavefileTest sft = SavefileTest();
+
+    for(int mode = 1; mode <= 2; ++mode)
+    {
+        fast_dispatcher_t dispatcher(mode);
+        sft = SavefileTest();
+        int rval = load_from_file(file.c_str(), savefile_test_ports, &sft,
+                                  "savefiletest", rtosc_version {1, 2, 3},
+                                  &dispatcher);
+        assert_int_eq(2, rval, "fast path: all messages read", __LINE__);
+        assert_int_eq(0, dispatcher.hooks, "fast path: no hooks for files "
+                      "of the current version", __LINE__);
+        assert_true(sft.new_param == 7 && sft.further_param == 123,
+                    "fast path: values are dispatched", __LINE__);
+
+        sft = SavefileTest();
+        rval = load_from_file(file.c_str(), savefile_test_ports, &sft,
+                              "savefiletest", rtosc_version {1, 2, 4},
+                              &dispatcher);
+        assert_int_eq(4, dispatcher.hooks, "fast path: hooks for files of "
+                      "older app versions, in both rounds", __LINE__);
+        assert_int_eq(123, sft.further_param,
+                      "fast path: older files are dispatched", __LINE__);
+
+        dispatcher.hooks = 0;
+        rval = load_from_file((file + "/unknown 1\n").c_str(),
+                              savefile_test_ports, &sft, "savefiletest",
+                              rtosc_version {1, 2, 3}, &dispatcher);
+        assert_true(rval < 0, "fast path: unknown ports abort loading",
+                    __LINE__);
+    }
+
+    std::string binfile = "RTOSCBIN";
+    const char versions[8] = { (char)cur.major, (char)cur.minor,
+                               (char)cur.revision, 0, 1, 2, 3, 0 };
+    binfile.append(versions, 8);
+    binfile.append("savefiletest\0\0\0\0", 16);
+    char msg[32];
+    const char size[4] = { 0, 0, 0,
+        (char)rtosc_message(msg, 32, "/further_param", "i", 321) };
+    binfile.append(size, 4);
+    binfile.append(msg, size[3]);
+
+    fast_dispatcher_t dispatcher(2);
+    sft = SavefileTest();
+    int rval = load_from_binary_file(binfile.data(), binfile.size(),
+                                     savefile_test_ports, &sft,
+                                     "savefiletest", rtosc_version {1, 2, 3},
+                                     &dispatcher);
+    assert_int_eq(1, rval, "fast path: binary message read", __LINE__);
+    assert_int_eq(0, dispatcher.hooks, "fast path: no hooks for binary files",
+                  __LINE__);
+    assert_int_eq(321, sft.further_param,
+                  "fast path: binary messages are dispatched", __LINE__);
 }
 
 int main()
@@ -475,8 +1118,16 @@ int main()
     canonical_values();
     simple_default_values();
     envelope_types();
+    encoded_default_values();
+    cached_default_values();
+    parallel_changed_values();
+    snapshot_values();
+    snapshot_capture_without_allocations();
+    incremental_changed_values();
+    state_hashes();
     presets();
     savefiles();
+    savefile_fast_path();
 
     return test_summary();
 }
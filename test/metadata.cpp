@@ -1,6 +1,8 @@
 #include <rtosc/rtosc.h>
 #include <rtosc/ports.h>
+#include <rtosc/string-pool.h>
 #include <cassert>
+#include <cstring>
 
 using namespace rtosc;
 
@@ -20,9 +22,79 @@ Ports ports = {
     {"porte", MAP(name, porte)
               MAP(min, 12)
               MAP(max, 23)
-              MAP(Hello, "WOrld"), 0, dummy}
+              MAP(Hello, "WOrld"), 0, dummy},
+    {"portf", ":parameter\0:max\0=1\0:max\0=2\0:enabled by\0=porta\0",
+              0, dummy}
 };
 
+//! the indexed lookups must equal the linear ones
+void indexed_lookups()
+{
+    for(const auto &port : ports) {
+        const Port::MetaContainer linear = port.meta();
+        const Port::MetaContainer indexed = ports.meta(port);
+        assert(indexed.index);
+        assert(!linear.index);
+        for(int k = 0; k < Port::meta_key_count; ++k) {
+            const Port::meta_key_t key = (Port::meta_key_t)k;
+            const char *name = Port::meta_key_names[k];
+            assert(indexed[key] == linear[name]);
+            assert(indexed[name] == linear[name]);
+            assert(linear[key] == linear[name]);
+            assert((indexed.find(key) == indexed.end()) ==
+                   (linear.find(name) == linear.end()));
+        }
+    }
+    const Port &portf = ports.ports.back();
+    assert(!strcmp(ports.meta(portf)[Port::meta_max], "1"));
+    assert(ports.meta(portf)[Port::meta_parameter] == NULL);
+    assert(ports.meta(portf).find(Port::meta_parameter) !=
+           ports.meta(portf).end());
+    assert(!strcmp(ports.meta(portf)[Port::meta_enabled_by], "porta"));
+    // ports of other Ports are looked up linearly
+    const Ports other = {{"x", ":min\0=1\0", 0, dummy}};
+    assert(!ports.meta(other.ports[0]).index);
+    assert(!strcmp(ports.meta(other.ports[0])[Port::meta_min], "1"));
+}
+
+void string_pool()
+{
+    assert(StringPool::metadata_size("") == 1);
+    assert(StringPool::metadata_size(":min\0=23\0") == 10);
+    assert(StringPool::metadata_size(NULL) == 0);
+
+    // generated names and metadata
+    const char literal[] = MAP(min, 0) MAP(max, 127);
+    std::string meta1 = std::string(literal, sizeof(literal));
+    std::string meta2 = meta1;
+    char name1[] = "volume::f", name2[] = "volume::f";
+
+    StringPool pool;
+    const char *m1 = pool.intern_metadata(meta1.data());
+    const char *m2 = pool.intern_metadata(meta2.data());
+    const char *n1 = pool.intern_name(name1);
+    const char *n2 = pool.intern_name(name2);
+    assert(m1 == m2 && m1 != meta1.data());
+    assert(n1 == n2 && !strcmp(n1, "volume::f"));
+    assert(!strcmp(Port::MetaContainer(m1)["max"], "127"));
+    assert(pool.intern_metadata(NULL) == NULL);
+    assert(pool.stats().strings == 4);
+    assert(pool.stats().distinct == 2);
+    assert(pool.stats().saved() == sizeof(literal) + 10);
+
+    // "a" and "b" have equal metadata, "ports" is only counted once
+    const Ports tree = {
+        {"a", MAP(min, 0), 0, dummy},
+        {"b", MAP(min, 0), 0, dummy},
+        {"sub/", NULL, &ports, dummy},
+        {"sub2/", NULL, &ports, dummy},
+    };
+    const StringPool::stats_t stats = StringPool::measure(tree);
+    // two ports of each table have no metadata
+    assert(stats.strings == (4 + 2) + (ports.size() * 2 - 2));
+    assert(stats.saved() == StringPool::metadata_size(MAP(min, 0)));
+}
+
 int main()
 {
     for(const auto &port : ports) {
@@ -30,4 +102,6 @@ int main()
             printf("%s:'%s' => '%s'\n", port.name, desc.title, desc.value);
         assert(port.meta().length() < 100);
     }
+    indexed_lookups();
+    string_pool();
 }
@@ -0,0 +1,116 @@
+#include <rtosc/rtosc.h>
+#include <string.h>
+#include "common.h"
+
+char buffer[4096];
+
+//compare every argument of the view against rtosc_argument
+static int view_matches_argument(const char *msg)
+{
+    rtosc_msg_view view;
+    unsigned n = rtosc_msg_view_init(&view, msg);
+    if(n != rtosc_narguments(msg) || n != view.nargs)
+        return 0;
+    for(unsigned i = 0; i < n; ++i) {
+        char type = rtosc_msg_view_type(&view, i);
+        if(type != rtosc_type(msg, i))
+            return 0;
+        rtosc_arg_t a = rtosc_msg_view_argument(&view, i);
+        rtosc_arg_t b = rtosc_argument(msg, i);
+        switch(type) {
+            case 's': case 'S':
+                if(a.s != b.s) return 0;
+                break;
+            case 'b':
+                if(a.b.len != b.b.len || a.b.data != b.b.data) return 0;
+                break;
+            case 'h': case 't': case 'd':
+                if(a.h != b.h) return 0;
+                break;
+            case 'T': case 'F':
+                if(a.T != b.T) return 0;
+                break;
+            case 'N': case 'I':
+                break;
+            default:
+                if(a.i != b.i) return 0;
+        }
+    }
+    return 1;
+}
+
+void all_types(void)
+{
+    uint8_t midi[4] = {0x12, 0x23, 0x34, 0x45};
+    rtosc_message(buffer, sizeof(buffer), "/dest", "ifsbhtdScrmTFNI",
+                  42, 0.25f, "string", 3, "str", (int64_t)-125,
+                  (uint64_t)22412, 0.125, "Symbol", 25, 0x12345678, midi);
+
+    rtosc_msg_view view;
+    assert_int_eq(15, rtosc_msg_view_init(&view, buffer),
+                  "view counts all arguments", __LINE__);
+    assert_char_eq('b', rtosc_msg_view_type(&view, 3),
+                   "view stores the types", __LINE__);
+    assert_str_eq("Symbol", rtosc_msg_view_argument(&view, 7).s,
+                  "view finds arguments behind blobs", __LINE__);
+    assert_true(view_matches_argument(buffer),
+                "view equals rtosc_argument for all types", __LINE__);
+}
+
+void arrays(void)
+{
+    rtosc_message(buffer, sizeof(buffer), "/dest", "[is]s[f]",
+                  1, "one", "two", 3.0f);
+
+    rtosc_msg_view view;
+    assert_int_eq(4, rtosc_msg_view_init(&view, buffer),
+                  "view skips array delimiters", __LINE__);
+    assert_str_eq("two", rtosc_msg_view_argument(&view, 2).s,
+                  "view reads arguments between arrays", __LINE__);
+    assert_flt_eq(3.0f, rtosc_msg_view_argument(&view, 3).f,
+                  "view reads arguments inside arrays", __LINE__);
+    assert_true(view_matches_argument(buffer),
+                "view equals rtosc_argument for arrays", __LINE__);
+}
+
+void many_arguments(void)
+{
+    enum { nargs = RTOSC_MSG_VIEW_MAX_ARGS + 10 };
+    rtosc_arg_t args[nargs];
+    char types[nargs + 1];
+    for(int i = 0; i < nargs; ++i) {
+        types[i] = i % 3 ? 'i' : 's';
+        if(i % 3)
+            args[i].i = i;
+        else
+            args[i].s = "str";
+    }
+    types[nargs] = 0;
+    rtosc_amessage(buffer, sizeof(buffer), "/many", types, args);
+
+    rtosc_msg_view view;
+    assert_int_eq(nargs, rtosc_msg_view_init(&view, buffer),
+                  "view counts arguments beyond its capacity", __LINE__);
+    assert_int_eq(nargs - 1,
+                  rtosc_msg_view_argument(&view, nargs - 1).i,
+                  "view falls back beyond its capacity", __LINE__);
+    assert_true(view_matches_argument(buffer),
+                "view equals rtosc_argument for long messages", __LINE__);
+}
+
+void no_arguments(void)
+{
+    rtosc_message(buffer, sizeof(buffer), "/empty", "");
+    rtosc_msg_view view;
+    assert_int_eq(0, rtosc_msg_view_init(&view, buffer),
+                  "view of a message without arguments", __LINE__);
+}
+
+int main()
+{
+    all_types();
+    arrays();
+    many_arguments();
+    no_arguments();
+    return test_summary();
+}
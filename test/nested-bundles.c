@@ -1,5 +1,6 @@
 #include "common.h"
 #include <stdlib.h>
+#include <string.h>
 #include <rtosc/rtosc.h>
 
 char buffer_a[256];
@@ -43,6 +44,14 @@ const int Lb = sizeof(MSG_B)-1;
 const int Lc = sizeof(BUNDLE_C)-1;
 const int Ld = sizeof(BUNDLE_D)-1;
 
+int messages_a = 0;
+void count_message(const char *msg, size_t len, void *data)
+{
+    (void)data;
+    if(len == (size_t)La && !memcmp(msg, MSG_A, La))
+        ++messages_a;
+}
+
 int main()
 {
     //Message 1
@@ -88,5 +97,36 @@ int main()
     assert_int_eq(0, rtosc_message_length(buffer_d, len-1),
             "Verify Bad Message Is Detected With Truncation", __LINE__);
 
+    //Iterate and index the elements in one pass
+    size_t elm_len;
+    rtosc_bundle_itr_t itr = rtosc_bundle_itr_begin(buffer_d, len);
+    assert_ptr_eq(buffer_d+20, rtosc_bundle_itr_next(&itr, &elm_len),
+            "Iterate Bundle 2's First Subelement", __LINE__);
+    assert_int_eq(Lc, elm_len,
+            "Verify Bundle 2's First Subelement Length", __LINE__);
+    rtosc_bundle_itr_next(&itr, NULL);
+    assert_ptr_eq(rtosc_bundle_fetch(buffer_d, 2),
+            rtosc_bundle_itr_next(&itr, &elm_len),
+            "Iterate Bundle 2's Last Subelement", __LINE__);
+    assert_true(rtosc_bundle_itr_end(itr),
+            "Verify Iteration Ends After The Last Subelement", __LINE__);
+
+    const char *elms[3];
+    size_t      lens[3];
+    assert_int_eq(3, rtosc_bundle_index(buffer_d, len, elms, lens, 3),
+            "Index Bundle 2", __LINE__);
+    assert_ptr_eq(rtosc_bundle_fetch(buffer_d, 1), elms[1],
+            "Verify Bundle 2's Index", __LINE__);
+    assert_int_eq(rtosc_bundle_size(buffer_d, 2), lens[2],
+            "Verify Bundle 2's Indexed Lengths", __LINE__);
+    assert_int_eq(2, rtosc_bundle_index(buffer_d, len-1, NULL, NULL, 0),
+            "Index Bundles With Truncated Length", __LINE__);
+
+    //Walk nested bundles without copying
+    assert_int_eq(5, rtosc_bundle_walk(buffer_d, len, count_message, NULL),
+            "Walk All Messages Of Nested Bundles", __LINE__);
+    assert_int_eq(4, messages_a,
+            "Walk Finds All Messages Inside Nested Bundles", __LINE__);
+
     return test_summary();
 }
@@ -0,0 +1,126 @@
+#include <rtosc/osc-doc.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <sstream>
+#include <string>
+#include "common.h"
+
+using namespace rtosc;
+
+static void cb(const char *, RtData &) {}
+
+static Ports osc = {
+    {"freq::f", rProp(parameter) rDoc("frequency") rMap(min, 20) rMap(max, 2e4),
+        0, cb},
+    {"reset:", rDoc("restart the oscillator"), 0, cb},
+};
+static Ports voice = {
+    {"osc/", rDoc("oscillator"), &osc, cb},
+    {"gain::f", rProp(parameter) rDoc("loudness"), 0, cb},
+    {"mute::T:F", rProp(parameter) rDoc("silence"), 0, cb},
+};
+static Ports root = {
+    {"voice#4/", rDoc("voices"), &voice, cb},
+    {"extra/", rDoc("extra oscillator"), &osc, cb},
+    {"panic:", rDoc("stop all voices"), 0, cb},
+};
+
+static OscDocFormatter formatter{&root, "test", "urn:test", "here",
+                                 "first", "last"};
+
+static std::string reference(void)
+{
+    std::ostringstream o;
+    o << formatter;
+    return o.str();
+}
+
+static int append(const char *str, size_t len, void *data)
+{
+    ((std::string*)data)->append(str, len);
+    return 0;
+}
+
+//sink which stops printing after the first chunk
+struct limited_t
+{
+    std::string str;
+    unsigned chunks;
+};
+static int stop_early(const char *str, size_t len, void *data)
+{
+    limited_t &l = *(limited_t*)data;
+    l.str.append(str, len);
+    return ++l.chunks > 1;
+}
+
+static void streamed(void)
+{
+    std::string out;
+    assert_true(write_osc_doc(formatter, append, &out),
+                "Streaming finishes", __LINE__);
+    assert_str_eq(reference().c_str(), out.c_str(),
+                  "Streamed output equals operator<<", __LINE__);
+    assert_true(out.find("/voice[0,3]/osc/freq") != std::string::npos,
+                "Arrays are documented once", __LINE__);
+
+    // a large tree does not fit into one chunk
+    Ports many = {{"extra/", rDoc("extra oscillator"), &osc, cb}};
+    for(int i = 0; i < 63; ++i)
+        many.ports.push_back(Port{"extra/", rDoc("extra oscillator"), &osc,
+                                  cb});
+    OscDocFormatter large{&many, "test", "", "", "", ""};
+    limited_t l{"", 0};
+    assert_false(write_osc_doc(large, stop_early, &l),
+                 "Walk stops when the sink stops", __LINE__);
+    assert_int_eq(2, l.chunks, "No chunks are passed after stopping",
+                  __LINE__);
+    assert_true(l.str.find("</osc_unit>") == std::string::npos,
+                "Stopped output is incomplete", __LINE__);
+}
+
+static void cached(void)
+{
+    OscDocCache cache(formatter);
+    assert_int_eq(4, cache.update(),
+                  "First update formats root, voice and both osc", __LINE__);
+    assert_str_eq(reference().c_str(), cache.str().c_str(),
+                  "Cached output equals operator<<", __LINE__);
+    assert_int_eq(0, cache.update(), "Unchanged tree is not formatted",
+                  __LINE__);
+    assert_str_eq(reference().c_str(), cache.str().c_str(),
+                  "Output is kept", __LINE__);
+
+    std::string out;
+    assert_true(cache.write(append, &out), "Cache writes to sinks", __LINE__);
+    assert_str_eq(cache.str().c_str(), out.c_str(), "Sink gets the output",
+                  __LINE__);
+
+    cache.invalidate("/voice[0,3]/gain");
+    assert_int_eq(1, cache.update(), "Invalidated leaf formats its parent",
+                  __LINE__);
+    cache.invalidate("/voice[0,3]/");
+    assert_int_eq(2, cache.update(), "Invalidated subtree is formatted",
+                  __LINE__);
+
+    // changed metadata on the non-realtime side
+    const char *old = voice.ports[1].metadata;
+    voice.ports[1].metadata = rProp(parameter) rDoc("volume");
+    assert_int_eq(1, cache.update(), "Changed ports are formatted",
+                  __LINE__);
+    assert_true(cache.str().find("Set Value of volume") != std::string::npos,
+                "Cache shows changed metadata", __LINE__);
+    assert_str_eq(reference().c_str(), cache.str().c_str(),
+                  "Changed output equals operator<<", __LINE__);
+    voice.ports[1].metadata = old;
+    cache.update();
+    assert_str_eq(reference().c_str(), cache.str().c_str(),
+                  "Restored output equals operator<<", __LINE__);
+}
+
+int main()
+{
+    streamed();
+    cached();
+    return test_summary();
+}
@@ -0,0 +1,118 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/parallel-dispatch.h>
+#include <cctype>
+#include <cstdlib>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+enum { nparts = 8, nmsgs = 2000 };
+
+//only written by the worker dispatching the part's subtree
+struct part_t
+{
+    std::vector<int>     values;
+    std::vector<RtData*> workers;
+} parts[nparts];
+
+std::vector<int> master_values;
+
+Ports part_ports = {
+    {"value::i", "", 0, [](const char *m, RtData &d) {
+        part_t &p = *(part_t*)d.obj;
+        p.values.push_back(rtosc_argument(m, 0).i);
+        p.workers.push_back(&d);
+    }},
+};
+
+Ports root_ports = {
+    {"part#8/", "", &part_ports, [](const char *m, RtData &d) {
+        const char *idx = m;
+        while(!isdigit(*idx))
+            ++idx;
+        d.obj = &parts[atoi(idx)];
+        while(*m && *m != '/')
+            ++m;
+        part_ports.dispatch(m+1, d);
+    }},
+    {"value::i", "", 0, [](const char *m, RtData &) {
+        master_values.push_back(rtosc_argument(m, 0).i); }},
+};
+
+void test_dispatch(unsigned threads)
+{
+    for(part_t &p : parts)
+        p = part_t{};
+    master_values.clear();
+
+    //uneven partitions, part0 receives most of the messages
+    std::vector<std::vector<char>> buffers(nmsgs, std::vector<char>(64));
+    std::vector<const char*> msgs(nmsgs);
+    int expected[nparts] = {0};
+    int master = 0;
+    for(int i=0; i<nmsgs; ++i) {
+        const int part = (i % 3) ? 0 : (i/3) % (nparts + 1);
+        if(part == nparts) {
+            rtosc_message(buffers[i].data(), 64, "/value", "i", i);
+            ++master;
+        } else {
+            char path[32];
+            snprintf(path, sizeof(path), "/part%d/value", part);
+            rtosc_message(buffers[i].data(), 64, path, "i", i);
+            ++expected[part];
+        }
+        msgs[i] = buffers[i].data();
+    }
+
+    ParallelDispatcher dispatcher(threads);
+    assert_int_eq(threads, dispatcher.threads(), "Number of threads",
+                  __LINE__);
+    std::vector<RtData> data(dispatcher.threads());
+    std::vector<std::vector<char>> locs(dispatcher.threads(),
+                                        std::vector<char>(128));
+    std::vector<RtData*> ptrs;
+    for(RtData &d : data) {
+        d.loc      = locs[&d - data.data()].data();
+        d.loc_size = 128;
+        ptrs.push_back(&d);
+    }
+
+    assert_int_eq(nmsgs, dispatcher.dispatch(root_ports, msgs.data(), nmsgs,
+                                             ptrs.data()),
+                  "All messages matched", __LINE__);
+
+    bool counts = true, ordered = true, one_worker = true;
+    for(part_t &p : parts) {
+        counts &= p.values.size() == (size_t)expected[&p - parts];
+        for(size_t i=1; i<p.values.size(); ++i) {
+            ordered    &= p.values[i-1] < p.values[i];
+            one_worker &= p.workers[i-1] == p.workers[i];
+        }
+    }
+    assert_true(counts, "Each part received its messages", __LINE__);
+    assert_true(ordered, "Order within a subtree is kept", __LINE__);
+    assert_true(one_worker, "Each subtree is dispatched by one worker",
+                __LINE__);
+    assert_int_eq(master, master_values.size(),
+                  "Leaves under root are dispatched", __LINE__);
+
+    //the dispatcher can be reused
+    for(part_t &p : parts)
+        p.values.clear();
+    dispatcher.dispatch(root_ports, msgs.data(), nmsgs/2, ptrs.data());
+    size_t total = 0;
+    for(part_t &p : parts)
+        total += p.values.size();
+    assert_true(total > 0 && total < (size_t)nmsgs/2 + 1,
+                "Dispatcher can be reused", __LINE__);
+}
+
+int main()
+{
+    test_dispatch(1);
+    test_dispatch(4);
+
+    return test_summary();
+}
@@ -0,0 +1,167 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/pattern-dispatch.h>
+#include <cctype>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "common.h"
+
+using namespace rtosc;
+
+struct part_t
+{
+    int  volume;
+    int  panning;
+    bool enable;
+    std::string name;
+} parts[4];
+
+int master_volume = 0;
+
+Ports part_ports = {
+    {"Pvolume::i", "", 0, [](const char *m, RtData &d) {
+        ((part_t*)d.obj)->volume = rtosc_argument(m, 0).i; }},
+    {"Ppanning::i", "", 0, [](const char *m, RtData &d) {
+        ((part_t*)d.obj)->panning = rtosc_argument(m, 0).i; }},
+    {"enable::T:F", "", 0, [](const char *m, RtData &d) {
+        ((part_t*)d.obj)->enable = rtosc_argument(m, 0).T; }},
+    {"name::s", "", 0, [](const char *m, RtData &d) {
+        ((part_t*)d.obj)->name = rtosc_argument(m, 0).s; }},
+};
+
+Ports root_ports = {
+    {"part#4/", "", &part_ports, [](const char *m, RtData &d) {
+        const char *idx = m;
+        while(!isdigit(*idx))
+            ++idx;
+        d.obj = &parts[atoi(idx)];
+        while(*m && *m != '/')
+            ++m;
+        part_ports.dispatch(m+1, d);
+    }},
+    {"volume::i", "", 0, [](const char *m, RtData &) {
+        master_volume = rtosc_argument(m, 0).i; }},
+    {"volume::f", "", 0, [](const char *m, RtData &) {
+        master_volume = (int)rtosc_argument(m, 0).f; }},
+};
+
+int send(PatternCache *cache, const char *path, const char *args, ...)
+{
+    char buffer[256];
+    va_list va;
+    va_start(va, args);
+    rtosc_vmessage(buffer, sizeof(buffer), path, args, va);
+    va_end(va);
+
+    RtData d;
+    return dispatch_pattern(root_ports, buffer, d, cache);
+}
+
+void reset(void)
+{
+    for(part_t &p : parts)
+        p = part_t{0, 0, false, ""};
+}
+
+int volumes(void)
+{
+    int mask = 0;
+    for(int i=0; i<4; ++i)
+        mask |= (parts[i].volume == 5) << i;
+    return mask;
+}
+
+void test_compile(void)
+{
+    CompiledPattern p;
+    assert_true(p.compile("/part[0-2]*/P{vol,pan}*"), "Compile pattern",
+                __LINE__);
+    assert_int_eq(2, p.segments(), "Pattern segments", __LINE__);
+    assert_false(p.literal(0), "Pattern segment is not literal", __LINE__);
+    assert_true(p.match(0, "part1", 5), "Match set and star", __LINE__);
+    assert_true(p.match(0, "part12", 6), "Star matches more chars",
+                __LINE__);
+    assert_false(p.match(0, "part3", 5), "Set excludes chars", __LINE__);
+    assert_true(p.match(1, "Pvolume", 7), "Match options", __LINE__);
+    assert_true(p.match(1, "Ppanning", 8), "Match second option", __LINE__);
+    assert_false(p.match(1, "Pgain", 5), "Options exclude names", __LINE__);
+
+    assert_true(p.compile("/a?/[!a-c]"), "Compile negated set", __LINE__);
+    assert_true(p.match(0, "ab", 2), "Match any char", __LINE__);
+    assert_false(p.match(0, "a", 1), "Any char requires a char", __LINE__);
+    assert_true(p.match(1, "d", 1), "Match negated set", __LINE__);
+    assert_false(p.match(1, "b", 1), "Negated set excludes chars", __LINE__);
+
+    assert_false(p.compile("/part[0-3/volume"), "Reject unclosed set",
+                 __LINE__);
+    assert_false(p.compile("/part{1,2/volume"), "Reject unclosed options",
+                 __LINE__);
+}
+
+void test_dispatch(PatternCache *cache)
+{
+    reset();
+    assert_int_eq(4, send(cache, "/part*/Pvolume", "i", 5),
+                  "Star fans out to all parts", __LINE__);
+    assert_int_eq(0xf, volumes(), "All parts have been set", __LINE__);
+
+    reset();
+    assert_int_eq(2, send(cache, "/part[1-2]/Pvolume", "i", 5),
+                  "Set fans out to some parts", __LINE__);
+    assert_int_eq(0x6, volumes(), "Parts in the set have been set",
+                  __LINE__);
+
+    reset();
+    assert_int_eq(2, send(cache, "/part{0,3}/Pvolume", "i", 5),
+                  "Options fan out to some parts", __LINE__);
+    assert_int_eq(0x9, volumes(), "Parts in the options have been set",
+                  __LINE__);
+
+    reset();
+    assert_int_eq(8, send(cache, "/part?/P*", "i", 5),
+                  "Patterns on several levels", __LINE__);
+    assert_int_eq(5, parts[3].panning, "Panning has been set", __LINE__);
+
+    reset();
+    assert_int_eq(4, send(cache, "/*/enable", "T"),
+                  "Star matches enumerated ports", __LINE__);
+    assert_true(parts[0].enable && parts[3].enable, "All parts enabled",
+                __LINE__);
+
+    assert_int_eq(1, send(cache, "/part2/name", "s", "two"),
+                  "Literal address is dispatched", __LINE__);
+    assert_str_eq("two", parts[2].name.c_str(), "Literal address works",
+                  __LINE__);
+
+    master_volume = 0;
+    assert_int_eq(1, send(cache, "/vol*", "f", 7.0f),
+                  "Ports with the same name are dispatched once", __LINE__);
+    assert_int_eq(7, master_volume, "Leaf under root has been set", __LINE__);
+
+    assert_int_eq(0, send(cache, "/part*/gain", "i", 5),
+                  "Missing leaf is not dispatched", __LINE__);
+    assert_int_eq(0, send(cache, "/part[4-9]/Pvolume", "i", 5),
+                  "Out of range index is not dispatched", __LINE__);
+}
+
+int main()
+{
+    test_compile();
+
+    test_dispatch(NULL);
+
+    PatternCache cache;
+    test_dispatch(&cache);
+    const CompiledPattern *p = cache.get("/part*/Pvolume");
+    assert_non_null(p, "Pattern in cache", __LINE__);
+    assert_ptr_eq(p, cache.get("/part*/Pvolume"), "Pattern is reused",
+                  __LINE__);
+    for(int i=0; i<PatternCache::size; ++i)
+        cache.get(("/other" + std::to_string(i) + "*").c_str());
+    assert_str_eq("other7*", p->pattern(),
+                  "Least recently used pattern is replaced", __LINE__);
+
+    return test_summary();
+}
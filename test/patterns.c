@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
 #include "common.h"
 
 const char paths[12][32] = {
@@ -37,6 +38,62 @@ int64_t prm(const char *path, const char *args, ...)
     return result;
 }
 
+//project via compiled patterns
+int64_t prm_compiled(const char *path, const char *args, ...)
+{
+    char buffer[256], prog[256];
+    va_list va;
+    va_start(va, args);
+    rtosc_vmessage(buffer, 256, path, args, va);
+    va_end(va);
+
+    int64_t result = 0;
+    for(int i=0; i<12; ++i) {
+        if(rtosc_pattern_compile(paths[i], prog, sizeof(prog)) > sizeof(prog))
+            return -1;
+        result |= ((bool)rtosc_pattern_match(prog, buffer, NULL)) << i;
+    }
+    return result;
+}
+
+//compare compiled patterns with rtosc_match_path() on many combinations
+void compiled_patterns(void)
+{
+    const char *patterns[] = {
+        "", "/", "a", "ab/", "ab/:", "ab::i", "ab:i:", "#3", "x#10/", "#",
+        "x#/", "*", "*/", "a*/b", "*:i", "{a,bc}/", "{a,ab}", "{}", "{,a}x",
+        "{a,b", "{a,b}#5:i", "x/{y,z}/*/", "a:b", "p#2/q#3/r", "*#4/"
+    };
+    const char *msgs[] = {
+        "", "/", "a", "ab", "ab/", "ab/c", "ab:i", "2", "3", "x9/", "x10/",
+        "xyz", "xyz/", "axb", "a/b", "bc/", "ab", "x", "ax", "b3", "b4",
+        "x/z/qq/", "x/y/", "a:b", "p1/q2/r", "p1/q3/r", "zz4/", "zz/"
+    };
+    char prog[256];
+    int mismatches = 0, tests = 0;
+    for(size_t p = 0; p < sizeof(patterns)/sizeof(patterns[0]); ++p) {
+        size_t len = rtosc_pattern_compile(patterns[p], prog, sizeof(prog));
+        assert_true(len && len <= sizeof(prog), "Compile pattern", __LINE__);
+        for(size_t m = 0; m < sizeof(msgs)/sizeof(msgs[0]); ++m) {
+            const char *end_a = NULL, *end_b = NULL;
+            const char *a = rtosc_match_path(patterns[p], msgs[m], &end_a);
+            const char *b = rtosc_pattern_match_path(prog, msgs[m], &end_b);
+            ++tests;
+            if(!a != !b || (a && (strcmp(a, b) || end_a != end_b))) {
+                printf("# mismatch: pattern \"%s\", message \"%s\"\n",
+                       patterns[p], msgs[m]);
+                ++mismatches;
+            }
+        }
+    }
+    assert_int_eq(0, mismatches, "Compiled patterns match like patterns",
+                  __LINE__);
+    assert_true(tests > 500, "Compared enough combinations", __LINE__);
+
+    assert_true(rtosc_pattern_compile("abc{d,e}#12/", prog, 4) > 4,
+                "Compilation reports the needed size", __LINE__);
+}
+
 #define rmp rtosc_match_partial
 bool rtosc_match_partial(const char *a, const char *b);
 
@@ -90,6 +147,17 @@ int main()
     assert_int_eq(0<<11,prm("flam/error",  ""),
             "MultiPath Case 3",                  __LINE__);
 
+    assert_int_eq(prm("path123/", "ff", 1.0, 2.0),
+                  prm_compiled("path123/", "ff", 1.0, 2.0),
+                  "Compiled Composite Path", __LINE__);
+    assert_int_eq(1<<9, prm_compiled("bfnpar1", "c"),
+            "Compiled Optional Arg", __LINE__);
+    assert_int_eq(1<<10,prm_compiled("zit",     ""),
+            "Compiled PseudoWild", __LINE__);
+    assert_int_eq(1<<11,prm_compiled("flam/bugs",  ""),
+            "Compiled MultiPath", __LINE__);
+    compiled_patterns();
+
 
     printf("\n# Suite 2 On Standard Based Matching Alg.\n");
     //Check the standard path matching algorithm
@@ -16,11 +16,24 @@ void usage(const char* progname)
               << std::endl
               << "or just ppppp (which means osc.udp://127.0.0.1:ppppp/)"
               << std::endl << std::endl;
-    std::cout << "Options: --timeout <time in msecs>" << std::endl;
+    std::cout << "Options: --timeout <time in msecs>" << std::endl
+              << "         --pipeline <max parameter checks at once>"
+              << std::endl
+              << "         --clients <number of parallel clients>"
+              << std::endl << std::endl;
+    std::cout << "Profiling options:" << std::endl
+              << "         --latency <queries per parameter>" << std::endl
+              << "         --slow <latency in msecs to report ports as slow>"
+              << std::endl
+              << "         --flood <messages sent at once per parameter>"
+              << std::endl
+              << "         --profile-file <file to write the profile to>"
+              << std::endl;
 }
 
 int run_port_checker(const char* url,
-                     const rtosc::port_checker_options& checker_opts)
+                     const rtosc::port_checker_options& checker_opts,
+                     const char* profile_file)
 {
     int rval = EXIT_SUCCESS;
     try {
@@ -35,6 +48,14 @@ int run_port_checker(const char* url,
         checker.print_not_affected();
         checker.print_skipped();
         checker.print_statistics();
+        if(checker_opts.latency_samples) {
+            checker.print_profile();
+            if(profile_file && !checker.write_profile(profile_file)) {
+                std::cout << "**Error**: could not write profile to \""
+                          << profile_file << "\"" << std::endl;
+                rval = EXIT_FAILURE;
+            }
+        }
     }
     catch(const rtosc::port_error& e) {
         std::cout << "**Error caught**: port \"" << e.m_port << "\": "
@@ -67,6 +88,12 @@ int main(int argc, char** argv)
         // options with single char equivalents
         { "help", 0, nullptr, 'h' },
         { "timeout", 1, nullptr, 't' },
+        { "pipeline", 1, nullptr, 'p' },
+        { "clients", 1, nullptr, 'c' },
+        { "latency", 1, nullptr, 'l' },
+        { "slow", 1, nullptr, 's' },
+        { "flood", 1, nullptr, 'f' },
+        { "profile-file", 1, nullptr, 'o' },
         { nullptr, 0, nullptr, 0 }
     };
     opterr = 0;
@@ -75,11 +102,12 @@ int main(int argc, char** argv)
     // port checker args
     rtosc::port_checker_options checker_opts;
     const char* url;
+    const char* profile_file = nullptr;
 
     // parse options
     while(1)
     {
-        opt = getopt_long(argc, argv, "ht:", opts, &option_index);
+        opt = getopt_long(argc, argv, "ht:p:c:l:s:f:o:", opts, &option_index);
         if(opt == -1)
             break;
 
@@ -94,6 +122,39 @@ int main(int argc, char** argv)
                     mk_err("Timeout must be a parameter >0");
                 }
                 break;
+            case 'p':
+                checker_opts.max_outstanding = atoi(optarg);
+                if(checker_opts.max_outstanding <= 0) {
+                    mk_err("Pipeline must be a parameter >0");
+                }
+                break;
+            case 'c':
+                checker_opts.clients = atoi(optarg);
+                if(checker_opts.clients <= 0) {
+                    mk_err("Clients must be a parameter >0");
+                }
+                break;
+            case 'l':
+                checker_opts.latency_samples = atoi(optarg);
+                if(checker_opts.latency_samples <= 0) {
+                    mk_err("Latency must be a parameter >0");
+                }
+                break;
+            case 's':
+                checker_opts.slow_msecs = atof(optarg);
+                if(checker_opts.slow_msecs <= 0) {
+                    mk_err("Slow must be a parameter >0");
+                }
+                break;
+            case 'f':
+                checker_opts.flood_count = atoi(optarg);
+                if(checker_opts.flood_count <= 0) {
+                    mk_err("Flood must be a parameter >0");
+                }
+                break;
+            case 'o':
+                profile_file = optarg;
+                break;
             case '?':
                 mk_err("Bad option or parameter (use --help)");
         }
@@ -110,7 +171,13 @@ int main(int argc, char** argv)
         if(errmsg) std::cerr << "ERROR: " << errmsg << std::endl << std::endl;
         usage(*argv);
     }
-    else rval = run_port_checker(url, checker_opts);
+    else
+    {
+        if((profile_file || checker_opts.flood_count) &&
+           !checker_opts.latency_samples)
+            checker_opts.latency_samples = 1;
+        rval = run_port_checker(url, checker_opts, profile_file);
+    }
 
     return rval;
 }
@@ -64,6 +64,51 @@ void usage(const char* progname)
               << std::endl;
 }
 
+void check(const char* url, const rtosc::port_checker_options& opts,
+           const char* mode)
+{
+    std::cout << "# Checking " << mode << std::endl;
+
+    rtosc::port_checker checker(opts);
+    checker(url);
+
+    assert_true(checker.sanity_checks(), "Port checker sanity", __LINE__);
+    // we keep it clean, but if you ever need help:
+    // checker.print_evaluation();
+    assert_true(checker.coverage(), "All issues have test ports", __LINE__);
+
+    std::multimap<issue, std::string> exp = get_exp(); // see above
+    const std::multimap<issue, std::string>& res = checker.issues();
+
+    assert_int_eq(exp.size(), res.size(),
+                  "Expected number of issues is correct", __LINE__);
+    //for(auto pr : exp) { std::cerr << "exp: " << (int)pr.first << "   " <<  pr.second << std::endl; }
+    //for(auto pr : res) { std::cerr << "res: " << (int)pr.first << "   " << pr.second << std::endl; }
+    assert_true(exp == res,
+                "Issues are as expected", __LINE__);
+
+    std::set<std::string> exp_skipped;
+    exp_skipped.insert("/invisible_param::i");
+    assert_true(exp_skipped == checker.skipped(), "Skipped port are as"
+                                                  "expected", __LINE__);
+
+    if(opts.latency_samples)
+    {
+        const std::vector<rtosc::port_profile_t>& prof = checker.profile();
+        bool sorted = true, percentiles_ok = true, flooded = false;
+        for(std::size_t i = 0; i < prof.size(); ++i)
+        {
+            sorted = sorted && (!i || prof[i-1].port <= prof[i].port);
+            percentiles_ok = percentiles_ok && prof[i].p50 <= prof[i].p99;
+            flooded = flooded || prof[i].flood_replied;
+        }
+        assert_true(!prof.empty(), "Parameters have been profiled", __LINE__);
+        assert_true(sorted, "Profile is sorted by port", __LINE__);
+        assert_true(percentiles_ok, "Latency p50 <= p99", __LINE__);
+        assert_true(flooded, "Flooded parameters replied", __LINE__);
+    }
+}
+
 int main(int argc, char** argv)
 {
     if(argc < 2 || !strcmp(argv[1], "--help") || !strcmp(argv[1], "-h")) {
@@ -74,28 +119,16 @@ int main(int argc, char** argv)
     bool exceptions_thrown = false;
 
     try {
-        rtosc::port_checker checker;
-        checker(argv[1]);
-
-        assert_true(checker.sanity_checks(), "Port checker sanity", __LINE__);
-        // we keep it clean, but if you ever need help:
-        // checker.print_evaluation();
-        assert_true(checker.coverage(), "All issues have test ports", __LINE__);
-
-        std::multimap<issue, std::string> exp = get_exp(); // see above
-        const std::multimap<issue, std::string>& res = checker.issues();
-
-        assert_int_eq(exp.size(), res.size(),
-                      "Expected number of issues is correct", __LINE__);
-        //for(auto pr : exp) { std::cerr << "exp: " << (int)pr.first << "   " <<  pr.second << std::endl; }
-        //for(auto pr : res) { std::cerr << "res: " << (int)pr.first << "   " << pr.second << std::endl; }
-        assert_true(exp == res,
-                    "Issues are as expected", __LINE__);
-
-        std::set<std::string> exp_skipped;
-        exp_skipped.insert("/invisible_param::i");
-        assert_true(exp_skipped == checker.skipped(), "Skipped port are as"
-                                                      "expected", __LINE__);
+        rtosc::port_checker_options seq_opts;
+        seq_opts.latency_samples = 3;
+        seq_opts.flood_count = 8;
+        check(argv[1], seq_opts, "sequentially, with profiling");
+
+        // many outstanding replies, and the tree split across clients
+        rtosc::port_checker_options opts;
+        opts.max_outstanding = 16;
+        opts.clients = 3;
+        check(argv[1], opts, "pipelined and in parallel");
     }
     catch(const std::exception& e) {
         // std::cout << "**Error caught**: " << e.what() << std::endl;
@@ -106,4 +139,3 @@ int main(int argc, char** argv)
 
     return test_summary();
 }
-
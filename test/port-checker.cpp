@@ -7,6 +7,11 @@
 #include <ctime>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <thread>
 
 #include <rtosc/ports.h>
 #include <rtosc/pretty-format.h>
@@ -122,42 +127,97 @@ int handle_st(const char *path, const char *types, lo_arg **argv,
     return 0;
 }
 
+//! Serialize a received message, letting @p args point into @p buffer
+static void store_msg(const char *path, const char *types, int argc,
+                      lo_message msg, std::vector<char>* buffer,
+                      std::vector<rtosc_arg_val_t>* args)
+{
+    size_t len = lo_message_length(msg, path);
+    *buffer = std::vector<char>(len);
+    size_t written;
+    lo_message_serialise(msg, path, buffer->data(), &written);
+    if(written > buffer->size()) // ouch...
+        throw std::runtime_error("can not happen, "
+                                 "lo_message_length has been used");
+
+    args->resize(argc);
+    for(int i = 0; i < argc; ++i)
+    {
+        (*args)[i].val = rtosc_argument(buffer->data(), i);
+        (*args)[i].type = types[i];
+    }
+}
+
 void port_checker::server::on_recv(const char *path, const char *types,
                                    lo_arg **argv, int argc, lo_message msg)
 {
     (void)argv;
+    _last_recv = std::chrono::steady_clock::now();
 //  std::cout << "on_recv: " << path << ", " << waiting << std::endl;
 //  for(const char** exp_path = exp_paths; *exp_path;
 //      ++exp_path, ++_replied_path)
 //      std::cout << " - exp: " << *exp_path << std::endl;
-    if(waiting && exp_paths[0])
+    if(!replies.empty())
+    {
+        auto itr = replies.find(path);
+        // only the first reply counts, later ones are e.g. broadcasts
+        if(itr != replies.end() && !itr->second)
+        {
+            itr->second.reset(new reply_t);
+            store_msg(path, types, argc, msg,
+                      &itr->second->buffer, &itr->second->args);
+        }
+    }
+    else if(waiting && exp_paths[0])
     {
         _replied_path = 0;
         for(const char** exp_path = exp_paths; *exp_path;
             ++exp_path, ++_replied_path)
         if(!strcmp(*exp_path, path))
         {
-            size_t len = lo_message_length(msg, path);
-            *last_buffer = std::vector<char>(len);
-            size_t written;
-            lo_message_serialise(msg, path, last_buffer->data(), &written);
-            if(written > last_buffer->size()) // ouch...
-                throw std::runtime_error("can not happen, "
-                                         "lo_message_length has been used");
-
-            last_args->resize(argc);
-            for(int i = 0; i < argc; ++i)
-            {
-                (*last_args)[i].val = rtosc_argument(last_buffer->data(), i);
-                (*last_args)[i].type = types[i];
-            }
-
+            store_msg(path, types, argc, msg, last_buffer, last_args);
             waiting = false;
             break;
         }
     }
 }
 
+void port_checker::server::expect(const std::string& path)
+{
+    replies[path].reset();
+}
+
+void port_checker::server::forget(const std::string& path)
+{
+    replies.erase(path);
+}
+
+bool port_checker::server::expects(const std::string& path) const
+{
+    return replies.count(path);
+}
+
+bool port_checker::server::take_reply(const std::string& path,
+                                      reply_t& reply)
+{
+    auto itr = replies.find(path);
+    if(itr == replies.end() || !itr->second)
+        return false;
+    // moving the buffer keeps the args pointing into it valid
+    reply = std::move(*itr->second);
+    replies.erase(itr);
+    return true;
+}
+
+int port_checker::server::receive(int timeout_msecs)
+{
+    int received = 0;
+    for(int n = lo_server_recv_noblock(srv, timeout_msecs); n;
+        n = lo_server_recv_noblock(srv, 0))
+        ++received;
+    return received;
+}
+
 void port_checker::server::init(const char* target_url)
 {
     target = lo_address_new_from_url(target_url);
@@ -180,6 +240,14 @@ void port_checker::server::init(const char* target_url)
     wait_for_reply(&buf, &reply, "/paths");
 }
 
+port_checker::server::~server()
+{
+    if(srv)
+        lo_server_free(srv);
+    if(target)
+        lo_address_free(target);
+}
+
 bool port_checker::send_msg(const char* address,
                             size_t nargs, const rtosc_arg_val_t* args)
 {
@@ -440,49 +508,70 @@ void port_checker::check_port(const char* loc, const char* portname,
                     raise(issue::option_port_not_si);
                 }
 
-                // send and reply...
-                // first, get some useful values
-                send_msg(full_path.c_str(), 0, nullptr);
-                std::vector<rtosc_arg_val_t> args1;
-                std::vector<char> strbuf1;
-                int res = sender.wait_for_reply(&strbuf1, &args1,
-                                                full_path.c_str());
+                if(opts.latency_samples)
+                {
+                    port_profile_t p;
+                    p.port = full_path;
+                    m_profile.push_back(p);
+                }
 
-                if(res)
+                if(opts.max_outstanding > 1)
                 {
-                    // alternate the values...
-                    for(rtosc_arg_val_t& a : args1)
-                        alternate_arg_val(a);
-                    // ... and send them back
-                    send_msg(full_path.c_str(), args1.size(), args1.data());
-                    args1.clear();
-                    strbuf1.clear();
-                    res = sender.wait_for_reply(&strbuf1, &args1,
-                                                full_path.c_str(),
-                                                "/undo_change");
-
-                    if(!res)
-                        raise(issue::parameter_not_replied);
-                    else {
-                        if(sender.replied_path() == 1 /* i.e. undo_change */) {
-                            // some apps may reply with undo_change, some may
-                            // already catch those... if we get one: retry
-                            res = sender.wait_for_reply(&strbuf1, &args1,
-                                                        full_path.c_str());
-                        }
+                    // pipelined: send and reply later, in check_params()
+                    param_check_t c;
+                    c.path = full_path;
+                    c.name = "/" + std::string(loc) + portname;
+                    m_param_checks.push_back(std::move(c));
+                }
+                else
+                {
+                    // send and reply...
+                    // first, get some useful values
+                    send_msg(full_path.c_str(), 0, nullptr);
+                    std::vector<rtosc_arg_val_t> args1;
+                    std::vector<char> strbuf1;
+                    int res = sender.wait_for_reply(&strbuf1, &args1,
+                                                    full_path.c_str());
+
+                    if(res)
+                    {
+                        // alternate the values...
+                        for(rtosc_arg_val_t& a : args1)
+                            alternate_arg_val(a);
+                        // ... and send them back
+                        send_msg(full_path.c_str(),
+                                 args1.size(), args1.data());
+                        args1.clear();
+                        strbuf1.clear();
+                        res = sender.wait_for_reply(&strbuf1, &args1,
+                                                    full_path.c_str(),
+                                                    "/undo_change");
+
+                        if(!res)
+                            raise(issue::parameter_not_replied);
+                        else {
+                            // i.e. undo_change
+                            if(sender.replied_path() == 1) {
+                                // some apps may reply with undo_change, some
+                                // may already catch those... if we get one:
+                                // retry
+                                res = sender.wait_for_reply(&strbuf1, &args1,
+                                                            full_path.c_str());
+                            }
 
-                        if(res)
-                        {
-                            res = other.wait_for_reply(&strbuf1, &args1,
-                                                       full_path.c_str());
-                            if(!res)
-                                raise(issue::parameter_not_broadcast);
+                            if(res)
+                            {
+                                res = other.wait_for_reply(&strbuf1, &args1,
+                                                           full_path.c_str());
+                                if(!res)
+                                    raise(issue::parameter_not_broadcast);
+                            }
+                            else raise(issue::parameter_not_replied);
                         }
-                        else raise(issue::parameter_not_replied);
                     }
-                }
-                else {
-                    raise(issue::parameter_not_queryable);
+                    else {
+                        raise(issue::parameter_not_queryable);
+                    }
                 }
             }
             else {
@@ -493,6 +582,233 @@ void port_checker::check_port(const char* loc, const char* portname,
     }
 }
 
+void port_checker::step_param_check(param_check_t& c,
+                                    std::chrono::steady_clock::time_point now)
+{
+    using namespace std::chrono;
+    server& srv = (c.state == param_check_t::broadcast) ? other : sender;
+    reply_t reply;
+    if(srv.take_reply(c.path, reply))
+    {
+        switch(c.state)
+        {
+            case param_check_t::query:
+                // alternate the values and send them back
+                for(rtosc_arg_val_t& a : reply.args)
+                    alternate_arg_val(a);
+                sender.expect(c.path);
+                other.expect(c.path);
+                send_msg(c.path.c_str(), reply.args.size(), reply.args.data());
+                c.state = param_check_t::set;
+                break;
+            case param_check_t::set:
+                // replies to "/undo_change" are not expected, so they are
+                // skipped like in the sequential check
+                c.state = param_check_t::broadcast;
+                break;
+            default:
+                c.state = param_check_t::done;
+        }
+        c.state_started = now;
+    }
+    else
+    {
+        // like wait_for_reply(): give up if nothing has been received for
+        // timeout_msecs, or after one second
+        auto idle = now - std::max(c.state_started, srv.last_recv());
+        if(idle >= milliseconds(opts.timeout_msecs) ||
+           now - c.state_started >= seconds(1))
+        {
+            c.issues.push_back(
+                c.state == param_check_t::query ? issue::parameter_not_queryable
+                : c.state == param_check_t::set ? issue::parameter_not_replied
+                : issue::parameter_not_broadcast);
+            c.state = param_check_t::done;
+            sender.forget(c.path);
+            other.forget(c.path);
+        }
+    }
+}
+
+void port_checker::check_params()
+{
+    std::vector<param_check_t>& checks = m_param_checks;
+    const size_t max_outstanding = opts.max_outstanding;
+    std::vector<size_t> active;
+    size_t first_queued = 0;
+
+    while(first_queued < checks.size() || !active.empty())
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        // start new checks, but only one per path at a time, since replies
+        // are matched by path (e.g. duplicate parameters)
+        for(size_t i = first_queued;
+            i < checks.size() && active.size() < max_outstanding; ++i)
+        {
+            param_check_t& c = checks[i];
+            if(c.state == param_check_t::queued &&
+               !sender.expects(c.path) && !other.expects(c.path))
+            {
+                c.state = param_check_t::query;
+                c.started = c.state_started = now;
+                sender.expect(c.path);
+                send_msg(c.path.c_str(), 0, nullptr);
+                active.push_back(i);
+            }
+        }
+        while(first_queued < checks.size() &&
+              checks[first_queued].state != param_check_t::queued)
+            ++first_queued;
+
+        int received = sender.receive(0);
+        received += other.receive(0);
+        if(!received)
+            sender.receive(1); // nothing there, wait a bit
+        now = std::chrono::steady_clock::now();
+
+        for(size_t i = 0; i < active.size();)
+        {
+            step_param_check(checks[active[i]], now);
+            if(checks[active[i]].state == param_check_t::done) {
+                active[i] = active.back();
+                active.pop_back();
+            }
+            else
+                ++i;
+        }
+    }
+
+    // raise in the order of the ports, like the sequential check
+    for(const param_check_t& c : checks)
+        for(issue i : c.issues)
+            m_issues.emplace(i, c.name);
+    checks.clear();
+}
+
+//! Nearest-rank percentile of sorted, non-empty @p v
+static double percentile(const std::vector<double>& v, double p)
+{
+    std::size_t rank = (std::size_t)std::ceil(p / 100.0 * v.size());
+    return v[rank ? rank - 1 : 0];
+}
+
+void port_checker::profile_params()
+{
+    using clock = std::chrono::steady_clock;
+    auto msecs = [](clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count(); };
+
+    for(port_profile_t& p : m_profile)
+    {
+        const char* path = p.port.c_str();
+        std::vector<rtosc_arg_val_t> args;
+        std::vector<char> strbuf;
+
+        for(int i = 0; i < opts.latency_samples && !p.timed_out; ++i)
+        {
+            clock::time_point start = clock::now();
+            send_msg(path, 0, nullptr);
+            if(sender.wait_for_reply(&strbuf, &args, path))
+                p.latencies.push_back(msecs(clock::now() - start));
+            else
+                p.timed_out = true; // don't wait for it again
+        }
+        if(p.latencies.empty())
+            continue;
+        std::sort(p.latencies.begin(), p.latencies.end());
+        p.p50 = percentile(p.latencies, 50);
+        p.p99 = percentile(p.latencies, 99);
+
+        if(opts.flood_count && !p.timed_out)
+        {
+            // set the current values again, all at once, and count the
+            // replies until they stop
+            std::vector<rtosc_arg_val_t> reply_args;
+            std::vector<char> reply_buf;
+            clock::time_point start = clock::now(), last = start;
+            for(int i = 0; i < opts.flood_count; ++i)
+                send_msg(path, args.size(), args.data());
+            p.flood_sent = opts.flood_count;
+            while(p.flood_replied < p.flood_sent &&
+                  sender.wait_for_reply(&reply_buf, &reply_args, path)) {
+                ++p.flood_replied;
+                last = clock::now();
+            }
+            p.flood_msecs = msecs(last - start);
+        }
+    }
+}
+
+const std::vector<port_profile_t> &port_checker::profile() const
+{
+    return m_profile;
+}
+
+void port_checker::print_profile(std::size_t max_ports) const
+{
+    std::vector<const port_profile_t*> sorted;
+    std::size_t not_replied = 0;
+    for(const port_profile_t& p : m_profile)
+    {
+        if(p.latencies.empty())
+            ++not_replied;
+        else
+            sorted.push_back(&p);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const port_profile_t* a, const port_profile_t* b) {
+                  return a->p99 > b->p99; });
+
+    std::cout << "# Profile" << std::endl << std::endl;
+    std::cout << "Parameters:" << std::endl;
+    std::cout << "* profiled: " << sorted.size() << std::endl;
+    std::cout << "* not replied: " << not_replied << std::endl << std::endl;
+
+    std::cout << "Slowest ports (latency in ms, throughput in replies/s):"
+              << std::endl << std::endl;
+    std::cout << "| port | p50 | p99 | throughput |" << std::endl;
+    std::cout << "|------|-----|-----|------------|" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for(std::size_t i = 0; i < sorted.size() && i < max_ports; ++i)
+    {
+        const port_profile_t& p = *sorted[i];
+        std::cout << "| " << p.port << " | " << p.p50 << " | " << p.p99
+                  << " | ";
+        if(p.flood_sent)
+            std::cout << std::setprecision(0) << p.throughput()
+                      << std::setprecision(3) << " (" << p.flood_replied
+                      << "/" << p.flood_sent << " replied)";
+        else
+            std::cout << "-";
+        std::cout << " |" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::endl;
+
+    std::cout << "The following ports are slower than " << opts.slow_msecs
+              << "ms (p99):" << std::endl;
+    std::size_t slow = 0;
+    for(; slow < sorted.size() && sorted[slow]->p99 > opts.slow_msecs; ++slow)
+        std::cout << "* " << sorted[slow]->port << std::endl;
+    if(!slow)
+        std::cout << "None" << std::endl;
+    std::cout << std::endl;
+}
+
+bool port_checker::write_profile(const char* filename) const
+{
+    std::ofstream out(filename);
+    out << "# port\tp50_ms\tp99_ms\tsamples\ttimed_out"
+           "\tflood_sent\tflood_replied\tthroughput" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for(const port_profile_t& p : m_profile)
+        out << p.port << '\t' << p.p50 << '\t' << p.p99 << '\t'
+            << p.latencies.size() << '\t' << p.timed_out << '\t'
+            << p.flood_sent << '\t' << p.flood_replied << '\t'
+            << p.throughput() << std::endl;
+    return (bool)out;
+}
+
 void port_checker::print_evaluation() const
 {
     auto sev_str = [](severity s) -> const char* {
@@ -658,6 +974,10 @@ bool port_checker::print_sanity_checks() const
 void port_checker::do_checks(char* loc, int loc_size, bool check_defaults)
 {
     char* old_loc = loc + strlen(loc);
+    // the root is checked by part 0, its subtrees are shared by all parts
+    const bool root = (old_loc == loc);
+    const bool root_of_other_part = root && part;
+    size_t subtree_no = 0;
 //  std::cout << "Checking Ports: \"" << loc << "\"..." << std::endl;
 
 
@@ -691,7 +1011,9 @@ void port_checker::do_checks(char* loc, int loc_size, bool check_defaults)
                 self_disabled = true;
         }
     }
-    if(self_disabled)
+    if(root_of_other_part)
+        m_issues.clear(); // the root's enabled-ports are reported by part 0
+    else if(self_disabled)
         m_skipped.insert("/" + std::string(loc));
     else
         ++ports_checked;
@@ -708,6 +1030,10 @@ void port_checker::do_checks(char* loc, int loc_size, bool check_defaults)
         const int32_t meta_len = blob.len;
         const bool has_meta = meta_len && metadata && *metadata;
         bool has_subports = portname[portlen-1] == '/';
+        if(root && parts > 1 &&
+           (has_subports ? (subtree_no++ % parts != (size_t)part)
+                         : root_of_other_part))
+            continue;
         if(!has_meta)
            metadata = "";
         //std::cout << "port /" << loc << ", replied: " << portname
@@ -797,13 +1123,8 @@ void port_checker::do_checks(char* loc, int loc_size, bool check_defaults)
     }
 }
 
-bool port_checker::operator()(const char* url)
+void port_checker::run(const char* url)
 {
-    for(const issue_t& it : _m_issue_types_arr)
-        m_issue_types.emplace(it.issue_id, it);
-
-    start_time = time(NULL);
-
     unsigned i = 0;
     for(; i < strlen(url); ++i)
         if(!isdigit(url[i]))
@@ -823,6 +1144,67 @@ bool port_checker::operator()(const char* url)
 
     char loc_buffer[4096] = { 0 };
     do_checks(loc_buffer, sizeof(loc_buffer));
+    check_params();
+    if(opts.latency_samples)
+        profile_params();
+}
+
+bool port_checker::operator()(const char* url)
+{
+    for(const issue_t& it : _m_issue_types_arr)
+        m_issue_types.emplace(it.issue_id, it);
+
+    start_time = time(NULL);
+
+    if(opts.clients > 1)
+    {
+        // each client has its own sockets and checks its own subtrees
+        port_checker_options client_opts = opts;
+        client_opts.clients = 1;
+        std::vector<std::unique_ptr<port_checker>> clients;
+        std::vector<std::exception_ptr> errors(opts.clients);
+        std::vector<std::thread> threads;
+        for(int i = 0; i < opts.clients; ++i)
+        {
+            clients.emplace_back(new port_checker(client_opts));
+            clients[i]->part = i;
+            clients[i]->parts = opts.clients;
+        }
+        for(int i = 0; i < opts.clients; ++i)
+            threads.emplace_back([&clients, &errors, url, i]() {
+                try {
+                    clients[i]->run(url);
+                }
+                catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        for(std::thread& t : threads)
+            t.join();
+        for(const std::exception_ptr& e : errors)
+            if(e)
+                std::rethrow_exception(e);
+
+        // issues of different clients can not be merged in port order,
+        // so sort them
+        std::vector<std::pair<issue, std::string>> issues;
+        for(const auto& c : clients)
+        {
+            ports_checked += c->ports_checked;
+            m_skipped.insert(c->m_skipped.begin(), c->m_skipped.end());
+            issues.insert(issues.end(), c->m_issues.begin(), c->m_issues.end());
+            m_profile.insert(m_profile.end(),
+                             c->m_profile.begin(), c->m_profile.end());
+        }
+        std::sort(issues.begin(), issues.end());
+        m_issues.insert(issues.begin(), issues.end());
+    }
+    else
+        run(url);
+
+    std::sort(m_profile.begin(), m_profile.end(),
+              [](const port_profile_t& a, const port_profile_t& b) {
+                  return a.port < b.port; });
 
     finish_time = time(NULL);
     return true;
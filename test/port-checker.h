@@ -34,6 +34,8 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
+#include <chrono>
 #include <rtosc/rtosc.h>
 #include <lo/lo_types.h>
 
@@ -87,6 +89,36 @@ struct issue_t
 struct port_checker_options
 {
     int timeout_msecs = 50;
+    //! Number of parameter checks waiting for replies at the same time
+    //! 1 means one check after another, each waiting for its replies
+    int max_outstanding = 1;
+    //! Number of clients, each with its own sockets, checking parts of the
+    //! port tree in parallel
+    int clients = 1;
+
+    // profiling, done after the checks, by each client for its ports
+    //! Number of queries per parameter to measure the reply latency,
+    //! 0 for no profiling
+    int latency_samples = 0;
+    //! Ports with a p99 latency above are reported as slow
+    double slow_msecs = 10.0;
+    //! Number of messages sent at once to each parameter to measure the
+    //! throughput, 0 for not flooding
+    int flood_count = 0;
+};
+
+//! Latency and throughput of one parameter port
+struct port_profile_t
+{
+    std::string port;
+    std::vector<double> latencies; //!< round trip times in msecs, sorted
+    double p50 = 0, p99 = 0; //!< in msecs
+    bool timed_out = false;  //!< whether a query was not replied
+    int flood_sent = 0, flood_replied = 0;
+    double flood_msecs = 0;  //!< time until the last flood reply
+    //! Replies per second while flooding, 0 if no flood took place
+    double throughput() const {
+        return flood_msecs > 0 ? flood_replied * 1000.0 / flood_msecs : 0; }
 };
 
 class port_error : public std::runtime_error
@@ -116,6 +148,32 @@ class port_checker
     //! URL of the app
     std::string sendtourl;
 
+    port_checker_options opts;
+    //! Part of the port tree checked by this instance: subtrees of the root
+    //! with number % parts == part, and the root ports if part is 0
+    int part = 0, parts = 1;
+
+    //! Parameter check whose replies are awaited, see check_params()
+    struct param_check_t
+    {
+        std::string path; //!< path to send to
+        std::string name; //!< name for issues
+        enum { queued, query, set, broadcast, done } state = queued;
+        std::chrono::steady_clock::time_point started, state_started;
+        std::vector<issue> issues;
+    };
+    //! Parameter checks left for check_params()
+    std::vector<param_check_t> m_param_checks;
+    //! Parameters to profile, and their results after profile_params()
+    std::vector<port_profile_t> m_profile;
+
+    //! A received message, with args pointing into buffer
+    struct reply_t
+    {
+        std::vector<char> buffer;
+        std::vector<rtosc_arg_val_t> args;
+    };
+
     //! One instance of server connected to the app
     //! We will have two servers (one for send/reply and one
     //! for catching broadcasts)
@@ -127,8 +185,8 @@ class port_checker
         volatile bool waiting = true;
         int timeout_msecs;
 
-        lo_server srv;
-        lo_address target;
+        lo_server srv = nullptr;
+        lo_address target = nullptr;
 
         constexpr static int max_exp_paths = 15;
         const char *exp_paths[max_exp_paths+1];
@@ -138,6 +196,11 @@ class port_checker
         std::vector<char>* last_buffer;
         std::vector<rtosc_arg_val_t>* last_args;
 
+        //! Reply table for pipelined checks: paths which are expected,
+        //! with their reply once it has been received
+        std::map<std::string, std::unique_ptr<reply_t>> replies;
+        std::chrono::steady_clock::time_point _last_recv;
+
         bool _wait_for_reply(std::vector<char> *buffer,
                              std::vector<rtosc_arg_val_t>*args, int unused);
 
@@ -154,7 +217,8 @@ class port_checker
                      lo_arg **argv, int argc, lo_message msg);
 
     public:
-        server(int t) : timeout_msecs(t) {}
+        server(int t) : timeout_msecs(t) { exp_paths[0] = nullptr; }
+        ~server();
 
         //! Return which of the expected paths from wait_for_reply() has
         //! has been received
@@ -174,6 +238,22 @@ class port_checker
                             Args ...exp_paths) {
             return _wait_for_reply(buffer, args, 0, exp_paths...);
         }
+
+        //! Keep the next message to @p path in the reply table
+        void expect(const std::string& path);
+        //! Stop expecting @p path, dropping its reply, if any
+        void forget(const std::string& path);
+        //! Whether @p path is expected or has a reply in the table
+        bool expects(const std::string& path) const;
+        //! Move the reply to @p path out of the table, if it arrived
+        bool take_reply(const std::string& path, reply_t& reply);
+        //! Receive all pending messages, waiting at most @p timeout_msecs
+        //! for the first one. Messages not expected are discarded.
+        //! @return the number of messages received
+        int receive(int timeout_msecs);
+        //! Time of the last received message
+        std::chrono::steady_clock::time_point last_recv() const {
+            return _last_recv; }
     };
 
     server sender; //!< send and check replies
@@ -195,15 +275,27 @@ class port_checker
                     const char *metadata, int meta_len, bool check_defaults);
     bool port_is_enabled(const char *loc, const char *port,
                          const char *metadata);
+    //! Check the parameters of m_param_checks, with up to
+    //! max_outstanding checks at once
+    void check_params();
+    //! Advance @p c if its replies arrived, or let it time out
+    void step_param_check(param_check_t& c,
+                          std::chrono::steady_clock::time_point now);
+    //! Measure latency and throughput of the ports in m_profile
+    void profile_params();
+    //! Check the port tree, or its part, without timing
+    void run(const char* url);
     void m_sanity_checks(std::vector<int> &issue_type_missing) const;
     std::set<issue> issues_not_covered() const;
 
 public:
     port_checker(port_checker_options opts_arg = port_checker_options()) :
+        opts(opts_arg),
         sender(opts_arg.timeout_msecs),
         other(opts_arg.timeout_msecs) {}
 
     //! Let the port checker connect to url and find issues for all ports
+    //! With more than one client, the issues of each type are sorted by port
     //! @param url URL in format osc.udp://xxx.xxx.xxx.xxx:ppppp/, or just
     //!     ppppp (which means osc.udp://127.0.0.1:ppppp/)
     bool operator()(const char* url);
@@ -239,6 +331,16 @@ public:
 
     //! Print statistics like number of ports and time consumed
     void print_statistics() const;
+
+    //! Return the profiles of all parameters, sorted by port
+    //! Empty unless latency_samples has been set
+    const std::vector<port_profile_t>& profile() const;
+    //! Print the @p max_ports slowest ports, and ports slower than
+    //! slow_msecs
+    void print_profile(std::size_t max_ports = 20) const;
+    //! Write the profile as tab separated values, one port per line,
+    //! sorted by port, in order to compare it across builds
+    bool write_profile(const char* filename) const;
 };
 
 }
@@ -0,0 +1,817 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/dispatch-profiler.h>
+#include <cstdarg>
+#include <cstdlib>
+#include <sstream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+std::string last_port;
+std::string last_loc;
+int hits = 0;
+
+void record(const char *, RtData &d)
+{
+    ++hits;
+    last_port = d.port->name;
+    last_loc  = d.loc ? d.loc : "";
+}
+
+//The '#' entries prevent a minimal perfect hash, so these ports are being
+//dispatched through the prefix trie
+Ports arrays = {
+    {"voice#8/",      "", 0, record},
+    {"volume::f",     "", 0, record},
+    {"vol::i",        "", 0, record},
+    {"val#16::i",     "", 0, record},
+    {"value::f",      "", 0, record},
+    {"v:",            "", 0, record},
+    {"enable::T:F",   "", 0, record},
+    {"en{a,b}:",      "", 0, record},
+};
+
+//No '#' here, these ports are dispatched using the minimal perfect hash
+#define HASHED_PORTS \
+    {"volume::f",     "", 0, record}, \
+    {"vol::i",        "", 0, record}, \
+    {"value::f",      "", 0, record}, \
+    {"v:",            "", 0, record}, \
+    {"voice/",        "", 0, record}, \
+    {"enable::T:F",   "", 0, record}, \
+    {"pan::c",        "", 0, record}, \
+    {"panning::f",    "", 0, record}, \
+    {"detune::i",     "", 0, record}, \
+    {"octave::i",     "", 0, record}, \
+    {"filter/",       "", 0, record}, \
+    {"lfo/",          "", 0, record}, \
+    {"lfo-freq::f",   "", 0, record}, \
+    {"lfo-depth::f",  "", 0, record}
+
+Ports hashed = { HASHED_PORTS };
+
+int dispatch_to(const Ports &p, const char *path, const char *args, ...)
+{
+    char buffer[256], loc[256] = {0};
+    va_list va;
+    va_start(va, args);
+    rtosc_vmessage(buffer, sizeof(buffer), path, args, va);
+    va_end(va);
+
+    RtData d;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    hits = 0;
+    last_port.clear();
+    p.dispatch(buffer, d, true);
+    return hits;
+}
+
+void check_hashed(const Ports &p, const char *what)
+{
+    std::string msg = what;
+    for(const Port &port : p) {
+        std::string path = "/";
+        path += port.name;
+        path = path.substr(0, path.find(':'));
+        if(path.back() == '/')
+            path += "x";
+        int n;
+        if(strstr(port.name, "::f"))
+            n = dispatch_to(p, path.c_str(), "f", 1.0f);
+        else if(strstr(port.name, "::i"))
+            n = dispatch_to(p, path.c_str(), "i", 1);
+        else if(strstr(port.name, "::c"))
+            n = dispatch_to(p, path.c_str(), "c", 1);
+        else if(strstr(port.name, "::T"))
+            n = dispatch_to(p, path.c_str(), "T");
+        else
+            n = dispatch_to(p, path.c_str(), "");
+        assert_int_eq(1, n, (msg + ": " + port.name + " is found").c_str(),
+                      __LINE__);
+        assert_str_eq(port.name, last_port.c_str(),
+                      (msg + ": " + port.name + " is the right one").c_str(),
+                      __LINE__);
+    }
+    assert_int_eq(0, dispatch_to(p, "/volum", "f", 1.0f),
+                  (msg + ": unknown port is not dispatched").c_str(), __LINE__);
+}
+
+//Tree for the dispatch cache
+int recursions = 0;
+int leaf_value[2][3];
+std::string leaf_loc;
+
+Ports leaves = {
+    {"value::i", "", 0, [](const char *m, RtData &d) {
+        ((int*)d.obj)[d.idx[0]] = rtosc_argument(m, 0).i;
+        leaf_loc = d.location() ? d.location() : ""; }},
+    {"value::f", "", 0, [](const char *m, RtData &d) {
+        ((int*)d.obj)[d.idx[0]] = -(int)rtosc_argument(m, 0).f; }},
+};
+
+Ports mid = {
+    {"slot#3/", "", &leaves, [](const char *m, RtData &d) {
+        ++recursions;
+        d.push_index(atoi(m+4));
+        while(*m && *m != '/') ++m;
+        leaves.dispatch(m+1, d);
+        d.pop_index(); }},
+};
+
+Ports top = {
+    {"part#2/", "", &mid, [](const char *m, RtData &d) {
+        ++recursions;
+        d.obj = leaf_value[atoi(m+4)];
+        while(*m && *m != '/') ++m;
+        mid.dispatch(m+1, d); }},
+};
+
+int cached(DispatchCache &cache, const char *path, const char *args, ...)
+{
+    char buffer[256], loc[128] = {0};
+    va_list va;
+    va_start(va, args);
+    rtosc_vmessage(buffer, sizeof(buffer), path, args, va);
+    va_end(va);
+
+    RtData d;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    recursions = 0;
+    leaf_loc.clear();
+    cache.dispatch(top, buffer, d);
+    return recursions;
+}
+
+void test_dispatch_cache(void)
+{
+    DispatchCache cache(64);
+    memset(leaf_value, 0, sizeof(leaf_value));
+
+    assert_int_eq(2, cached(cache, "/part1/slot2/value", "i", 42),
+                  "First dispatch walks the tree", __LINE__);
+    assert_int_eq(42, leaf_value[1][2], "First dispatch is applied",
+                  __LINE__);
+    assert_int_eq(0, cached(cache, "/part1/slot2/value", "i", 43),
+                  "Second dispatch skips the tree", __LINE__);
+    assert_int_eq(43, leaf_value[1][2], "Cached dispatch is applied",
+                  __LINE__);
+    assert_str_eq("/part1/slot2/value", leaf_loc.c_str(),
+                  "Cached dispatch restores the location", __LINE__);
+    assert_int_eq(1, cache.hits, "Cache hit is counted", __LINE__);
+
+    assert_int_eq(2, cached(cache, "/part1/slot2/value", "f", 5.0f),
+                  "Other argument types are other entries", __LINE__);
+    assert_int_eq(0, cached(cache, "/part1/slot2/value", "f", 6.0f),
+                  "Other argument types are cached", __LINE__);
+    assert_int_eq(-6, leaf_value[1][2], "Other port has been called",
+                  __LINE__);
+
+    assert_int_eq(2, cached(cache, "/part0/slot1/missing", "i", 1),
+                  "Missing leaf walks the tree", __LINE__);
+    assert_int_eq(2, cached(cache, "/part0/slot1/missing", "i", 1),
+                  "Missing leaf is not cached", __LINE__);
+
+    cached(cache, "/part0/slot1/value", "i", 7);
+    cache.invalidate("/part0");
+    assert_int_eq(2, cached(cache, "/part0/slot1/value", "i", 8),
+                  "Invalidated prefix walks the tree", __LINE__);
+    assert_int_eq(8, leaf_value[0][1], "Invalidated prefix is applied",
+                  __LINE__);
+
+    assert_int_eq(0, cached(cache, "/part0/slot1/value", "i", 9),
+                  "Entry is cached again", __LINE__);
+    Ports refreshed = {{"x", "", 0, record}};
+    assert_int_eq(2, cached(cache, "/part0/slot1/value", "i", 10),
+                  "refreshMagic invalidates the cache", __LINE__);
+}
+
+void add_ctx(const char *m, RtData &, void *ctx)
+{
+    *(int*)ctx += rtosc_argument(m, 0).i;
+}
+
+void test_port_callback(void)
+{
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), "/x", "i", 3);
+    RtData d;
+
+    assert_true(sizeof(PortCallback) <= 2*sizeof(void*),
+                "Callbacks are two pointers", __LINE__);
+    assert_false((bool)PortCallback(), "Empty callback", __LINE__);
+    assert_false((bool)PortCallback(NULL), "NULL callback", __LINE__);
+
+    PortCallback plain = [](const char *, RtData &d) { ++d.matches; };
+    assert_non_null((void*)plain.function(),
+                    "Lambdas without captures are functions", __LINE__);
+    plain(msg, d);
+    assert_int_eq(1, d.matches, "Call function", __LINE__);
+
+    PortCallback wrapped = std::function<void(msg_t, RtData&)>(record);
+    assert_true(wrapped.function() == &record,
+                "std::function with a function is unwrapped", __LINE__);
+
+    int sum = 0;
+    PortCallback ctx(add_ctx, &sum);
+    ctx(msg, d);
+    assert_int_eq(3, sum, "Call function with context", __LINE__);
+
+    PortCallback capturing = [&sum](const char *m, RtData &) {
+        sum += 10*rtosc_argument(m, 0).i; };
+    assert_true(capturing.function() == NULL,
+                "Lambdas with captures are no functions", __LINE__);
+    PortCallback copy = capturing;
+    capturing = plain;
+    copy(msg, d);
+    assert_int_eq(33, sum, "Call copied capturing lambda", __LINE__);
+    PortCallback moved = std::move(copy);
+    moved(msg, d);
+    assert_int_eq(63, sum, "Call moved capturing lambda", __LINE__);
+    assert_false((bool)copy, "Moved callback is empty", __LINE__);
+}
+
+//Tree for batches
+std::string batch_log;
+
+Ports batch_leaves = {
+    {"x::i", "", 0, [](const char *m, RtData &d) {
+        batch_log += std::string(d.location()) + "=" +
+                     std::to_string(rtosc_argument(m, 0).i) + " "; }},
+};
+
+Ports batch_ports = {
+    {"sub#2/", "", &batch_leaves, [](const char *m, RtData &d) {
+        while(*m && *m != '/') ++m;
+        batch_leaves.dispatch(m+1, d); }},
+    {"y::i", "", 0, [](const char *m, RtData &d) {
+        batch_log += std::string(d.location()) + "=" +
+                     std::to_string(rtosc_argument(m, 0).i) + " "; }},
+};
+
+void test_batch(void)
+{
+    char m1[32], m2[32], m3[32], m4[32], inner[128], bundle[256];
+    char loc[64];
+    rtosc_message(m1, sizeof(m1), "/sub1/x", "i", 1);
+    rtosc_message(m2, sizeof(m2), "/y", "i", 2);
+    rtosc_message(m3, sizeof(m3), "/sub0/x", "i", 3);
+    rtosc_message(m4, sizeof(m4), "/missing", "i", 4);
+
+    RtData d;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    const char *msgs[] = {m1, m2, m3, m4};
+    batch_log.clear();
+    batch_ports.dispatch_batch(msgs, 4, d);
+    assert_str_eq("/sub1/x=1 /y=2 /sub0/x=3 ", batch_log.c_str(),
+                  "Batch is dispatched in order", __LINE__);
+    assert_int_eq(3, d.matches, "Batch matches are summed up", __LINE__);
+
+    size_t inner_len = rtosc_bundle(inner, sizeof(inner), 0, 2, m3, m2);
+    size_t len = rtosc_bundle(bundle, sizeof(bundle), 0, 3, m1, inner, m4);
+    batch_log.clear();
+    batch_ports.dispatch_bundle(bundle, len, d);
+    assert_true(inner_len && len, "Bundles are created", __LINE__);
+    assert_str_eq("/sub1/x=1 /sub0/x=3 /y=2 ", batch_log.c_str(),
+                  "Nested bundles are dispatched in place", __LINE__);
+    assert_int_eq(3, d.matches, "Bundle matches are summed up", __LINE__);
+
+    batch_log.clear();
+    d.loc = NULL;
+    batch_ports.dispatch_batch(msgs, 0, d);
+    assert_str_eq("", batch_log.c_str(), "Empty batch", __LINE__);
+}
+
+void test_lazy_loc(void)
+{
+    char buffer[64], loc[64];
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    d.lazy_loc = true;
+
+    memset(loc, 'z', sizeof(loc));
+    rtosc_message(buffer, sizeof(buffer), "/part1/slot2/value", "f", 1.0f);
+    top.dispatch(buffer, d, true);
+    assert_int_eq('z', loc[1], "Unused lazy location is not written",
+                  __LINE__);
+    assert_int_eq(1, d.matches, "Lazy location counts matches", __LINE__);
+    assert_int_eq(0, d.loc_depth, "Lazy location stack is empty again",
+                  __LINE__);
+
+    leaf_loc.clear();
+    rtosc_message(buffer, sizeof(buffer), "/part0/slot1/value", "i", 4);
+    top.dispatch(buffer, d, true);
+    assert_str_eq("/part0/slot1/value", leaf_loc.c_str(),
+                  "Lazy location is written on demand", __LINE__);
+    assert_int_eq(4, leaf_value[0][1], "Lazy location dispatch is applied",
+                  __LINE__);
+
+    batch_log.clear();
+    rtosc_message(buffer, sizeof(buffer), "/sub1/x", "i", 5);
+    batch_ports.dispatch(buffer, d, true);
+    assert_str_eq("/sub1/x=5 ", batch_log.c_str(),
+                  "Lazy location without hash", __LINE__);
+
+    DispatchCache cache;
+    cached(cache, "/part1/slot0/value", "i", 1);
+    leaf_loc.clear();
+    rtosc_message(buffer, sizeof(buffer), "/part1/slot0/value", "i", 2);
+    cache.dispatch(top, buffer, d);
+    assert_int_eq(1, cache.hits, "Cache hit with lazy location", __LINE__);
+    assert_str_eq("/part1/slot0/value", leaf_loc.c_str(),
+                  "Cached lazy location", __LINE__);
+}
+
+//Sugar callbacks with lazy locations
+struct Knob
+{
+    float gain;
+    int   mode;
+    int   resets;
+    void reset(void) { ++resets; }
+};
+
+#define rObject Knob
+Ports knob_ports = {
+    rParamF(gain, rLinear(0, 1), "gain"),
+    rParamI(mode, rLinear(0, 3), "mode"),
+    rAction(reset, "reset"),
+};
+#undef rObject
+
+void test_lazy_loc_sugar(void)
+{
+    char buffer[64], loc[64];
+    Knob knob = {0.5f, 2, 0};
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    d.lazy_loc = true;
+    d.obj      = &knob;
+
+    memset(loc, 'z', sizeof(loc));
+    rtosc_message(buffer, sizeof(buffer), "reset", "");
+    knob_ports.dispatch(buffer, d, true);
+    assert_int_eq(1, knob.resets, "Sugar action is called", __LINE__);
+    assert_int_eq('z', loc[1], "Sugar action writes no location", __LINE__);
+
+    rtosc_message(buffer, sizeof(buffer), "mode", "i", 7);
+    knob_ports.dispatch(buffer, d, true);
+    assert_int_eq(3, knob.mode, "Sugar setter limits the value", __LINE__);
+    assert_str_eq("/mode", loc, "Sugar setter writes the location",
+                  __LINE__);
+}
+
+//One port with overloads, found by hash and by the trie
+Ports overloads = {
+    {"over::i:c:ff:s", "", 0, record},
+    {"other::i", "", 0, record},
+};
+Ports overloads_trie = {
+    {"over::i:c:ff:s", "", 0, record},
+    {"other#2::i", "", 0, record},
+};
+
+void test_arg_specs(void)
+{
+    const Ports *tables[] = {&overloads, &overloads_trie};
+    const char *names[] = {"hash", "trie"};
+    char buffer[64], loc[64];
+    for(int t=0; t<2; ++t)
+    for(int with_loc=0; with_loc<2; ++with_loc) {
+        std::string what = std::string(names[t]) +
+                           (with_loc ? " with loc: " : ": ");
+        auto matches = [&](const char *args, ...) {
+            va_list va;
+            va_start(va, args);
+            rtosc_vmessage(buffer, sizeof(buffer), "/over", args, va);
+            va_end(va);
+            RtData d;
+            if(with_loc) {
+                d.loc = loc;
+                d.loc_size = sizeof(loc);
+            }
+            hits = 0;
+            tables[t]->dispatch(buffer, d, true);
+            return hits;
+        };
+        assert_int_eq(1, matches(""), (what + "empty args").c_str(),
+                      __LINE__);
+        assert_int_eq(1, matches("i", 1), (what + "int").c_str(), __LINE__);
+        assert_int_eq(1, matches("c", 1), (what + "char").c_str(), __LINE__);
+        assert_int_eq(1, matches("ff", 1.0f, 2.0f),
+                      (what + "two floats").c_str(), __LINE__);
+        assert_int_eq(1, matches("s", "x"), (what + "string").c_str(),
+                      __LINE__);
+        assert_int_eq(0, matches("f", 1.0f), (what + "one float").c_str(),
+                      __LINE__);
+        assert_int_eq(0, matches("ic", 1, 2), (what + "int and char").c_str(),
+                      __LINE__);
+        assert_int_eq(0, matches("T"), (what + "true").c_str(), __LINE__);
+    }
+}
+
+//Read back the array definition written by MagicFormatter
+std::vector<uint32_t> parse_magic(const std::string &code)
+{
+    std::vector<uint32_t> words;
+    const char *c = strchr(code.c_str(), '{');
+    while(c && *c != '}') {
+        char *end;
+        unsigned long w = strtoul(c+1, &end, 0);
+        if(end != c+1)
+            words.push_back(w);
+        c = strpbrk(end, ",}");
+    }
+    return words;
+}
+
+int dispatch(const char *path, const char *args, bool with_loc, ...)
+{
+    char buffer[256], loc[256];
+    va_list va;
+    va_start(va, with_loc);
+    rtosc_vmessage(buffer, sizeof(buffer), path, args, va);
+    va_end(va);
+
+    RtData d;
+    if(with_loc) {
+        memset(loc, 0, sizeof(loc));
+        d.loc = loc;
+        d.loc_size = sizeof(loc);
+    }
+    hits = 0;
+    last_port.clear();
+    arrays.dispatch(buffer, d, true);
+    return hits;
+}
+
+struct ReplyData : public RtData
+{
+    std::vector<std::string> replies;
+    char buffer[128];
+
+    ReplyData(void) { memset(buffer, 0, sizeof(buffer)); loc = buffer;
+                      loc_size = sizeof(buffer); }
+    void reply(const char *msg) override {
+        replies.push_back(std::string(msg) + ":" +
+                          rtosc_argument_string(msg)); }
+    void replyArray(const char *path, const char *args,
+                    rtosc_arg_t *) override {
+        replies.push_back(std::string(path) + ":" + args); }
+};
+
+void test_profiler(void)
+{
+    DispatchProfiler profiler(64, 2);
+    char buffer[64], loc[128] = {0};
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    d.profiler = &profiler;
+    for(int i=0; i<5; ++i) {
+        rtosc_message(buffer, sizeof(buffer), "/part1/slot2/value", "i", i);
+        top.dispatch(buffer+1, d, true);
+    }
+    rtosc_message(buffer, sizeof(buffer), "/part0/slot0/value", "f", 1.0f);
+    top.dispatch(buffer+1, d, true);
+    assert_int_eq(4, leaf_value[1][2], "Profiled ports are called", __LINE__);
+
+    assert_int_eq(2, profiler.size(), "Only leaves are profiled", __LINE__);
+    const DispatchProfiler::stats_t *s = profiler.find("/part1/slot2/value");
+    assert_non_null(s, "Profiled port has its location", __LINE__);
+    assert_int_eq(5, s->hits, "Calls are counted", __LINE__);
+    assert_int_eq(2, s->samples, "Every n-th call is timed", __LINE__);
+    int histogram = 0;
+    for(int i=0; i<DispatchProfiler::buckets; ++i)
+        histogram += s->histogram[i];
+    assert_int_eq(2, histogram, "Timed calls are in the histogram", __LINE__);
+    assert_int_eq(1, profiler.find("/part0/slot0/value")->hits,
+                  "Other port is counted separately", __LINE__);
+
+    DispatchProfiler small(2, 0);
+    d.profiler = &small;
+    top.dispatch(buffer+1, d, true);
+    rtosc_message(buffer, sizeof(buffer), "/part1/slot2/value", "i", 3);
+    top.dispatch(buffer+1, d, true);
+    assert_int_eq(1, small.size(), "Full profiler keeps its ports", __LINE__);
+    assert_int_eq(1, small.overflow, "Calls beyond the table are counted",
+                  __LINE__);
+    assert_int_eq(3, leaf_value[1][2], "Ports beyond the table are called",
+                  __LINE__);
+
+    Ports monitor = {profiler.profilerPort()};
+    ReplyData r;
+    rtosc_message(buffer, sizeof(buffer), "/profiler/count", "");
+    monitor.dispatch(buffer+1, r, true);
+    rtosc_message(buffer, sizeof(buffer), "/profiler/stats", "");
+    monitor.dispatch(buffer+1, r, true);
+    rtosc_message(buffer, sizeof(buffer), "/profiler/histogram", "s",
+                  "/part1/slot2/value");
+    monitor.dispatch(buffer+1, r, true);
+    assert_int_eq(4, r.replies.size(), "Statistics are replied", __LINE__);
+    assert_str_eq("/profiler/count:i", r.replies[0].c_str(),
+                  "Number of ports is replied", __LINE__);
+    assert_str_eq("/profiler/stats:shhhh", r.replies[1].c_str(),
+                  "Statistics of each port are replied", __LINE__);
+    assert_str_eq("/profiler/histogram:siiiiiiiiiiiiiiii",
+                  r.replies[3].c_str(), "Histogram is replied", __LINE__);
+
+    rtosc_message(buffer, sizeof(buffer), "/profiler/reset", "");
+    monitor.dispatch(buffer+1, r, true);
+    assert_int_eq(0, profiler.size(), "Statistics are reset over OSC",
+                  __LINE__);
+}
+
+//reference implementation of Ports::operator[]
+const Port *find_linear(const Ports &p, const char *name)
+{
+    for(const Port &port : p) {
+        const char *n = name, *h = port.name;
+        while(*n && *n == *h)
+            ++n, ++h;
+        if(!*n && (*h == ':' || !*h))
+            return &port;
+    }
+    return NULL;
+}
+
+void test_name_lookup(void)
+{
+    const char *names[] = {"volume", "volume::f", "volume:", "vol", "vo",
+                           "val#16", "val#16::i", "voice#8/", "voice/", "v",
+                           "v:", "enable", "enable::T", "en{a,b}", "pan",
+                           "lfo", "lfo/", "lfo-freq", "missing", "",
+                           "volume::i"};
+    const Ports *tables[] = {&arrays, &hashed};
+    bool same = true;
+    for(const Ports *p : tables)
+        for(const char *name : names)
+            same &= (*p)[name] == find_linear(*p, name);
+    assert_true(same, "Indexed name lookup finds the same ports", __LINE__);
+    assert_str_eq("volume::f", hashed["volume"]->name,
+                  "Port is found by its name", __LINE__);
+
+    Ports overloaded = {
+        {"volume::i", "", 0, record},
+        {"volume::f", "", 0, record},
+        {"volume/",   "", 0, record},
+    };
+    assert_str_eq("volume::i", overloaded["volume"]->name,
+                  "First port of a name is found", __LINE__);
+    assert_str_eq("volume::f", overloaded["volume::f"]->name,
+                  "Later port of the same name is found", __LINE__);
+    assert_str_eq("volume/", overloaded["volume/"]->name,
+                  "Subtree port is found", __LINE__);
+
+    assert_str_eq("volume::f", hashed.apropos("/vol")->name,
+                  "apropos finds the first prefixed port", __LINE__);
+    assert_str_eq("lfo-freq::f", hashed.apropos("/lfo-")->name,
+                  "apropos finds a longer prefix", __LINE__);
+    assert_str_eq("val#16::i", arrays.apropos("/val3")->name,
+                  "apropos matches enumerated ports", __LINE__);
+    assert_str_eq("voice#8/", arrays.apropos("/voice2/")->name,
+                  "apropos finds subtrees without children", __LINE__);
+    assert_str_eq("value::i", top.apropos("/part1/slot0/value")->name,
+                  "apropos descends into subtrees", __LINE__);
+    assert_null(hashed.apropos("/gg"), "apropos without match", __LINE__);
+}
+
+void test_compose(void)
+{
+    int which = 0;
+    Ports first = {
+        {"volume::f", "", 0, [&](const char *, RtData &) { which = 1; }},
+        {"pan::c",    "", 0, [&](const char *, RtData &) { which = 2; }},
+    };
+    Ports second = {
+        {"volume::f", "", 0, [&](const char *, RtData &) { which = 3; }},
+        {"volume::i", "", 0, [&](const char *, RtData &) { which = 4; }},
+        {"detune::i", "", 0, [&](const char *, RtData &) { which = 5; }},
+    };
+
+    MergePorts merged = {&first, &second};
+    assert_int_eq(4, merged.ports.size(), "Duplicate ports are dropped",
+                  __LINE__);
+    char msg[64];
+    RtData d;
+    rtosc_message(msg, sizeof(msg), "/volume", "f", 1.0f);
+    merged.dispatch(msg+1, d, true);
+    assert_int_eq(1, which, "Earlier ports override later ones", __LINE__);
+    rtosc_message(msg, sizeof(msg), "/volume", "i", 1);
+    merged.dispatch(msg+1, d, true);
+    assert_int_eq(4, which, "Other argument specs are kept", __LINE__);
+    rtosc_message(msg, sizeof(msg), "/detune", "i", 1);
+    merged.dispatch(msg+1, d, true);
+    assert_int_eq(5, which, "Ports of later objects are merged", __LINE__);
+
+    //the hash needs unique paths, i.e. no "volume" twice
+    Ports third = {{"detune::i", "", 0, record}, {"octave::i", "", 0, record}};
+    MergePorts unique = {&first, &third};
+    const std::string magic = unique.saveMagic();
+    MergePorts loaded({&first, &third}, magic.data(), magic.size());
+    assert_true(!magic.empty() && magic == loaded.saveMagic(),
+                "Merged ports load a saved hash", __LINE__);
+
+    Ports twice = {
+        {"volume::f", "a", 0, record},
+        {"volume::f", "b", 0, record},
+    };
+    int cloned = 0, fallback = 0;
+    ClonePorts clone(twice, {
+        {"volume::f", [&](const char *, RtData &) { ++cloned; }},
+        {"*",         [&](const char *, RtData &) { ++fallback; }},
+    });
+    assert_int_eq(1, clone.ports.size(), "Clone has its ports", __LINE__);
+    assert_str_eq("b", clone.ports[0].metadata,
+                  "Last port of a name is cloned", __LINE__);
+    rtosc_message(msg, sizeof(msg), "/volume", "f", 1.0f);
+    clone.dispatch(msg+1, d, true);
+    assert_int_eq(1, cloned, "Cloned port has the new callback", __LINE__);
+}
+
+void test_prepare(void)
+{
+    Ports leaf = {{"value::i", ":doc\0=leaf\0", 0, record}};
+    Ports tree = {{"sub/", "", &leaf, [&leaf](const char *m, RtData &d) {
+                       while(*m && *m != '/') ++m;
+                       leaf.dispatch(m + 1, d);
+                   }}};
+    assert_false(tree.prepared(), "Tables are not built by the constructor",
+                 __LINE__);
+    tree.prepare();
+    assert_true(tree.prepared() && leaf.prepared(),
+                "prepare() builds the tables of all subtrees", __LINE__);
+    assert_int_eq(1, dispatch_to(tree, "/sub/value", "i", 1),
+                  "Prepared tree dispatches", __LINE__);
+
+    //same names, other metadata: the matcher is shared, the index is not
+    Ports other = {{"value::i", ":doc\0=other\0", 0, record}};
+    assert_int_eq(1, dispatch_to(other, "/value", "i", 1),
+                  "First dispatch builds the tables", __LINE__);
+    assert_true(other.prepared(), "Dispatched tables are built", __LINE__);
+    assert_str_eq("other", other.meta(other.ports[0])["doc"],
+                  "Tables with equal names keep their own metadata",
+                  __LINE__);
+    assert_str_eq("leaf", leaf.meta(leaf.ports[0])["doc"],
+                  "Sharing does not change the first table's metadata",
+                  __LINE__);
+
+    //concurrent first dispatches build the tables once
+    Ports lazy = { HASHED_PORTS };
+    std::vector<std::thread> threads;
+    int found[4] = {0};
+    for(int i = 0; i < 4; ++i)
+        threads.emplace_back([&lazy, &found, i](void) {
+            found[i] = lazy["octave"] && lazy.apropos("/lfo-");
+        });
+    for(std::thread &t : threads)
+        t.join();
+    assert_true(found[0] && found[1] && found[2] && found[3],
+                "Tables are built thread safely", __LINE__);
+}
+
+void test_index_stack(void)
+{
+    RtData d;
+    assert_int_eq(0, d.index(), "Empty index stack reads 0", __LINE__);
+    d.push_index(3);
+    d.push_index(5);
+    assert_int_eq(5, d.idx[0], "Innermost index is on top", __LINE__);
+    assert_int_eq(3, d.index(1), "Outer index is below", __LINE__);
+    d.idx[0] = 6;
+    assert_int_eq(6, d.index(), "Top index can be written", __LINE__);
+    d.pop_index();
+    assert_int_eq(3, d.index(), "Popping restores the outer index",
+                  __LINE__);
+
+    bool all = true;
+    for(int i=0; i<IndexStack::default_depth + 4; ++i)
+        d.push_index(i);
+    assert_int_eq(IndexStack::default_depth + 5, d.idx.size(),
+                  "Indices beyond the capacity are counted", __LINE__);
+    assert_int_eq(0, d.index(), "Indices beyond the capacity read as 0",
+                  __LINE__);
+    for(int i=0; i<5; ++i) //the 3 pushed first takes one slot
+        d.pop_index();
+    assert_int_eq(IndexStack::default_depth - 2, d.index(),
+                  "Stored indices are kept", __LINE__);
+
+    int storage[64];
+    RtData deep;
+    deep.push_index(7);
+    deep.idx.set_storage(storage, 64);
+    for(int i=0; i<40; ++i)
+        deep.push_index(100 + i);
+    for(int i=39; i>=0; --i) {
+        all &= deep.index() == 100 + i;
+        deep.pop_index();
+    }
+    assert_true(all, "External storage holds deep stacks", __LINE__);
+    assert_int_eq(7, deep.index(), "External storage keeps the old indices",
+                  __LINE__);
+
+    RtData copy = d;
+    copy.pop_index();
+    assert_int_eq(IndexStack::default_depth - 2, d.index(),
+                  "Copies have their own stack", __LINE__);
+}
+
+int main()
+{
+    for(int with_loc = 0; with_loc < 2; ++with_loc)
+    {
+        assert_int_eq(1, dispatch("/volume", "f", with_loc, 0.5f),
+                      "Literal port is found", __LINE__);
+        assert_str_eq("volume::f", last_port.c_str(),
+                      "Literal port is the right one", __LINE__);
+
+        assert_int_eq(1, dispatch("/vol", "i", with_loc, 3),
+                      "Prefix of another port is found", __LINE__);
+        assert_str_eq("vol::i", last_port.c_str(),
+                      "Prefix port is the right one", __LINE__);
+
+        assert_int_eq(1, dispatch("/val3", "i", with_loc, 3),
+                      "Enumerated port is found", __LINE__);
+        assert_str_eq("val#16::i", last_port.c_str(),
+                      "Enumerated port is the right one", __LINE__);
+
+        assert_int_eq(0, dispatch("/val16", "i", with_loc, 3),
+                      "Enumerated port honors its bounds", __LINE__);
+
+        assert_int_eq(1, dispatch("/voice7/x", "", with_loc),
+                      "Enumerated subtree is found", __LINE__);
+
+        assert_int_eq(1, dispatch("/v", "", with_loc),
+                      "Shortest port is found", __LINE__);
+
+        assert_int_eq(1, dispatch("/enb", "", with_loc),
+                      "Options in port names are matched", __LINE__);
+
+        assert_int_eq(0, dispatch("/missing", "", with_loc),
+                      "Unknown port is not dispatched", __LINE__);
+    }
+
+    dispatch("/val12", "i", true, 3);
+    assert_str_eq("/val12", last_loc.c_str(),
+                  "Location of enumerated port", __LINE__);
+
+    assert_true(arrays.saveMagic().empty(),
+                "Ports without hash do not serialize one", __LINE__);
+
+    check_hashed(hashed, "Generated hash");
+
+    const std::string magic = hashed.saveMagic();
+    assert_false(magic.empty(), "Hash can be serialized", __LINE__);
+    Ports loaded({ HASHED_PORTS }, magic.data(), magic.size());
+    assert_true(magic == loaded.saveMagic(),
+                "Serialized hash is loaded", __LINE__);
+    check_hashed(loaded, "Loaded hash");
+
+    std::string broken = magic;
+    broken[broken.size()-1] ^= 0x7f;
+    Ports regenerated({ HASHED_PORTS }, broken.data(), broken.size());
+    check_hashed(regenerated, "Mismatching hash is regenerated");
+
+    Ports other({{"volume::f", "", 0, record}, {"pan::c", "", 0, record}},
+                magic.data(), magic.size());
+    check_hashed(other, "Hash of other ports is regenerated");
+
+    std::ostringstream code;
+    code << MagicFormatter{&hashed, "hashed_magic"};
+    assert_int_eq(0, code.str().find("static const uint32_t hashed_magic[] = {"),
+                  "Hash is written as array", __LINE__);
+    std::vector<uint32_t> compiled = parse_magic(code.str());
+    Ports precomputed({ HASHED_PORTS }, (const char*)compiled.data(),
+                      compiled.size()*sizeof(uint32_t));
+    assert_true(magic == precomputed.saveMagic(),
+                "Written hash is loaded", __LINE__);
+    check_hashed(precomputed, "Written hash");
+
+    static const uint32_t stale_magic[] = {0x7274ad01, 14, 0, 0, 1, 1, 0, 0};
+    Ports stale({ HASHED_PORTS }, rMagic(stale_magic));
+    check_hashed(stale, "Stale written hash is regenerated");
+
+    test_dispatch_cache();
+    test_port_callback();
+    test_batch();
+    test_lazy_loc();
+    test_lazy_loc_sugar();
+    test_arg_specs();
+    test_profiler();
+    test_name_lookup();
+    test_compose();
+    test_index_stack();
+    test_prepare();
+
+    return test_summary();
+}
@@ -0,0 +1,102 @@
+#include <rtosc/port-memory.h>
+#include <rtosc/ports.h>
+#include <sstream>
+#include <string>
+#include "common.h"
+
+using namespace rtosc;
+
+static void cb(const char *, RtData &) {}
+//a callable which is kept in a std::function
+struct functor_t
+{
+    int value;
+    void operator()(const char *, RtData &) const {}
+};
+
+static Ports leaf = {
+    {"value::f", ":parameter\0:default\0=0.5\0", 0, cb},
+    {"other::i", "", 0, functor_t{1}},
+};
+//same names as leaf, so both share one matcher
+static Ports twin = {
+    {"value::f", "", 0, cb},
+    {"other::i", "", 0, cb},
+};
+static Ports voice = {
+    {"osc/",   "", &leaf, cb},
+    {"twin/",  "", &twin, cb},
+    {"gain::f", "", 0, cb},
+};
+static Ports root = {
+    {"voice#8/", "", &voice, cb},
+    {"extra/",   "", &leaf, cb},
+};
+
+static void unprepared(void)
+{
+    PortMemoryReport report(root);
+    assert_int_eq(4, report.subtrees.size(), "Each Ports is reported once",
+                  __LINE__);
+    assert_int_eq(0, report.sum.matcher + report.sum.tables,
+                  "Unbuilt tables use no memory", __LINE__);
+    std::ostringstream out;
+    report.print(out);
+    assert_true(out.str().find("not built yet") != std::string::npos,
+                "Report says that tables are not built", __LINE__);
+}
+
+static void prepared(void)
+{
+    root.prepare();
+    PortMemoryReport report(root);
+    const std::vector<PortMemoryReport::subtree_t> &s = report.subtrees;
+    assert_int_eq(4, s.size(), "Each Ports is reported once", __LINE__);
+    assert_str_eq("/", s[0].path.c_str(), "Root comes first", __LINE__);
+    assert_str_eq("/voice#8/", s[1].path.c_str(), "Subtree path", __LINE__);
+    assert_str_eq("/voice#8/osc/", s[2].path.c_str(),
+                  "Shared subtree is reported at the first path", __LINE__);
+    assert_str_eq("/voice#8/twin/", s[3].path.c_str(), "Third level",
+                  __LINE__);
+    assert_int_eq(8, s[1].instances, "Enumerated subtrees are instances",
+                  __LINE__);
+    assert_int_eq(9, s[2].instances, "Instances of all mounts are counted",
+                  __LINE__);
+
+    assert_true(s[2].self.callbacks > 0, "Heap callbacks are counted",
+                __LINE__);
+    assert_int_eq(0, s[3].self.callbacks, "Plain functions use no heap",
+                  __LINE__);
+    assert_true(s[2].self.strings > s[3].self.strings,
+                "Metadata is counted", __LINE__);
+    assert_true(s[2].self.matcher > 0 && s[2].self.tables > 0,
+                "Built tables are counted", __LINE__);
+    assert_int_eq(0, s[3].self.matcher, "Shared matcher is counted once",
+                  __LINE__);
+    assert_true(s[3].self.matcher_id == s[2].self.matcher_id &&
+                s[3].self.matcher_users >= 2,
+                "Equal names share the matcher", __LINE__);
+
+    std::size_t bytes = 0;
+    for(const PortMemoryReport::subtree_t &t : s)
+        bytes += t.bytes;
+    assert_int_eq(bytes, report.total(), "Total is the sum of all tables",
+                  __LINE__);
+    assert_int_eq(s[1].bytes + s[2].bytes + s[3].bytes, s[1].total,
+                  "Subtree totals include the subtrees below", __LINE__);
+    assert_false(s[1].oversized, "Normal hash is not oversized", __LINE__);
+
+    std::ostringstream out;
+    report.print(out, 1);
+    assert_true(out.str().find("/voice#8/\n") != std::string::npos,
+                "Report lists subtrees", __LINE__);
+    assert_true(out.str().find("/voice#8/osc/") == std::string::npos,
+                "Report stops at the maximum depth", __LINE__);
+}
+
+int main()
+{
+    unprepared();
+    prepared();
+    return test_summary();
+}
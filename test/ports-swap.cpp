@@ -0,0 +1,173 @@
+#include <rtosc/ports-swap.h>
+#include <rtosc/ports.h>
+#include <rtosc/rtosc.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "common.h"
+
+using namespace rtosc;
+
+//! A tree whose "value" port replies @p value; it holds @p alive while it
+//! exists, so use_count() tells whether it has been deleted
+static Ports *make_tree(int value, std::shared_ptr<int> alive)
+{
+    return new Ports{
+        {"value:", 0, 0, [value, alive](const char *, RtData &d) {
+                d.reply("/value", "i", value);
+            }},
+    };
+}
+
+struct recorder_t : public RtData
+{
+    recorder_t(void)
+    {
+        memset(buf, 0, sizeof(buf));
+        loc = buf;
+        loc_size = sizeof(buf);
+    }
+    void reply(const char *path, const char *args, ...) override
+    {
+        (void)path;
+        va_list va;
+        va_start(va, args);
+        last = (args[0] == 'i') ? va_arg(va, int) : -1;
+        va_end(va);
+        ++replies;
+    }
+    char buf[128];
+    int last = 0, replies = 0;
+};
+
+static int query(const PortsSwap &swap, const char *path = "value")
+{
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), path, "");
+    recorder_t d;
+    swap.dispatch(msg, d);
+    return d.replies ? d.last : -1;
+}
+
+static void publish_and_reclaim(void)
+{
+    std::shared_ptr<int> first = std::make_shared<int>(),
+                         second = std::make_shared<int>();
+    PortsSwap swap;
+    assert_null(swap.current(), "No initial tree", __LINE__);
+    assert_int_eq(-1, query(swap), "Dispatch without tree does nothing",
+                  __LINE__);
+
+    swap.publish(make_tree(1, first));
+    assert_int_eq(1, query(swap), "Dispatch into the first tree", __LINE__);
+    assert_int_eq(0, swap.reclaim(), "Nothing retired yet", __LINE__);
+
+    swap.publish(make_tree(2, second));
+    assert_int_eq(2, query(swap), "Dispatch into the new tree", __LINE__);
+    assert_int_eq(1, swap.reclaim(),
+                  "Old tree waits for the realtime thread", __LINE__);
+    assert_int_eq(2, first.use_count(), "Old tree is still alive", __LINE__);
+
+    swap.quiescent();
+    assert_int_eq(0, swap.reclaim(), "Old tree reclaimed after quiescent()",
+                  __LINE__);
+    assert_int_eq(1, first.use_count(), "Old tree is deleted", __LINE__);
+    assert_int_eq(2, second.use_count(), "Current tree is alive", __LINE__);
+
+    // a quiescent state before a publish does not cover it
+    swap.publish(make_tree(3, first));
+    swap.publish(make_tree(4, first));
+    assert_int_eq(2, swap.reclaim(), "Two trees retired", __LINE__);
+    swap.quiescent();
+    swap.publish(make_tree(5, first));
+    assert_int_eq(1, swap.reclaim(), "Tree retired after quiescent() waits",
+                  __LINE__);
+    assert_int_eq(1, second.use_count(), "Earlier trees are deleted",
+                  __LINE__);
+}
+
+static void destructor_deletes_all(void)
+{
+    std::shared_ptr<int> alive = std::make_shared<int>();
+    {
+        PortsSwap swap(make_tree(1, alive));
+        swap.publish(make_tree(2, alive));
+        assert_int_eq(3, alive.use_count(), "Two trees alive", __LINE__);
+    }
+    assert_int_eq(1, alive.use_count(), "Destructor deletes all trees",
+                  __LINE__);
+}
+
+static void mounted(void)
+{
+    std::shared_ptr<int> alive = std::make_shared<int>();
+    PortsSwap swap(make_tree(7, alive));
+    Ports root = {
+        swap.port("plugin/", ":documentation\0=swapped plugin\0"),
+        {"other:", 0, 0, [](const char *, RtData &d) {
+                d.reply("/other", "i", 42);
+            }},
+    };
+
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), "/plugin/value", "");
+    recorder_t d;
+    root.dispatch(msg + 1, d, true);
+    assert_int_eq(7, d.last, "Mounted swap dispatches into its tree",
+                  __LINE__);
+
+    swap.publish(make_tree(8, alive));
+    root.dispatch(msg + 1, d, true);
+    assert_int_eq(8, d.last, "Mounted swap sees the new tree", __LINE__);
+    assert_int_eq(2, d.replies, "Each dispatch replied", __LINE__);
+}
+
+static void threaded(void)
+{
+    std::shared_ptr<int> alive = std::make_shared<int>();
+    PortsSwap swap(make_tree(0, alive));
+    std::atomic<bool> stop(false);
+    std::atomic<int> bad(0);
+    std::atomic<int> dispatches(0);
+
+    std::thread rt([&](void) {
+        int prev = 0;
+        while(!stop.load()) {
+            for(int i = 0; i < 8; ++i, ++dispatches) {
+                int v = query(swap);
+                if(v < prev)
+                    ++bad;
+                prev = v;
+            }
+            swap.quiescent();
+        }
+    });
+
+    while(!dispatches)
+        std::this_thread::yield();
+    for(int i = 1; i <= 2000; ++i) {
+        swap.publish(make_tree(i, alive));
+        swap.reclaim();
+    }
+    stop = true;
+    rt.join();
+
+    assert_int_eq(0, bad, "Realtime thread never sees an older tree",
+                  __LINE__);
+    assert_true(dispatches > 0, "Realtime thread dispatched", __LINE__);
+    swap.quiescent();
+    assert_int_eq(0, swap.reclaim(), "All old trees reclaimed", __LINE__);
+    assert_int_eq(2, alive.use_count(), "Only the current tree is alive",
+                  __LINE__);
+}
+
+int main()
+{
+    publish_and_reclaim();
+    destructor_deletes_all();
+    mounted();
+    threaded();
+    return test_summary();
+}
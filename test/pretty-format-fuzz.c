@@ -0,0 +1,330 @@
+/*
+ * Fuzz target for the pretty-format scanner, with a time-per-byte watchdog
+ *
+ * The input is scanned like a savefile by load_from_file(), i.e. message by
+ * message into an arena, and each message is also counted and scanned with
+ * the two pass functions. A scan which takes longer than WATCHDOG_NS_PER_BYTE
+ * per input byte (plus WATCHDOG_NS_BASE) is reported like a crash, so inputs
+ * that scan in quadratic or worse time are found like any other bug.
+ *
+ * Built with -DRTOSC_LIBFUZZER and -fsanitize=fuzzer, this is a libFuzzer
+ * target for the corpus in test/corpus/pretty-format. Otherwise, main()
+ * scans the files given as arguments, mutations of them, and inputs of
+ * growing sizes which must scan in linear time. This ctest version does not
+ * depend on absolute times, which vary with the load of the machine: its
+ * watchdog is off, and the growing inputs only compare times with each
+ * other. They measure the CPU time of the process, which does not count
+ * the time in which other processes run.
+ *
+ * The environment variable RTOSC_FUZZ_NS_PER_BYTE overrides the watchdog's
+ * time per byte, e.g. for sanitizer builds, and turns it on for the ctest
+ * version.
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rtosc/pretty-format.h>
+#include <rtosc/rtosc-time.h>
+
+#define WATCHDOG_NS_PER_BYTE 20000
+#define WATCHDOG_NS_BASE     20000000
+
+//the watchdog's time per byte, or 0 if the watchdog is off
+static uint64_t ns_per_byte(void)
+{
+    static int init = 0;
+    static uint64_t res = 0;
+    if(!init) {
+        const char *env = getenv("RTOSC_FUZZ_NS_PER_BYTE");
+        res = env ? strtoull(env, NULL, 10) : 0;
+#ifdef RTOSC_LIBFUZZER
+        if(!res)
+            res = WATCHDOG_NS_PER_BYTE;
+#endif
+        init = 1;
+    }
+    return res;
+}
+
+//scan all messages of the nul-terminated text, like a savefile
+static void scan_text(const char *text, size_t len)
+{
+    char portname[1024];
+    //scanned strings never need more space than the input
+    const size_t strbuf_size = 2 * len + 64;
+    char *strbuf = malloc(strbuf_size);
+    rtosc_arg_val_t *args = NULL;
+    size_t args_size = 0;
+
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    rtosc_arg_val_arena_intern(&arena, 1);
+
+    for(const char *msg = text; *msg; )
+    {
+        size_t rd;
+        int nargs = rtosc_scan_message_arena(msg, portname, sizeof(portname),
+                                             &arena, &rd);
+        if(nargs < 0 || !rd)
+            break;
+
+        //the two pass scanner must accept the same message
+        int counted = rtosc_count_printed_arg_vals_of_msg(msg);
+        if(counted != nargs) {
+            fprintf(stderr, "count %d, but arena scanned %d values at:\n%.*s\n",
+                    counted, nargs, (int)rd, msg);
+            abort();
+        }
+        if(nargs > 0) {
+            if((size_t)nargs > args_size) {
+                args_size = nargs;
+                args = realloc(args, args_size * sizeof(*args));
+            }
+            rtosc_scan_message(msg, portname, sizeof(portname), args, nargs,
+                               strbuf, strbuf_size);
+        }
+
+        msg += rd;
+        rtosc_arg_val_arena_clear(&arena);
+    }
+
+    //the scanner is also used for argument lists without address
+    rtosc_count_printed_arg_vals(text);
+
+    rtosc_arg_val_arena_destroy(&arena);
+    free(args);
+    free(strbuf);
+}
+
+//scan the input, abort if it was too slow
+static void run(const uint8_t *data, size_t size)
+{
+    char *text = malloc(size + 1);
+    memcpy(text, data, size);
+    text[size] = 0;
+    const size_t len = strlen(text);
+
+    const uint64_t start = rtosc_monotonic_ns();
+    scan_text(text, len);
+    const uint64_t elapsed = rtosc_monotonic_ns() - start;
+
+    if(ns_per_byte() && elapsed > WATCHDOG_NS_BASE + ns_per_byte() * len) {
+        fprintf(stderr, "watchdog: %llu ns for %lu bytes, input starts with:\n"
+                "%.256s\n", (unsigned long long)elapsed, (unsigned long)len,
+                text);
+        abort();
+    }
+    free(text);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    run(data, size);
+    return 0;
+}
+
+#ifndef RTOSC_LIBFUZZER
+
+#include "common.h"
+
+static uint32_t rng_state = 0x12345678;
+static uint32_t rng(void)
+{
+    //xorshift, to get the same mutations on each run
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+//bytes that are significant for the scanner
+static const char tokens[] = "[]. \"'\\x0123456789-+e%\n/abfhmINTS(),:";
+
+/*
+ * mutate the seed into buf: replace and insert significant bytes, and
+ * repeat spans, which makes long arrays, strings and ranges
+ */
+static size_t mutate(const char *seed, size_t seed_len, char *buf, size_t max)
+{
+    size_t len = seed_len < max ? seed_len : max;
+    memcpy(buf, seed, len);
+    const unsigned steps = 1 + rng() % 8;
+    for(unsigned s = 0; s < steps && len; ++s)
+    {
+        const size_t pos = rng() % len;
+        switch(rng() % 4)
+        {
+            case 0:
+                buf[pos] = tokens[rng() % (sizeof(tokens) - 1)];
+                break;
+            case 1:
+                if(len < max) {
+                    memmove(buf + pos + 1, buf + pos, len - pos);
+                    buf[pos] = tokens[rng() % (sizeof(tokens) - 1)];
+                    ++len;
+                }
+                break;
+            case 2:
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                --len;
+                break;
+            default:
+            {
+                const size_t span = 1 + rng() % 16;
+                const unsigned times = 1 + rng() % 256;
+                if(pos + span > len)
+                    break;
+                for(unsigned t = 0; t < times && len + span <= max; ++t) {
+                    memmove(buf + pos + span, buf + pos, len - pos);
+                    len += span;
+                }
+            }
+        }
+    }
+    return len;
+}
+
+//prefix, repeated unit and suffix of inputs that grow
+static const char *growing[][3] = {
+    {"/a [", "1 ", "]\n"},
+    {"/a ", "1 ", "\n"},
+    {"/a ", "[", "\n"},
+    {"/a ", "[1 ", "\n"},
+    {"/a [", "[0 1] ", "... ]\n"},
+    {"/a \"", "x", "\"\n"},
+    {"/a \"", "\\\"", "\n"},
+    {"/a ", "1 ... ", "2\n"},
+    {"/a 1 2 ", "... ", "\n"},
+    {"/a ", "'a' ", "... 'z'\n"},
+    {"/a ", "3x", "1\n"},
+    {"/a ", "3x0.5 ", "\n"},
+    {"/a BLOB [1", " 0x00", "]\n"},
+    {"/a MIDI [", "0x00 ", "]\n"},
+    {"/a ", "Symbol", "\n"},
+    {"", "/voice", "/volume 1\n"},
+    {"", "/a 1\n", ""},
+    {"", "% comment\n", "/a 1\n"},
+    {"/a ", " ", "1\n"},
+    {"/a ", "\n    1", "\n"},
+    {"/a 2016-11-16 00:00:00", "0", "\n"},
+    {"/a ", "0", ".5\n"},
+};
+
+static char *repeat(const char *const *pattern, unsigned n, size_t *len)
+{
+    const size_t plen = strlen(pattern[0]), ulen = strlen(pattern[1]),
+                 slen = strlen(pattern[2]);
+    *len = plen + n * ulen + slen;
+    char *res = malloc(*len + 1), *pos = res;
+    memcpy(pos, pattern[0], plen);
+    pos += plen;
+    for(unsigned i = 0; i < n; ++i, pos += ulen)
+        memcpy(pos, pattern[1], ulen);
+    memcpy(pos, pattern[2], slen + 1);
+    return res;
+}
+
+//CPU time of this process in ns
+static uint64_t cpu_ns(void)
+{
+#ifdef _WIN32
+    return rtosc_monotonic_ns();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//best of three CPU times of scanning the text, per byte
+static double time_per_byte(const char *text, size_t len)
+{
+    uint64_t best = UINT64_MAX;
+    for(int i = 0; i < 3; ++i) {
+        const uint64_t start = cpu_ns();
+        run((const uint8_t*)text, len);
+        const uint64_t t = cpu_ns() - start;
+        if(t < best)
+            best = t;
+    }
+    return (double)best / len;
+}
+
+/*
+ * scan each growing input with 16 times more units, which must not take
+ * more than 4 times longer per byte. Other processes can still slow down
+ * single measurements, e.g. through the caches, so each input gets a few
+ * tries.
+ */
+static void growth(void)
+{
+    enum { small = 1024, large = 16 * small, tries = 5 };
+    for(size_t i = 0; i < sizeof(growing) / sizeof(growing[0]); ++i)
+    {
+        size_t small_len, large_len;
+        char *small_text = repeat(growing[i], small, &small_len);
+        char *large_text = repeat(growing[i], large, &large_len);
+        double t_small = 0, t_large = 0;
+        for(int t = 0; t < tries; ++t) {
+            t_small = time_per_byte(small_text, small_len);
+            t_large = time_per_byte(large_text, large_len);
+            if(t_large < 4 * t_small + 1)
+                break;
+        }
+
+        char testcase[128];
+        snprintf(testcase, sizeof(testcase),
+                 "linear time for \"%s\"... (%.1f vs %.1f ns per byte)",
+                 growing[i][1], t_small, t_large);
+        //the small input takes at least 1 ns, else the ratio is meaningless
+        assert_true(t_large < 4 * t_small + 1, testcase, __LINE__);
+        free(small_text);
+        free(large_text);
+    }
+}
+
+static char *read_file(const char *filename, size_t *len)
+{
+    FILE *fp = fopen(filename, "rb");
+    if(!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *res = malloc(*len + 1);
+    *len = fread(res, 1, *len, fp);
+    res[*len] = 0;
+    fclose(fp);
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    enum { mutations = 2000, max_mutated = 1 << 16 };
+    char *buf = malloc(max_mutated);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        size_t len = 0;
+        char *seed = read_file(argv[i], &len);
+        if(!assert_non_null(seed, argv[i], __LINE__)) {
+            run((const uint8_t*)seed, len);
+            for(int m = 0; m < mutations; ++m)
+                run((const uint8_t*)buf, mutate(seed, len, buf, max_mutated));
+            assert_true(1, "scan the mutations of the seed", __LINE__);
+        }
+        free(seed);
+    }
+    free(buf);
+
+    growth();
+
+    return test_summary();
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include <assert.h>
+#include <limits.h>
 #include <rtosc/rtosc.h>
 #include <rtosc/pretty-format.h>
+#include <rtosc/arg-val-cmp.h>
 #include "common.h"
 
 rtosc_arg_val_t scanned[32];
@@ -89,7 +91,7 @@ void scan_and_print_single()
         timestamps
     */
     rtosc_print_options lossy = ((rtosc_print_options) { false, 3, " ", 80,
-                                                         true });
+                                                         true, false });
     check_alt("1970-01-02 00:00:00", NULL, "one day after the epoch", __LINE__,
               "1970-01-02");
     check("2016-11-16 19:44:06", NULL, "a timestamp", __LINE__);
@@ -113,7 +115,7 @@ void scan_and_print_single()
     */
     // saving this as a float will lose precision
     rtosc_print_options prec6 = ((rtosc_print_options) { true, 6, " ", 80,
-                                                         true });
+                                                         true, false });
     check_alt("1234567890.098700d", &prec6,
               "a double that would not fit into a float", __LINE__,
               "1234567890.098700d (0x1.26580b486511ap+30)");
@@ -128,12 +130,34 @@ void scan_and_print_single()
     check_alt("0.0f (-0x1.8p+0)", NULL, "the zero float (0.0f)", __LINE__,
               "-1.50 (-0x1.8p+0)");
     rtosc_print_options prec0 = ((rtosc_print_options) { true, 0, " ", 80,
-                                                         true });
+                                                         true, false });
     // this float may not lose its period (otherwise,
     // it would be read as an int!)
     check_alt("1.", &prec0, "a float with zero precision", __LINE__,
               "1. (0x1p+0)");
     check_alt("1e1", &lossy, "the float 1e1", __LINE__, "10.000");
+    check_alt("1234567890.0987d (0x1.26580b486511ap+30)", &prec6,
+              "a double with lossless part", __LINE__,
+              "1234567890.098700d (0x1.26580b486511ap+30)");
+
+    // shortest representations need no lossless part
+    rtosc_print_options shortest = ((rtosc_print_options) { true, 2, " ", 80,
+                                                            true, true });
+    check("0.1", &shortest, "the shortest float 0.1", __LINE__);
+    check_alt("1.", &shortest, "the shortest float 1", __LINE__, "1.0");
+    check("-0.00001", &shortest, "a small shortest float", __LINE__);
+    check("1.0e-06", &shortest, "a shortest float in exponent notation",
+          __LINE__);
+    check("123456790.0", &shortest, "a large shortest float", __LINE__);
+    check_alt("0.0f (0x1.fffffep+127)", &shortest, "the largest float",
+              __LINE__, "3.4028235e+38");
+    check_alt("0.0f (0x1p-149)", &shortest, "the smallest float",
+              __LINE__, "1.0e-45");
+    check("0.3d", &shortest, "the shortest double 0.3", __LINE__);
+    check("1234567890.0987d", &shortest, "a shortest double", __LINE__);
+    check("5.0e-324d", &shortest, "the smallest double", __LINE__);
+    check("1.7976931348623157e+308d", &shortest, "the largest double",
+          __LINE__);
 
     /*
         chars
@@ -183,7 +207,7 @@ void scan_and_print_single()
         identifiers aka symbols
     */
     rtosc_print_options shortline_9 = ((rtosc_print_options) { true, 3, " ", 9,
-                                                               true });
+                                                               true, false });
     check("an_identifier_42", NULL, "a simple identifier", __LINE__);
     check("_", NULL, "the identifier \"_\"", __LINE__);
     check("truely falseeee infinite nilpferd immediatelyly nowhere MIDINOTE",
@@ -220,7 +244,7 @@ void scan_and_print_single()
         linebreaks
     */
     rtosc_print_options shortline = ((rtosc_print_options) { true, 3, " ", 10,
-                                                             true });
+                                                             true, false });
     check_alt("\"0123456789012345678\"", &shortline,
               "string exceeding line length", __LINE__,
               "\"0123456\"\\\n"
@@ -253,7 +277,7 @@ void arrays()
     check("[]", NULL, "empty array", __LINE__);
 
     rtosc_print_options shortline = ((rtosc_print_options)
-                                     { true, 3, " ", 12, true });
+                                     { true, 3, " ", 12, true, false });
     // TODO: arrays with strings print newline positions wrong
     //       write *one* generic function rtosc_insert_newlines?
     check("[\"123\" \"45\" \"\"\\\n    \"6\"]", &shortline,
@@ -270,9 +294,11 @@ void arrays()
 void ranges()
 {
     rtosc_print_options uncompressed = ((rtosc_print_options) { false, 3, " ",
-                                                                10, false });
+                                                                10, false,
+                                                                false });
     rtosc_print_options simplefloats = ((rtosc_print_options) { false, 2, " ",
-                                                                80, true });
+                                                                80, true,
+                                                                false });
 
     /*
         with delta
@@ -372,9 +398,11 @@ void scan_ranges()
         no range conversion
      */
     rtosc_print_options uncompressed = ((rtosc_print_options) { false, 3, " ",
-                                                                80, false });
+                                                                80, false,
+                                                                false });
     rtosc_print_options simplefloats = ((rtosc_print_options) { false, 2, " ",
-                                                                80, true });
+                                                                80, true,
+                                                                false });
     check("0 1 2 3", NULL, "too less args for range conversion", __LINE__);
     check("0.00 1.00 2.00 3.00 4.00", &simplefloats,
           "wrong type for range conversion", __LINE__);
@@ -480,7 +508,7 @@ void messages()
     char printed[len];
     memset(printed, 0x7f, len); /* init with rubbish */
     rtosc_print_options shortline = ((rtosc_print_options) { true, 3, " ", 7,
-                                                             true });
+                                                             true, false });
     size_t written = rtosc_print_message("/noteOn", scanned, num,
                                          printed, len, &shortline, 0);
 
@@ -497,6 +525,316 @@ void messages()
                             "/second_param 123", msgbuf, msgbuflen,
                             scanned, 0, strbuf, strbuflen);
     assert_int_eq(13, rd, "scan message without arguments", __LINE__);
+
+    // a comment line between the address and the first argument
+    input = "/volume\n% comment\n    v";
+    num = rtosc_count_printed_arg_vals_of_msg(input);
+    assert_int_eq(1, num, "count arguments after a comment line", __LINE__);
+    rd = rtosc_scan_message(input, msgbuf, msgbuflen, scanned, 1,
+                            strbuf, strbuflen);
+    assert_int_eq(strlen(input), rd, "scan arguments after a comment line",
+                  __LINE__);
+    assert_char_eq('S', scanned[0].type,
+                   "scan the argument after a comment line", __LINE__);
+}
+
+void scan_arena()
+{
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    char address[64];
+    size_t rd;
+
+    const char* input = "%a savefile\n"
+                        "/noteOn 0 1 2 % a noteOn message\n"
+                        "/name \"a string which is longer than the initial "
+                        "string buffer of the arena, so it needs to grow "
+                        "while the arena already holds strings, which must "
+                        "still be valid afterwards. Long, isn't it? Still "
+                        "need some more characters.\" \"second\"\n"
+                        "/range [1 2 ... 5]\n";
+    int nargs = rtosc_scan_message_arena(input, address, sizeof(address),
+                                         &arena, &rd);
+    assert_int_eq(3, nargs, "scan a message into an arena", __LINE__);
+    assert_str_eq("/noteOn", address, "scan the address", __LINE__);
+    assert_int_eq(2, arena.args[2].val.i, "scan the arguments", __LINE__);
+    input += rd;
+
+    nargs = rtosc_scan_message_arena(input, address, sizeof(address),
+                                     &arena, &rd);
+    assert_int_eq(2, nargs, "append a message to the arena", __LINE__);
+    assert_int_eq(5, arena.nargs, "the arena holds all arguments", __LINE__);
+    assert_str_eq("second", arena.args[4].val.s, "scan strings", __LINE__);
+    // the arena has grown while the second string was scanned
+    assert_true(!strncmp("a string which", arena.args[3].val.s, 14),
+                "strings stay valid when the arena grows", __LINE__);
+    input += rd;
+
+    int count = rtosc_count_printed_arg_vals_of_msg(input);
+    nargs = rtosc_scan_message_arena(input, address, sizeof(address),
+                                     &arena, &rd);
+    assert_int_eq(count, nargs, "count ranges like the counting pre-pass",
+                  __LINE__);
+    assert_int_eq('a', arena.args[5].type, "scan arrays with ranges",
+                  __LINE__);
+    input += rd;
+
+    nargs = rtosc_scan_message_arena(input, address, sizeof(address),
+                                     &arena, &rd);
+    assert_int_eq(INT_MIN, nargs, "detect the end of the messages", __LINE__);
+
+    rtosc_arg_val_arena_clear(&arena);
+    const char* invalid = "/invalid 1 2 (3)";
+    nargs = rtosc_scan_message_arena(invalid, address, sizeof(address),
+                                     &arena, &rd);
+    assert_int_eq(rtosc_count_printed_arg_vals_of_msg(invalid), nargs,
+                  "report errors like the counting pre-pass", __LINE__);
+    // "2 (3)" is an error, since only floats may have a lossless part
+    assert_int_eq(1, arena.nargs, "keep the arguments before an error",
+                  __LINE__);
+    assert_int_eq(-1, rtosc_scan_message_arena("no/address", address,
+                                               sizeof(address), &arena, &rd),
+                  "messages must start with a slash", __LINE__);
+
+    rtosc_arg_val_arena_destroy(&arena);
+    assert_null(arena.args, "destroy the arena", __LINE__);
+}
+
+void append_to_arena()
+{
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+
+    char str[] = "copied string";
+    uint8_t blob[] = { 1, 2, 3 };
+    rtosc_arg_val_t args[3];
+    args[0].type = 'i'; args[0].val.i = 42;
+    args[1].type = 's'; args[1].val.s = str;
+    args[2].type = 'b'; args[2].val.b.len = 3; args[2].val.b.data = blob;
+    assert_true(rtosc_arg_val_arena_append(&arena, args, 3),
+                "append values to an arena", __LINE__);
+    str[0] = 'X';
+    blob[0] = 9;
+    assert_int_eq(42, arena.args[0].val.i, "appended int", __LINE__);
+    assert_str_eq("copied string", arena.args[1].val.s,
+                  "appended strings are copied", __LINE__);
+    assert_int_eq(1, arena.args[2].val.b.data[0],
+                  "appended blobs are copied", __LINE__);
+
+    // grow the arena while it holds strings
+    char long_str[300];
+    memset(long_str, 'a', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = 0;
+    args[1].val.s = long_str;
+    assert_true(rtosc_arg_val_arena_append(&arena, args + 1, 1),
+                "append an argument requiring growth", __LINE__);
+    assert_int_eq(4, arena.nargs, "the arena holds all arguments", __LINE__);
+    assert_str_eq("copied string", arena.args[1].val.s,
+                  "strings stay valid when appending", __LINE__);
+    assert_int_eq(299, strlen(arena.args[3].val.s), "appended long string",
+                  __LINE__);
+
+    rtosc_arg_val_arena_destroy(&arena);
+}
+
+void intern_in_arena()
+{
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    assert_true(rtosc_arg_val_arena_intern(&arena, true),
+                "switch interning on", __LINE__);
+    char address[64];
+    size_t rd;
+
+    const char* input = "/a \"sine\" \"saw\" \"sine\"\n"
+                        "/b [\"saw\" \"square\" \"sine\"] \"saw\"\n"
+                        "/c BLOB [2 0x01 0x02] \"tri\" BLOB [2 0x01 0x02]\n";
+    for(int i = 0; i < 3; ++i)
+    {
+        assert_true(rtosc_scan_message_arena(input, address, sizeof(address),
+                                             &arena, &rd) > 0,
+                    "scan messages into an interning arena", __LINE__);
+        input += rd;
+    }
+    const rtosc_arg_val_t* a = arena.args;
+    assert_str_eq("sine", a[2].val.s, "interned strings keep their values",
+                  __LINE__);
+    assert_true(a[0].val.s == a[2].val.s && a[0].val.s == a[6].val.s,
+                "equal strings are stored once", __LINE__);
+    assert_true(a[1].val.s == a[4].val.s && a[1].val.s == a[7].val.s,
+                "equal strings in arrays are stored once", __LINE__);
+    assert_str_eq("square", a[5].val.s, "distinct strings", __LINE__);
+    assert_true(a[8].val.b.data == a[10].val.b.data && a[8].val.b.len == 2 &&
+                a[8].val.b.data[1] == 2, "equal blobs are stored once",
+                __LINE__);
+    assert_int_eq(strlen("sine saw square tri ") + 2, arena.strbuf_used,
+                  "only distinct data is stored", __LINE__);
+
+    // appended values are interned, too, and old strings never move
+    const char* sine = a[0].val.s;
+    char long_str[600];
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = 0;
+    rtosc_arg_val_t args[2];
+    args[0].type = 's'; args[0].val.s = long_str;
+    args[1].type = 'S'; args[1].val.s = "square";
+    assert_true(rtosc_arg_val_arena_append(&arena, args, 2),
+                "append to an interning arena", __LINE__);
+    assert_true(arena.args[12].val.s == arena.args[5].val.s,
+                "appended strings are interned", __LINE__);
+    assert_true(sine == arena.args[0].val.s && !strcmp(sine, "sine"),
+                "strings do not move when the arena grows", __LINE__);
+
+    rtosc_arg_val_arena_clear(&arena);
+    args[0].val.s = "sine";
+    rtosc_arg_val_arena_append(&arena, args, 1);
+    assert_int_eq(5, arena.strbuf_used, "clearing forgets interned strings",
+                  __LINE__);
+
+    rtosc_arg_val_arena_destroy(&arena);
+    assert_null(arena.interned, "destroy the interning table", __LINE__);
+}
+
+typedef struct
+{
+    char buffer[16384];
+    size_t len;
+    size_t calls;
+    size_t limit; //!< stop if more bytes are passed
+} sink_data_t;
+
+int append_to_sink(const char* str, size_t len, void* data)
+{
+    sink_data_t* sink = (sink_data_t*)data;
+    if(sink->len + len > sink->limit)
+        return 1;
+    memcpy(sink->buffer + sink->len, str, len);
+    sink->len += len;
+    sink->buffer[sink->len] = 0;
+    ++sink->calls;
+    return 0;
+}
+
+sink_data_t sink;
+char printed[16384];
+
+void print_to_sink()
+{
+    const char* inputs[] = {
+        "0 1 2 3",
+        "0.5 \"a string\" 'c' #deadbeef MIDI [0x00 0x90 0x40 0x7f]",
+        "\"a long string with a line break\nand another line, which is "
+        "longer than the line length\"",
+        "[1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20]",
+        "[] [\"x\" \"y\"] [1.0 1.0 1.0 1.0 1.0 1.0]",
+        "1 2 3 4 5 6 7 8 9 10 0.1 0.2 0.3 0.4 0.5",
+        "[0 1] [0 1] [0 1] [0 1] [0 1] 'a' 'b' 'c' 'd' 'e'",
+        "2016-11-16 19:44:06 true false nil inf -5000000000h"
+    };
+    rtosc_print_options opts[] = {
+        { true, 3, " ", 80, true, false },
+        { true, 2, " ", 10, true, false },
+        { false, 2, " ", 7, false, false },
+        { true, 2, " ", 20, true, true }
+    };
+    char line[256];
+    int strbuflen = 256;
+    char strbuf[strbuflen];
+    rtosc_arg_val_t args[64];
+
+    for(size_t i = 0; i < sizeof(inputs)/sizeof(inputs[0]); ++i)
+    for(size_t o = 0; o < sizeof(opts)/sizeof(opts[0]); ++o)
+    {
+        int num = rtosc_count_printed_arg_vals(inputs[i]);
+        assert(num > 0 && num < 64);
+        rtosc_scan_arg_vals(inputs[i], args, num, strbuf, strbuflen);
+
+        memset(printed, 0, sizeof(printed));
+        rtosc_print_message("/some/port", args, num, printed, sizeof(printed),
+                            opts + o, 0);
+        sink.len = 0;
+        sink.limit = sizeof(sink.buffer) - 1;
+        size_t written = rtosc_print_message_to_sink("/some/port", args, num,
+                                                     append_to_sink, &sink,
+                                                     opts + o, 0);
+        snprintf(line, sizeof(line),
+                 "print input %d with options %d to a sink", (int)i, (int)o);
+        assert_str_eq(printed, sink.buffer, line, __LINE__);
+        snprintf(line, sizeof(line),
+                 "sink gets the length of input %d with options %d",
+                 (int)i, (int)o);
+        assert_int_eq(strlen(printed), written, line, __LINE__);
+    }
+
+    // huge arrays are passed in chunks
+    static rtosc_arg_val_t huge[2001];
+    huge[0].type = 'a';
+    huge[0].val.a.type = 'i';
+    huge[0].val.a.len = 2000;
+    for(int i = 1; i <= 2000; ++i) {
+        huge[i].type = 'i';
+        huge[i].val.i = i * 7;
+    }
+    rtosc_print_options uncompressed = { true, 2, " ", 80, false, false };
+    printed[0] = ' ';
+    rtosc_print_arg_vals(huge, 2001, printed + 1, sizeof(printed) - 1,
+                         &uncompressed, 0);
+    sink.len = sink.calls = 0;
+    rtosc_print_arg_vals_to_sink(huge, 2001, append_to_sink, &sink,
+                                 &uncompressed, 0);
+    assert_str_eq(printed + 1, sink.buffer, "print huge arrays to a sink",
+                  __LINE__);
+    assert_true(sink.calls > 1, "pass huge arrays in chunks", __LINE__);
+
+    sink.len = 0;
+    sink.limit = 100;
+    size_t written = rtosc_print_arg_vals_to_sink(huge, 2001, append_to_sink,
+                                                  &sink, &uncompressed, 0);
+    assert_int_eq(sink.len, written, "the sink can stop printing", __LINE__);
+    assert_true(written <= 100, "no text is passed after stopping", __LINE__);
+}
+
+void large_ranges()
+{
+    // 3000 ints with delta, 1000 repeated ints, 100 repeated doubles
+    static rtosc_arg_val_t args[4101], scanned[4101];
+    args[0].type = 'a';
+    args[0].val.a.type = 'i';
+    args[0].val.a.len = 4000;
+    for(int i = 1; i <= 3000; ++i) {
+        args[i].type = 'i';
+        args[i].val.i = i - 1;
+    }
+    for(int i = 3001; i <= 4000; ++i) {
+        args[i].type = 'i';
+        args[i].val.i = 5;
+    }
+    for(int i = 4001; i <= 4100; ++i) {
+        args[i].type = 'd';
+        args[i].val.d = 0.25;
+    }
+
+    char printed[1024];
+    rtosc_print_options opt = { false, 2, " ", 80, true, false };
+    printed[0] = ' ';
+    rtosc_print_arg_vals(args, 4101, printed + 1, sizeof(printed) - 1,
+                         &opt, 0);
+    assert_str_eq("[0 ... 2999 1000x5] 100x0.25d", printed + 1,
+                  "large arrays are compressed into ranges", __LINE__);
+
+    int num = rtosc_count_printed_arg_vals(printed + 1);
+    assert_true(num > 0, "count large ranges", __LINE__);
+    char strbuf[1];
+    rtosc_scan_arg_vals(printed + 1, scanned, num, strbuf, 1);
+    assert_true(rtosc_arg_vals_eq(args, scanned, 4101, num, NULL),
+                "large ranges are expanded correctly", __LINE__);
+
+    // an almost-range must not be compressed
+    args[1500].val.i = -1;
+    rtosc_print_arg_vals(args, 4001, printed + 1, sizeof(printed) - 1,
+                         &opt, 0);
+    assert_str_eq("[0 ... 1498 -1 1500 ... 2999 1000x5]", printed + 1,
+                  "broken ranges are split", __LINE__);
 }
 
 void scan_invalid()
@@ -658,6 +996,11 @@ int main()
     ranges();
 
     messages();
+    scan_arena();
+    append_to_arena();
+    intern_in_arena();
+    print_to_sink();
+    large_ranges();
 
     scan_invalid();
 
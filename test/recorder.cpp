@@ -0,0 +1,141 @@
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/recorder.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "common.h"
+
+using namespace rtosc;
+
+struct Synth
+{
+    int   note = 0;
+    float gain = 0.0f;
+    int   notes_played = 0;
+    static const Ports ports;
+};
+
+#define rObject Synth
+const Ports Synth::ports = {
+    {"note:i", "", 0, [](const char *m, RtData &d) {
+        Synth &s = *(Synth*)d.obj;
+        s.note = rtosc_argument(m, 0).i;
+        ++s.notes_played; }},
+    rParamF(gain, "Gain"),
+};
+#undef rObject
+
+//one second in NTP time
+static const uint64_t second = 1ull << 32;
+static const uint64_t t0     = 3900000000ull << 32;
+
+char path[] = "/tmp/rtosc-recorder-XXXXXX";
+char buffer[256];
+
+void record(void)
+{
+    const int fd = mkstemp(path);
+    assert_true(fd >= 0, "temporary file", __LINE__);
+    close(fd);
+
+    Recorder rec(128, 64);
+    assert_true(rec.open(path), "log opens", __LINE__);
+
+    for(int i=0; i<200; ++i) {
+        rtosc_message(buffer, sizeof(buffer), "/note", "i", i);
+        rec.record(buffer, t0 + i * (second/100));
+        if(i%32 == 31) //the ring buffer holds 64 messages
+            rec.flush();
+    }
+    rtosc_message(buffer, sizeof(buffer), "/gain", "f", 0.5f);
+    rec.record(buffer, t0 + 2*second);
+    char too_long[160];
+    memset(too_long, 'x', sizeof(too_long)-1);
+    too_long[sizeof(too_long)-1] = 0;
+    rtosc_message(buffer, sizeof(buffer), "/note", "s", too_long);
+    rec.record(buffer, t0 + 3*second);
+    assert_int_eq(9, rec.flush(), "too long messages are not recorded",
+                  __LINE__);
+    assert_int_eq(201, rec.size(), "all messages are recorded", __LINE__);
+    rec.close();
+    assert_false(rec.is_open(), "log closes", __LINE__);
+
+    const uint64_t now = Recorder::now();
+    assert_true(now > t0 - 1000*second, "now() is an NTP timestamp",
+                __LINE__);
+}
+
+void replay(void)
+{
+    LogReplay log;
+    assert_true(log.open(path), "log can be replayed", __LINE__);
+    assert_int_eq(201, log.size(), "all records are read", __LINE__);
+    assert_true(log.first_timetag() == t0, "first timetag", __LINE__);
+    assert_true(log.last_timetag() == t0 + 2*second, "last timetag",
+                __LINE__);
+
+    uint64_t tt;
+    const char *msg = log.next(&tt);
+    assert_str_eq("/note", msg, "records hold the messages", __LINE__);
+    assert_int_eq(0, rtosc_argument(msg, 0).i, "records hold the arguments",
+                  __LINE__);
+
+    log.seek(t0 + 150 * (second/100));
+    msg = log.next(&tt);
+    assert_int_eq(150, rtosc_argument(msg, 0).i, "seek by time", __LINE__);
+    log.seek(t0 + 70 * (second/100) - 1);
+    assert_int_eq(70, rtosc_argument(log.next(), 0).i,
+                  "seek to the next record", __LINE__);
+    log.seek(t0 + 10*second);
+    assert_null(log.next(), "seek behind the end", __LINE__);
+
+    Synth synth;
+    char loc[128];
+    RtData d;
+    d.loc      = loc;
+    d.loc_size = sizeof(loc);
+    d.obj      = &synth;
+
+    log.seek(t0 + 100 * (second/100));
+    assert_int_eq(50, log.replay(Synth::ports, d, LogReplay::max_speed,
+                                 t0 + 149 * (second/100)),
+                  "replay up to a time", __LINE__);
+    assert_int_eq(149, synth.note, "replay dispatches", __LINE__);
+    assert_int_eq(51, log.replay(Synth::ports, d), "replay the rest",
+                  __LINE__);
+    assert_int_eq(199, synth.note, "replay in order", __LINE__);
+    assert_flt_eq(0.5f, synth.gain, "replay to all ports", __LINE__);
+    assert_int_eq(100, synth.notes_played, "replay each message once",
+                  __LINE__);
+
+    log.rewind();
+    d.obj = &synth;
+    const uint64_t until = t0 + 10 * (second/100);
+    log.replay(Synth::ports, d, LogReplay::original_speed, until);
+    assert_int_eq(10, synth.note, "replay at original speed", __LINE__);
+    log.close();
+    assert_int_eq(0, log.size(), "closed logs are empty", __LINE__);
+
+    //a log which has not been closed ends with zeros
+    FILE *f = fopen(path, "ab");
+    const char zeros[64] = {0};
+    fwrite(zeros, 1, sizeof(zeros), f);
+    fclose(f);
+    assert_true(log.open(path), "unfinished logs can be replayed", __LINE__);
+    assert_int_eq(201, log.size(), "unfinished logs have all records",
+                  __LINE__);
+    log.close();
+
+    unlink(path);
+    assert_false(log.open(path), "missing logs can not be opened", __LINE__);
+}
+
+int main()
+{
+    record();
+    replay();
+    return test_summary();
+}
@@ -0,0 +1,134 @@
+#include <rtosc/reply-bundler.h>
+#include <rtosc/ports.h>
+#include <rtosc/rtosc.h>
+#include <rtosc/thread-link.h>
+#include <string>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+//! Records what it would send
+struct sink_t
+{
+    std::vector<std::string> replies, broadcasts;
+    ReplyBundler::sink_t sink(void)
+    {
+        return [this](const char *msg, std::size_t len, bool broadcast) {
+            (broadcast ? broadcasts : replies).emplace_back(msg, len);
+        };
+    }
+};
+
+static const Ports ports = {
+    {"dump:i", 0, 0, [](const char *m, RtData &d) {
+            for(int i = 0; i < rtosc_argument(m, 0).i; ++i)
+                d.reply("/value", "i", i);
+        }},
+    {"set:i", 0, 0, [](const char *m, RtData &d) {
+            d.reply("/undo_change", "ii", 0, rtosc_argument(m, 0).i);
+            d.broadcast("/set", "i", rtosc_argument(m, 0).i);
+            char msg[64];
+            rtosc_message(msg, sizeof(msg), "/set2", "i", 2);
+            d.broadcast(msg);
+        }},
+    {"long:i", 0, 0, [](const char *, RtData &d) {
+            d.reply("/long", "s", std::string(300, 'x').c_str());
+            d.reply("/short", "");
+        }},
+};
+
+static void dispatch(ReplyBundler &b, const char *path, int arg)
+{
+    char loc[64] = "", msg[64];
+    rtosc_message(msg, sizeof(msg), path, "i", arg);
+    b.loc = loc;
+    b.loc_size = sizeof(loc);
+    b.dispatch(ports, msg);
+}
+
+static std::size_t elements(const std::string &bundle)
+{
+    return rtosc_bundle_p(bundle.data())
+         ? rtosc_bundle_elements(bundle.data(), bundle.size()) : 0;
+}
+
+void many_replies(void)
+{
+    sink_t sink;
+    ReplyBundler b(sink.sink());
+    dispatch(b, "/dump", 10);
+    assert_int_eq(1, sink.replies.size(), "replies go out as one message",
+                  __LINE__);
+    assert_int_eq(10, elements(sink.replies[0]), "all replies are bundled",
+                  __LINE__);
+    const char *third = rtosc_bundle_fetch(sink.replies[0].data(), 2);
+    assert_str_eq("/value", third, "bundled reply", __LINE__);
+    assert_int_eq(2, rtosc_argument(third, 0).i, "replies keep their order",
+                  __LINE__);
+    assert_int_eq(10, b.messages(), "messages are counted", __LINE__);
+    assert_int_eq(1, b.bundles(), "bundles are counted", __LINE__);
+}
+
+void full_bundles(void)
+{
+    sink_t sink;
+    //a bundle header, and four elements of 4+16 bytes
+    ReplyBundler b(sink.sink(), 16 + 4*20);
+    dispatch(b, "/dump", 10);
+    assert_int_eq(3, sink.replies.size(), "full bundles are passed on",
+                  __LINE__);
+    assert_int_eq(4, elements(sink.replies[0]), "bundles are filled",
+                  __LINE__);
+    assert_int_eq(2, elements(sink.replies[2]), "the rest is flushed",
+                  __LINE__);
+
+    dispatch(b, "/long", 0);
+    assert_int_eq(5, sink.replies.size(), "too long messages pass alone",
+                  __LINE__);
+    assert_str_eq("/long", sink.replies[3].data(), "the long message",
+                  __LINE__);
+    assert_str_eq("/short", sink.replies[4].data(),
+                  "a single message is not bundled", __LINE__);
+}
+
+void broadcasts(void)
+{
+    sink_t sink;
+    ReplyBundler b(sink.sink());
+    dispatch(b, "/set", 5);
+    assert_int_eq(1, sink.replies.size(), "one reply", __LINE__);
+    assert_str_eq("/undo_change", sink.replies[0].data(),
+                  "single replies are passed on as they are", __LINE__);
+    assert_int_eq(1, sink.broadcasts.size(), "broadcasts are bundled apart",
+                  __LINE__);
+    assert_int_eq(2, elements(sink.broadcasts[0]), "both broadcasts",
+                  __LINE__);
+
+    dispatch(b, "/dump", 0);
+    assert_int_eq(1, sink.replies.size(), "nothing pending, nothing sent",
+                  __LINE__);
+}
+
+void links(void)
+{
+    ThreadLink link(1024, 4);
+    ReplyBundler b(ReplyBundler::link_sink(link));
+    dispatch(b, "/dump", 3);
+    std::size_t len = 0;
+    assert_int_eq(1, link.read_all([](const char *msg, size_t n, void *data) {
+                assert_true(rtosc_bundle_p(msg), "the link gets a bundle",
+                            __LINE__);
+                *(std::size_t*)data = n;
+            }, &len), "one write to the link", __LINE__);
+    assert_int_eq(16 + 3*(4+16), len, "bundle length", __LINE__);
+}
+
+int main()
+{
+    many_replies();
+    full_bundles();
+    broadcasts();
+    links();
+    return test_summary();
+}
@@ -0,0 +1,205 @@
+#include <rtosc/rt-checker.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/rtosc.h>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+struct Voice
+{
+    std::vector<int> notes;
+    float volume = 0.5f;
+    static const Ports ports;
+};
+
+struct Synth
+{
+    Voice voice;
+    float volume = 1.0f;
+    std::mutex lock;
+    int locked = 0;
+    static const Ports ports;
+};
+
+#define rObject Voice
+const Ports Voice::ports = {
+    rParamF(volume, "clean"),
+    {"note::i", 0, 0, [](const char *m, RtData &d) {
+            ((Voice*)d.obj)->notes.push_back(0);
+            (void)m;
+        }},
+};
+#undef rObject
+
+#define rObject Synth
+const Ports Synth::ports = {
+    rParamF(volume, "clean"),
+    rRecur(voice, "a voice"),
+    {"locking:", 0, 0, [](const char *, RtData &d) {
+            Synth &s = *(Synth*)d.obj;
+            std::lock_guard<std::mutex> guard(s.lock);
+            ++s.locked;
+        }},
+    {"sleep:", 0, 0, [](const char *, RtData &) {
+            RtChecker::note("sleep");
+            RtChecker::note("sleep");
+        }},
+    {"hidden:", rProp(internal), 0, [](const char *, RtData &) {
+            RtChecker::note("hidden");
+        }},
+};
+#undef rObject
+
+struct tester_t
+{
+    RtChecker checker;
+    Synth synth;
+    char loc[128];
+
+    tester_t(void) { Synth::ports.prepare(); }
+
+    void send(const char *path, const char *args = "")
+    {
+        char msg[128];
+        rtosc_message(msg, sizeof(msg), path, args, 3);
+        RtData d;
+        d.loc = loc;
+        d.loc_size = sizeof(loc);
+        d.obj = &synth;
+        d.checker = &checker;
+        Synth::ports.dispatch(msg, d, true);
+    }
+
+    const RtChecker::violation_t *find(const char *call) const
+    {
+        for(unsigned i = 0; i < checker.violations(); ++i)
+            if(!strcmp(checker.violation(i).call, call))
+                return &checker.violation(i);
+        return NULL;
+    }
+};
+
+void clean_ports(void)
+{
+    tester_t t;
+    t.send("/volume", "f");
+    t.send("/volume");
+    t.send("/voice/volume");
+    assert_int_eq(0, t.checker.violations(), "clean ports have no violations",
+                  __LINE__);
+    assert_int_eq(2, t.checker.size(), "clean ports are timed", __LINE__);
+    assert_int_eq(2, t.checker.stats(0).calls, "calls are counted", __LINE__);
+    assert_str_eq("/volume", t.checker.stats(0).path, "timed path", __LINE__);
+    assert_non_null(t.checker.worst(), "worst time is recorded", __LINE__);
+    assert_false(RtChecker::active(), "checker is inactive after dispatch",
+                 __LINE__);
+}
+
+void reported_calls(void)
+{
+    tester_t t;
+    t.send("/sleep");
+    t.send("/sleep");
+    assert_int_eq(1, t.checker.violations(), "equal calls are merged",
+                  __LINE__);
+    const RtChecker::violation_t *v = t.find("sleep");
+    assert_non_null(v, "reported call is a violation", __LINE__);
+    if(v) {
+        assert_int_eq(4, v->count, "reported calls are counted", __LINE__);
+        assert_str_eq("/sleep", v->path, "path of the violation", __LINE__);
+    }
+
+    //outside of checked callbacks, nothing is recorded
+    RtChecker::note("sleep");
+    assert_int_eq(4, t.find("sleep")->count, "unchecked calls are ignored",
+                  __LINE__);
+    t.checker.reset();
+    assert_int_eq(0, t.checker.violations(), "reset drops violations",
+                  __LINE__);
+    assert_int_eq(0, t.checker.size(), "reset drops times", __LINE__);
+}
+
+void interposed_calls(void)
+{
+    if(!RtChecker::interposed())
+        return;
+    tester_t t;
+    for(int i = 0; i < 16; ++i)
+        t.send("/voice/note", "i");
+    t.send("/locking");
+    const RtChecker::violation_t *v = t.find("malloc");
+    assert_non_null(v, "allocations are found", __LINE__);
+    if(v)
+        assert_str_eq("/voice/note", v->path, "path of the allocation",
+                      __LINE__);
+    v = t.find("pthread_mutex_lock");
+    assert_non_null(v, "locks are found", __LINE__);
+    if(v)
+        assert_str_eq("/locking", v->path, "path of the lock", __LINE__);
+    assert_int_eq(1, t.synth.locked, "checked callbacks still run", __LINE__);
+}
+
+void exercise(void)
+{
+    tester_t t;
+    std::size_t n = t.checker.exercise(Synth::ports, &t.synth);
+    assert_int_eq(5, n, "all leaf ports but internal ones are called",
+                  __LINE__);
+    assert_non_null(t.find("sleep"), "exercise finds violations", __LINE__);
+    assert_true(!t.find("hidden"), "internal ports are skipped", __LINE__);
+    if(RtChecker::interposed()) {
+        const RtChecker::violation_t *v = t.find("malloc");
+        assert_non_null(v, "exercise finds allocations", __LINE__);
+        if(v)
+            assert_str_eq("/voice/note", v->path, "path from exercise",
+                          __LINE__);
+    }
+}
+
+void unprepared_ports(void)
+{
+    //a tree of its own, which no other test has prepared
+#define rObject Synth
+    const Ports ports = {
+        rRecur(voice, "a voice"),
+    };
+#undef rObject
+    tester_t t;
+    char msg[128];
+    rtosc_message(msg, sizeof(msg), "/voice/volume", "");
+    RtData d;
+    d.loc = t.loc;
+    d.loc_size = sizeof(t.loc);
+    d.obj = &t.synth;
+    d.checker = &t.checker;
+    ports.dispatch(msg, d, true);
+    ports.dispatch(msg, d, true);
+    const RtChecker::violation_t *v = t.find("Ports::build_tables");
+    assert_non_null(v, "dispatch into unprepared ports is reported",
+                    __LINE__);
+    if(v) {
+        assert_int_eq(1, v->count, "only the first dispatch builds",
+                      __LINE__);
+        assert_str_eq("/voice/volume", v->path, "path of the build",
+                      __LINE__);
+    }
+
+    t.checker.reset();
+    ports.dispatch(msg, d, true);
+    assert_int_eq(0, t.checker.violations(), "prepared ports are clean",
+                  __LINE__);
+}
+
+int main()
+{
+    clean_ports();
+    reported_calls();
+    interposed_calls();
+    exercise();
+    unprepared_ports();
+    return test_summary();
+}
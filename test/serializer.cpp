@@ -15,6 +15,7 @@ class SubObject
 {
     public:
         int foobar;
+        char name[512];
         static Ports ports;
 };
 
@@ -43,7 +44,8 @@ Ports Object::ports = {
 #undef  rObject
 #define rObject SubObject
 Ports SubObject::ports = {
-    rToggle(foobar, "a boolean object")
+    rToggle(foobar, "a boolean object"),
+    rString(name, 512, "a long string")
 };
 
 //TODO there should be some way to go through this and figure out what the size
@@ -70,6 +72,8 @@ void run_test(void)
     o.foo = 12;
     o.bar = 0.0f;
     o.baz.foobar = 0;
+    memset(o.baz.name, 'x', 400);
+    o.baz.name[400] = 0;
     memset(o.blam, 0, sizeof(o.blam));
     o.blam[32] = 45;
     o.blam[12] = 80;
@@ -86,15 +90,17 @@ void run_test(void)
     o.bar = 128.0f;
     o.foo = 0;
     o.baz.foobar = 1;
+    strcpy(o.baz.name, "short");
     o.blam[32] = 120;
     o.blam[12] = 3;
     o.blam[2] = 5;
     o.blam[1] = 2;
 
     //Save Second Image
-    //Sizes must be identical due to OSC format
+    //Sizes only differ by the string
     sizeb = subtree_serialize(bufferb, sizeof(bufferb), &o, &Object::ports);
-    assert(sizeb == sizea);
+    assert(sizeb == sizea - 404 + 8);
+    assert(subtree_serialize(bufferc, 256, &o, &Object::ports) == 0);
 
     //Reload Save State 1
     subtree_deserialize(buffera, sizea, &o, &Object::ports, d);
@@ -103,12 +109,36 @@ void run_test(void)
     assert(o.baz.foobar == 0);
     assert(o.blam[32] == 45);
     assert(o.blam[12] == 80);
+    assert(strlen(o.baz.name) == 400);
 
     //Reload Save State 2
     subtree_deserialize(bufferb, sizeb, &o, &Object::ports, d);
     assert(o.baz.foobar == 1);
     assert(o.blam[12] == 3);
     assert(o.blam[2]  == 5);
+    assert(!strcmp(o.baz.name, "short"));
+
+    //Subtrees are sub-bundles, growable bundles have no size limit
+    const std::vector<char> image = subtree_serialize(&o, Object::ports);
+    assert(image.size() == sizeb);
+    bool sub_bundle = false;
+    for(unsigned i=0; i<rtosc_bundle_elements(image.data(), image.size()); ++i)
+        sub_bundle |= !!rtosc_bundle_p(rtosc_bundle_fetch(image.data(), i));
+    assert(sub_bundle);
+
+    //Diffs only contain the changed values
+    std::vector<char> diff = subtree_diff(buffera, sizea, image.data(),
+                                          image.size());
+    assert(rtosc_bundle_elements(diff.data(), diff.size()) == 8);
+    diff = subtree_diff(image.data(), image.size(), image.data(),
+                        image.size());
+    assert(rtosc_bundle_elements(diff.data(), diff.size()) == 0);
+
+    //Applying a diff to the first state gives the second one
+    subtree_deserialize(buffera, sizea, &o, &Object::ports, d);
+    diff = subtree_diff(buffera, sizea, image.data(), image.size());
+    subtree_deserialize(diff.data(), diff.size(), &o, &Object::ports, d);
+    assert(subtree_serialize(&o, Object::ports) == image);
 }
 
 int main(int, char**)
@@ -102,5 +102,43 @@ int main()
         assert_int_eq(sizeof(ref3), sz, "correct buffer size", __LINE__);
     }
 
+    //The contiguous length scan must agree with the one for split rings
+    printf("#Check message lengths against split rings\n");
+    const char *msgs[4];
+    char m1[64], m2[64], m3[64], m4[64];
+    rtosc_message(m1, 64, "/testing", "is", 23, "this string");
+    rtosc_message(m2, 64, "m", "bb", 4, buffer2, 1, buffer2);
+    rtosc_message(m3, 64, "/a/b/c", "Tfhs", 1.0f, (int64_t)3, "");
+    rtosc_message(m4, 64, "/x", "");
+    msgs[0] = m1; msgs[1] = m2; msgs[2] = m3; msgs[3] = m4;
+    int same = 1;
+    for(int i=0; i<4; ++i) {
+        const size_t full = rtosc_message_length(msgs[i], -1);
+        for(size_t len=0; len<=full; ++len) {
+            const size_t flat = rtosc_message_length(msgs[i], len);
+            same &= flat == (len == full ? full : 0);
+            for(size_t split=1; split<len; ++split) {
+                ring_t ring[2] = {{(char*)msgs[i], split},
+                                  {(char*)msgs[i]+split, len-split}};
+                same &= rtosc_message_ring_length(ring) == flat;
+            }
+        }
+        //a complete first segment followed by more data
+        ring_t ring[2] = {{(char*)msgs[i], full}, {m1, sizeof(m1)}};
+        same &= rtosc_message_ring_length(ring) == full;
+    }
+    assert_true(same, "Message lengths agree for all splits and truncations",
+                __LINE__);
+
+    sz = rtosc_message(buffer, 256, "/testing", "is", 23, "this string");
+    assert_true(rtosc_valid_message_p(buffer, sz), "Valid Message", __LINE__);
+    assert_false(rtosc_valid_message_p(buffer, sz-4),
+                 "Truncated Message Is Invalid", __LINE__);
+    assert_false(rtosc_valid_message_p(buffer, 0),
+                 "Empty Message Is Invalid", __LINE__);
+    buffer[3] = '\t';
+    assert_false(rtosc_valid_message_p(buffer, sz),
+                 "Unprintable Path Is Invalid", __LINE__);
+
     return test_summary();
 }
@@ -0,0 +1,148 @@
+#include <rtosc/stream-framer.h>
+#include <rtosc/rtosc.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "common.h"
+
+using namespace rtosc;
+
+typedef StreamFramer::framing_t framing_t;
+
+static std::string message(int i, size_t blob_len)
+{
+    std::vector<char> blob(blob_len);
+    for(size_t j=0; j<blob_len; ++j)
+        blob[j] = (char)(0xc0 + (i+j)%32); //includes the SLIP bytes
+    char buf[4096];
+    size_t len = rtosc_message(buf, sizeof(buf), "/stream", "ib", i,
+                               (int32_t)blob_len, blob.data());
+    return std::string(buf, len);
+}
+
+static std::string framed(framing_t f, const std::string &msg)
+{
+    std::vector<char> buf(StreamFramer::max_framed_length(f, msg.size()));
+    size_t len = StreamFramer::frame(f, msg.data(), msg.size(), buf.data(),
+                                     buf.size());
+    return std::string(buf.data(), len);
+}
+
+//feed @p stream in chunks of @p chunk bytes, collect all messages
+static std::vector<std::string> feed(StreamFramer &framer,
+                                     const std::string &stream, size_t chunk)
+{
+    std::vector<std::string> got;
+    for(size_t pos = 0; pos < stream.size();) {
+        size_t len;
+        char *space = framer.write_space(&len);
+        if(len > chunk)
+            len = chunk;
+        if(len > stream.size() - pos)
+            len = stream.size() - pos;
+        if(!len)
+            break;
+        memcpy(space, stream.data() + pos, len);
+        framer.commit(len);
+        pos += len;
+        framer.read_all([&](const char *msg, size_t n) {
+                got.push_back(std::string(msg, n));
+            });
+    }
+    return got;
+}
+
+void split_streams(framing_t f, const char *name)
+{
+    std::vector<std::string> msgs;
+    std::string stream;
+    for(int i=0; i<20; ++i) {
+        msgs.push_back(message(i, 4*i));
+        stream += framed(f, msgs.back());
+    }
+
+    //chunk sizes from single bytes up to everything at once, the small
+    //ring makes messages wrap around
+    int ok = 1;
+    for(size_t chunk : {1, 3, 7, 64, 1000, 100000}) {
+        StreamFramer framer(f, 128, 300);
+        ok &= feed(framer, stream, chunk) == msgs;
+        ok &= !framer.pending() && !framer.dropped();
+    }
+    assert_true(ok, name, __LINE__);
+}
+
+void slip_escapes(void)
+{
+    const char msg[] = {'/', 'e', 0, 0, ',', 'b', 0, 0, 0, 0, 0, 4,
+                        (char)0xc0, (char)0xdb, (char)0xdc, (char)0xdd};
+    char buf[64];
+    size_t len = StreamFramer::frame(StreamFramer::SLIP, msg, sizeof(msg),
+                                     buf, sizeof(buf));
+    const char expected[] = {(char)0xc0, '/', 'e', 0, 0, ',', 'b', 0, 0,
+                             0, 0, 0, 4, (char)0xdb, (char)0xdc,
+                             (char)0xdb, (char)0xdd, (char)0xdc, (char)0xdd,
+                             (char)0xc0};
+    assert_int_eq(sizeof(expected), len, "SLIP escapes END and ESC",
+                  __LINE__);
+    assert_true(!memcmp(buf, expected, len), "SLIP frame is encoded",
+                __LINE__);
+    assert_int_eq(0, StreamFramer::frame(StreamFramer::SLIP, msg,
+                                         sizeof(msg), buf, len-1),
+                  "frames do not overflow the buffer", __LINE__);
+}
+
+void dropping(framing_t f, const char *name)
+{
+    const std::string big   = message(1, 200);
+    const std::string small = message(2, 8);
+    const std::string invalid("not osc\0", 8);
+    std::string stream = framed(f, big) + framed(f, small) +
+                         framed(f, invalid) + framed(f, small);
+
+    StreamFramer framer(f, 128);
+    std::vector<std::string> got = feed(framer, stream, 5);
+    assert_int_eq(2, got.size(), name, __LINE__);
+    assert_true(got.size() == 2 && got[0] == small && got[1] == small,
+                "the stream continues after dropped messages", __LINE__);
+    assert_int_eq(2, framer.dropped(), "oversized and invalid are dropped",
+                  __LINE__);
+}
+
+void sockets(void)
+{
+    int fds[2];
+    assert_int_eq(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds),
+                  "socket pair is created", __LINE__);
+    const std::string big = message(3, 3000);
+    std::string stream;
+    for(int i=0; i<3; ++i)
+        stream += framed(StreamFramer::LENGTH_PREFIX, big);
+    assert_int_eq(stream.size(), write(fds[0], stream.data(), stream.size()),
+                  "stream is written", __LINE__);
+    close(fds[0]);
+
+    StreamFramer framer(StreamFramer::LENGTH_PREFIX, 4096);
+    int n = 0, ok = 1;
+    while(framer.read_from(fds[1]) > 0)
+        n += framer.read_all([&](const char *msg, size_t len) {
+                ok &= std::string(msg, len) == big;
+            });
+    close(fds[1]);
+    assert_int_eq(3, n, "large messages are read from the stream", __LINE__);
+    assert_true(ok, "large messages are read intact", __LINE__);
+}
+
+int main()
+{
+    split_streams(StreamFramer::LENGTH_PREFIX,
+                  "length prefixed messages are split at any byte");
+    split_streams(StreamFramer::SLIP, "SLIP messages are split at any byte");
+    slip_escapes();
+    dropping(StreamFramer::LENGTH_PREFIX, "length prefixed dropping");
+    dropping(StreamFramer::SLIP, "SLIP dropping");
+    sockets();
+    return test_summary();
+}
@@ -0,0 +1,244 @@
+#include <rtosc/sync.h>
+#include <rtosc/broadcaster.h>
+#include <rtosc/ports.h>
+#include <rtosc/port-sugar.h>
+#include <rtosc/rtosc.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+struct Channel
+{
+    static const rtosc::Ports& ports;
+    int gain = 64;
+    int pan  = 0;
+};
+
+#define rObject Channel
+static const Ports channel_ports = {
+    rParamI(gain, rDefault(64), "gain"),
+    rParamI(pan, rDefault(0), "panning")
+};
+#undef rObject
+
+const rtosc::Ports& Channel::ports = channel_ports;
+
+struct Mixer
+{
+    Channel channel[4];
+    int tempo = 120;
+};
+
+#define rObject Mixer
+static const Ports mixer_ports = {
+    rRecurs(channel, 4, "channels"),
+    rParamI(tempo, rDefault(120), "tempo")
+};
+#undef rObject
+
+//a remote UI, which applies the messages to its own copy of the mixer
+struct remote_t
+{
+    Mixer mixer;
+    SyncClient client;
+    int applied = 0;
+    std::vector<std::vector<char>> inbox;
+
+    SyncServer::send_t send(void)
+    {
+        return [this](const char *packet, size_t len) {
+            inbox.emplace_back(packet, packet + len);
+        };
+    }
+
+    //apply all received packets, return false if one was not accepted
+    bool receive(void)
+    {
+        bool ok = true;
+        for(const std::vector<char> &packet : inbox)
+            ok &= client.receive(packet.data(), packet.size(),
+                                 [this](const char *msg, size_t) {
+                    char loc[128];
+                    RtData d;
+                    d.loc = loc;
+                    d.loc_size = sizeof(loc);
+                    d.obj = &mixer;
+                    *d.loc = 0;
+                    mixer_ports.dispatch(msg, d, true);
+                    ++applied;
+                });
+        inbox.clear();
+        return ok;
+    }
+
+    int connect(SyncServer &server)
+    {
+        char msg[64];
+        client.connect_message(msg, sizeof(msg));
+        return server.connect(msg, send());
+    }
+};
+
+struct session_t
+{
+    Mixer mixer;
+    Broadcaster broadcaster;
+    SyncServer server;
+
+    explicit session_t(size_t capacity)
+        :server(mixer_ports, &mixer, capacity)
+    {
+        broadcaster.subscribe(server.sink());
+    }
+
+    //change a value, like a UI would, and broadcast the change
+    void set(const char *path, int value)
+    {
+        char msg[64], loc[128];
+        rtosc_message(msg, sizeof(msg), path, "i", value);
+        BroadcastData d(broadcaster);
+        d.loc = loc;
+        d.loc_size = sizeof(loc);
+        d.obj = &mixer;
+        *d.loc = 0;
+        mixer_ports.dispatch(msg, d, true);
+    }
+
+    void tick(void)
+    {
+        broadcaster.flush();
+        server.flush();
+    }
+};
+
+bool same(const Mixer &a, const Mixer &b)
+{
+    bool res = a.tempo == b.tempo;
+    for(int i = 0; i < 4; ++i)
+        res &= a.channel[i].gain == b.channel[i].gain &&
+               a.channel[i].pan == b.channel[i].pan;
+    return res;
+}
+
+void snapshot_and_deltas(void)
+{
+    session_t s(64);
+    s.set("/channel1/gain", 10);
+    s.set("/tempo", 90);
+    s.tick();
+    assert_int_eq(2, s.server.sequence(), "changes are numbered", __LINE__);
+
+    remote_t ui;
+    assert_int_eq(0, ui.connect(s.server), "client connects", __LINE__);
+    assert_true(ui.receive(), "snapshot is accepted", __LINE__);
+    assert_true(ui.client.synced(), "client is synced", __LINE__);
+    assert_int_eq(2, ui.client.sequence(), "snapshot includes the changes",
+                  __LINE__);
+    assert_true(same(s.mixer, ui.mixer), "snapshot restores the state",
+                __LINE__);
+
+    const int applied = ui.applied;
+    s.set("/channel3/pan", -5);
+    s.set("/channel1/gain", 11);
+    s.tick();
+    assert_true(ui.receive(), "deltas are accepted", __LINE__);
+    assert_int_eq(applied + 2, ui.applied, "only the changes are sent",
+                  __LINE__);
+    assert_int_eq(4, ui.client.sequence(), "sequence of the deltas",
+                  __LINE__);
+    assert_true(same(s.mixer, ui.mixer), "deltas follow the state", __LINE__);
+
+    assert_int_eq(0, s.server.flush(), "no packets without changes",
+                  __LINE__);
+}
+
+void resume(void)
+{
+    session_t s(8);
+    remote_t ui;
+    ui.connect(s.server);
+    ui.receive();
+
+    //the remote UI goes away, while the session keeps changing
+    s.server.disconnect(0);
+    assert_int_eq(0, s.server.clients(), "client is disconnected", __LINE__);
+    s.set("/channel0/gain", 1);
+    s.set("/channel2/gain", 2);
+    s.tick();
+
+    const int before = ui.applied;
+    assert_int_eq(1, ui.connect(s.server), "client reconnects", __LINE__);
+    assert_true(ui.receive(), "resume is accepted", __LINE__);
+    assert_int_eq(before + 2, ui.applied,
+                  "reconnecting only sends the missed changes", __LINE__);
+    assert_true(same(s.mixer, ui.mixer), "resumed state", __LINE__);
+
+    //too many changes since the last connection lead to a snapshot
+    s.server.disconnect(1);
+    for(int i = 0; i < 20; ++i)
+        s.set("/tempo", 100 + i);
+    s.tick();
+    assert_false(s.server.can_resume(ui.client.sequence()),
+                 "the changes are not kept anymore", __LINE__);
+    const int before_snapshot = ui.applied;
+    ui.connect(s.server);
+    assert_true(ui.receive(), "snapshot is accepted", __LINE__);
+    assert_true(ui.applied - before_snapshot < 20,
+                "a snapshot instead of all changes", __LINE__);
+    assert_true(same(s.mixer, ui.mixer), "state after the snapshot",
+                __LINE__);
+
+    //a server with other sequence numbers sends a snapshot
+    session_t other(8);
+    other.set("/tempo", 60);
+    other.tick();
+    ui.connect(other.server);
+    assert_true(ui.receive(), "other server's snapshot", __LINE__);
+    assert_int_eq(60, ui.mixer.tempo, "state of the other server", __LINE__);
+}
+
+void lost_packets(void)
+{
+    session_t s(64);
+    remote_t ui;
+    ui.connect(s.server);
+    ui.receive();
+
+    s.set("/tempo", 1);
+    s.tick();
+    ui.inbox.clear(); //lost
+    s.set("/tempo", 2);
+    s.tick();
+    assert_false(ui.receive(), "a gap is detected", __LINE__);
+    assert_false(ui.client.synced(), "client is not synced", __LINE__);
+
+    s.server.disconnect(0);
+    ui.connect(s.server);
+    assert_true(ui.receive(), "reconnect after a gap", __LINE__);
+    assert_true(ui.client.synced(), "client is synced again", __LINE__);
+    assert_int_eq(2, ui.mixer.tempo, "missed changes are applied", __LINE__);
+
+    //a repeated packet is not applied twice
+    s.set("/tempo", 3);
+    s.tick();
+    ui.inbox.push_back(ui.inbox.back());
+    const int before = ui.applied;
+    assert_true(ui.receive(), "repeated packets are accepted", __LINE__);
+    assert_int_eq(before + 1, ui.applied, "changes are applied once",
+                  __LINE__);
+
+    assert_int_eq(-1, s.server.connect("/foo\0\0\0\0,\0\0\0", ui.send()),
+                  "other messages are no connects", __LINE__);
+}
+
+int main()
+{
+    snapshot_and_deltas();
+    resume();
+    lost_packets();
+
+    return test_summary();
+}
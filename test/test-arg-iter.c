@@ -119,6 +119,54 @@ int main()
 
     CHECK(rtosc_valid_message_p(buffer, message_len));
 
+    //decode plans decode the same values as the iterator
+    rtosc_decode_plan_t plan;
+    CHECK(rtosc_decode_plan_init(&plan, rtosc_argument_string(buffer)));
+    CHECK(plan.nargs == 15);
+    CHECK(plan.native_size == 0);
+    CHECK(rtosc_decode_plan_matches(&plan, buffer));
+    rtosc_arg_t args[16];
+    CHECK(rtosc_plan_decode(&plan, buffer, args, 16) == 15);
+    CHECK(args[0].i == i);
+    CHECK(args[1].f == f);
+    CHECK(!strcmp(args[2].s, s));
+    CHECK(args[3].b.len == 3 && !memcmp(args[3].b.data, "str", 3));
+    CHECK(args[4].h == h);
+    CHECK(args[5].t == t);
+    CHECK(args[6].d == d);
+    CHECK(!strcmp(args[7].s, S));
+    CHECK(args[8].i == c);
+    CHECK(args[9].i == r);
+    CHECK(!memcmp(args[10].m, m, 4));
+    CHECK(args[11].T && !args[12].T);
+    CHECK(rtosc_plan_decode(&plan, buffer, args, 2) == 2);
+    CHECK(rtosc_plan_decode_native(&plan, buffer, args, sizeof(args)) == 0);
+
+    //runs of fixed size types are decoded in bulk
+    char native_msg[256];
+    rtosc_message(native_msg, sizeof(native_msg), "/v", "[iii]ffTd",
+                  1, 2, 3, 0.5f, -1.5f, 2.25);
+    CHECK(rtosc_decode_plan_init(&plan, "[iii]ffTd"));
+    CHECK(plan.nruns == 4);
+    CHECK(plan.runs[0].type == 'i' && plan.runs[0].count == 3);
+    CHECK(plan.native_size == 32);
+    CHECK(rtosc_decode_plan_matches(&plan, native_msg));
+    CHECK(!rtosc_decode_plan_matches(&plan, buffer));
+    union { double d; int32_t i; } native[4];
+    CHECK(rtosc_plan_decode_native(&plan, native_msg, native, 16) == 0);
+    CHECK(rtosc_plan_decode_native(&plan, native_msg, native,
+                                   sizeof(native)) == 32);
+    const int32_t *ints = (const int32_t*)native;
+    const float *floats = (const float*)(ints + 3);
+    CHECK(ints[0] == 1 && ints[1] == 2 && ints[2] == 3);
+    CHECK(floats[0] == 0.5f && floats[1] == -1.5f);
+    CHECK(native[3].d == 2.25);
+
+    //too many runs
+    CHECK(!rtosc_decode_plan_init(&plan,
+        "ifififififififififififififififififi"));
+    CHECK(!rtosc_decode_plan_init(&plan, "iXi"));
+
 
 #if 0
     rtosc_arg_t speed_check[4096];
@@ -2,6 +2,9 @@
 #include <rtosc/automations.h>
 #include <rtosc/port-sugar.h>
 #include "common.h"
+#include <cmath>
+#include <atomic>
+#include <thread>
 
 struct Dummy {
     float foo;
@@ -14,6 +17,19 @@ rtosc::Ports p = {
     rParamF(bar, rLinear(0, 100.2), "no doc"),
 };
 
+struct Typed {
+    int   num;
+    bool  on;
+};
+
+#undef rObject
+#define rObject Typed
+rtosc::Ports typed_ports = {
+    rParamI(num, rLinear(0, 10), "int parameter"),
+    rToggle(on, "toggle parameter"),
+};
+#undef rObject
+
 void suite(const char *s)
 { 
     printf("\n\n#SUITE: %s\n", s);
@@ -186,6 +202,38 @@ void test_midi_learn(void)
     assert_flt_eq(-1, d.foo, "Slot to min makes bound parameter min", __LINE__);
 }
 
+void test_nrpn_learn(void)
+{
+    suite("test_nrpn_learn");
+    rtosc::AutomationMgr mgr(4, 2, 16);
+    Dummy d = {0,0};
+    mgr.set_ports(p);
+    mgr.backend = [&d](const char *msg) {
+        rtosc::RtData rd;
+        char loc[128];
+        rd.loc = loc;
+        rd.loc_size = sizeof(loc);
+        rd.obj = &d; p.dispatch(msg, rd, true);};
+
+    mgr.createBinding(0, "/foo", true);
+    mgr.handleMidi(0, C_nrpnhi, 1);
+    mgr.handleMidi(0, C_nrpnlo, 2);
+    assert_int_eq(1, mgr.slots[0].learning,
+            "Parameter number alone is not learned", __LINE__);
+    mgr.handleMidi(0, C_dataentryhi, 0);
+    mgr.handleMidi(0, C_dataentrylo, 0);
+    assert_int_eq((1<<7)|2, mgr.slots[0].midi_nrpn, "NRPN is captured",
+            __LINE__);
+
+    mgr.handleMidi(0, C_dataentryhi, 127);
+    mgr.handleMidi(0, C_dataentrylo, 127);
+    assert_flt_eq(10, d.foo, "NRPN max makes bound parameter max", __LINE__);
+    int parhi, parlo, valhi, vallo;
+    assert_int_eq(0, mgr.getnrpn(&parhi, &parlo, &valhi, &vallo),
+            "NRPN state is known", __LINE__);
+    assert_int_eq(127, vallo, "NRPN state has data", __LINE__);
+}
+
 void test_macro_learn(void)
 {
     suite("test_macro_learn");
@@ -266,6 +314,131 @@ void test_curve_lerp(void)
     assert_flt_eq(-1, d.foo, "Minimum is correct", __LINE__);
 }
 
+void test_preencoded(void)
+{
+    suite("test_preencoded");
+    rtosc::AutomationMgr mgr(4, 2, 16);
+    mgr.set_ports(typed_ports);
+    char sent[256] = {0};
+    mgr.backend = [&sent](const char *msg) {
+        memcpy(sent, msg, rtosc_message_length(msg, -1));};
+
+    mgr.createBinding(0, "/num", false);
+    mgr.createBinding(1, "/on", false);
+    mgr.setSlot(0, 0.7);
+    assert_str_eq("/num", sent, "Template has the path", __LINE__);
+    assert_str_eq("i", rtosc_argument_string(sent), "Template has the type",
+            __LINE__);
+    assert_int_eq(7, rtosc_argument(sent, 0).i, "Int is patched", __LINE__);
+    mgr.setSlot(0, 0.2);
+    assert_int_eq(2, rtosc_argument(sent, 0).i, "Int is patched again",
+            __LINE__);
+
+    mgr.setSlot(1, 1);
+    assert_str_eq("/on", sent, "Toggle path", __LINE__);
+    assert_str_eq("T", rtosc_argument_string(sent), "Toggle is set", __LINE__);
+    mgr.setSlot(1, 0);
+    assert_str_eq("F", rtosc_argument_string(sent), "Toggle is cleared",
+            __LINE__);
+
+    mgr.setSlotSubPath(0, 0, "/on");
+    mgr.setSlot(0, 1);
+    assert_str_eq("/on", sent, "Template follows new path", __LINE__);
+    assert_str_eq("T", rtosc_argument_string(sent), "New path has new type",
+            __LINE__);
+
+    sent[0] = 0;
+    mgr.clearSlot(1);
+    mgr.setSlot(1, 1);
+    assert_str_eq("", sent, "Cleared slot sends nothing", __LINE__);
+}
+
+void test_block(void)
+{
+    suite("test_block");
+    rtosc::AutomationMgr mgr(4, 2, 16);
+    Dummy d = {0,0};
+    int sent = 0;
+    mgr.set_ports(p);
+    mgr.backend = [&d, &sent](const char *msg) {
+        rtosc::RtData rd;
+        char loc[128];
+        rd.loc = loc;
+        rd.loc_size = sizeof(loc);
+        rd.obj = &d; p.dispatch(msg, rd, true);
+        ++sent;};
+    mgr.createBinding(0, "/foo", false);
+
+    mgr.queueSlot(0, 0.5);
+    mgr.queueSlot(0, 1);
+    assert_int_eq(0, sent, "Queueing sends nothing", __LINE__);
+    mgr.process(4);
+    assert_int_eq(1, sent, "Last queued value is sent once", __LINE__);
+    assert_flt_eq(10, d.foo, "Queued value is applied", __LINE__);
+    mgr.process(4);
+    mgr.queueSlot(0, 1);
+    mgr.process(4);
+    assert_int_eq(1, sent, "Unchanged values are not sent", __LINE__);
+
+    auto &map = mgr.slots[0].automations[0].map;
+    float points[] = {0, -1, 0.5, 0, 1, 10};
+    memcpy(map.control_points, points, sizeof(points));
+    map.control_type = 1;
+    map.upoints = 3;
+    mgr.queueSlot(0, 0.75);
+    mgr.process(4);
+    assert_flt_eq(5, d.foo, "Piecewise linear curve", __LINE__);
+    mgr.queueSlot(0, 0.25);
+    mgr.process(4);
+    assert_flt_eq(-0.5, d.foo, "First piece of curve", __LINE__);
+
+    float ramp[4] = {0};
+    mgr.ramp_backend = [&ramp](const char *path, const float *r, int n) {
+        assert_str_eq("/foo", path, "Ramp for bound path", __LINE__);
+        memcpy(ramp, r, n*sizeof(float));};
+    mgr.queueSlot(0, 0.75);
+    mgr.process(4);
+    assert_flt_eq(0.875, ramp[0], "Ramp starts behind last value", __LINE__);
+    assert_flt_eq(5, ramp[3], "Ramp ends at new value", __LINE__);
+    assert_int_eq(3, sent, "Ramp replaces message", __LINE__);
+}
+
+void test_smoothing(void)
+{
+    suite("test_smoothing");
+    rtosc::AutomationMgr mgr(4, 2, 16);
+    float values[8];
+    int sent = 0;
+    mgr.set_ports(p);
+    mgr.backend = [&values, &sent](const char *msg) {
+        if(sent < 8)
+            values[sent++] = rtosc_argument(msg, 0).f;};
+    mgr.createBinding(0, "/bar", false);
+    mgr.setSlotSmoothing(0, 8);
+    mgr.setSubBlock(2);
+
+    mgr.queueSlot(0, 1);
+    mgr.process(8);
+    assert_int_eq(4, sent, "One update per sub block", __LINE__);
+    assert_flt_eq(25.05, values[0], "Ramp starts at current value", __LINE__);
+    assert_flt_eq(50.1, values[1], "Ramp is linear", __LINE__);
+    assert_flt_eq(100.2, values[3], "Ramp reaches target", __LINE__);
+    mgr.process(8);
+    assert_int_eq(4, sent, "No updates after the ramp", __LINE__);
+
+    mgr.queueSlot(0, 0.5);
+    mgr.process(4);
+    assert_true(fabsf(87.675f - values[4]) < 1e-3,
+            "New ramp starts at current value", __LINE__);
+    assert_true(fabsf(75.15f - values[5]) < 1e-3,
+            "Ramp continues across sub blocks", __LINE__);
+    mgr.setSlotSmoothing(0, 0);
+    mgr.queueSlot(0, 0);
+    mgr.process(4);
+    assert_int_eq(7, sent, "Unsmoothed value is sent once", __LINE__);
+    assert_flt_eq(0, values[6], "Unsmoothed value jumps", __LINE__);
+}
+
 void test_curve_piecewise(void)
 {
     rtosc::AutomationMgr mgr(4, 2, 16);
@@ -286,12 +459,71 @@ void test_learn_many(void)
     mgr.createBinding(0, "/bar", true);
 }
 
+void test_queued_learn(void)
+{
+    suite("test_queued_learn");
+    rtosc::AutomationMgr mgr(4, 2, 16);
+    Dummy d = {0,0};
+    mgr.set_ports(p);
+    mgr.backend = [&d](const char *msg) {
+        rtosc::RtData rd;
+        char loc[128];
+        rd.loc = loc;
+        rd.loc_size = sizeof(loc);
+        rd.obj = &d; p.dispatch(msg, rd, true);};
+
+    assert_true(mgr.queueBinding(0, "/foo", true), "Binding is queued",
+            __LINE__);
+    assert_false(mgr.queueBinding(1, "/nothing", true),
+            "Unknown ports are not queued", __LINE__);
+    assert_false(mgr.slots[0].used, "Queued binding is not installed yet",
+            __LINE__);
+    assert_int_eq(1, mgr.applyQueued(), "Queue is applied", __LINE__);
+    assert_str_eq("/foo", mgr.slots[0].automations[0].param_path,
+            "Queued binding is installed", __LINE__);
+    assert_int_eq(1, mgr.slots[0].learning,
+            "Queued binding is in learning state", __LINE__);
+    mgr.handleMidi(0, 12, 127);
+    assert_int_eq(12, mgr.slots[0].midi_cc, "MIDI CC is captured", __LINE__);
+    assert_flt_eq(10, d.foo, "Queued binding sets the parameter", __LINE__);
+
+    // bind on another thread while MIDI is being handled
+    std::atomic<bool> done(false);
+    std::thread non_rt([&mgr, &done]() {
+        mgr.queueBinding(1, "/bar", false);
+        while(!mgr.queueLearn(1))
+            std::this_thread::yield();
+        done = true;
+    });
+    while(!done || mgr.slots[1].learning != 1)
+        mgr.handleMidi(0, 12, 0);
+    non_rt.join();
+    assert_str_eq("/bar", mgr.slots[1].automations[0].param_path,
+            "Binding from other thread is installed", __LINE__);
+    mgr.handleMidi(0, 13, 127);
+    assert_int_eq(13, mgr.slots[1].midi_cc,
+            "Queued learn request captures a MIDI CC", __LINE__);
+    assert_flt_eq(100.2, d.bar, "Learned slot sets the parameter", __LINE__);
+
+    int queued = 0;
+    while(mgr.queueLearn(2))
+        ++queued;
+    assert_true(queued > 0, "Full queue rejects requests", __LINE__);
+    assert_int_eq(queued, mgr.applyQueued(), "All requests are applied",
+            __LINE__);
+}
+
 int main()
 {
     test_basic_learn();
     test_slot_learn();
     test_midi_learn();
+    test_nrpn_learn();
     test_macro_learn();
     test_learn_many();
+    test_preencoded();
+    test_block();
+    test_smoothing();
+    test_queued_learn();
     return test_summary();
 }
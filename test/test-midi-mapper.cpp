@@ -1,6 +1,9 @@
 #include <rtosc/miditable.h>
+#include <rtosc/midi-decoder.h>
 #include <rtosc/port-sugar.h>
 #include "common.h"
+#include <string>
+#include <vector>
 
 struct Dummy {
     char foo;
@@ -98,9 +101,201 @@ void test_relearn(void)
     return;
 }
 
+void test_transaction(void)
+{
+    printf("#Test Transaction\n");
+    rtosc::MidiMapperRT rt;
+    rtosc::MidiMappernRT non_rt;
+    int binds = 0, retired = 0, events = 0;
+    non_rt.rt_cb = [&](const char *msg) {
+        ++binds;
+        rt.bind(msg);};
+    rt.setFrontendCb([&](const char *msg) {
+        if(non_rt.reclaim(msg))
+            ++retired;});
+    rt.setBackendCb([&](const char *) { ++events; });
+
+    non_rt.beginTransaction();
+    non_rt.addNewMapper(0, p.ports[0], "/foo");
+    non_rt.beginTransaction();
+    non_rt.addNewMapper(1, p.ports[1], "/bar");
+    non_rt.commitTransaction();
+    assert_int_eq(0, binds, "Nested transaction does not publish", __LINE__);
+    non_rt.addNewMapper(2, p.ports[0], "/foo");
+    non_rt.commitTransaction();
+    assert_int_eq(1, binds, "Transaction publishes once", __LINE__);
+    assert_true(rt.storage == non_rt.storage, "RT side uses new storage",
+            __LINE__);
+    assert_int_eq(3, rt.storage->mapping.size(), "All changes are published",
+            __LINE__);
+
+    rt.handleCC(1, 64);
+    assert_int_eq(1, events, "Published mapping is used", __LINE__);
+
+    non_rt.unMap("/bar", true);
+    assert_int_eq(2, binds, "Changes outside transactions publish", __LINE__);
+    assert_int_eq(1, retired, "Old storage is reclaimed", __LINE__);
+    assert_true(!non_rt.reclaim("/midi-use-CC\0\0\0\0,i\0\0\0\0\0\0"),
+            "Other messages are not reclaimed", __LINE__);
+    delete rt.storage;
+}
+
+void test_buffer(void)
+{
+    printf("#Test Buffer\n");
+    rtosc::MidiMapperRT rt;
+    rtosc::MidiMappernRT non_rt;
+    std::vector<std::string> sent;
+    int unhandled = 0;
+    non_rt.rt_cb = [&](const char *msg) { rt.bind(msg); };
+    rt.setFrontendCb([&](const char *msg) {
+        if(!non_rt.reclaim(msg))
+            ++unhandled;});
+    rt.setBackendCb([&](const char *msg) { sent.push_back(msg); });
+
+    non_rt.beginTransaction();
+    non_rt.addNewMapper(0, p.ports[0], "/foo");
+    non_rt.addNewMapper(1, p.ports[1], "/bar");
+    non_rt.commitTransaction();
+    rt.addWatch();
+
+    const rtosc::MidiEvent events[] = {
+        {0, 0, 10}, {5, 0, 20}, {6, 1, 30}, {7, 0, 40}, {8, 9, 1}
+    };
+    rt.handleCCs(events, 5);
+    assert_int_eq(2, sent.size(), "One message per target", __LINE__);
+    assert_str_eq("/foo", sent[0].c_str(), "Targets in order of first CC",
+            __LINE__);
+    assert_str_eq("/bar", sent[1].c_str(), "Second target", __LINE__);
+    assert_int_eq(40, rt.storage->values[0] >> 7, "Last value is kept",
+            __LINE__);
+    assert_int_eq(1, unhandled, "Unmapped CC is reported", __LINE__);
+    delete rt.storage;
+}
+
+void test_decoder(void)
+{
+    printf("#Test Decoder\n");
+    rtosc::MidiDecoder dec;
+    rtosc::MidiDecoder::Event ev;
+
+    assert_true(dec.feed(3, 1, 100, &ev), "Plain CC is decoded", __LINE__);
+    assert_int_eq(rtosc::MidiDecoder::cc, ev.type, "Plain CC type", __LINE__);
+    assert_int_eq(100, ev.value, "Plain CC value", __LINE__);
+
+    dec.setHighRes(1, true);
+    dec.feed(3, 1, 2, &ev);
+    dec.feed(3, 33, 5, &ev);
+    assert_int_eq(rtosc::MidiDecoder::cc14, ev.type, "14 bit CC type",
+            __LINE__);
+    assert_int_eq(1, ev.number, "14 bit CC has coarse number", __LINE__);
+    assert_int_eq((2<<7)|5, ev.value, "14 bit CC value", __LINE__);
+    dec.feed(3, 1, 3, &ev);
+    assert_int_eq((3<<7)|5, ev.value, "Fine part is kept", __LINE__);
+    dec.feed(4, 33, 7, &ev);
+    assert_int_eq(7, ev.value, "Channels are separate", __LINE__);
+
+    assert_true(!dec.feed(0, 99, 1, &ev), "NRPN number is no value",
+            __LINE__);
+    assert_true(!dec.feed(0, 98, 2, &ev), "NRPN number is no value",
+            __LINE__);
+    assert_true(!dec.feed(0, 6, 3, &ev), "Data MSB alone is no value",
+            __LINE__);
+    assert_true(dec.feed(0, 38, 4, &ev), "Data LSB completes the value",
+            __LINE__);
+    assert_int_eq(rtosc::MidiDecoder::nrpn, ev.type, "NRPN type", __LINE__);
+    assert_int_eq((1<<7)|2, ev.number, "NRPN number", __LINE__);
+    assert_int_eq((3<<7)|4, ev.value, "NRPN value", __LINE__);
+
+    dec.feed(0, 101, 127, &ev);
+    dec.feed(0, 100, 127, &ev);
+    assert_true(dec.feed(0, 6, 9, &ev), "Data entry after RPN null",
+            __LINE__);
+    assert_int_eq(rtosc::MidiDecoder::cc, ev.type,
+            "Data entry after RPN null is a plain CC", __LINE__);
+}
+
+struct Typed {
+    float vol;
+    float gain;
+    bool  on;
+};
+
+#undef rObject
+#define rObject Typed
+rtosc::Ports typed_ports = {
+    rParamF(vol, rLinear(0, 127), "float parameter"),
+    rParamF(gain, rLog(1, 1000), "logarithmic parameter"),
+    rToggle(on, "toggle parameter"),
+};
+
+char table_event[256];
+void table_event_cb(const char *msg)
+{
+    memcpy(table_event, msg, rtosc_message_length(msg, -1));
+}
+
+void test_table(void)
+{
+    printf("#Test Table\n");
+    rtosc::MidiTable table(typed_ports);
+    table.event_cb = table_event_cb;
+    table.addElm(2, 7, "/vol");
+    table.addElm(15, 127, "/on");
+
+    assert_true(table.has(2, 7), "Mapping is found", __LINE__);
+    assert_true(!table.has(7, 2), "Other CC is not mapped", __LINE__);
+    assert_str_eq("/on", table.get(15, 127)->path, "Last CC is mapped",
+            __LINE__);
+
+    table.process(2, 7, 127);
+    assert_str_eq("/vol", table_event, "Event path", __LINE__);
+    assert_flt_eq(127, rtosc_argument(table_event, 0).f, "Float is translated",
+            __LINE__);
+    table.process(15, 127, 100);
+    assert_str_eq("T", rtosc_argument_string(table_event), "Toggle is set",
+            __LINE__);
+    table.process(15, 127, 0);
+    assert_str_eq("F", rtosc_argument_string(table_event),
+            "Toggle is cleared", __LINE__);
+
+    table.addElm(2, 7, "/on");
+    table.process(2, 7, 127);
+    assert_str_eq("/on", table_event, "Remapped CC has new path", __LINE__);
+
+    table.clear_entry("/on");
+    assert_true(!table.has(2, 7), "Cleared mapping is gone", __LINE__);
+    assert_true(table.has(15, 127), "Later duplicate is found", __LINE__);
+}
+
+void test_conversion(void)
+{
+    printf("#Test Conversion\n");
+    const rtosc::MidiTable::Conversion lin =
+        rtosc::MidiTable::parseConversion(typed_ports.ports[0].metadata);
+    const rtosc::MidiTable::Conversion log =
+        rtosc::MidiTable::parseConversion(typed_ports.ports[1].metadata);
+    assert_int_eq(rtosc::MidiTable::Conversion::linear, lin.scale,
+            "Linear scale is parsed", __LINE__);
+    assert_int_eq(rtosc::MidiTable::Conversion::logarithmic, log.scale,
+            "Logarithmic scale is parsed", __LINE__);
+    for(int v : {0, 1, 64, 100, 127})
+        assert_flt_eq(rtosc::MidiTable::translate(v,
+                                        typed_ports.ports[1].metadata),
+                      rtosc::MidiTable::translate(v, log),
+                      "Parsed conversion translates like metadata", __LINE__);
+    assert_flt_eq(63.5, rtosc::MidiTable::translate(64, lin),
+            "Middle value is centered", __LINE__);
+}
+
 int main()
 {
     test_basic();
     test_relearn();
+    test_transaction();
+    test_buffer();
+    test_decoder();
+    test_table();
+    test_conversion();
     return test_summary();
 }
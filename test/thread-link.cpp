@@ -0,0 +1,462 @@
+#include <rtosc/thread-link.h>
+#include <rtosc/coalescing-link.h>
+#include <rtosc/rtosc.h>
+#include <rtosc/ports.h>
+#include <cstdio>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+using namespace rtosc;
+
+void wrap_around(void)
+{
+    //odd sizes of the ring and the messages make them wrap everywhere
+    ThreadLink link(36, 3);
+    int ok = 1;
+    for(int i=0; i<500; ++i) {
+        link.write("/wrap", i%2 ? "i" : "ii", i, 0x01020304);
+        ok &= link.hasNext();
+        const char *msg = link.read();
+        ok &= !strcmp("/wrap", msg) &&
+              rtosc_argument(msg, 0).i == i &&
+              (i%2 || rtosc_argument(msg, 1).i == 0x01020304);
+        ok &= !link.hasNext();
+    }
+    assert_true(ok, "messages wrapping around are read intact", __LINE__);
+}
+
+void capacity(void)
+{
+    ThreadLink link(32, 4);
+    char msg[32];
+    const size_t len = rtosc_message(msg, sizeof(msg), "/full/length/msg",
+                                     "ii", 1, 2);
+    assert_int_eq(32, len, "message of maximum length", __LINE__);
+    for(int i=0; i<5; ++i)
+        link.raw_write(msg);
+    int n = 0;
+    for(; link.hasNext(); ++n)
+        link.read();
+    assert_int_eq(4, n, "max_messages fit, further messages are dropped",
+                  __LINE__);
+}
+
+struct collect_t
+{
+    int calls = 0;
+    int sum   = 0;
+    bool in_place = false;
+    const char *read_buffer;
+};
+
+void read_all(void)
+{
+    ThreadLink link(32, 8);
+    assert_int_eq(0, link.read_all([](const char*, size_t){}),
+                  "nothing to read", __LINE__);
+
+    link.write("/x", "i", 0);
+    link.read(); //fill read_buffer, so in place messages can be told apart
+    for(int i=1; i<=6; ++i)
+        link.write("/x", "i", i);
+
+    collect_t c;
+    c.read_buffer = link.peak();
+    const size_t n = link.read_all([&c](const char *msg, size_t len) {
+            ++c.calls;
+            c.sum += rtosc_argument(msg, 0).i;
+            c.in_place |= msg != c.read_buffer;
+            if(len != rtosc_message_length(msg, len))
+                c.sum = -1000;
+        });
+    assert_int_eq(6, n, "read_all reads all messages", __LINE__);
+    assert_int_eq(6, c.calls, "one callback per message", __LINE__);
+    assert_int_eq(21, c.sum, "read_all passes messages and lengths",
+                  __LINE__);
+    assert_true(c.in_place, "messages are passed in place", __LINE__);
+    assert_false(link.hasNext(), "read_all drains the link", __LINE__);
+
+    //mixed with read(), and wrapping around
+    int ok = 1;
+    for(int i=0; i<100; ++i) {
+        link.write("/a", "i", i);
+        link.write("/b", "ii", i, i);
+        ok &= rtosc_argument(link.read(), 0).i == i;
+        int sum = 0;
+        link.read_all([&sum](const char *msg, size_t) {
+                sum += rtosc_argument(msg, 1).i; });
+        ok &= sum == i;
+    }
+    assert_true(ok, "read_all after read", __LINE__);
+
+    //C style callback
+    link.write("/c", "");
+    int calls = 0;
+    link.read_all([](const char *msg, size_t, void *data) {
+            if(!strcmp(msg, "/c"))
+                ++*(int*)data;
+        }, &calls);
+    assert_int_eq(1, calls, "read_all with data pointer", __LINE__);
+}
+
+void reserve_commit(void)
+{
+    ThreadLink link(32, 4);
+    int ok = 1, in_ring = 0;
+    for(int i=0; i<50; ++i) {
+        char *buf = link.reserve(32);
+        ok &= buf != NULL;
+        in_ring += buf != link.buffer();
+        const size_t len = rtosc_message(buf, 32, "/built", "i", i);
+        link.commit(len);
+        ok &= rtosc_argument(link.read(), 0).i == i;
+    }
+    assert_true(ok, "messages are built in place", __LINE__);
+    assert_true(in_ring > 0 && in_ring < 50,
+                "wrapping messages are built in the write buffer", __LINE__);
+
+    assert_null(link.reserve(33), "no reservations beyond the maximum length",
+                __LINE__);
+    link.reserve(32);
+    link.commit(0);
+    assert_false(link.hasNext(), "empty commits cancel", __LINE__);
+
+    for(int i=0; i<4; ++i)
+        link.write("/full/length/msg", "ii", 1, 2);
+    assert_null(link.reserve(4), "no reservations in full links", __LINE__);
+    link.read();
+    char *buf = link.reserve(32);
+    assert_non_null(buf, "reservations after reading", __LINE__);
+    link.commit(rtosc_message(buf, 32, "/last", ""));
+    int n = 0;
+    const char *last = NULL;
+    for(; link.hasNext(); ++n)
+        last = link.read();
+    assert_int_eq(4, n, "committed messages are appended", __LINE__);
+    assert_str_eq("/last", last, "commit publishes the message", __LINE__);
+}
+
+struct ReplyData : public RtData
+{
+    char buffer[128];
+    char last[256];
+    int  replies = 0;
+
+    ReplyData(void) { memset(buffer, 0, sizeof(buffer)); loc = buffer;
+                      loc_size = sizeof(buffer); }
+    void reply(const char *msg) override {
+        memcpy(last, msg, rtosc_message_length(msg, -1));
+        ++replies; }
+    void replyArray(const char *path, const char *args,
+                    rtosc_arg_t *vals) override {
+        rtosc_amessage(last, sizeof(last), path, args, vals);
+        ++replies; }
+};
+
+void stats(void)
+{
+    ThreadLink plain(32, 4);
+    plain.write("/x", "");
+    assert_int_eq(4+8, plain.stats().occupancy,
+                  "occupancy without statistics", __LINE__);
+    assert_int_eq(0, plain.stats().written, "no counters without statistics",
+                  __LINE__);
+
+    ThreadLink link(32, 4, ThreadLink::with_stats);
+    for(int i=0; i<6; ++i)
+        link.write("/full/length/msg", "ii", 1, 2);
+    ThreadLink::stats_t s = link.stats();
+    assert_int_eq(4, s.written, "written messages are counted", __LINE__);
+    assert_int_eq(2, s.dropped, "dropped messages are counted", __LINE__);
+    assert_int_eq(4*(32+12), s.occupancy, "occupancy in bytes", __LINE__);
+    assert_int_eq(s.occupancy, s.peak_occupancy, "peak occupancy", __LINE__);
+    assert_null(link.reserve(32), "reserve fails in full links", __LINE__);
+    assert_int_eq(3, link.stats().dropped, "failed reservations are counted",
+                  __LINE__);
+
+    link.read();
+    link.read_all([](const char*, size_t){});
+    s = link.stats();
+    assert_int_eq(4, s.read, "read messages are counted", __LINE__);
+    assert_int_eq(0, s.occupancy, "drained links are empty", __LINE__);
+    assert_int_eq(4*(32+12), s.peak_occupancy, "peak stays after reads",
+                  __LINE__);
+    uint32_t waits = 0;
+    for(int i=0; i<ThreadLink::latency_buckets; ++i)
+        waits += s.latency[i];
+    assert_int_eq(4, waits, "each read message adds to the histogram",
+                  __LINE__);
+    assert_true(s.messages_per_second() > 0, "message rate", __LINE__);
+
+    Ports monitor = {link.statsPort()};
+    ReplyData r;
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), "/stats/counters", "");
+    monitor.dispatch(msg+1, r, true);
+    assert_int_eq(1, r.replies, "statistics port replies", __LINE__);
+    assert_str_eq("hhh", rtosc_argument_string(r.last), "counter types",
+                  __LINE__);
+    assert_true(rtosc_argument(r.last, 2).h == 3, "dropped over OSC",
+                __LINE__);
+    rtosc_message(msg, sizeof(msg), "/stats/latency", "");
+    monitor.dispatch(msg+1, r, true);
+    assert_int_eq(ThreadLink::latency_buckets, rtosc_narguments(r.last),
+                  "latency histogram over OSC", __LINE__);
+
+    rtosc_message(msg, sizeof(msg), "/stats/reset", "");
+    monitor.dispatch(msg+1, r, true);
+    s = link.stats();
+    assert_int_eq(0, s.written + s.read + s.dropped, "statistics reset",
+                  __LINE__);
+}
+
+void wakeup(void)
+{
+    ThreadLink link(32, 4);
+    assert_int_eq(-1, link.wakeup_fd(), "no wakeup channel by default",
+                  __LINE__);
+    assert_false(link.wait(1000), "no waiting without wakeup channel",
+                 __LINE__);
+    assert_true(link.enable_wakeup(), "wakeup channel", __LINE__);
+    assert_true(link.wakeup_fd() >= 0, "wakeup descriptor", __LINE__);
+    assert_false(link.wait(10), "wait times out", __LINE__);
+
+    link.write("/pending", "");
+    assert_false(link.arm_wakeup(), "no sleeping with pending messages",
+                 __LINE__);
+    assert_true(link.wait(), "wait returns for pending messages", __LINE__);
+    link.read();
+
+    using namespace std::chrono;
+    int ok = 1;
+    for(int i=0; i<20; ++i) {
+        std::thread writer([&link, i]() {
+                std::this_thread::sleep_for(milliseconds(i%4));
+                link.write("/wake", "i", i); });
+        const steady_clock::time_point start = steady_clock::now();
+        ok &= link.wait(10000);
+        ok &= steady_clock::now() - start < seconds(5);
+        writer.join();
+        ok &= rtosc_argument(link.read(), 0).i == i;
+    }
+    assert_true(ok, "writers wake up waiting readers", __LINE__);
+}
+
+void locked_memory(void)
+{
+    ThreadLink link(64, 1024, ThreadLink::lock_memory |
+                              ThreadLink::huge_pages);
+    //locking may fail for unprivileged users, the link works anyways
+    int ok = 1;
+    for(int i=0; i<5000; ++i) {
+        link.write("/locked", "i", i);
+        ok &= rtosc_argument(link.read(), 0).i == i;
+    }
+    assert_true(ok, "links with locked buffers", __LINE__);
+    ThreadLink plain(64, 16);
+    assert_true(plain.memory_locked(), "nothing to lock by default",
+                __LINE__);
+}
+
+void shared_memory(void)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/rtosc-test-%d", (int)getpid());
+    ThreadLink *link = ThreadLink::create_shared(name, 64, 16);
+    assert_non_null(link, "shared link created", __LINE__);
+    if(!link)
+        return;
+    assert_false(link->enable_wakeup(), "no wakeup for shared links",
+                 __LINE__);
+    assert_null(ThreadLink::create_shared(name, 64, 16),
+                "a live segment is not replaced", __LINE__);
+
+    ThreadLink *same = ThreadLink::open_shared(name);
+    assert_non_null(same, "shared link opened", __LINE__);
+    same->write("/same", "i", 42);
+    assert_true(link->hasNext(), "messages pass through the segment",
+                __LINE__);
+    assert_int_eq(42, rtosc_argument(link->read(), 0).i,
+                  "messages are intact", __LINE__);
+    delete same;
+
+    //the child writes, the parent reads
+    const int n = 10000;
+    const pid_t child = fork();
+    if(!child) {
+        ThreadLink *w = ThreadLink::open_shared(name);
+        for(int i=0; w && i<n;)
+            if(char *buf = w->reserve(64)) {
+                w->commit(rtosc_message(buf, 64, "/child", "i", i));
+                ++i;
+            }
+        _exit(w ? 0 : 1);
+    }
+
+    int ok = 1, next = 0;
+    while(next < n && ok) {
+        link->read_all([&](const char *msg, size_t) {
+                ok &= rtosc_argument(msg, 0).i == next++; });
+    }
+    int status = 1;
+    waitpid(child, &status, 0);
+    assert_true(ok && next == n, "messages pass between processes", __LINE__);
+    assert_int_eq(0, status, "child opened the shared link", __LINE__);
+
+    delete link;
+    assert_null(ThreadLink::open_shared(name), "creator removes the segment",
+                __LINE__);
+
+    //a creator which exits without removing the segment leaves it stale
+    const pid_t crashed = fork();
+    if(!crashed)
+        _exit(ThreadLink::create_shared(name, 64, 16) ? 0 : 1);
+    waitpid(crashed, &status, 0);
+    assert_int_eq(0, status, "child created the shared link", __LINE__);
+    link = ThreadLink::create_shared(name, 64, 16);
+    assert_non_null(link, "a stale segment is replaced", __LINE__);
+    delete link;
+}
+
+void coalescing(void)
+{
+    CoalescingLink link(32, 8, 2);
+    for(int i=0; i<100; ++i)
+        link.write_latest("/slider", "f", i * 0.01f);
+    link.write("/note", "i", 1);
+    link.write_latest("/knob", "i", 3);
+    link.write_latest("/slider", "f", 1.0f);
+    link.write("/note", "i", 2);
+    link.write_latest("/third", "i", 7); //out of address slots
+    assert_int_eq(100, link.coalesced(), "replaced values are counted",
+                  __LINE__);
+    assert_true(link.hasNext(), "pending latest values", __LINE__);
+
+    std::string order;
+    float slider = 0;
+    const size_t n = link.read_all([&](const char *msg, size_t) {
+            order += msg;
+            if(!strcmp(msg, "/slider"))
+                slider = rtosc_argument(msg, 0).f;
+        });
+    assert_int_eq(5, n, "one message per address", __LINE__);
+    assert_str_eq("/note/note/third/slider/knob", order.c_str(),
+                  "FIFO messages first, then latest values", __LINE__);
+    assert_flt_eq(1.0f, slider, "the latest value wins", __LINE__);
+    assert_false(link.hasNext(), "coalescing link drained", __LINE__);
+
+    link.write_latest("/knob", "i", 4);
+    int knob = 0;
+    link.read_all([&](const char *msg, size_t) {
+            knob = rtosc_argument(msg, 0).i; });
+    assert_int_eq(4, knob, "addresses get pending again", __LINE__);
+
+    //long addresses, which only differ at their ends
+    CoalescingLink long_names(64, 8, 4);
+    for(int i=0; i<10; ++i) {
+        long_names.write_latest("/part0/voice3/filter/cutoff", "i", i);
+        long_names.write_latest("/part0/voice3/filter/cutofg", "i", -i);
+    }
+    std::string longs;
+    long_names.read_all([&](const char *msg, size_t) {
+            longs += msg;
+            longs += "=" + std::to_string(rtosc_argument(msg, 0).i) + " "; });
+    assert_str_eq("/part0/voice3/filter/cutoff=9 "
+                  "/part0/voice3/filter/cutofg=-9 ", longs.c_str(),
+                  "long addresses are coalesced", __LINE__);
+
+    //concurrent writer, values only grow
+    CoalescingLink shared(32, 8, 4);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+            for(int i=0; i<100000; ++i)
+                shared.write_latest(i%2 ? "/a" : "/b", "i", i);
+            done = true; });
+    int last[2] = {-1, -1}, ok = 1;
+    auto check = [&](const char *msg, size_t) {
+        const int v = rtosc_argument(msg, 0).i;
+        ok &= v >= last[v%2] && (v%2 ? "/a" : "/b") == std::string(msg);
+        last[v%2] = v;
+    };
+    while(!done)
+        shared.read_all(check);
+    writer.join();
+    shared.read_all(check);
+    assert_true(ok, "latest values stay consistent", __LINE__);
+    assert_true(last[0] == 99998 && last[1] == 99999,
+                "the final values are read", __LINE__);
+}
+
+void multi_producer(void)
+{
+    MultiProducerLink link(32, 4);
+    for(int i=0; i<6; ++i)
+        link.write("/m", "i", i);
+    int n = 0, sum = 0;
+    for(; link.hasNext(); ++n)
+        sum += rtosc_argument(link.read(), 0).i;
+    assert_int_eq(4, n, "messages are dropped if all slots are used",
+                  __LINE__);
+    assert_int_eq(6, sum, "slots are read in order", __LINE__);
+
+    char big[64];
+    rtosc_message(big, sizeof(big), "/too/long/for/a/slot", "ii", 1, 2);
+    link.raw_write(big);
+    link.write("/too/long/for/a/slot", "ii", 1, 2);
+    link.write("/ok", "");
+    assert_str_eq("/ok", link.read(), "too long messages are skipped",
+                  __LINE__);
+    assert_false(link.hasNext(), "link is drained", __LINE__);
+
+    //concurrent writers, each writer's messages stay in order
+    const int writers = 4, per_writer = 20000;
+    MultiProducerLink shared(32, 64);
+    std::atomic<int> done(0);
+    std::vector<std::thread> threads;
+    for(int w=0; w<writers; ++w)
+        threads.emplace_back([&shared, &done, w]() {
+                for(int i=0; i<per_writer; ++i)
+                    shared.write("/w", "ii", w, i);
+                ++done;
+            });
+
+    std::vector<int> next(writers, 0);
+    int received = 0, ordered = 1;
+    auto check = [&](const char *msg, size_t len) {
+        const int w = rtosc_argument(msg, 0).i;
+        const int i = rtosc_argument(msg, 1).i;
+        ordered &= len == 16 && w >= 0 && w < writers && i >= next[w];
+        next[w] = i+1;
+        ++received;
+    };
+    while(done != writers)
+        shared.read_all(check);
+    for(auto &t : threads)
+        t.join();
+    shared.read_all(check);
+    assert_true(ordered, "messages of each writer stay in order", __LINE__);
+    assert_true(received > 0 && received <= writers*per_writer,
+                "concurrent messages are received", __LINE__);
+}
+
+int main()
+{
+    wrap_around();
+    capacity();
+    read_all();
+    reserve_commit();
+    stats();
+    wakeup();
+    locked_memory();
+    shared_memory();
+    coalescing();
+    multi_producer();
+    return test_summary();
+}
@@ -0,0 +1,98 @@
+#include <rtosc/rtosc-time.h>
+#include "common.h"
+
+void test_ns2timetag()
+{
+    assert_int_eq(1, rtosc_ns2timetag(1000000000u) == (UINT64_C(1) << 32),
+                  "One second is 2^32 units", __LINE__);
+    assert_int_eq(1, rtosc_ns2timetag(UINT64_C(1500000000)) ==
+                     (UINT64_C(3) << 31),
+                  "Second fractions are converted", __LINE__);
+    int exact = 1;
+    for(uint64_t ns = 0; ns < 1000000000u; ns += 999983)
+    {
+        const double tt = ns * 4294967296.0 / 1e9;
+        const double diff = rtosc_ns2timetag(ns) - tt;
+        exact = exact && diff > -1.0 && diff < 1.0;
+    }
+    assert_int_eq(1, exact, "Fractions are exact to one unit", __LINE__);
+}
+
+void test_clock()
+{
+    rtosc_timetag_clock_t clock;
+    rtosc_timetag_clock_calibrate(&clock);
+
+    rtosc_arg_val_t av, coarse;
+    rtosc_arg_val_from_clock(&av, &clock);
+    rtosc_arg_val_current_time(&coarse);
+    assert_char_eq('t', av.type, "Clock stamps timetags", __LINE__);
+    const int64_t diff = (int64_t)rtosct_time_t_from_arg_val(&av) -
+                         (int64_t)rtosct_time_t_from_arg_val(&coarse);
+    assert_int_eq(1, diff >= -1 && diff <= 1,
+                  "Clock has the epoch of rtosc_arg_val_current_time()",
+                  __LINE__);
+
+    const uint64_t t1 = rtosc_timetag_clock_now(&clock);
+    const uint64_t t2 = rtosc_timetag_clock_now(&clock);
+    assert_int_eq(1, t2 >= t1, "Clock is monotonic", __LINE__);
+
+    assert_int_eq(1, rtosc_timetag_clock_at(&clock, clock.base_ns + 250000000u)
+                     == clock.base_tt + (UINT64_C(1) << 30),
+                  "Timetags follow the monotonic clock", __LINE__);
+    assert_int_eq(1, rtosc_timetag_clock_at(&clock, clock.base_ns - 250000000u)
+                     == clock.base_tt - (UINT64_C(1) << 30),
+                  "Readings before calibration", __LINE__);
+}
+
+void test_block()
+{
+    const uint64_t start = UINT64_C(1000) << 32;
+    rtosc_block_time_t block;
+    rtosc_block_time_init(&block, start, 256, 48000);
+
+    uint32_t frames[256], back[256];
+    uint64_t tt[256];
+    for(uint32_t i = 0; i < 256; ++i)
+        frames[i] = i;
+    rtosc_frames2timetags(&block, frames, tt, 256);
+    rtosc_timetags2frames(&block, tt, back, 256);
+    int same = 1;
+    for(uint32_t i = 0; i < 256; ++i)
+        same = same && back[i] == i;
+    assert_int_eq(1, same, "Frames are converted back and forth", __LINE__);
+
+    // the same rounding as with double arithmetic
+    int rounded = 1;
+    for(uint64_t d = 0; d < block.end - start; d += 1234567)
+    {
+        const uint64_t t = start + d;
+        uint32_t f;
+        rtosc_timetags2frames(&block, &t, &f, 1);
+        unsigned expected = d * 48000.0 / 4294967296.0 + 0.5;
+        if(expected > 255)
+            expected = 255;
+        rounded = rounded && f == expected;
+    }
+    assert_int_eq(1, rounded, "Timetags are rounded to frames", __LINE__);
+
+    const uint64_t outside[4] = {1, start - 5, block.end, UINT64_MAX};
+    rtosc_timetags2frames(&block, outside, back, 4);
+    assert_int_eq(0, back[0], "Immediate timetag is at frame 0", __LINE__);
+    assert_int_eq(0, back[1], "Late timetags are at frame 0", __LINE__);
+    assert_int_eq(256, back[2], "Block end is after the block", __LINE__);
+    assert_int_eq(256, back[3], "Future timetags are after the block",
+                  __LINE__);
+}
+
+/*
+    all tests
+*/
+int main()
+{
+    test_ns2timetag();
+    test_clock();
+    test_block();
+
+    return test_summary();
+}
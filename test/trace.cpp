@@ -0,0 +1,124 @@
+#include <rtosc/trace.h>
+#include <rtosc/ports.h>
+#include <rtosc/rtosc.h>
+#include <rtosc/thread-link.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "common.h"
+
+using namespace rtosc;
+
+static const Ports ports = {
+    {"volume::f", 0, 0, [](const char *, RtData &) {}},
+};
+
+static void dispatch(const char *path)
+{
+    char loc[64] = "", msg[64];
+    rtosc_message(msg, sizeof(msg), path, "");
+    RtData d;
+    d.loc = loc;
+    d.loc_size = sizeof(loc);
+    ports.dispatch(msg, d, true);
+}
+
+static bool has(const std::string &json, const char *str)
+{
+    return json.find(str) != std::string::npos;
+}
+
+void stopped(void)
+{
+    assert_false(trace::active(), "tracing is stopped initially", __LINE__);
+    assert_true(trace::attach_thread("main"), "thread is attached", __LINE__);
+    assert_false(trace::attach_thread("main"), "threads attach once",
+                 __LINE__);
+    dispatch("/volume");
+    const std::string json = trace::chrome_json();
+    assert_true(has(json, "\"thread_name\"") && has(json, "{\"name\":\"main\"}"),
+                "thread names are exported", __LINE__);
+    assert_false(has(json, "volume"), "nothing is traced while stopped",
+                 __LINE__);
+}
+
+void recording(void)
+{
+    ThreadLink link(64, 4);
+    trace::start();
+    dispatch("/volume");
+    link.write("/note", "i", 42);
+    link.read();
+    {
+        trace::scope_t scope("app", "period");
+        trace::counter("app", "load", 70);
+    }
+    trace::instant("app", "quote\"d", 3);
+    trace::stop();
+    dispatch("/volume");
+
+    const std::string json = trace::chrome_json();
+    assert_true(has(json, "{\"name\":\"volume::f\",\"cat\":\"dispatch\","
+                          "\"ph\":\"B\""), "dispatch begin", __LINE__);
+    assert_true(has(json, "{\"name\":\"volume::f\",\"cat\":\"dispatch\","
+                          "\"ph\":\"E\""), "dispatch end", __LINE__);
+    std::size_t dispatched = 0;
+    for(std::size_t pos = 0;
+        (pos = json.find("\"cat\":\"dispatch\"", pos)) != std::string::npos;
+        ++pos)
+        ++dispatched;
+    assert_int_eq(2, dispatched, "no events after stop", __LINE__);
+    assert_true(has(json, "\"name\":\"enqueue\",\"cat\":\"link\""),
+                "link writes are traced", __LINE__);
+    assert_true(has(json, "\"name\":\"dequeue\",\"cat\":\"link\""),
+                "link reads are traced", __LINE__);
+    assert_true(has(json, "\"name\":\"period\",\"cat\":\"app\",\"ph\":\"E\""),
+                "scopes end their slices", __LINE__);
+    assert_true(has(json, "\"ph\":\"C\"") && has(json, "{\"load\":70}"),
+                "counters", __LINE__);
+    assert_true(has(json, "\"quote\\\"d\"") && has(json, "{\"value\":3}"),
+                "names are escaped", __LINE__);
+    assert_true(json[0] == '{' && has(json, "\n]}\n"), "JSON is complete",
+                __LINE__);
+
+    const char *filename = "trace-test.json";
+    assert_true(trace::write_chrome_json(filename), "trace is written",
+                __LINE__);
+    remove(filename);
+}
+
+void other_threads(void)
+{
+    trace::clear();
+    trace::start();
+    std::thread([]{ trace::instant("app", "unattached"); }).join();
+    assert_int_eq(1, trace::dropped(), "events of unattached threads",
+                  __LINE__);
+    std::thread([]{
+            trace::attach_thread("worker", 2);
+            for(int i = 0; i < 5; ++i)
+                trace::instant("app", "work");
+        }).join();
+    trace::stop();
+    assert_int_eq(4, trace::dropped(), "events beyond full buffers",
+                  __LINE__);
+    std::string json = trace::chrome_json();
+    assert_true(has(json, "{\"name\":\"worker\"}"),
+                "buffers outlive their threads", __LINE__);
+    assert_false(has(json, "period"), "clear drops events", __LINE__);
+
+    trace::clear();
+    json = trace::chrome_json();
+    assert_false(has(json, "worker"), "clear drops exited threads", __LINE__);
+    assert_true(has(json, "{\"name\":\"main\"}"), "clear keeps attached threads",
+                __LINE__);
+    assert_int_eq(0, trace::dropped(), "clear resets dropped", __LINE__);
+}
+
+int main()
+{
+    stopped();
+    recording();
+    other_threads();
+    return test_summary();
+}
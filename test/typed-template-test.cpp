@@ -1,7 +1,10 @@
 //#include <rtosc/typed-message.h>
 #include "../include/rtosc/typed-message.h"
+#include "../include/rtosc/typed-port.h"
 #include "common.h"
 #include <cstdio>
+#include <string>
+#include <vector>
 
 using rtosc::rtMsg;
 using rtosc::get;
@@ -50,6 +53,105 @@ MKMATCH(T_config,  "/config/");
 MKMATCH(T_presets, "/presets/");
 MKMATCH(T_io,      "/io/");
 
+//Typed ports
+struct Voice
+{
+    float   volume = 1.0f;
+    int32_t note_  = 60;
+    bool    mute   = false;
+    int64_t pos    = 0;
+    int32_t note(void) const { return note_; }
+    void set_note(int32_t n) { note_ = n < 0 ? 0 : n > 127 ? 127 : n; }
+};
+
+#define rObject Voice
+static rtosc::Ports voice_ports = {
+    rTypedParam(volume, rLog(1e-3, 1), "loudness"),
+    rTypedProperty(note, note, set_note, "MIDI note"),
+    rTypedParam(mute, "mute"),
+    rTypedParam(pos, "position")
+};
+#undef rObject
+
+struct ReplyData : public rtosc::RtData
+{
+    std::vector<std::string> replies, broadcasts;
+    std::vector<float> floats;
+    char buffer[128];
+
+    ReplyData(void) { memset(buffer, 0, sizeof(buffer)); loc = buffer;
+                      loc_size = sizeof(buffer); }
+    void reply(const char *msg) override {
+        replies.push_back(std::string(msg) + ":" +
+                          rtosc_argument_string(msg));
+        if(!strcmp(rtosc_argument_string(msg), "f"))
+            floats.push_back(rtosc_argument(msg, 0).f);
+    }
+    void reply(const char *path, const char *args, ...) override {
+        replies.push_back(std::string(path) + ":" + args); }
+    void broadcast(const char *msg) override {
+        broadcasts.push_back(std::string(msg) + ":" +
+                             rtosc_argument_string(msg)); }
+};
+
+void typed_ports(void)
+{
+    Voice voice;
+    ReplyData d;
+    d.obj = &voice;
+    char msg[64];
+    auto send = [&](const char *path, const char *args, ...) {
+        va_list va;
+        va_start(va, args);
+        rtosc_vmessage(msg, sizeof(msg), path, args, va);
+        va_end(va);
+        d.buffer[0] = 0;
+        voice_ports.dispatch(msg + 1, d, true);
+    };
+
+    assert_str_eq("volume::f", voice_ports["volume"]->name,
+                  "Typed Port Names Are Generated", __LINE__);
+    assert_str_eq("mute::T:F", voice_ports["mute"]->name,
+                  "Typed Bool Ports Take True And False", __LINE__);
+    auto meta = voice_ports["volume"]->meta();
+    assert_true(meta.find("parameter") != meta.end() && meta["max"],
+                "Typed Ports Have Metadata", __LINE__);
+
+    send("/volume", "f", 0.25f);
+    assert_flt_eq(0.25f, voice.volume, "Typed Port Sets Member", __LINE__);
+    assert_int_eq(1, d.broadcasts.size(), "Typed Port Broadcasts", __LINE__);
+    assert_str_eq("/volume:f", d.broadcasts.back().c_str(),
+                  "Typed Port Broadcasts Its Value", __LINE__);
+    assert_str_eq("/undo_change:sff", d.replies.back().c_str(),
+                  "Typed Port Replies Undo", __LINE__);
+
+    send("/volume", "");
+    assert_str_eq("/volume:f", d.replies.back().c_str(),
+                  "Typed Port Replies Queries", __LINE__);
+    assert_flt_eq(0.25f, d.floats.back(), "Typed Port Replies Its Value",
+                  __LINE__);
+
+    send("/volume", "i", 3);
+    assert_flt_eq(0.25f, voice.volume, "Typed Port Ignores Other Types",
+                  __LINE__);
+
+    send("/note", "i", 200);
+    assert_int_eq(127, voice.note(), "Typed Port Calls Setter", __LINE__);
+    send("/mute", "T");
+    assert_true(voice.mute, "Typed Bool Port Sets True", __LINE__);
+    assert_str_eq("/mute:T", d.broadcasts.back().c_str(),
+                  "Typed Bool Port Broadcasts", __LINE__);
+    send("/pos", "h", (int64_t)1 << 40);
+    assert_true(voice.pos == (int64_t)1 << 40, "Typed 64 Bit Port", __LINE__);
+
+    const size_t broadcasts = d.broadcasts.size(), replies = d.replies.size();
+    send("/pos", "h", (int64_t)1 << 40);
+    assert_int_eq(broadcasts + 1, d.broadcasts.size(),
+                  "Unchanged Values Are Broadcast", __LINE__);
+    assert_int_eq(replies, d.replies.size(),
+                  "Unchanged Values Have No Undo", __LINE__);
+}
+
 int main() {
     char buf[1024];
     char buf2[1024];
@@ -76,5 +178,36 @@ int main() {
     assert_true(m5, "Check Type Match", __LINE__);
     assert_false(m6, "Check Type Conflict", __LINE__);
 
+    //Compile time layouts
+    typedef rtosc::MsgLayout<int32_t, int32_t, float> Note;
+    typedef rtosc::MsgLayout<int64_t, double> Wide;
+    static_assert(Note::tags_size == 8, "',iif' is padded to 8 bytes");
+    static_assert(Note::offset<2>() == 16, "offsets are constant");
+    static_assert(Note::length(5) == 28, "lengths are constant");
+
+    char ref[128], fixed[128];
+    size_t ref_len = rtosc_message(ref, sizeof(ref), "/note", "iif",
+                                   1, 64, 0.5f);
+    size_t len = Note::write(fixed, sizeof(fixed), "/note", 1, 64, 0.5f);
+    assert_hex_eq(ref, fixed, ref_len, len,
+                  "Layout Writes Like rtosc_message()", __LINE__);
+    assert_int_eq(0, Note::write(fixed, 27, "/note", 1, 64, 0.5f),
+                  "Layout Respects Buffer Bounds", __LINE__);
+    assert_true(Note::matches(ref), "Layout Matches Signature", __LINE__);
+    assert_false(Note::matches(buf2), "Layout Rejects Other Signature",
+                 __LINE__);
+    assert_int_eq(64, Note::get<1>(ref), "Layout Reads Ints", __LINE__);
+    assert_flt_eq(0.5f, Note::get<2>(ref), "Layout Reads Floats", __LINE__);
+
+    ref_len = rtosc_message(ref, sizeof(ref), "/wide/path", "hd",
+                            (int64_t)-5, 0.125);
+    len = Wide::write(fixed, sizeof(fixed), "/wide/path", -5, 0.125);
+    assert_hex_eq(ref, fixed, ref_len, len,
+                  "Layout Writes 64 Bit Arguments", __LINE__);
+    assert_true(Wide::get<0>(ref) == -5 && Wide::get<1>(ref) == 0.125,
+                "Layout Reads 64 Bit Arguments", __LINE__);
+
+    typed_ports();
+
     return test_summary();
 };
@@ -0,0 +1,283 @@
+#include <rtosc/udp-transport.h>
+#ifdef HAVE_IO_URING
+#include <rtosc/uring-transport.h>
+#endif
+#include <rtosc/thread-link.h>
+#include <rtosc/rtosc.h>
+#include <cstdio>
+#include <cstring>
+#include "common.h"
+
+using namespace rtosc;
+
+//all tests send from an A to a B
+template<class A, class B>
+static bool open_pair(A &a, B &b, UdpPeer &to_b)
+{
+    return a.open(0, "127.0.0.1") && b.open(0, "127.0.0.1") &&
+           to_b.resolve("127.0.0.1", b.port());
+}
+
+template<class A, class B>
+void batched(void)
+{
+    A a(64, 16);
+    B b(64, 16);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+    assert_true(b.port() != 0, "a free port is picked", __LINE__);
+
+    char msg[64];
+    int ok = 1;
+    for(int i=0; i<40; ++i) {
+        const size_t len = rtosc_message(msg, sizeof(msg), "/num", "i", i);
+        ok &= a.queue(msg, len, to_b);
+    }
+    assert_true(ok, "messages are queued", __LINE__);
+    //the pool of 16 has been flushed twice while queueing
+    assert_int_eq(8, a.queued(), "full pools are flushed", __LINE__);
+    assert_int_eq(8, a.flush(), "the rest is sent by flush()", __LINE__);
+    assert_int_eq(40, a.sent(), "all messages are sent", __LINE__);
+
+    int n = 0, next = 0, largest = 0;
+    unsigned short from = 0;
+    while(n < 40 && b.wait(1000)) {
+        size_t got = b.receive_batch([&](const char *const *msgs,
+                                         const size_t *lens,
+                                         const UdpPeer *peers, size_t cnt) {
+                for(size_t i=0; i<cnt; ++i) {
+                    ok &= !strcmp(msgs[i], "/num") &&
+                          rtosc_argument(msgs[i], 0).i == next++ &&
+                          lens[i] == rtosc_message_length(msgs[i], lens[i]);
+                    from = peers[i].port();
+                }
+            });
+        n += got;
+        largest = got > (size_t)largest ? got : largest;
+    }
+    assert_int_eq(40, n, "all messages are received", __LINE__);
+    assert_true(ok, "messages arrive intact and in order", __LINE__);
+    assert_true(largest > 1 && largest <= 16,
+                "multiple messages per receive, at most one batch", __LINE__);
+    assert_int_eq(a.port(), from, "the sender is reported", __LINE__);
+}
+
+template<class A, class B>
+void invalid(void)
+{
+    A a(64, 8);
+    B b(32, 8);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+
+    char msg[64];
+    const char garbage[8] = {'n', 'o', 't', ' ', 'o', 's', 'c', 0};
+    a.queue(garbage, sizeof(garbage), to_b);
+    //too long for the receiver's buffers
+    size_t len = rtosc_message(msg, sizeof(msg),
+                               "/this/path/is/too/long/for/b", "i", 1);
+    a.queue(msg, len, to_b);
+    //bundles are accepted
+    char sub[16];
+    rtosc_message(sub, sizeof(sub), "/b", "i", 2);
+    len = rtosc_bundle(msg, sizeof(msg), 0, 1, sub);
+    a.queue(msg, len, to_b);
+    len = rtosc_message(msg, sizeof(msg), "/ok", "");
+    a.queue(msg, len, to_b);
+    a.flush();
+
+    int n = 0, bundles = 0;
+    while(n < 2 && b.wait(1000))
+        n += b.receive([&](const char *m, size_t, const UdpPeer &) {
+                bundles += rtosc_bundle_p(m);
+            });
+    while(b.wait(100))
+        n += b.receive([](const char *, size_t, const UdpPeer &) {});
+    assert_int_eq(2, n, "only valid messages are received", __LINE__);
+    assert_int_eq(1, bundles, "bundles are received", __LINE__);
+    assert_int_eq(2, b.dropped(), "garbage and truncated messages are dropped",
+                  __LINE__);
+}
+
+template<class A, class B>
+void to_link(void)
+{
+    A a(64, 8);
+    B b(64, 8);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+    //room for 4 messages of 20 bytes
+    ThreadLink link(20, 4);
+
+    char msg[64];
+    for(int i=0; i<6; ++i) {
+        const size_t len = rtosc_message(msg, sizeof(msg), "/link", "ii", i, 0);
+        a.queue(msg, len, to_b);
+    }
+    a.flush();
+    size_t n = 0, got = 0;
+    while(got < 6 && b.wait(1000)) {
+        const size_t before = b.received();
+        n   += b.receive(link);
+        got += b.received() - before;
+    }
+    assert_int_eq(4, n, "messages which fit are written to the link",
+                  __LINE__);
+    int ok = 1, i = 0;
+    while(link.hasNext()) {
+        const char *m = link.read();
+        ok &= !strcmp(m, "/link") && rtosc_argument(m, 0).i == i++;
+    }
+    assert_true(ok && i == 4, "the link holds the messages in order",
+                __LINE__);
+}
+
+template<class A, class B>
+void replies(void)
+{
+    A a(64, 8);
+    B b(64, 8);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+
+    char msg[64];
+    size_t len = rtosc_message(msg, sizeof(msg), "/ping", "i", 7);
+    a.queue(msg, len, to_b);
+    a.flush();
+
+    //answer to the address the message came from
+    auto pong = [&](const char *m, size_t, const UdpPeer &from) {
+        char reply[64];
+        size_t rlen = rtosc_message(reply, sizeof(reply), "/pong", "i",
+                                    rtosc_argument(m, 0).i + 1);
+        b.queue(reply, rlen, from);
+    };
+    while(b.wait(1000) && !b.receive(pong))
+        ;
+    assert_int_eq(1, b.flush(), "reply is sent", __LINE__);
+
+    int answer = 0;
+    if(a.wait(1000))
+        a.receive([&](const char *m, size_t, const UdpPeer &) {
+                answer = !strcmp(m, "/pong") ? rtosc_argument(m, 0).i : -1;
+            });
+    assert_int_eq(8, answer, "reply reaches the sender", __LINE__);
+}
+
+void fan_out(void)
+{
+    UdpTransport a(64, 2);
+    UdpTransport b[5];
+    UdpPeer to[5];
+    int ok = a.open(0, "127.0.0.1");
+    for(int i=0; i<5; ++i)
+        ok &= b[i].open(0, "127.0.0.1") &&
+              to[i].resolve("127.0.0.1", b[i].port());
+    assert_true(ok, "sockets are opened", __LINE__);
+
+    char msg[64];
+    size_t len = rtosc_message(msg, sizeof(msg), "/first", "");
+    a.queue(msg, len, to[0]);
+    len = rtosc_message(msg, sizeof(msg), "/all", "i", 42);
+    //more peers than the batch size
+    assert_int_eq(5, a.send_to_all(msg, len, to, 5),
+                  "one message is sent to all peers", __LINE__);
+    assert_int_eq(0, a.queued(), "queued messages are sent first", __LINE__);
+
+    int n = 0;
+    for(int i=0; i<5; ++i) {
+        int expected = i ? 1 : 2, got = 0;
+        while(got < expected && b[i].wait(1000))
+            b[i].receive([&](const char *m, size_t, const UdpPeer &) {
+                    ok &= ++got < expected ? !strcmp(m, "/first")
+                                           : rtosc_argument(m, 0).i == 42;
+                });
+        n += got;
+    }
+    assert_int_eq(6, n, "all peers receive the message", __LINE__);
+    assert_true(ok, "messages are received in order", __LINE__);
+
+    //the pool is usable as before
+    len = rtosc_message(msg, sizeof(msg), "/after", "");
+    a.queue(msg, len, to[1]);
+    a.flush();
+    int after = 0;
+    if(b[1].wait(1000))
+        b[1].receive([&](const char *m, size_t, const UdpPeer &) {
+                after = !strcmp(m, "/after");
+            });
+    assert_true(after, "queueing works after sending to all", __LINE__);
+}
+
+template<class A, class B>
+void all(void)
+{
+    batched<A, B>();
+    invalid<A, B>();
+    to_link<A, B>();
+    replies<A, B>();
+}
+
+#ifdef HAVE_IO_URING
+void buffers_exhausted(void)
+{
+    UdpTransport a(64, 64);
+    UringTransport b(64, 4, 4);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+
+    char msg[64];
+    for(int i=0; i<40; ++i) {
+        const size_t len = rtosc_message(msg, sizeof(msg), "/num", "i", i);
+        a.queue(msg, len, to_b);
+    }
+    a.flush();
+    int n = 0, next = 0, ok = 1;
+    while(n < 40 && b.wait(1000))
+        n += b.receive([&](const char *m, size_t, const UdpPeer &) {
+                ok &= rtosc_argument(m, 0).i == next++;
+            });
+    assert_int_eq(40, n, "receiving continues when buffers ran out",
+                  __LINE__);
+    assert_true(ok, "messages arrive in order", __LINE__);
+}
+
+void zero_copy(void)
+{
+    UringTransport a(64, 16);
+    UdpTransport b(64, 16);
+    UdpPeer to_b;
+    assert_true(open_pair(a, b, to_b), "sockets are opened", __LINE__);
+    a.set_zero_copy(true);
+
+    char msg[64];
+    for(int i=0; i<16; ++i) {
+        const size_t len = rtosc_message(msg, sizeof(msg), "/zc", "i", i);
+        a.queue(msg, len, to_b);
+    }
+    assert_int_eq(16, a.flush(), "zero copy messages are sent", __LINE__);
+    int n = 0;
+    while(n < 16 && b.wait(1000))
+        n += b.receive([](const char *, size_t, const UdpPeer &) {});
+    assert_int_eq(16, n, "zero copy messages are received", __LINE__);
+}
+#endif
+
+int main()
+{
+    all<UdpTransport, UdpTransport>();
+    fan_out();
+#ifdef HAVE_IO_URING
+    UringTransport probe;
+    if(probe.open(0, "127.0.0.1")) {
+        probe.close();
+        all<UdpTransport, UringTransport>();
+        all<UringTransport, UdpTransport>();
+        all<UringTransport, UringTransport>();
+        buffers_exhausted();
+        zero_copy();
+    } else
+        printf("# io_uring is not available, skipping its tests\n");
+#endif
+    return test_summary();
+}
@@ -1,7 +1,13 @@
 #include <rtosc/ports.h>
 #include <rtosc/port-sugar.h>
 #include <rtosc/undo-history.h>
+#include <rtosc/address-table.h>
 #include <cstdarg>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "common.h"
 
@@ -64,6 +70,313 @@ struct Rt:public RtData
 
 char ref[] = "b\0\0\0,c\0\0\0\0\0\7";
 
+//record changes of distinct ports, which are not merged
+void record(UndoHistory &hist, int n)
+{
+    for(int i = 0; i < n; ++i) {
+        char path[16], msg[64];
+        snprintf(path, sizeof(path), "/a%d", i);
+        rtosc_message(msg, sizeof(msg), "/undo_change", "sii", path, 0, 1);
+        hist.recordEvent(msg);
+    }
+}
+
+void limits(void)
+{
+    UndoHistory hist;
+    hist.setLimits(1024, 3);
+    record(hist, 5);
+    assert_int_eq(3, hist.size(), "Event Limit Drops Oldest Events", __LINE__);
+    assert_int_eq(3, hist.getPos(), "Position Follows Dropped Events",
+            __LINE__);
+    assert_str_eq("/a2", rtosc_argument(hist.getHistory(0), 0).s,
+            "Oldest Remaining Event", __LINE__);
+    assert_str_eq("/a4", rtosc_argument(hist.getHistory(2), 0).s,
+            "Newest Event", __LINE__);
+
+    // each message has 36 bytes
+    hist.setLimits(100, 10);
+    assert_int_eq(0, hist.size(), "Setting Limits Clears History", __LINE__);
+    record(hist, 7);
+    assert_int_eq(2, hist.size(), "Byte Limit Drops Oldest Events", __LINE__);
+    assert_str_eq("/a5", rtosc_argument(hist.getHistory(0), 0).s,
+            "Oldest Event After Wrapping", __LINE__);
+    assert_str_eq("/a6", rtosc_argument(hist.getHistory(1), 0).s,
+            "Newest Event After Wrapping", __LINE__);
+    assert_int_eq(1, rtosc_argument(hist.getHistory(1), 2).i,
+            "Wrapped Event Is Intact", __LINE__);
+
+    hist.setLimits(16, 10);
+    record(hist, 1);
+    assert_int_eq(0, hist.size(), "Too Large Events Are Not Recorded",
+            __LINE__);
+}
+
+//record a change of path from old_val to new_val
+void change(UndoHistory &hist, const char *path, int old_val, int new_val)
+{
+    char msg[64];
+    rtosc_message(msg, sizeof(msg), "/undo_change", "sii",
+                  path, old_val, new_val);
+    hist.recordEvent(msg);
+}
+
+void coalescing(void)
+{
+    UndoHistory hist;
+    for(int i = 0; i < 10; ++i)
+        change(hist, "/a", i, i+1);
+    assert_int_eq(1, hist.size(), "Changes In Time Window Are Merged",
+            __LINE__);
+    assert_int_eq(0, rtosc_argument(hist.getHistory(0), 1).i,
+            "Merged Event Holds First Old Value", __LINE__);
+    assert_int_eq(10, rtosc_argument(hist.getHistory(0), 2).i,
+            "Merged Event Holds Last New Value", __LINE__);
+
+    hist.setLimits(16384, 20);
+    hist.setMergeWindow(0);
+    for(int i = 0; i < 3; ++i)
+        change(hist, "/a", i, i+1);
+    assert_int_eq(3, hist.size(), "Zero Time Window Disables Merging",
+            __LINE__);
+
+    hist.beginGesture();
+    hist.beginGesture();
+    for(int i = 3; i < 6; ++i) {
+        change(hist, "/a", i, i+1);
+        change(hist, "/b", i, i+1);
+    }
+    hist.endGesture();
+    change(hist, "/a", 6, 7);
+    hist.endGesture();
+    assert_int_eq(5, hist.size(), "Changes Of A Gesture Are Merged Per Path",
+            __LINE__);
+    assert_int_eq(3, rtosc_argument(hist.getHistory(3), 1).i,
+            "Gesture Is Not Merged Into Events Before It", __LINE__);
+    assert_int_eq(7, rtosc_argument(hist.getHistory(3), 2).i,
+            "Nested Gestures Count As One", __LINE__);
+
+    hist.setMergeWindow(2);
+    change(hist, "/a", 7, 8);
+    assert_int_eq(6, hist.size(), "Events After A Gesture Are Not Merged",
+            __LINE__);
+    change(hist, "/a", 8, 9);
+    assert_int_eq(6, hist.size(), "Merging Resumes After A Gesture",
+            __LINE__);
+}
+
+int value, callbacks;
+void set_value(const char *msg)
+{
+    value = rtosc_argument(msg, 0).i;
+    ++callbacks;
+}
+
+void journal(void)
+{
+    char path[] = "/tmp/rtosc-undo-XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    {
+        UndoHistory hist;
+        hist.setMergeWindow(0);
+        hist.setCallback(set_value);
+        assert_true(hist.openJournal(path), "Open New Journal", __LINE__);
+        for(int i = 0; i < 3; ++i)
+            change(hist, "/a", i, i+1);
+        hist.seekHistory(-1);
+    }
+    {
+        UndoHistory hist;
+        hist.setMergeWindow(0);
+        assert_true(hist.openJournal(path), "Reopen Journal", __LINE__);
+        assert_int_eq(3, hist.size(), "Journal Restores Events", __LINE__);
+        assert_int_eq(2, hist.getPos(), "Journal Restores Position", __LINE__);
+        change(hist, "/a", 2, 5);
+    }
+
+    // simulate a crash while writing a record
+    fd = open(path, O_WRONLY | O_APPEND);
+    assert_int_eq(2, write(fd, "e\1", 2), "Append Incomplete Record",
+            __LINE__);
+    close(fd);
+    {
+        UndoHistory hist;
+        hist.setMergeWindow(0);
+        assert_true(hist.openJournal(path), "Incomplete Record Is Cut Off",
+                __LINE__);
+        assert_int_eq(3, hist.size(), "Redos Are Dropped After Reload",
+                __LINE__);
+        assert_int_eq(5, rtosc_argument(hist.getHistory(2), 2).i,
+                "Journaled Event After Reload", __LINE__);
+    }
+
+    fd = open(path, O_WRONLY | O_TRUNC);
+    assert_int_eq(16, write(fd, "no undo journal!", 16), "Write Other File",
+            __LINE__);
+    close(fd);
+    UndoHistory hist;
+    assert_true(!hist.openJournal(path), "Reject Files That Are No Journal",
+            __LINE__);
+    unlink(path);
+}
+
+void checkpoints(void)
+{
+    int restores = 0;
+    UndoHistory hist;
+    hist.setMergeWindow(0);
+    hist.setCallback(set_value);
+    hist.setCheckpoints(4,
+        [](){ return std::to_string(value); },
+        [&restores](const char *snapshot) {
+            value = atoi(snapshot);
+            ++restores;
+        });
+    for(value = 0; value < 12;) {
+        ++value;
+        change(hist, "/a", value - 1, value);
+    }
+    assert_int_eq(3, hist.checkpoints(), "Checkpoints Are Added Periodically",
+            __LINE__);
+
+    callbacks = 0;
+    hist.seekHistory(-11);
+    assert_int_eq(1, value, "Seek Back Via Checkpoint", __LINE__);
+    assert_int_eq(1, restores, "Restore Nearest Checkpoint", __LINE__);
+    assert_int_eq(3, callbacks, "Replay Only The Delta", __LINE__);
+
+    hist.seekHistory(+1);
+    assert_int_eq(2, value, "Seek Near Without Checkpoint", __LINE__);
+    assert_int_eq(1, restores, "No Restore For Short Seeks", __LINE__);
+}
+
+std::vector<char> blob_state;
+std::string name_state;
+void set_state(const char *msg)
+{
+    if(!strcmp(msg, "/data")) {
+        rtosc_blob_t b = rtosc_argument(msg, 0).b;
+        blob_state.assign((const char*)b.data, (const char*)b.data + b.len);
+    } else if(!strcmp(msg, "/name"))
+        name_state = rtosc_argument(msg, 0).s;
+    else
+        value = rtosc_argument(msg, 0).i;
+}
+
+void change_blob(UndoHistory &hist, const std::vector<char> &old_val,
+                 const std::vector<char> &new_val)
+{
+    std::vector<char> msg(old_val.size() + new_val.size() + 64);
+    rtosc_message(msg.data(), msg.size(), "/undo_change", "sbb", "/data",
+                  old_val.size(), old_val.data(),
+                  new_val.size(), new_val.data());
+    hist.recordEvent(msg.data());
+}
+
+void change_name(UndoHistory &hist, const char *old_val, const char *new_val)
+{
+    char msg[128];
+    rtosc_message(msg, sizeof(msg), "/undo_change", "sss", "/name",
+                  old_val, new_val);
+    hist.recordEvent(msg);
+}
+
+void compact(void)
+{
+    AddressTable table;
+    table.add("/data");
+    table.add("/a");
+    UndoHistory hist;
+    hist.setMergeWindow(0);
+    hist.setLimits(16384, 200);
+    hist.setCompact(true, &table);
+    hist.setCallback(set_state);
+
+    // each step changes one byte of a 4 KiB blob
+    blob_state.assign(4096, 0);
+    for(int k = 0; k < 100; ++k) {
+        std::vector<char> old_val = blob_state;
+        blob_state[k] = k + 1;
+        change_blob(hist, old_val, blob_state);
+    }
+    assert_int_eq(100, hist.size(), "Compact Events Fit Into The Limits",
+            __LINE__);
+    const std::vector<char> last = blob_state;
+
+    rtosc_blob_t old_b = rtosc_argument(hist.getHistory(50), 1).b;
+    rtosc_blob_t new_b = rtosc_argument(hist.getHistory(50), 2).b;
+    assert_int_eq(4096, old_b.len, "Decoded Old Value", __LINE__);
+    assert_int_eq(0, old_b.data[50], "Decoded Old Value Before Change",
+            __LINE__);
+    assert_int_eq(50, old_b.data[49], "Decoded Old Value After Earlier Ones",
+            __LINE__);
+    assert_int_eq(51, rtosc_argument(hist.getHistory(50), 2).b.data[50],
+            "Decoded New Value", __LINE__);
+    (void)new_b;
+
+    hist.seekHistory(-30);
+    assert_int_eq(70, blob_state[69], "Undo Keeps Earlier Changes", __LINE__);
+    assert_int_eq(0, blob_state[70], "Undo Restores Old Bytes", __LINE__);
+    assert_int_eq(0, rtosc_argument(hist.getHistory(80), 1).b.data[80],
+            "Decode Future Events", __LINE__);
+    assert_int_eq(81, rtosc_argument(hist.getHistory(80), 2).b.data[80],
+            "Decode Future Events", __LINE__);
+    hist.seekHistory(-70);
+    assert_true(blob_state == std::vector<char>(4096, 0),
+            "Undo All Compact Events", __LINE__);
+    hist.seekHistory(+100);
+    assert_true(blob_state == last, "Redo All Compact Events", __LINE__);
+
+    // a change without undo event between two events
+    std::vector<char> old_val = blob_state;
+    blob_state[200] = 1;
+    change_blob(hist, old_val, blob_state);
+    std::vector<char> outside = blob_state;
+    outside[300] = 2;
+    blob_state = outside;
+    blob_state[400] = 3;
+    change_blob(hist, outside, blob_state);
+    hist.seekHistory(-1);
+    assert_true(blob_state == outside, "Undo To Unrecorded Value", __LINE__);
+    hist.seekHistory(-1);
+    assert_true(blob_state == last, "Undo Over Unrecorded Change", __LINE__);
+    hist.seekHistory(+2);
+    assert_int_eq(3, blob_state[400], "Redo Over Unrecorded Change",
+            __LINE__);
+    assert_int_eq(2, blob_state[300], "Redo Restores Unrecorded Change",
+            __LINE__);
+
+    // paths which are not interned, strings and fixed size values
+    name_state = "hello";
+    change_name(hist, "hello", "help");
+    change_name(hist, "help", "helmet");
+    change(hist, "/a", 3, 4);
+    assert_str_eq("helmet", rtosc_argument(hist.getHistory(103), 2).s,
+            "Decoded String", __LINE__);
+    assert_str_eq("/a", rtosc_argument(hist.getHistory(104), 0).s,
+            "Decoded Interned Path", __LINE__);
+    hist.seekHistory(-3);
+    assert_int_eq(3, value, "Undo Compact Integer", __LINE__);
+    assert_str_eq("hello", name_state.c_str(), "Undo Compact Strings",
+            __LINE__);
+
+    // merged compact events
+    hist.setMergeWindow(2);
+    name_state = "one";
+    change_name(hist, "one", "two");
+    change_name(hist, "two", "three");
+    assert_int_eq(103, hist.size(), "Compact Events Are Merged", __LINE__);
+    assert_str_eq("one", rtosc_argument(hist.getHistory(102), 1).s,
+            "Merged Event Keeps First Old Value", __LINE__);
+    hist.seekHistory(-1);
+    assert_str_eq("one", name_state.c_str(), "Undo Merged Compact Event",
+            __LINE__);
+    hist.seekHistory(+1);
+    assert_str_eq("three", name_state.c_str(), "Redo Merged Compact Event",
+            __LINE__);
+}
+
 char message_buff[256];
 int main()
 {
@@ -100,6 +413,11 @@ int main()
     assert_int_eq(7, o.b,
             "Verify Redo Has Returned To Altered State", __LINE__);
 
+    limits();
+    coalescing();
+    journal();
+    checkpoints();
+    compact();
     return test_summary();
 }
 
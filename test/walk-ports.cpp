@@ -6,6 +6,8 @@
 
 #include <rtosc/ports.h>
 #include <rtosc/port-sugar.h>
+#include <rtosc/port-index.h>
+#include <rtosc/ports-runtime.h>
 
 void null_fn(const char*,rtosc::RtData){}
 
@@ -40,6 +42,335 @@ void append_str(const rtosc::Port*, const char *name, const char*,
     *res += ";";
 }
 
+static const rtosc::Ports voice_ports = {
+    {"freq::f", 0, 0, null_fn},
+    {"env#3::i", 0, 0, null_fn},
+};
+
+static const rtosc::Ports synth_ports = {
+    {"volume::f", 0, 0, null_fn},
+    {"voice#2/", 0, &voice_ports, null_fn},
+    {"fx/", 0, &d_ports, null_fn},
+};
+
+void append_with_base(const rtosc::Port* p, const char *name,
+                      const char* from_base, const rtosc::Ports&,
+                      void *resVoid, void*)
+{
+    std::string* res = (std::string*)resVoid;
+    *res += name;
+    *res += "(";
+    *res += from_base;
+    *res += ",";
+    *res += p->name;
+    *res += ");";
+}
+
+void port_index(const rtosc::Ports& root, bool expand, const char* name)
+{
+    char buffer[1024];
+    memset(buffer, 0, sizeof(buffer));
+    std::string walked, indexed;
+    rtosc::walk_ports(&root, buffer, 1024, &walked, append_with_base, expand);
+    rtosc::PortIndex index(root, expand);
+    index.walk(&indexed, append_with_base);
+    assert_str_eq(walked.c_str(), indexed.c_str(), name, __LINE__);
+}
+
+void port_index_entries()
+{
+    rtosc::PortIndex index(synth_ports);
+    assert_int_eq(1 + 2 * 4 + 1, index.size(), "port index size", __LINE__);
+
+    const rtosc::PortIndex::entry_t& e = index[8];
+    assert_str_eq("/voice1/env2", index.path(e), "port index path", __LINE__);
+    assert_str_eq("env2", index.path_from_base(e),
+                  "port index path from base", __LINE__);
+    assert_true(e.base == &voice_ports, "port index base", __LINE__);
+    assert_int_eq(2, e.nindices, "port index: number of indices", __LINE__);
+    assert_int_eq(1, index.indices(e)[0], "port index: indices (1)",
+                  __LINE__);
+    assert_int_eq(2, index.indices(e)[1], "port index: indices (2)",
+                  __LINE__);
+    assert_int_eq(0, index[0].nindices, "port index: no indices", __LINE__);
+}
+
+static const rtosc::Ports search_ports = {
+    {"volume::f", 0, 0, null_fn},
+    {"voice#2/", 0, &voice_ports, null_fn},
+    {"fx/", 0, &d_ports, null_fn},
+    {"fxvolume::f", 0, 0, null_fn},
+    {"panning::f", 0, 0, null_fn},
+};
+
+// names from a path search reply, separated by ';'
+std::string search_names(const char *str, const char *needle,
+                         const rtosc::PathSearchIndex *index,
+                         bool substring = false)
+{
+    char types[16];
+    rtosc_arg_t args[15];
+    if(index)
+        rtosc::path_search(*index, str, needle, types, sizeof(types),
+                           args, 15, substring);
+    else
+        rtosc::path_search(search_ports, str, needle, types, sizeof(types),
+                           args, 15);
+    std::string res;
+    for(const char *t = types; *t; t += 2)
+        res += std::string(args[t - types].s) + ";";
+    return res;
+}
+
+void path_search_index()
+{
+    rtosc::PathSearchIndex index(search_ports);
+    const char *needles[] = { "", "v", "vo", "voice", "fx", "x", NULL };
+    for(const char **n = needles; *n; ++n)
+    {
+        std::set<std::string> linear, indexed;
+        std::string l = search_names("", *n, NULL),
+                    i = search_names("", *n, &index);
+        for(size_t p; (p = l.find(';')) != std::string::npos; l.erase(0, p+1))
+            linear.insert(l.substr(0, p));
+        for(size_t p; (p = i.find(';')) != std::string::npos; i.erase(0, p+1))
+            indexed.insert(i.substr(0, p));
+        assert_true(linear == indexed, "indexed path search finds the same "
+                    "ports as the linear one", __LINE__);
+    }
+
+    assert_str_eq("voice#2/;volume::f;", search_names("", "vo", &index).c_str(),
+                  "indexed path search is sorted by name", __LINE__);
+    assert_str_eq("volume::f;fxvolume::f;",
+                  search_names("", "vol", &index, true).c_str(),
+                  "substring matches follow prefix matches", __LINE__);
+    assert_str_eq("fx/;fxvolume::f;", search_names("", "x", &index, true).c_str(),
+                  "substring matches are ranked by position and name",
+                  __LINE__);
+    assert_str_eq("env#3::i;", search_names("/voice1/", "e", &index).c_str(),
+                  "indexed path search in subtree", __LINE__);
+    assert_str_eq("freq::f;", search_names("/voice0/freq", "", &index).c_str(),
+                  "indexed path search on a leaf port", __LINE__);
+
+    char msg[64], reply[256];
+    rtosc_message(msg, sizeof(msg), "/path-search", "ssT", "", "ume");
+    size_t len = rtosc::path_search(index, msg, 8, reply, sizeof(reply));
+    assert_true(len > 0, "indexed path search reply", __LINE__);
+    assert_str_eq("sbsb", rtosc_argument_string(reply),
+                  "indexed path search reply types", __LINE__);
+    assert_str_eq("volume::f", rtosc_argument(reply, 0).s,
+                  "indexed path search reply ranking", __LINE__);
+}
+
+struct Leaf
+{
+    int x;
+    static const rtosc::Ports ports;
+};
+
+#define rObject Leaf
+const rtosc::Ports Leaf::ports = {
+    rParamI(x, "some value"),
+};
+#undef rObject
+
+struct Root
+{
+    Leaf* ptr = nullptr;
+    Leaf arr[2];
+    bool on = false;
+    static const rtosc::Ports ports;
+};
+
+#define rObject Root
+const rtosc::Ports Root::ports = {
+    rRecurp(ptr, "optional subtree"),
+    rRecurs(arr, 2, rEnabledBy(on), "subtrees enabled by a toggle"),
+    rToggle(on, "enable arr"),
+};
+#undef rObject
+
+std::string lazy_walk(const rtosc::Ports& root, void* runtime,
+                      bool expand = true)
+{
+    std::string res;
+    for(const rtosc::PortWalk::item_t& item :
+        rtosc::PortWalk(root, runtime, expand))
+    {
+        append_with_base(item.port, item.path, item.path_from_base,
+                         *item.base, &res, item.runtime);
+    }
+    return res;
+}
+
+void port_walk(const rtosc::Ports& root, void* runtime, bool expand,
+               const char* name)
+{
+    char buffer[1024];
+    memset(buffer, 0, sizeof(buffer));
+    std::string walked;
+    rtosc::walk_ports(&root, buffer, 1024, &walked, append_with_base, expand,
+                      runtime);
+    assert_str_eq(walked.c_str(), lazy_walk(root, runtime, expand).c_str(),
+                  name, __LINE__);
+}
+
+void port_walk_runtime()
+{
+    Root root;
+    Leaf leaf;
+    port_walk(Root::ports, &root, true, "lazy walk, all disabled");
+    root.ptr = &leaf;
+    port_walk(Root::ports, &root, true, "lazy walk, pointer enabled");
+    root.on = true;
+    port_walk(Root::ports, &root, true, "lazy walk, all enabled");
+    port_walk(Root::ports, NULL, true, "lazy walk without runtime");
+    assert_true(lazy_walk(Root::ports, &root).find("/arr1/x") !=
+                std::string::npos, "lazy walk visits enabled subtrees",
+                __LINE__);
+
+    // runtime objects are passed like in walk_ports()
+    bool found = false;
+    for(const rtosc::PortWalk::item_t& item : rtosc::PortWalk(Root::ports,
+                                                              &root))
+    {
+        if(!strcmp(item.path, "/arr1/x"))
+        {
+            found = item.runtime == &root.arr[1];
+            break;
+        }
+    }
+    assert_true(found, "lazy walk passes the subtree's runtime", __LINE__);
+
+    // walks can be interleaved
+    rtosc::PortWalk w1(synth_ports), w2(synth_ports);
+    std::string interleaved;
+    while(w1.next() && w2.next())
+    {
+        interleaved += w1.get().path;
+        interleaved += w2.get().path;
+    }
+    assert_str_eq("/volume/volume/voice0/freq/voice0/freq",
+                  interleaved.substr(0, 38).c_str(),
+                  "lazy walks can be interleaved", __LINE__);
+}
+
+void batched_queries()
+{
+    Root root;
+    root.arr[0].x = 10;
+    root.arr[1].x = 11;
+    root.on = true;
+
+    rtosc::helpers::value_query_t queries[] = {
+        {"/arr1/x", 0, 0}, {"/on", 0, 0}, {"/ptr/x", 0, 0},
+        {"/arr0/x", 0, 0}, {"/nothing", 0, 0}, {"/arr1/x", 0, 0}
+    };
+    rtosc_arg_val_t vals[8];
+    size_t n = rtosc::helpers::get_values_from_runtime(&root, Root::ports,
+                                                       queries, 6, 8, vals);
+    assert_int_eq(4, n, "batched queries: number of values", __LINE__);
+    assert_int_eq(1, queries[0].nargs, "batched query", __LINE__);
+    assert_int_eq(11, vals[queries[0].offset].val.i,
+                  "batched query value", __LINE__);
+    assert_int_eq(10, vals[queries[3].offset].val.i,
+                  "batched query value in sibling", __LINE__);
+    assert_int_eq(11, vals[queries[5].offset].val.i,
+                  "batched query value, queried twice", __LINE__);
+    assert_char_eq('T', vals[queries[1].offset].type,
+                   "batched query at root", __LINE__);
+    assert_int_eq(-1, queries[2].nargs, "batched query with NULL parent",
+                  __LINE__);
+    assert_int_eq(-1, queries[4].nargs, "batched query of unknown port",
+                  __LINE__);
+
+    // too small for all values: "/on" and "/arr0/x" are queried first
+    n = rtosc::helpers::get_values_from_runtime(&root, Root::ports,
+                                                queries, 6, 2, vals);
+    assert_int_eq(2, n, "batched queries stop at full buffer", __LINE__);
+    assert_int_eq(-1, queries[0].nargs, "batched query which does not fit",
+                  __LINE__);
+    assert_int_eq(10, vals[queries[3].offset].val.i,
+                  "batched query which fits", __LINE__);
+}
+
+void typed_query()
+{
+    Root root;
+    root.arr[1].x = 11;
+    char loc[128] = "/";
+    char buffer[128] = "arr1/x";
+    rtosc_arg_val_arena arena;
+    rtosc_arg_val_arena_init(&arena);
+    int n = rtosc::helpers::get_value_from_runtime(&root, Root::ports,
+                                                   sizeof(loc), loc, buffer,
+                                                   sizeof(buffer), &arena);
+    assert_int_eq(1, n, "typed query through Ports", __LINE__);
+    assert_char_eq('i', arena.args[0].type, "typed query type", __LINE__);
+    assert_int_eq(11, arena.args[0].val.i, "typed query value", __LINE__);
+    rtosc_arg_val_arena_destroy(&arena);
+}
+
+struct Counted
+{
+    Leaf arr[4];
+    bool on = true;
+    int queries = 0;
+    static const rtosc::Ports ports;
+};
+
+#define rObject Counted
+const rtosc::Ports Counted::ports = {
+    rRecurs(arr, 4, rEnabledBy(on), "subtrees sharing one toggle"),
+    {"on::T:F", rProp(parameter) rDoc("toggle counting its queries"), 0,
+        [](const char*, rtosc::RtData& d) {
+            Counted* obj = (Counted*)d.obj;
+            ++obj->queries;
+            d.reply(d.loc, obj->on ? "T" : "F");
+        }},
+};
+#undef rObject
+
+void walk_queries_toggles_once()
+{
+    Counted counted;
+    char buffer[1024];
+    memset(buffer, 0, sizeof(buffer));
+    std::string walked;
+    rtosc::walk_ports(&Counted::ports, buffer, 1024, &walked, append_str,
+                      true, &counted);
+    assert_str_eq("/arr0/x;/arr1/x;/arr2/x;/arr3/x;/on;", walked.c_str(),
+                  "walk with shared toggle", __LINE__);
+    assert_int_eq(1, counted.queries,
+                  "shared toggle is queried once per walk", __LINE__);
+
+    counted.on = false;
+    walked.clear();
+    memset(buffer, 0, sizeof(buffer));
+    rtosc::walk_ports(&Counted::ports, buffer, 1024, &walked, append_str,
+                      true, &counted);
+    assert_str_eq("/on;", walked.c_str(),
+                  "toggle is queried again in the next walk", __LINE__);
+    assert_int_eq(2, counted.queries, "one more query for the next walk",
+                  __LINE__);
+
+    rtosc::WalkEnabledCache cache;
+    cache.install();
+    for(int i = 0; i < 2; ++i)
+    {
+        counted.on = !i;
+        walked.clear();
+        memset(buffer, 0, sizeof(buffer));
+        rtosc::walk_ports(&Counted::ports, buffer, 1024, &walked, append_str,
+                          true, &counted);
+    }
+    cache.uninstall();
+    assert_str_eq("/on;", walked.c_str(),
+                  "preallocated cache is cleared for each walk", __LINE__);
+    assert_int_eq(4, counted.queries,
+                  "preallocated cache queries toggles once per walk", __LINE__);
+}
+
 int main()
 {
     char buffer[1024];
@@ -52,6 +383,22 @@ int main()
     printf("str: %s\n",res.c_str());
     // yet wrong, but at least half way right:
     assert_str_eq("/a0/b#2/c;/a1/b#2/c;/a2/b#2/c;", res.c_str(), "walk_ports from root", __LINE__);
+
+    port_index(ports, true, "port index walk");
+    port_index(numeric_ports, true, "port index walk of numeric ports");
+    port_index(synth_ports, true, "port index walk with arrays");
+    port_index(synth_ports, false, "port index walk without expanding");
+    port_index_entries();
+    path_search_index();
+
+    port_walk(ports, NULL, true, "lazy walk");
+    port_walk(numeric_ports, NULL, true, "lazy walk of numeric ports");
+    port_walk(synth_ports, NULL, true, "lazy walk with arrays");
+    port_walk(synth_ports, NULL, false, "lazy walk without expanding");
+    port_walk_runtime();
+    walk_queries_toggles_once();
+    batched_queries();
+    typed_query();
     return test_summary();
 }
 
@@ -0,0 +1,117 @@
+#include <rtosc/worker-pool.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace rtosc;
+
+//each job runs exactly once, on a valid worker
+void test_jobs(WorkerPool &pool, size_t njobs)
+{
+    std::vector<std::atomic<int>> runs(njobs);
+    for(std::atomic<int> &r : runs)
+        r = 0;
+    std::atomic<bool> workers_ok(true);
+    pool.run(njobs, [&](size_t job, unsigned worker) {
+            ++runs[job];
+            if(worker >= pool.size())
+                workers_ok = false;
+        });
+    bool once = true;
+    for(std::atomic<int> &r : runs)
+        once &= r == 1;
+    assert_true(once, "Each job runs once", __LINE__);
+    assert_true(workers_ok, "Jobs get valid worker indices", __LINE__);
+}
+
+//a worker with slow jobs gets its other jobs stolen
+void test_stealing(void)
+{
+    WorkerPool pool(4);
+    enum { njobs = 64 };
+    std::vector<unsigned> ran_on(njobs);
+    pool.run(njobs, [&](size_t job, unsigned worker) {
+            ran_on[job] = worker;
+            if(job < njobs/4)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        });
+    bool stolen = false;
+    for(size_t job = 0; job < njobs/4; ++job)
+        stolen |= ran_on[job] != ran_on[0];
+    assert_true(stolen, "Jobs of a slow worker are stolen", __LINE__);
+}
+
+void test_nested_and_concurrent(void)
+{
+    WorkerPool pool(3);
+    std::atomic<int> inner(0);
+    pool.run(6, [&](size_t, unsigned worker) {
+            pool.run(5, [&](size_t, unsigned inner_worker) {
+                    if(inner_worker == worker)
+                        ++inner;
+                });
+        });
+    assert_int_eq(30, inner, "Nested runs run on the calling worker",
+                  __LINE__);
+
+    std::atomic<int> total(0);
+    std::vector<std::thread> callers;
+    for(int i = 0; i < 4; ++i)
+        callers.emplace_back([&]() {
+                for(int round = 0; round < 50; ++round)
+                    pool.run(10, [&](size_t, unsigned) { ++total; });
+            });
+    for(std::thread &t : callers)
+        t.join();
+    assert_int_eq(4*50*10, total, "Concurrent runs are serialized", __LINE__);
+}
+
+void test_options(void)
+{
+    WorkerPool::options_t options;
+    options.threads = 2;
+    options.avoid_cpu = 0;
+    options.pin = true;
+    options.low_priority = true;
+    WorkerPool pool(options);
+    assert_int_eq(2, pool.size(), "Number of workers", __LINE__);
+#ifdef __linux__
+    //if core 0 and its hyperthreads are all we have, they must be used
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    const bool few_cores = CPU_COUNT(&set) <= 4;
+    bool pinned = true, avoided = true;
+    for(unsigned i = 0; i < pool.size(); ++i) {
+        pinned  &= pool.cpu(i) >= 0 && CPU_ISSET(pool.cpu(i), &set);
+        avoided &= pool.cpu(i) != 0 || few_cores;
+    }
+    assert_true(pinned, "Workers are pinned to usable cores", __LINE__);
+    assert_true(avoided, "Workers are kept off the avoided core", __LINE__);
+#endif
+    test_jobs(pool, 100);
+
+    assert_true(&WorkerPool::shared() == &WorkerPool::shared(),
+                "One shared pool", __LINE__);
+    test_jobs(WorkerPool::shared(), 1000);
+}
+
+int main()
+{
+    WorkerPool one(1), four(4);
+    assert_int_eq(4, four.size(), "Number of workers", __LINE__);
+    test_jobs(one, 100);
+    test_jobs(four, 0);
+    test_jobs(four, 3);
+    test_jobs(four, 10000);
+    test_stealing();
+    test_nested_and_concurrent();
+    test_options();
+
+    return test_summary();
+}